@@ -0,0 +1,54 @@
+# Once done these will be defined:
+#
+#  OPUS_FOUND
+#  OPUS_INCLUDE_DIRS
+#  OPUS_LIBRARIES
+#
+# For use in OBS: 
+#
+#  Opus_INCLUDE_DIR
+
+find_package(PkgConfig QUIET)
+if (PKG_CONFIG_FOUND)
+	pkg_check_modules(_OPUS QUIET opus)
+endif()
+
+if(CMAKE_SIZEOF_VOID_P EQUAL 8)
+	set(_lib_suffix 64)
+else()
+	set(_lib_suffix 32)
+endif()
+
+find_path(Opus_INCLUDE_DIR
+	NAMES opus/opus.h
+	HINTS
+		ENV OpusPath${_lib_suffix}
+		ENV OpusPath
+		${_OPUS_INCLUDE_DIRS}
+	PATHS
+		/usr/include /usr/local/include /opt/local/include /sw/include)
+
+find_library(Opus_LIB
+	NAMES ${_OPUS_LIBRARIES} opus libopus
+	HINTS
+		ENV OpusPath${_lib_suffix}
+		ENV OpusPath
+		${_OPUS_LIBRARY_DIRS}
+	PATHS
+		/usr/lib /usr/local/lib /opt/local/lib /sw/lib
+	PATH_SUFFIXES
+		lib${_lib_suffix} lib
+		libs${_lib_suffix} libs
+		bin${_lib_suffix} bin
+		../lib${_lib_suffix} ../lib
+		../libs${_lib_suffix} ../libs
+		../bin${_lib_suffix} ../bin)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Opus DEFAULT_MSG Opus_LIB Opus_INCLUDE_DIR)
+mark_as_advanced(Opus_INCLUDE_DIR Opus_LIB)
+
+if(OPUS_FOUND)
+	set(OPUS_INCLUDE_DIRS ${Opus_INCLUDE_DIR})
+	set(OPUS_LIBRARIES ${Opus_LIB})
+endif()
@@ -0,0 +1,278 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "d3d11-subsystem.hpp"
+
+static inline bool get_monitor(gs_device_t *device, int monitor_idx,
+		IDXGIOutput **dxgiOutput)
+{
+	ComPtr<IDXGIDevice>  dxgiDevice;
+	ComPtr<IDXGIAdapter> dxgiAdapter;
+	HRESULT hr;
+
+	hr = device->device->QueryInterface(__uuidof(IDXGIDevice),
+			(void**)dxgiDevice.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to query IDXGIDevice", hr);
+
+	hr = dxgiDevice->GetAdapter(dxgiAdapter.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to get adapter", hr);
+
+	hr = dxgiAdapter->EnumOutputs(monitor_idx, dxgiOutput);
+	if (hr == DXGI_ERROR_NOT_FOUND)
+		return false;
+	if (FAILED(hr))
+		throw HRError("Failed to get output", hr);
+
+	return true;
+}
+
+gs_duplicator::gs_duplicator(gs_device_t *device_, int monitor_idx)
+	: texture (nullptr),
+	  device  (device_)
+{
+	ComPtr<IDXGIOutput>  output;
+	ComPtr<IDXGIOutput1> output1;
+	HRESULT hr;
+
+	if (!get_monitor(device, monitor_idx, output.Assign()))
+		throw "Invalid monitor index";
+
+	hr = output->QueryInterface(__uuidof(IDXGIOutput1),
+			(void**)output1.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to query IDXGIOutput1", hr);
+
+	hr = output1->DuplicateOutput(device->device, duplicator.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to duplicate output", hr);
+}
+
+gs_duplicator::~gs_duplicator()
+{
+	delete texture;
+}
+
+/* the acquired frame always contains the full desktop image, so moved regions
+ * can be copied from their destination just like dirty regions */
+static inline void copy_rect(gs_duplicator_t *d, ID3D11Texture2D *frame,
+		const RECT &rect)
+{
+	D3D11_BOX box;
+	box.left   = (UINT)rect.left;
+	box.top    = (UINT)rect.top;
+	box.right  = (UINT)rect.right;
+	box.bottom = (UINT)rect.bottom;
+	box.front  = 0;
+	box.back   = 1;
+
+	if (box.right > d->texture->width)
+		box.right = d->texture->width;
+	if (box.bottom > d->texture->height)
+		box.bottom = d->texture->height;
+	if (box.left >= box.right || box.top >= box.bottom)
+		return;
+
+	d->device->context->CopySubresourceRegion(d->texture->texture, 0,
+			box.left, box.top, 0, frame, 0, &box);
+}
+
+static bool copy_changed_rects(gs_duplicator_t *d, ID3D11Texture2D *frame,
+		const DXGI_OUTDUPL_FRAME_INFO &info)
+{
+	UINT move_size  = 0;
+	UINT dirty_size = 0;
+	HRESULT hr;
+
+	if (d->metadata.size() < info.TotalMetadataBufferSize)
+		d->metadata.resize(info.TotalMetadataBufferSize);
+	if (!info.TotalMetadataBufferSize)
+		return true;
+
+	hr = d->duplicator->GetFrameMoveRects(
+			(UINT)d->metadata.size(),
+			(DXGI_OUTDUPL_MOVE_RECT*)d->metadata.data(),
+			&move_size);
+	if (FAILED(hr))
+		return false;
+
+	hr = d->duplicator->GetFrameDirtyRects(
+			(UINT)(d->metadata.size() - move_size),
+			(RECT*)(d->metadata.data() + move_size),
+			&dirty_size);
+	if (FAILED(hr))
+		return false;
+
+	DXGI_OUTDUPL_MOVE_RECT *moves =
+		(DXGI_OUTDUPL_MOVE_RECT*)d->metadata.data();
+	RECT *dirty = (RECT*)(d->metadata.data() + move_size);
+
+	for (size_t i = 0; i < move_size / sizeof(*moves); i++) {
+		const DXGI_OUTDUPL_MOVE_RECT &move = moves[i];
+		RECT rect;
+		rect.left   = move.DestinationPoint.x;
+		rect.top    = move.DestinationPoint.y;
+		rect.right  = rect.left + (move.SourceRect.right -
+				move.SourceRect.left);
+		rect.bottom = rect.top + (move.SourceRect.bottom -
+				move.SourceRect.top);
+		copy_rect(d, frame, rect);
+	}
+
+	for (size_t i = 0; i < dirty_size / sizeof(*dirty); i++)
+		copy_rect(d, frame, dirty[i]);
+
+	return true;
+}
+
+static inline void copy_texture(gs_duplicator_t *d, ID3D11Texture2D *frame,
+		const DXGI_OUTDUPL_FRAME_INFO &info)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	frame->GetDesc(&desc);
+
+	bool recreate = !d->texture ||
+		d->texture->width  != desc.Width ||
+		d->texture->height != desc.Height ||
+		d->texture->dxgiFormat != desc.Format;
+
+	if (recreate) {
+		gs_color_format format = ConvertDXGITextureFormat(desc.Format);
+		if (format == GS_UNKNOWN)
+			return;
+
+		delete d->texture;
+		d->texture = nullptr;
+
+		try {
+			d->texture = new gs_texture_2d(d->device, desc.Width,
+					desc.Height, format, 1, nullptr, 0,
+					GS_TEXTURE_2D, false, false);
+		} catch (HRError error) {
+			blog(LOG_ERROR, "gs_duplicator_update_frame: Failed "
+			                "to create texture: %s (%08lX)",
+					error.str, error.hr);
+		}
+	}
+
+	if (!d->texture)
+		return;
+
+	if (recreate || !copy_changed_rects(d, frame, info))
+		d->device->context->CopyResource(d->texture->texture, frame);
+}
+
+extern "C" {
+
+EXPORT bool device_get_duplicator_monitor_info(gs_device_t *device,
+		int monitor_idx, struct gs_monitor_info *info)
+{
+	DXGI_OUTPUT_DESC desc;
+	HRESULT hr;
+
+	try {
+		ComPtr<IDXGIOutput> output;
+
+		if (!get_monitor(device, monitor_idx, output.Assign()))
+			return false;
+
+		hr = output->GetDesc(&desc);
+		if (FAILED(hr))
+			throw HRError("GetDesc failed", hr);
+
+	} catch (HRError error) {
+		blog(LOG_ERROR, "device_get_duplicator_monitor_info: "
+		                "%s (%08lX)", error.str, error.hr);
+		return false;
+	}
+
+	info->x  = desc.DesktopCoordinates.left;
+	info->y  = desc.DesktopCoordinates.top;
+	info->cx = desc.DesktopCoordinates.right - info->x;
+	info->cy = desc.DesktopCoordinates.bottom - info->y;
+
+	return true;
+}
+
+EXPORT gs_duplicator_t *device_duplicator_create(gs_device_t *device,
+		int monitor_idx)
+{
+	gs_duplicator *duplicator = nullptr;
+
+	try {
+		duplicator = new gs_duplicator(device, monitor_idx);
+
+	} catch (const char *error) {
+		blog(LOG_DEBUG, "device_duplicator_create: %s", error);
+		return nullptr;
+
+	} catch (HRError error) {
+		blog(LOG_DEBUG, "device_duplicator_create: %s (%08lX)",
+				error.str, error.hr);
+		return nullptr;
+	}
+
+	return duplicator;
+}
+
+EXPORT void gs_duplicator_destroy(gs_duplicator_t *duplicator)
+{
+	delete duplicator;
+}
+
+EXPORT bool gs_duplicator_update_frame(gs_duplicator_t *d)
+{
+	DXGI_OUTDUPL_FRAME_INFO info;
+	ComPtr<ID3D11Texture2D> tex;
+	ComPtr<IDXGIResource> res;
+	HRESULT hr;
+
+	hr = d->duplicator->AcquireNextFrame(0, &info, res.Assign());
+	if (hr == DXGI_ERROR_ACCESS_LOST) {
+		return false;
+
+	} else if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+		return true;
+
+	} else if (FAILED(hr)) {
+		blog(LOG_ERROR, "gs_duplicator_update_frame: Failed to update "
+		                "frame (%08lX)", hr);
+		return true;
+	}
+
+	/* cursor-only updates don't touch the desktop image */
+	if (info.LastPresentTime.QuadPart != 0 || !d->texture) {
+		hr = res->QueryInterface(__uuidof(ID3D11Texture2D),
+				(void**)tex.Assign());
+		if (SUCCEEDED(hr))
+			copy_texture(d, tex, info);
+		else
+			blog(LOG_ERROR, "gs_duplicator_update_frame: Failed to "
+			                "query ID3D11Texture2D (%08lX)", hr);
+	}
+
+	d->duplicator->ReleaseFrame();
+	return true;
+}
+
+EXPORT gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator)
+{
+	return duplicator->texture;
+}
+
+}
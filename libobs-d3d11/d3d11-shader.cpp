@@ -21,6 +21,7 @@
 #include <graphics/vec3.h>
 #include <graphics/matrix3.h>
 #include <graphics/matrix4.h>
+#include <util/platform.h>
 
 void gs_vertex_shader::GetBuffersExpected(
 		const vector<D3D11_INPUT_ELEMENT_DESC> &inputs)
@@ -48,7 +49,7 @@ gs_vertex_shader::gs_vertex_shader(gs_device_t *device, const char *file,
 {
 	vector<D3D11_INPUT_ELEMENT_DESC> inputs;
 	ShaderProcessor    processor(device);
-	ComPtr<ID3D10Blob> shaderBlob;
+	vector<uint8_t>    bytecode;
 	string             outputString;
 	HRESULT            hr;
 
@@ -59,16 +60,16 @@ gs_vertex_shader::gs_vertex_shader(gs_device_t *device, const char *file,
 	GetBuffersExpected(inputs);
 	BuildConstantBuffer();
 
-	Compile(outputString.c_str(), file, "vs_4_0", shaderBlob.Assign());
+	Compile(outputString.c_str(), file, "vs_4_0", bytecode);
 
-	hr = device->device->CreateVertexShader(shaderBlob->GetBufferPointer(),
-			shaderBlob->GetBufferSize(), NULL, shader.Assign());
+	hr = device->device->CreateVertexShader(bytecode.data(),
+			bytecode.size(), NULL, shader.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to create vertex shader", hr);
 
 	hr = device->device->CreateInputLayout(inputs.data(),
-			(UINT)inputs.size(), shaderBlob->GetBufferPointer(),
-			shaderBlob->GetBufferSize(), layout.Assign());
+			(UINT)inputs.size(), bytecode.data(),
+			bytecode.size(), layout.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to create input layout", hr);
 
@@ -81,7 +82,7 @@ gs_pixel_shader::gs_pixel_shader(gs_device_t *device, const char *file,
 	: gs_shader(device, GS_SHADER_PIXEL)
 {
 	ShaderProcessor    processor(device);
-	ComPtr<ID3D10Blob> shaderBlob;
+	vector<uint8_t>    bytecode;
 	string             outputString;
 	HRESULT            hr;
 
@@ -91,10 +92,10 @@ gs_pixel_shader::gs_pixel_shader(gs_device_t *device, const char *file,
 	processor.BuildSamplers(samplers);
 	BuildConstantBuffer();
 
-	Compile(outputString.c_str(), file, "ps_4_0", shaderBlob.Assign());
+	Compile(outputString.c_str(), file, "ps_4_0", bytecode);
 
-	hr = device->device->CreatePixelShader(shaderBlob->GetBufferPointer(),
-			shaderBlob->GetBufferSize(), NULL, shader.Assign());
+	hr = device->device->CreatePixelShader(bytecode.data(),
+			bytecode.size(), NULL, shader.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to create vertex shader", hr);
 }
@@ -151,6 +152,8 @@ void gs_shader::BuildConstantBuffer()
 		constantSize += size;
 	}
 
+	constData.assign(constantSize, 0);
+
 	if (constantSize) {
 		D3D11_BUFFER_DESC bd;
 		HRESULT hr;
@@ -171,48 +174,149 @@ void gs_shader::BuildConstantBuffer()
 		gs_shader_set_default(&params[i]);
 }
 
+/*
+ * Compiled shaders are cached on disk, keyed by a hash of the generated HLSL,
+ * the target and the compiler version.  Shader bytecode doesn't depend on the
+ * adapter or driver, so a cached shader stays valid until either the shader
+ * or the compiler changes.
+ */
+
+static uint64_t HashShader(const char *shaderString, const char *target,
+		int compilerVer)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	auto hashBytes = [&hash] (const void *data, size_t size)
+	{
+		const uint8_t *bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	};
+
+	hashBytes(shaderString, strlen(shaderString) + 1);
+	hashBytes(target, strlen(target) + 1);
+	hashBytes(&compilerVer, sizeof(compilerVer));
+	return hash;
+}
+
+static string GetShaderCachePath(uint64_t hash)
+{
+	char name[64];
+	sprintf_s(name, sizeof(name), "obs-studio/shader-cache/%016llx.cso",
+			(unsigned long long)hash);
+
+	char *path = os_get_config_path(name);
+	string str = path ? path : "";
+	bfree(path);
+	return str;
+}
+
+/* checks the size stored in the DXBC container header, so that a truncated
+ * file isn't used */
+static bool LoadCachedShader(const string &path, vector<uint8_t> &bytecode)
+{
+	FILE *file = os_fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	int64_t size = os_fgetsize(file);
+	bool success = false;
+
+	if (size > 32 && size < 0x1000000) {
+		bytecode.resize((size_t)size);
+		success = fread(bytecode.data(), 1, bytecode.size(), file) ==
+			bytecode.size();
+	}
+
+	fclose(file);
+
+	if (success) {
+		uint32_t totalSize;
+		memcpy(&totalSize, bytecode.data() + 24, sizeof(totalSize));
+
+		success = memcmp(bytecode.data(), "DXBC", 4) == 0 &&
+			totalSize == bytecode.size();
+	}
+
+	if (!success)
+		bytecode.clear();
+	return success;
+}
+
+static void SaveCachedShader(const string &path,
+		const vector<uint8_t> &bytecode)
+{
+	char *dir = os_get_config_path("obs-studio/shader-cache");
+	if (dir) {
+		os_mkdir(dir);
+		bfree(dir);
+	}
+
+	FILE *file = os_fopen(path.c_str(), "wb");
+	if (!file)
+		return;
+
+	bool success = fwrite(bytecode.data(), 1, bytecode.size(), file) ==
+		bytecode.size();
+	fclose(file);
+
+	if (!success)
+		os_unlink(path.c_str());
+}
+
 void gs_shader::Compile(const char *shaderString, const char *file,
-		const char *target, ID3D10Blob **shader)
+		const char *target, vector<uint8_t> &bytecode)
 {
+	ComPtr<ID3D10Blob> shaderBlob;
 	ComPtr<ID3D10Blob> errorsBlob;
 	HRESULT hr;
 
 	if (!shaderString)
 		throw "No shader string specified";
 
+	string cachePath = GetShaderCachePath(HashShader(shaderString, target,
+				device->d3dCompilerVer));
+	if (!cachePath.empty() && LoadCachedShader(cachePath, bytecode))
+		return;
+
 	hr = device->d3dCompile(shaderString, strlen(shaderString), file, NULL,
 			NULL, "main", target,
 			D3D10_SHADER_OPTIMIZATION_LEVEL1, 0,
-			shader, errorsBlob.Assign());
+			shaderBlob.Assign(), errorsBlob.Assign());
 	if (FAILED(hr)) {
 		if (errorsBlob != NULL && errorsBlob->GetBufferSize())
 			throw ShaderError(errorsBlob, hr);
 		else
 			throw HRError("Failed to compile shader", hr);
 	}
+
+	const uint8_t *data = (const uint8_t*)shaderBlob->GetBufferPointer();
+	bytecode.assign(data, data + shaderBlob->GetBufferSize());
+
+	if (!cachePath.empty())
+		SaveCachedShader(cachePath, bytecode);
 }
 
-inline void gs_shader::UpdateParam(vector<uint8_t> &constData,
-		gs_shader_param &param, bool &upload)
+/*
+ * Constant data is kept between draws, and only values that were changed
+ * since the last upload are written to it.  The buffer is only mapped and
+ * uploaded when something changed.
+ */
+inline void gs_shader::UpdateParam(gs_shader_param &param, bool &upload)
 {
 	if (param.type != GS_SHADER_PARAM_TEXTURE) {
 		if (!param.curValue.size())
 			throw "Not all shader parameters were set";
 
-		/* padding in case the constant needs to start at a new
-		 * register */
-		if (param.pos > constData.size()) {
-			uint8_t zero  = 0;
-
-			constData.insert(constData.end(),
-					param.pos - constData.size(), zero);
-		}
+		if (param.changed) {
+			if (param.pos + param.curValue.size() > constData.size())
+				throw "Invalid constant data size given to "
+				      "shader";
 
-		constData.insert(constData.end(),
-				param.curValue.begin(),
-				param.curValue.end());
+			memcpy(constData.data() + param.pos,
+					param.curValue.data(),
+					param.curValue.size());
 
-		if (param.changed) {
 			upload = true;
 			param.changed = false;
 		}
@@ -225,16 +329,10 @@ inline void gs_shader::UpdateParam(vector<uint8_t> &constData,
 
 void gs_shader::UploadParams()
 {
-	vector<uint8_t> constData;
-	bool            upload = false;
-
-	constData.reserve(constantSize);
+	bool upload = false;
 
 	for (size_t i = 0; i < params.size(); i++)
-		UpdateParam(constData, params[i], upload);
-
-	if (constData.size() != constantSize)
-		throw "Invalid constant data size given to shader";
+		UpdateParam(params[i], upload);
 
 	if (upload) {
 		D3D11_MAPPED_SUBRESOURCE map;
@@ -23,8 +23,10 @@ gs_stage_surface::gs_stage_surface(gs_device_t *device, uint32_t width,
 	  width      (width),
 	  height     (height),
 	  format     (colorFormat),
-	  dxgiFormat (ConvertGSTextureFormat(colorFormat))
+	  dxgiFormat (ConvertGSTextureFormat(colorFormat)),
+	  pitch      (0)
 {
+	D3D11_MAPPED_SUBRESOURCE map;
 	D3D11_TEXTURE2D_DESC td;
 	HRESULT hr;
 
@@ -41,4 +43,12 @@ gs_stage_surface::gs_stage_surface(gs_device_t *device, uint32_t width,
 	hr = device->device->CreateTexture2D(&td, NULL, texture.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to create 2D texture", hr);
+
+	/* the row pitch is only known once mapped, nothing has been copied to
+	 * the surface yet so this doesn't stall */
+	hr = device->context->Map(texture, 0, D3D11_MAP_READ, 0, &map);
+	if (SUCCEEDED(hr)) {
+		pitch = map.RowPitch;
+		device->context->Unmap(texture, 0);
+	}
 }
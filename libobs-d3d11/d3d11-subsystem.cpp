@@ -35,11 +35,25 @@ struct UnsupportedHWError : HRError {
 static const IID dxgiFactory2 =
 {0x50c83a1c, 0xe072, 0x4c48, {0x87, 0xb0, 0x36, 0x30, 0xfa, 0x36, 0xa6, 0xd0}};
 
+/* not in older SDK headers */
+static const DXGI_SWAP_EFFECT swapEffectFlipSequential = (DXGI_SWAP_EFFECT)3;
+static const DXGI_SWAP_EFFECT swapEffectFlipDiscard    = (DXGI_SWAP_EFFECT)4;
+
 static inline void make_swap_desc(DXGI_SWAP_CHAIN_DESC &desc,
-		const gs_init_data *data)
+		const gs_init_data *data,
+		DXGI_SWAP_EFFECT effect = DXGI_SWAP_EFFECT_DISCARD,
+		UINT flags = 0)
 {
+	bool flip = effect == swapEffectFlipSequential ||
+		effect == swapEffectFlipDiscard;
+
 	memset(&desc, 0, sizeof(desc));
 	desc.BufferCount       = data->num_backbuffers;
+	if (flip && desc.BufferCount < 2)
+		desc.BufferCount = 2;
+
+	desc.SwapEffect        = effect;
+	desc.Flags             = flags;
 	desc.BufferDesc.Format = ConvertGSTextureFormat(data->format);
 	desc.BufferDesc.Width  = data->cx;
 	desc.BufferDesc.Height = data->cy;
@@ -96,7 +110,8 @@ void gs_swap_chain::Resize(uint32_t cx, uint32_t cy)
 		if (cy == 0) cy = clientRect.bottom;
 	}
 
-	hr = swap->ResizeBuffers(numBuffers, cx, cy, target.dxgiFormat, 0);
+	hr = swap->ResizeBuffers(numBuffers, cx, cy, target.dxgiFormat,
+			swapFlags);
 	if (FAILED(hr))
 		throw HRError("Failed to resize swap buffers", hr);
 
@@ -118,14 +133,59 @@ void gs_swap_chain::Init(const gs_init_data *data)
 	InitZStencilBuffer(data->cx, data->cy);
 }
 
+bool gs_swap_chain::InitWaitable()
+{
+	ComPtr<IDXGISwapChain2> swap2;
+	HRESULT hr;
+
+	hr = swap->QueryInterface(__uuidof(IDXGISwapChain2),
+			(void**)swap2.Assign());
+	if (FAILED(hr))
+		return false;
+
+	swap2->SetMaximumFrameLatency(1);
+	waitable = swap2->GetFrameLatencyWaitableObject();
+	return waitable != NULL;
+}
+
+/*
+ * Displays use flip model swap chains where available: they present without
+ * a copy through the compositor, and their frame latency waitable object lets
+ * the graphics thread check whether a display can take a frame rather than
+ * blocking in Present.  Flip discard needs Windows 10 and flip sequential
+ * Windows 8.1, so each is tried in turn before falling back to the blt model.
+ */
+static const DXGI_SWAP_EFFECT flipEffects[] = {
+	swapEffectFlipDiscard,
+	swapEffectFlipSequential
+};
+
+static const UINT flipFlags =
+	DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+
 gs_swap_chain::gs_swap_chain(gs_device *device, const gs_init_data *data)
 	: device     (device),
 	  numBuffers (data->num_backbuffers),
-	  hwnd       ((HWND)data->window.hwnd)
+	  hwnd       ((HWND)data->window.hwnd),
+	  swapFlags  (0),
+	  waitable   (NULL)
 {
 	HRESULT hr;
 	DXGI_SWAP_CHAIN_DESC swapDesc;
 
+	for (DXGI_SWAP_EFFECT effect : flipEffects) {
+		make_swap_desc(swapDesc, data, effect, flipFlags);
+		hr = device->factory->CreateSwapChain(device->device,
+				&swapDesc, swap.Assign());
+
+		if (SUCCEEDED(hr) && InitWaitable()) {
+			numBuffers = swapDesc.BufferCount;
+			swapFlags  = swapDesc.Flags;
+			Init(data);
+			return;
+		}
+	}
+
 	make_swap_desc(swapDesc, data);
 	hr = device->factory->CreateSwapChain(device->device, &swapDesc,
 			swap.Assign());
@@ -148,6 +208,7 @@ void gs_device::InitCompiler()
 			d3dCompile = (pD3DCompile)GetProcAddress(module,
 					"D3DCompile");
 			if (d3dCompile) {
+				d3dCompilerVer = ver;
 				return;
 			}
 
@@ -206,6 +267,27 @@ void gs_device::InitDevice(const gs_init_data *data, IDXGIAdapter *adapter)
 	blog(LOG_INFO, "Loading up D3D11 on adapter %s", adapterNameUTF8);
 	bfree(adapterNameUTF8);
 
+	/* without a window there is no default swap chain, everything is
+	 * rendered to textures (headless) */
+	if (!data->window.hwnd) {
+		hr = D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN,
+				NULL, createFlags, featureLevels,
+				sizeof(featureLevels) /
+				sizeof(D3D_FEATURE_LEVEL),
+				D3D11_SDK_VERSION, device.Assign(),
+				&levelUsed, context.Assign());
+		if (FAILED(hr))
+			throw UnsupportedHWError("Failed to create device",
+					hr);
+
+		blog(LOG_INFO, "D3D11 loaded sucessfully without a window, "
+		               "feature level used: %u",
+		               (uint32_t)levelUsed);
+
+		defaultSwap.device = this;
+		return;
+	}
+
 	hr = D3D11CreateDeviceAndSwapChain(adapter, D3D_DRIVER_TYPE_UNKNOWN,
 			NULL, createFlags, featureLevels,
 			sizeof(featureLevels) / sizeof(D3D_FEATURE_LEVEL),
@@ -531,6 +613,9 @@ void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
 		ID3D11DepthStencilView *depthView  = NULL;
 		int i = device->curRenderSide;
 
+		if (!device->curSwapChain->swap)
+			return;
+
 		device->context->OMSetRenderTargets(1, &renderView, depthView);
 		device->curSwapChain->Resize(cx, cy);
 
@@ -650,6 +735,33 @@ gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
 	return surf;
 }
 
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	gs_timer *timer = NULL;
+	try {
+		timer = new gs_timer(device);
+	} catch (HRError error) {
+		blog(LOG_ERROR, "device_timer_create (D3D11): %s (%08lX)",
+				error.str, error.hr);
+	}
+
+	return timer;
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	gs_timer_range *range = NULL;
+	try {
+		range = new gs_timer_range(device);
+	} catch (HRError error) {
+		blog(LOG_ERROR, "device_timer_range_create (D3D11): %s "
+		                "(%08lX)",
+				error.str, error.hr);
+	}
+
+	return range;
+}
+
 gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
 		const struct gs_sampler_info *info)
 {
@@ -962,11 +1074,28 @@ gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
 	return device->curZStencilBuffer;
 }
 
+static inline void unbind_render_target(gs_device_t *device)
+{
+	ID3D11RenderTargetView *rt = NULL;
+
+	device->curRenderTarget   = NULL;
+	device->curRenderSide     = 0;
+	device->curZStencilBuffer = NULL;
+	device->context->OMSetRenderTargets(1, &rt, NULL);
+}
+
 void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
 		gs_zstencil_t *zstencil)
 {
-	if (!tex)
+	if (!tex) {
+		/* windowless device, there's no swap chain to fall back to */
+		if (!device->curSwapChain->swap) {
+			unbind_render_target(device);
+			return;
+		}
+
 		tex = &device->curSwapChain->target;
+	}
 	if (!zstencil)
 		zstencil = &device->curSwapChain->zs;
 
@@ -1216,7 +1345,7 @@ void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
 {
 	gs_texture_t  *target = device->curRenderTarget;
 	gs_zstencil_t *zs     = device->curZStencilBuffer;
-	bool is_cube = device->curRenderTarget->type == GS_TEXTURE_CUBE;
+	bool is_cube = target && target->type == GS_TEXTURE_CUBE;
 
 	if (target == &device->curSwapChain->target)
 		target = NULL;
@@ -1260,7 +1389,8 @@ void device_clear(gs_device_t *device, uint32_t clear_flags,
 
 void device_present(gs_device_t *device)
 {
-	device->curSwapChain->swap->Present(0, 0);
+	if (device->curSwapChain->swap)
+		device->curSwapChain->swap->Present(0, 0);
 }
 
 void device_flush(gs_device_t *device)
@@ -1520,6 +1650,15 @@ void device_projection_pop(gs_device_t *device)
 	device->projStack.pop_back();
 }
 
+bool gs_swapchain_ready(gs_swapchain_t *swapchain)
+{
+	/* a successful wait takes the frame, the caller presents next */
+	if (!swapchain->waitable)
+		return true;
+
+	return WaitForSingleObject(swapchain->waitable, 0) == WAIT_OBJECT_0;
+}
+
 void gs_swapchain_destroy(gs_swapchain_t *swapchain)
 {
 	if (!swapchain)
@@ -1590,6 +1729,67 @@ void gs_texture_unmap(gs_texture_t *tex)
 	tex2d->device->context->Unmap(tex2d->texture, 0);
 }
 
+static inline bool can_update_region(gs_texture_t *tex)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return false;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d*>(tex);
+
+	/* dynamic textures can only be written by mapping the whole image */
+	return !tex2d->isDynamic && !gs_is_compressed_format(tex2d->format);
+}
+
+static inline void update_region(gs_texture_2d *tex2d, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	D3D11_BOX box;
+	box.left   = x;
+	box.top    = y;
+	box.front  = 0;
+	box.right  = x + cx;
+	box.bottom = y + cy;
+	box.back   = 1;
+
+	tex2d->device->context->UpdateSubresource(tex2d->texture, 0, &box,
+			data, linesize, 0);
+}
+
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	if (!can_update_region(tex))
+		return false;
+
+	update_region(static_cast<gs_texture_2d*>(tex), data, linesize,
+			x, y, cx, cy);
+	return true;
+}
+
+bool gs_texture_set_image_regions(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, const gs_rect *rects, size_t num_rects)
+{
+	if (!can_update_region(tex))
+		return false;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d*>(tex);
+	uint32_t pixel_size = gs_get_format_bpp(tex2d->format) / 8;
+
+	for (size_t i = 0; i < num_rects; i++) {
+		const gs_rect &rect = rects[i];
+		const uint8_t *pixels = data +
+			(uint32_t)rect.y * linesize +
+			(uint32_t)rect.x * pixel_size;
+
+		update_region(tex2d, pixels, linesize, rect.x, rect.y,
+				rect.cx, rect.cy);
+	}
+
+	return true;
+}
+
 void *gs_texture_get_obj(gs_texture_t *tex)
 {
 	if (tex->type != GS_TEXTURE_2D)
@@ -1680,6 +1880,11 @@ enum gs_color_format gs_stagesurface_get_color_format(
 	return stagesurf->format;
 }
 
+uint32_t gs_stagesurface_get_pitch(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->pitch;
+}
+
 bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize)
 {
@@ -1693,12 +1898,190 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 	return true;
 }
 
+bool gs_stagesurface_try_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	D3D11_MAPPED_SUBRESOURCE map;
+	HRESULT hr = stagesurf->device->context->Map(stagesurf->texture, 0,
+			D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+
+	/* DXGI_ERROR_WAS_STILL_DRAWING while the copy is pending */
+	if (FAILED(hr))
+		return false;
+
+	*data = (uint8_t*)map.pData;
+	*linesize = map.RowPitch;
+	return true;
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	stagesurf->device->context->Unmap(stagesurf->texture, 0);
 }
 
 
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	delete timer;
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	timer->device->context->End(timer->queryBegin);
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	timer->device->context->End(timer->queryEnd);
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	ID3D11DeviceContext *context = timer->device->context;
+	uint64_t begin, end;
+	HRESULT hr;
+
+	hr = context->GetData(timer->queryEnd, &end, sizeof(end),
+			D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	if (hr != S_OK)
+		return false;
+
+	hr = context->GetData(timer->queryBegin, &begin, sizeof(begin),
+			D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	if (hr != S_OK)
+		return false;
+
+	*ticks = end - begin;
+	return true;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	delete range;
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	range->device->context->Begin(range->queryDisjoint);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	range->device->context->End(range->queryDisjoint);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+		uint64_t *frequency)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT data;
+	HRESULT hr;
+
+	hr = range->device->context->GetData(range->queryDisjoint, &data,
+			sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	if (hr != S_OK)
+		return false;
+
+	*disjoint  = data.Disjoint != FALSE;
+	*frequency = data.Frequency;
+	return true;
+}
+
+/* forgets the cached bindings so that the next calls bind them again on the
+ * current context, keeping only the render target and viewport */
+void gs_device::ResetStateCache()
+{
+	gs_texture_2d      *target   = curRenderTarget;
+	gs_zstencil_buffer *zstencil = curZStencilBuffer;
+	int                side      = curRenderSide;
+
+	curRenderTarget      = nullptr;
+	curZStencilBuffer    = nullptr;
+	curVertexBuffer      = nullptr;
+	curIndexBuffer       = nullptr;
+	curVertexShader      = nullptr;
+	curPixelShader       = nullptr;
+	curDepthStencilState = nullptr;
+	curRasterState       = nullptr;
+	curBlendState        = nullptr;
+	curToplogy           = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	memset(curTextures, 0, sizeof(curTextures));
+	memset(curSamplers, 0, sizeof(curSamplers));
+
+	zstencilStateChanged = true;
+	rasterStateChanged   = true;
+	blendStateChanged    = true;
+
+	if (target && target->type == GS_TEXTURE_CUBE)
+		device_set_cube_render_target(this, target, side, zstencil);
+	else if (target)
+		device_set_render_target(this, target, zstencil);
+
+	device_set_viewport(this, viewport.x, viewport.y, viewport.cx,
+			viewport.cy);
+}
+
+bool device_command_list_begin(gs_device_t *device)
+{
+	if (device->immediateContext) {
+		blog(LOG_ERROR, "device_command_list_begin (D3D11): "
+		                "Already recording a command list");
+		return false;
+	}
+
+	if (!device->deferredContext) {
+		HRESULT hr = device->device->CreateDeferredContext(0,
+				device->deferredContext.Assign());
+		if (FAILED(hr)) {
+			blog(LOG_ERROR, "device_command_list_begin (D3D11): "
+			                "Failed to create deferred context "
+			                "(%08lX)", hr);
+			return false;
+		}
+	}
+
+	device->immediateContext = device->context;
+	device->context          = device->deferredContext;
+	device->ResetStateCache();
+	return true;
+}
+
+gs_cmdlist_t *device_command_list_end(gs_device_t *device)
+{
+	if (!device->immediateContext)
+		return nullptr;
+
+	gs_command_list *list = new gs_command_list;
+	HRESULT hr = device->context->FinishCommandList(FALSE,
+			list->list.Assign());
+
+	device->context = device->immediateContext;
+	device->immediateContext.Clear();
+	device->ResetStateCache();
+
+	if (FAILED(hr)) {
+		blog(LOG_ERROR, "device_command_list_end (D3D11): "
+		                "Failed to finish command list (%08lX)", hr);
+		delete list;
+		return nullptr;
+	}
+
+	return list;
+}
+
+void device_command_list_execute(gs_device_t *device, gs_cmdlist_t *list)
+{
+	/* FALSE clears the context state afterwards, which is cheaper than
+	 * having it saved and restored */
+	device->context->ExecuteCommandList(list->list, FALSE);
+	device->ResetStateCache();
+}
+
+void gs_command_list_destroy(gs_cmdlist_t *list)
+{
+	delete list;
+}
+
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	delete zstencil;
@@ -1755,6 +2138,56 @@ void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
 	}
 }
 
+void gs_vertexbuffer_flush_range(gs_vertbuffer_t *vertbuffer, size_t start,
+		size_t num, bool discard)
+{
+	if (!vertbuffer->dynamic) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush_range: vertex buffer "
+		                "is not dynamic");
+		return;
+	}
+	if (!num || start + num > vertbuffer->numVerts) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush_range: vertex range "
+		                "out of bounds");
+		return;
+	}
+
+	try {
+		gs_vb_data *data = vertbuffer->vbd.data;
+
+		vertbuffer->FlushBufferRange(vertbuffer->vertexBuffer,
+				data->points, sizeof(vec3), start, num,
+				discard);
+
+		if (vertbuffer->normalBuffer)
+			vertbuffer->FlushBufferRange(vertbuffer->normalBuffer,
+					data->normals, sizeof(vec3), start,
+					num, discard);
+
+		if (vertbuffer->tangentBuffer)
+			vertbuffer->FlushBufferRange(
+					vertbuffer->tangentBuffer,
+					data->tangents, sizeof(vec3), start,
+					num, discard);
+
+		if (vertbuffer->colorBuffer)
+			vertbuffer->FlushBufferRange(vertbuffer->colorBuffer,
+					data->colors, sizeof(uint32_t), start,
+					num, discard);
+
+		for (size_t i = 0; i < vertbuffer->uvBuffers.size(); i++) {
+			gs_tvertarray &tv = data->tvarray[i];
+			vertbuffer->FlushBufferRange(vertbuffer->uvBuffers[i],
+					tv.array, tv.width*sizeof(float),
+					start, num, discard);
+		}
+
+	} catch (HRError error) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush_range: %s (%08lX)",
+				error.str, error.hr);
+	}
+}
+
 struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vertbuffer)
 {
 	return vertbuffer->vbd.data;
@@ -1881,3 +2314,12 @@ extern "C" EXPORT gs_texture_t *device_texture_open_shared(gs_device_t *device,
 
 	return texture;
 }
+
+extern "C" EXPORT uint32_t device_texture_get_shared_handle(gs_texture_t *tex)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return 0;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d*>(tex);
+	return tex2d->isShared ? tex2d->sharedHandle : 0;
+}
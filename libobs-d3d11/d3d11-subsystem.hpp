@@ -24,6 +24,8 @@
 
 #include <windows.h>
 #include <dxgi.h>
+#include <dxgi1_2.h>
+#include <dxgi1_3.h>
 #include <d3d11.h>
 #include <d3dcompiler.h>
 
@@ -75,11 +77,38 @@ static inline DXGI_FORMAT ConvertGSTextureFormat(gs_color_format format)
 	case GS_DXT1:        return DXGI_FORMAT_BC1_UNORM;
 	case GS_DXT3:        return DXGI_FORMAT_BC2_UNORM;
 	case GS_DXT5:        return DXGI_FORMAT_BC3_UNORM;
+	case GS_R8G8:        return DXGI_FORMAT_R8G8_UNORM;
 	}
 
 	return DXGI_FORMAT_UNKNOWN;
 }
 
+static inline gs_color_format ConvertDXGITextureFormat(DXGI_FORMAT format)
+{
+	switch (format) {
+	case DXGI_FORMAT_A8_UNORM:           return GS_A8;
+	case DXGI_FORMAT_R8_UNORM:           return GS_R8;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:     return GS_RGBA;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:     return GS_BGRX;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:     return GS_BGRA;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:  return GS_R10G10B10A2;
+	case DXGI_FORMAT_R16G16B16A16_UNORM: return GS_RGBA16;
+	case DXGI_FORMAT_R16_UNORM:          return GS_R16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return GS_RGBA16F;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return GS_RGBA32F;
+	case DXGI_FORMAT_R16G16_FLOAT:       return GS_RG16F;
+	case DXGI_FORMAT_R32G32_FLOAT:       return GS_RG32F;
+	case DXGI_FORMAT_R16_FLOAT:          return GS_R16F;
+	case DXGI_FORMAT_R32_FLOAT:          return GS_R32F;
+	case DXGI_FORMAT_BC1_UNORM:          return GS_DXT1;
+	case DXGI_FORMAT_BC2_UNORM:          return GS_DXT3;
+	case DXGI_FORMAT_BC3_UNORM:          return GS_DXT5;
+	case DXGI_FORMAT_R8G8_UNORM:         return GS_R8G8;
+	}
+
+	return GS_UNKNOWN;
+}
+
 static inline DXGI_FORMAT ConvertGSZStencilFormat(gs_zstencil_format format)
 {
 	switch (format) {
@@ -190,6 +219,9 @@ struct gs_vertex_buffer {
 
 	void FlushBuffer(ID3D11Buffer *buffer, void *array,
 			size_t elementSize);
+	void FlushBufferRange(ID3D11Buffer *buffer, void *array,
+			size_t elementSize, size_t start, size_t num,
+			bool discard);
 
 	void MakeBufferList(gs_vertex_shader *shader,
 			vector<ID3D11Buffer*> &buffers,
@@ -319,11 +351,43 @@ struct gs_stage_surface {
 	uint32_t        width, height;
 	gs_color_format format;
 	DXGI_FORMAT     dxgiFormat;
+	uint32_t        pitch;
 
 	gs_stage_surface(gs_device_t *device, uint32_t width, uint32_t height,
 			gs_color_format colorFormat);
 };
 
+struct gs_timer {
+	ComPtr<ID3D11Query> queryBegin;
+	ComPtr<ID3D11Query> queryEnd;
+
+	gs_device           *device;
+
+	gs_timer(gs_device_t *device);
+};
+
+struct gs_timer_range {
+	ComPtr<ID3D11Query> queryDisjoint;
+
+	gs_device           *device;
+
+	gs_timer_range(gs_device_t *device);
+};
+
+struct gs_command_list {
+	ComPtr<ID3D11CommandList> list;
+};
+
+struct gs_duplicator {
+	ComPtr<IDXGIOutputDuplication> duplicator;
+	gs_texture_2d                  *texture;
+	gs_device                      *device;
+	vector<uint8_t>                metadata;
+
+	gs_duplicator(gs_device_t *device, int monitor_idx);
+	~gs_duplicator();
+};
+
 struct gs_sampler_state {
 	ComPtr<ID3D11SamplerState> state;
 	gs_device_t                *device;
@@ -367,13 +431,15 @@ struct gs_shader {
 	ComPtr<ID3D11Buffer> constants;
 	size_t               constantSize;
 
-	inline void UpdateParam(vector<uint8_t> &constData,
-			gs_shader_param &param, bool &upload);
+	/* current contents of the constant buffer */
+	vector<uint8_t>      constData;
+
+	inline void UpdateParam(gs_shader_param &param, bool &upload);
 	void UploadParams();
 
 	void BuildConstantBuffer();
 	void Compile(const char *shaderStr, const char *file,
-			const char *target, ID3D10Blob **shader);
+			const char *target, vector<uint8_t> &bytecode);
 
 	inline gs_shader(gs_device_t *device, gs_shader_type type)
 		: device       (device),
@@ -450,19 +516,33 @@ struct gs_swap_chain {
 	gs_zstencil_buffer             zs;
 	ComPtr<IDXGISwapChain>         swap;
 
+	/* flip model swap chains only, signaled when the swap chain can
+	 * take another frame without Present blocking */
+	UINT                           swapFlags;
+	HANDLE                         waitable;
+
 	void InitTarget(uint32_t cx, uint32_t cy);
 	void InitZStencilBuffer(uint32_t cx, uint32_t cy);
+	bool InitWaitable();
 	void Resize(uint32_t cx, uint32_t cy);
 	void Init(const gs_init_data *data);
 
 	inline gs_swap_chain()
 		: device     (NULL),
 		  numBuffers (0),
-		  hwnd       (NULL)
+		  hwnd       (NULL),
+		  swapFlags  (0),
+		  waitable   (NULL)
 	{
 	}
 
 	gs_swap_chain(gs_device *device, const gs_init_data *data);
+
+	inline ~gs_swap_chain()
+	{
+		if (waitable)
+			CloseHandle(waitable);
+	}
 };
 
 struct BlendState {
@@ -584,6 +664,11 @@ struct gs_device {
 	ComPtr<ID3D11DeviceContext> context;
 	gs_swap_chain               defaultSwap;
 
+	/* while recording a command list, context is the deferred context and
+	 * the immediate context is kept here */
+	ComPtr<ID3D11DeviceContext> deferredContext;
+	ComPtr<ID3D11DeviceContext> immediateContext;
+
 	gs_texture_2d               *curRenderTarget;
 	gs_zstencil_buffer          *curZStencilBuffer;
 	int                         curRenderSide;
@@ -610,6 +695,7 @@ struct gs_device {
 	D3D11_PRIMITIVE_TOPOLOGY    curToplogy;
 
 	pD3DCompile                 d3dCompile;
+	int                         d3dCompilerVer;
 
 	gs_rect                     viewport;
 
@@ -637,5 +723,7 @@ struct gs_device {
 
 	void UpdateViewProjMatrix();
 
+	void ResetStateCache();
+
 	gs_device(const gs_init_data *data);
 };
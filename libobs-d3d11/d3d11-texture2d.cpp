@@ -76,6 +76,9 @@ void gs_texture_2d::InitTexture(const uint8_t **data)
 	if (isGDICompatible)
 		td.MiscFlags |= D3D11_RESOURCE_MISC_GDI_COMPATIBLE;
 
+	if (isShared)
+		td.MiscFlags |= D3D11_RESOURCE_MISC_SHARED;
+
 	if (data)
 		InitSRD(srd, data);
 
@@ -90,6 +93,23 @@ void gs_texture_2d::InitTexture(const uint8_t **data)
 		if (FAILED(hr))
 			throw HRError("Failed to create GDI surface", hr);
 	}
+
+	if (isShared) {
+		ComPtr<IDXGIResource> dxgiRes;
+		HANDLE handle;
+
+		hr = texture->QueryInterface(__uuidof(IDXGIResource),
+				(void**)dxgiRes.Assign());
+		if (FAILED(hr))
+			throw HRError("Failed to query DXGI resource", hr);
+
+		hr = dxgiRes->GetSharedHandle(&handle);
+		if (FAILED(hr))
+			throw HRError("Failed to get shared handle", hr);
+
+		/* shared resource handles are 32-bit even on 64-bit */
+		sharedHandle = (uint32_t)(uintptr_t)handle;
+	}
 }
 
 void gs_texture_2d::InitResourceView()
@@ -150,7 +170,7 @@ gs_texture_2d::gs_texture_2d(gs_device_t *device, uint32_t width,
 	  height          (height),
 	  dxgiFormat      (ConvertGSTextureFormat(format)),
 	  isGDICompatible (gdiCompatible),
-	  isShared        (shared),
+	  isShared        (shared || (flags & GS_SHARED_TEX) != 0),
 	  isDynamic       ((flags & GS_DYNAMIC) != 0),
 	  isRenderTarget  ((flags & GS_RENDER_TARGET) != 0),
 	  genMipmaps      ((flags & GS_BUILD_MIPMAPS) != 0)
@@ -162,31 +182,6 @@ gs_texture_2d::gs_texture_2d(gs_device_t *device, uint32_t width,
 		InitRenderTargets();
 }
 
-static inline gs_color_format ConvertDXGITextureFormat(DXGI_FORMAT format)
-{
-	switch (format) {
-	case DXGI_FORMAT_A8_UNORM:           return GS_A8;
-	case DXGI_FORMAT_R8_UNORM:           return GS_R8;
-	case DXGI_FORMAT_R8G8B8A8_UNORM:     return GS_RGBA;
-	case DXGI_FORMAT_B8G8R8X8_UNORM:     return GS_BGRX;
-	case DXGI_FORMAT_B8G8R8A8_UNORM:     return GS_BGRA;
-	case DXGI_FORMAT_R10G10B10A2_UNORM:  return GS_R10G10B10A2;
-	case DXGI_FORMAT_R16G16B16A16_UNORM: return GS_RGBA16;
-	case DXGI_FORMAT_R16_UNORM:          return GS_R16;
-	case DXGI_FORMAT_R16G16B16A16_FLOAT: return GS_RGBA16F;
-	case DXGI_FORMAT_R32G32B32A32_FLOAT: return GS_RGBA32F;
-	case DXGI_FORMAT_R16G16_FLOAT:       return GS_RG16F;
-	case DXGI_FORMAT_R32G32_FLOAT:       return GS_RG32F;
-	case DXGI_FORMAT_R16_FLOAT:          return GS_R16F;
-	case DXGI_FORMAT_R32_FLOAT:          return GS_R32F;
-	case DXGI_FORMAT_BC1_UNORM:          return GS_DXT1;
-	case DXGI_FORMAT_BC2_UNORM:          return GS_DXT3;
-	case DXGI_FORMAT_BC3_UNORM:          return GS_DXT5;
-	}
-
-	return GS_UNKNOWN;
-}
-
 gs_texture_2d::gs_texture_2d(gs_device_t *device, uint32_t handle)
 	: isRenderTarget  (false),
 	  isGDICompatible (false),
@@ -46,6 +46,25 @@ void gs_vertex_buffer::FlushBuffer(ID3D11Buffer *buffer, void *array,
 	device->context->Unmap(buffer, 0);
 }
 
+/* without discarding, the buffer is mapped with NO_OVERWRITE so that it
+ * doesn't wait on draws still using other parts of it */
+void gs_vertex_buffer::FlushBufferRange(ID3D11Buffer *buffer, void *array,
+		size_t elementSize, size_t start, size_t num, bool discard)
+{
+	D3D11_MAPPED_SUBRESOURCE msr;
+	D3D11_MAP type = discard ? D3D11_MAP_WRITE_DISCARD :
+		D3D11_MAP_WRITE_NO_OVERWRITE;
+	HRESULT hr;
+
+	if (FAILED(hr = device->context->Map(buffer, 0, type, 0, &msr)))
+		throw HRError("Failed to map buffer", hr);
+
+	memcpy((uint8_t*)msr.pData + start * elementSize,
+			(uint8_t*)array + start * elementSize,
+			num * elementSize);
+	device->context->Unmap(buffer, 0);
+}
+
 void gs_vertex_buffer::MakeBufferList(gs_vertex_shader *shader,
 		vector<ID3D11Buffer*> &buffers, vector<uint32_t> &strides)
 {
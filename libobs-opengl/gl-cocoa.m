@@ -93,6 +93,11 @@ static NSOpenGLContext *gl_context_create(const struct gs_init_data *info)
 
 	[context setView:info->window.view];
 
+	/* displays are paced by libobs, so presenting never waits for vsync
+	 * and can't hold up the graphics thread */
+	GLint interval = 0;
+	[context setValues:&interval forParameter:NSOpenGLCPSwapInterval];
+
 	return context;
 }
 
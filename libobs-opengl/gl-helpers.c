@@ -148,6 +148,31 @@ bool gl_create_buffer(GLenum target, GLuint *buffer, GLsizeiptr size,
 	return success;
 }
 
+/* without discarding, the range is mapped unsynchronized so that it doesn't
+ * wait on draws still using other parts of the buffer */
+bool update_buffer_range(GLenum target, GLuint buffer, const void *data,
+		size_t offset, size_t size, bool discard)
+{
+	GLbitfield access = GL_MAP_WRITE_BIT | (discard ?
+			GL_MAP_INVALIDATE_BUFFER_BIT :
+			GL_MAP_UNSYNCHRONIZED_BIT);
+	void *ptr;
+	bool success = true;
+
+	if (!gl_bind_buffer(target, buffer))
+		return false;
+
+	ptr = glMapBufferRange(target, offset, size, access);
+	success = gl_success("glMapBufferRange");
+	if (success && ptr) {
+		memcpy(ptr, data, size);
+		glUnmapBuffer(target);
+	}
+
+	gl_bind_buffer(target, 0);
+	return success;
+}
+
 bool update_buffer(GLenum target, GLuint buffer, void *data, size_t size)
 {
 	void *ptr;
@@ -443,11 +443,25 @@ static inline bool validate_param(struct program_param *pp,
 	return true;
 }
 
+static inline bool param_uploaded(struct program_param *pp)
+{
+	return pp->uploaded.num == pp->param->cur_value.num &&
+		memcmp(pp->uploaded.array, pp->param->cur_value.array,
+				pp->uploaded.num) == 0;
+}
+
 static void program_set_param_data(struct gs_program *program,
 		struct program_param *pp)
 {
 	void *array = pp->param->cur_value.array;
 
+	if (pp->param->type != GS_SHADER_PARAM_TEXTURE) {
+		if (param_uploaded(pp))
+			return;
+
+		da_copy(pp->uploaded, pp->param->cur_value);
+	}
+
 	if (pp->param->type == GS_SHADER_PARAM_BOOL ||
 	    pp->param->type == GS_SHADER_PARAM_INT) {
 		if (validate_param(pp, sizeof(int))) {
@@ -565,6 +579,7 @@ static bool assign_program_param(struct gs_program *program,
 	}
 
 	info.param = param;
+	da_init(info.uploaded);
 	da_push_back(program->params, &info);
 	return true;
 }
@@ -668,6 +683,9 @@ void gs_program_destroy(struct gs_program *program)
 		gl_success("glUseProgram (zero)");
 	}
 
+	for (size_t i = 0; i < program->params.num; i++)
+		da_free(program->params.array[i].uploaded);
+
 	da_free(program->attribs);
 	da_free(program->params);
 
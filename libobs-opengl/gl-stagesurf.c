@@ -32,9 +32,27 @@ static bool create_pixel_pack_buffer(struct gs_stage_surface *surf)
 	size  = (size+3) & 0xFFFFFFFC; /* align width to 4-byte boundry */
 	size *= surf->height;
 
-	glBufferData(GL_PIXEL_PACK_BUFFER, size, 0, GL_DYNAMIC_READ);
-	if (!gl_success("glBufferData"))
-		success = false;
+	if (GLAD_GL_ARB_buffer_storage) {
+		/* map once for the lifetime of the surface rather than mapping
+		 * and unmapping for every frame read back */
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT |
+			GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags);
+		if (!gl_success("glBufferStorage"))
+			success = false;
+
+		if (success) {
+			surf->mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+					0, size, flags);
+			if (!gl_success("glMapBufferRange") || !surf->mapped)
+				success = false;
+		}
+	} else {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, 0, GL_DYNAMIC_READ);
+		if (!gl_success("glBufferData"))
+			success = false;
+	}
 
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0))
 		success = false;
@@ -65,9 +83,26 @@ gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
 	return surf;
 }
 
+static inline void delete_fence(struct gs_stage_surface *surf)
+{
+	if (surf->fence) {
+		glDeleteSync(surf->fence);
+		surf->fence = NULL;
+	}
+}
+
+static inline void insert_fence(struct gs_stage_surface *surf)
+{
+	delete_fence(surf);
+
+	surf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	gl_success("glFenceSync");
+}
+
 void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 {
 	if (stagesurf) {
+		delete_fence(stagesurf);
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
 
@@ -141,6 +176,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	insert_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -172,6 +208,8 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	insert_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -202,9 +240,51 @@ enum gs_color_format gs_stagesurface_get_color_format(
 	return stagesurf->format;
 }
 
+/* rows are packed with the default GL_PACK_ALIGNMENT of 4 */
+static inline uint32_t get_pitch(const gs_stagesurf_t *stagesurf)
+{
+	return (stagesurf->bytes_per_pixel * stagesurf->width + 3) &
+		0xFFFFFFFC;
+}
+
+uint32_t gs_stagesurface_get_pitch(const gs_stagesurf_t *stagesurf)
+{
+	return get_pitch(stagesurf);
+}
+
+/* returns false if the last copy is still in progress after timeout ns */
+static bool wait_for_copy(struct gs_stage_surface *surf, GLuint64 timeout)
+{
+	GLenum result;
+
+	if (!surf->fence)
+		return true;
+
+	/* flush so the fence is guaranteed to signal eventually */
+	result = glClientWaitSync(surf->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+			timeout);
+	if (result == GL_TIMEOUT_EXPIRED)
+		return false;
+	if (result == GL_WAIT_FAILED)
+		gl_success("glClientWaitSync");
+
+	delete_fence(surf);
+	return true;
+}
+
 bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize)
 {
+	if (stagesurf->mapped) {
+		/* nothing implicitly waits for the copy with a persistent
+		 * mapping, so wait on its fence */
+		while (!wait_for_copy(stagesurf, 1000000000ULL));
+
+		*data     = stagesurf->mapped;
+		*linesize = get_pitch(stagesurf);
+		return true;
+	}
+
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
 		goto fail;
 
@@ -214,7 +294,7 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 
-	*linesize = stagesurf->bytes_per_pixel * stagesurf->width;
+	*linesize = get_pitch(stagesurf);
 	return true;
 
 fail:
@@ -222,8 +302,20 @@ fail:
 	return false;
 }
 
+bool gs_stagesurface_try_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	if (!wait_for_copy(stagesurf, 0))
+		return false;
+
+	return gs_stagesurface_map(stagesurf, data, linesize);
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
+	if (stagesurf->mapped)
+		return;
+
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
 		return;
 
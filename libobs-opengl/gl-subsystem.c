@@ -145,12 +145,65 @@ static bool gl_init_extensions(struct gs_device* device)
 	return true;
 }
 
+/* the defaults of a new context, except the viewport and scissor rect which
+ * depend on the window and are left invalid so that they're always set */
+static void gl_init_state(struct gs_device *device)
+{
+	struct gl_state *state = &device->state;
+
+	state->active_texture = GL_TEXTURE0;
+	state->stencil_mask   = 0xFFFFFFFF;
+	state->blend_src      = GL_ONE;
+	state->blend_dst      = GL_ZERO;
+	state->depth_func     = GL_LESS;
+
+	for (size_t i = 0; i < 4; i++) {
+		state->color_mask[i] = true;
+		state->viewport[i]   = -1;
+		state->scissor[i]    = -1;
+	}
+}
+
+/* returns true (and counts it) if a state change can be skipped */
+static inline bool state_unchanged(struct gs_device *device, bool unchanged)
+{
+	if (unchanged)
+		device->redundant_state_changes++;
+	return unchanged;
+}
+
+static bool set_active_texture(struct gs_device *device, GLenum texture_id)
+{
+	if (state_unchanged(device,
+				device->state.active_texture == texture_id))
+		return true;
+
+	if (!gl_active_texture(texture_id))
+		return false;
+
+	device->state.active_texture = texture_id;
+	return true;
+}
+
+static bool set_capability(struct gs_device *device, bool *cur, GLenum cap,
+		bool enable)
+{
+	if (state_unchanged(device, *cur == enable))
+		return true;
+
+	if (!(enable ? gl_enable(cap) : gl_disable(cap)))
+		return false;
+
+	*cur = enable;
+	return true;
+}
+
 static void clear_textures(struct gs_device *device)
 {
 	GLenum i;
 	for (i = 0; i < GS_MAX_TEXTURES; i++) {
 		if (device->cur_textures[i]) {
-			gl_active_texture(GL_TEXTURE0 + i);
+			set_active_texture(device, GL_TEXTURE0 + i);
 			gl_bind_texture(device->cur_textures[i]->gl_target, 0);
 			device->cur_textures[i] = NULL;
 		}
@@ -217,6 +270,7 @@ int device_create(gs_device_t **p_device, const struct gs_init_data *info)
 	}
 	
 	gl_enable(GL_CULL_FACE);
+	gl_init_state(device);
 	
 	device_leave_context(device);
 	device->cur_swap = gl_platform_getswap(device->plat);
@@ -243,6 +297,11 @@ void device_destroy(gs_device_t *device)
 		while (device->first_program)
 			gs_program_destroy(device->first_program);
 
+		blog(LOG_DEBUG, "device_destroy (GL): skipped %llu redundant "
+		                "state changes",
+		                (unsigned long long)
+		                device->redundant_state_changes);
+
 		da_free(device->proj_stack);
 		da_free(device->fbos);
 		gl_platform_destroy(device->plat);
@@ -432,7 +491,7 @@ void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
 	if (cur_tex == tex)
 		return;
 
-	if (!gl_active_texture(GL_TEXTURE0 + unit))
+	if (!set_active_texture(device, GL_TEXTURE0 + unit))
 		goto fail;
 
 	/* the target for the previous text may not be the same as the
@@ -475,7 +534,8 @@ static bool load_sampler_on_textures(gs_device_t *device, gs_samplerstate_t *ss,
 		if (param->type == GS_SHADER_PARAM_TEXTURE &&
 		    param->sampler_id == (uint32_t)sampler_unit &&
 		    param->texture) {
-			if (!gl_active_texture(GL_TEXTURE0 + param->texture_id))
+			if (!set_active_texture(device,
+						GL_TEXTURE0 + param->texture_id))
 				return false;
 			if (!load_texture_sampler(param->texture, ss))
 				return false;
@@ -932,12 +992,7 @@ void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
 
 	load_vb_buffers(program, device->cur_vertex_buffer);
 
-	if (program != device->cur_program && device->cur_program) {
-		glUseProgram(0);
-		gl_success("glUseProgram (zero)");
-	}
-
-	if (program != device->cur_program) {
+	if (!state_unchanged(device, program == device->cur_program)) {
 		device->cur_program = program;
 
 		glUseProgram(program->obj);
@@ -1036,50 +1091,46 @@ enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
 
 void device_enable_blending(gs_device_t *device, bool enable)
 {
-	if (enable)
-		gl_enable(GL_BLEND);
-	else
-		gl_disable(GL_BLEND);
-
-	UNUSED_PARAMETER(device);
+	set_capability(device, &device->state.blend, GL_BLEND, enable);
 }
 
 void device_enable_depth_test(gs_device_t *device, bool enable)
 {
-	if (enable)
-		gl_enable(GL_DEPTH_TEST);
-	else
-		gl_disable(GL_DEPTH_TEST);
-
-	UNUSED_PARAMETER(device);
+	set_capability(device, &device->state.depth_test, GL_DEPTH_TEST,
+			enable);
 }
 
 void device_enable_stencil_test(gs_device_t *device, bool enable)
 {
-	if (enable)
-		gl_enable(GL_STENCIL_TEST);
-	else
-		gl_disable(GL_STENCIL_TEST);
-
-	UNUSED_PARAMETER(device);
+	set_capability(device, &device->state.stencil_test, GL_STENCIL_TEST,
+			enable);
 }
 
 void device_enable_stencil_write(gs_device_t *device, bool enable)
 {
-	if (enable)
-		glStencilMask(0xFFFFFFFF);
-	else
-		glStencilMask(0);
+	GLuint mask = enable ? 0xFFFFFFFF : 0;
 
-	UNUSED_PARAMETER(device);
+	if (state_unchanged(device, device->state.stencil_mask == mask))
+		return;
+
+	glStencilMask(mask);
+	device->state.stencil_mask = mask;
 }
 
 void device_enable_color(gs_device_t *device, bool red, bool green,
 		bool blue, bool alpha)
 {
-	glColorMask(red, green, blue, alpha);
+	bool *mask = device->state.color_mask;
 
-	UNUSED_PARAMETER(device);
+	if (state_unchanged(device, mask[0] == red && mask[1] == green &&
+				mask[2] == blue && mask[3] == alpha))
+		return;
+
+	glColorMask(red, green, blue, alpha);
+	mask[0] = red;
+	mask[1] = green;
+	mask[2] = blue;
+	mask[3] = alpha;
 }
 
 void device_blend_function(gs_device_t *device, enum gs_blend_type src,
@@ -1088,22 +1139,34 @@ void device_blend_function(gs_device_t *device, enum gs_blend_type src,
 	GLenum gl_src = convert_gs_blend_type(src);
 	GLenum gl_dst = convert_gs_blend_type(dest);
 
+	if (state_unchanged(device, device->state.blend_src == gl_src &&
+				device->state.blend_dst == gl_dst))
+		return;
+
 	glBlendFunc(gl_src, gl_dst);
-	if (!gl_success("glBlendFunc"))
+	if (!gl_success("glBlendFunc")) {
 		blog(LOG_ERROR, "device_blend_function (GL) failed");
+		return;
+	}
 
-	UNUSED_PARAMETER(device);
+	device->state.blend_src = gl_src;
+	device->state.blend_dst = gl_dst;
 }
 
 void device_depth_function(gs_device_t *device, enum gs_depth_test test)
 {
 	GLenum gl_test = convert_gs_depth_test(test);
 
+	if (state_unchanged(device, device->state.depth_func == gl_test))
+		return;
+
 	glDepthFunc(gl_test);
-	if (!gl_success("glDepthFunc"))
+	if (!gl_success("glDepthFunc")) {
 		blog(LOG_ERROR, "device_depth_function (GL) failed");
+		return;
+	}
 
-	UNUSED_PARAMETER(device);
+	device->state.depth_func = gl_test;
 }
 
 void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
@@ -1159,9 +1222,19 @@ void device_set_viewport(gs_device_t *device, int x, int y, int width,
 		gl_getclientsize(device->cur_swap, &dw, &base_height);
 	}
 
-	glViewport(x, base_height - y - height, width, height);
-	if (!gl_success("glViewport"))
-		blog(LOG_ERROR, "device_set_viewport (GL) failed");
+	GLint gl_viewport[4] = {x, (GLint)base_height - y - height, width,
+		height};
+
+	if (!state_unchanged(device, memcmp(device->state.viewport,
+					gl_viewport, sizeof(gl_viewport)) == 0)) {
+		glViewport(gl_viewport[0], gl_viewport[1], gl_viewport[2],
+				gl_viewport[3]);
+		if (gl_success("glViewport"))
+			memcpy(device->state.viewport, gl_viewport,
+					sizeof(gl_viewport));
+		else
+			blog(LOG_ERROR, "device_set_viewport (GL) failed");
+	}
 
 	device->cur_viewport.x  = x;
 	device->cur_viewport.y  = y;
@@ -1176,17 +1249,30 @@ void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
 
 void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
 {
-	UNUSED_PARAMETER(device);
+	struct gl_state *state = &device->state;
 
 	if (rect != NULL) {
-		glScissor(rect->x, rect->y, rect->cx, rect->cy);
-		if (gl_success("glScissor") && gl_enable(GL_SCISSOR_TEST))
+		GLint scissor[4] = {rect->x, rect->y, rect->cx, rect->cy};
+
+		if (!state_unchanged(device, memcmp(state->scissor, scissor,
+						sizeof(scissor)) == 0)) {
+			glScissor(scissor[0], scissor[1], scissor[2],
+					scissor[3]);
+			if (!gl_success("glScissor"))
+				goto fail;
+			memcpy(state->scissor, scissor, sizeof(scissor));
+		}
+
+		if (set_capability(device, &state->scissor_test,
+					GL_SCISSOR_TEST, true))
 			return;
 
-	} else if (gl_disable(GL_SCISSOR_TEST)) {
+	} else if (set_capability(device, &state->scissor_test,
+				GL_SCISSOR_TEST, false)) {
 		return;
 	}
 
+fail:
 	blog(LOG_ERROR, "device_set_scissor_rect (GL) failed");
 }
 
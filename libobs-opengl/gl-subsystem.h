@@ -56,6 +56,7 @@ static inline GLint convert_gs_format(enum gs_color_format format)
 	case GS_DXT1:        return GL_RGB;
 	case GS_DXT3:        return GL_RGBA;
 	case GS_DXT5:        return GL_RGBA;
+	case GS_R8G8:        return GL_RG;
 	case GS_UNKNOWN:     return 0;
 	}
 
@@ -82,6 +83,7 @@ static inline GLint convert_gs_internal_format(enum gs_color_format format)
 	case GS_DXT1:        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
 	case GS_DXT3:        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
 	case GS_DXT5:        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case GS_R8G8:        return GL_RG8;
 	case GS_UNKNOWN:     return 0;
 	}
 
@@ -108,6 +110,7 @@ static inline GLenum get_gl_format_type(enum gs_color_format format)
 	case GS_DXT1:        return GL_UNSIGNED_BYTE;
 	case GS_DXT3:        return GL_UNSIGNED_BYTE;
 	case GS_DXT5:        return GL_UNSIGNED_BYTE;
+	case GS_R8G8:        return GL_UNSIGNED_BYTE;
 	case GS_UNKNOWN:     return 0;
 	}
 
@@ -342,6 +345,10 @@ struct gs_shader {
 struct program_param {
 	GLint                  obj;
 	struct gs_shader_param *param;
+
+	/* uniform values are kept by the program, so only values that differ
+	 * from the last ones uploaded to it need to be set again */
+	DARRAY(uint8_t)        uploaded;
 };
 
 struct gs_program {
@@ -437,6 +444,21 @@ struct gs_stage_surface {
 	GLint                gl_internal_format;
 	GLenum               gl_type;
 	GLuint               pack_buffer;
+
+	/* persistent mapping of pack_buffer, with ARB_buffer_storage */
+	uint8_t              *mapped;
+
+	/* signaled once the last copy to pack_buffer has completed */
+	GLsync               fence;
+};
+
+struct gs_timer {
+	gs_device_t          *device;
+	GLuint               queries[2];
+};
+
+struct gs_timer_range {
+	gs_device_t          *device;
 };
 
 struct gs_zstencil_buffer {
@@ -473,6 +495,23 @@ static inline void fbo_info_destroy(struct fbo_info *fbo)
 	}
 }
 
+/* shadow copy of the GL state set by the device, used to skip state changes
+ * that wouldn't change anything */
+struct gl_state {
+	GLenum               active_texture;
+	bool                 blend;
+	bool                 depth_test;
+	bool                 stencil_test;
+	bool                 scissor_test;
+	GLuint               stencil_mask;
+	bool                 color_mask[4];
+	GLenum               blend_src;
+	GLenum               blend_dst;
+	GLenum               depth_func;
+	GLint                viewport[4];
+	GLint                scissor[4];
+};
+
 struct gs_device {
 	struct gl_platform   *plat;
 	enum copy_type       copy_type;
@@ -494,6 +533,9 @@ struct gs_device {
 	enum gs_cull_mode    cur_cull_mode;
 	struct gs_rect       cur_viewport;
 
+	struct gl_state      state;
+	uint64_t             redundant_state_changes;
+
 	struct matrix4       cur_proj;
 	struct matrix4       cur_view;
 	struct matrix4       cur_viewproj;
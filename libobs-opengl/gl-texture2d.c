@@ -226,6 +226,86 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+static bool begin_region_upload(gs_texture_t *tex, uint32_t linesize,
+		const char *func)
+{
+	uint32_t pixel_size = gs_get_format_bpp(tex->format) / 8;
+
+	if (!is_texture_2d(tex, func))
+		return false;
+	if (!pixel_size || gs_is_compressed_format(tex->format) ||
+	    linesize % pixel_size != 0)
+		return false;
+
+	if (!gl_bind_texture(tex->gl_target, tex->texture))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / pixel_size);
+	return true;
+}
+
+static inline bool upload_region(gs_texture_t *tex, const uint8_t *pixels,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy)
+{
+	glTexSubImage2D(tex->gl_target, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type, pixels);
+	return gl_success("glTexSubImage2D");
+}
+
+static bool end_region_upload(gs_texture_t *tex, bool success,
+		const char *func)
+{
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	gl_bind_texture(tex->gl_target, 0);
+
+	if (!success)
+		blog(LOG_ERROR, "%s (GL) failed", func);
+	return success;
+}
+
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	const char *func = "gs_texture_set_image_region";
+	bool success;
+
+	if (!begin_region_upload(tex, linesize, func))
+		return false;
+
+	success = upload_region(tex, data, x, y, cx, cy);
+	return end_region_upload(tex, success, func);
+}
+
+bool gs_texture_set_image_regions(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, const struct gs_rect *rects,
+		size_t num_rects)
+{
+	const char *func = "gs_texture_set_image_regions";
+	uint32_t pixel_size;
+	bool success = true;
+
+	if (!begin_region_upload(tex, linesize, func))
+		return false;
+
+	pixel_size = gs_get_format_bpp(tex->format) / 8;
+
+	for (size_t i = 0; i < num_rects && success; i++) {
+		const struct gs_rect *rect = &rects[i];
+		const uint8_t *pixels = data +
+			(uint32_t)rect->y * linesize +
+			(uint32_t)rect->x * pixel_size;
+
+		success = upload_region(tex, pixels, rect->x, rect->y,
+				rect->cx, rect->cy);
+	}
+
+	return end_region_upload(tex, success, func);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
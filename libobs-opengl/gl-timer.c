@@ -0,0 +1,121 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "gl-subsystem.h"
+
+/*
+ * Timers use a pair of GL_TIMESTAMP queries rather than GL_TIME_ELAPSED so
+ * that they can be nested.  Timestamps are always in nanoseconds and don't
+ * have a notion of disjoint ranges, so ranges don't need any GL objects.
+ */
+
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	struct gs_timer *timer;
+
+	if (!GLAD_GL_VERSION_3_3 && !GLAD_GL_ARB_timer_query)
+		return NULL;
+
+	timer = bzalloc(sizeof(struct gs_timer));
+	timer->device = device;
+
+	glGenQueries(2, timer->queries);
+	if (!gl_success("glGenQueries")) {
+		bfree(timer);
+		return NULL;
+	}
+
+	return timer;
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	struct gs_timer_range *range;
+
+	if (!GLAD_GL_VERSION_3_3 && !GLAD_GL_ARB_timer_query)
+		return NULL;
+
+	range = bzalloc(sizeof(struct gs_timer_range));
+	range->device = device;
+	return range;
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	if (!timer)
+		return;
+
+	glDeleteQueries(2, timer->queries);
+	gl_success("glDeleteQueries");
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	glQueryCounter(timer->queries[0], GL_TIMESTAMP);
+	gl_success("glQueryCounter");
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	glQueryCounter(timer->queries[1], GL_TIMESTAMP);
+	gl_success("glQueryCounter");
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	GLint    available = 0;
+	GLuint64 begin, end;
+
+	glGetQueryObjectiv(timer->queries[1], GL_QUERY_RESULT_AVAILABLE,
+			&available);
+	if (!gl_success("glGetQueryObjectiv") || !available)
+		return false;
+
+	glGetQueryObjectui64v(timer->queries[0], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(timer->queries[1], GL_QUERY_RESULT, &end);
+	if (!gl_success("glGetQueryObjectui64v"))
+		return false;
+
+	*ticks = end - begin;
+	return true;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+		uint64_t *frequency)
+{
+	*disjoint  = false;
+	*frequency = 1000000000;
+
+	UNUSED_PARAMETER(range);
+	return true;
+}
@@ -170,6 +170,67 @@ failed:
 	blog(LOG_ERROR, "gs_vertexbuffer_flush (GL) failed");
 }
 
+void gs_vertexbuffer_flush_range(gs_vertbuffer_t *vb, size_t start,
+		size_t num, bool discard)
+{
+	size_t i;
+
+	if (!vb->dynamic) {
+		blog(LOG_ERROR, "vertex buffer is not dynamic");
+		goto failed;
+	}
+	if (!num || start + num > vb->data->num) {
+		blog(LOG_ERROR, "vertex range out of bounds");
+		goto failed;
+	}
+
+	if (!update_buffer_range(GL_ARRAY_BUFFER, vb->vertex_buffer,
+				vb->data->points + start,
+				start * sizeof(struct vec3),
+				num * sizeof(struct vec3), discard))
+		goto failed;
+
+	if (vb->normal_buffer) {
+		if (!update_buffer_range(GL_ARRAY_BUFFER, vb->normal_buffer,
+					vb->data->normals + start,
+					start * sizeof(struct vec3),
+					num * sizeof(struct vec3), discard))
+			goto failed;
+	}
+
+	if (vb->tangent_buffer) {
+		if (!update_buffer_range(GL_ARRAY_BUFFER, vb->tangent_buffer,
+					vb->data->tangents + start,
+					start * sizeof(struct vec3),
+					num * sizeof(struct vec3), discard))
+			goto failed;
+	}
+
+	if (vb->color_buffer) {
+		if (!update_buffer_range(GL_ARRAY_BUFFER, vb->color_buffer,
+					vb->data->colors + start,
+					start * sizeof(uint32_t),
+					num * sizeof(uint32_t), discard))
+			goto failed;
+	}
+
+	for (i = 0; i < vb->data->num_tex; i++) {
+		GLuint buffer = vb->uv_buffers.array[i];
+		struct gs_tvertarray *tv = vb->data->tvarray+i;
+		size_t stride = tv->width * sizeof(float);
+
+		if (!update_buffer_range(GL_ARRAY_BUFFER, buffer,
+					(uint8_t*)tv->array + start * stride,
+					start * stride, num * stride, discard))
+			goto failed;
+	}
+
+	return;
+
+failed:
+	blog(LOG_ERROR, "gs_vertexbuffer_flush_range (GL) failed");
+}
+
 struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
 {
 	return vb->data;
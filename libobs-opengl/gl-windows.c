@@ -27,6 +27,9 @@
 struct gl_windowinfo {
 	HWND hwnd;
 	HDC  hdc;
+
+	/* the swap interval is set once the window is first made current */
+	bool swap_interval_set;
 };
 
 /* Like the other subsystems, the GL subsystem has one swap chain created by
@@ -505,8 +508,18 @@ void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swap)
 	if (swap) {
 		hdc = swap->wi->hdc;
 
-		if (!wgl_make_current(hdc, device->plat->hrc))
+		if (!wgl_make_current(hdc, device->plat->hrc)) {
 			blog(LOG_ERROR, "device_load_swapchain (GL) failed");
+			return;
+		}
+
+		/* displays are paced by libobs, so presenting never waits
+		 * for vsync and can't hold up the graphics thread */
+		if (!swap->wi->swap_interval_set &&
+		    GLAD_WGL_EXT_swap_control) {
+			wglSwapIntervalEXT(0);
+			swap->wi->swap_interval_set = true;
+		}
 	}
 }
 
@@ -65,6 +65,9 @@ struct gl_windowinfo {
 
 	/* We can't fetch screen without a request so we cache it. */
 	int screen;
+
+	/* the swap interval is set once the window is first made current */
+	bool swap_interval_set;
 };
 
 struct gl_platform {
@@ -254,7 +257,7 @@ static void gl_context_destroy(struct gl_platform *plat)
 extern struct gl_windowinfo *gl_windowinfo_create(const struct gs_init_data *info)
 {
 	UNUSED_PARAMETER(info);
-	return bmalloc(sizeof(struct gl_windowinfo));
+	return bzalloc(sizeof(struct gl_windowinfo));
 }
 
 extern void gl_windowinfo_destroy(struct gl_windowinfo *info)
@@ -280,7 +283,9 @@ extern struct gl_platform *gl_platform_create(gs_device_t *device,
 		goto fail_wi_create;
 	}
 
-	display = XOpenDisplay(XDisplayString(info->window.display));
+	/* without a window (headless), the display comes from $DISPLAY */
+	display = XOpenDisplay(info->window.display ?
+			XDisplayString(info->window.display) : NULL);
 	if (!display) {
 		blog(LOG_ERROR, "Unable to open new X connection!");
 		goto fail_display_open;
@@ -354,10 +359,17 @@ extern bool gl_platform_init_swapchain(struct gs_swap_chain *swap)
 	xcb_connection_t *xcb_conn = XGetXCBConnection(display);
 	xcb_window_t wid = xcb_generate_id(xcb_conn);
 	xcb_window_t parent = swap->info.window.id;
-	xcb_get_geometry_reply_t *geometry =
-		get_window_geometry(xcb_conn, parent);
+	bool headless = !parent;
+	xcb_get_geometry_reply_t *geometry;
 	bool status = false;
 
+	/* headless: the context still needs a drawable, so an unmapped
+	 * window is created on the default screen */
+	if (headless)
+		parent = RootWindow(display, DefaultScreen(display));
+
+	geometry = get_window_geometry(xcb_conn, parent);
+
 	int screen_num;
 	int visual;
 	GLXFBConfig *fb_config;
@@ -442,7 +454,8 @@ extern bool gl_platform_init_swapchain(struct gs_swap_chain *swap)
 	swap->wi->config = fb_config[0];
 	swap->wi->window = wid;
 
-	xcb_map_window(xcb_conn, wid);
+	if (!headless)
+		xcb_map_window(xcb_conn, wid);
 
 	XFree(fb_config);
 	status = true;
@@ -531,6 +544,14 @@ extern void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swap)
 
 	if (!glXMakeCurrent(dpy, window, ctx)) {
 		blog(LOG_ERROR, "Failed to make context current.");
+		return;
+	}
+
+	/* displays are paced by libobs, so presenting never waits for
+	 * vsync and can't hold up the graphics thread */
+	if (!swap->wi->swap_interval_set && GLAD_GLX_EXT_swap_control) {
+		glXSwapIntervalEXT(dpy, window, 0);
+		swap->wi->swap_interval_set = true;
 	}
 }
 
@@ -63,15 +63,19 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 	return (size != 0) ? str : NULL;
 }
 
+/* the stored name sizes are compared before the names themselves, so only
+ * parameters with names of the same length are ever compared */
 static bool cd_getparam(const calldata_t *data, const char *name,
 		uint8_t **pos)
 {
 	size_t name_size;
+	size_t find_size;
 
 	if (!data->size)
 		return false;
 
 	*pos = data->stack;
+	find_size = strlen(name)+1;
 
 	name_size = cd_serialize_size(pos);
 	while (name_size != 0) {
@@ -79,7 +83,8 @@ static bool cd_getparam(const calldata_t *data, const char *name,
 		size_t param_size;
 
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == find_size &&
+		    memcmp(param_name, name, name_size) == 0)
 			return true;
 
 		param_size = cd_serialize_size(pos);
@@ -151,7 +156,17 @@ static inline void cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 	if (new_capacity < new_size)
 		new_capacity = new_size;
 
-	data->stack    = brealloc(data->stack, new_capacity);
+	/* outgrew a fixed stack, continue with an allocated copy */
+	if (data->fixed) {
+		uint8_t *stack = bmalloc(new_capacity);
+		memcpy(stack, data->stack, data->size);
+
+		data->stack = stack;
+		data->fixed = false;
+	} else {
+		data->stack = brealloc(data->stack, new_capacity);
+	}
+
 	data->capacity = new_capacity;
 
 	*pos = data->stack + offset;
@@ -47,18 +47,39 @@ struct calldata {
 	size_t  size;     /* size of the stack, in bytes */
 	size_t  capacity; /* capacity of the stack, in bytes */
 	uint8_t *stack;
+	bool    fixed;    /* stack is not owned by the calldata */
 };
 
 typedef struct calldata calldata_t;
 
+/* size of the stack buffers used with calldata_init_fixed for signals */
+#define CALLDATA_FIXED_SIZE 256
+
 static inline void calldata_init(struct calldata *data)
 {
 	memset(data, 0, sizeof(struct calldata));
 }
 
+/*
+ * Initializes calldata with a caller-provided stack (typically a local
+ * array), so setting parameters doesn't allocate.  If the parameters outgrow
+ * it, the data is moved to an allocated stack, so calldata_free must still be
+ * called.
+ */
+static inline void calldata_init_fixed(struct calldata *data, uint8_t *stack,
+		size_t size)
+{
+	data->size     = sizeof(size_t);
+	data->capacity = size;
+	data->stack    = stack;
+	data->fixed    = true;
+	*(size_t*)stack = 0;
+}
+
 static inline void calldata_free(struct calldata *data)
 {
-	bfree(data->stack);
+	if (!data->fixed)
+		bfree(data->stack);
 }
 
 EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
@@ -66,6 +87,8 @@ EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
 EXPORT void calldata_set_data(calldata_t *data, const char *name,
 		const void *in, size_t new_size);
 
+/* removes all parameters but keeps the stack, so one calldata can be reused
+ * for every emission of a signal without allocating */
 static inline void calldata_clear(struct calldata *data)
 {
 	if (data->stack) {
@@ -15,6 +15,7 @@
  */
 
 #include "../util/darray.h"
+#include "../util/hash-map.h"
 
 #include "decl.h"
 #include "proc.h"
@@ -31,14 +32,17 @@ static inline void proc_info_free(struct proc_info *pi)
 }
 
 struct proc_handler {
-	/* TODO: replace with hash table lookup? */
 	DARRAY(struct proc_info) procs;
+
+	/* proc name -> index in procs + 1 */
+	struct hash_map          lookup;
 };
 
 proc_handler_t *proc_handler_create(void)
 {
 	struct proc_handler *handler = bmalloc(sizeof(struct proc_handler));
 	da_init(handler->procs);
+	hash_map_init(&handler->lookup);
 	return handler;
 }
 
@@ -48,6 +52,7 @@ void proc_handler_destroy(proc_handler_t *handler)
 		for (size_t i = 0; i < handler->procs.num; i++)
 			proc_info_free(handler->procs.array+i);
 		da_free(handler->procs);
+		hash_map_free(&handler->lookup);
 		bfree(handler);
 	}
 }
@@ -70,21 +75,26 @@ void proc_handler_add(proc_handler_t *handler, const char *decl_string,
 	pi.data     = data;
 
 	da_push_back(handler->procs, &pi);
+
+	/* the first proc added with a name is the one that's called */
+	if (!hash_map_find(&handler->lookup, pi.func.name))
+		hash_map_set(&handler->lookup, pi.func.name,
+				(void*)(uintptr_t)handler->procs.num);
 }
 
 bool proc_handler_call(proc_handler_t *handler, const char *name,
 		calldata_t *params)
 {
-	if (!handler) return false;
+	struct proc_info *info;
+	size_t idx;
 
-	for (size_t i = 0; i < handler->procs.num; i++) {
-		struct proc_info *info = handler->procs.array+i;
+	if (!handler) return false;
 
-		if (strcmp(info->func.name, name) == 0) {
-			info->callback(info->data, params);
-			return true;
-		}
-	}
+	idx = (size_t)(uintptr_t)hash_map_find(&handler->lookup, name);
+	if (!idx)
+		return false;
 
-	return false;
+	info = handler->procs.array + idx - 1;
+	info->callback(info->data, params);
+	return true;
 }
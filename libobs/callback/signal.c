@@ -26,15 +26,38 @@ struct signal_callback {
 	bool              remove;
 };
 
+/*
+ * Signals are never removed from a handler until it's destroyed, and are only
+ * linked in to the list once they're fully initialized, so they can be looked
+ * up without locking.  Callbacks are still called with the signal's mutex
+ * held so that once signal_handler_disconnect returns the callback will never
+ * be called again, but signalling without any callbacks never takes a lock.
+ */
 struct signal_info {
 	struct decl_info               func;
+	uint32_t                       hash;
 	DARRAY(struct signal_callback) callbacks;
 	pthread_mutex_t                mutex;
 	bool                           signalling;
 
-	struct signal_info             *next;
+	/* callbacks not marked for removal */
+	volatile long                  num_callbacks;
+
+	struct signal_info             *volatile next;
 };
 
+static inline uint32_t signal_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
 	pthread_mutexattr_t attr;
@@ -47,9 +70,11 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 
 	si = bmalloc(sizeof(struct signal_info));
 
-	si->func       = *info;
-	si->next       = NULL;
-	si->signalling = false;
+	si->func          = *info;
+	si->hash          = signal_hash(info->name);
+	si->next          = NULL;
+	si->signalling    = false;
+	si->num_callbacks = 0;
 	da_init(si->callbacks);
 
 	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
@@ -87,18 +112,22 @@ static inline size_t signal_get_callback_idx(struct signal_info *si,
 }
 
 struct signal_handler {
-	struct signal_info *first;
-	pthread_mutex_t    mutex;
+	struct signal_info *volatile first;
+	volatile long                published;
+
+	/* only needed for adding signals */
+	pthread_mutex_t              mutex;
 };
 
 static struct signal_info *getsignal(signal_handler_t *handler,
 		const char *name, struct signal_info **p_last)
 {
 	struct signal_info *signal, *last= NULL;
+	uint32_t hash = signal_hash(name);
 
 	signal = handler->first;
 	while (signal != NULL) {
-		if (strcmp(signal->func.name, name) == 0)
+		if (signal->hash == hash && strcmp(signal->func.name, name) == 0)
 			break;
 
 		last = signal;
@@ -115,7 +144,8 @@ static struct signal_info *getsignal(signal_handler_t *handler,
 signal_handler_t *signal_handler_create(void)
 {
 	struct signal_handler *handler = bmalloc(sizeof(struct signal_handler));
-	handler->first = NULL;
+	handler->first     = NULL;
+	handler->published = 0;
 
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Couldn't create signal handler!");
@@ -161,7 +191,14 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 		success = false;
 	} else {
 		sig = signal_info_create(&func);
-		if (!last)
+
+		/* full barrier, the signal must be visible to lookups without
+		 * the lock before it's linked in */
+		os_atomic_inc_long(&handler->published);
+
+		if (!sig)
+			success = false;
+		else if (!last)
 			handler->first = sig;
 		else
 			last->next = sig;
@@ -182,10 +219,7 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
 	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
 	if (!sig) {
 		blog(LOG_WARNING, "signal_handler_connect: "
 		                  "signal '%s' not found", signal);
@@ -197,31 +231,29 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 	pthread_mutex_lock(&sig->mutex);
 
 	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx == DARRAY_INVALID)
+	if (idx == DARRAY_INVALID) {
 		da_push_back(sig->callbacks, &cb_data);
-	
+		os_atomic_inc_long(&sig->num_callbacks);
+
+	} else if (sig->callbacks.array[idx].remove) {
+		/* reconnected while signalling */
+		sig->callbacks.array[idx].remove = false;
+		os_atomic_inc_long(&sig->num_callbacks);
+	}
+
 	pthread_mutex_unlock(&sig->mutex);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-		const char *name)
+static inline struct signal_info *getsignal_unlocked(
+		signal_handler_t *handler, const char *name)
 {
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
+	return handler ? getsignal(handler, name, NULL) : NULL;
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_info *sig = getsignal_unlocked(handler, signal);
 	size_t idx;
 
 	if (!sig)
@@ -230,22 +262,24 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 	pthread_mutex_lock(&sig->mutex);
 
 	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
+	if (idx != DARRAY_INVALID && !sig->callbacks.array[idx].remove) {
 		if (sig->signalling)
 			sig->callbacks.array[idx].remove = true;
 		else
 			da_erase(sig->callbacks, idx);
+
+		os_atomic_dec_long(&sig->num_callbacks);
 	}
-	
+
 	pthread_mutex_unlock(&sig->mutex);
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_info *sig = getsignal_unlocked(handler, signal);
 
-	if (!sig)
+	if (!sig || !os_atomic_load_long(&sig->num_callbacks))
 		return;
 
 	pthread_mutex_lock(&sig->mutex);
@@ -253,7 +287,8 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 
 	for (size_t i = 0; i < sig->callbacks.num; i++) {
 		struct signal_callback *cb = sig->callbacks.array+i;
-		cb->callback(cb->data, params);
+		if (!cb->remove)
+			cb->callback(cb->data, params);
 	}
 
 	for (size_t i = sig->callbacks.num; i > 0; i--) {
@@ -87,37 +87,21 @@ void bounds_get_center(struct vec3 *dst, const struct bounds *b)
 void bounds_transform(struct bounds *dst, const struct bounds *b,
 		const struct matrix4 *m)
 {
+	struct vec3 points[8];
 	struct bounds temp;
-	bool b_init = false;
 	int i;
 
-	memset(&temp, 0, sizeof(temp));
-
-	for (i = 0; i < 8; i++) {
-		struct vec3 p;
-		bounds_get_point(&p, b, i);
-		vec3_transform(&p, &p, m);
+	for (i = 0; i < 8; i++)
+		bounds_get_point(&points[i], b, i);
 
-		if (!b_init) {
-			vec3_copy(&temp.min, &p);
-			vec3_copy(&temp.max, &p);
-			b_init = true;
-		} else {
-			if (p.x < temp.min.x)
-				temp.min.x = p.x;
-			else if (p.x > temp.max.x)
-				temp.max.x = p.x;
+	vec3_transform_array(points, points, 8, m);
 
-			if (p.y < temp.min.y)
-				temp.min.y = p.y;
-			else if (p.y > temp.max.y)
-				temp.max.y = p.y;
+	vec3_copy(&temp.min, &points[0]);
+	vec3_copy(&temp.max, &points[0]);
 
-			if (p.z < temp.min.z)
-				temp.min.z = p.z;
-			else if (p.z > temp.max.z)
-				temp.max.z = p.z;
-		}
+	for (i = 1; i < 8; i++) {
+		vec3_min(&temp.min, &temp.min, &points[i]);
+		vec3_max(&temp.max, &temp.max, &points[i]);
 	}
 
 	bounds_copy(dst, &temp);
@@ -52,6 +52,8 @@ EXPORT gs_zstencil_t *device_zstencil_create(gs_device_t *device,
 EXPORT gs_stagesurf_t *device_stagesurface_create(gs_device_t *device,
 		uint32_t width, uint32_t height,
 		enum gs_color_format color_format);
+EXPORT gs_timer_t *device_timer_create(gs_device_t *device);
+EXPORT gs_timer_range_t *device_timer_range_create(gs_device_t *device);
 EXPORT gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
 		const struct gs_sampler_info *info);
 EXPORT gs_shader_t *device_vertexshader_create(gs_device_t *device,
@@ -136,6 +138,10 @@ EXPORT void device_frustum(gs_device_t *device, float left, float right,
 		float top, float bottom, float znear, float zfar);
 EXPORT void device_projection_push(gs_device_t *device);
 EXPORT void device_projection_pop(gs_device_t *device);
+EXPORT bool device_command_list_begin(gs_device_t *device);
+EXPORT gs_cmdlist_t *device_command_list_end(gs_device_t *device);
+EXPORT void device_command_list_execute(gs_device_t *device,
+		gs_cmdlist_t *list);
 
 #ifdef __cplusplus
 }
@@ -919,11 +919,9 @@ static bool ep_compile(struct effect_parser *ep);
 
 extern const char *gs_preprocessor_name(void);
 
-bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
-              const char *effect_string, const char *file)
+static bool ep_parse_tokens(struct effect_parser *ep,
+		const char *effect_string, const char *file)
 {
-	bool success;
-
 	const char *graphics_preprocessor = gs_preprocessor_name();
 
 	if (graphics_preprocessor) {
@@ -937,7 +935,6 @@ bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
 		cf_preprocessor_add_def(&ep->cfp.pp, &def);
 	}
 
-	ep->effect = effect;
 	if (!cf_parser_parse(&ep->cfp, effect_string, file))
 		return false;
 
@@ -968,11 +965,67 @@ bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
 		}
 	}
 
-	success = !error_data_has_errors(&ep->cfp.error_list);
-	if (success)
-		success = ep_compile(ep);
+	return !error_data_has_errors(&ep->cfp.error_list);
+}
 
-	return success;
+bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
+              const char *effect_string, const char *file)
+{
+	ep->effect = effect;
+	if (!ep_parse_tokens(ep, effect_string, file))
+		return false;
+
+	return ep_compile(ep);
+}
+
+static void get_declared_names(struct effect_parser *ep,
+		struct hash_map *names)
+{
+	size_t i;
+
+	for (i = 0; i < ep->params.num; i++)
+		hash_map_set(names, ep->params.array[i].name, ep);
+	for (i = 0; i < ep->structs.num; i++)
+		hash_map_set(names, ep->structs.array[i].name, ep);
+	for (i = 0; i < ep->funcs.num; i++)
+		hash_map_set(names, ep->funcs.array[i].name, ep);
+	for (i = 0; i < ep->samplers.num; i++)
+		hash_map_set(names, ep->samplers.array[i].name, ep);
+}
+
+char *ep_prefix_names(struct effect_parser *ep, const char *effect_string,
+		const char *file, const char *prefix)
+{
+	struct hash_map names;
+	struct cf_token *first, *token;
+	struct dstr name = {0};
+	struct dstr text = {0};
+
+	if (!ep_parse_tokens(ep, effect_string, file))
+		return NULL;
+
+	hash_map_init(&names);
+	get_declared_names(ep, &names);
+
+	first = cf_preprocessor_get_tokens(&ep->cfp.pp);
+
+	for (token = first; token->type != CFTOKEN_NONE; token++) {
+		/* struct members can share names with declarations */
+		bool member = token > first &&
+			strref_cmp(&token[-1].str, ".") == 0;
+
+		if (token->type == CFTOKEN_NAME && !member) {
+			dstr_copy_strref(&name, &token->str);
+			if (hash_map_find(&names, name.array))
+				dstr_cat(&text, prefix);
+		}
+
+		dstr_cat_strref(&text, &token->str);
+	}
+
+	dstr_free(&name);
+	hash_map_free(&names);
+	return text.array ? text.array : bstrdup("");
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1295,6 +1348,10 @@ static void ep_compile_param(struct effect_parser *ep, size_t idx)
 	param->effect  = ep->effect;
 	da_move(param->default_val, param_in->default_val);
 
+	/* the first declaration wins, as with the old linear search */
+	if (!hash_map_find(&ep->effect->param_map, param->name))
+		hash_map_set(&ep->effect->param_map, param->name, param);
+
 	if (strcmp(param_in->type, "bool") == 0)
 		param->type = GS_SHADER_PARAM_BOOL;
 	else if (strcmp(param_in->type, "float") == 0)
@@ -1457,6 +1514,9 @@ static inline bool ep_compile_technique(struct effect_parser *ep, size_t idx)
 	tech->section = EFFECT_TECHNIQUE;
 	tech->effect = ep->effect;
 
+	if (!hash_map_find(&ep->effect->technique_map, tech->name))
+		hash_map_set(&ep->effect->technique_map, tech->name, tech);
+
 	da_resize(tech->passes, tech_in->passes.num);
 
 	for (i = 0; i < tech->passes.num; i++) {
@@ -278,6 +278,13 @@ extern void ep_free(struct effect_parser *ep);
 extern bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
                      const char *effect_string, const char *file);
 
+/* parses the effect without compiling it, and returns its text with every
+ * top-level name it declares (parameters, structs, functions and samplers)
+ * prefixed, so the text of several effects can be combined in to one */
+extern char *ep_prefix_names(struct effect_parser *ep,
+		const char *effect_string, const char *file,
+		const char *prefix);
+
 #ifdef __cplusplus
 }
 #endif
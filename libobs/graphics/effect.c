@@ -32,15 +32,9 @@ void gs_effect_destroy(gs_effect_t *effect)
 gs_technique_t *gs_effect_get_technique(const gs_effect_t *effect,
 		const char *name)
 {
-	if (!effect) return NULL;
-
-	for (size_t i = 0; i < effect->techniques.num; i++) {
-		struct gs_effect_technique *tech = effect->techniques.array+i;
-		if (strcmp(tech->name, name) == 0)
-			return tech;
-	}
+	if (!effect || !name) return NULL;
 
-	return NULL;
+	return hash_map_find(&effect->technique_map, name);
 }
 
 gs_technique_t *gs_effect_get_current_technique(const gs_effect_t *effect)
@@ -117,7 +111,7 @@ void gs_technique_end(gs_technique_t *tech)
 	for (i = 0; i < effect->params.num; i++) {
 		struct gs_effect_param *param = params+i;
 
-		da_free(param->cur_val);
+		da_clear(param->cur_val);
 		param->changed = false;
 	}
 }
@@ -261,18 +255,9 @@ gs_eparam_t *gs_effect_get_param_by_idx(const gs_effect_t *effect, size_t param)
 gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
 		const char *name)
 {
-	if (!effect) return NULL;
-
-	struct gs_effect_param *params = effect->params.array;
-
-	for (size_t i = 0; i < effect->params.num; i++) {
-		struct gs_effect_param *param = params+i;
+	if (!effect || !name) return NULL;
 
-		if (strcmp(param->name, name) == 0)
-			return param;
-	}
-
-	return NULL;
+	return hash_map_find(&effect->param_map, name);
 }
 
 gs_eparam_t *gs_effect_get_viewproj_matrix(const gs_effect_t *effect)
@@ -371,3 +356,16 @@ void gs_effect_set_default(gs_eparam_t *param)
 	effect_setval_inline(param, param->default_val.array,
 			param->default_val.num);
 }
+
+void gs_effect_copy_val(gs_eparam_t *dst, const gs_eparam_t *src)
+{
+	if (!dst || !src)
+		return;
+
+	if (src->cur_val.num)
+		effect_setval_inline(dst, src->cur_val.array,
+				src->cur_val.num);
+	else if (src->default_val.num)
+		effect_setval_inline(dst, src->default_val.array,
+				src->default_val.num);
+}
@@ -19,6 +19,7 @@
 
 #include "effect-parser.h"
 #include "graphics.h"
+#include "../util/hash-map.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -142,6 +143,10 @@ struct gs_effect {
 	DARRAY(struct gs_effect_param) params;
 	DARRAY(struct gs_effect_technique) techniques;
 
+	/* name lookups, filled in once the arrays above are final */
+	struct hash_map param_map;
+	struct hash_map technique_map;
+
 	struct gs_effect_technique *cur_technique;
 	struct gs_effect_pass *cur_pass;
 
@@ -167,6 +172,8 @@ static inline void effect_free(gs_effect_t *effect)
 
 	da_free(effect->params);
 	da_free(effect->techniques);
+	hash_map_free(&effect->param_map);
+	hash_map_free(&effect->technique_map);
 
 	bfree(effect->effect_path);
 	bfree(effect->effect_dir);
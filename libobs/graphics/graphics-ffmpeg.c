@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include "../util/darray.h"
 
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -96,12 +97,13 @@ fail:
 static bool ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		AVFrame *frame, uint8_t *out, int linesize)
 {
-	struct SwsContext *sws_ctx = NULL;
-	int               ret      = 0;
+	struct SwsContext  *sws_ctx = NULL;
+	int                ret      = 0;
+	enum AVPixelFormat format   = (enum AVPixelFormat)frame->format;
 
-	if (info->format == AV_PIX_FMT_RGBA ||
-	    info->format == AV_PIX_FMT_BGRA ||
-	    info->format == AV_PIX_FMT_BGR0) {
+	if (format == AV_PIX_FMT_RGBA ||
+	    format == AV_PIX_FMT_BGRA ||
+	    format == AV_PIX_FMT_BGR0) {
 
 		if (linesize != frame->linesize[0]) {
 			int min_line = linesize < frame->linesize[0] ?
@@ -115,8 +117,10 @@ static bool ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 			memcpy(out, frame->data[0], linesize * info->cy);
 		}
 
+		info->format = format;
+
 	} else {
-		sws_ctx = sws_getContext(info->cx, info->cy, info->format,
+		sws_ctx = sws_getContext(info->cx, info->cy, format,
 				info->cx, info->cy, AV_PIX_FMT_BGRA,
 				SWS_POINT, NULL, NULL, NULL);
 		if (!sws_ctx) {
@@ -201,21 +205,126 @@ static inline enum gs_color_format convert_format(enum AVPixelFormat format)
 	return GS_BGRX;
 }
 
-gs_texture_t *gs_texture_create_from_file(const char *file)
+uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx, uint32_t *cy)
 {
 	struct ffmpeg_image image;
-	gs_texture_t           *tex = NULL;
+	uint8_t                *data = NULL;
 
 	if (ffmpeg_image_init(&image, file)) {
-		uint8_t *data = malloc(image.cx * image.cy * 4);
+		data = bmalloc(image.cx * image.cy * 4);
+
 		if (ffmpeg_image_decode(&image, data, image.cx * 4)) {
-			tex = gs_texture_create(image.cx, image.cy,
-					convert_format(image.format),
-					1, (const uint8_t**)&data, 0);
+			*format = convert_format(image.format);
+			*cx     = (uint32_t)image.cx;
+			*cy     = (uint32_t)image.cy;
+		} else {
+			bfree(data);
+			data = NULL;
 		}
 
 		ffmpeg_image_free(&image);
-		free(data);
+	}
+	return data;
+}
+
+gs_texture_t *gs_texture_create_from_file(const char *file)
+{
+	enum gs_color_format format;
+	uint32_t             cx;
+	uint32_t             cy;
+	uint8_t              *data = gs_create_texture_file_data(file, &format,
+			&cx, &cy);
+	gs_texture_t         *tex  = NULL;
+
+	if (data) {
+		tex = gs_texture_create(cx, cy, format, 1,
+				(const uint8_t**)&data, 0);
+		bfree(data);
 	}
 	return tex;
 }
+
+static bool ffmpeg_image_decode_all(struct ffmpeg_image *info,
+		struct gs_image_frames *frames, AVFrame *frame)
+{
+	AVRational ns_base    = {1, 1000000000};
+	size_t     frame_size = (size_t)info->cx * info->cy * 4;
+	DARRAY(uint8_t*) data;
+	DARRAY(uint64_t) durations;
+
+	da_init(data);
+	da_init(durations);
+
+	while ((data.num + 1) * frame_size <= GS_IMAGE_FRAMES_MAX_SIZE) {
+		AVPacket packet    = {0};
+		int      got_frame = 0;
+		int      ret;
+
+		if (av_read_frame(info->fmt_ctx, &packet) < 0)
+			break;
+
+		if (packet.stream_index == info->stream_idx) {
+			ret = avcodec_decode_video2(info->decoder_ctx, frame,
+					&got_frame, &packet);
+			if (ret < 0)
+				blog(LOG_WARNING, "Failed to decode frame for "
+				                  "'%s': %s", info->file,
+				                  av_err2str(ret));
+		}
+
+		if (got_frame) {
+			uint8_t *out = bmalloc(frame_size);
+			uint64_t duration = packet.duration > 0 ?
+				(uint64_t)av_rescale_q(packet.duration,
+						info->stream->time_base,
+						ns_base) : 0;
+
+			if (ffmpeg_image_reformat_frame(info, frame, out,
+						info->cx * 4)) {
+				da_push_back(data, &out);
+				da_push_back(durations, &duration);
+			} else {
+				bfree(out);
+			}
+		}
+
+		av_free_packet(&packet);
+	}
+
+	frames->num_frames   = data.num;
+	frames->data         = data.array;
+	frames->durations_ns = durations.array;
+	return data.num > 0;
+}
+
+bool gs_image_frames_init(struct gs_image_frames *frames, const char *file)
+{
+	struct ffmpeg_image image;
+	AVFrame             *frame;
+	bool                success = false;
+
+	memset(frames, 0, sizeof(*frames));
+
+	if (!ffmpeg_image_init(&image, file))
+		return false;
+
+	frame = av_frame_alloc();
+	if (frame) {
+		success = ffmpeg_image_decode_all(&image, frames, frame);
+		av_frame_free(&frame);
+	}
+
+	if (success) {
+		frames->format = convert_format(image.format);
+		frames->cx     = (uint32_t)image.cx;
+		frames->cy     = (uint32_t)image.cy;
+	} else {
+		gs_image_frames_free(frames);
+		blog(LOG_WARNING, "Failed to decode any frames from '%s'",
+				file);
+	}
+
+	ffmpeg_image_free(&image);
+	return success;
+}
@@ -57,6 +57,8 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(device_voltexture_create);
 	GRAPHICS_IMPORT(device_zstencil_create);
 	GRAPHICS_IMPORT(device_stagesurface_create);
+	GRAPHICS_IMPORT_OPTIONAL(device_timer_create);
+	GRAPHICS_IMPORT_OPTIONAL(device_timer_range_create);
 	GRAPHICS_IMPORT(device_samplerstate_create);
 	GRAPHICS_IMPORT(device_vertexshader_create);
 	GRAPHICS_IMPORT(device_pixelshader_create);
@@ -105,7 +107,13 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(device_projection_push);
 	GRAPHICS_IMPORT(device_projection_pop);
 
+	GRAPHICS_IMPORT_OPTIONAL(device_command_list_begin);
+	GRAPHICS_IMPORT_OPTIONAL(device_command_list_end);
+	GRAPHICS_IMPORT_OPTIONAL(device_command_list_execute);
+	GRAPHICS_IMPORT_OPTIONAL(gs_command_list_destroy);
+
 	GRAPHICS_IMPORT(gs_swapchain_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_swapchain_ready);
 
 	GRAPHICS_IMPORT(gs_texture_destroy);
 	GRAPHICS_IMPORT(gs_texture_get_width);
@@ -113,6 +121,8 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_texture_get_color_format);
 	GRAPHICS_IMPORT(gs_texture_map);
 	GRAPHICS_IMPORT(gs_texture_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_texture_set_image_region);
+	GRAPHICS_IMPORT_OPTIONAL(gs_texture_set_image_regions);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_is_rect);
 	GRAPHICS_IMPORT(gs_texture_get_obj);
 
@@ -131,7 +141,18 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_stagesurface_get_height);
 	GRAPHICS_IMPORT(gs_stagesurface_get_color_format);
 	GRAPHICS_IMPORT(gs_stagesurface_map);
+	GRAPHICS_IMPORT_OPTIONAL(gs_stagesurface_try_map);
 	GRAPHICS_IMPORT(gs_stagesurface_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_stagesurface_get_pitch);
+
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_begin);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_end);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_get_data);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_range_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_range_begin);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_range_end);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_range_get_data);
 
 	GRAPHICS_IMPORT(gs_zstencil_destroy);
 
@@ -139,6 +160,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 
 	GRAPHICS_IMPORT(gs_vertexbuffer_destroy);
 	GRAPHICS_IMPORT(gs_vertexbuffer_flush);
+	GRAPHICS_IMPORT_OPTIONAL(gs_vertexbuffer_flush_range);
 	GRAPHICS_IMPORT(gs_vertexbuffer_get_data);
 
 	GRAPHICS_IMPORT(gs_indexbuffer_destroy);
@@ -179,6 +201,12 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_get_dc);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_release_dc);
 	GRAPHICS_IMPORT_OPTIONAL(device_texture_open_shared);
+	GRAPHICS_IMPORT_OPTIONAL(device_texture_get_shared_handle);
+	GRAPHICS_IMPORT_OPTIONAL(device_get_duplicator_monitor_info);
+	GRAPHICS_IMPORT_OPTIONAL(device_duplicator_create);
+	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_update_frame);
+	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_get_texture);
 #endif
 
 	return success;
@@ -56,6 +56,8 @@ struct gs_exports {
 	gs_stagesurf_t *(*device_stagesurface_create)(gs_device_t *device,
 			uint32_t width, uint32_t height,
 			enum gs_color_format color_format);
+	gs_timer_t *(*device_timer_create)(gs_device_t *device);
+	gs_timer_range_t *(*device_timer_range_create)(gs_device_t *device);
 	gs_samplerstate_t *(*device_samplerstate_create)(gs_device_t *device,
 			const struct gs_sampler_info *info);
 	gs_shader_t *(*device_vertexshader_create)(gs_device_t *device,
@@ -144,7 +146,14 @@ struct gs_exports {
 	void (*device_projection_push)(gs_device_t *device);
 	void (*device_projection_pop)(gs_device_t *device);
 
+	bool (*device_command_list_begin)(gs_device_t *device);
+	gs_cmdlist_t *(*device_command_list_end)(gs_device_t *device);
+	void (*device_command_list_execute)(gs_device_t *device,
+			gs_cmdlist_t *list);
+	void (*gs_command_list_destroy)(gs_cmdlist_t *list);
+
 	void     (*gs_swapchain_destroy)(gs_swapchain_t *swapchain);
+	bool     (*gs_swapchain_ready)(gs_swapchain_t *swapchain);
 
 	void     (*gs_texture_destroy)(gs_texture_t *tex);
 	uint32_t (*gs_texture_get_width)(const gs_texture_t *tex);
@@ -154,6 +163,12 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	bool     (*gs_texture_set_image_region)(gs_texture_t *tex,
+			const uint8_t *data, uint32_t linesize,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
+	bool     (*gs_texture_set_image_regions)(gs_texture_t *tex,
+			const uint8_t *data, uint32_t linesize,
+			const struct gs_rect *rects, size_t num_rects);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -176,7 +191,20 @@ struct gs_exports {
 			const gs_stagesurf_t *stagesurf);
 	bool     (*gs_stagesurface_map)(gs_stagesurf_t *stagesurf,
 			uint8_t **data, uint32_t *linesize);
+	bool     (*gs_stagesurface_try_map)(gs_stagesurf_t *stagesurf,
+			uint8_t **data, uint32_t *linesize);
 	void     (*gs_stagesurface_unmap)(gs_stagesurf_t *stagesurf);
+	uint32_t (*gs_stagesurface_get_pitch)(const gs_stagesurf_t *stagesurf);
+
+	void     (*gs_timer_destroy)(gs_timer_t *timer);
+	void     (*gs_timer_begin)(gs_timer_t *timer);
+	void     (*gs_timer_end)(gs_timer_t *timer);
+	bool     (*gs_timer_get_data)(gs_timer_t *timer, uint64_t *ticks);
+	void     (*gs_timer_range_destroy)(gs_timer_range_t *range);
+	void     (*gs_timer_range_begin)(gs_timer_range_t *range);
+	void     (*gs_timer_range_end)(gs_timer_range_t *range);
+	bool     (*gs_timer_range_get_data)(gs_timer_range_t *range,
+			bool *disjoint, uint64_t *frequency);
 
 	void (*gs_zstencil_destroy)(gs_zstencil_t *zstencil);
 
@@ -184,6 +212,8 @@ struct gs_exports {
 
 	void (*gs_vertexbuffer_destroy)(gs_vertbuffer_t *vertbuffer);
 	void (*gs_vertexbuffer_flush)(gs_vertbuffer_t *vertbuffer);
+	void (*gs_vertexbuffer_flush_range)(gs_vertbuffer_t *vertbuffer,
+			size_t start, size_t num, bool discard);
 	struct gs_vb_data *(*gs_vertexbuffer_get_data)(
 			const gs_vertbuffer_t *vertbuffer);
 
@@ -240,6 +270,15 @@ struct gs_exports {
 
 	gs_texture_t *(*device_texture_open_shared)(gs_device_t *device,
 				uint32_t handle);
+	uint32_t (*device_texture_get_shared_handle)(gs_texture_t *tex);
+
+	bool (*device_get_duplicator_monitor_info)(gs_device_t *device,
+			int monitor_idx, struct gs_monitor_info *monitor_info);
+	gs_duplicator_t *(*device_duplicator_create)(gs_device_t *device,
+			int monitor_idx);
+	void (*gs_duplicator_destroy)(gs_duplicator_t *duplicator);
+	bool (*gs_duplicator_update_frame)(gs_duplicator_t *duplicator);
+	gs_texture_t *(*gs_duplicator_get_texture)(gs_duplicator_t *duplicator);
 #endif
 };
 
@@ -249,6 +288,18 @@ struct blend_state {
 	enum gs_blend_type dest;
 };
 
+/* a texture made with gs_texture_create, tracked for the memory accounting
+ * and, once destroyed, possibly kept in the pool to be reused */
+struct gs_texture_entry {
+	gs_texture_t           *tex;
+	uint32_t               width;
+	uint32_t               height;
+	enum gs_color_format   format;
+	uint32_t               flags;
+	uint64_t               size;
+	bool                   poolable;
+};
+
 struct graphics_subsystem {
 	void                   *module;
 	gs_device_t            *device;
@@ -263,6 +314,10 @@ struct graphics_subsystem {
 	struct gs_effect       *cur_effect;
 
 	gs_vertbuffer_t        *sprite_buffer;
+	size_t                 immediate_pos;
+	bool                   immediate_discard;
+	float                  sprite_params[6];
+	bool                   sprite_params_valid;
 
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
@@ -276,4 +331,11 @@ struct graphics_subsystem {
 	volatile long          ref;
 
 	struct blend_state     cur_blend_state;
+
+	DARRAY(struct gs_texture_entry) textures;
+	DARRAY(struct gs_texture_entry) texture_pool;
+	uint64_t               texture_memory;
+	uint64_t               texture_pool_memory;
+	uint64_t               texture_budget;
+	bool                   texture_budget_warned;
 };
@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include "../util/darray.h"
 
 #define MAGICKCORE_QUANTUM_DEPTH 16
 #define MAGICKCORE_HDRI_ENABLE   0
@@ -14,9 +15,11 @@ void gs_free_image_deps()
 	MagickCoreTerminus();
 }
 
-gs_texture_t *gs_texture_create_from_file(const char *file)
+uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx_out,
+		uint32_t *cy_out)
 {
-	gs_texture_t  *tex = NULL;
+	uint8_t       *data = NULL;
 	ImageInfo     *info;
 	ExceptionInfo *exception;
 	Image         *image;
@@ -32,19 +35,22 @@ gs_texture_t *gs_texture_create_from_file(const char *file)
 	if (image) {
 		size_t  cx    = image->magick_columns;
 		size_t  cy    = image->magick_rows;
-		uint8_t *data = malloc(cx * cy * 4);
+		data = bmalloc(cx * cy * 4);
 
 		ExportImagePixels(image, 0, 0, cx, cy, "BGRA", CharPixel,
 				data, exception);
-		if (exception->severity == UndefinedException)
-			tex = gs_texture_create(cx, cy, GS_BGRA, 1,
-					(const uint8_t**)&data, 0);
-		else
+		if (exception->severity == UndefinedException) {
+			*format = GS_BGRA;
+			*cx_out = (uint32_t)cx;
+			*cy_out = (uint32_t)cy;
+		} else {
 			blog(LOG_WARNING, "magickcore warning/error getting "
 			                  "pixels from file '%s': %s", file,
 			                  exception->reason);
+			bfree(data);
+			data = NULL;
+		}
 
-		free(data);
 		DestroyImage(image);
 
 	} else if (exception->severity != UndefinedException) {
@@ -55,5 +61,97 @@ gs_texture_t *gs_texture_create_from_file(const char *file)
 	DestroyImageInfo(info);
 	DestroyExceptionInfo(exception);
 
+	return data;
+}
+
+gs_texture_t *gs_texture_create_from_file(const char *file)
+{
+	enum gs_color_format format;
+	uint32_t             cx;
+	uint32_t             cy;
+	uint8_t              *data = gs_create_texture_file_data(file, &format,
+			&cx, &cy);
+	gs_texture_t         *tex  = NULL;
+
+	if (data) {
+		tex = gs_texture_create(cx, cy, format, 1,
+				(const uint8_t**)&data, 0);
+		bfree(data);
+	}
 	return tex;
 }
+
+bool gs_image_frames_init(struct gs_image_frames *frames, const char *file)
+{
+	ImageInfo     *info;
+	ExceptionInfo *exception;
+	Image         *image;
+	Image         *coalesced = NULL;
+	DARRAY(uint8_t*) data;
+	DARRAY(uint64_t) durations;
+
+	memset(frames, 0, sizeof(*frames));
+	da_init(data);
+	da_init(durations);
+
+	if (!file || !*file)
+		return false;
+
+	info      = CloneImageInfo(NULL);
+	exception = AcquireExceptionInfo();
+
+	strcpy(info->filename, file);
+	image = ReadImage(info, exception);
+
+	/* animation frames may only contain the changed area, coalescing
+	 * turns them in to full frames */
+	if (image)
+		coalesced = CoalesceImages(image, exception);
+
+	if (coalesced) {
+		size_t cx         = coalesced->magick_columns;
+		size_t cy         = coalesced->magick_rows;
+		size_t frame_size = cx * cy * 4;
+
+		for (Image *cur = coalesced;
+		     cur && (data.num + 1) * frame_size <=
+				GS_IMAGE_FRAMES_MAX_SIZE;
+		     cur = GetNextImageInList(cur)) {
+			uint8_t  *out = bmalloc(frame_size);
+			uint64_t tps  = cur->ticks_per_second > 0 ?
+				(uint64_t)cur->ticks_per_second : 100;
+			uint64_t duration = (uint64_t)cur->delay *
+				1000000000ULL / tps;
+
+			ExportImagePixels(cur, 0, 0, cx, cy, "BGRA", CharPixel,
+					out, exception);
+			if (exception->severity != UndefinedException) {
+				bfree(out);
+				break;
+			}
+
+			da_push_back(data, &out);
+			da_push_back(durations, &duration);
+		}
+
+		frames->format = GS_BGRA;
+		frames->cx     = (uint32_t)cx;
+		frames->cy     = (uint32_t)cy;
+		DestroyImageList(coalesced);
+	}
+
+	if (exception->severity != UndefinedException)
+		blog(LOG_WARNING, "magickcore warning/error reading frames "
+		                  "from file '%s': %s", file,
+		                  exception->reason);
+
+	if (image)
+		DestroyImageList(image);
+	DestroyImageInfo(info);
+	DestroyExceptionInfo(exception);
+
+	frames->num_frames   = data.num;
+	frames->data         = data.array;
+	frames->durations_ns = durations.array;
+	return data.num > 0;
+}
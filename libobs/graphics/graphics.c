@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <assert.h>
+#include <inttypes.h>
 
 #include "../util/base.h"
 #include "../util/bmem.h"
@@ -36,6 +37,13 @@ static __thread graphics_t *thread_graphics = NULL;
 
 #define IMMEDIATE_COUNT 512
 
+/*
+ * The immediate vertex buffer is used as a ring: each immediate draw writes
+ * its vertices after those of the previous draw without waiting for the GPU,
+ * and the buffer is only discarded when it wraps around.
+ */
+#define IMMEDIATE_RING_COUNT (IMMEDIATE_COUNT * 16)
+
 extern void gs_init_image_deps(void);
 extern void gs_free_image_deps(void);
 
@@ -47,15 +55,15 @@ static bool graphics_init_immediate_vb(struct graphics_subsystem *graphics)
 	struct gs_vb_data *vbd;
 
 	vbd = gs_vbdata_create();
-	vbd->num     = IMMEDIATE_COUNT;
-	vbd->points  = bmalloc(sizeof(struct vec3)*IMMEDIATE_COUNT);
-	vbd->normals = bmalloc(sizeof(struct vec3)*IMMEDIATE_COUNT);
-	vbd->colors  = bmalloc(sizeof(uint32_t)   *IMMEDIATE_COUNT);
+	vbd->num     = IMMEDIATE_RING_COUNT;
+	vbd->points  = bmalloc(sizeof(struct vec3)*IMMEDIATE_RING_COUNT);
+	vbd->normals = bmalloc(sizeof(struct vec3)*IMMEDIATE_RING_COUNT);
+	vbd->colors  = bmalloc(sizeof(uint32_t)   *IMMEDIATE_RING_COUNT);
 	vbd->num_tex = 1;
 	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
 	vbd->tvarray[0].width = 2;
 	vbd->tvarray[0].array =
-		bmalloc(sizeof(struct vec2) * IMMEDIATE_COUNT);
+		bmalloc(sizeof(struct vec2) * IMMEDIATE_RING_COUNT);
 
 	graphics->immediate_vertbuffer = graphics->exports.
 		device_vertexbuffer_create(graphics->device, vbd, GS_DYNAMIC);
@@ -165,6 +173,12 @@ void gs_destroy(graphics_t *graphics)
 
 	if (graphics->device) {
 		graphics->exports.device_enter_context(graphics->device);
+		for (size_t i = 0; i < graphics->texture_pool.num; i++)
+			graphics->exports.gs_texture_destroy(
+					graphics->texture_pool.array[i].tex);
+		if (graphics->textures.num)
+			blog(LOG_DEBUG, "gs_destroy: %d textures leaked",
+					(int)graphics->textures.num);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
@@ -175,6 +189,8 @@ void gs_destroy(graphics_t *graphics)
 	pthread_mutex_destroy(&graphics->mutex);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
+	da_free(graphics->textures);
+	da_free(graphics->texture_pool);
 	if (graphics->module)
 		os_dlclose(graphics->module);
 	bfree(graphics);
@@ -383,15 +399,24 @@ void gs_render_start(bool b_new)
 	if (b_new) {
 		graphics->vbd = gs_vbdata_create();
 	} else {
+		size_t pos = graphics->immediate_pos;
+		struct vec2 *tvarray;
+
+		if (pos + IMMEDIATE_COUNT > IMMEDIATE_RING_COUNT) {
+			graphics->immediate_pos     = pos = 0;
+			graphics->immediate_discard = true;
+		}
+
 		graphics->vbd = gs_vertexbuffer_get_data(
 				graphics->immediate_vertbuffer);
-		memset(graphics->vbd->colors, 0xFF,
+		tvarray = graphics->vbd->tvarray[0].array;
+		memset(graphics->vbd->colors + pos, 0xFF,
 				sizeof(uint32_t) * IMMEDIATE_COUNT);
 
-		graphics->verts.array       = graphics->vbd->points;
-		graphics->norms.array       = graphics->vbd->normals;
-		graphics->colors.array      = graphics->vbd->colors;
-		graphics->texverts[0].array = graphics->vbd->tvarray[0].array;
+		graphics->verts.array       = graphics->vbd->points  + pos;
+		graphics->norms.array       = graphics->vbd->normals + pos;
+		graphics->colors.array      = graphics->vbd->colors  + pos;
+		graphics->texverts[0].array = tvarray + pos;
 
 		graphics->verts.capacity       = IMMEDIATE_COUNT;
 		graphics->norms.capacity       = IMMEDIATE_COUNT;
@@ -449,12 +474,17 @@ void gs_render_stop(enum gs_draw_mode mode)
 	}
 
 	if (graphics->using_immediate) {
-		gs_vertexbuffer_flush(graphics->immediate_vertbuffer);
+		size_t pos = graphics->immediate_pos;
+
+		gs_vertexbuffer_flush_range(graphics->immediate_vertbuffer,
+				pos, num, graphics->immediate_discard);
 
 		gs_load_vertexbuffer(graphics->immediate_vertbuffer);
 		gs_load_indexbuffer(NULL);
-		gs_draw(mode, 0, (uint32_t)num);
+		gs_draw(mode, (uint32_t)pos, (uint32_t)num);
 
+		graphics->immediate_pos     = pos + num;
+		graphics->immediate_discard = false;
 		reset_immediate_arrays(graphics);
 	} else {
 		gs_vertbuffer_t *vb = gs_render_save();
@@ -672,6 +702,24 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	return effect;
 }
 
+char *gs_effect_prefix_names(const char *effect_string, const char *filename,
+		const char *prefix, char **error_string)
+{
+	struct effect_parser parser;
+	char *text;
+
+	if (!thread_graphics || !effect_string || !prefix)
+		return NULL;
+
+	ep_init(&parser);
+	text = ep_prefix_names(&parser, effect_string, filename, prefix);
+	if (!text && error_string)
+		*error_string = error_data_buildstring(&parser.cfp.error_list);
+
+	ep_free(&parser);
+	return text;
+}
+
 gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 		char **error_string)
 {
@@ -739,10 +787,28 @@ static inline void assign_sprite_uv(float *start, float *end, bool flip)
 	}
 }
 
-static void build_sprite(struct gs_vb_data *data, float fcx, float fcy,
+/*
+ * The sprite buffer is only rebuilt and uploaded when the sprite differs from
+ * the last one drawn, which saves a buffer upload per draw when drawing
+ * sources of the same size or render targets of the output size.  Returns
+ * true if the buffer needs to be flushed.
+ */
+static bool build_sprite(graphics_t *graphics, float fcx, float fcy,
 		float start_u, float end_u, float start_v, float end_v)
 {
-	struct vec2 *tvarray = data->tvarray[0].array;
+	float params[6] = {fcx, fcy, start_u, end_u, start_v, end_v};
+	struct gs_vb_data *data;
+	struct vec2 *tvarray;
+
+	if (graphics->sprite_params_valid &&
+	    memcmp(graphics->sprite_params, params, sizeof(params)) == 0)
+		return false;
+
+	memcpy(graphics->sprite_params, params, sizeof(params));
+	graphics->sprite_params_valid = true;
+
+	data    = gs_vertexbuffer_get_data(graphics->sprite_buffer);
+	tvarray = data->tvarray[0].array;
 
 	vec3_zero(data->points);
 	vec3_set(data->points+1,  fcx, 0.0f, 0.0f);
@@ -752,9 +818,10 @@ static void build_sprite(struct gs_vb_data *data, float fcx, float fcy,
 	vec2_set(tvarray+1, end_u,   start_v);
 	vec2_set(tvarray+2, start_u, end_v);
 	vec2_set(tvarray+3, end_u,   end_v);
+	return true;
 }
 
-static inline void build_sprite_norm(struct gs_vb_data *data, float fcx,
+static inline bool build_sprite_norm(graphics_t *graphics, float fcx,
 		float fcy, uint32_t flip)
 {
 	float start_u, end_u;
@@ -762,10 +829,11 @@ static inline void build_sprite_norm(struct gs_vb_data *data, float fcx,
 
 	assign_sprite_uv(&start_u, &end_u, (flip & GS_FLIP_U) != 0);
 	assign_sprite_uv(&start_v, &end_v, (flip & GS_FLIP_V) != 0);
-	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
+	return build_sprite(graphics, fcx, fcy, start_u, end_u,
+			start_v, end_v);
 }
 
-static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
+static inline bool build_sprite_rect(graphics_t *graphics, gs_texture_t *tex,
 		float fcx, float fcy, uint32_t flip)
 {
 	float start_u, end_u;
@@ -775,7 +843,8 @@ static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
 
 	assign_sprite_rect(&start_u, &end_u, width,  (flip & GS_FLIP_U) != 0);
 	assign_sprite_rect(&start_v, &end_v, height, (flip & GS_FLIP_V) != 0);
-	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
+	return build_sprite(graphics, fcx, fcy, start_u, end_u,
+			start_v, end_v);
 }
 
 void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
@@ -783,7 +852,7 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 {
 	graphics_t *graphics = thread_graphics;
 	float fcx, fcy;
-	struct gs_vb_data *data;
+	bool changed;
 
 	assert(tex);
 	if (!tex || !thread_graphics)
@@ -797,13 +866,66 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	fcx = width  ? (float)width  : (float)gs_texture_get_width(tex);
 	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
 
-	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	if (gs_texture_is_rect(tex))
-		build_sprite_rect(data, tex, fcx, fcy, flip);
+		changed = build_sprite_rect(graphics, tex, fcx, fcy, flip);
 	else
-		build_sprite_norm(data, fcx, fcy, flip);
+		changed = build_sprite_norm(graphics, fcx, fcy, flip);
+
+	if (changed)
+		gs_vertexbuffer_flush(graphics->sprite_buffer);
+	gs_load_vertexbuffer(graphics->sprite_buffer);
+	gs_load_indexbuffer(NULL);
+
+	gs_draw(GS_TRISTRIP, 0, 0);
+}
+
+static inline void assign_sprite_region(float *start, float *end,
+		float pos, float size, float tex_size, bool flip)
+{
+	*start = pos / tex_size;
+	*end   = (pos + size) / tex_size;
+
+	if (flip) {
+		float temp = *start;
+		*start = *end;
+		*end   = temp;
+	}
+}
+
+void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy)
+{
+	graphics_t *graphics = thread_graphics;
+	float tex_cx, tex_cy;
+	float start_u, end_u;
+	float start_v, end_v;
+
+	assert(tex);
+	if (!tex || !thread_graphics)
+		return;
 
-	gs_vertexbuffer_flush(graphics->sprite_buffer);
+	if (gs_get_texture_type(tex) != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "A sprite must be a 2D texture");
+		return;
+	}
+
+	/* rectangle textures use unnormalized coordinates */
+	if (gs_texture_is_rect(tex)) {
+		tex_cx = 1.0f;
+		tex_cy = 1.0f;
+	} else {
+		tex_cx = (float)gs_texture_get_width(tex);
+		tex_cy = (float)gs_texture_get_height(tex);
+	}
+
+	assign_sprite_region(&start_u, &end_u, (float)x, (float)cx, tex_cx,
+			(flip & GS_FLIP_U) != 0);
+	assign_sprite_region(&start_v, &end_v, (float)y, (float)cy, tex_cy,
+			(flip & GS_FLIP_V) != 0);
+
+	if (build_sprite(graphics, (float)cx, (float)cy, start_u, end_u,
+				start_v, end_v))
+		gs_vertexbuffer_flush(graphics->sprite_buffer);
 	gs_load_vertexbuffer(graphics->sprite_buffer);
 	gs_load_indexbuffer(NULL);
 
@@ -907,6 +1029,57 @@ void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 	gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !tex || !data)
+		return false;
+	if (!graphics->exports.gs_texture_set_image_region)
+		return false;
+
+	if (!cx || !cy ||
+	    x + cx > gs_texture_get_width(tex) ||
+	    y + cy > gs_texture_get_height(tex))
+		return false;
+
+	return graphics->exports.gs_texture_set_image_region(tex, data,
+			linesize, x, y, cx, cy);
+}
+
+bool gs_texture_set_image_regions(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, const struct gs_rect *rects,
+		size_t num_rects)
+{
+	graphics_t *graphics = thread_graphics;
+	uint32_t width, height;
+
+	if (!graphics || !tex || !data || !rects)
+		return false;
+	if (!graphics->exports.gs_texture_set_image_regions)
+		return false;
+
+	width  = gs_texture_get_width(tex);
+	height = gs_texture_get_height(tex);
+
+	for (size_t i = 0; i < num_rects; i++) {
+		const struct gs_rect *rect = &rects[i];
+
+		if (rect->x < 0 || rect->y < 0 ||
+		    rect->cx <= 0 || rect->cy <= 0 ||
+		    (uint32_t)(rect->x + rect->cx) > width ||
+		    (uint32_t)(rect->y + rect->cy) > height)
+			return false;
+	}
+
+	if (!num_rects)
+		return true;
+
+	return graphics->exports.gs_texture_set_image_regions(tex, data,
+			linesize, rects, num_rects);
+}
+
 void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert)
 {
@@ -1009,6 +1182,163 @@ static inline bool is_pow2(uint32_t size)
 	return size >= 2 && (size & (size-1)) == 0;
 }
 
+/* ------------------------------------------------------------------------- */
+/* texture pool and memory accounting */
+
+#define TEXTURE_POOL_MAX 16
+
+static uint64_t calc_texture_size(uint32_t width, uint32_t height,
+		enum gs_color_format format, uint32_t levels)
+{
+	uint32_t bpp = gs_get_format_bpp(format);
+	uint64_t size = 0;
+
+	if (!levels)
+		levels = gs_get_total_levels(width, height) + 1;
+
+	while (levels--) {
+		size += (uint64_t)width * height * bpp / 8;
+		if (width > 1)  width  /= 2;
+		if (height > 1) height /= 2;
+	}
+
+	return size;
+}
+
+static void destroy_oldest_pooled_texture(graphics_t *graphics)
+{
+	struct gs_texture_entry *entry = graphics->texture_pool.array;
+
+	graphics->exports.gs_texture_destroy(entry->tex);
+	graphics->texture_memory      -= entry->size;
+	graphics->texture_pool_memory -= entry->size;
+	da_erase(graphics->texture_pool, 0);
+}
+
+/* makes room for a new texture within the budget, evicting pooled textures
+ * first */
+static bool reserve_texture_memory(graphics_t *graphics, uint64_t size)
+{
+	uint64_t budget = graphics->texture_budget;
+
+	if (!budget)
+		return true;
+
+	while (graphics->texture_memory + size > budget &&
+	       graphics->texture_pool.num)
+		destroy_oldest_pooled_texture(graphics);
+
+	if (graphics->texture_memory + size <= budget) {
+		graphics->texture_budget_warned = false;
+		return true;
+	}
+
+	if (!graphics->texture_budget_warned) {
+		blog(LOG_WARNING, "gs_texture_create: Texture memory budget "
+		                  "exceeded (%"PRIu64" of %"PRIu64" bytes "
+		                  "used), refusing new textures",
+		                  graphics->texture_memory, budget);
+		graphics->texture_budget_warned = true;
+	}
+
+	return false;
+}
+
+static bool take_pooled_texture(graphics_t *graphics,
+		struct gs_texture_entry *entry)
+{
+	for (size_t i = graphics->texture_pool.num; i > 0; i--) {
+		struct gs_texture_entry *pooled =
+			graphics->texture_pool.array + (i - 1);
+
+		if (pooled->width  == entry->width &&
+		    pooled->height == entry->height &&
+		    pooled->format == entry->format &&
+		    pooled->flags  == entry->flags) {
+			*entry = *pooled;
+			graphics->texture_pool_memory -= entry->size;
+			da_erase(graphics->texture_pool, i - 1);
+			da_push_back(graphics->textures, entry);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* returns false if the texture wasn't made by gs_texture_create */
+static bool release_tracked_texture(graphics_t *graphics, gs_texture_t *tex)
+{
+	struct gs_texture_entry entry;
+	size_t idx = DARRAY_INVALID;
+
+	for (size_t i = graphics->textures.num; i > 0; i--) {
+		if (graphics->textures.array[i - 1].tex == tex) {
+			idx = i - 1;
+			break;
+		}
+	}
+
+	if (idx == DARRAY_INVALID)
+		return false;
+
+	entry = graphics->textures.array[idx];
+	da_erase(graphics->textures, idx);
+
+	if (!entry.poolable) {
+		graphics->exports.gs_texture_destroy(tex);
+		graphics->texture_memory -= entry.size;
+		return true;
+	}
+
+	if (graphics->texture_pool.num == TEXTURE_POOL_MAX)
+		destroy_oldest_pooled_texture(graphics);
+
+	graphics->texture_pool_memory += entry.size;
+	da_push_back(graphics->texture_pool, &entry);
+	return true;
+}
+
+void gs_get_texture_memory_info(struct gs_texture_memory_info *info)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!info)
+		return;
+
+	memset(info, 0, sizeof(*info));
+	if (!graphics)
+		return;
+
+	info->used   = graphics->texture_memory;
+	info->pooled = graphics->texture_pool_memory;
+	info->budget = graphics->texture_budget;
+}
+
+void gs_set_texture_memory_budget(uint64_t budget)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics) return;
+
+	graphics->texture_budget = budget;
+	graphics->texture_budget_warned = false;
+
+	while (budget && graphics->texture_memory > budget &&
+	       graphics->texture_pool.num)
+		destroy_oldest_pooled_texture(graphics);
+}
+
+void gs_texture_pool_flush(void)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics) return;
+
+	while (graphics->texture_pool.num)
+		destroy_oldest_pooled_texture(graphics);
+}
+
+/* ------------------------------------------------------------------------- */
+
 gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
 		enum gs_color_format color_format, uint32_t levels,
 		const uint8_t **data, uint32_t flags)
@@ -1037,8 +1367,41 @@ gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
 		levels = 1;
 	}
 
-	return graphics->exports.device_texture_create(graphics->device,
+	struct gs_texture_entry entry = {0};
+	entry.width    = width;
+	entry.height   = height;
+	entry.format   = color_format;
+	entry.flags    = flags;
+	entry.size     = calc_texture_size(width, height, color_format,
+			uses_mipmaps ? levels : 1);
+	entry.poolable = !uses_mipmaps && (flags & GS_GL_DUMMYTEX) == 0;
+
+	if (entry.poolable && !data && take_pooled_texture(graphics, &entry))
+		return entry.tex;
+
+	if (!reserve_texture_memory(graphics, entry.size))
+		return NULL;
+
+	entry.tex = graphics->exports.device_texture_create(graphics->device,
 			width, height, color_format, levels, data, flags);
+	if (entry.tex) {
+		graphics->texture_memory += entry.size;
+		da_push_back(graphics->textures, &entry);
+	}
+
+	return entry.tex;
+}
+
+void gs_image_frames_free(struct gs_image_frames *frames)
+{
+	if (!frames)
+		return;
+
+	for (size_t i = 0; i < frames->num_frames; i++)
+		bfree(frames->data[i]);
+	bfree(frames->data);
+	bfree(frames->durations_ns);
+	memset(frames, 0, sizeof(*frames));
 }
 
 gs_texture_t *gs_cubetexture_create(uint32_t size,
@@ -1106,6 +1469,24 @@ gs_stagesurf_t *gs_stagesurface_create(uint32_t width, uint32_t height,
 			width, height, color_format);
 }
 
+gs_timer_t *gs_timer_create(void)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !graphics->exports.device_timer_create)
+		return NULL;
+
+	return graphics->exports.device_timer_create(graphics->device);
+}
+
+gs_timer_range_t *gs_timer_range_create(void)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !graphics->exports.device_timer_range_create)
+		return NULL;
+
+	return graphics->exports.device_timer_range_create(graphics->device);
+}
+
 gs_samplerstate_t *gs_samplerstate_create(const struct gs_sampler_info *info)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1517,6 +1898,40 @@ void gs_projection_pop(void)
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
+bool gs_command_list_begin(void)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !graphics->exports.device_command_list_begin)
+		return false;
+
+	return graphics->exports.device_command_list_begin(graphics->device);
+}
+
+gs_cmdlist_t *gs_command_list_end(void)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !graphics->exports.device_command_list_end)
+		return NULL;
+
+	return graphics->exports.device_command_list_end(graphics->device);
+}
+
+void gs_command_list_execute(gs_cmdlist_t *list)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !list) return;
+
+	graphics->exports.device_command_list_execute(graphics->device, list);
+}
+
+void gs_command_list_destroy(gs_cmdlist_t *list)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !list) return;
+
+	graphics->exports.gs_command_list_destroy(list);
+}
+
 void gs_swapchain_destroy(gs_swapchain_t *swapchain)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1525,6 +1940,17 @@ void gs_swapchain_destroy(gs_swapchain_t *swapchain)
 	graphics->exports.gs_swapchain_destroy(swapchain);
 }
 
+bool gs_swapchain_ready(gs_swapchain_t *swapchain)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !swapchain) return true;
+
+	if (!graphics->exports.gs_swapchain_ready)
+		return true;
+
+	return graphics->exports.gs_swapchain_ready(swapchain);
+}
+
 void gs_shader_destroy(gs_shader_t *shader)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1675,7 +2101,8 @@ void gs_texture_destroy(gs_texture_t *tex)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !tex) return;
 
-	graphics->exports.gs_texture_destroy(tex);
+	if (!release_tracked_texture(graphics, tex))
+		graphics->exports.gs_texture_destroy(tex);
 }
 
 uint32_t gs_texture_get_width(const gs_texture_t *tex)
@@ -1844,6 +2271,21 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 	return graphics->exports.gs_stagesurface_map(stagesurf, data, linesize);
 }
 
+bool gs_stagesurface_try_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !stagesurf) return false;
+
+	/* renderers that can't query the copy just wait for it */
+	if (!graphics->exports.gs_stagesurface_try_map)
+		return graphics->exports.gs_stagesurface_map(stagesurf, data,
+				linesize);
+
+	return graphics->exports.gs_stagesurface_try_map(stagesurf, data,
+			linesize);
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1852,6 +2294,84 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	graphics->exports.gs_stagesurface_unmap(stagesurf);
 }
 
+uint32_t gs_stagesurface_get_pitch(const gs_stagesurf_t *stagesurf)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !stagesurf) return 0;
+	if (!graphics->exports.gs_stagesurface_get_pitch) return 0;
+
+	return graphics->exports.gs_stagesurface_get_pitch(stagesurf);
+}
+
+/* timers and ranges can only exist if the device supports them, so their
+ * functions don't need to check for the exports */
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !timer) return;
+
+	graphics->exports.gs_timer_destroy(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !timer) return;
+
+	graphics->exports.gs_timer_begin(timer);
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !timer) return;
+
+	graphics->exports.gs_timer_end(timer);
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !timer || !ticks) return false;
+
+	return graphics->exports.gs_timer_get_data(timer, ticks);
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !range) return;
+
+	graphics->exports.gs_timer_range_destroy(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !range) return;
+
+	graphics->exports.gs_timer_range_begin(range);
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !range) return;
+
+	graphics->exports.gs_timer_range_end(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+		uint64_t *frequency)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !range || !disjoint || !frequency) return false;
+
+	return graphics->exports.gs_timer_range_get_data(range, disjoint,
+			frequency);
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	if (!thread_graphics || !zstencil) return;
@@ -1881,6 +2401,20 @@ void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
 	thread_graphics->exports.gs_vertexbuffer_flush(vertbuffer);
 }
 
+void gs_vertexbuffer_flush_range(gs_vertbuffer_t *vertbuffer,
+		size_t start, size_t num, bool discard)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!graphics || !vertbuffer) return;
+
+	if (graphics->exports.gs_vertexbuffer_flush_range)
+		graphics->exports.gs_vertexbuffer_flush_range(vertbuffer,
+				start, num, discard);
+	else
+		graphics->exports.gs_vertexbuffer_flush(vertbuffer);
+}
+
 struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vertbuffer)
 {
 	if (!thread_graphics || !vertbuffer) return NULL;
@@ -2010,4 +2544,71 @@ gs_texture_t *gs_texture_open_shared(uint32_t handle)
 	return NULL;
 }
 
+uint32_t gs_texture_get_shared_handle(gs_texture_t *tex)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !tex)
+		return 0;
+
+	if (graphics->exports.device_texture_get_shared_handle)
+		return graphics->exports.device_texture_get_shared_handle(tex);
+	return 0;
+}
+
+bool gs_get_duplicator_monitor_info(int monitor_idx,
+		struct gs_monitor_info *monitor_info)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !monitor_info)
+		return false;
+
+	if (graphics->exports.device_get_duplicator_monitor_info)
+		return graphics->exports.device_get_duplicator_monitor_info(
+				graphics->device, monitor_idx, monitor_info);
+	return false;
+}
+
+gs_duplicator_t *gs_duplicator_create(int monitor_idx)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics)
+		return NULL;
+
+	if (graphics->exports.device_duplicator_create)
+		return graphics->exports.device_duplicator_create(
+				graphics->device, monitor_idx);
+	return NULL;
+}
+
+void gs_duplicator_destroy(gs_duplicator_t *duplicator)
+{
+	if (!thread_graphics || !duplicator)
+		return;
+
+	if (thread_graphics->exports.gs_duplicator_destroy)
+		thread_graphics->exports.gs_duplicator_destroy(duplicator);
+}
+
+bool gs_duplicator_update_frame(gs_duplicator_t *duplicator)
+{
+	if (!thread_graphics || !duplicator)
+		return false;
+
+	if (thread_graphics->exports.gs_duplicator_update_frame)
+		return thread_graphics->exports.gs_duplicator_update_frame(
+				duplicator);
+	return false;
+}
+
+gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator)
+{
+	if (!thread_graphics || !duplicator)
+		return NULL;
+
+	if (thread_graphics->exports.gs_duplicator_get_texture)
+		return thread_graphics->exports.gs_duplicator_get_texture(
+				duplicator);
+	return NULL;
+}
+
 #endif
@@ -71,7 +71,8 @@ enum gs_color_format {
 	GS_R32F,
 	GS_DXT1,
 	GS_DXT3,
-	GS_DXT5
+	GS_DXT5,
+	GS_R8G8
 };
 
 enum gs_zstencil_format {
@@ -249,6 +250,10 @@ struct graphics_subsystem;
 
 typedef struct gs_texture          gs_texture_t;
 typedef struct gs_stage_surface    gs_stagesurf_t;
+typedef struct gs_timer            gs_timer_t;
+typedef struct gs_timer_range      gs_timer_range_t;
+typedef struct gs_duplicator       gs_duplicator_t;
+typedef struct gs_command_list    gs_cmdlist_t;
 typedef struct gs_zstencil_buffer  gs_zstencil_t;
 typedef struct gs_vertex_buffer    gs_vertbuffer_t;
 typedef struct gs_index_buffer     gs_indexbuffer_t;
@@ -383,6 +388,10 @@ EXPORT void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val);
 EXPORT void gs_effect_set_val(gs_eparam_t *param, const void *val, size_t size);
 EXPORT void gs_effect_set_default(gs_eparam_t *param);
 
+/** Copies the current value of a parameter (or its default value if it has
+ * none) to a parameter of the same type, which can be in another effect */
+EXPORT void gs_effect_copy_val(gs_eparam_t *dst, const gs_eparam_t *src);
+
 /* ---------------------------------------------------
  * texture render helper functions
  * --------------------------------------------------- */
@@ -404,6 +413,7 @@ EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 #define GS_DYNAMIC       (1<<1)
 #define GS_RENDER_TARGET (1<<2)
 #define GS_GL_DUMMYTEX   (1<<3) /**<< texture with no allocated texture data */
+#define GS_SHARED_TEX    (1<<4) /**<< windows: can be opened by other devices */
 
 /* ---------------- */
 /* global functions */
@@ -485,6 +495,16 @@ EXPORT gs_effect_t *gs_effect_create_from_file(const char *file,
 EXPORT gs_effect_t *gs_effect_create(const char *effect_string,
 		const char *filename, char **error_string);
 
+/**
+ * Returns the effect text with every top-level name it declares (parameters,
+ * structs, functions and samplers) given the prefix, so the text of several
+ * effects can be combined in to one effect without their names clashing.
+ * Returns NULL if the effect fails to parse.  Free the result with bfree.
+ */
+EXPORT char *gs_effect_prefix_names(const char *effect_string,
+		const char *filename, const char *prefix,
+		char **error_string);
+
 EXPORT gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 		char **error_string);
 EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
@@ -492,6 +512,35 @@ EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
 
 EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 
+/**
+ * Decodes an image file without using the graphics subsystem, so that it can
+ * be done on any thread and uploaded later with gs_texture_create.  The
+ * returned pixels are tightly packed and must be freed with bfree.
+ */
+EXPORT uint8_t *gs_create_texture_file_data(const char *file,
+		enum gs_color_format *format, uint32_t *cx, uint32_t *cy);
+
+/** Decoding stops once the frames of an animation would exceed this */
+#define GS_IMAGE_FRAMES_MAX_SIZE (256 * 1024 * 1024)
+
+struct gs_image_frames {
+	enum gs_color_format format;
+	uint32_t             cx;
+	uint32_t             cy;
+	size_t               num_frames;
+	uint8_t              **data;          /**<< tightly packed, per frame */
+	uint64_t             *durations_ns;   /**<< 0 if the file has none */
+};
+
+/**
+ * Decodes every frame of an animated image (like a GIF) up front, without
+ * using the graphics subsystem.  Still images are decoded as a single frame.
+ * Returns false if no frames could be decoded.
+ */
+EXPORT bool gs_image_frames_init(struct gs_image_frames *frames,
+		const char *file);
+EXPORT void gs_image_frames_free(struct gs_image_frames *frames);
+
 #define GS_FLIP_U (1<<0)
 #define GS_FLIP_V (1<<1)
 
@@ -505,6 +554,13 @@ EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height);
 
+/**
+ * Draws a region of a texture as 2D sprite, at the size of the region.  Used
+ * when a texture is larger than the image it holds.
+ */
+EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear);
 
@@ -521,6 +577,26 @@ EXPORT void gs_viewport_pop(void);
 
 EXPORT void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 		uint32_t linesize, bool invert);
+
+/**
+ * Uploads only a region of a texture.  data points to the first pixel of the
+ * region and linesize is the distance between its rows.  Returns false if the
+ * renderer or texture does not support partial updates, in which case the
+ * whole image has to be set with gs_texture_set_image instead
+ */
+EXPORT bool gs_texture_set_image_region(gs_texture_t *tex,
+		const uint8_t *data, uint32_t linesize,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
+
+/**
+ * Uploads several regions of a texture in one call.  Unlike
+ * gs_texture_set_image_region, data points to the first pixel of an image the
+ * size of the texture, and each rect is both the source and destination area.
+ * Returns false if partial updates are not supported
+ */
+EXPORT bool gs_texture_set_image_regions(gs_texture_t *tex,
+		const uint8_t *data, uint32_t linesize,
+		const struct gs_rect *rects, size_t num_rects);
 EXPORT void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 		const void *data, uint32_t linesize, bool invert);
 
@@ -548,12 +624,42 @@ EXPORT gs_texture_t *gs_voltexture_create(uint32_t width, uint32_t height,
 		uint32_t depth, enum gs_color_format color_format,
 		uint32_t levels, const uint8_t **data, uint32_t flags);
 
+struct gs_texture_memory_info {
+	uint64_t used;    /**<< all textures, including pooled ones */
+	uint64_t pooled;  /**<< textures waiting in the pool to be reused */
+	uint64_t budget;  /**<< 0 if there is no budget */
+};
+
+/**
+ * Gets the memory used by textures made with gs_texture_create.  The sizes
+ * are calculated from the descriptions, so driver padding isn't included.
+ */
+EXPORT void gs_get_texture_memory_info(struct gs_texture_memory_info *info);
+
+/**
+ * Sets the texture memory budget in bytes, or 0 for no budget.  When a new
+ * texture would go over the budget, pooled textures are destroyed first, and
+ * the texture is refused if that still isn't enough.
+ */
+EXPORT void gs_set_texture_memory_budget(uint64_t budget);
+
+/** Destroys all of the textures that are being kept for reuse */
+EXPORT void gs_texture_pool_flush(void);
+
 EXPORT gs_zstencil_t *gs_zstencil_create(uint32_t width, uint32_t height,
 		enum gs_zstencil_format format);
 
 EXPORT gs_stagesurf_t *gs_stagesurface_create(uint32_t width, uint32_t height,
 		enum gs_color_format color_format);
 
+/**
+ * Creates a GPU timer, or returns NULL if the device does not support GPU
+ * timing.  Timers may be nested, but must be used within a timer range to
+ * know whether their results can be trusted and what their frequency is.
+ */
+EXPORT gs_timer_t *gs_timer_create(void);
+EXPORT gs_timer_range_t *gs_timer_range_create(void);
+
 EXPORT gs_samplerstate_t *gs_samplerstate_create(
 		const struct gs_sampler_info *info);
 
@@ -641,8 +747,32 @@ EXPORT void gs_frustum(float left, float right, float top, float bottom,
 EXPORT void gs_projection_push(void);
 EXPORT void gs_projection_pop(void);
 
+/**
+ * Starts recording draw calls in to a command list instead of executing
+ * them, so they can be replayed later with gs_command_list_execute.  Render
+ * target and viewport carry over, all other bound state (shaders, buffers,
+ * textures) must be loaded again after beginning, so begin and end outside
+ * of effect passes.  Staging surfaces and timers can't be read while
+ * recording.  Returns false if the renderer doesn't support command lists,
+ * in which case calls keep executing directly.
+ */
+EXPORT bool gs_command_list_begin(void);
+EXPORT gs_cmdlist_t *gs_command_list_end(void);
+
+/** Executes a recorded command list, then resets bound state as above */
+EXPORT void gs_command_list_execute(gs_cmdlist_t *list);
+EXPORT void gs_command_list_destroy(gs_cmdlist_t *list);
+
 EXPORT void     gs_swapchain_destroy(gs_swapchain_t *swapchain);
 
+/**
+ * Returns whether a frame can be presented to the swap chain without
+ * blocking.  When it returns true the frame is reserved, so the swap chain
+ * must be drawn to and presented next.  Always true for renderers that can't
+ * tell, and for the default swap chain (NULL).
+ */
+EXPORT bool     gs_swapchain_ready(gs_swapchain_t *swapchain);
+
 EXPORT void     gs_texture_destroy(gs_texture_t *tex);
 EXPORT uint32_t gs_texture_get_width(const gs_texture_t *tex);
 EXPORT uint32_t gs_texture_get_height(const gs_texture_t *tex);
@@ -680,14 +810,61 @@ EXPORT enum gs_color_format gs_stagesurface_get_color_format(
 		const gs_stagesurf_t *stagesurf);
 EXPORT bool     gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize);
+
+/**
+ * Maps the surface only if the GPU has finished copying to it, rather than
+ * waiting for the copy.  Returns false without mapping the surface if the
+ * copy is still pending or mapping failed.
+ */
+EXPORT bool     gs_stagesurface_try_map(gs_stagesurf_t *stagesurf,
+		uint8_t **data, uint32_t *linesize);
 EXPORT void     gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/**
+ * Returns the linesize gs_stagesurface_map will return for the surface, so
+ * that data can be laid out to match it before anything is mapped.  Returns 0
+ * if unknown
+ */
+EXPORT uint32_t gs_stagesurface_get_pitch(const gs_stagesurf_t *stagesurf);
+
+EXPORT void     gs_timer_destroy(gs_timer_t *timer);
+EXPORT void     gs_timer_begin(gs_timer_t *timer);
+EXPORT void     gs_timer_end(gs_timer_t *timer);
+
+/**
+ * Gets the elapsed GPU ticks between gs_timer_begin and gs_timer_end.
+ * Returns false without waiting if the result isn't available yet.
+ */
+EXPORT bool     gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks);
+
+EXPORT void     gs_timer_range_destroy(gs_timer_range_t *range);
+EXPORT void     gs_timer_range_begin(gs_timer_range_t *range);
+EXPORT void     gs_timer_range_end(gs_timer_range_t *range);
+
+/**
+ * Gets the tick frequency of the timers used within the range.  If disjoint
+ * is true, the timers of the range are invalid (for example because the GPU
+ * clock changed).  Returns false without waiting if the result isn't
+ * available yet.
+ */
+EXPORT bool     gs_timer_range_get_data(gs_timer_range_t *range,
+		bool *disjoint, uint64_t *frequency);
+
 EXPORT void     gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void     gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
 
 EXPORT void     gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer);
 EXPORT void     gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer);
+
+/**
+ * Uploads only vertices [start, start + num) of a dynamic vertex buffer.  If
+ * discard is false, the rest of the buffer is left untouched and the upload
+ * doesn't wait for draws that use it, so the range must not be used by any
+ * pending draw.  If discard is true, the rest of the buffer becomes undefined.
+ */
+EXPORT void     gs_vertexbuffer_flush_range(gs_vertbuffer_t *vertbuffer,
+		size_t start, size_t num, bool discard);
 EXPORT struct gs_vb_data *gs_vertexbuffer_get_data(
 		const gs_vertbuffer_t *vertbuffer);
 
@@ -720,6 +897,46 @@ EXPORT void gs_texture_release_dc(gs_texture_t *gdi_tex);
 
 /** creates a windows shared texture from a texture handle */
 EXPORT gs_texture_t *gs_texture_open_shared(uint32_t handle);
+
+/**
+ * returns the handle of a texture created with GS_SHARED_TEX, which other
+ * devices (including in other processes) can open with
+ * gs_texture_open_shared/OpenSharedResource.  0 if the texture isn't shared
+ */
+EXPORT uint32_t gs_texture_get_shared_handle(gs_texture_t *tex);
+
+struct gs_monitor_info {
+	int  x;
+	int  y;
+	long cx;
+	long cy;
+};
+
+/**
+ * Gets the desktop position and size of a monitor usable with the desktop
+ * duplicator.  Monitors are indexed in the order the adapter enumerates them
+ */
+EXPORT bool gs_get_duplicator_monitor_info(int monitor_idx,
+		struct gs_monitor_info *monitor_info);
+
+/**
+ * Creates a desktop duplicator for the monitor, which keeps a copy of the
+ * desktop image on the GPU.  Returns NULL if desktop duplication is not
+ * available (windows 8 or higher is required)
+ */
+EXPORT gs_duplicator_t *gs_duplicator_create(int monitor_idx);
+EXPORT void gs_duplicator_destroy(gs_duplicator_t *duplicator);
+
+/**
+ * Copies the regions of the desktop that changed since the last call into the
+ * duplicator texture.  Returns false if access to the desktop was lost (for
+ * example on a mode change or secure desktop), in which case the duplicator
+ * should be destroyed and created again
+ */
+EXPORT bool gs_duplicator_update_frame(gs_duplicator_t *duplicator);
+
+/** Returns the desktop texture, or NULL if no frame has been received yet */
+EXPORT gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator);
 #endif
 
 /* inline functions used by modules */
@@ -744,6 +961,7 @@ static inline uint32_t gs_get_format_bpp(enum gs_color_format format)
 	case GS_DXT1:        return 4;
 	case GS_DXT3:        return 8;
 	case GS_DXT5:        return 8;
+	case GS_R8G8:        return 16;
 	case GS_UNKNOWN:     return 0;
 	}
 
@@ -57,23 +57,32 @@ void matrix4_from_axisang(struct matrix4 *dst, const struct axisang *aa)
 	matrix4_from_quat(dst, &q);
 }
 
+/* each row of the result is the rows of m2 weighted by the elements of the
+ * same row of m1 */
+static inline __m128 mul_row(__m128 row, const struct matrix4 *m)
+{
+	__m128 x = _mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 y = _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 w = _mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128 xy = _mm_add_ps(_mm_mul_ps(x, m->x.m), _mm_mul_ps(y, m->y.m));
+	__m128 zw = _mm_add_ps(_mm_mul_ps(z, m->z.m), _mm_mul_ps(w, m->t.m));
+
+	return _mm_add_ps(xy, zw);
+}
+
 void matrix4_mul(struct matrix4 *dst, const struct matrix4 *m1,
 		const struct matrix4 *m2)
 {
-	const struct vec4 *m1v = (const struct vec4*)m1;
-	const float *m2f = (const float*)m2;
-	struct vec4 out[4];
-	int i, j;
-
-	for (i = 0; i < 4; i++) {
-		for (j=0; j<4; j++) {
-			struct vec4 temp;
-			vec4_set(&temp, m2f[j], m2f[j+4], m2f[j+8], m2f[j+12]);
-			out[i].ptr[j] = vec4_dot(&m1v[i], &temp);
-		}
-	}
-
-	matrix4_copy(dst, (struct matrix4*)out);
+	__m128 x = mul_row(m1->x.m, m2);
+	__m128 y = mul_row(m1->y.m, m2);
+	__m128 z = mul_row(m1->z.m, m2);
+	__m128 t = mul_row(m1->t.m, m2);
+
+	dst->x.m = x;
+	dst->y.m = y;
+	dst->z.m = z;
+	dst->t.m = t;
 }
 
 static inline void get_3x3_submatrix(float *dst, const struct matrix4 *m,
@@ -229,57 +238,105 @@ void matrix4_scale_i(struct matrix4 *dst, const struct vec3 *v,
 	matrix4_mul(dst, &temp, m);
 }
 
+/* inverse by Cramer's rule, based on the SSE implementation from Intel's
+ * "Streaming SIMD Extensions - Inverse of 4x4 Matrix".  the cofactors are
+ * computed four at a time from products of pairs of rows of the transposed
+ * matrix */
 bool matrix4_inv(struct matrix4 *dst, const struct matrix4 *m)
 {
-	struct vec4 *dstv = (struct vec4 *)dst;
-	float det = matrix4_determinant(m);
-	float m3x3[9];
-	int   i, j, sign;
-
-	if (dst == m) {
-		struct matrix4 temp = *m;
-		return matrix4_inv(dst, &temp);
-	}
-
-	dstv = (struct vec4 *)dst;
-	det  = matrix4_determinant(m);
-
-	if (fabs(det) < 0.0005f)
+	__m128 minor0, minor1, minor2, minor3;
+	__m128 row0, row1, row2, row3;
+	__m128 det, tmp;
+
+	row0 = m->x.m;
+	row1 = m->y.m;
+	row2 = m->z.m;
+	row3 = m->t.m;
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+	row1 = _mm_shuffle_ps(row1, row1, 0x4E);
+	row3 = _mm_shuffle_ps(row3, row3, 0x4E);
+
+	tmp    = _mm_mul_ps(row2, row3);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor0 = _mm_mul_ps(row1, tmp);
+	minor1 = _mm_mul_ps(row0, tmp);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(_mm_mul_ps(row1, tmp), minor0);
+	minor1 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor1);
+	minor1 = _mm_shuffle_ps(minor1, minor1, 0x4E);
+
+	tmp    = _mm_mul_ps(row1, row2);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor0 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor0);
+	minor3 = _mm_mul_ps(row0, tmp);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row3, tmp));
+	minor3 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor3);
+	minor3 = _mm_shuffle_ps(minor3, minor3, 0x4E);
+
+	tmp    = _mm_mul_ps(_mm_shuffle_ps(row1, row1, 0x4E), row3);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	row2   = _mm_shuffle_ps(row2, row2, 0x4E);
+	minor0 = _mm_add_ps(_mm_mul_ps(row2, tmp), minor0);
+	minor2 = _mm_mul_ps(row0, tmp);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row2, tmp));
+	minor2 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor2);
+	minor2 = _mm_shuffle_ps(minor2, minor2, 0x4E);
+
+	tmp    = _mm_mul_ps(row0, row1);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor2 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor2);
+	minor3 = _mm_sub_ps(_mm_mul_ps(row2, tmp), minor3);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor2 = _mm_sub_ps(_mm_mul_ps(row3, tmp), minor2);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row2, tmp));
+
+	tmp    = _mm_mul_ps(row0, row3);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row2, tmp));
+	minor2 = _mm_add_ps(_mm_mul_ps(row1, tmp), minor2);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor1 = _mm_add_ps(_mm_mul_ps(row2, tmp), minor1);
+	minor2 = _mm_sub_ps(minor2, _mm_mul_ps(row1, tmp));
+
+	tmp    = _mm_mul_ps(row0, row2);
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor1 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor1);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row1, tmp));
+	tmp    = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row3, tmp));
+	minor3 = _mm_add_ps(_mm_mul_ps(row1, tmp), minor3);
+
+	det = _mm_mul_ps(row0, minor0);
+	det = _mm_add_ps(_mm_shuffle_ps(det, det, 0x4E), det);
+	det = _mm_add_ss(_mm_shuffle_ps(det, det, 0xB1), det);
+
+	if (fabsf(_mm_cvtss_f32(det)) < 0.0005f)
 		return false;
 
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 4; j++) {
-			sign = 1 - ((i+j) % 2) * 2;
-			get_3x3_submatrix(m3x3, m, i, j);
-			dstv[j].ptr[i] = get_3x3_determinant(m3x3) *
-			                  (float)sign / det;
-		}
-	}
+	det = _mm_div_ps(_mm_set1_ps(1.0f),
+			_mm_shuffle_ps(det, det, 0x00));
 
+	dst->x.m = _mm_mul_ps(det, minor0);
+	dst->y.m = _mm_mul_ps(det, minor1);
+	dst->z.m = _mm_mul_ps(det, minor2);
+	dst->t.m = _mm_mul_ps(det, minor3);
 	return true;
 }
 
 void matrix4_transpose(struct matrix4 *dst, const struct matrix4 *m)
 {
-	struct matrix4 temp;
+	__m128 x = m->x.m;
+	__m128 y = m->y.m;
+	__m128 z = m->z.m;
+	__m128 t = m->t.m;
+
+	_MM_TRANSPOSE4_PS(x, y, z, t);
 
-	/* TODO: Add SSE */
-	temp.x.x = m->x.x;
-	temp.x.y = m->y.x;
-	temp.x.z = m->z.x;
-	temp.x.w = m->t.x;
-	temp.y.x = m->x.y;
-	temp.y.y = m->y.y;
-	temp.y.z = m->z.y;
-	temp.y.w = m->t.y;
-	temp.z.x = m->x.z;
-	temp.z.y = m->y.z;
-	temp.z.z = m->z.z;
-	temp.z.w = m->t.z;
-	temp.t.x = m->x.w;
-	temp.t.y = m->y.w;
-	temp.t.z = m->z.w;
-	temp.t.w = m->t.w;
-
-	matrix4_copy(dst, &temp);
+	dst->x.m = x;
+	dst->y.m = y;
+	dst->z.m = z;
+	dst->t.m = t;
 }
@@ -17,6 +17,7 @@
 
 #include "vec3.h"
 #include "vec4.h"
+#include "matrix4.h"
 #include "quat.h"
 #include "axisang.h"
 #include "plane.h"
@@ -55,6 +56,27 @@ void vec3_transform(struct vec3 *dst, const struct vec3 *v,
 	vec3_from_vec4(dst, &v4);
 }
 
+void vec3_transform_array(struct vec3 *dst, const struct vec3 *v,
+		size_t count, const struct matrix4 *m)
+{
+	__m128 mx = m->x.m;
+	__m128 my = m->y.m;
+	__m128 mz = m->z.m;
+	__m128 mt = m->t.m;
+
+	for (size_t i = 0; i < count; i++) {
+		__m128 p = v[i].m;
+		__m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 xy = _mm_add_ps(_mm_mul_ps(x, mx), _mm_mul_ps(y, my));
+		__m128 zt = _mm_add_ps(_mm_mul_ps(z, mz), mt);
+
+		dst[i].m = _mm_add_ps(xy, zt);
+		dst[i].w = 0.0f;
+	}
+}
+
 void vec3_transform3x4(struct vec3 *dst, const struct vec3 *v,
 		const struct matrix3 *m)
 {
@@ -227,6 +227,10 @@ EXPORT float vec3_plane_dist(const struct vec3 *v, const struct plane *p);
 EXPORT void vec3_transform(struct vec3 *dst, const struct vec3 *v,
 		const struct matrix4 *m);
 
+/** Transforms count points at once, dst may be the same array as v */
+EXPORT void vec3_transform_array(struct vec3 *dst, const struct vec3 *v,
+		size_t count, const struct matrix4 *m);
+
 EXPORT void vec3_rotate(struct vec3 *dst, const struct vec3 *v,
 		const struct matrix3 *m);
 EXPORT void vec3_transform3x4(struct vec3 *dst, const struct vec3 *v,
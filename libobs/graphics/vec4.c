@@ -28,15 +28,12 @@ void vec4_from_vec3(struct vec4 *dst, const struct vec3 *v)
 void vec4_transform(struct vec4 *dst, const struct vec4 *v,
 		const struct matrix4 *m)
 {
-	struct vec4 temp;
-	struct matrix4 transpose;
-
-	matrix4_transpose(&transpose, m);
-
-	temp.x = vec4_dot(&transpose.x, v);
-	temp.y = vec4_dot(&transpose.y, v);
-	temp.z = vec4_dot(&transpose.z, v);
-	temp.w = vec4_dot(&transpose.t, v);
-
-	vec4_copy(dst, &temp);
+	__m128 x = _mm_shuffle_ps(v->m, v->m, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 y = _mm_shuffle_ps(v->m, v->m, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_shuffle_ps(v->m, v->m, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 w = _mm_shuffle_ps(v->m, v->m, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128 xy = _mm_add_ps(_mm_mul_ps(x, m->x.m), _mm_mul_ps(y, m->y.m));
+	__m128 zw = _mm_add_ps(_mm_mul_ps(z, m->z.m), _mm_mul_ps(w, m->t.m));
+
+	dst->m = _mm_add_ps(xy, zw);
 }
@@ -0,0 +1,353 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string.h>
+
+#include "../util/c99defs.h"
+#include "../util/simd.h"
+#include "audio-io.h"
+
+/*
+ * Kernels for converting audio to planar float without changing the sample
+ * rate.  The resampler uses these instead of libswresample when a source
+ * only differs from the output in sample format, or in being mono instead
+ * of stereo (or the other way around).
+ */
+
+#define AUDIO_S16_SCALE (1.0f / 32768.0f)
+#define AUDIO_S32_SCALE (1.0f / 2147483648.0f)
+
+/* the levels libswresample uses when remixing between mono and stereo, so
+ * the result sounds the same either way */
+#define AUDIO_REMIX_LEVEL 0.70710678118654752f
+
+static inline void s16_to_float_mono(float *out, const int16_t *in,
+		size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 scale = _mm_set1_ps(AUDIO_S16_SCALE);
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128i v  = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+		_mm_storeu_ps(out + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo),
+					scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi),
+					scale));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t scale = vdupq_n_f32(AUDIO_S16_SCALE);
+
+	for (; i + 8 <= frames; i += 8) {
+		int16x8_t v  = vld1q_s16(in + i);
+		int32x4_t lo = vmovl_s16(vget_low_s16(v));
+		int32x4_t hi = vmovl_s16(vget_high_s16(v));
+
+		vst1q_f32(out + i,     vmulq_f32(vcvtq_f32_s32(lo), scale));
+		vst1q_f32(out + i + 4, vmulq_f32(vcvtq_f32_s32(hi), scale));
+	}
+#endif
+
+	for (; i < frames; i++)
+		out[i] = (float)in[i] * AUDIO_S16_SCALE;
+}
+
+static inline void s16_to_float_stereo(float *left, float *right,
+		const int16_t *in, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 scale = _mm_set1_ps(AUDIO_S16_SCALE);
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128i v  = _mm_loadu_si128((const __m128i*)(in + i * 2));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		__m128  a  = _mm_mul_ps(_mm_cvtepi32_ps(lo), scale);
+		__m128  b  = _mm_mul_ps(_mm_cvtepi32_ps(hi), scale);
+
+		_mm_storeu_ps(left  + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t scale = vdupq_n_f32(AUDIO_S16_SCALE);
+
+	for (; i + 4 <= frames; i += 4) {
+		int16x4x2_t v = vld2_s16(in + i * 2);
+
+		vst1q_f32(left  + i, vmulq_f32(vcvtq_f32_s32(
+						vmovl_s16(v.val[0])), scale));
+		vst1q_f32(right + i, vmulq_f32(vcvtq_f32_s32(
+						vmovl_s16(v.val[1])), scale));
+	}
+#endif
+
+	for (; i < frames; i++) {
+		left[i]  = (float)in[i * 2]     * AUDIO_S16_SCALE;
+		right[i] = (float)in[i * 2 + 1] * AUDIO_S16_SCALE;
+	}
+}
+
+static inline void s32_to_float_mono(float *out, const int32_t *in,
+		size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 scale = _mm_set1_ps(AUDIO_S32_SCALE);
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t scale = vdupq_n_f32(AUDIO_S32_SCALE);
+
+	for (; i + 4 <= frames; i += 4)
+		vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(in + i)),
+					scale));
+#endif
+
+	for (; i < frames; i++)
+		out[i] = (float)in[i] * AUDIO_S32_SCALE;
+}
+
+static inline void s32_to_float_stereo(float *left, float *right,
+		const int32_t *in, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 scale = _mm_set1_ps(AUDIO_S32_SCALE);
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(in + i * 2));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(in + i * 2 + 4));
+		__m128  a  = _mm_mul_ps(_mm_cvtepi32_ps(va), scale);
+		__m128  b  = _mm_mul_ps(_mm_cvtepi32_ps(vb), scale);
+
+		_mm_storeu_ps(left  + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t scale = vdupq_n_f32(AUDIO_S32_SCALE);
+
+	for (; i + 4 <= frames; i += 4) {
+		int32x4x2_t v = vld2q_s32(in + i * 2);
+
+		vst1q_f32(left  + i, vmulq_f32(vcvtq_f32_s32(v.val[0]),
+					scale));
+		vst1q_f32(right + i, vmulq_f32(vcvtq_f32_s32(v.val[1]),
+					scale));
+	}
+#endif
+
+	for (; i < frames; i++) {
+		left[i]  = (float)in[i * 2]     * AUDIO_S32_SCALE;
+		right[i] = (float)in[i * 2 + 1] * AUDIO_S32_SCALE;
+	}
+}
+
+static inline void float_deinterleave_stereo(float *left, float *right,
+		const float *in, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	for (; i + 4 <= frames; i += 4) {
+		__m128 a = _mm_loadu_ps(in + i * 2);
+		__m128 b = _mm_loadu_ps(in + i * 2 + 4);
+
+		_mm_storeu_ps(left  + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b,
+					_MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+#elif defined(SIMD_NEON)
+	for (; i + 4 <= frames; i += 4) {
+		float32x4x2_t v = vld2q_f32(in + i * 2);
+
+		vst1q_f32(left  + i, v.val[0]);
+		vst1q_f32(right + i, v.val[1]);
+	}
+#endif
+
+	for (; i < frames; i++) {
+		left[i]  = in[i * 2];
+		right[i] = in[i * 2 + 1];
+	}
+}
+
+/* fallback for interleaved audio with more than two channels */
+static inline void packed_to_float_planar(float *out[], const uint8_t *in,
+		enum audio_format format, uint32_t channels, size_t frames)
+{
+	const int16_t *in16 = (const int16_t*)in;
+	const int32_t *in32 = (const int32_t*)in;
+	const float   *inf  = (const float*)in;
+
+	for (uint32_t ch = 0; ch < channels; ch++) {
+		float *dst = out[ch];
+
+		for (size_t i = 0; i < frames; i++) {
+			size_t pos = i * channels + ch;
+
+			if (format == AUDIO_FORMAT_16BIT)
+				dst[i] = (float)in16[pos] * AUDIO_S16_SCALE;
+			else if (format == AUDIO_FORMAT_32BIT)
+				dst[i] = (float)in32[pos] * AUDIO_S32_SCALE;
+			else
+				dst[i] = inf[pos];
+		}
+	}
+}
+
+static inline bool audio_format_to_float_supported(enum audio_format format)
+{
+	switch (format) {
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Converts audio in any of the formats audio_format_to_float_supported
+ * accepts to planar float, keeping the channels as they are.  out needs one
+ * plane per channel.
+ */
+static inline void audio_to_float_planar(float *out[],
+		const uint8_t *const in[], enum audio_format format,
+		uint32_t channels, size_t frames)
+{
+	if (is_audio_planar(format)) {
+		for (uint32_t ch = 0; ch < channels; ch++) {
+			if (format == AUDIO_FORMAT_16BIT_PLANAR)
+				s16_to_float_mono(out[ch],
+						(const int16_t*)in[ch], frames);
+			else if (format == AUDIO_FORMAT_32BIT_PLANAR)
+				s32_to_float_mono(out[ch],
+						(const int32_t*)in[ch], frames);
+			else
+				memcpy(out[ch], in[ch], frames * sizeof(float));
+		}
+
+	} else if (channels == 1) {
+		if (format == AUDIO_FORMAT_16BIT)
+			s16_to_float_mono(out[0], (const int16_t*)in[0],
+					frames);
+		else if (format == AUDIO_FORMAT_32BIT)
+			s32_to_float_mono(out[0], (const int32_t*)in[0],
+					frames);
+		else
+			memcpy(out[0], in[0], frames * sizeof(float));
+
+	} else if (channels == 2) {
+		if (format == AUDIO_FORMAT_16BIT)
+			s16_to_float_stereo(out[0], out[1],
+					(const int16_t*)in[0], frames);
+		else if (format == AUDIO_FORMAT_32BIT)
+			s32_to_float_stereo(out[0], out[1],
+					(const int32_t*)in[0], frames);
+		else
+			float_deinterleave_stereo(out[0], out[1],
+					(const float*)in[0], frames);
+
+	} else {
+		packed_to_float_planar(out, in[0], format, channels, frames);
+	}
+}
+
+/* right = left = left * level, in place */
+static inline void upmix_mono_to_stereo(float *left, float *right,
+		size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 level = _mm_set1_ps(AUDIO_REMIX_LEVEL);
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(left + i), level);
+
+		_mm_storeu_ps(left  + i, v);
+		_mm_storeu_ps(right + i, v);
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t level = vdupq_n_f32(AUDIO_REMIX_LEVEL);
+
+	for (; i + 4 <= frames; i += 4) {
+		float32x4_t v = vmulq_f32(vld1q_f32(left + i), level);
+
+		vst1q_f32(left  + i, v);
+		vst1q_f32(right + i, v);
+	}
+#endif
+
+	for (; i < frames; i++)
+		right[i] = left[i] = left[i] * AUDIO_REMIX_LEVEL;
+}
+
+/* out may be the same buffer as left */
+static inline void downmix_stereo_to_mono(float *out, const float *left,
+		const float *right, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 level = _mm_set1_ps(AUDIO_REMIX_LEVEL);
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 v = _mm_add_ps(_mm_loadu_ps(left  + i),
+		                      _mm_loadu_ps(right + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(v, level));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t level = vdupq_n_f32(AUDIO_REMIX_LEVEL);
+
+	for (; i + 4 <= frames; i += 4) {
+		float32x4_t v = vaddq_f32(vld1q_f32(left  + i),
+		                          vld1q_f32(right + i));
+		vst1q_f32(out + i, vmulq_f32(v, level));
+	}
+#endif
+
+	for (; i < frames; i++)
+		out[i] = (left[i] + right[i]) * AUDIO_REMIX_LEVEL;
+}
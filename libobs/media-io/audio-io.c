@@ -22,34 +22,73 @@
 #include "../util/darray.h"
 #include "../util/circlebuf.h"
 #include "../util/platform.h"
+#include "../util/profiler.h"
 
 #include "audio-io.h"
+#include "audio-mix.h"
 #include "audio-resampler.h"
 
 /* #define DEBUG_AUDIO */
 
 #define nop() do {int invalid = 0;} while(0)
 
-struct audio_input {
-	struct audio_convert_info conversion;
-	audio_resampler_t         *resampler;
-
+struct audio_callback {
 	void (*callback)(void *param, struct audio_data *data);
 	void *param;
 };
 
+/* connections asking for the same conversion share one input, so the data is
+ * only resampled once for all of them.  if the conversion matches the output
+ * format there is no resampler, and the mix is passed through as-is */
+struct audio_input {
+	struct audio_convert_info     conversion;
+	audio_resampler_t             *resampler;
+
+	DARRAY(struct audio_callback) callbacks;
+};
+
 static inline void audio_input_free(struct audio_input *input)
 {
 	audio_resampler_destroy(input->resampler);
+	da_free(input->callbacks);
 }
 
+struct audio_mix {
+	DARRAY(struct audio_input) inputs;
+	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
+};
+
+/* number of packets that can be queued on a line between mixes.  the audio
+ * thread mixes 40 times a second, so this is plenty for any capture period */
+#define AUDIO_LINE_QUEUE_SIZE 64
+
+/* audio data submitted to a line, with the volume already applied */
+struct audio_line_packet {
+	DARRAY(uint8_t)            data[MAX_AV_PLANES];
+	uint32_t                   frames;
+	uint64_t                   timestamp;
+};
+
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
+
+	/* single producer/single consumer queue from the thread calling
+	 * audio_line_output to the audio thread.  the producer only writes
+	 * write_pos, the consumer only writes read_pos, so neither ever waits
+	 * on the other.  one slot is always left empty to tell full from
+	 * empty */
+	struct audio_line_packet   queue[AUDIO_LINE_QUEUE_SIZE];
+	volatile long              write_pos;
+	volatile long              read_pos;
+	long                       packets_dropped;
+
+	/* mask of the mixes this line is mixed in to */
+	volatile long              mixers;
+
+	/* everything below is only accessed by the audio thread */
 	struct circlebuf           buffers[MAX_AV_PLANES];
-	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -57,7 +96,7 @@ struct audio_line {
 
 	/* states whether this line is still being used.  if not, then when the
 	 * buffer is depleted, it's destroyed */
-	bool                       alive;
+	volatile bool              alive;
 
 	struct audio_line          **prev_next;
 	struct audio_line          *next;
@@ -65,16 +104,24 @@ struct audio_line {
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
-	}
 
-	pthread_mutex_destroy(&line->mutex);
+	for (size_t i = 0; i < AUDIO_LINE_QUEUE_SIZE; i++)
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			da_free(line->queue[i].data[j]);
+
+	if (line->packets_dropped)
+		blog(LOG_DEBUG, "Audio line '%s' dropped %ld packets because "
+		                "its queue was full", line->name,
+		                line->packets_dropped);
+
 	bfree(line->name);
 	bfree(line);
 }
 
+static void audio_line_process_queue(struct audio_line *line);
+
 struct audio_output {
 	struct audio_output_info   info;
 	size_t                     block_size;
@@ -84,15 +131,27 @@ struct audio_output {
 	pthread_t                  thread;
 	os_event_t                 *stop_event;
 
-	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
-
 	bool                       initialized;
 
 	pthread_mutex_t            line_mutex;
 	struct audio_line          *first_line;
 
+	/* all mixes are made in one pass over the lines, mixes without any
+	 * inputs are skipped */
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct audio_input) inputs;
+	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+
+	/* buffering used by the mix.  with adaptive buffering, max_delay_ns
+	 * is the latest any line's data arrived on the audio thread in the
+	 * current measurement window */
+	volatile long              buffer_ms;
+	uint64_t                   max_delay_ns;
+	size_t                     delay_cycles;
+
+	/* clock set by audio_output_set_time for offline rendering, 0 while
+	 * the mix follows the system clock */
+	volatile int64_t           clock_time;
+	os_event_t                 *clock_event;
 };
 
 static inline void audio_output_removeline(struct audio_output *audio,
@@ -166,7 +225,7 @@ static inline void clear_excess_audio_data(struct audio_line *line,
 		size_t clear_size = (size < line->buffers[i].size) ?
 			size : line->buffers[i].size;
 
-		circlebuf_pop_front(&line->buffers[i], NULL, clear_size);
+		circlebuf_consume(&line->buffers[i], clear_size);
 	}
 }
 
@@ -185,39 +244,28 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-#define MIX_BUFFER_SIZE 256
-
-/* TODO: optimize mixing */
-static void mix_float(uint8_t *mix_in, struct circlebuf *buf, size_t size)
+/* mixes directly from the circular buffer's contiguous regions rather than
+ * popping through an intermediate buffer */
+static void mix_float(uint8_t *mix_in, const struct circlebuf_span *span)
 {
 	float *mix = (float*)mix_in;
-	float vals[MIX_BUFFER_SIZE];
-	register float mix_val;
-
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
-
-		circlebuf_pop_front(buf, vals, pop_count);
-		pop_count /= sizeof(float);
-
-		/* This sequence provides hints for MSVC to use packed SSE 
-		 * instructions addps, minps, maxps, etc. */
-		for (size_t i = 0; i < pop_count; i++) {
-			mix_val =  *mix + vals[i];
-
-			/* clamp confuses the optimisation */
-			mix_val = (mix_val >  1.0f) ?  1.0f : mix_val; 
-			mix_val = (mix_val < -1.0f) ? -1.0f : mix_val;
 
-			*(mix++) = mix_val;
-		}
-	}
+	mix_float_span(mix, (float*)span->data[0],
+			span->size[0] / sizeof(float));
+	if (span->size[1])
+		mix_float_span(mix + span->size[0] / sizeof(float),
+				(float*)span->data[1],
+				span->size[1] / sizeof(float));
 }
 
+/* the line's data is read once and mixed in to every active mix it belongs
+ * to before being removed from the line */
 static inline bool mix_audio_line(struct audio_output *audio,
-		struct audio_line *line, size_t size, uint64_t timestamp)
+		struct audio_line *line, size_t size, uint64_t timestamp,
+		long active_mixes)
 {
+	long mixers = os_atomic_load_long(&line->mixers) & active_mixes;
+
 	size_t time_offset = ts_diff_bytes(audio,
 			line->base_timestamp, timestamp);
 	if (time_offset > size)
@@ -231,9 +279,19 @@ static inline bool mix_audio_line(struct audio_output *audio,
 
 	for (size_t i = 0; i < audio->planes; i++) {
 		size_t pop_size = min_size(size, line->buffers[i].size);
+		struct circlebuf_span span;
 
-		mix_float(audio->mix_buffers[i].array + time_offset,
-				&line->buffers[i], pop_size);
+		circlebuf_peek_front_span(&line->buffers[i], pop_size, &span);
+
+		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+			struct audio_mix *mix = &audio->mixes[mix_idx];
+
+			if ((mixers & (1 << mix_idx)) != 0)
+				mix_float(mix->mix_buffers[i].array +
+						time_offset, &span);
+		}
+
+		circlebuf_consume(&line->buffers[i], pop_size);
 	}
 
 	return true;
@@ -266,25 +324,51 @@ static bool resample_audio_output(struct audio_input *input,
 }
 
 static inline void do_audio_output(struct audio_output *audio,
-		uint64_t timestamp, uint32_t frames)
+		size_t mix_idx, uint64_t timestamp, uint32_t frames)
 {
+	struct audio_mix *mix = &audio->mixes[mix_idx];
 	struct audio_data data;
-	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		data.data[i] = audio->mix_buffers[i].array;
-	data.frames = frames;
-	data.timestamp = timestamp;
-	data.volume = 1.0f;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	os_mutex_lock(&audio->input_mutex, "input_mutex");
+
+	for (size_t i = 0; i < mix->inputs.num; i++) {
+		struct audio_input *input = mix->inputs.array+i;
+
+		/* resampling replaces the data pointers */
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			data.data[j] = mix->mix_buffers[j].array;
+		data.frames    = frames;
+		data.timestamp = timestamp;
+		data.volume    = 1.0f;
+
+		if (!resample_audio_output(input, &data))
+			continue;
+
+		/* each callback gets its own copy of the data info */
+		for (size_t j = 0; j < input->callbacks.num; j++) {
+			struct audio_callback *cb = input->callbacks.array+j;
+			struct audio_data     cb_data = data;
+
+			cb->callback(cb->param, &cb_data);
+		}
+	}
+
+	os_mutex_unlock(&audio->input_mutex, "input_mutex");
+}
+
+static long get_active_mixes(struct audio_output *audio)
+{
+	long active_mixes = 0;
 
-	for (size_t i = 0; i < audio->inputs.num; i++) {
-		struct audio_input *input = audio->inputs.array+i;
+	os_mutex_lock(&audio->input_mutex, "input_mutex");
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, &data);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (audio->mixes[i].inputs.num)
+			active_mixes |= (1 << i);
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	os_mutex_unlock(&audio->input_mutex, "input_mutex");
+	return active_mixes;
 }
 
 static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
@@ -294,6 +378,7 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	uint32_t frames = (uint32_t)ts_diff_frames(audio, audio_time,
 	                                           prev_time);
 	size_t bytes = frames * audio->block_size;
+	long active_mixes = get_active_mixes(audio);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "audio_time: %llu, prev_time: %llu, bytes: %lu",
@@ -305,65 +390,162 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 	audio_time = prev_time + conv_frames_to_time(audio, frames);
 
 	/* resize and clear mix buffers */
-	for (size_t i = 0; i < audio->planes; i++) {
-		da_resize(audio->mix_buffers[i], bytes);
-		memset(audio->mix_buffers[i].array, 0, bytes);
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix *mix = &audio->mixes[mix_idx];
+
+		if ((active_mixes & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t i = 0; i < audio->planes; i++) {
+			da_resize(mix->mix_buffers[i], bytes);
+			memset(mix->mix_buffers[i].array, 0, bytes);
+		}
 	}
 
 	/* mix audio lines */
 	while (line) {
 		struct audio_line *next = line->next;
 
+		/* checked before taking queued data, nothing is queued on a
+		 * line once it's been destroyed */
+		bool alive = line->alive;
+
+		audio_line_process_queue(line);
+
 		/* if line marked for removal, destroy and move to the next */
 		if (!line->buffers[0].size) {
-			if (!line->alive) {
+			if (!alive) {
 				audio_output_removeline(audio, line);
 				line = next;
 				continue;
 			}
 		}
 
-		pthread_mutex_lock(&line->mutex);
-
 		if (line->buffers[0].size && line->base_timestamp < prev_time) {
 			clear_excess_audio_data(line, prev_time);
 			line->base_timestamp = prev_time;
 		}
 
-		if (mix_audio_line(audio, line, bytes, prev_time))
+		if (mix_audio_line(audio, line, bytes, prev_time,
+					active_mixes))
 			line->base_timestamp = audio_time;
 
-		pthread_mutex_unlock(&line->mutex);
-
 		line = next;
 	}
 
 	/* output */
-	do_audio_output(audio, prev_time, frames);
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((active_mixes & (1 << mix_idx)) != 0)
+			do_audio_output(audio, mix_idx, prev_time, frames);
+	}
 
 	return audio_time;
 }
 
+/* only takes queued data, used while the mix waits for the buffering to
+ * grow */
+static void process_line_queues(struct audio_output *audio)
+{
+	for (struct audio_line *line = audio->first_line; line;
+			line = line->next)
+		audio_line_process_queue(line);
+}
+
 /* sample audio 40 times a second */
 #define AUDIO_WAIT_TIME (1000/40)
 
+/* adaptive buffering is kept this far above the measured delay, which covers
+ * data arriving just after a mix */
+#define BUFFER_MARGIN_MS      AUDIO_WAIT_TIME
+/* the buffering is shrunk by at most BUFFER_SHRINK_MS every
+ * BUFFER_WINDOW_CYCLES mixes (2 seconds), it grows as soon as data arrives
+ * too late for it */
+#define BUFFER_WINDOW_CYCLES  80
+#define BUFFER_SHRINK_MS      5
+
+static uint64_t update_buffering(struct audio_output *audio)
+{
+	long buffer_ms = audio->buffer_ms;
+	long target_ms;
+
+	if (!audio->info.adaptive_buffering)
+		return (uint64_t)buffer_ms * 1000000;
+
+	target_ms = (long)(audio->max_delay_ns / 1000000) + BUFFER_MARGIN_MS;
+	if (target_ms > (long)audio->info.buffer_ms)
+		target_ms = (long)audio->info.buffer_ms;
+
+	if (target_ms > buffer_ms) {
+		buffer_ms = target_ms;
+
+	} else if (++audio->delay_cycles >= BUFFER_WINDOW_CYCLES) {
+		if (target_ms < buffer_ms - BUFFER_SHRINK_MS)
+			target_ms = buffer_ms - BUFFER_SHRINK_MS;
+		buffer_ms = target_ms;
+
+		audio->max_delay_ns = 0;
+		audio->delay_cycles = 0;
+	}
+
+	if (buffer_ms != audio->buffer_ms) {
+#ifdef DEBUG_AUDIO
+		blog(LOG_DEBUG, "audio buffering changed to %ld ms",
+				buffer_ms);
+#endif
+		os_atomic_set_long(&audio->buffer_ms, buffer_ms);
+	}
+
+	return (uint64_t)buffer_ms * 1000000;
+}
+
+/* returns the time to mix up to (before buffering), which offline is the
+ * external clock, mixed as soon as it advances */
+static inline uint64_t wait_for_mix_time(struct audio_output *audio)
+{
+	if (os_atomic_load_64(&audio->clock_time)) {
+		os_event_timedwait(audio->clock_event, AUDIO_WAIT_TIME);
+		return (uint64_t)os_atomic_load_64(&audio->clock_time);
+	}
+
+	os_sleep_ms(AUDIO_WAIT_TIME);
+	return os_gettime_ns();
+}
+
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
-	uint64_t buffer_time = audio->info.buffer_ms * 1000000;
+	uint64_t buffer_time = (uint64_t)audio->buffer_ms * 1000000;
 	uint64_t prev_time = os_gettime_ns() - buffer_time;
 	uint64_t audio_time;
+	uint64_t mix_time;
+
+	os_set_thread_role(OS_THREAD_ROLE_AUDIO);
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
-		os_sleep_ms(AUDIO_WAIT_TIME);
+		mix_time = wait_for_mix_time(audio);
+
+		profile_start("audio_thread");
 
 		pthread_mutex_lock(&audio->line_mutex);
 
-		audio_time = os_gettime_ns() - buffer_time;
-		audio_time = mix_and_output(audio, audio_time, prev_time);
-		prev_time  = audio_time;
+		buffer_time = update_buffering(audio);
+		audio_time  = mix_time - buffer_time;
+
+		/* after the buffering grows, the mix stalls until the time
+		 * catches up with what was already output */
+		if (audio_time > prev_time) {
+			profile_start("mix_and_output");
+			audio_time = mix_and_output(audio, audio_time,
+					prev_time);
+			prev_time  = audio_time;
+			profile_end("mix_and_output");
+		} else {
+			process_line_queues(audio);
+		}
 
 		pthread_mutex_unlock(&audio->line_mutex);
+
+		profile_end("audio_thread");
 	}
 
 	return NULL;
@@ -371,19 +553,49 @@ static void *audio_thread(void *param)
 
 /* ------------------------------------------------------------------------- */
 
-static size_t audio_get_input_idx(const audio_t *video,
+static size_t audio_get_input_idx(const audio_t *video, size_t mix_idx,
 		void (*callback)(void *param, struct audio_data *data),
-		void *param)
+		void *param, size_t *cb_idx)
 {
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct audio_input *input = video->inputs.array+i;
-		if (input->callback == callback && input->param == param)
-			return i;
+	const struct audio_mix *mix = &video->mixes[mix_idx];
+
+	for (size_t i = 0; i < mix->inputs.num; i++) {
+		struct audio_input *input = mix->inputs.array+i;
+
+		for (size_t j = 0; j < input->callbacks.num; j++) {
+			struct audio_callback *cb = input->callbacks.array+j;
+
+			if (cb->callback == callback && cb->param == param) {
+				if (cb_idx)
+					*cb_idx = j;
+				return i;
+			}
+		}
 	}
 
 	return DARRAY_INVALID;
 }
 
+static inline bool conversion_equal(const struct audio_convert_info *a,
+		const struct audio_convert_info *b)
+{
+	return a->format          == b->format          &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers        == b->speakers;
+}
+
+static struct audio_input *find_conversion(struct audio_mix *mix,
+		const struct audio_convert_info *conversion)
+{
+	for (size_t i = 0; i < mix->inputs.num; i++) {
+		struct audio_input *input = mix->inputs.array+i;
+		if (conversion_equal(&input->conversion, conversion))
+			return input;
+	}
+
+	return NULL;
+}
+
 static inline bool audio_input_init(struct audio_input *input,
 		struct audio_output *audio)
 {
@@ -415,21 +627,23 @@ static inline bool audio_input_init(struct audio_input *input,
 	return true;
 }
 
-bool audio_output_connect(audio_t *audio,
+bool audio_output_connect(audio_t *audio, size_t mix_idx,
 		const struct audio_convert_info *conversion,
 		void (*callback)(void *param, struct audio_data *data),
 		void *param)
 {
 	bool success = false;
 
-	if (!audio) return false;
+	if (!audio || mix_idx >= MAX_AUDIO_MIXES) return false;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	os_mutex_lock(&audio->input_mutex, "input_mutex");
 
-	if (audio_get_input_idx(audio, callback, param) == DARRAY_INVALID) {
-		struct audio_input input;
-		input.callback = callback;
-		input.param    = param;
+	if (audio_get_input_idx(audio, mix_idx, callback, param, NULL) ==
+			DARRAY_INVALID) {
+		struct audio_mix      *mix = &audio->mixes[mix_idx];
+		struct audio_input    *existing;
+		struct audio_input    input = {0};
+		struct audio_callback cb = {callback, param};
 
 		if (conversion) {
 			input.conversion = *conversion;
@@ -448,31 +662,49 @@ bool audio_output_connect(audio_t *audio,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
-		if (success)
-			da_push_back(audio->inputs, &input);
+		existing = find_conversion(mix, &input.conversion);
+		if (existing) {
+			da_push_back(existing->callbacks, &cb);
+			success = true;
+
+		} else {
+			success = audio_input_init(&input, audio);
+			if (success) {
+				da_push_back(input.callbacks, &cb);
+				da_push_back(mix->inputs, &input);
+			}
+		}
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	os_mutex_unlock(&audio->input_mutex, "input_mutex");
 
 	return success;
 }
 
-void audio_output_disconnect(audio_t *audio,
+void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 		void (*callback)(void *param, struct audio_data *data),
 		void *param)
 {
-	if (!audio) return;
+	if (!audio || mix_idx >= MAX_AUDIO_MIXES) return;
 
-	pthread_mutex_lock(&audio->input_mutex);
+	os_mutex_lock(&audio->input_mutex, "input_mutex");
 
-	size_t idx = audio_get_input_idx(audio, callback, param);
+	size_t cb_idx;
+	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param,
+			&cb_idx);
 	if (idx != DARRAY_INVALID) {
-		audio_input_free(audio->inputs.array+idx);
-		da_erase(audio->inputs, idx);
+		struct audio_mix   *mix   = &audio->mixes[mix_idx];
+		struct audio_input *input = mix->inputs.array+idx;
+
+		da_erase(input->callbacks, cb_idx);
+
+		if (!input->callbacks.num) {
+			audio_input_free(input);
+			da_erase(mix->inputs, idx);
+		}
 	}
 
-	pthread_mutex_unlock(&audio->input_mutex);
+	os_mutex_unlock(&audio->input_mutex, "input_mutex");
 }
 
 static inline bool valid_audio_params(const struct audio_output_info *info)
@@ -500,6 +732,7 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 	out->planes     = planar ? out->channels : 1;
 	out->block_size = (planar ? 1 : out->channels) *
 	                  get_audio_bytes_per_channel(info->format);
+	out->buffer_ms  = (long)info->buffer_ms;
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -511,6 +744,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (os_event_init(&out->clock_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
 		goto fail;
 
@@ -543,13 +778,19 @@ void audio_output_close(audio_t *audio)
 		line = next;
 	}
 
-	for (size_t i = 0; i < audio->inputs.num; i++)
-		audio_input_free(audio->inputs.array+i);
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		struct audio_mix *mix = &audio->mixes[mix_idx];
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		da_free(audio->mix_buffers[i]);
+		for (size_t i = 0; i < mix->inputs.num; i++)
+			audio_input_free(mix->inputs.array+i);
 
-	da_free(audio->inputs);
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			da_free(mix->mix_buffers[i]);
+
+		da_free(mix->inputs);
+	}
+
+	os_event_destroy(audio->clock_event);
 	os_event_destroy(audio->stop_event);
 	pthread_mutex_destroy(&audio->line_mutex);
 	bfree(audio);
@@ -560,15 +801,9 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name)
 	if (!audio) return NULL;
 
 	struct audio_line *line = bzalloc(sizeof(struct audio_line));
-	line->alive = true;
-	line->audio = audio;
-
-	if (pthread_mutex_init(&line->mutex, NULL) != 0) {
-		blog(LOG_ERROR, "audio_output_createline: Failed to create "
-		                "mutex");
-		bfree(line);
-		return NULL;
-	}
+	line->alive  = true;
+	line->audio  = audio;
+	line->mixers = (1 << MAX_AUDIO_MIXES) - 1;
 
 	pthread_mutex_lock(&audio->line_mutex);
 
@@ -591,20 +826,38 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_set_time(audio_t *audio, uint64_t time)
+{
+	if (!audio)
+		return;
+
+	os_atomic_set_64(&audio->clock_time, (int64_t)time);
+	os_event_signal(audio->clock_event);
+}
+
+uint64_t audio_output_get_buffer_ms(const audio_t *audio)
+{
+	return audio ? (uint64_t)os_atomic_load_long(&audio->buffer_ms) : 0;
+}
+
+/* the line's buffers belong to the audio thread, so it's left to that thread
+ * to remove the line once it has output whatever is still queued */
 void audio_line_destroy(struct audio_line *line)
 {
-	if (line) {
-		if (!line->buffers[0].size)
-			audio_output_removeline(line->audio, line);
-		else
-			line->alive = false;
-	}
+	if (line)
+		line->alive = false;
 }
 
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio) return false;
-	return audio->inputs.num != 0;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (audio->mixes[i].inputs.num != 0)
+			return true;
+	}
+
+	return false;
 }
 
 size_t audio_output_get_block_size(const audio_t *audio)
@@ -627,6 +880,17 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
+void audio_line_set_mixers(audio_line_t *line, uint32_t mixers)
+{
+	if (line)
+		os_atomic_set_long(&line->mixers, (long)mixers);
+}
+
+uint32_t audio_line_get_mixers(const audio_line_t *line)
+{
+	return line ? (uint32_t)os_atomic_load_long(&line->mixers) : 0;
+}
+
 /* TODO: optimize these two functions */
 static inline void mul_vol_float(float *array, float volume, size_t count)
 {
@@ -635,32 +899,13 @@ static inline void mul_vol_float(float *array, float volume, size_t count)
 }
 
 static void audio_line_place_data_pos(struct audio_line *line,
-		const struct audio_data *data, size_t position)
+		const struct audio_line_packet *packet, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
-	size_t total_size = data->frames * line->audio->block_size;
-
-	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
-
-		uint8_t *array = line->volume_buffers[i].array;
-
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float((float*)array, data->volume, total_num);
-			break;
-		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-			                "Unsupported or unknown format");
-			break;
-		}
+	size_t total_size = packet->frames * line->audio->block_size;
 
+	for (size_t i = 0; i < line->audio->planes; i++)
 		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
-	}
+				packet->data[i].array, total_size);
 }
 
 static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
@@ -683,24 +928,24 @@ static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
 }
 
 static void audio_line_place_data(struct audio_line *line,
-		const struct audio_data *data)
+		const struct audio_line_packet *packet)
 {
 	size_t pos;
-	uint64_t timestamp = smooth_ts(line, data->timestamp);
+	uint64_t timestamp = smooth_ts(line, packet->timestamp);
 
 	pos = ts_diff_bytes(line->audio, timestamp, line->base_timestamp);
 	line->next_ts_min =
-		timestamp + conv_frames_to_time(line->audio, data->frames);
+		timestamp + conv_frames_to_time(line->audio, packet->frames);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "data->timestamp: %llu, line->base_timestamp: %llu, "
 			"pos: %lu, bytes: %lu, buf size: %lu",
 			timestamp, line->base_timestamp, pos,
-			data->frames * line->audio->block_size,
+			packet->frames * line->audio->block_size,
 			line->buffers[0].size);
 #endif
 
-	audio_line_place_data_pos(line, data, pos);
+	audio_line_place_data_pos(line, packet, pos);
 }
 
 #define MAX_DELAY_NS 6000000000ULL
@@ -714,28 +959,90 @@ static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
 	return ts >= line->base_timestamp && ts < max_ts;
 }
 
-void audio_line_output(audio_line_t *line, const struct audio_data *data)
+static void audio_line_insert(struct audio_line *line,
+		const struct audio_line_packet *packet)
 {
-	if (!line || !data) return;
-
-	pthread_mutex_lock(&line->mutex);
-
 	if (!line->buffers[0].size) {
-		line->base_timestamp = data->timestamp -
-		                       line->audio->info.buffer_ms * 1000000;
-		audio_line_place_data(line, data);
+		line->base_timestamp = packet->timestamp -
+		                       (uint64_t)line->audio->buffer_ms * 1000000;
+		audio_line_place_data(line, packet);
 
-	} else if (valid_timestamp_range(line, data->timestamp)) {
-		audio_line_place_data(line, data);
+	} else if (valid_timestamp_range(line, packet->timestamp)) {
+		audio_line_place_data(line, packet);
 
 	} else {
 		blog(LOG_DEBUG, "Bad timestamp for audio line '%s', "
 		                "data->timestamp: %"PRIu64", "
 		                "line->base_timestamp: %"PRIu64".  This can "
 		                "sometimes happen when there's a pause in "
-		                "the threads.", line->name, data->timestamp,
+		                "the threads.", line->name, packet->timestamp,
 		                line->base_timestamp);
 	}
+}
+
+/* called on the audio thread before mixing the line */
+static void audio_line_process_queue(struct audio_line *line)
+{
+	struct audio_output *audio = line->audio;
+	long read_pos  = line->read_pos;
+	long write_pos = os_atomic_load_long(&line->write_pos);
+	uint64_t now   = audio->info.adaptive_buffering ? os_gettime_ns() : 0;
+
+	while (read_pos != write_pos) {
+		const struct audio_line_packet *packet = &line->queue[read_pos];
+
+		/* how long it took the data to get to the mix */
+		if (now > packet->timestamp &&
+		    now - packet->timestamp > audio->max_delay_ns)
+			audio->max_delay_ns = now - packet->timestamp;
+
+		audio_line_insert(line, packet);
+
+		read_pos = (read_pos + 1) % AUDIO_LINE_QUEUE_SIZE;
+		os_atomic_set_long(&line->read_pos, read_pos);
+	}
+}
+
+void audio_line_output(audio_line_t *line, const struct audio_data *data)
+{
+	struct audio_line_packet *packet;
+	long write_pos, next_pos;
+	bool planar;
+	size_t total_num, total_size;
+
+	if (!line || !data) return;
+
+	write_pos = line->write_pos;
+	next_pos  = (write_pos + 1) % AUDIO_LINE_QUEUE_SIZE;
+
+	if (next_pos == os_atomic_load_long(&line->read_pos)) {
+		os_atomic_inc_long(&line->packets_dropped);
+		return;
+	}
+
+	packet     = &line->queue[write_pos];
+	planar     = line->audio->planes > 1;
+	total_num  = data->frames * (planar ? 1 : line->audio->channels);
+	total_size = data->frames * line->audio->block_size;
+
+	for (size_t i = 0; i < line->audio->planes; i++) {
+		da_copy_array(packet->data[i], data->data[i], total_size);
+
+		switch (line->audio->info.format) {
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR:
+			mul_vol_float((float*)packet->data[i].array,
+					data->volume, total_num);
+			break;
+		default:
+			blog(LOG_ERROR, "audio_line_output: "
+			                "Unsupported or unknown format");
+			break;
+		}
+	}
+
+	packet->frames    = data->frames;
+	packet->timestamp = data->timestamp;
 
-	pthread_mutex_unlock(&line->mutex);
+	os_atomic_set_long(&line->write_pos, next_pos);
 }
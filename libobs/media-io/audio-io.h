@@ -76,6 +76,10 @@ struct audio_output_info {
 	enum audio_format   format;
 	enum speaker_layout speakers;
 	uint64_t            buffer_ms;
+
+	/* if set, buffer_ms is the maximum buffering, and the actual buffering
+	 * follows how late the audio lines' data arrives */
+	bool                adaptive_buffering;
 };
 
 struct audio_convert_info {
@@ -165,6 +169,9 @@ static inline size_t get_audio_size(enum audio_format format,
 	       frames;
 }
 
+/* number of separate mixes (tracks) an audio output produces */
+#define MAX_AUDIO_MIXES 4
+
 #define AUDIO_OUTPUT_SUCCESS       0
 #define AUDIO_OUTPUT_INVALIDPARAM -1
 #define AUDIO_OUTPUT_FAIL         -2
@@ -172,11 +179,11 @@ static inline size_t get_audio_size(enum audio_format format,
 EXPORT int audio_output_open(audio_t **audio, struct audio_output_info *info);
 EXPORT void audio_output_close(audio_t *audio);
 
-EXPORT bool audio_output_connect(audio_t *video,
+EXPORT bool audio_output_connect(audio_t *video, size_t mix_idx,
 		const struct audio_convert_info *conversion,
 		void (*callback)(void *param, struct audio_data *data),
 		void *param);
-EXPORT void audio_output_disconnect(audio_t *video,
+EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx,
 		void (*callback)(void *param, struct audio_data *data),
 		void *param);
 
@@ -189,10 +196,24 @@ EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
+/* drives the mix from an external clock instead of the system time, for
+ * offline rendering.  once called, the mix only advances as the time is set,
+ * until it's set to 0 */
+EXPORT void audio_output_set_time(audio_t *audio, uint64_t time);
+
+/* returns the buffering currently used by the mix, in milliseconds.  this is
+ * always buffer_ms unless adaptive buffering is enabled */
+EXPORT uint64_t audio_output_get_buffer_ms(const audio_t *audio);
+
 EXPORT audio_line_t *audio_output_create_line(audio_t *audio, const char *name);
 EXPORT void audio_line_destroy(audio_line_t *line);
 EXPORT void audio_line_output(audio_line_t *line, const struct audio_data *data);
 
+/* sets the mask of mixes (1 << mix_idx) the line is mixed in to, by default
+ * a line is in all mixes */
+EXPORT void audio_line_set_mixers(audio_line_t *line, uint32_t mixers);
+EXPORT uint32_t audio_line_get_mixers(const audio_line_t *line);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,71 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "../util/simd.h"
+
+/*
+ * Mixes one contiguous span of samples into the mix buffer, clamping the
+ * result.  The kernel is bound by memory bandwidth, so wider vectors than
+ * the base SSE2/NEON would not gain anything here.
+ */
+static inline void mix_float_span(float *mix, const float *vals, size_t count)
+{
+	size_t i = 0;
+
+#if defined(SIMD_SSE2)
+	const __m128 max_val = _mm_set1_ps( 1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_add_ps(_mm_loadu_ps(mix  + i),
+		                      _mm_loadu_ps(vals + i));
+		__m128 b = _mm_add_ps(_mm_loadu_ps(mix  + i + 4),
+		                      _mm_loadu_ps(vals + i + 4));
+
+		_mm_storeu_ps(mix + i,     _mm_min_ps(_mm_max_ps(a, min_val),
+					max_val));
+		_mm_storeu_ps(mix + i + 4, _mm_min_ps(_mm_max_ps(b, min_val),
+					max_val));
+	}
+
+#elif defined(SIMD_NEON)
+	const float32x4_t max_val = vdupq_n_f32( 1.0f);
+	const float32x4_t min_val = vdupq_n_f32(-1.0f);
+
+	for (; i + 8 <= count; i += 8) {
+		float32x4_t a = vaddq_f32(vld1q_f32(mix  + i),
+		                          vld1q_f32(vals + i));
+		float32x4_t b = vaddq_f32(vld1q_f32(mix  + i + 4),
+		                          vld1q_f32(vals + i + 4));
+
+		vst1q_f32(mix + i,     vminq_f32(vmaxq_f32(a, min_val),
+					max_val));
+		vst1q_f32(mix + i + 4, vminq_f32(vmaxq_f32(b, min_val),
+					max_val));
+	}
+#endif
+
+	for (; i < count; i++) {
+		float mix_val = mix[i] + vals[i];
+
+		mix_val = (mix_val >  1.0f) ?  1.0f : mix_val;
+		mix_val = (mix_val < -1.0f) ? -1.0f : mix_val;
+
+		mix[i] = mix_val;
+	}
+}
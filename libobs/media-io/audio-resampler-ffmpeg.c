@@ -17,15 +17,29 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-conversion.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
+enum remix_type {
+	REMIX_NONE,
+	REMIX_MONO_TO_STEREO,
+	REMIX_STEREO_TO_MONO,
+};
+
 struct audio_resampler {
 	struct SwrContext   *context;
 	bool                opened;
 
+	/* same sample rate: converted by the kernels in audio-conversion.h
+	 * rather than by libswresample */
+	bool                direct;
+	enum audio_format   direct_format;
+	enum remix_type     remix;
+	uint32_t            input_ch;
+
 	uint32_t            input_freq;
 	uint64_t            input_layout;
 	enum AVSampleFormat input_format;
@@ -77,6 +91,30 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
+static bool get_direct_remix(const struct resample_info *dst,
+		const struct resample_info *src, enum remix_type *remix)
+{
+	if (src->samples_per_sec != dst->samples_per_sec)
+		return false;
+	if (dst->format != AUDIO_FORMAT_FLOAT_PLANAR)
+		return false;
+	if (!audio_format_to_float_supported(src->format))
+		return false;
+
+	if (src->speakers == dst->speakers)
+		*remix = REMIX_NONE;
+	else if (src->speakers == SPEAKERS_MONO &&
+	         dst->speakers == SPEAKERS_STEREO)
+		*remix = REMIX_MONO_TO_STEREO;
+	else if (src->speakers == SPEAKERS_STEREO &&
+	         dst->speakers == SPEAKERS_MONO)
+		*remix = REMIX_STEREO_TO_MONO;
+	else
+		return false;
+
+	return src->speakers != SPEAKERS_UNKNOWN;
+}
+
 audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 		const struct resample_info *src)
 {
@@ -93,6 +131,13 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	rs->output_layout = convert_speaker_layout(dst->speakers);
 	rs->output_format = convert_audio_format(dst->format);
 	rs->output_planes = is_audio_planar(dst->format) ? rs->output_ch : 1;
+	rs->input_ch      = get_audio_channels(src->speakers);
+
+	if (get_direct_remix(dst, src, &rs->remix)) {
+		rs->direct        = true;
+		rs->direct_format = src->format;
+		return rs;
+	}
 
 	rs->context = swr_alloc_set_opts(NULL,
 		rs->output_layout, rs->output_format, dst->samples_per_sec,
@@ -128,11 +173,60 @@ void audio_resampler_destroy(audio_resampler_t *rs)
 	}
 }
 
+static bool convert_direct(audio_resampler_t *rs,
+		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
+		 const uint8_t *const input[], uint32_t in_frames)
+{
+	float *planes[MAX_AV_PLANES];
+
+	/* downmixing needs a plane for every input channel */
+	if ((int)in_frames > rs->output_size) {
+		uint32_t channels = rs->input_ch > rs->output_ch ?
+			rs->input_ch : rs->output_ch;
+
+		if (rs->output_buffer[0])
+			av_freep(&rs->output_buffer[0]);
+
+		if (av_samples_alloc(rs->output_buffer, NULL, (int)channels,
+					(int)in_frames, rs->output_format,
+					0) < 0) {
+			blog(LOG_ERROR, "Failed to allocate conversion "
+			                "buffer");
+			rs->output_size = 0;
+			return false;
+		}
+
+		rs->output_size = (int)in_frames;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		planes[i] = (float*)rs->output_buffer[i];
+
+	audio_to_float_planar(planes, input, rs->direct_format, rs->input_ch,
+			in_frames);
+
+	if (rs->remix == REMIX_MONO_TO_STEREO)
+		upmix_mono_to_stereo(planes[0], planes[1], in_frames);
+	else if (rs->remix == REMIX_STEREO_TO_MONO)
+		downmix_stereo_to_mono(planes[0], planes[0], planes[1],
+				in_frames);
+
+	for (uint32_t i = 0; i < rs->output_planes; i++)
+		output[i] = rs->output_buffer[i];
+
+	*out_frames = in_frames;
+	*ts_offset  = 0;
+	return true;
+}
+
 bool audio_resampler_resample(audio_resampler_t *rs,
 		 uint8_t *output[], uint32_t *out_frames, uint64_t *ts_offset,
 		 const uint8_t *const input[], uint32_t in_frames)
 {
 	if (!rs) return false;
+	if (rs->direct)
+		return convert_direct(rs, output, out_frames, ts_offset,
+				input, in_frames);
 
 	struct SwrContext *context = rs->context;
 	int ret;
@@ -0,0 +1,201 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 versions of the UYVX compression functions.  This file is compiled
+ * with AVX2 enabled, so nothing in it may be called unless the CPU supports
+ * it (see format-conversion.c).  16 pixels of two lines are processed per
+ * iteration, the remaining pixels of each line are processed in C, which
+ * gives the same results as the SSE2 versions.
+ */
+
+#include "format-conversion-internal.h"
+#include <immintrin.h>
+
+/*
+ * Luma of 16 pixels per line.  packs/packus work within 128bit lanes, so the
+ * values end up as (in dwords of 4 pixels):
+ *   line1 0-3, line1 8-11, line2 0-3, line2 8-11,
+ *   line1 4-7, line1 12-15, line2 4-7, line2 12-15
+ */
+#define pack_lum_avx2(lum_plane, lum_pos0, lum_pos1, l1a, l1b, l2a, l2b)      \
+do {                                                                          \
+	__m256i lum_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);        \
+	__m256i lum_mask  = _mm256_set1_epi32(0x0000FF00);                    \
+	__m256i pack1 = _mm256_packs_epi32(                                   \
+			_mm256_srli_epi32(_mm256_and_si256(l1a, lum_mask), 8),\
+			_mm256_srli_epi32(_mm256_and_si256(l1b, lum_mask), 8));\
+	__m256i pack2 = _mm256_packs_epi32(                                   \
+			_mm256_srli_epi32(_mm256_and_si256(l2a, lum_mask), 8),\
+			_mm256_srli_epi32(_mm256_and_si256(l2b, lum_mask), 8));\
+	__m256i pack_val = _mm256_permutevar8x32_epi32(                       \
+			_mm256_packus_epi16(pack1, pack2), lum_order);        \
+                                                                              \
+	_mm_storeu_si128((__m128i*)(lum_plane+lum_pos0),                      \
+			_mm256_castsi256_si128(pack_val));                    \
+	_mm_storeu_si128((__m128i*)(lum_plane+lum_pos1),                      \
+			_mm256_extracti128_si256(pack_val, 1));               \
+} while (false)
+
+/* averages each 2x2 block, the sums of every pixel pair end up in the even
+ * dwords as U, V words */
+#define avg_ch_avx2(line1, line2)                                             \
+	_mm256_shuffle_epi32(_mm256_srli_epi16(                               \
+		_mm256_add_epi16(                                             \
+			_mm256_add_epi16(                                     \
+				_mm256_and_si256(line1, uv_mask),             \
+				_mm256_and_si256(line2, uv_mask)),            \
+			_mm256_shuffle_epi32(                                 \
+				_mm256_add_epi16(                             \
+					_mm256_and_si256(line1, uv_mask),     \
+					_mm256_and_si256(line2, uv_mask)),    \
+				_MM_SHUFFLE(2, 3, 0, 1))),                    \
+		2), _MM_SHUFFLE(3, 1, 2, 0))
+
+/* returns the interleaved U/V bytes of 16 pixels (8 pairs) in the low lane */
+#define pack_ch_avx2(l1a, l1b, l2a, l2b)                                      \
+	_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(                   \
+		_mm256_packus_epi16(                                          \
+			avg_ch_avx2(l1a, l2a),                                \
+			avg_ch_avx2(l1b, l2b)),                               \
+		_mm256_setr_epi32(0, 4, 2, 6, 1, 3, 5, 7)))
+
+static FORCE_INLINE void compress_tail(const uint8_t *line1,
+		const uint8_t *line2, uint8_t *lum0, uint8_t *lum1,
+		uint8_t *u, uint8_t *v, uint32_t pixels, uint32_t uv_step)
+{
+	for (uint32_t x = 0; x < pixels; x += 2) {
+		const uint8_t *p1 = line1 + x * 4;
+		const uint8_t *p2 = line2 + x * 4;
+
+		lum0[x]     = p1[1];
+		lum0[x + 1] = p1[5];
+		lum1[x]     = p2[1];
+		lum1[x + 1] = p2[5];
+
+		*u = (uint8_t)((p1[0] + p1[4] + p2[0] + p2[4]) >> 2);
+		*v = (uint8_t)((p1[2] + p1[6] + p2[2] + p2[6]) >> 2);
+		u += uv_step;
+		v += uv_step;
+	}
+}
+
+void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane = output[0];
+	uint8_t  *u_plane   = output[1];
+	uint8_t  *v_plane   = output[2];
+	uint32_t width      = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_simd = width & ~15;
+	uint32_t y;
+
+	__m256i  uv_mask    = _mm256_set1_epi16(0x00FF);
+	__m128i  uv_split   = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14,
+			1, 3, 5, 7, 9, 11, 13, 15);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_simd; x += 16) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t ch_pos    = chroma_y_pos + (x>>1);
+
+			__m256i l1a = _mm256_loadu_si256((const __m256i*)img);
+			__m256i l1b = _mm256_loadu_si256(
+					(const __m256i*)(img + 32));
+			__m256i l2a = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i l2b = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize + 32));
+
+			pack_lum_avx2(lum_plane, lum_pos0, lum_pos1,
+					l1a, l1b, l2a, l2b);
+
+			__m128i uv = _mm_shuffle_epi8(
+					pack_ch_avx2(l1a, l1b, l2a, l2b),
+					uv_split);
+			_mm_storel_epi64((__m128i*)(u_plane + ch_pos), uv);
+			_mm_storel_epi64((__m128i*)(v_plane + ch_pos),
+					_mm_srli_si128(uv, 8));
+		}
+
+		compress_tail(input + y_pos + x*4,
+				input + y_pos + in_linesize + x*4,
+				lum_plane + lum_y_pos + x,
+				lum_plane + lum_y_pos + out_linesize[0] + x,
+				u_plane + chroma_y_pos + (x>>1),
+				v_plane + chroma_y_pos + (x>>1),
+				width - x, 1);
+	}
+}
+
+void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane    = output[0];
+	uint8_t  *chroma_plane = output[1];
+	uint32_t width         = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_simd    = width & ~15;
+	uint32_t y;
+
+	__m256i  uv_mask       = _mm256_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_simd; x += 16) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i l1a = _mm256_loadu_si256((const __m256i*)img);
+			__m256i l1b = _mm256_loadu_si256(
+					(const __m256i*)(img + 32));
+			__m256i l2a = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i l2b = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize + 32));
+
+			pack_lum_avx2(lum_plane, lum_pos0, lum_pos1,
+					l1a, l1b, l2a, l2b);
+			_mm_storeu_si128(
+					(__m128i*)(chroma_plane + chroma_y_pos + x),
+					pack_ch_avx2(l1a, l1b, l2a, l2b));
+		}
+
+		compress_tail(input + y_pos + x*4,
+				input + y_pos + in_linesize + x*4,
+				lum_plane + lum_y_pos + x,
+				lum_plane + lum_y_pos + out_linesize[0] + x,
+				chroma_plane + chroma_y_pos + x,
+				chroma_plane + chroma_y_pos + x + 1,
+				width - x, 2);
+	}
+}
@@ -15,10 +15,16 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
-#include "format-conversion.h"
+#include "format-conversion-internal.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -72,13 +78,7 @@ do {                                                                          \
 	*(uint16_t*)(v_plane+chroma_pos) = (uint16_t)(packed_vals>>16);       \
 } while (false)
 
-
-static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
-{
-	return a < b ? a : b;
-}
-
-void compress_uyvx_to_i420(
+static void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -116,7 +116,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+static void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -152,6 +152,109 @@ void compress_uyvx_to_nv12(
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+
+struct conversion_funcs {
+	void (*compress_uyvx_to_i420)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*compress_uyvx_to_nv12)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+};
+
+static const struct conversion_funcs sse2_funcs = {
+	compress_uyvx_to_i420_sse2,
+	compress_uyvx_to_nv12_sse2
+};
+
+static const struct conversion_funcs avx2_funcs = {
+	compress_uyvx_to_i420_avx2,
+	compress_uyvx_to_nv12_avx2
+};
+
+static const struct conversion_funcs *conversion_funcs = NULL;
+
+#define CPUID_OSXSAVE (1<<27)
+#define CPUID_AVX     (1<<28)
+#define CPUID_AVX2    (1<<5)
+#define XCR0_YMM      0x6
+
+static bool cpu_has_avx2(void)
+{
+	uint32_t regs[4];
+	uint64_t xcr0;
+
+#ifdef _MSC_VER
+	__cpuid((int*)regs, 0);
+	if (regs[0] < 7)
+		return false;
+
+	__cpuid((int*)regs, 1);
+#else
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+	if ((regs[2] & (CPUID_OSXSAVE | CPUID_AVX)) !=
+			(CPUID_OSXSAVE | CPUID_AVX))
+		return false;
+
+	/* the OS also has to save the YMM registers */
+#ifdef _MSC_VER
+	xcr0 = _xgetbv(0);
+	__cpuidex((int*)regs, 7, 0);
+#else
+	{
+		uint32_t eax, edx;
+		__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		xcr0 = ((uint64_t)edx << 32) | eax;
+	}
+	__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+
+	return (xcr0 & XCR0_YMM) == XCR0_YMM && (regs[1] & CPUID_AVX2) != 0;
+}
+
+static inline const struct conversion_funcs *get_conversion_funcs(void)
+{
+	/* selecting the functions more than once is harmless */
+	if (!conversion_funcs)
+		conversion_funcs = cpu_has_avx2() ? &avx2_funcs : &sse2_funcs;
+
+	return conversion_funcs;
+}
+
+bool format_conversion_use_avx2(bool enable)
+{
+	conversion_funcs = enable && cpu_has_avx2() ? &avx2_funcs : &sse2_funcs;
+	return conversion_funcs == &avx2_funcs;
+}
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_conversion_funcs()->compress_uyvx_to_i420(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_conversion_funcs()->compress_uyvx_to_nv12(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+/* ------------------------------------------------------------------------- */
+
 void decompress_420(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
@@ -37,6 +37,14 @@ EXPORT void compress_uyvx_to_nv12(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[]);
 
+/**
+ * Selects whether the compress functions may use their AVX2 versions (the
+ * default when the CPU supports it) or always use the SSE2 versions.  Meant
+ * for benchmarking and testing.  Returns whether the AVX2 versions are now
+ * in use.
+ */
+EXPORT bool format_conversion_use_avx2(bool enable);
+
 EXPORT void decompress_nv12(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
@@ -20,17 +20,123 @@
 #include "../util/base.h"
 #include "../util/bmem.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
+#include "../util/circlebuf.h"
 
 #include <libavformat/avformat.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
+/* input and output are read/written in large blocks rather than through
+ * avio's default 32k buffers */
+#define REMUX_IO_BUFFER_SIZE (4 * 1024 * 1024)
+
+/* packets the reader thread can get ahead of the writer by */
+#define REMUX_MAX_QUEUED_PACKETS 256
+
+struct remux_packet {
+	AVPacket pkt;
+	int64_t  in_pos;
+	int      ret;
+	bool     eof;
+};
+
 struct media_remux_job {
 	int64_t in_size;
 	AVFormatContext *ifmt_ctx, *ofmt_ctx;
+
+	FILE *in_file, *out_file;
+	AVIOContext *in_io, *out_io;
+
+	pthread_t read_thread;
+	bool read_thread_active;
+	volatile bool stop;
+	pthread_mutex_t queue_mutex;
+	os_sem_t *packets_sem;
+	os_sem_t *free_sem;
+	struct circlebuf queue;
 };
 
+/* ------------------------------------------------------------------------- */
+
+static int read_input(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	size_t size = fread(buf, 1, buf_size, job->in_file);
+
+	if (!size)
+		return ferror(job->in_file) ? AVERROR(EIO) : AVERROR_EOF;
+	return (int)size;
+}
+
+static int write_output(void *opaque, uint8_t *buf, int buf_size)
+{
+	media_remux_job_t job = opaque;
+	size_t size = fwrite(buf, 1, buf_size, job->out_file);
+
+	return size == (size_t)buf_size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t seek_file(FILE *file, int64_t size, int64_t offset,
+		int whence)
+{
+	if (whence & AVSEEK_SIZE)
+		return size;
+
+	whence &= ~AVSEEK_FORCE;
+	if (os_fseeki64(file, offset, whence) != 0)
+		return AVERROR(EIO);
+
+	return os_ftelli64(file);
+}
+
+static int64_t seek_input(void *opaque, int64_t offset, int whence)
+{
+	media_remux_job_t job = opaque;
+	return seek_file(job->in_file, job->in_size, offset, whence);
+}
+
+static int64_t seek_output(void *opaque, int64_t offset, int whence)
+{
+	media_remux_job_t job = opaque;
+	int64_t size = -1;
+
+	if (whence & AVSEEK_SIZE) {
+		int64_t pos = os_ftelli64(job->out_file);
+		os_fseeki64(job->out_file, 0, SEEK_END);
+		size = os_ftelli64(job->out_file);
+		os_fseeki64(job->out_file, pos, SEEK_SET);
+	}
+
+	return seek_file(job->out_file, size, offset, whence);
+}
+
+static AVIOContext *create_io(media_remux_job_t job, bool write)
+{
+	uint8_t *buffer = av_malloc(REMUX_IO_BUFFER_SIZE);
+	AVIOContext *io;
+
+	if (!buffer)
+		return NULL;
+
+	io = avio_alloc_context(buffer, REMUX_IO_BUFFER_SIZE, write, job,
+			write ? NULL : read_input,
+			write ? write_output : NULL,
+			write ? seek_output : seek_input);
+	if (!io)
+		av_free(buffer);
+	return io;
+}
+
+static void free_io(AVIOContext **io)
+{
+	if (*io) {
+		av_freep(&(*io)->buffer);
+		av_freep(io);
+	}
+}
+
 static inline void init_size(media_remux_job_t job, const char *in_filename)
 {
 #ifdef _MSC_VER
@@ -45,7 +151,29 @@ static inline void init_size(media_remux_job_t job, const char *in_filename)
 
 static inline bool init_input(media_remux_job_t job, const char *in_filename)
 {
-	int ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
+	int ret;
+
+	job->in_file = os_fopen(in_filename, "rb");
+	if (!job->in_file) {
+		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
+				in_filename);
+		return false;
+	}
+
+	job->ifmt_ctx = avformat_alloc_context();
+	if (!job->ifmt_ctx)
+		return false;
+
+	job->in_io = create_io(job, false);
+	if (!job->in_io) {
+		blog(LOG_ERROR, "media_remux: Could not create input buffer");
+		return false;
+	}
+
+	job->ifmt_ctx->pb     = job->in_io;
+	job->ifmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
 				in_filename);
@@ -103,13 +231,21 @@ static inline bool init_output(media_remux_job_t job, const char *out_filename)
 #endif
 
 	if (!(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-		ret = avio_open(&job->ofmt_ctx->pb, out_filename,
-				AVIO_FLAG_WRITE);
-		if (ret < 0) {
+		job->out_file = os_fopen(out_filename, "wb");
+		if (!job->out_file) {
 			blog(LOG_ERROR, "media_remux: Failed to open output"
 					" file '%s'", out_filename);
 			return false;
 		}
+
+		job->out_io = create_io(job, true);
+		if (!job->out_io) {
+			blog(LOG_ERROR, "media_remux: Could not create output"
+					" buffer");
+			return false;
+		}
+
+		job->ofmt_ctx->pb = job->out_io;
 	}
 
 	return true;
@@ -129,6 +265,14 @@ bool media_remux_job_create(media_remux_job_t *job, const char *in_filename,
 	if (!*job)
 		return false;
 
+	pthread_mutex_init_value(&(*job)->queue_mutex);
+	if (pthread_mutex_init(&(*job)->queue_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&(*job)->packets_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&(*job)->free_sem, REMUX_MAX_QUEUED_PACKETS) != 0)
+		goto fail;
+
 	init_size(*job, in_filename);
 
 	av_register_all();
@@ -161,15 +305,78 @@ static inline void process_packet(AVPacket *pkt,
 
 }
 
+static void *read_thread(void *data)
+{
+	media_remux_job_t job = data;
+	struct remux_packet packet;
+
+	for (;;) {
+		memset(&packet, 0, sizeof(packet));
+
+		if (os_sem_wait(job->free_sem) != 0 || job->stop)
+			break;
+
+		packet.ret = av_read_frame(job->ifmt_ctx, &packet.pkt);
+		packet.eof = packet.ret < 0;
+		packet.in_pos = avio_tell(job->ifmt_ctx->pb);
+
+		pthread_mutex_lock(&job->queue_mutex);
+		circlebuf_push_back(&job->queue, &packet, sizeof(packet));
+		pthread_mutex_unlock(&job->queue_mutex);
+		os_sem_post(job->packets_sem);
+
+		if (packet.eof)
+			break;
+	}
+
+	return NULL;
+}
+
+static void stop_read_thread(media_remux_job_t job)
+{
+	struct remux_packet packet;
+
+	if (job->read_thread_active) {
+		job->stop = true;
+		os_sem_post(job->free_sem);
+		pthread_join(job->read_thread, NULL);
+		job->read_thread_active = false;
+	}
+
+	while (job->queue.size) {
+		circlebuf_pop_front(&job->queue, &packet, sizeof(packet));
+		if (!packet.eof)
+			av_free_packet(&packet.pkt);
+	}
+}
+
+/* packets are read on a separate thread and written here, progress is
+ * reported by how far in to the input file the written packets were read
+ * from, whenever it changes by at least a tenth of a percent */
 static inline int process_packets(media_remux_job_t job,
 		media_remux_progress_callback callback, void *data)
 {
-	AVPacket pkt;
+	struct remux_packet packet;
+	float last_progress = 0.f;
+	int ret;
+
+	if (pthread_create(&job->read_thread, NULL, read_thread, job) != 0) {
+		blog(LOG_ERROR, "media_remux: Failed to create read thread");
+		return AVERROR(ENOMEM);
+	}
+
+	job->read_thread_active = true;
 
-	int ret, throttle = 0;
 	for (;;) {
-		ret = av_read_frame(job->ifmt_ctx, &pkt);
-		if (ret < 0) {
+		os_sem_wait(job->packets_sem);
+
+		pthread_mutex_lock(&job->queue_mutex);
+		circlebuf_pop_front(&job->queue, &packet, sizeof(packet));
+		pthread_mutex_unlock(&job->queue_mutex);
+		os_sem_post(job->free_sem);
+
+		if (packet.eof) {
+			ret = packet.ret;
 			if (ret != AVERROR_EOF)
 				blog(LOG_ERROR, "media_remux: Error reading"
 						" packet: %s",
@@ -177,18 +384,25 @@ static inline int process_packets(media_remux_job_t job,
 			break;
 		}
 
-		if (callback != NULL && throttle++ > 10) {
-			float progress = pkt.pos / (float)job->in_size * 100.f;
-			if (!callback(data, progress))
-				break;
-			throttle = 0;
+		if (callback != NULL && job->in_size) {
+			float progress = packet.in_pos /
+				(float)job->in_size * 100.f;
+			if (progress - last_progress >= 0.1f) {
+				if (!callback(data, progress)) {
+					av_free_packet(&packet.pkt);
+					ret = 0;
+					break;
+				}
+				last_progress = progress;
+			}
 		}
 
-		process_packet(&pkt, job->ifmt_ctx->streams[pkt.stream_index],
-				job->ofmt_ctx->streams[pkt.stream_index]);
+		AVPacket *pkt = &packet.pkt;
+		process_packet(pkt, job->ifmt_ctx->streams[pkt->stream_index],
+				job->ofmt_ctx->streams[pkt->stream_index]);
 
-		ret = av_interleaved_write_frame(job->ofmt_ctx, &pkt);
-		av_free_packet(&pkt);
+		ret = av_interleaved_write_frame(job->ofmt_ctx, pkt);
+		av_free_packet(pkt);
 
 		if (ret < 0) {
 			blog(LOG_ERROR, "media_remux: Error muxing packet: %s",
@@ -197,6 +411,7 @@ static inline int process_packets(media_remux_job_t job,
 		}
 	}
 
+	stop_read_thread(job);
 	return ret;
 }
 
@@ -240,12 +455,25 @@ void media_remux_job_destroy(media_remux_job_t job)
 	if (!job)
 		return;
 
+	stop_read_thread(job);
+
 	avformat_close_input(&job->ifmt_ctx);
+	avformat_free_context(job->ofmt_ctx);
 
-	if (job->ofmt_ctx && !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE))
-		avio_close(job->ofmt_ctx->pb);
+	if (job->out_io)
+		avio_flush(job->out_io);
 
-	avformat_free_context(job->ofmt_ctx);
+	free_io(&job->in_io);
+	free_io(&job->out_io);
+
+	if (job->in_file)
+		fclose(job->in_file);
+	if (job->out_file)
+		fclose(job->out_file);
 
+	circlebuf_free(&job->queue);
+	os_sem_destroy(job->packets_sem);
+	os_sem_destroy(job->free_sem);
+	pthread_mutex_destroy(&job->queue_mutex);
 	bfree(job);
 }
@@ -26,6 +26,11 @@ struct video_frame {
 EXPORT void video_frame_init(struct video_frame *frame,
 		enum video_format format, uint32_t width, uint32_t height);
 
+/* copies frame data between frames that may have different line sizes */
+EXPORT void video_frame_copy(struct video_frame *dst,
+		const struct video_frame *src, enum video_format format,
+		uint32_t height);
+
 static inline void video_frame_free(struct video_frame *frame)
 {
 	if (frame) {
@@ -18,32 +18,63 @@
 #include <assert.h>
 #include "../util/bmem.h"
 #include "../util/platform.h"
+#include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
 #include "video-frame.h"
 #include "video-scaler.h"
 
-#define MAX_CONVERT_BUFFERS 3
+/* frames an input can fall behind by before new frames are dropped for it */
+#define MAX_QUEUED_FRAMES 3
+#define MAX_QUEUED_SIZE   (MAX_QUEUED_FRAMES * sizeof(struct cached_frame*))
 
-struct video_input {
+/* scaler shared by all inputs that request the same conversion */
+struct scale_group {
 	struct video_scale_info   conversion;
 	video_scaler_t            *scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	pthread_mutex_t           mutex;
+	uint64_t                  id;
+	long                      refs;
+};
+
+/* a cached frame scaled for one scale group */
+struct scaled_frame {
+	uint64_t                  group_id;
+	struct video_scale_info   conversion;
+	struct video_frame        frame;
+	bool                      valid;
+};
+
+/* copy of an output frame, shared between the inputs it was queued to */
+struct cached_frame {
+	struct video_frame        frame;
+	uint64_t                  timestamp;
+	volatile long             refs;
+
+	pthread_mutex_t           mutex;
+	DARRAY(struct scaled_frame*) scaled;
+};
+
+struct video_input {
+	struct video_output       *video;
+	struct video_scale_info   conversion;
+	struct scale_group        *group;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	pthread_t                 thread;
+	pthread_mutex_t           queue_mutex;
+	os_sem_t                  *queue_sem;
+	struct circlebuf          queue;
+	uint32_t                  skipped_frames;
+	volatile bool             stop;
+	volatile bool             detached;
+};
 
 struct video_output {
 	struct video_output_info   info;
@@ -63,14 +94,220 @@ struct video_output {
 	uint32_t                   total_frames;
 	uint64_t                   last_ts;
 
+	pthread_mutex_t            timing_mutex;
+	struct video_output_timing timing;
+
 	bool                       initialized;
 
+	/* virtual clock of offline rendering */
+	uint64_t                   offline_start;
+	uint64_t                   offline_frames;
+
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input*) inputs;
+
+	pthread_mutex_t            cache_mutex;
+	DARRAY(struct cached_frame*) free_frames;
+
+	DARRAY(struct scale_group*) scale_groups;
+	uint64_t                   next_group_id;
 };
 
 /* ------------------------------------------------------------------------- */
 
+static struct cached_frame *cached_frame_get(struct video_output *video)
+{
+	struct cached_frame *cached = NULL;
+
+	pthread_mutex_lock(&video->cache_mutex);
+	if (video->free_frames.num) {
+		cached = video->free_frames.array[video->free_frames.num-1];
+		da_pop_back(video->free_frames);
+	}
+	pthread_mutex_unlock(&video->cache_mutex);
+
+	if (!cached) {
+		cached = bzalloc(sizeof(struct cached_frame));
+		video_frame_init(&cached->frame, video->info.format,
+				video->info.width, video->info.height);
+		pthread_mutex_init(&cached->mutex, NULL);
+	}
+
+	/* scaled buffers are kept for reuse, but no longer hold this frame */
+	for (size_t i = 0; i < cached->scaled.num; i++) {
+		cached->scaled.array[i]->group_id = 0;
+		cached->scaled.array[i]->valid    = false;
+	}
+
+	cached->refs = 1;
+	return cached;
+}
+
+static void cached_frame_destroy(struct cached_frame *cached)
+{
+	for (size_t i = 0; i < cached->scaled.num; i++) {
+		video_frame_free(&cached->scaled.array[i]->frame);
+		bfree(cached->scaled.array[i]);
+	}
+
+	da_free(cached->scaled);
+	video_frame_free(&cached->frame);
+	pthread_mutex_destroy(&cached->mutex);
+	bfree(cached);
+}
+
+static inline bool same_conversion(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format &&
+	       a->width      == b->width &&
+	       a->height     == b->height &&
+	       a->range      == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static struct scaled_frame *cached_frame_get_scaled(
+		struct cached_frame *cached, const struct scale_group *group)
+{
+	struct scaled_frame *scaled = NULL;
+
+	pthread_mutex_lock(&cached->mutex);
+
+	for (size_t i = 0; i < cached->scaled.num; i++) {
+		if (cached->scaled.array[i]->group_id == group->id) {
+			scaled = cached->scaled.array[i];
+			goto found;
+		}
+	}
+
+	for (size_t i = 0; i < cached->scaled.num; i++) {
+		if (cached->scaled.array[i]->group_id == 0) {
+			scaled = cached->scaled.array[i];
+			break;
+		}
+	}
+
+	if (!scaled) {
+		scaled = bzalloc(sizeof(struct scaled_frame));
+		da_push_back(cached->scaled, &scaled);
+	}
+
+	if (!scaled->frame.data[0] ||
+	    !same_conversion(&scaled->conversion, &group->conversion)) {
+		video_frame_free(&scaled->frame);
+		video_frame_init(&scaled->frame, group->conversion.format,
+				group->conversion.width,
+				group->conversion.height);
+		scaled->conversion = group->conversion;
+	}
+
+	scaled->group_id = group->id;
+	scaled->valid    = false;
+
+found:
+	pthread_mutex_unlock(&cached->mutex);
+	return scaled;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* requires input_mutex */
+static struct scale_group *scale_group_get(struct video_output *video,
+		const struct video_scale_info *conversion)
+{
+	struct scale_group *group;
+
+	for (size_t i = 0; i < video->scale_groups.num; i++) {
+		group = video->scale_groups.array[i];
+		if (same_conversion(&group->conversion, conversion)) {
+			group->refs++;
+			return group;
+		}
+	}
+
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+	};
+
+	group = bzalloc(sizeof(struct scale_group));
+	group->conversion = *conversion;
+
+	int ret = video_scaler_create(&group->scaler, conversion, &from,
+			VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+			                "scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+			                "create scaler");
+
+		bfree(group);
+		return NULL;
+	}
+
+	pthread_mutex_init(&group->mutex, NULL);
+	group->id   = ++video->next_group_id;
+	group->refs = 1;
+	da_push_back(video->scale_groups, &group);
+	return group;
+}
+
+/* requires input_mutex */
+static void scale_group_unref(struct video_output *video,
+		struct scale_group *group)
+{
+	if (!group || --group->refs != 0)
+		return;
+
+	da_erase_item(video->scale_groups, &group);
+	video_scaler_destroy(group->scaler);
+	pthread_mutex_destroy(&group->mutex);
+	bfree(group);
+}
+
+static inline void scale_group_release(struct video_output *video,
+		struct scale_group *group)
+{
+	os_mutex_lock(&video->input_mutex, "input_mutex");
+	scale_group_unref(video, group);
+	os_mutex_unlock(&video->input_mutex, "input_mutex");
+}
+
+static void cached_frame_release(struct video_output *video,
+		struct cached_frame *cached)
+{
+	if (os_atomic_dec_long(&cached->refs) == 0) {
+		pthread_mutex_lock(&video->cache_mutex);
+		da_push_back(video->free_frames, &cached);
+		pthread_mutex_unlock(&video->cache_mutex);
+	}
+}
+
+static void video_input_destroy(struct video_input *input)
+{
+	struct cached_frame *cached;
+
+	while (input->queue.size) {
+		circlebuf_pop_front(&input->queue, &cached, sizeof(cached));
+		cached_frame_release(input->video, cached);
+	}
+
+	if (input->skipped_frames)
+		blog(LOG_INFO, "video-io: %u frames skipped by a slow "
+		               "video input", input->skipped_frames);
+
+	scale_group_release(input->video, input->group);
+	circlebuf_free(&input->queue);
+	os_sem_destroy(input->queue_sem);
+	pthread_mutex_destroy(&input->queue_mutex);
+	bfree(input);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void video_swapframes(struct video_output *video)
 {
 	if (video->new_frame) {
@@ -80,27 +317,33 @@ static inline void video_swapframes(struct video_output *video)
 }
 
 static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+		struct cached_frame *cached, struct video_data *data)
 {
+	struct scale_group *group = input->group;
 	bool success = true;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	if (group) {
+		struct scaled_frame *scaled;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+		/* the first input of a group to get here scales the frame,
+		 * the others use its result */
+		pthread_mutex_lock(&group->mutex);
 
-		frame = &input->frame[input->cur_frame];
+		scaled = cached_frame_get_scaled(cached, group);
+		if (!scaled->valid)
+			scaled->valid = video_scaler_scale(group->scaler,
+					scaled->frame.data,
+					scaled->frame.linesize,
+					(const uint8_t * const*)data->data,
+					data->linesize);
+		success = scaled->valid;
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
-				(const uint8_t * const*)data->data,
-				data->linesize);
+		pthread_mutex_unlock(&group->mutex);
 
 		if (success) {
 			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
+				data->data[i]     = scaled->frame.data[i];
+				data->linesize[i] = scaled->frame.linesize[i];
 			}
 		} else {
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
@@ -110,36 +353,119 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
-static inline void video_output_cur_frame(struct video_output *video)
+static void *input_thread(void *param)
 {
-	if (!video->cur_frame.data[0])
-		return;
+	struct video_input *input = param;
 
-	pthread_mutex_lock(&video->input_mutex);
+	os_set_thread_role(OS_THREAD_ROLE_ENCODER);
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
-		struct video_data frame = video->cur_frame;
+	while (os_sem_wait(input->queue_sem) == 0) {
+		struct cached_frame *cached;
+		struct video_data   frame;
+
+		if (input->stop)
+			break;
+
+		pthread_mutex_lock(&input->queue_mutex);
+		circlebuf_pop_front(&input->queue, &cached, sizeof(cached));
+		pthread_mutex_unlock(&input->queue_mutex);
 
-		if (scale_video_output(input, &frame)) {
-			if (frame.timestamp <= video->last_ts)
-				video->last_ts += video->frame_time;
-			else
-				video->last_ts = frame.timestamp;
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			frame.data[i]     = cached->frame.data[i];
+			frame.linesize[i] = cached->frame.linesize[i];
+		}
+		frame.timestamp = cached->timestamp;
 
-			frame.timestamp = video->last_ts;
+		if (scale_video_output(input, cached, &frame))
 			input->callback(input->param, &frame);
+
+		cached_frame_release(input->video, cached);
+	}
+
+	/* disconnected from its own callback, so nothing joined this
+	 * thread and it has to clean up after itself */
+	if (input->detached)
+		video_input_destroy(input);
+
+	return NULL;
+}
+
+static inline void video_input_queue(struct video_input *input,
+		struct cached_frame *cached)
+{
+	bool queued = false;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	/* offline, nothing is dropped: the pipeline waits for the input */
+	if (input->video->info.offline) {
+		while (input->queue.size >= MAX_QUEUED_SIZE && !input->stop) {
+			pthread_mutex_unlock(&input->queue_mutex);
+			os_sleep_ms(1);
+			pthread_mutex_lock(&input->queue_mutex);
 		}
 	}
 
-	pthread_mutex_unlock(&video->input_mutex);
+	if (input->queue.size < MAX_QUEUED_SIZE) {
+		os_atomic_inc_long(&cached->refs);
+		circlebuf_push_back(&input->queue, &cached, sizeof(cached));
+		queued = true;
+	}
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (queued)
+		os_sem_post(input->queue_sem);
+	else
+		input->skipped_frames++;
+}
+
+static inline void video_output_cur_frame(struct video_output *video)
+{
+	struct cached_frame *cached;
+	struct video_frame  src;
+
+	if (!video->cur_frame.data[0])
+		return;
+
+	os_mutex_lock(&video->input_mutex, "input_mutex");
+
+	if (!video->inputs.num) {
+		os_mutex_unlock(&video->input_mutex, "input_mutex");
+		return;
+	}
+
+	/* the frame data belongs to the graphics thread, so it's copied once
+	 * and the copy is shared by every input */
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		src.data[i]     = video->cur_frame.data[i];
+		src.linesize[i] = video->cur_frame.linesize[i];
+	}
+
+	cached = cached_frame_get(video);
+	video_frame_copy(&cached->frame, &src, video->info.format,
+			video->info.height);
+
+	if (video->cur_frame.timestamp <= video->last_ts)
+		video->last_ts += video->frame_time;
+	else
+		video->last_ts = video->cur_frame.timestamp;
+
+	cached->timestamp = video->last_ts;
+
+	for (size_t i = 0; i < video->inputs.num; i++)
+		video_input_queue(video->inputs.array[i], cached);
+
+	os_mutex_unlock(&video->input_mutex, "input_mutex");
+
+	cached_frame_release(video, cached);
 }
 
 #define MAX_MISSED_TIMINGS 8
 
-static inline bool safe_sleepto(uint64_t t, uint32_t *missed_timings)
+static inline bool safe_sleepto(os_timer_t *timer, uint64_t t,
+		uint32_t *missed_timings)
 {
-	if (!os_sleepto_ns(t))
+	if (!os_timer_sleepto_ns(timer, t))
 		(*missed_timings)++;
 	else
 		*missed_timings = 0;
@@ -147,17 +473,53 @@ static inline bool safe_sleepto(uint64_t t, uint32_t *missed_timings)
 	return *missed_timings <= MAX_MISSED_TIMINGS;
 }
 
+/* time of a half frame boundary relative to the start of the thread.  this is
+ * computed from the exact frame rate each time rather than accumulating the
+ * rounded frame time, so the clock doesn't drift */
+static inline uint64_t half_frame_offset(const struct video_output *video,
+		uint64_t half_frames)
+{
+	uint64_t num = (uint64_t)video->info.fps_num * 2;
+	uint64_t den = (uint64_t)video->info.fps_den * 1000000000ULL;
+
+	return (half_frames / num) * den + (half_frames % num) * den / num;
+}
+
+static void update_timing(struct video_output *video, uint64_t target)
+{
+	struct video_output_timing *timing = &video->timing;
+	uint64_t jitter = os_gettime_ns() - target;
+
+	pthread_mutex_lock(&video->timing_mutex);
+
+	timing->frames++;
+	timing->total_jitter_ns += jitter;
+	timing->last_jitter_ns   = jitter;
+	if (jitter > timing->max_jitter_ns)
+		timing->max_jitter_ns = jitter;
+	if (jitter > video->frame_time / 2)
+		timing->late_frames++;
+
+	pthread_mutex_unlock(&video->timing_mutex);
+}
+
 static void *video_thread(void *param)
 {
 	struct video_output *video         = param;
-	uint64_t            cur_time       = os_gettime_ns();
+	os_timer_t          *timer         = os_timer_create();
+	uint64_t            start_time     = os_gettime_ns();
+	uint64_t            half_frames    = 0;
+	uint64_t            cur_time;
 	uint32_t            missed_timings = 0;
 
+	os_set_thread_role(OS_THREAD_ROLE_VIDEO);
+
 	while (os_event_try(video->stop_event) == EAGAIN) {
 		/* wait half a frame, update frame */
-		cur_time += (video->frame_time/2);
+		cur_time = start_time + half_frame_offset(video, ++half_frames);
 
-		if (safe_sleepto(cur_time, &missed_timings)) {
+		if (safe_sleepto(timer, cur_time, &missed_timings)) {
+			update_timing(video, cur_time);
 			video->cur_video_time = cur_time;
 			os_event_signal(video->update_event);
 		} else {
@@ -165,8 +527,10 @@ static void *video_thread(void *param)
 		}
 
 		/* wait another half a frame, swap and output frames */
-		cur_time += (video->frame_time/2);
-		safe_sleepto(cur_time, &missed_timings);
+		cur_time = start_time + half_frame_offset(video, ++half_frames);
+		safe_sleepto(timer, cur_time, &missed_timings);
+
+		profile_start("video_thread");
 
 		pthread_mutex_lock(&video->data_mutex);
 
@@ -175,9 +539,12 @@ static void *video_thread(void *param)
 
 		pthread_mutex_unlock(&video->data_mutex);
 
+		profile_end("video_thread");
+
 		video->total_frames++;
 	}
 
+	os_timer_destroy(timer);
 	return NULL;
 }
 
@@ -209,12 +576,23 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->cache_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&out->timing_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (os_event_init(&out->update_event, OS_EVENT_TYPE_AUTO) != 0)
 		goto fail;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+
+	if (info->offline) {
+		out->offline_start  = os_gettime_ns();
+		out->cur_video_time = out->offline_start;
+		blog(LOG_INFO, "video-io: offline rendering, not paced by the "
+		               "system clock");
+	} else if (pthread_create(&out->thread, NULL, video_thread, out) != 0) {
 		goto fail;
+	}
 
 	out->initialized = true;
 	*video = out;
@@ -225,6 +603,22 @@ fail:
 	return VIDEO_OUTPUT_FAIL;
 }
 
+static void video_input_stop(struct video_input *input)
+{
+	input->stop = true;
+
+	if (pthread_equal(pthread_self(), input->thread)) {
+		input->detached = true;
+		pthread_detach(input->thread);
+		os_sem_post(input->queue_sem);
+		return;
+	}
+
+	os_sem_post(input->queue_sem);
+	pthread_join(input->thread, NULL);
+	video_input_destroy(input);
+}
+
 void video_output_close(video_t *video)
 {
 	if (!video)
@@ -233,13 +627,20 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_stop(video->inputs.array[i]);
 	da_free(video->inputs);
 
+	for (size_t i = 0; i < video->free_frames.num; i++)
+		cached_frame_destroy(video->free_frames.array[i]);
+	da_free(video->free_frames);
+	da_free(video->scale_groups);
+
 	os_event_destroy(video->update_event);
 	os_event_destroy(video->stop_event);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutex_destroy(&video->timing_mutex);
+	pthread_mutex_destroy(&video->cache_mutex);
 	bfree(video);
 }
 
@@ -248,7 +649,7 @@ static size_t video_get_input_idx(const video_t *video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -256,40 +657,37 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+/* requires input_mutex */
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
+	pthread_mutex_init_value(&input->queue_mutex);
+
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&input->queue_sem, 0) != 0)
+		goto fail;
+
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-				                "scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-				                "create scaler");
-
-			return false;
-		}
+		input->group = scale_group_get(video, &input->conversion);
+		if (!input->group)
+			goto fail;
+	}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
+	if (pthread_create(&input->thread, NULL, input_thread, input) != 0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create thread");
+		goto fail;
 	}
 
 	return true;
+
+fail:
+	scale_group_unref(video, input->group);
+	os_sem_destroy(input->queue_sem);
+	pthread_mutex_destroy(&input->queue_mutex);
+	return false;
 }
 
 bool video_output_connect(video_t *video,
@@ -302,34 +700,36 @@ bool video_output_connect(video_t *video,
 	if (!video || !callback)
 		return false;
 
-	pthread_mutex_lock(&video->input_mutex);
+	os_mutex_lock(&video->input_mutex, "input_mutex");
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(struct video_input));
 
-		input.callback = callback;
-		input.param    = param;
+		input->video    = video;
+		input->callback = callback;
+		input->param    = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success)
 			da_push_back(video->inputs, &input);
+		else
+			bfree(input);
 	}
 
-	pthread_mutex_unlock(&video->input_mutex);
+	os_mutex_unlock(&video->input_mutex, "input_mutex");
 
 	return success;
 }
@@ -341,15 +741,22 @@ void video_output_disconnect(video_t *video,
 	if (!video || !callback)
 		return;
 
-	pthread_mutex_lock(&video->input_mutex);
+	struct video_input *input = NULL;
+
+	os_mutex_lock(&video->input_mutex, "input_mutex");
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 	}
 
-	pthread_mutex_unlock(&video->input_mutex);
+	os_mutex_unlock(&video->input_mutex, "input_mutex");
+
+	/* joined outside of the lock so the input's callback can't stall the
+	 * other inputs while it finishes */
+	if (input)
+		video_input_stop(input);
 }
 
 bool video_output_active(const video_t *video)
@@ -368,8 +775,17 @@ void video_output_swap_frame(video_t *video, struct video_data *frame)
 	if (!video) return;
 
 	pthread_mutex_lock(&video->data_mutex);
-	video->next_frame = *frame;
-	video->new_frame = true;
+
+	if (video->info.offline) {
+		/* every frame is output exactly once, when it's ready */
+		video->cur_frame = *frame;
+		video_output_cur_frame(video);
+		video->total_frames++;
+	} else {
+		video->next_frame = *frame;
+		video->new_frame = true;
+	}
+
 	pthread_mutex_unlock(&video->data_mutex);
 }
 
@@ -377,6 +793,12 @@ bool video_output_wait(video_t *video)
 {
 	if (!video) return false;
 
+	if (video->info.offline) {
+		video->cur_video_time = video->offline_start +
+			half_frame_offset(video, ++video->offline_frames * 2);
+		return os_event_try(video->stop_event) == EAGAIN;
+	}
+
 	os_event_wait(video->update_event);
 	return os_event_try(video->stop_event) == EAGAIN;
 }
@@ -401,7 +823,8 @@ void video_output_stop(video_t *video)
 	if (video->initialized) {
 		video->initialized = false;
 		os_event_signal(video->stop_event);
-		pthread_join(video->thread, &thread_ret);
+		if (!video->info.offline)
+			pthread_join(video->thread, &thread_ret);
 		os_event_signal(video->update_event);
 	}
 }
@@ -438,3 +861,15 @@ uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
 }
+
+void video_output_get_timing(const video_t *video,
+		struct video_output_timing *timing)
+{
+	memset(timing, 0, sizeof(*timing));
+	if (!video)
+		return;
+
+	pthread_mutex_lock((pthread_mutex_t*)&video->timing_mutex);
+	*timing = video->timing;
+	pthread_mutex_unlock((pthread_mutex_t*)&video->timing_mutex);
+}
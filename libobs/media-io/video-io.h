@@ -75,6 +75,12 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* offline rendering: instead of being paced by the system clock,
+	 * each video_output_wait advances a virtual clock by one frame, every
+	 * swapped frame is output right away, and slow inputs are waited on
+	 * rather than skipped */
+	bool              offline;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -151,6 +157,21 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/**
+ * Frame start timing.  Jitter is how late the video thread woke up to start
+ * each frame, relative to the ideal frame clock.
+ */
+struct video_output_timing {
+	uint64_t frames;
+	uint64_t late_frames;      /* woke more than half a frame late */
+	uint64_t total_jitter_ns;
+	uint64_t max_jitter_ns;
+	uint64_t last_jitter_ns;
+};
+
+EXPORT void video_output_get_timing(const video_t *video,
+		struct video_output_timing *timing);
+
 
 #ifdef __cplusplus
 }
@@ -188,9 +188,10 @@ static float log_db_to_def(const float db)
 static void signal_volume_changed(signal_handler_t *sh,
 		struct obs_fader *fader, const float db)
 {
+	uint8_t stack[CALLDATA_FIXED_SIZE];
 	struct calldata data;
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
 	calldata_set_ptr  (&data, "fader", fader);
 	calldata_set_float(&data, "db",    db);
@@ -204,9 +205,10 @@ static void signal_levels_updated(signal_handler_t *sh,
 		struct obs_volmeter *volmeter,
 		const float level, const float magnitude, const float peak)
 {
+	uint8_t stack[CALLDATA_FIXED_SIZE];
 	struct calldata data;
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 
 	calldata_set_ptr  (&data, "volmeter",  volmeter);
 	calldata_set_float(&data, "level",     level);
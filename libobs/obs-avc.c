@@ -15,9 +15,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
-#include "obs.h"
+#include "obs-internal.h"
 #include "obs-avc.h"
 #include "util/array-serializer.h"
+#include "util/simd.h"
 
 enum {
 	NAL_UNKNOWN   = 0,
@@ -33,13 +34,6 @@ enum {
 	NAL_FILLER    = 12,
 };
 
-enum {
-	NAL_PRIORITY_DISPOSABLE = 0,
-	NAL_PRIORITY_LOW        = 1,
-	NAL_PRIORITY_HIGH       = 2,
-	NAL_PRIORITY_HIGHEST    = 3,
-};
-
 /* NOTE: I noticed that FFmpeg does some unusual special handling of certain
  * scenarios that I was unaware of, so instead of just searching for {0, 0, 1}
  * we'll just use the code from FFmpeg - http://www.ffmpeg.org/ */
@@ -81,9 +75,64 @@ static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p,
 	return end + 3;
 }
 
+#if defined(SIMD_SSE2) || defined(SIMD_NEON)
+
+/* a start code can only begin at a zero byte, and zero bytes are rare in
+ * encoded slice data, so 16 bytes are checked for zeros at once and only the
+ * blocks that contain one are looked at byte by byte.  a block is only
+ * loaded if the two bytes after it are in range too, as a start code that
+ * begins at its last byte ends there. */
+static inline bool startcode_at(const uint8_t *p)
+{
+	return p[0] == 0 && p[1] == 0 && p[2] == 1;
+}
+
+static const uint8_t *find_startcode_simd(const uint8_t *p,
+		const uint8_t *end)
+{
+#ifdef SIMD_SSE2
+	const __m128i zero = _mm_setzero_si128();
+#else
+	const uint8x16_t zero = vdupq_n_u8(0);
+#endif
+
+	for (; end - p >= 18; p += 16) {
+#ifdef SIMD_SSE2
+		__m128i block = _mm_loadu_si128((const __m128i*)p);
+		int zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+
+		if (!zeros)
+			continue;
+#else
+		uint64x2_t zeros = vreinterpretq_u64_u8(
+				vceqq_u8(vld1q_u8(p), zero));
+
+		if (!(vgetq_lane_u64(zeros, 0) | vgetq_lane_u64(zeros, 1)))
+			continue;
+#endif
+
+		for (int i = 0; i < 16; i++) {
+			if (startcode_at(p + i))
+				return p + i;
+		}
+	}
+
+	for (; end - p >= 3; p++) {
+		if (startcode_at(p))
+			return p;
+	}
+
+	return end;
+}
+
+#define find_startcode find_startcode_simd
+#else
+#define find_startcode ff_avc_find_startcode_internal
+#endif
+
 const uint8_t *obs_avc_find_startcode(const uint8_t *p, const uint8_t *end)
 {
-	const uint8_t *out= ff_avc_find_startcode_internal(p, end);
+	const uint8_t *out = find_startcode(p, end);
 	if (p < out && out < end && !out[-1]) out--;
 	return out;
 }
@@ -91,11 +140,11 @@ const uint8_t *obs_avc_find_startcode(const uint8_t *p, const uint8_t *end)
 static inline int get_drop_priority(int priority)
 {
 	switch (priority) {
-	case NAL_PRIORITY_DISPOSABLE: return NAL_PRIORITY_DISPOSABLE;
-	case NAL_PRIORITY_LOW:        return NAL_PRIORITY_LOW;
+	case OBS_NAL_PRIORITY_DISPOSABLE: return OBS_NAL_PRIORITY_DISPOSABLE;
+	case OBS_NAL_PRIORITY_LOW:        return OBS_NAL_PRIORITY_LOW;
 	}
 
-	return NAL_PRIORITY_HIGHEST;
+	return OBS_NAL_PRIORITY_HIGHEST;
 }
 
 static void serialize_avc_data(struct serializer *s, const uint8_t *data,
@@ -128,20 +177,66 @@ static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 	}
 }
 
+static inline uint32_t read_be32(const uint8_t *data)
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+		((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+/* for packets that are already length-prefixed, only the slice types need to
+ * be looked at */
+static void parse_avcc_data(const uint8_t *data, size_t size,
+		bool *is_keyframe, int *priority)
+{
+	const uint8_t *end = data+size;
+	int type;
+
+	while (end - data > 4) {
+		const uint8_t *nal_start = data + 4;
+		size_t nal_size = read_be32(data);
+
+		if (!nal_size || nal_size > (size_t)(end - nal_start))
+			break;
+
+		type = nal_start[0] & 0x1F;
+
+		if (type == NAL_SLICE_IDR || type == NAL_SLICE) {
+			*is_keyframe = (type == NAL_SLICE_IDR);
+			*priority = nal_start[0] >> 5;
+		}
+
+		data = nal_start + nal_size;
+	}
+}
+
 void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 		const struct encoder_packet *src)
 {
 	struct array_output_data output;
 	struct serializer s;
+	long ref = 1;
+
+	/* nothing to convert, so just take another reference to the data */
+	if (src->avcc) {
+		obs_encoder_packet_ref(avc_packet, src);
+		parse_avcc_data(src->data, src->size, &avc_packet->keyframe,
+				&avc_packet->priority);
+		avc_packet->drop_priority =
+			get_drop_priority(avc_packet->priority);
+		return;
+	}
 
 	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
+	/* the output packet is reference counted like any other packet, so
+	 * the count is written in front of the packet data */
+	s_write(&s, &ref, sizeof(ref));
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			&avc_packet->priority);
 
-	avc_packet->data          = output.bytes.array;
-	avc_packet->size          = output.bytes.num;
+	avc_packet->data          = output.bytes.array + sizeof(ref);
+	avc_packet->size          = output.bytes.num - sizeof(ref);
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
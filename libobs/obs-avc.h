@@ -25,10 +25,22 @@ extern "C" {
 
 struct encoder_packet;
 
+enum {
+	OBS_NAL_PRIORITY_DISPOSABLE = 0,
+	OBS_NAL_PRIORITY_LOW        = 1,
+	OBS_NAL_PRIORITY_HIGH       = 2,
+	OBS_NAL_PRIORITY_HIGHEST    = 3,
+};
+
 /* Helpers for parsing AVC NAL units.  */
 
 EXPORT const uint8_t *obs_avc_find_startcode(const uint8_t *p,
 		const uint8_t *end);
+
+/**
+ * Converts an annex-b packet to AVCC.  The resulting packet is reference
+ * counted and must be released with obs_encoder_packet_release.
+ */
 EXPORT void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 		const struct encoder_packet *src);
 EXPORT size_t obs_parse_avc_header(uint8_t **header, const uint8_t *data,
@@ -18,13 +18,18 @@
 #include "util/bmem.h"
 #include "util/threading.h"
 #include "util/darray.h"
+#include "util/hash-map.h"
+#include "util/dstr.h"
+#include "util/serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <stdio.h>
 
 struct obs_data_item {
 	volatile long        ref;
@@ -44,11 +49,21 @@ struct obs_data {
 	volatile long        ref;
 	char                 *json;
 	struct obs_data_item *first_item;
+
+	/* item name -> item, for the items in the list */
+	struct hash_map      items;
+
+	/* see snapshots below */
+	long                 change_epoch;
+	struct obs_data_version *versions;
 };
 
 struct obs_data_array {
 	volatile long        ref;
 	DARRAY(obs_data_t*)   objects;
+
+	long                 change_epoch;
+	struct obs_data_version *versions;
 };
 
 struct obs_data_number {
@@ -252,6 +267,340 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* Snapshots
+ *
+ *   Taking a snapshot only starts a new epoch.  Objects and arrays remember
+ * the epoch of their last change, and when one of them is about to change
+ * while a snapshot taken since then is alive, its current state is copied
+ * first and kept as a version for that snapshot.  Reading a snapshot resolves
+ * each object to the version for its epoch, or to the object's current state
+ * if it hasn't changed since the snapshot was taken.
+ *
+ *   While no snapshot is alive, changes skip all of this (and the lock). */
+
+struct obs_data_version {
+	/* seen by the snapshots with from < epoch <= to */
+	long                    from;
+	long                    to;
+	union {
+		obs_data_t          *data;
+		obs_data_array_t    *array;
+	};
+	struct obs_data_version *next;
+};
+
+struct obs_data_snapshot {
+	long                    epoch;
+	obs_data_t              *data;
+};
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile long   snapshot_count = 0;
+static volatile long   snapshot_epoch = 0;
+static DARRAY(long)    snapshot_epochs;
+
+/* with snapshot_mutex locked */
+static bool snapshot_alive(long from, long to)
+{
+	for (size_t i = 0; i < snapshot_epochs.num; i++) {
+		long epoch = snapshot_epochs.array[i];
+		if (epoch > from && epoch <= to)
+			return true;
+	}
+
+	return false;
+}
+
+static void item_values_addref(struct obs_data_item *item)
+{
+	if (item->type == OBS_DATA_OBJECT) {
+		if (item->data_size)
+			obs_data_addref(*(obs_data_t**)get_data_ptr(item));
+		obs_data_addref(get_item_default_obj(item));
+		obs_data_addref(get_item_autoselect_obj(item));
+
+	} else if (item->type == OBS_DATA_ARRAY) {
+		if (item->data_size)
+			obs_data_array_addref(
+				*(obs_data_array_t**)get_data_ptr(item));
+		obs_data_array_addref(get_item_default_array(item));
+		obs_data_array_addref(get_item_autoselect_array(item));
+	}
+}
+
+/* copies the items, nested objects and arrays are shared */
+static obs_data_t *copy_data_items(struct obs_data *data)
+{
+	struct obs_data *copy = obs_data_create();
+	struct obs_data_item **next = &copy->first_item;
+
+	for (struct obs_data_item *item = data->first_item; item;
+			item = item->next) {
+		size_t size = obs_data_item_total_size(item);
+		struct obs_data_item *new_item = bmemdup(item, size);
+
+		new_item->ref      = 1;
+		new_item->parent   = copy;
+		new_item->next     = NULL;
+		new_item->capacity = size;
+		item_values_addref(new_item);
+
+		*next = new_item;
+		next  = &new_item->next;
+		hash_map_set(&copy->items, get_item_name(new_item), new_item);
+	}
+
+	return copy;
+}
+
+static obs_data_array_t *copy_array_objects(struct obs_data_array *array)
+{
+	struct obs_data_array *copy = obs_data_array_create();
+
+	da_copy(copy->objects, array->objects);
+	for (size_t i = 0; i < copy->objects.num; i++)
+		obs_data_addref(copy->objects.array[i]);
+
+	return copy;
+}
+
+static void free_versions(struct obs_data_version **p_version, bool array,
+		bool all)
+{
+	while (*p_version) {
+		struct obs_data_version *version = *p_version;
+
+		if (!all && snapshot_alive(version->from, version->to)) {
+			p_version = &version->next;
+			continue;
+		}
+
+		*p_version = version->next;
+
+		if (array)
+			obs_data_array_release(version->array);
+		else
+			obs_data_release(version->data);
+		bfree(version);
+	}
+}
+
+static struct obs_data_version *push_version(
+		struct obs_data_version **versions, long from, long to)
+{
+	struct obs_data_version *version = bzalloc(sizeof(*version));
+	version->from = from;
+	version->to   = to;
+	version->next = *versions;
+	*versions = version;
+	return version;
+}
+
+/* called before an object or array changes, end_change is called after */
+static bool data_begin_change(struct obs_data *data)
+{
+	long epoch;
+
+	if (!data)
+		return false;
+	if (!os_atomic_load_long(&snapshot_count) && !data->versions)
+		return false;
+
+	pthread_mutex_lock(&snapshot_mutex);
+	epoch = snapshot_epoch;
+
+	free_versions(&data->versions, false, false);
+	if (snapshot_alive(data->change_epoch, epoch))
+		push_version(&data->versions, data->change_epoch, epoch)
+			->data = copy_data_items(data);
+
+	data->change_epoch = epoch;
+	return true;
+}
+
+static bool array_begin_change(struct obs_data_array *array)
+{
+	long epoch;
+
+	if (!array)
+		return false;
+	if (!os_atomic_load_long(&snapshot_count) && !array->versions)
+		return false;
+
+	pthread_mutex_lock(&snapshot_mutex);
+	epoch = snapshot_epoch;
+
+	free_versions(&array->versions, true, false);
+	if (snapshot_alive(array->change_epoch, epoch))
+		push_version(&array->versions, array->change_epoch, epoch)
+			->array = copy_array_objects(array);
+
+	array->change_epoch = epoch;
+	return true;
+}
+
+static inline void end_change(bool locked)
+{
+	if (locked)
+		pthread_mutex_unlock(&snapshot_mutex);
+}
+
+/* shallow copy of the object as seen by the snapshot */
+static obs_data_t *data_state_for(struct obs_data *data, long epoch)
+{
+	obs_data_t *state = NULL;
+
+	pthread_mutex_lock(&snapshot_mutex);
+
+	if (data->change_epoch >= epoch) {
+		for (struct obs_data_version *version = data->versions;
+				version; version = version->next) {
+			if (version->from < epoch && epoch <= version->to) {
+				state = copy_data_items(version->data);
+				break;
+			}
+		}
+	}
+
+	if (!state)
+		state = copy_data_items(data);
+
+	pthread_mutex_unlock(&snapshot_mutex);
+	return state;
+}
+
+static obs_data_array_t *array_state_for(struct obs_data_array *array,
+		long epoch)
+{
+	obs_data_array_t *state = NULL;
+
+	pthread_mutex_lock(&snapshot_mutex);
+
+	if (array->change_epoch >= epoch) {
+		for (struct obs_data_version *version = array->versions;
+				version; version = version->next) {
+			if (version->from < epoch && epoch <= version->to) {
+				state = copy_array_objects(version->array);
+				break;
+			}
+		}
+	}
+
+	if (!state)
+		state = copy_array_objects(array);
+
+	pthread_mutex_unlock(&snapshot_mutex);
+	return state;
+}
+
+static obs_data_t *snapshot_copy_data(obs_data_t *data, long epoch);
+
+static obs_data_array_t *snapshot_copy_array(obs_data_array_t *array,
+		long epoch)
+{
+	obs_data_array_t *state;
+
+	if (!array)
+		return NULL;
+
+	/* the state is a private copy, its objects are replaced in place */
+	state = array_state_for(array, epoch);
+	for (size_t i = 0; i < state->objects.num; i++) {
+		obs_data_t **obj = &state->objects.array[i];
+		obs_data_t *copy = snapshot_copy_data(*obj, epoch);
+
+		obs_data_release(*obj);
+		*obj = copy;
+	}
+
+	return state;
+}
+
+static void snapshot_copy_value(struct obs_data_item *item, void *ptr,
+		long epoch)
+{
+	if (item->type == OBS_DATA_OBJECT) {
+		obs_data_t **obj = ptr;
+		obs_data_t *copy = snapshot_copy_data(*obj, epoch);
+
+		obs_data_release(*obj);
+		*obj = copy;
+
+	} else if (item->type == OBS_DATA_ARRAY) {
+		obs_data_array_t **array = ptr;
+		obs_data_array_t *copy = snapshot_copy_array(*array, epoch);
+
+		obs_data_array_release(*array);
+		*array = copy;
+	}
+}
+
+static obs_data_t *snapshot_copy_data(obs_data_t *data, long epoch)
+{
+	obs_data_t *state;
+
+	if (!data)
+		return NULL;
+
+	state = data_state_for(data, epoch);
+	for (struct obs_data_item *item = state->first_item; item;
+			item = item->next) {
+		if (item->data_size)
+			snapshot_copy_value(item, get_data_ptr(item), epoch);
+		if (item->default_size)
+			snapshot_copy_value(item, get_default_data_ptr(item),
+					epoch);
+		if (item->autoselect_size)
+			snapshot_copy_value(item,
+					get_autoselect_data_ptr(item), epoch);
+	}
+
+	return state;
+}
+
+obs_data_snapshot_t *obs_data_snapshot_create(obs_data_t *data)
+{
+	struct obs_data_snapshot *snapshot;
+
+	if (!data)
+		return NULL;
+
+	snapshot = bzalloc(sizeof(struct obs_data_snapshot));
+	snapshot->data = data;
+	obs_data_addref(data);
+
+	pthread_mutex_lock(&snapshot_mutex);
+	snapshot->epoch = os_atomic_inc_long(&snapshot_epoch);
+	da_push_back(snapshot_epochs, &snapshot->epoch);
+	os_atomic_inc_long(&snapshot_count);
+	pthread_mutex_unlock(&snapshot_mutex);
+
+	return snapshot;
+}
+
+void obs_data_snapshot_destroy(obs_data_snapshot_t *snapshot)
+{
+	if (!snapshot)
+		return;
+
+	/* versions kept for the snapshot are freed with the next change */
+	pthread_mutex_lock(&snapshot_mutex);
+	da_erase_item(snapshot_epochs, &snapshot->epoch);
+	if (os_atomic_dec_long(&snapshot_count) == 0)
+		da_free(snapshot_epochs);
+	pthread_mutex_unlock(&snapshot_mutex);
+
+	obs_data_release(snapshot->data);
+	bfree(snapshot);
+}
+
+obs_data_t *obs_data_snapshot_get_data(obs_data_snapshot_t *snapshot)
+{
+	return snapshot ?
+		snapshot_copy_data(snapshot->data, snapshot->epoch) : NULL;
+}
+
 static struct obs_data_item *obs_data_item_create(const char *name,
 		const void *data, size_t size, enum obs_data_type type,
 		bool default_data, bool autoselect_data)
@@ -319,6 +668,8 @@ static inline void obs_data_item_detach(struct obs_data_item *item)
 	if (prev_next) {
 		*prev_next = item->next;
 		item->next = NULL;
+
+		hash_map_remove(&item->parent->items, get_item_name(item));
 	}
 }
 
@@ -328,8 +679,12 @@ static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 	struct obs_data_item **prev_next = get_item_prev_next(new_ptr->parent,
 			old_ptr);
 
-	if (prev_next)
+	/* the name moved with the item, so the key is replaced too */
+	if (prev_next) {
 		*prev_next = new_ptr;
+		hash_map_set(&new_ptr->parent->items, get_item_name(new_ptr),
+				new_ptr);
+	}
 }
 
 static struct obs_data_item *obs_data_item_ensure_capacity(
@@ -459,155 +814,991 @@ static inline void obs_data_item_set_autoselect_data(
 }
 
 /* ------------------------------------------------------------------------- */
+/* JSON reader
+ *
+ *   Single pass parser that sets the values directly on obs_data objects,
+ * without building an intermediate tree.  Like before, arrays may only
+ * contain objects, other array values are skipped, as are null values.
+ */
+
+#define JSON_MAX_DEPTH 1024
+
+struct json_reader {
+	const char  *pos;
+	int         line;
+	int         depth;
+	const char  *error;
+
+	/* string values are read here, keys are read per object */
+	struct dstr str;
+};
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json);
+static inline bool json_fail(struct json_reader *r, const char *error)
+{
+	if (!r->error)
+		r->error = error;
+	return false;
+}
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+static inline void json_skip_ws(struct json_reader *r)
 {
-	const char *item_key;
-	json_t *jitem;
+	for (;;) {
+		char ch = *r->pos;
+
+		if (ch == '\n')
+			r->line++;
+		else if (ch != ' ' && ch != '\t' && ch != '\r')
+			break;
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+		r->pos++;
 	}
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-		json_t *jobj)
+static inline void json_reset_str(struct dstr *str)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	if (str->array) {
+		str->array[0] = 0;
+		str->len = 0;
+	} else {
+		dstr_reserve(str, 64);
+		str->array[0] = 0;
+	}
+}
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+static inline int json_hex(char ch)
+{
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+	return -1;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-		json_t *jarray)
+static bool json_read_u16(struct json_reader *r, uint32_t *val)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	*val = 0;
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+	for (int i = 0; i < 4; i++) {
+		int digit = json_hex(*r->pos);
+		if (digit < 0)
+			return json_fail(r, "invalid \\u escape");
 
-		if (!json_is_object(jitem))
-			continue;
+		*val = (*val << 4) | (uint32_t)digit;
+		r->pos++;
+	}
+
+	return true;
+}
+
+static void json_cat_utf8(struct dstr *str, uint32_t cp)
+{
+	char utf8[4];
+	size_t len;
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+	if (cp < 0x80) {
+		utf8[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		utf8[0] = (char)(0xC0 | (cp >> 6));
+		utf8[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		utf8[0] = (char)(0xE0 | (cp >> 12));
+		utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		utf8[0] = (char)(0xF0 | (cp >> 18));
+		utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	dstr_ncat(str, utf8, len);
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json)
+static bool json_read_escape(struct json_reader *r, struct dstr *str)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	uint32_t cp;
+	char ch = *(r->pos++);
+
+	switch (ch) {
+	case '"':  dstr_cat_ch(str, '"');  return true;
+	case '\\': dstr_cat_ch(str, '\\'); return true;
+	case '/':  dstr_cat_ch(str, '/');  return true;
+	case 'b':  dstr_cat_ch(str, '\b'); return true;
+	case 'f':  dstr_cat_ch(str, '\f'); return true;
+	case 'n':  dstr_cat_ch(str, '\n'); return true;
+	case 'r':  dstr_cat_ch(str, '\r'); return true;
+	case 't':  dstr_cat_ch(str, '\t'); return true;
+	case 'u':  break;
+	default:   return json_fail(r, "invalid escape");
+	}
+
+	if (!json_read_u16(r, &cp))
+		return false;
+
+	/* characters outside of the BMP are escaped as surrogate pairs */
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		uint32_t low;
+
+		if (r->pos[0] != '\\' || r->pos[1] != 'u')
+			return json_fail(r, "invalid Unicode surrogate pair");
+
+		r->pos += 2;
+		if (!json_read_u16(r, &low))
+			return false;
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_fail(r, "invalid Unicode surrogate pair");
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_fail(r, "invalid Unicode surrogate pair");
+
+	} else if (cp == 0) {
+		return json_fail(r, "\\u0000 is not allowed");
+	}
+
+	json_cat_utf8(str, cp);
+	return true;
 }
 
-/* ------------------------------------------------------------------------- */
+static bool json_read_string(struct json_reader *r, struct dstr *str)
+{
+	json_reset_str(str);
+
+	if (*r->pos != '"')
+		return json_fail(r, "expected string");
+	r->pos++;
+
+	for (;;) {
+		const char *start = r->pos;
+
+		/* copy unescaped runs in one go */
+		while (*r->pos != '"' && *r->pos != '\\' &&
+		       (unsigned char)*r->pos >= 0x20)
+			r->pos++;
+
+		if (r->pos != start)
+			dstr_ncat(str, start, r->pos - start);
+
+		if (*r->pos == '"') {
+			r->pos++;
+			return true;
+
+		} else if (*r->pos == '\\') {
+			r->pos++;
+			if (!json_read_escape(r, str))
+				return false;
 
-static inline void set_json_string(json_t *json, const char *name,
-		obs_data_item_t *item)
+		} else if (!*r->pos) {
+			return json_fail(r, "premature end of input");
+
+		} else {
+			return json_fail(r, "control character in string");
+		}
+	}
+}
+
+static inline bool json_match(struct json_reader *r, const char *literal)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	size_t len = strlen(literal);
+
+	if (strncmp(r->pos, literal, len) != 0)
+		return json_fail(r, "invalid token");
+
+	r->pos += len;
+	return true;
+}
+
+static inline bool json_is_digit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+/* strtod uses the locale's decimal point */
+static inline void json_to_locale(char *num)
+{
+	const char *point = localeconv()->decimal_point;
+	char *dot;
+
+	if (*point != '.' && (dot = strchr(num, '.')) != NULL)
+		*dot = *point;
 }
 
-static inline void set_json_number(json_t *json, const char *name,
-		obs_data_item_t *item)
+static bool json_read_number(struct json_reader *r, obs_data_t *data,
+		const char *key)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	const char *start = r->pos;
+	bool real = false;
+	char num[64];
+	size_t len;
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
+	if (*r->pos == '-')
+		r->pos++;
+
+	if (*r->pos == '0') {
+		r->pos++;
+	} else if (json_is_digit(*r->pos)) {
+		while (json_is_digit(*r->pos))
+			r->pos++;
 	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+		return json_fail(r, "invalid token");
+	}
+
+	if (*r->pos == '.') {
+		real = true;
+		r->pos++;
+		if (!json_is_digit(*r->pos))
+			return json_fail(r, "invalid number");
+		while (json_is_digit(*r->pos))
+			r->pos++;
+	}
+
+	if (*r->pos == 'e' || *r->pos == 'E') {
+		real = true;
+		r->pos++;
+		if (*r->pos == '+' || *r->pos == '-')
+			r->pos++;
+		if (!json_is_digit(*r->pos))
+			return json_fail(r, "invalid number");
+		while (json_is_digit(*r->pos))
+			r->pos++;
+	}
+
+	len = r->pos - start;
+	if (len >= sizeof(num))
+		return json_fail(r, "number too long");
+
+	if (!data)
+		return true;
+
+	memcpy(num, start, len);
+	num[len] = 0;
+
+	if (!real) {
+		long long val;
+
+		errno = 0;
+		val = strtoll(num, NULL, 10);
+		if (errno != ERANGE) {
+			obs_data_set_int(data, key, val);
+			return true;
+		}
+
+		/* too big for an integer, keep it as a double */
 	}
+
+	json_to_locale(num);
+	obs_data_set_double(data, key, strtod(num, NULL));
+	return true;
 }
 
-static inline void set_json_bool(json_t *json, const char *name,
-		obs_data_item_t *item)
+static bool json_read_value(struct json_reader *r, obs_data_t *data,
+		const char *key);
+
+/* reads the members of an object in to data, or skips them if data is NULL */
+static bool json_read_object(struct json_reader *r, obs_data_t *data)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	struct dstr key = {0};
+	bool success = false;
+
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_fail(r, "maximum nesting depth exceeded");
+
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == '}') {
+		r->pos++;
+		success = true;
+		goto exit;
+	}
+
+	for (;;) {
+		json_skip_ws(r);
+		if (!json_read_string(r, &key))
+			goto exit;
+
+		json_skip_ws(r);
+		if (*r->pos != ':') {
+			json_fail(r, "':' expected");
+			goto exit;
+		}
+		r->pos++;
+
+		json_skip_ws(r);
+		if (!json_read_value(r, data, key.array))
+			goto exit;
+
+		json_skip_ws(r);
+		if (*r->pos == '}') {
+			r->pos++;
+			break;
+		} else if (*r->pos != ',') {
+			json_fail(r, "'}' expected");
+			goto exit;
+		}
+		r->pos++;
+	}
+
+	success = true;
+
+exit:
+	r->depth--;
+	dstr_free(&key);
+	return success;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data);
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array)
+{
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_fail(r, "maximum nesting depth exceeded");
 
-static inline void set_json_obj(json_t *json, const char *name,
-		obs_data_item_t *item)
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == ']') {
+		r->pos++;
+		r->depth--;
+		return true;
+	}
+
+	for (;;) {
+		json_skip_ws(r);
+
+		if (*r->pos == '{' && array) {
+			obs_data_t *item = obs_data_create();
+			bool success = json_read_object(r, item);
+
+			obs_data_array_push_back(array, item);
+			obs_data_release(item);
+			if (!success)
+				return false;
+
+		} else if (!json_read_value(r, NULL, NULL)) {
+			return false;
+		}
+
+		json_skip_ws(r);
+		if (*r->pos == ']') {
+			r->pos++;
+			break;
+		} else if (*r->pos != ',') {
+			return json_fail(r, "']' expected");
+		}
+		r->pos++;
+	}
+
+	r->depth--;
+	return true;
+}
+
+/* sets the value on data, or skips it if data is NULL */
+static bool json_read_value(struct json_reader *r, obs_data_t *data,
+		const char *key)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj));
-	obs_data_release(obj);
+	switch (*r->pos) {
+	case '{': {
+		obs_data_t *obj;
+		bool success;
+
+		if (!data)
+			return json_read_object(r, NULL);
+
+		obj = obs_data_create();
+		success = json_read_object(r, obj);
+		obs_data_set_obj(data, key, obj);
+		obs_data_release(obj);
+		return success;
+	}
+
+	case '[': {
+		obs_data_array_t *array;
+		bool success;
+
+		if (!data)
+			return json_read_array(r, NULL);
+
+		array = obs_data_array_create();
+		success = json_read_array(r, array);
+		obs_data_set_array(data, key, array);
+		obs_data_array_release(array);
+		return success;
+	}
+
+	case '"':
+		if (!json_read_string(r, &r->str))
+			return false;
+		if (data)
+			obs_data_set_string(data, key, r->str.array);
+		return true;
+
+	case 't':
+		if (!json_match(r, "true"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, true);
+		return true;
+
+	case 'f':
+		if (!json_match(r, "false"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, false);
+		return true;
+
+	case 'n':
+		return json_match(r, "null");
+
+	case 0:
+		return json_fail(r, "premature end of input");
+	}
+
+	return json_read_number(r, data, key);
+}
+
+static bool obs_data_read_json(obs_data_t *data, const char *json_string,
+		struct json_reader *r)
+{
+	bool success;
+
+	r->pos  = json_string;
+	r->line = 1;
+
+	json_skip_ws(r);
+
+	if (*r->pos == '{')
+		success = json_read_object(r, data);
+	else if (*r->pos == '[')
+		/* valid json, but there's nothing to add */
+		success = json_read_array(r, NULL);
+	else
+		return json_fail(r, "'[' or '{' expected");
+
+	if (!success)
+		return false;
+
+	json_skip_ws(r);
+	if (*r->pos)
+		return json_fail(r, "end of file expected");
+
+	return true;
 }
 
-static inline void set_json_array(json_t *json, const char *name,
-		obs_data_item_t *item)
+/* ------------------------------------------------------------------------- */
+/* JSON writer
+ *
+ *   Writes the same output as jansson did with JSON_PRESERVE_ORDER and
+ * JSON_INDENT(4), straight from the items.
+ */
+
+static inline void json_write_indent(struct dstr *out, int depth)
 {
-	json_t           *jarray = json_array();
-	obs_data_array_t *array   = obs_data_item_get_array(item);
-	size_t           count   = obs_data_array_count(array);
+	dstr_cat_ch(out, '\n');
+	for (int i = 0; i < depth; i++)
+		dstr_ncat(out, "    ", 4);
+}
+
+static void json_write_string(struct dstr *out, const char *str)
+{
+	dstr_cat_ch(out, '"');
+
+	while (str && *str) {
+		const char *start = str;
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t     *jitem   = obs_data_to_json(sub_item);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+		while (*str && *str != '"' && *str != '\\' &&
+		       (unsigned char)*str >= 0x20)
+			str++;
+
+		if (str != start)
+			dstr_ncat(out, start, str - start);
+		if (!*str)
+			break;
+
+		switch (*str) {
+		case '"':  dstr_ncat(out, "\\\"", 2); break;
+		case '\\': dstr_ncat(out, "\\\\", 2); break;
+		case '\b': dstr_ncat(out, "\\b", 2);  break;
+		case '\f': dstr_ncat(out, "\\f", 2);  break;
+		case '\n': dstr_ncat(out, "\\n", 2);  break;
+		case '\r': dstr_ncat(out, "\\r", 2);  break;
+		case '\t': dstr_ncat(out, "\\t", 2);  break;
+		default:
+			dstr_catf(out, "\\u%04X", (unsigned)*str);
+		}
+
+		str++;
+	}
+
+	dstr_cat_ch(out, '"');
+}
+
+static void json_write_double(struct dstr *out, double val)
+{
+	const char *point = localeconv()->decimal_point;
+	char num[64];
+	char *pos;
+
+	snprintf(num, sizeof(num), "%.17g", val);
+
+	if (*point != '.' && (pos = strchr(num, *point)) != NULL)
+		*pos = '.';
+
+	/* keep it a real when read back */
+	if (!strchr(num, '.') && !strchr(num, 'e')) {
+		dstr_cat(out, num);
+		dstr_ncat(out, ".0", 2);
+		return;
+	}
+
+	/* no '+' or leading zeros in the exponent */
+	pos = strchr(num, 'e');
+	if (pos) {
+		char *start = ++pos;
+		char *end;
+
+		if (*start == '-')
+			start++;
+
+		end = start;
+		if (*end == '+')
+			end++;
+		while (*end == '0' && end[1])
+			end++;
+
+		memmove(start, end, strlen(end) + 1);
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	dstr_cat(out, num);
+}
+
+static void json_write_obj(struct dstr *out, obs_data_t *data, int depth);
+
+static void json_write_array(struct dstr *out, obs_data_array_t *array,
+		int depth)
+{
+	size_t count = array ? array->objects.num : 0;
+
+	dstr_cat_ch(out, '[');
+
+	for (size_t i = 0; i < count; i++) {
+		if (i)
+			dstr_cat_ch(out, ',');
+		json_write_indent(out, depth + 1);
+		json_write_obj(out, array->objects.array[i], depth + 1);
+	}
+
+	if (count)
+		json_write_indent(out, depth);
+	dstr_cat_ch(out, ']');
+}
+
+static void json_write_item(struct dstr *out, struct obs_data_item *item,
+		int depth)
+{
+	struct obs_data_number *num;
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		json_write_string(out, get_item_data(item));
+		break;
+
+	case OBS_DATA_NUMBER:
+		num = get_item_data(item);
+		if (num->type == OBS_DATA_NUM_INT)
+			dstr_catf(out, "%lld", num->int_val);
+		else
+			json_write_double(out, num->double_val);
+		break;
+
+	case OBS_DATA_BOOLEAN:
+		dstr_cat(out, *(bool*)get_item_data(item) ? "true" : "false");
+		break;
+
+	case OBS_DATA_OBJECT:
+		json_write_obj(out, get_item_obj(item), depth);
+		break;
+
+	case OBS_DATA_ARRAY:
+		json_write_array(out, get_item_array(item), depth);
+		break;
+
+	case OBS_DATA_NULL:
+		break;
+	}
 }
 
-static json_t *obs_data_to_json(obs_data_t *data)
+static void json_write_obj(struct dstr *out, obs_data_t *data, int depth)
 {
-	json_t *json = json_object();
-	obs_data_item_t *item = NULL;
+	struct obs_data_item *item = data ? data->first_item : NULL;
+	bool empty = true;
 
-	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name        = get_item_name(item);
+	dstr_cat_ch(out, '{');
 
-		if (!obs_data_item_has_user_value(item))
+	for (; item; item = item->next) {
+		if (!item->data_size || item->type == OBS_DATA_NULL)
 			continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item);
+		if (!empty)
+			dstr_cat_ch(out, ',');
+		json_write_indent(out, depth + 1);
+
+		json_write_string(out, get_item_name(item));
+		dstr_ncat(out, ": ", 2);
+		json_write_item(out, item, depth + 1);
+
+		empty = false;
+	}
+
+	if (!empty)
+		json_write_indent(out, depth);
+	dstr_cat_ch(out, '}');
+}
+
+/* ------------------------------------------------------------------------- */
+/* Binary format
+ *
+ *   Little endian, with every object and array prefixed by its size so that
+ * readers can skip over them, and no pointers, so a saved buffer can be used
+ * straight from a memory mapped file:
+ *
+ *     [char[4]  "OBSD"]
+ *     [uint32   version]
+ *     [uint64   size of the root object]
+ *     [object]
+ *
+ *   object: [uint32 size of the rest] [uint32 item count] [items]
+ *   item:   [uint8 type] [uint32 name length] [name + null terminator]
+ *           [value]
+ *   string: [uint32 length] [string + null terminator]
+ *   int:    [int64]
+ *   double: [float64]
+ *   bool:   [uint8]
+ *   array:  [uint32 size of the rest] [uint32 object count] [objects]
+ *
+ *   Only user values are stored, like with JSON.
+ */
+
+#define BINARY_MAGIC   "OBSD"
+#define BINARY_VERSION 1
+
+enum binary_type {
+	BINARY_STRING = 1,
+	BINARY_INT,
+	BINARY_DOUBLE,
+	BINARY_BOOL,
+	BINARY_OBJECT,
+	BINARY_ARRAY
+};
+
+static inline bool binary_item_saved(struct obs_data_item *item)
+{
+	return item->data_size && item->type != OBS_DATA_NULL;
+}
+
+static size_t binary_obj_size(obs_data_t *data);
+
+static size_t binary_array_size(obs_data_array_t *array)
+{
+	size_t size = 8;
+
+	for (size_t i = 0; array && i < array->objects.num; i++)
+		size += binary_obj_size(array->objects.array[i]);
+
+	return size;
+}
+
+static size_t binary_item_size(struct obs_data_item *item)
+{
+	size_t size = 1 + 4 + strlen(get_item_name(item)) + 1;
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		return size + 4 + strlen(get_item_data(item)) + 1;
+	case OBS_DATA_NUMBER:
+		return size + 8;
+	case OBS_DATA_BOOLEAN:
+		return size + 1;
+	case OBS_DATA_OBJECT:
+		return size + binary_obj_size(get_item_obj(item));
+	case OBS_DATA_ARRAY:
+		return size + binary_array_size(get_item_array(item));
+	case OBS_DATA_NULL:
+		break;
+	}
+
+	return size;
+}
+
+static size_t binary_obj_size(obs_data_t *data)
+{
+	struct obs_data_item *item = data ? data->first_item : NULL;
+	size_t size = 8;
+
+	for (; item; item = item->next)
+		if (binary_item_saved(item))
+			size += binary_item_size(item);
+
+	return size;
+}
+
+static inline void binary_write_str(struct serializer *s, const char *str)
+{
+	size_t len = strlen(str);
+
+	s_wl32(s, (uint32_t)len);
+	s_write(s, str, len + 1);
+}
+
+static void binary_write_obj(struct serializer *s, obs_data_t *data);
+
+static void binary_write_array(struct serializer *s, obs_data_array_t *array)
+{
+	size_t count = array ? array->objects.num : 0;
+
+	s_wl32(s, (uint32_t)(binary_array_size(array) - 4));
+	s_wl32(s, (uint32_t)count);
+
+	for (size_t i = 0; i < count; i++)
+		binary_write_obj(s, array->objects.array[i]);
+}
+
+static void binary_write_item(struct serializer *s, struct obs_data_item *item)
+{
+	struct obs_data_number *num;
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		s_w8(s, BINARY_STRING);
+		binary_write_str(s, get_item_name(item));
+		binary_write_str(s, get_item_data(item));
+		break;
+
+	case OBS_DATA_NUMBER:
+		num = get_item_data(item);
+		if (num->type == OBS_DATA_NUM_INT) {
+			s_w8(s, BINARY_INT);
+			binary_write_str(s, get_item_name(item));
+			s_wl64(s, (uint64_t)num->int_val);
+		} else {
+			s_w8(s, BINARY_DOUBLE);
+			binary_write_str(s, get_item_name(item));
+			s_wld(s, num->double_val);
+		}
+		break;
+
+	case OBS_DATA_BOOLEAN:
+		s_w8(s, BINARY_BOOL);
+		binary_write_str(s, get_item_name(item));
+		s_w8(s, *(bool*)get_item_data(item) ? 1 : 0);
+		break;
+
+	case OBS_DATA_OBJECT:
+		s_w8(s, BINARY_OBJECT);
+		binary_write_str(s, get_item_name(item));
+		binary_write_obj(s, get_item_obj(item));
+		break;
+
+	case OBS_DATA_ARRAY:
+		s_w8(s, BINARY_ARRAY);
+		binary_write_str(s, get_item_name(item));
+		binary_write_array(s, get_item_array(item));
+		break;
+
+	case OBS_DATA_NULL:
+		break;
+	}
+}
+
+static void binary_write_obj(struct serializer *s, obs_data_t *data)
+{
+	struct obs_data_item *item = data ? data->first_item : NULL;
+	uint32_t count = 0;
+
+	for (struct obs_data_item *cur = item; cur; cur = cur->next)
+		if (binary_item_saved(cur))
+			count++;
+
+	s_wl32(s, (uint32_t)(binary_obj_size(data) - 4));
+	s_wl32(s, count);
+
+	for (; item; item = item->next)
+		if (binary_item_saved(item))
+			binary_write_item(s, item);
+}
+
+struct binary_reader {
+	const uint8_t *pos;
+	const uint8_t *end;
+	int           depth;
+};
+
+static inline bool binary_read(struct binary_reader *r, void *out, size_t size)
+{
+	if ((size_t)(r->end - r->pos) < size)
+		return false;
+
+	memcpy(out, r->pos, size);
+	r->pos += size;
+	return true;
+}
+
+static inline bool binary_read_u32(struct binary_reader *r, uint32_t *val)
+{
+	uint8_t b[4];
+	if (!binary_read(r, b, sizeof(b)))
+		return false;
+
+	*val = (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+		((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+	return true;
+}
+
+static inline bool binary_read_u64(struct binary_reader *r, uint64_t *val)
+{
+	uint32_t lo, hi;
+	if (!binary_read_u32(r, &lo) || !binary_read_u32(r, &hi))
+		return false;
+
+	*val = (uint64_t)lo | ((uint64_t)hi << 32);
+	return true;
+}
+
+/* strings are used in place, they're stored with their null terminator */
+static inline bool binary_read_str(struct binary_reader *r, const char **str)
+{
+	uint32_t len;
+
+	if (!binary_read_u32(r, &len))
+		return false;
+	if ((size_t)(r->end - r->pos) <= len || r->pos[len] != 0)
+		return false;
+
+	*str = (const char*)r->pos;
+	r->pos += len + 1;
+	return true;
+}
+
+static bool binary_read_obj(struct binary_reader *r, obs_data_t *data);
+
+static bool binary_read_sized_obj(struct binary_reader *r, obs_data_t *data)
+{
+	struct binary_reader sub;
+	uint32_t size;
+
+	if (!binary_read_u32(r, &size) || (size_t)(r->end - r->pos) < size)
+		return false;
+
+	sub.pos   = r->pos;
+	sub.end   = r->pos + size;
+	sub.depth = r->depth + 1;
+	r->pos   += size;
+
+	return sub.depth <= JSON_MAX_DEPTH && binary_read_obj(&sub, data) &&
+		sub.pos == sub.end;
+}
+
+static bool binary_read_array(struct binary_reader *r, obs_data_array_t *array)
+{
+	struct binary_reader sub;
+	uint32_t size, count;
+
+	if (!binary_read_u32(r, &size) || (size_t)(r->end - r->pos) < size)
+		return false;
+
+	sub.pos   = r->pos;
+	sub.end   = r->pos + size;
+	sub.depth = r->depth + 1;
+	r->pos   += size;
+
+	if (!binary_read_u32(&sub, &count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		obs_data_t *obj = obs_data_create();
+		bool success = binary_read_sized_obj(&sub, obj);
+
+		obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
+		if (!success)
+			return false;
 	}
 
-	return json;
+	return sub.pos == sub.end;
+}
+
+static bool binary_read_item(struct binary_reader *r, obs_data_t *data)
+{
+	const char *name, *str;
+	uint64_t val;
+	uint8_t type, b;
+	double d;
+
+	if (!binary_read(r, &type, 1) || !binary_read_str(r, &name))
+		return false;
+
+	switch (type) {
+	case BINARY_STRING:
+		if (!binary_read_str(r, &str))
+			return false;
+		obs_data_set_string(data, name, str);
+		return true;
+
+	case BINARY_INT:
+		if (!binary_read_u64(r, &val))
+			return false;
+		obs_data_set_int(data, name, (long long)val);
+		return true;
+
+	case BINARY_DOUBLE:
+		if (!binary_read_u64(r, &val))
+			return false;
+		memcpy(&d, &val, sizeof(d));
+		obs_data_set_double(data, name, d);
+		return true;
+
+	case BINARY_BOOL:
+		if (!binary_read(r, &b, 1))
+			return false;
+		obs_data_set_bool(data, name, b != 0);
+		return true;
+
+	case BINARY_OBJECT: {
+		obs_data_t *obj = obs_data_create();
+		bool success = binary_read_sized_obj(r, obj);
+
+		obs_data_set_obj(data, name, obj);
+		obs_data_release(obj);
+		return success;
+	}
+
+	case BINARY_ARRAY: {
+		obs_data_array_t *array = obs_data_array_create();
+		bool success = binary_read_array(r, array);
+
+		obs_data_set_array(data, name, array);
+		obs_data_array_release(array);
+		return success;
+	}
+	}
+
+	return false;
+}
+
+static bool binary_read_obj(struct binary_reader *r, obs_data_t *data)
+{
+	uint32_t count;
+
+	if (!binary_read_u32(r, &count))
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+		if (!binary_read_item(r, data))
+			return false;
+
+	return true;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -616,6 +1807,7 @@ obs_data_t *obs_data_create()
 {
 	struct obs_data *data = bzalloc(sizeof(struct obs_data));
 	data->ref = 1;
+	data->change_epoch = os_atomic_load_long(&snapshot_epoch);
 
 	return data;
 }
@@ -623,19 +1815,20 @@ obs_data_t *obs_data_create()
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
 	obs_data_t *data = obs_data_create();
+	struct json_reader reader = {0};
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
-
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
+	if (!json_string || !obs_data_read_json(data, json_string, &reader)) {
 		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_json] "
 		                "Failed reading json string (%d): %s",
-		                error.line, error.text);
+		                reader.line, reader.error ? reader.error :
+		                "no json data");
+
+		/* don't return partially read data */
+		obs_data_release(data);
+		data = obs_data_create();
 	}
 
+	dstr_free(&reader.str);
 	return data;
 }
 
@@ -655,8 +1848,10 @@ static inline void obs_data_destroy(struct obs_data *data)
 		item = next;
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	hash_map_free(&data->items);
+	free_versions(&data->versions, false, true);
+
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -670,33 +1865,64 @@ void obs_data_release(obs_data_t *data)
 
 const char *obs_data_get_json(obs_data_t *data)
 {
+	struct dstr json = {0};
+
 	if (!data) return NULL;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
-	data->json = NULL;
+	bfree(data->json);
 
-	json_t *root = obs_data_to_json(data);
-	data->json = json_dumps(root, JSON_PRESERVE_ORDER | JSON_INDENT(4));
-	json_decref(root);
+	json_write_obj(&json, data, 0);
+	data->json = json.array;
 
 	return data->json;
 }
 
-static struct obs_data_item *get_item(struct obs_data *data, const char *name)
+void obs_data_write_binary(obs_data_t *data, struct serializer *s)
 {
-	if (!data) return NULL;
-
-	struct obs_data_item *item = data->first_item;
+	if (!data || !s) return;
 
-	while (item) {
-		if (strcmp(get_item_name(item), name) == 0)
-			return item;
+	s_write(s, BINARY_MAGIC, 4);
+	s_wl32(s, BINARY_VERSION);
+	s_wl64(s, binary_obj_size(data));
+	binary_write_obj(s, data);
+}
 
-		item = item->next;
+obs_data_t *obs_data_create_from_binary(const void *bin, size_t size)
+{
+	obs_data_t *data = obs_data_create();
+	struct binary_reader r = {bin, (const uint8_t*)bin + size, 0};
+	uint32_t version;
+	uint64_t obj_size;
+	char magic[4];
+	bool success;
+
+	success = bin &&
+		binary_read(&r, magic, 4) &&
+		memcmp(magic, BINARY_MAGIC, 4) == 0 &&
+		binary_read_u32(&r, &version) && version == BINARY_VERSION &&
+		binary_read_u64(&r, &obj_size) &&
+		obj_size == (uint64_t)(r.end - r.pos);
+
+	/* the root object is read like any other size-prefixed object */
+	if (success)
+		success = binary_read_sized_obj(&r, data);
+
+	if (!success) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+		                "Invalid or truncated data");
+
+		obs_data_release(data);
+		data = obs_data_create();
 	}
 
-	return NULL;
+	return data;
+}
+
+static struct obs_data_item *get_item(struct obs_data *data, const char *name)
+{
+	if (!data) return NULL;
+
+	return hash_map_find(&data->items, name);
 }
 
 static void set_item_data(struct obs_data *data, struct obs_data_item **item,
@@ -705,6 +1931,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 		bool default_data, bool autoselect_data)
 {
 	obs_data_item_t *new_item = NULL;
+	bool locked = data_begin_change(data ? data :
+			(item && *item ? (*item)->parent : NULL));
 
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
@@ -732,6 +1960,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 		if (!prev)
 			data->first_item = new_item;
 
+		hash_map_set(&data->items, get_item_name(new_item), new_item);
+
 		obs_data_item_release(&prev);
 		obs_data_item_release(&next);
 
@@ -742,6 +1972,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	} else {
 		obs_data_item_setdata(item, ptr, size, type);
 	}
+
+	end_change(locked);
 }
 
 static inline void set_item(struct obs_data *data, obs_data_item_t **item,
@@ -826,9 +2058,96 @@ void obs_data_erase(obs_data_t *data, const char *name)
 	struct obs_data_item *item = get_item(data, name);
 
 	if (item) {
+		bool locked = data_begin_change(data);
 		obs_data_item_detach(item);
 		obs_data_item_release(&item);
+		end_change(locked);
+	}
+}
+
+/* serializes the current (user or default) value of an item, so that it can
+ * be compared with an earlier one */
+static void item_fingerprint(struct obs_data_item *item, struct dstr *str)
+{
+	obs_data_array_t *array;
+	obs_data_t *obj;
+
+	switch (item->type) {
+	case OBS_DATA_NULL:
+		dstr_copy(str, "n");
+		break;
+	case OBS_DATA_STRING:
+		dstr_copy(str, "s");
+		dstr_cat(str, obs_data_item_get_string(item));
+		break;
+	case OBS_DATA_NUMBER:
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+			dstr_printf(str, "i%lld", obs_data_item_get_int(item));
+		else
+			dstr_printf(str, "d%.17g",
+					obs_data_item_get_double(item));
+		break;
+	case OBS_DATA_BOOLEAN:
+		dstr_copy(str, obs_data_item_get_bool(item) ? "b1" : "b0");
+		break;
+	case OBS_DATA_OBJECT:
+		obj = obs_data_item_get_obj(item);
+		dstr_copy(str, "o");
+		if (obj)
+			dstr_cat(str, obs_data_get_json(obj));
+		obs_data_release(obj);
+		break;
+	case OBS_DATA_ARRAY:
+		array = obs_data_item_get_array(item);
+		dstr_copy(str, "a");
+		for (size_t i = 0; i < obs_data_array_count(array); i++) {
+			obj = obs_data_array_item(array, i);
+			dstr_cat(str, obs_data_get_json(obj));
+			dstr_cat(str, "\n");
+			obs_data_release(obj);
+		}
+		obs_data_array_release(array);
+		break;
+	}
+}
+
+void obs_data_get_changes(obs_data_t *data, obs_data_t *state,
+		obs_data_t *changed)
+{
+	struct obs_data_item *item;
+	struct dstr fingerprint = {0};
+
+	if (!data || !state)
+		return;
+
+	for (item = data->first_item; item; item = item->next) {
+		const char *name = get_item_name(item);
+
+		item_fingerprint(item, &fingerprint);
+		if (strcmp(obs_data_get_string(state, name),
+					fingerprint.array) == 0)
+			continue;
+
+		obs_data_set_string(state, name, fingerprint.array);
+		if (changed)
+			obs_data_set_bool(changed, name, true);
 	}
+
+	item = state->first_item;
+	while (item) {
+		struct obs_data_item *next = item->next;
+		const char *name = get_item_name(item);
+
+		if (!get_item(data, name)) {
+			if (changed)
+				obs_data_set_bool(changed, name, true);
+			obs_data_erase(state, name);
+		}
+
+		item = next;
+	}
+
+	dstr_free(&fingerprint);
 }
 
 typedef void (*set_item_t)(obs_data_t*, obs_data_item_t**, const char*,
@@ -1072,6 +2391,7 @@ obs_data_array_t *obs_data_array_create()
 {
 	struct obs_data_array *array = bzalloc(sizeof(struct obs_data_array));
 	array->ref = 1;
+	array->change_epoch = os_atomic_load_long(&snapshot_epoch);
 
 	return array;
 }
@@ -1088,6 +2408,7 @@ static inline void obs_data_array_destroy(obs_data_array_t *array)
 		for (size_t i = 0; i < array->objects.num; i++)
 			obs_data_release(array->objects.array[i]);
 		da_free(array->objects);
+		free_versions(&array->versions, true, true);
 		bfree(array);
 	}
 }
@@ -1125,8 +2446,14 @@ size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
 	if (!array || !obj)
 		return 0;
 
+	bool locked = array_begin_change(array);
+	size_t idx;
+
 	os_atomic_inc_long(&obj->ref);
-	return da_push_back(array->objects, &obj);
+	idx = da_push_back(array->objects, &obj);
+
+	end_change(locked);
+	return idx;
 }
 
 void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
@@ -1134,15 +2461,23 @@ void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
 	if (!array || !obj)
 		return;
 
+	bool locked = array_begin_change(array);
+
 	os_atomic_inc_long(&obj->ref);
 	da_insert(array->objects, idx, &obj);
+
+	end_change(locked);
 }
 
 void obs_data_array_erase(obs_data_array_t *array, size_t idx)
 {
 	if (array) {
+		bool locked = array_begin_change(array);
+
 		obs_data_release(array->objects.array[idx]);
 		da_erase(array->objects, idx);
+
+		end_change(locked);
 	}
 }
 
@@ -1203,6 +2538,7 @@ void obs_data_item_unset_user_value(obs_data_item_t *item)
 		return;
 
 	void *old_non_user_data = get_default_data_ptr(item);
+	bool locked = data_begin_change(item->parent);
 
 	item_data_release(item);
 	item->data_size = 0;
@@ -1212,6 +2548,8 @@ void obs_data_item_unset_user_value(obs_data_item_t *item)
 		move_data(item, old_non_user_data, item,
 				get_default_data_ptr(item),
 				item->default_len + item->autoselect_size);
+
+	end_change(locked);
 }
 
 void obs_data_item_unset_default_value(obs_data_item_t *item)
@@ -1220,6 +2558,7 @@ void obs_data_item_unset_default_value(obs_data_item_t *item)
 		return;
 
 	void *old_autoselect_data = get_autoselect_data_ptr(item);
+	bool locked = data_begin_change(item->parent);
 
 	item_default_data_release(item);
 	item->default_size = 0;
@@ -1229,6 +2568,8 @@ void obs_data_item_unset_default_value(obs_data_item_t *item)
 		move_data(item, old_autoselect_data, item,
 				get_autoselect_data_ptr(item),
 				item->autoselect_size);
+
+	end_change(locked);
 }
 
 void obs_data_item_unset_autoselect_value(obs_data_item_t *item)
@@ -1236,8 +2577,12 @@ void obs_data_item_unset_autoselect_value(obs_data_item_t *item)
 	if (!item || !item->autoselect_size)
 		return;
 
+	bool locked = data_begin_change(item->parent);
+
 	item_autoselect_data_release(item);
 	item->autoselect_size = 0;
+
+	end_change(locked);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1295,11 +2640,18 @@ void obs_data_item_release(obs_data_item_t **item)
 void obs_data_item_remove(obs_data_item_t **item)
 {
 	if (item && *item) {
+		bool locked = data_begin_change((*item)->parent);
 		obs_data_item_detach(*item);
 		obs_data_item_release(item);
+		end_change(locked);
 	}
 }
 
+const char *obs_data_item_get_name(obs_data_item_t *item)
+{
+	return item ? get_item_name(item) : NULL;
+}
+
 enum obs_data_type obs_data_item_gettype(obs_data_item_t *item)
 {
 	return item ? item->type : OBS_DATA_NULL;
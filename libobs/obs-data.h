@@ -27,6 +27,7 @@ struct vec2;
 struct vec3;
 struct vec4;
 struct quat;
+struct serializer;
 
 /*
  * OBS data settings storage
@@ -38,9 +39,11 @@ struct quat;
 struct obs_data;
 struct obs_data_item;
 struct obs_data_array;
-typedef struct obs_data       obs_data_t;
-typedef struct obs_data_item  obs_data_item_t;
-typedef struct obs_data_array obs_data_array_t;
+struct obs_data_snapshot;
+typedef struct obs_data          obs_data_t;
+typedef struct obs_data_item     obs_data_item_t;
+typedef struct obs_data_array    obs_data_array_t;
+typedef struct obs_data_snapshot obs_data_snapshot_t;
 
 enum obs_data_type {
 	OBS_DATA_NULL,
@@ -67,10 +70,43 @@ EXPORT void obs_data_release(obs_data_t *data);
 
 EXPORT const char *obs_data_get_json(obs_data_t *data);
 
+/* compact binary encoding of the user values, for fast loading and for
+ * passing settings between processes.  the encoded data is size-prefixed and
+ * contains no pointers, so it can be decoded straight from a mapped file */
+EXPORT void obs_data_write_binary(obs_data_t *data, struct serializer *s);
+EXPORT obs_data_t *obs_data_create_from_binary(const void *bin, size_t size);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
 
+/**
+ * Finds the items of 'data' whose values changed since the last call.
+ *
+ * 'state' keeps a fingerprint of each value from the previous call (start
+ * with an empty data object) and is updated to the current values.  Every
+ * item that was added, removed, or has a different user or default value is
+ * set to true in 'changed', which may be NULL to only update 'state'.
+ */
+EXPORT void obs_data_get_changes(obs_data_t *data, obs_data_t *state,
+		obs_data_t *changed);
+
+/**
+ * Takes a snapshot of the current state of 'data' and everything in it.
+ *
+ * Creating a snapshot doesn't copy anything; objects and arrays that are
+ * changed while the snapshot is alive copy their previous state first.  The
+ * snapshot must be created on the thread that modifies 'data'.
+ */
+EXPORT obs_data_snapshot_t *obs_data_snapshot_create(obs_data_t *data);
+EXPORT void obs_data_snapshot_destroy(obs_data_snapshot_t *snapshot);
+
+/**
+ * Returns a copy of the data as it was when the snapshot was created.  Can be
+ * called from any thread, the returned data must be released.
+ */
+EXPORT obs_data_t *obs_data_snapshot_get_data(obs_data_snapshot_t *snapshot);
+
 /* Set functions */
 EXPORT void obs_data_set_string(obs_data_t *data, const char *name,
 		const char *val);
@@ -184,6 +220,8 @@ EXPORT bool obs_data_item_next(obs_data_item_t **item);
 EXPORT void obs_data_item_release(obs_data_item_t **item);
 EXPORT void obs_data_item_remove(obs_data_item_t **item);
 
+EXPORT const char *obs_data_item_get_name(obs_data_item_t *item);
+
 /* Gets Item type */
 EXPORT enum obs_data_type obs_data_item_gettype(obs_data_item_t *item);
 EXPORT enum obs_data_number_type obs_data_item_numtype(obs_data_item_t *item);
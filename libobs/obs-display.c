@@ -23,6 +23,7 @@ bool obs_display_init(struct obs_display *display,
 		const struct gs_init_data *graphics_data)
 {
 	pthread_mutex_init_value(&display->draw_callbacks_mutex);
+	display->interval = 1;
 
 	if (graphics_data) {
 		display->swap = gs_swapchain_create(graphics_data);
@@ -68,11 +69,20 @@ obs_display_t *obs_display_create(const struct gs_init_data *graphics_data)
 	return display;
 }
 
+static void release_sources(obs_source_t **sources, size_t num)
+{
+	for (size_t i = 0; i < num; i++)
+		obs_source_release(sources[i]);
+}
+
 void obs_display_free(obs_display_t *display)
 {
 	pthread_mutex_destroy(&display->draw_callbacks_mutex);
 	da_free(display->draw_callbacks);
 
+	release_sources(display->multiview.array, display->multiview.num);
+	da_free(display->multiview);
+
 	if (display->swap) {
 		gs_swapchain_destroy(display->swap);
 		display->swap = NULL;
@@ -136,6 +146,48 @@ void obs_display_remove_draw_callback(obs_display_t *display,
 	pthread_mutex_unlock(&display->draw_callbacks_mutex);
 }
 
+void obs_display_set_interval(obs_display_t *display, uint32_t interval)
+{
+	if (!display) return;
+
+	os_atomic_set_long(&display->interval, (long)interval);
+}
+
+void obs_display_set_fps(obs_display_t *display, uint32_t fps)
+{
+	if (!display) return;
+
+	os_atomic_set_long(&display->fps, (long)fps);
+}
+
+void obs_display_set_multiview(obs_display_t *display,
+		obs_source_t **sources, size_t num, uint32_t columns)
+{
+	DARRAY(obs_source_t*) new_sources;
+	struct darray         old_sources;
+
+	if (!display) return;
+
+	da_init(new_sources);
+
+	for (size_t i = 0; i < num; i++) {
+		if (sources[i]) {
+			obs_source_addref(sources[i]);
+			da_push_back(new_sources, &sources[i]);
+		}
+	}
+
+	pthread_mutex_lock(&display->draw_callbacks_mutex);
+	old_sources                = display->multiview.da;
+	display->multiview.da      = new_sources.da;
+	display->multiview_columns = columns;
+	pthread_mutex_unlock(&display->draw_callbacks_mutex);
+
+	/* releasing can destroy a source, so not with the mutex held */
+	release_sources(old_sources.array, old_sources.num);
+	darray_free(&old_sources);
+}
+
 static inline void render_display_begin(struct obs_display *display)
 {
 	struct vec4 clear_color;
@@ -168,14 +220,124 @@ static inline void render_display_end()
 	gs_present();
 }
 
+/* number of output frames per redraw that keeps the display at or below its
+ * target frame rate */
+static inline uint32_t get_fps_interval(struct obs_display *display)
+{
+	const struct video_output_info *info;
+	long     fps = os_atomic_load_long(&display->fps);
+	uint64_t num, den;
+
+	if (!fps || !obs->video.video)
+		return 1;
+
+	info = video_output_get_info(obs->video.video);
+	num  = info->fps_num;
+	den  = (uint64_t)info->fps_den * (uint64_t)fps;
+
+	return den ? (uint32_t)((num + den - 1) / den) : 1;
+}
+
+static inline bool display_needs_redraw(struct obs_display *display)
+{
+	long interval = os_atomic_load_long(&display->interval);
+	uint32_t fps_interval;
+
+	if (!interval)
+		return false;
+
+	fps_interval = get_fps_interval(display);
+	if (fps_interval > (uint32_t)interval)
+		interval = (long)fps_interval;
+
+	if (++display->skipped_frames < (uint32_t)interval)
+		return false;
+
+	/* a display that can't take a frame yet (its window is on a busy
+	 * monitor, for example) is tried again next frame rather than holding
+	 * up the graphics thread in gs_present */
+	if (!gs_swapchain_ready(display->swap))
+		return false;
+
+	display->skipped_frames = 0;
+	return true;
+}
+
+static inline uint32_t get_multiview_columns(struct obs_display *display)
+{
+	uint32_t columns = display->multiview_columns;
+
+	if (!columns) {
+		columns = 1;
+		while (columns * columns < display->multiview.num)
+			columns++;
+	}
+
+	return columns;
+}
+
+/* each source is drawn with the projection of the full base resolution on to
+ * a viewport the size of its cell, so the geometry is rasterized at the size
+ * of the cell instead of being rendered at full size and scaled down */
+static void render_multiview(struct obs_display *display)
+{
+	size_t   num     = display->multiview.num;
+	uint32_t base_cx = obs->video.base_width;
+	uint32_t base_cy = obs->video.base_height;
+	uint32_t columns, rows;
+	uint32_t cell_cx, cell_cy;
+	float    scale;
+	int      cx, cy;
+
+	if (!num || !base_cx || !base_cy)
+		return;
+
+	columns = get_multiview_columns(display);
+	rows    = (uint32_t)((num + columns - 1) / columns);
+	cell_cx = display->cx / columns;
+	cell_cy = display->cy / rows;
+
+	scale = (float)cell_cx / (float)base_cx;
+	if (scale > (float)cell_cy / (float)base_cy)
+		scale = (float)cell_cy / (float)base_cy;
+
+	cx = (int)((float)base_cx * scale);
+	cy = (int)((float)base_cy * scale);
+	if (!cx || !cy)
+		return;
+
+	gs_viewport_push();
+	gs_projection_push();
+
+	for (size_t i = 0; i < num; i++) {
+		uint32_t column = (uint32_t)(i % columns);
+		uint32_t row    = (uint32_t)(i / columns);
+		int x = (int)(column * cell_cx) + ((int)cell_cx - cx) / 2;
+		int y = (int)(row    * cell_cy) + ((int)cell_cy - cy) / 2;
+
+		gs_set_viewport(x, y, cx, cy);
+		gs_ortho(0.0f, (float)base_cx, 0.0f, (float)base_cy,
+				-100.0f, 100.0f);
+
+		obs_source_video_render(display->multiview.array[i]);
+	}
+
+	gs_projection_pop();
+	gs_viewport_pop();
+}
+
 void render_display(struct obs_display *display)
 {
 	if (!display) return;
+	if (!display_needs_redraw(display))
+		return;
 
 	render_display_begin(display);
 
 	pthread_mutex_lock(&display->draw_callbacks_mutex);
 
+	render_multiview(display);
+
 	for (size_t i = 0; i < display->draw_callbacks.num; i++) {
 		struct draw_callback *callback;
 		callback = display->draw_callbacks.array+i;
@@ -91,10 +91,24 @@ obs_encoder_t *obs_video_encoder_create(const char *id, const char *name,
 }
 
 obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
-		obs_data_t *settings)
+		obs_data_t *settings, size_t mixer_idx)
 {
-	if (!name || !id) return NULL;
-	return create_encoder(id, OBS_ENCODER_AUDIO, name, settings);
+	struct obs_encoder *encoder;
+
+	if (!name || !id || mixer_idx >= MAX_AUDIO_MIXES) return NULL;
+
+	encoder = create_encoder(id, OBS_ENCODER_AUDIO, name, settings);
+	if (encoder)
+		encoder->mixer_idx = mixer_idx;
+	return encoder;
+}
+
+size_t obs_encoder_get_mixer_index(const obs_encoder_t *encoder)
+{
+	if (!encoder || encoder->info.type != OBS_ENCODER_AUDIO)
+		return 0;
+
+	return encoder->mixer_idx;
 }
 
 static void receive_video(void *param, struct video_data *frame);
@@ -142,6 +156,39 @@ static inline bool has_scaling(const struct obs_encoder *encoder)
 		 video_height != encoder->scaled_height);
 }
 
+/* texture encoding requires that the converted textures are exactly what
+ * the encoder would otherwise get from the video output */
+static inline bool can_encode_texture(const struct obs_encoder *encoder,
+		const struct obs_video_mix *mix,
+		const struct video_scale_info *info)
+{
+	return (encoder->info.caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0 &&
+		encoder->info.encode_texture &&
+		mix && mix->gpu_conversion &&
+		!info && !has_scaling(encoder);
+}
+
+static void add_gpu_encoder(struct obs_encoder *encoder,
+		struct obs_video_mix *mix)
+{
+	pthread_mutex_lock(&mix->gpu_encoder_mutex);
+	da_push_back(mix->gpu_encoders, &encoder);
+	pthread_mutex_unlock(&mix->gpu_encoder_mutex);
+
+	encoder->gpu_mix = mix;
+}
+
+static void remove_gpu_encoder(struct obs_encoder *encoder)
+{
+	struct obs_video_mix *mix = encoder->gpu_mix;
+
+	pthread_mutex_lock(&mix->gpu_encoder_mutex);
+	da_erase_item(mix->gpu_encoders, &encoder);
+	pthread_mutex_unlock(&mix->gpu_encoder_mutex);
+
+	encoder->gpu_mix = NULL;
+}
+
 static void add_connection(struct obs_encoder *encoder)
 {
 	struct audio_convert_info audio_info = {0};
@@ -149,11 +196,18 @@ static void add_connection(struct obs_encoder *encoder)
 
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		get_audio_info(encoder, &audio_info);
-		audio_output_connect(encoder->media, &audio_info, receive_audio,
-				encoder);
+		audio_output_connect(encoder->media, encoder->mixer_idx,
+				&audio_info, receive_audio, encoder);
 	} else {
 		struct video_scale_info *info =
 			get_video_info(encoder, &video_info);
+		struct obs_video_mix *mix = obs_get_video_mix(encoder->media);
+
+		if (can_encode_texture(encoder, mix, info)) {
+			add_gpu_encoder(encoder, mix);
+			encoder->active = true;
+			return;
+		}
 
 		if (!info && has_scaling(encoder)) {
 			info = &video_info;
@@ -177,8 +231,10 @@ static void add_connection(struct obs_encoder *encoder)
 static void remove_connection(struct obs_encoder *encoder)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO)
-		audio_output_disconnect(encoder->media, receive_audio,
-				encoder);
+		audio_output_disconnect(encoder->media, encoder->mixer_idx,
+				receive_audio, encoder);
+	else if (encoder->gpu_mix)
+		remove_gpu_encoder(encoder);
 	else
 		video_output_disconnect(encoder->media, receive_video,
 				encoder);
@@ -235,8 +291,11 @@ void obs_encoder_destroy(obs_encoder_t *encoder)
 			encoder->destroy_on_stop = true;
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 
-		if (destroy)
+		if (destroy) {
+			if (encoder->active)
+				remove_connection(encoder);
 			obs_encoder_actually_destroy(encoder);
+		}
 	}
 }
 
@@ -291,6 +350,10 @@ void obs_encoder_update(obs_encoder_t *encoder, obs_data_t *settings)
 
 	obs_data_apply(encoder->context.settings, settings);
 
+	/* user settings take precedence over any congestion adjustment */
+	encoder->requested_bitrate = 0;
+	encoder->bitrate_changed   = false;
+
 	if (encoder->info.update && encoder->context.data)
 		encoder->info.update(encoder->context.data,
 				encoder->context.settings);
@@ -314,6 +377,14 @@ obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder)
 	return encoder->context.settings;
 }
 
+uint32_t obs_encoder_get_frame_delay(const obs_encoder_t *encoder)
+{
+	if (encoder && encoder->info.get_frame_delay && encoder->context.data)
+		return encoder->info.get_frame_delay(encoder->context.data);
+
+	return 0;
+}
+
 static inline void reset_audio_buffers(struct obs_encoder *encoder)
 {
 	free_audio_buffers(encoder);
@@ -340,6 +411,8 @@ static void intitialize_audio_encoder(struct obs_encoder *encoder)
 
 bool obs_encoder_initialize(obs_encoder_t *encoder)
 {
+	enum bmem_tag prev_tag;
+
 	if (!encoder) return false;
 
 	if (encoder->active)
@@ -348,13 +421,17 @@ bool obs_encoder_initialize(obs_encoder_t *encoder)
 	if (encoder->context.data)
 		encoder->info.destroy(encoder->context.data);
 
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_ENCODER);
 	encoder->context.data = encoder->info.create(encoder->context.settings,
 			encoder);
+	bmem_set_thread_tag(prev_tag);
 	if (!encoder->context.data)
 		return false;
 
-	encoder->paired_encoder  = NULL;
-	encoder->start_ts        = 0;
+	encoder->paired_encoder    = NULL;
+	encoder->start_ts          = 0;
+	encoder->requested_bitrate = 0;
+	encoder->bitrate_changed   = false;
 
 	if (encoder->info.type == OBS_ENCODER_AUDIO)
 		intitialize_audio_encoder(encoder);
@@ -396,9 +473,15 @@ void obs_encoder_start(obs_encoder_t *encoder,
 
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
 
-	if (first) {
+	if (first && !encoder->active) {
 		encoder->cur_pts = 0;
 		add_connection(encoder);
+
+	} else if (idx == DARRAY_INVALID) {
+		/* the encoder is already running (in standby or for another
+		 * output), start the new output with a keyframe rather than
+		 * waiting for the next one */
+		obs_encoder_request_keyframe(encoder);
 	}
 }
 
@@ -422,13 +505,46 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
 
 	if (last) {
-		remove_connection(encoder);
+		if (!encoder->standby || encoder->destroy_on_stop)
+			remove_connection(encoder);
 
 		if (encoder->destroy_on_stop)
 			obs_encoder_actually_destroy(encoder);
 	}
 }
 
+bool obs_encoder_set_standby(obs_encoder_t *encoder, bool standby)
+{
+	bool idle;
+
+	if (!encoder) return false;
+	if (encoder->standby == standby) return true;
+
+	if (standby && !obs_encoder_initialize(encoder))
+		return false;
+
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	encoder->standby = standby;
+	idle = (encoder->callbacks.num == 0);
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	if (standby && !encoder->active) {
+		encoder->cur_pts = 0;
+		add_connection(encoder);
+	} else if (!standby && idle && encoder->active) {
+		remove_connection(encoder);
+	}
+
+	blog(LOG_INFO, "encoder '%s' %s standby", encoder->context.name,
+			standby ? "entered" : "left");
+	return true;
+}
+
+bool obs_encoder_standby(const obs_encoder_t *encoder)
+{
+	return encoder ? encoder->standby : false;
+}
+
 const char *obs_encoder_get_codec(const obs_encoder_t *encoder)
 {
 	return encoder ? encoder->info.codec : NULL;
@@ -542,17 +658,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 		return;
 	}
 
+	/* build the packet data in place with room for the reference count in
+	 * front of it, rather than copying it again into a new instance */
+	da_resize(data, sizeof(long));
+	*(long*)data.array = 1;
+
 	da_push_back_array(data, sei, size);
 	da_push_back_array(data, packet->data, packet->size);
 
 	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.data = data.array + sizeof(long);
+	first_packet.size = data.num - sizeof(long);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -570,23 +691,17 @@ static void full_stop(struct obs_encoder *encoder)
 	if (encoder) {
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 		da_free(encoder->callbacks);
+		encoder->standby = false;
 		remove_connection(encoder);
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 	}
 }
 
-static inline void do_encode(struct obs_encoder *encoder,
-		struct encoder_frame *frame)
+static void send_encoded(struct obs_encoder *encoder, bool success,
+		bool received, struct encoder_packet *pkt)
 {
-	struct encoder_packet pkt = {0};
-	bool received = false;
-	bool success;
+	struct encoder_packet instance;
 
-	pkt.timebase_num = encoder->timebase_num;
-	pkt.timebase_den = encoder->timebase_den;
-
-	success = encoder->info.encode(encoder->context.data, frame, &pkt,
-			&received);
 	if (!success) {
 		full_stop(encoder);
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
@@ -595,22 +710,136 @@ static inline void do_encode(struct obs_encoder *encoder,
 	}
 
 	if (received) {
+		pkt->encoder = encoder;
+		pkt->avcc    = (encoder->info.caps & OBS_ENCODER_CAP_AVCC) != 0;
+
 		/* we use system time here to ensure sync with other encoders,
 		 * you do not want to use relative timestamps here */
-		pkt.dts_usec = encoder->start_ts / 1000 + packet_dts_usec(&pkt);
+		pkt->dts_usec = encoder->start_ts / 1000 + packet_dts_usec(pkt);
+
+		/* copy the encoder's data once into a reference counted
+		 * packet (unless the encoder already did); outputs that need
+		 * to keep it just take a reference instead of copying it
+		 * again */
+		if (pkt->refcounted)
+			instance = *pkt;
+		else
+			obs_encoder_packet_create_instance(&instance, pkt);
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = 0; i < encoder->callbacks.num; i++) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array+i;
-			send_packet(encoder, cb, &pkt);
+			send_packet(encoder, cb, &instance);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&instance);
 	}
 }
 
+static inline void update_encode_stats(uint64_t encode_ns)
+{
+	uint64_t avg = (uint64_t)os_atomic_load_64(&obs->video.encode_ns);
+
+	/* video encoders may run on separate threads, a lost update only
+	 * skews the average slightly */
+	os_atomic_set_64(&obs->video.encode_ns,
+			(int64_t)update_avg_ns(avg, encode_ns));
+}
+
+static inline void do_encode(struct obs_encoder *encoder,
+		struct encoder_frame *frame)
+{
+	struct encoder_packet pkt = {0};
+	uint64_t encode_start;
+	bool received = false;
+	bool success;
+	enum bmem_tag prev_tag;
+
+	pkt.timebase_num = encoder->timebase_num;
+	pkt.timebase_den = encoder->timebase_den;
+
+	profile_start("do_encode");
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_ENCODER);
+
+	profile_start("encode");
+	encode_start = os_gettime_ns();
+	success = encoder->info.encode(encoder->context.data, frame, &pkt,
+			&received);
+	if (encoder->info.type == OBS_ENCODER_VIDEO)
+		update_encode_stats(os_gettime_ns() - encode_start);
+	profile_end("encode");
+
+	send_encoded(encoder, success, received, &pkt);
+
+	bmem_set_thread_tag(prev_tag);
+	profile_end("do_encode");
+}
+
+/* applies a bitrate requested via obs_encoder_set_dynamic_bitrate.  this is
+ * done on the encoder thread so the encoder never gets reconfigured in the
+ * middle of encoding a frame */
+static void apply_dynamic_bitrate(struct obs_encoder *encoder)
+{
+	uint32_t   bitrate = encoder->requested_bitrate;
+	obs_data_t *settings;
+
+	encoder->bitrate_changed = false;
+
+	if (!encoder->info.update)
+		return;
+
+	settings = obs_data_create();
+	obs_data_apply(settings, encoder->context.settings);
+	if (bitrate)
+		obs_data_set_int(settings, "bitrate", bitrate);
+
+	if (!encoder->info.update(encoder->context.data, settings))
+		blog(LOG_WARNING, "Encoder '%s': failed to change bitrate "
+				"to %u kbps", encoder->context.name,
+				bitrate ? bitrate :
+				obs_encoder_get_configured_bitrate(encoder));
+
+	obs_data_release(settings);
+}
+
+void obs_encoder_set_dynamic_bitrate(struct obs_encoder *encoder,
+		uint32_t bitrate)
+{
+	if (!encoder || encoder->info.type != OBS_ENCODER_VIDEO)
+		return;
+
+	encoder->requested_bitrate = bitrate;
+	encoder->bitrate_changed   = true;
+}
+
+/* also done on the encoder thread, right before the frame that should be a
+ * keyframe */
+static inline void request_keyframe(struct obs_encoder *encoder)
+{
+	encoder->keyframe_requested = false;
+
+	if (encoder->info.request_keyframe)
+		encoder->info.request_keyframe(encoder->context.data);
+}
+
+void obs_encoder_request_keyframe(obs_encoder_t *encoder)
+{
+	if (!encoder || encoder->info.type != OBS_ENCODER_VIDEO)
+		return;
+
+	encoder->keyframe_requested = true;
+}
+
+uint32_t obs_encoder_get_configured_bitrate(const struct obs_encoder *encoder)
+{
+	return encoder ? (uint32_t)obs_data_get_int(encoder->context.settings,
+			"bitrate") : 0;
+}
+
 static void receive_video(void *param, struct video_data *frame)
 {
 	struct obs_encoder    *encoder  = param;
@@ -629,11 +858,67 @@ static void receive_video(void *param, struct video_data *frame)
 	enc_frame.frames = 1;
 	enc_frame.pts    = encoder->cur_pts;
 
+	if (encoder->bitrate_changed)
+		apply_dynamic_bitrate(encoder);
+	if (encoder->keyframe_requested)
+		request_keyframe(encoder);
+
 	do_encode(encoder, &enc_frame);
 
 	encoder->cur_pts += encoder->timebase_num;
 }
 
+void obs_encoder_encode_texture(struct obs_encoder *encoder,
+		gs_texture_t *textures[], uint64_t timestamp)
+{
+	struct encoder_packet pkt = {0};
+	uint64_t encode_start;
+	bool received = false;
+	bool success;
+
+	if (!encoder->start_ts)
+		encoder->start_ts = timestamp;
+
+	if (encoder->bitrate_changed)
+		apply_dynamic_bitrate(encoder);
+	if (encoder->keyframe_requested)
+		request_keyframe(encoder);
+
+	pkt.timebase_num = encoder->timebase_num;
+	pkt.timebase_den = encoder->timebase_den;
+
+	profile_start("encode_texture");
+	encode_start = os_gettime_ns();
+	success = encoder->info.encode_texture(encoder->context.data,
+			textures, encoder->cur_pts, &pkt, &received);
+	update_encode_stats(os_gettime_ns() - encode_start);
+	profile_end("encode_texture");
+
+	send_encoded(encoder, success, received, &pkt);
+
+	encoder->cur_pts += encoder->timebase_num;
+}
+
+static void send_audio_frame(struct obs_encoder *encoder,
+		uint8_t *const planes[])
+{
+	struct encoder_frame  enc_frame;
+
+	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+
+	for (size_t i = 0; i < encoder->planes; i++) {
+		enc_frame.data[i]     = planes[i];
+		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
+	}
+
+	enc_frame.frames = (uint32_t)encoder->framesize;
+	enc_frame.pts    = encoder->cur_pts;
+
+	do_encode(encoder, &enc_frame);
+
+	encoder->cur_pts += encoder->framesize;
+}
+
 static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 {
 	size_t samplerate = encoder->samplerate;
@@ -666,6 +951,22 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 
 	size -= offset_size;
 
+	/* while nothing is left over from previous data, whole frames are
+	 * encoded straight from the mix (or resampler) output, and only the
+	 * remainder has to be buffered */
+	while (!encoder->audio_input_buffer[0].size &&
+	       size >= encoder->framesize_bytes) {
+		uint8_t *planes[MAX_AV_PLANES];
+
+		for (size_t i = 0; i < encoder->planes; i++)
+			planes[i] = data->data[i] + offset_size;
+
+		send_audio_frame(encoder, planes);
+
+		offset_size += encoder->framesize_bytes;
+		size        -= encoder->framesize_bytes;
+	}
+
 	/* push in to the circular buffer */
 	if (size)
 		for (size_t i = 0; i < encoder->planes; i++)
@@ -675,27 +976,36 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 	return true;
 }
 
-static void send_audio_data(struct obs_encoder *encoder)
+/* the frame is passed straight from the input buffer unless it wraps around
+ * the end of it, in which case it is copied in to the preallocated output
+ * buffer first */
+static inline uint8_t *get_audio_plane(struct obs_encoder *encoder, size_t i)
 {
-	struct encoder_frame  enc_frame;
+	struct circlebuf_span span;
 
-	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+	circlebuf_peek_front_span(&encoder->audio_input_buffer[i],
+			encoder->framesize_bytes, &span);
+	if (!span.size[1])
+		return span.data[0];
 
-	for (size_t i = 0; i < encoder->planes; i++) {
-		circlebuf_pop_front(&encoder->audio_input_buffer[i],
-				encoder->audio_output_buffer[i],
-				encoder->framesize_bytes);
+	memcpy(encoder->audio_output_buffer[i], span.data[0], span.size[0]);
+	memcpy(encoder->audio_output_buffer[i] + span.size[0], span.data[1],
+			span.size[1]);
+	return encoder->audio_output_buffer[i];
+}
 
-		enc_frame.data[i]     = encoder->audio_output_buffer[i];
-		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
-	}
+static void send_audio_data(struct obs_encoder *encoder)
+{
+	uint8_t *planes[MAX_AV_PLANES];
 
-	enc_frame.frames = (uint32_t)encoder->framesize;
-	enc_frame.pts    = encoder->cur_pts;
+	for (size_t i = 0; i < encoder->planes; i++)
+		planes[i] = get_audio_plane(encoder, i);
 
-	do_encode(encoder, &enc_frame);
+	send_audio_frame(encoder, planes);
 
-	encoder->cur_pts += encoder->framesize;
+	for (size_t i = 0; i < encoder->planes; i++)
+		circlebuf_consume(&encoder->audio_input_buffer[i],
+				encoder->framesize_bytes);
 }
 
 static void receive_audio(void *param, struct audio_data *data)
@@ -741,3 +1051,45 @@ void obs_free_encoder_packet(struct encoder_packet *packet)
 	bfree(packet->data);
 	memset(packet, 0, sizeof(struct encoder_packet));
 }
+
+/* reference counted packet data is prefixed with its reference count */
+static inline long *packet_refs(const struct encoder_packet *packet)
+{
+	return ((long*)packet->data) - 1;
+}
+
+void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	long *p_refs;
+
+	*dst = *src;
+	p_refs = bmalloc(sizeof(long) + src->size);
+	*p_refs = 1;
+
+	dst->data = (uint8_t*)(p_refs + 1);
+	memcpy(dst->data, src->data, src->size);
+}
+
+void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src)
+{
+	if (src->data)
+		os_atomic_inc_long(packet_refs(src));
+
+	*dst = *src;
+}
+
+void obs_encoder_packet_release(struct encoder_packet *packet)
+{
+	if (!packet)
+		return;
+
+	if (packet->data) {
+		long *p_refs = packet_refs(packet);
+		if (os_atomic_dec_long(p_refs) == 0)
+			bfree(p_refs);
+	}
+
+	memset(packet, 0, sizeof(struct encoder_packet));
+}
@@ -52,6 +52,15 @@ struct encoder_packet {
 	/* DTS in microseconds */
 	int64_t               dts_usec;
 
+	/* Audio track index, for outputs with more than one audio track */
+	size_t                track_idx;
+
+	/* Encoder that produced the packet */
+	obs_encoder_t         *encoder;
+
+	/* Packet data is length-prefixed AVCC (see OBS_ENCODER_CAP_AVCC) */
+	bool                  avcc;
+
 	/**
 	 * Packet priority
 	 *
@@ -67,8 +76,29 @@ struct encoder_packet {
 	 * priority or higher to continue transmission.
 	 */
 	int                   drop_priority;
+
+	/**
+	 * Set by the encoder when the packet data was created with
+	 * obs_encoder_packet_create_instance.  Its reference is then handed
+	 * over to libobs instead of the data being copied again.
+	 */
+	bool                  refcounted;
 };
 
+/**
+ * The encoder can encode frames straight from GPU textures (see
+ * obs_encoder_info::encode_texture) instead of from system memory
+ */
+#define OBS_ENCODER_CAP_PASS_TEXTURE (1<<0)
+
+/**
+ * H.264 encoder only:  The encoder outputs length-prefixed (AVCC) packets
+ * with 4 byte NAL sizes instead of Annex B start codes, so outputs don't have
+ * to convert them.  The SEI data must be in the same format, and the extra
+ * data must be the AVCDecoderConfigurationRecord.
+ */
+#define OBS_ENCODER_CAP_AVCC (1<<1)
+
 /** Encoder input frame */
 struct encoder_frame {
 	/** Data for the frame/audio */
@@ -217,6 +247,56 @@ struct obs_encoder_info {
 	 *                    otherwise
 	 */
 	bool (*get_video_info)(void *data, struct video_scale_info *info);
+
+	/**
+	 * Video encoder only:  Returns the maximum number of frames the
+	 * encoder can hold before outputting the packet for a frame (for
+	 * example lookahead, B-frames, or frame threads)
+	 *
+	 * @param  data  Data associated with this encoder context
+	 * @return       Pipeline delay in frames
+	 */
+	uint32_t (*get_frame_delay)(void *data);
+
+	/** Encoder capability flags (OBS_ENCODER_CAP_*) */
+	uint32_t caps;
+
+	/**
+	 * Video encoder only:  Encodes a frame from a GPU texture, for encoders
+	 * with OBS_ENCODER_CAP_PASS_TEXTURE.  This is called from the graphics
+	 * thread with the graphics context entered.
+	 *
+	 * The textures are the output of the GPU format conversion, one per
+	 * plane of the output format: a GS_R8 luma texture followed by a
+	 * GS_R8G8 chroma texture for NV12, or GS_R8 U and V textures for
+	 * I420, with the chroma planes at half resolution.  They are only
+	 * valid for the duration of the call, so they must be copied (or have
+	 * their copy queued) before returning.
+	 *
+	 * If the texture can't be used (for example if GPU conversion is
+	 * disabled, or the encoder needs scaling), the regular encode
+	 * callback is used instead.
+	 *
+	 * @param       data             Data associated with this encoder
+	 *                               context
+	 * @param       textures         Converted output planes
+	 * @param       pts              Presentation timestamp
+	 * @param[out]  packet           Encoder packet output, if any
+	 * @param[out]  received_packet  Set to true if a packet was received,
+	 *                               false otherwise
+	 * @return                       true if successful, false otherwise.
+	 */
+	bool (*encode_texture)(void *data, gs_texture_t *textures[], int64_t pts,
+			struct encoder_packet *packet, bool *received_packet);
+
+	/**
+	 * Optional: Makes the next frame a keyframe.  Called on the encoding
+	 * thread right before that frame is encoded, after a keyframe was
+	 * requested with obs_encoder_request_keyframe.
+	 *
+	 * @param  data  Data associated with this encoder context
+	 */
+	void (*request_keyframe)(void *data);
 };
 
 EXPORT void obs_register_encoder_s(const struct obs_encoder_info *info,
@@ -22,9 +22,13 @@
 #include "util/circlebuf.h"
 #include "util/dstr.h"
 #include "util/threading.h"
+#include "util/task-pool.h"
+#include "util/hash-map.h"
+#include "util/profiler.h"
 #include "util/platform.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
+#include "callback/calldata.h"
 
 #include "graphics/graphics.h"
 
@@ -34,8 +38,20 @@
 
 #include "obs.h"
 
-#define NUM_TEXTURES 2
+#define NUM_TEXTURES_DEFAULT 2
+#define NUM_TEXTURES_MAX 4
 #define MICROSECOND_DEN 1000000
+#define DEFAULT_LEVEL_UPDATE_RATE 30
+
+/* GPU timer results are read this many frames after they were issued */
+#define GPU_TIMER_FRAMES 3
+#define ASYNC_UPLOAD_SLOTS 2
+
+/* moving average over roughly the last 8 frames */
+static inline uint64_t update_avg_ns(uint64_t avg, uint64_t val)
+{
+	return (avg * 7 + val) / 8;
+}
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 {
@@ -47,6 +63,11 @@ struct draw_callback {
 	void *param;
 };
 
+struct audio_cb_info {
+	obs_source_audio_capture_t callback;
+	void *param;
+};
+
 /* ------------------------------------------------------------------------- */
 /* modules */
 
@@ -101,11 +122,18 @@ static inline bool check_path(const char *data, const char *path,
 struct obs_view {
 	pthread_mutex_t                 channels_mutex;
 	obs_source_t                    *channels[MAX_CHANNELS];
+
+	/* channels were changed since the last frame */
+	volatile bool                   changed;
 };
 
 extern bool obs_view_init(struct obs_view *view);
 extern void obs_view_free(struct obs_view *view);
 
+/* returns whether the view renders exactly as it did last frame, called once
+ * a frame by the mix of the view */
+extern bool obs_view_unchanged(struct obs_view *view);
+
 
 /* ------------------------------------------------------------------------- */
 /* displays */
@@ -117,6 +145,16 @@ struct obs_display {
 	pthread_mutex_t                 draw_callbacks_mutex;
 	DARRAY(struct draw_callback)    draw_callbacks;
 
+	/* frames between redraws, 0 to stop redrawing */
+	volatile long                   interval;
+	/* highest redraw rate, 0 for the output frame rate */
+	volatile long                   fps;
+	uint32_t                        skipped_frames;
+
+	/* multiview grid, drawn before the draw callbacks */
+	DARRAY(obs_source_t*)           multiview;
+	uint32_t                        multiview_columns;
+
 	struct obs_display              *next;
 	struct obs_display              **prev_next;
 };
@@ -129,45 +167,294 @@ extern void obs_display_free(struct obs_display *display);
 /* ------------------------------------------------------------------------- */
 /* core */
 
+struct obs_readback_frame {
+	struct video_data               frame;
+	int                             cur_texture;
+};
+
+enum render_stage {
+	RENDER_STAGE_MAIN,
+	RENDER_STAGE_SCALE,
+	RENDER_STAGE_CONVERT,
+	NUM_RENDER_STAGES
+};
+
+/* filter render targets are shared between all filters: a filter borrows a
+ * render target of the size/format it needs for as long as it renders, and
+ * targets that haven't been used for a while are freed */
+#define FILTER_TEXTURE_TIMEOUT_FRAMES 120
+
+struct filter_texture {
+	gs_texrender_t                  *texrender;
+	uint32_t                        cx;
+	uint32_t                        cy;
+	enum gs_color_format            format;
+	bool                            in_use;
+	uint64_t                        last_frame;
+};
+
+extern void expire_filter_textures(void);
+extern void free_filter_textures(void);
+
+/* snapshots are rendered and staged on the frame after they're requested,
+ * and mapped on a later frame once the copy is done.  staging surfaces of
+ * returned snapshots are kept for reuse, up to a limit */
+#define SNAPSHOT_POOL_SIZE      8
+#define SNAPSHOT_MAX_WAIT_FRAMES 4
+
+struct obs_snapshot {
+	obs_source_t                    *source;
+	uint32_t                        cx;
+	uint32_t                        cy;
+	obs_source_snapshot_cb          callback;
+	void                            *param;
+
+	gs_stagesurf_t                  *stagesurf;
+	uint64_t                        staged_frame;
+};
+
+extern void process_snapshots(void);
+extern void free_snapshots(void);
+
+/* consecutive filters with pixel effects are drawn in one pass, with an
+ * effect generated from all of their pixel functions */
+#define MAX_FUSED_FILTERS 8
+
+/* a pixel function file, shared by the pixel effects created from it */
+struct obs_pixel_function {
+	char                            *file;
+	char                            *text;
+	uint32_t                        id;
+};
+
+struct obs_pixel_effect {
+	struct obs_pixel_function       *function;
+	gs_effect_t                     *effect;
+
+	/* the parameters declared by the pixel function */
+	DARRAY(gs_eparam_t*)            params;
+};
+
+struct obs_fused_effect {
+	char                            *key;
+	uint32_t                        ids[MAX_FUSED_FILTERS];
+	size_t                          num;
+
+	/* NULL if it failed to compile, so it isn't tried again */
+	gs_effect_t                     *effect;
+
+	/* the parameters of each pixel function in turn */
+	DARRAY(gs_eparam_t*)            params;
+};
+
+/* gets the index in to obs->video.fused_effects of the effect that applies
+ * the pixel effects in order, created the first time the combination is
+ * used.  graphics context only */
+extern size_t obs_get_fused_effect(obs_pixel_effect_t *const *pes,
+		size_t num);
+extern void free_pixel_effects(void);
+
+struct render_stage_timer {
+	gs_timer_t                      *timers[GPU_TIMER_FRAMES];
+	bool                            used[GPU_TIMER_FRAMES];
+	uint64_t                        avg_ns;
+};
+
+struct video_texture_cb {
+	obs_video_texture_cb            callback;
+	void                            *param;
+};
+
+/* a video mix renders a view in to its own set of textures and outputs the
+ * result to its own video output.  all mixes share the base resolution and
+ * are rendered from the graphics thread, the main mix renders the main view
+ * and its video output drives the frame timing */
+struct obs_video_mix {
+	struct obs_view                 *view;
+	video_t                         *video;
+
+	/* renditions don't render the view themselves, they scale the render
+	 * texture the parent mix rendered this frame */
+	struct obs_video_mix            *parent;
+	int                             last_render_texture;
+
+	/* with GPU conversion there is a converted texture and a staging
+	 * surface for each plane of the output format, otherwise only the
+	 * first staging surface is used */
+	gs_stagesurf_t   *copy_surfaces[NUM_TEXTURES_MAX][MAX_AV_PLANES];
+	gs_texture_t                    *render_textures[NUM_TEXTURES_MAX];
+	gs_texture_t                    *output_textures[NUM_TEXTURES_MAX];
+	gs_texture_t     *convert_textures[NUM_TEXTURES_MAX][MAX_AV_PLANES];
+	bool                            textures_rendered[NUM_TEXTURES_MAX];
+	bool                            textures_output[NUM_TEXTURES_MAX];
+	bool                            textures_copied[NUM_TEXTURES_MAX];
+	bool                            textures_converted[NUM_TEXTURES_MAX];
+
+	/* render times of the content of each stage's textures */
+	uint64_t                        render_timestamps[NUM_TEXTURES_MAX];
+	uint64_t                        output_timestamps[NUM_TEXTURES_MAX];
+	uint64_t                        convert_timestamps[NUM_TEXTURES_MAX];
+	uint64_t                        copy_timestamps[NUM_TEXTURES_MAX];
+	struct obs_source_frame         convert_frames[NUM_TEXTURES_MAX];
+	gs_stagesurf_t                  *mapped_surfaces[MAX_AV_PLANES];
+	uint32_t                        readbacks_skipped;
+	int                             cur_texture;
+	int                             num_textures;
+
+	/* GPU timing of the passes of the output render */
+	struct render_stage_timer       stage_timers[NUM_RENDER_STAGES];
+
+	/* number of frames the view has been unchanged for.  once every
+	 * texture of every stage holds the same image there's no need to
+	 * render, scale or convert again */
+	uint32_t                        static_frames;
+
+	/* nothing takes the mix's output (no raw video output, GPU encoders
+	 * or texture callbacks, and no active renditions of it), so it isn't
+	 * rendered at all */
+	bool                            has_outputs;
+	bool                            idle;
+
+	/* mapped staging surfaces are handed off to the readback thread,
+	 * which does de-alignment/CPU conversion outside of the render
+	 * thread.  the render thread only waits on readback_complete when it
+	 * needs to unmap the surface again */
+	pthread_t                       readback_thread;
+	bool                            readback_thread_initialized;
+	volatile bool                   readback_stop;
+	bool                            readback_pending;
+	os_sem_t                        *readback_sem;
+	os_event_t                      *readback_complete;
+	pthread_mutex_t                 readback_mutex;
+	struct circlebuf                readback_queue;
+
+	/* encoders that take the converted textures directly.  when nothing
+	 * is connected to the video output, frames are not staged or read
+	 * back at all */
+	pthread_mutex_t                 gpu_encoder_mutex;
+	DARRAY(struct obs_encoder*)     gpu_encoders;
+	bool                            cpu_output_active;
+
+	/* callbacks that take the output texture directly */
+	pthread_mutex_t                 texture_cb_mutex;
+	DARRAY(struct video_texture_cb) texture_callbacks;
+
+	bool                            gpu_conversion;
+	size_t                          num_planes;
+	gs_technique_t                  *plane_techs[MAX_AV_PLANES];
+	uint32_t                        plane_widths[MAX_AV_PLANES];
+	uint32_t                        plane_heights[MAX_AV_PLANES];
+	enum gs_color_format            plane_formats[MAX_AV_PLANES];
+
+	uint32_t                        output_width;
+	uint32_t                        output_height;
+	float                           color_matrix[16];
+	enum obs_scale_type             scale_type;
+
+	/* output width, base height: the scale filters are applied
+	 * horizontally in to this and then vertically in to the output
+	 * textures.  only exists if the output is scaled */
+	gs_texture_t                    *scale_texture;
+};
+
+extern struct obs_video_mix *obs_video_mix_create(struct obs_view *view,
+		const struct obs_video_info *ovi);
+extern struct obs_video_mix *obs_video_mix_create_rendition(
+		struct obs_video_mix *parent,
+		const struct obs_video_info *ovi);
+extern void obs_video_mix_stop(struct obs_video_mix *mix);
+extern void obs_video_mix_destroy(struct obs_video_mix *mix);
+
+/* returns the mix that outputs to a video output, if any */
+extern struct obs_video_mix *obs_get_video_mix(const video_t *video);
+
+/* format_conversion.effect compiled with the sizes of a frame folded in to
+ * constants, effect is NULL if it failed to compile */
+struct obs_conversion_variant {
+	uint32_t                        width;
+	uint32_t                        height;
+	uint32_t                        input_width;
+	uint32_t                        input_height;
+	int                             plane_offset[2];
+	gs_effect_t                     *effect;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
-	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
-	gs_texture_t                    *render_textures[NUM_TEXTURES];
-	gs_texture_t                    *output_textures[NUM_TEXTURES];
-	gs_texture_t                    *convert_textures[NUM_TEXTURES];
-	bool                            textures_rendered[NUM_TEXTURES];
-	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
-	bool                            textures_converted[NUM_TEXTURES];
-	struct obs_source_frame         convert_frames[NUM_TEXTURES];
-	struct circlebuf                timestamp_buffer;
 	gs_effect_t                     *default_effect;
 	gs_effect_t                     *default_rect_effect;
 	gs_effect_t                     *solid_effect;
 	gs_effect_t                     *conversion_effect;
+
+	/* resolved when the effects are loaded, so the render paths don't
+	 * look them up by name every frame */
+	gs_technique_t                  *default_draw;
+	gs_technique_t                  *default_draw_matrix;
+	gs_eparam_t                     *default_image;
+	gs_eparam_t                     *conversion_image;
+
+	/* only used from the graphics thread */
+	DARRAY(struct obs_conversion_variant) conversion_variants;
 	gs_effect_t                     *bicubic_effect;
 	gs_effect_t                     *lanczos_effect;
-	gs_stagesurf_t                  *mapped_surface;
-	int                             cur_texture;
+	gs_effect_t                     *area_effect;
 
+	/* the main mix's video output */
 	video_t                         *video;
 	pthread_t                       video_thread;
 	bool                            thread_initialized;
 
-	bool                            gpu_conversion;
-	const char                      *conversion_tech;
-	uint32_t                        conversion_height;
-	uint32_t                        plane_offsets[3];
-	uint32_t                        plane_sizes[3];
-	uint32_t                        plane_linewidth[3];
+	struct obs_video_mix            *main_mix;
+	pthread_mutex_t                 mixes_mutex;
+	DARRAY(struct obs_video_mix*)   mixes;
+
+	/* GPU timing of sources: each frame is wrapped in a timer range, and
+	 * the results of a frame are read GPU_TIMER_FRAMES frames later */
+	gs_timer_range_t                *gpu_timer_ranges[GPU_TIMER_FRAMES];
+	bool                            gpu_ranges_used[GPU_TIMER_FRAMES];
+	bool                            gpu_range_active;
+	bool                            gpu_timing_valid;
+	uint64_t                        gpu_timer_frequency;
+	uint64_t                        gpu_timer_frame;
+
+	/* counts the frames rendered, starts at 1 */
+	uint64_t                        render_frame;
+
+	/* performance counters for obs_get_perf_stats: the average video
+	 * thread time per frame, the average video encode call time, and the
+	 * frames that took longer than the frame interval */
+	volatile int64_t                frame_ns;
+	volatile int64_t                encode_ns;
+	volatile long                   lagged_frames;
+
+	/* render targets borrowed by filters while they render */
+	DARRAY(struct filter_texture*)  filter_textures;
+
+	/* snapshots requested from any thread, and the ones waiting to be
+	 * mapped along with idle staging surfaces (graphics thread only) */
+	pthread_mutex_t                 snapshot_mutex;
+	DARRAY(struct obs_snapshot)     snapshot_requests;
+	DARRAY(struct obs_snapshot)     snapshots_staged;
+	DARRAY(gs_stagesurf_t*)         snapshot_surfaces;
+
+	/* pixel function files by file name, and fused effects by the ids of
+	 * their functions, only used within the graphics context */
+	struct hash_map                 pixel_function_map;
+	DARRAY(struct obs_pixel_function*) pixel_functions;
+	struct hash_map                 fused_effect_map;
+	DARRAY(struct obs_fused_effect*) fused_effects;
+
+	/* sources without child sources are ticked in parallel, the pool is
+	 * also used to convert output frames on the CPU */
+	task_pool_t                     *tick_pool;
+	DARRAY(struct obs_source*)      tick_parallel;
+	DARRAY(struct obs_source*)      tick_serial;
 
-	uint32_t                        output_width;
-	uint32_t                        output_height;
 	uint32_t                        base_width;
 	uint32_t                        base_height;
-	float                           color_matrix[16];
-	enum obs_scale_type             scale_type;
 
+	/* no window was given, the main display is never rendered */
+	bool                            headless;
 	struct obs_display              main_display;
 };
 
@@ -177,6 +464,9 @@ struct obs_core_audio {
 
 	float                           user_volume;
 	float                           present_volume;
+
+	/* volume level signals per second (0 = every audio packet) */
+	uint32_t                        level_update_rate;
 };
 
 /* user sources, output channels, and displays */
@@ -184,6 +474,9 @@ struct obs_core_data {
 	pthread_mutex_t                 user_sources_mutex;
 	DARRAY(struct obs_source*)      user_sources;
 
+	/* name -> first user source added with that name, user_sources_mutex */
+	struct hash_map                 user_source_names;
+
 	struct obs_source               *first_source;
 	struct obs_display              *first_display;
 	struct obs_output               *first_output;
@@ -192,6 +485,16 @@ struct obs_core_data {
 
 	pthread_mutex_t                 sources_mutex;
 	pthread_mutex_t                 displays_mutex;
+
+	/* protects the tree caches of all sources, tree_generation changes
+	 * whenever a child is added to or removed from any source */
+	pthread_mutex_t                 tree_mutex;
+	long                            tree_generation;
+	volatile bool                   displays_disabled;
+
+	/* single worker that runs the updates of sources that aren't
+	 * rendered by the video thread, see obs_source_update */
+	task_pool_t                     *update_pool;
 	pthread_mutex_t                 outputs_mutex;
 	pthread_mutex_t                 encoders_mutex;
 	pthread_mutex_t                 services_mutex;
@@ -200,6 +503,9 @@ struct obs_core_data {
 
 	long long                       unnamed_index;
 
+	/* create loaded sources on first use, see obs_load_source */
+	bool                            defer_source_creation;
+
 	volatile bool                   valid;
 };
 
@@ -231,6 +537,7 @@ struct obs_core {
 extern struct obs_core *obs;
 
 extern void *obs_video_thread(void *param);
+extern void *obs_readback_thread(void *param);
 
 
 /* ------------------------------------------------------------------------- */
@@ -268,6 +575,26 @@ extern void obs_context_data_setname(struct obs_context_data *context,
 /* ------------------------------------------------------------------------- */
 /* sources  */
 
+enum async_upload_state {
+	ASYNC_UPLOAD_UNMAPPED,
+	ASYNC_UPLOAD_MAPPED,
+	ASYNC_UPLOAD_ACQUIRED,
+};
+
+/*
+ * An async frame whose planes point directly into a mapped dynamic texture.
+ * The texture is unmapped (and thereby uploaded) when the frame is rendered,
+ * and then swapped with the async texture of the source.
+ */
+struct async_upload_slot {
+	struct obs_source_frame         frame;
+	gs_texture_t                    *texture;
+	/* protected by video_mutex */
+	enum async_upload_state         state;
+	/* only used by the graphics thread */
+	bool                            mapped;
+};
+
 struct obs_source {
 	struct obs_context_data         context;
 	struct obs_source_info          info;
@@ -281,6 +608,15 @@ struct obs_source {
 
 	/* signals to call the source update in the video thread */
 	bool                            defer_update;
+	volatile long                   update_queued;
+
+	/* settings as of the last update_diff call, to find what changed */
+	obs_data_t                      *update_state;
+
+	/* the plugin data is created when the source is first shown or
+	 * activated, and loaded then if obs_source_load was called before */
+	volatile long                   create_deferred;
+	bool                            load_deferred;
 
 	/* ensures show/hide are only called once */
 	volatile long                   show_refs;
@@ -291,6 +627,17 @@ struct obs_source {
 	/* prevents infinite recursion when enumerating sources */
 	volatile long                   enum_refs;
 
+	/* the sources obs_source_enum_tree would visit, in the same order, so
+	 * that activation and volume changes don't have to walk the scenes
+	 * every time.  holds a reference to every entry, and is rebuilt after
+	 * a child is added or removed anywhere in the tree.  tree_cache_roots
+	 * are the sources whose cache contains this source.  all protected by
+	 * obs->data.tree_mutex */
+	DARRAY(struct obs_source*)      tree_cache;
+	DARRAY(struct obs_source*)      tree_cache_roots;
+	bool                            tree_cache_valid;
+	long                            tree_cache_users;
+
 	/* used to indicate that the source has been removed and all
 	 * references to it should be released (not exactly how I would prefer
 	 * to handle things but it's the best option) */
@@ -301,6 +648,8 @@ struct obs_source {
 	volatile uint64_t               timing_adjust;
 	uint64_t                        next_audio_ts_min;
 	uint64_t                        last_frame_ts;
+	/* async frames released without being presented (video_mutex) */
+	uint64_t                        frames_dropped;
 	uint64_t                        last_sys_timestamp;
 	bool                            async_rendered;
 
@@ -310,6 +659,7 @@ struct obs_source {
 	audio_resampler_t               *resampler;
 	audio_line_t                    *audio_line;
 	pthread_mutex_t                 audio_mutex;
+	DARRAY(struct audio_cb_info)    audio_cb_list; /* audio_mutex */
 	struct obs_audio_data           audio_data;
 	size_t                          audio_storage_size;
 	float                           user_volume;
@@ -321,6 +671,9 @@ struct obs_source {
 	float                           vol_max;
 	float                           vol_peak;
 	size_t                          vol_update_count;
+	float                           vol_report_max;
+	uint64_t                        vol_last_update;
+	struct calldata                 vol_calldata;
 
 	/* transition volume is meant to store the sum of transitioning volumes
 	 * of a source, i.e. if a source is within both the "to" and "from"
@@ -332,6 +685,7 @@ struct obs_source {
 	/* async video data */
 	gs_texture_t                    *async_texture;
 	gs_texrender_t                  *async_convert_texrender;
+	gs_effect_t                     *async_conversion_effect;
 	bool                            async_gpu_conversion;
 	enum video_format               async_format;
 	enum gs_color_format            async_texture_format;
@@ -343,18 +697,65 @@ struct obs_source {
 	bool                            async_flip;
 	DARRAY(struct obs_source_frame*)video_frames;
 	pthread_mutex_t                 video_mutex;
+
+	/* released async frames are kept here to be reused for new frames of
+	 * the same format/size (protected by video_mutex) */
+	DARRAY(struct obs_source_frame*)async_cache;
+	enum video_format               async_cache_format;
+	uint32_t                        async_cache_width;
+	uint32_t                        async_cache_height;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
 	uint32_t                        async_convert_width;
 	uint32_t                        async_convert_height;
 
+	/* frames written directly into mapped textures, the format/size of
+	 * the last requested frame is used for the slots (protected by
+	 * video_mutex) */
+	struct async_upload_slot        async_upload[ASYNC_UPLOAD_SLOTS];
+	enum video_format               async_upload_format;
+	uint32_t                        async_upload_width;
+	uint32_t                        async_upload_height;
+	bool                            async_upload_failed;
+
 	/* filters */
 	struct obs_source               *filter_parent;
 	struct obs_source               *filter_target;
-	DARRAY(struct obs_source*)      filters;
+	DARRAY_INLINE(struct obs_source*, 4) filters;
 	pthread_mutex_t                 filter_mutex;
-	gs_texrender_t                  *filter_texrender;
 	bool                            rendering_filter;
+
+	/* index in to obs->video.fused_effects of the effect last used to
+	 * draw the pixel filters starting at this filter.  an index rather
+	 * than a pointer, the fused effects are freed with the graphics */
+	size_t                          fused_effect_idx;
+
+	/* render cost accounting, times are averaged per frame */
+	int                             render_depth;
+	uint64_t                        cur_render_ns;
+	uint64_t                        avg_render_ns;
+	uint64_t                        avg_tick_ns;
+	uint64_t                        avg_gpu_ns;
+	gs_timer_t                      *gpu_timers[GPU_TIMER_FRAMES];
+	bool                            gpu_timers_used[GPU_TIMER_FRAMES];
+	uint64_t                        gpu_timer_frame;
+
+	/* set when the source has to be considered changed next frame,
+	 * video_unchanged is the result for the current frame */
+	volatile bool                   video_dirty;
+	bool                            video_unchanged;
+
+	/* render-once cache for sources drawn more than once per frame */
+	gs_texrender_t                  *render_cache;
+	uint64_t                        render_cache_frame;
+	uint64_t                        render_count_frame;
+	uint32_t                        render_count;
+	uint64_t                        multi_render_frame;
+
+	/* transitions: the outgoing source frozen at the start of the
+	 * transition, so it isn't rendered live for the rest of it */
+	gs_texrender_t                  *transition_freeze;
+	bool                            transition_frozen;
 };
 
 extern const struct obs_source_info *find_source(struct darray *list,
@@ -364,8 +765,21 @@ extern bool obs_source_init_context(struct obs_source *source,
 extern bool obs_source_init(struct obs_source *source,
 		const struct obs_source_info *info);
 
+extern obs_source_t *obs_source_create_internal(enum obs_source_type type,
+		const char *id, const char *name, obs_data_t *settings,
+		bool defer);
 extern void obs_source_destroy(struct obs_source *source);
 
+/* keep the user source name lookup up to date, call with user_sources_mutex
+ * held.  on removal, name is the name the source was added with */
+extern void obs_user_source_name_add(obs_source_t *source);
+extern void obs_user_source_name_remove(obs_source_t *source,
+		const char *name);
+
+/* returns whether a source, its filters and its child sources all render
+ * exactly as they did last frame */
+extern bool obs_source_tree_unchanged(obs_source_t *source);
+
 enum view_type {
 	MAIN_VIEW,
 	AUX_VIEW
@@ -379,18 +793,27 @@ extern void obs_source_video_tick(obs_source_t *source, float seconds);
 /* ------------------------------------------------------------------------- */
 /* outputs  */
 
+/* track 0 is video, the rest are audio tracks */
+#define MAX_INTERLEAVE_TRACKS (1 + MAX_AUDIO_MIXES)
+
+struct interleave_track {
+	/* FIFO of struct encoder_packet, packets of one track always arrive
+	 * in dts order so they never need to be sorted */
+	struct circlebuf                packets;
+	int64_t                         offset;
+	bool                            enabled;
+	bool                            received;
+};
+
 struct obs_output {
 	struct obs_context_data         context;
 	struct obs_output_info          info;
 
-	bool                            received_video;
-	bool                            received_audio;
-	int64_t                         video_offset;
-	int64_t                         audio_offset;
-	int64_t                         highest_audio_ts;
-	int64_t                         highest_video_ts;
 	pthread_mutex_t                 interleaved_mutex;
-	DARRAY(struct encoder_packet)   interleaved_packets;
+	struct interleave_track         tracks[MAX_INTERLEAVE_TRACKS];
+	bool                            interleave_started;
+	bool                            interleave_forced;
+	int64_t                         highest_ts;
 
 	int                             reconnect_retry_sec;
 	int                             reconnect_retry_max;
@@ -405,11 +828,17 @@ struct obs_output {
 
 	int                             total_frames;
 
+	/* congestion-driven bitrate control state (see
+	 * obs_output_report_congestion) */
+	bool                            bitrate_adjusted;
+	uint64_t                        bitrate_change_ts;
+	uint64_t                        uncongested_ts;
+
 	bool                            active;
 	video_t                         *video;
 	audio_t                         *audio;
 	obs_encoder_t                   *video_encoder;
-	obs_encoder_t                   *audio_encoder;
+	obs_encoder_t                   *audio_encoders[MAX_AUDIO_MIXES];
 	obs_service_t                   *service;
 
 	uint32_t                        scaled_width;
@@ -420,6 +849,9 @@ struct obs_output {
 	struct video_scale_info         video_conversion;
 	struct audio_convert_info       audio_conversion;
 
+	/* audio mix received by raw outputs */
+	size_t                          mixer_idx;
+
 	bool                            valid;
 };
 
@@ -428,6 +860,9 @@ extern const struct obs_output_info *find_output(const char *id);
 extern void obs_output_remove_encoder(struct obs_output *output,
 		struct obs_encoder *encoder);
 
+extern void obs_output_get_perf_stats(struct obs_output *output,
+		struct obs_perf_output_stats *stats);
+
 
 /* ------------------------------------------------------------------------- */
 /* encoders  */
@@ -453,6 +888,9 @@ struct obs_encoder {
 
 	bool                            active;
 
+	/* mix whose converted textures are encoded instead of raw frames */
+	struct obs_video_mix            *gpu_mix;
+
 	uint32_t                        timebase_num;
 	uint32_t                        timebase_den;
 
@@ -474,9 +912,25 @@ struct obs_encoder {
 
 	bool                            destroy_on_stop;
 
+	/* bitrate requested by an output's congestion control, 0 meaning the
+	 * configured bitrate.  the change is applied on the encoder thread
+	 * before the next frame is encoded */
+	volatile uint32_t               requested_bitrate;
+	volatile bool                   bitrate_changed;
+
+	/* in standby the encoder stays connected and keeps encoding while no
+	 * output uses it, the packets are just discarded */
+	bool                            standby;
+
+	/* passed on to the encoder before the next frame, like the bitrate */
+	volatile bool                   keyframe_requested;
+
 	/* stores the video/audio media output pointer.  video_t *or audio_t **/
 	void                            *media;
 
+	/* audio mix encoded by audio encoders */
+	size_t                          mixer_idx;
+
 	pthread_mutex_t                 callbacks_mutex;
 	DARRAY(struct encoder_callback) callbacks;
 };
@@ -497,6 +951,17 @@ extern void obs_encoder_add_output(struct obs_encoder *encoder,
 extern void obs_encoder_remove_output(struct obs_encoder *encoder,
 		struct obs_output *output);
 
+/* requests a temporary bitrate (in kbps) in place of the "bitrate" setting,
+ * or 0 to go back to the configured bitrate */
+extern void obs_encoder_set_dynamic_bitrate(struct obs_encoder *encoder,
+		uint32_t bitrate);
+extern uint32_t obs_encoder_get_configured_bitrate(
+		const struct obs_encoder *encoder);
+
+/* called from the graphics thread for encoders in a mix's gpu_encoders */
+extern void obs_encoder_encode_texture(struct obs_encoder *encoder,
+		gs_texture_t *textures[], uint64_t timestamp);
+
 /* ------------------------------------------------------------------------- */
 /* services */
 
@@ -17,6 +17,7 @@
 
 #include "util/platform.h"
 #include "util/dstr.h"
+#include "util/task-pool.h"
 
 #include "obs-defs.h"
 #include "obs-internal.h"
@@ -56,15 +57,15 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	return MODULE_SUCCESS;
 }
 
-int obs_open_module(obs_module_t **module, const char *path,
+/* opens the module binary and loads its locale, but doesn't add it to the
+ * module list.  doesn't touch any shared state, so it can be called for
+ * multiple modules in parallel */
+static int open_module(obs_module_t **module, const char *path,
 		const char *data_path)
 {
 	struct obs_module mod = {0};
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
 	mod.module = os_dlopen(path);
 	if (!mod.module) {
 		blog(LOG_WARNING, "Module '%s' not found", path);
@@ -79,10 +80,8 @@ int obs_open_module(obs_module_t **module, const char *path,
 	mod.file      = strrchr(mod.bin_path, '/');
 	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
 	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
 
 	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
 	mod.set_pointer(*module);
 
 	if (mod.set_locale)
@@ -91,6 +90,27 @@ int obs_open_module(obs_module_t **module, const char *path,
 	return MODULE_SUCCESS;
 }
 
+static inline void add_module(obs_module_t *module)
+{
+	module->next      = obs->first_module;
+	obs->first_module = module;
+}
+
+int obs_open_module(obs_module_t **module, const char *path,
+		const char *data_path)
+{
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	errorcode = open_module(module, path, data_path);
+	if (errorcode == MODULE_SUCCESS)
+		add_module(*module);
+
+	return errorcode;
+}
+
 bool obs_init_module(obs_module_t *module)
 {
 	if (!module || !obs)
@@ -164,25 +184,72 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
+struct found_module {
+	char                           *bin_path;
+	char                           *data_path;
+	obs_module_t                   *module;
+};
+
 static void load_all_callback(void *param, const struct obs_module_info *info)
 {
-	obs_module_t *module;
+	struct found_module *fm = darray_push_back_new(
+			sizeof(struct found_module), param);
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
+	fm->bin_path  = bstrdup(info->bin_path);
+	fm->data_path = bstrdup(info->data_path);
+}
+
+static void open_found_module(void *param, size_t idx)
+{
+	struct darray *found = param;
+	struct found_module *fm = (struct found_module*)found->array + idx;
+
+	int code = open_module(&fm->module, fm->bin_path, fm->data_path);
 	if (code != MODULE_SUCCESS) {
 		blog(LOG_DEBUG, "Failed to load module file '%s': %d",
-				info->bin_path, code);
-		return;
+				fm->bin_path, code);
+		fm->module = NULL;
 	}
-
-	obs_init_module(module);
-
-	UNUSED_PARAMETER(param);
 }
 
+/*
+ * Opening the module binaries and loading their locale files is the slow part
+ * and is independent for each module, so it's done in parallel.  The modules
+ * are then added and initialized one by one in the order they were found, as
+ * registering their types modifies shared lists.
+ */
 void obs_load_all_modules(void)
 {
-	obs_find_modules(load_all_callback, NULL);
+	struct darray found;
+	task_pool_t *pool;
+
+	if (!obs) return;
+
+	darray_init(&found);
+	obs_find_modules(load_all_callback, &found);
+
+	pool = found.num > 1 ? task_pool_create(0) : NULL;
+	if (pool) {
+		task_pool_run(pool, found.num, open_found_module, &found);
+		task_pool_destroy(pool);
+	} else {
+		for (size_t i = 0; i < found.num; i++)
+			open_found_module(&found, i);
+	}
+
+	for (size_t i = 0; i < found.num; i++) {
+		struct found_module *fm = (struct found_module*)found.array + i;
+
+		if (fm->module) {
+			add_module(fm->module);
+			obs_init_module(fm->module);
+		}
+
+		bfree(fm->bin_path);
+		bfree(fm->data_path);
+	}
+
+	darray_free(&found);
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
@@ -89,6 +89,11 @@ bool obs_module_load(void)
  * the sources/encoders/outputs/services for your module, or anything else that
  * may need loading.
  *
+ * Modules are loaded one at a time, so this should only do what's needed to
+ * register the module's types.  Expensive work such as enumerating devices
+ * should be deferred until a source/encoder/output is first created or its
+ * properties are first requested.
+ *
  * @return           Return true to continue loading the module, otherwise
  *                   false to indcate failure and unload the module
  */
@@ -61,6 +61,7 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 {
 	const struct obs_output_info *info = find_output(id);
 	struct obs_output *output;
+	enum bmem_tag prev_tag;
 	int ret;
 
 	if (!info) {
@@ -87,7 +88,9 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	if (ret < 0)
 		goto fail;
 
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_OUTPUT);
 	output->context.data = info->create(output->context.settings, output);
+	bmem_set_thread_tag(prev_tag);
 	if (!output->context.data)
 		goto fail;
 
@@ -107,11 +110,19 @@ fail:
 	return NULL;
 }
 
-static inline void free_packets(struct obs_output *output)
+static void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_free_encoder_packet(output->interleaved_packets.array+i);
-	da_free(output->interleaved_packets);
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct circlebuf *packets = &output->tracks[i].packets;
+
+		while (packets->size) {
+			struct encoder_packet packet;
+			circlebuf_pop_front(packets, &packet, sizeof(packet));
+			obs_encoder_packet_release(&packet);
+		}
+
+		circlebuf_free(packets);
+	}
 }
 
 void obs_output_destroy(obs_output_t *output)
@@ -135,9 +146,12 @@ void obs_output_destroy(obs_output_t *output)
 			obs_encoder_remove_output(output->video_encoder,
 					output);
 		}
-		if (output->audio_encoder) {
-			obs_encoder_remove_output(output->audio_encoder,
-					output);
+		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+			if (output->audio_encoders[i]) {
+				obs_encoder_remove_output(
+						output->audio_encoders[i],
+						output);
+			}
 		}
 
 		pthread_mutex_destroy(&output->interleaved_mutex);
@@ -161,7 +175,7 @@ bool obs_output_start(obs_output_t *output)
 
 	success = output->info.start(output->context.data);
 
-	if (success && output->video) {
+	if (success && output->video && obs->video.video) {
 		output->starting_frame_count =
 			video_output_get_total_frames(output->video);
 		output->starting_skipped_frame_count =
@@ -181,6 +195,9 @@ static void log_frame_info(struct obs_output *output)
 
 	int dropped = obs_output_get_frames_dropped(output);
 
+	struct video_output_timing timing;
+	video_output_get_timing(output->video, &timing);
+
 	double percentage_skipped = (double)skipped / (double)total * 100.0;
 
 	blog(LOG_INFO, "Output '%s': stopping", output->context.name);
@@ -193,6 +210,14 @@ static void log_frame_info(struct obs_output *output)
 				output->context.name,
 				skipped, percentage_skipped);
 
+	if (timing.frames)
+		blog(LOG_INFO, "Output '%s': Frame start jitter: "
+				"average %.3f ms, max %.3f ms",
+				output->context.name,
+				(double)timing.total_jitter_ns /
+				(double)timing.frames / 1000000.0,
+				(double)timing.max_jitter_ns / 1000000.0);
+
 	if (dropped) {
 		double percentage_dropped;
 		percentage_dropped = (double)dropped / (double)total * 100.0;
@@ -214,7 +239,7 @@ void obs_output_stop(obs_output_t *output)
 		output->info.stop(output->context.data);
 		signal_stop(output, OBS_OUTPUT_SUCCESS);
 
-		if (output->video)
+		if (output->video && obs->video.video)
 			log_frame_info(output);
 	}
 }
@@ -331,10 +356,14 @@ void obs_output_remove_encoder(struct obs_output *output,
 {
 	if (!output) return;
 
-	if (output->video_encoder == encoder)
+	if (output->video_encoder == encoder) {
 		output->video_encoder = NULL;
-	else if (output->audio_encoder == encoder)
-		output->audio_encoder = NULL;
+	} else {
+		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+			if (output->audio_encoders[i] == encoder)
+				output->audio_encoders[i] = NULL;
+		}
+	}
 }
 
 void obs_output_set_video_encoder(obs_output_t *output, obs_encoder_t *encoder)
@@ -353,15 +382,23 @@ void obs_output_set_video_encoder(obs_output_t *output, obs_encoder_t *encoder)
 				output->scaled_width, output->scaled_height);
 }
 
-void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder)
+void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder,
+		size_t idx)
 {
 	if (!output) return;
-	if (output->audio_encoder == encoder) return;
 	if (encoder && encoder->info.type != OBS_ENCODER_AUDIO) return;
 
-	obs_encoder_remove_output(output->audio_encoder, output);
+	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK) != 0) {
+		if (idx >= MAX_AUDIO_MIXES) return;
+	} else if (idx > 0) {
+		return;
+	}
+
+	if (output->audio_encoders[idx] == encoder) return;
+
+	obs_encoder_remove_output(output->audio_encoders[idx], output);
 	obs_encoder_add_output(encoder, output);
-	output->audio_encoder = encoder;
+	output->audio_encoders[idx] = encoder;
 }
 
 obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output)
@@ -369,9 +406,11 @@ obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output)
 	return output ? output->video_encoder : NULL;
 }
 
-obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output)
+obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
+		size_t idx)
 {
-	return output ? output->audio_encoder : NULL;
+	if (!output || idx >= MAX_AUDIO_MIXES) return NULL;
+	return output->audio_encoders[idx];
 }
 
 void obs_output_set_service(obs_output_t *output, obs_service_t *service)
@@ -415,6 +454,127 @@ int obs_output_get_frames_dropped(const obs_output_t *output)
 	return output->info.get_dropped_frames(output->context.data);
 }
 
+void obs_output_get_perf_stats(struct obs_output *output,
+		struct obs_perf_output_stats *stats)
+{
+	size_t queued = 0;
+
+	os_mutex_lock(&output->interleaved_mutex, "interleaved_mutex");
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++)
+		queued += output->tracks[i].packets.size /
+			sizeof(struct encoder_packet);
+	os_mutex_unlock(&output->interleaved_mutex, "interleaved_mutex");
+
+	if (output->info.get_queued_packets)
+		queued += output->info.get_queued_packets(
+				output->context.data);
+
+	snprintf(stats->name, sizeof(stats->name), "%s",
+			obs_output_get_name(output));
+	stats->active         = output->active;
+	stats->frames_dropped = obs_output_get_frames_dropped(output);
+	stats->queued_packets = queued;
+}
+
+uint32_t obs_output_get_send_rate(const obs_output_t *output)
+{
+	if (!output || !output->info.get_send_rate)
+		return 0;
+
+	return output->info.get_send_rate(output->context.data);
+}
+
+/* congestion levels at which the video bitrate gets lowered/raised */
+#define CONGESTION_HIGH              0.5f
+#define CONGESTION_LOW               0.1f
+
+/* minimum time between lowering the bitrate, and the time the output must be
+ * uncongested before it gets raised again */
+#define BITRATE_LOWER_INTERVAL_NS    2000000000ULL
+#define BITRATE_RAISE_INTERVAL_NS    10000000000ULL
+
+/* the bitrate is never lowered below this fraction of the configured rate */
+#define MIN_BITRATE_DIVISOR          10
+
+static uint32_t get_lowered_bitrate(const struct obs_output *output,
+		uint32_t cur_bitrate, uint32_t max_bitrate)
+{
+	uint32_t send_rate   = obs_output_get_send_rate(output);
+	uint32_t min_bitrate = max_bitrate / MIN_BITRATE_DIVISOR;
+	uint32_t bitrate     = cur_bitrate * 3 / 4;
+
+	/* leave some headroom for audio and protocol overhead if the output
+	 * knows how fast it's actually able to send */
+	if (send_rate && send_rate * 8 / 10 < bitrate)
+		bitrate = send_rate * 8 / 10;
+
+	if (!min_bitrate)
+		min_bitrate = 1;
+	return (bitrate < min_bitrate) ? min_bitrate : bitrate;
+}
+
+void obs_output_report_congestion(obs_output_t *output, float congestion)
+{
+	struct obs_encoder *encoder;
+	uint32_t           max_bitrate;
+	uint32_t           cur_bitrate;
+	uint32_t           new_bitrate;
+	uint64_t           ts;
+
+	if (!output || !output->active || !output->video_encoder)
+		return;
+
+	encoder     = output->video_encoder;
+	max_bitrate = obs_encoder_get_configured_bitrate(encoder);
+	if (!max_bitrate)
+		return;
+
+	cur_bitrate = encoder->requested_bitrate ?
+		encoder->requested_bitrate : max_bitrate;
+	ts = os_gettime_ns();
+
+	if (congestion >= CONGESTION_HIGH) {
+		output->uncongested_ts = 0;
+
+		if (ts - output->bitrate_change_ts < BITRATE_LOWER_INTERVAL_NS)
+			return;
+
+		new_bitrate = get_lowered_bitrate(output, cur_bitrate,
+				max_bitrate);
+
+	} else if (congestion <= CONGESTION_LOW &&
+	           cur_bitrate < max_bitrate) {
+		if (!output->uncongested_ts)
+			output->uncongested_ts = ts;
+
+		if (ts - output->uncongested_ts < BITRATE_RAISE_INTERVAL_NS ||
+		    ts - output->bitrate_change_ts < BITRATE_RAISE_INTERVAL_NS)
+			return;
+
+		new_bitrate = cur_bitrate + max_bitrate / MIN_BITRATE_DIVISOR;
+		if (new_bitrate > max_bitrate)
+			new_bitrate = max_bitrate;
+
+	} else {
+		if (congestion > CONGESTION_LOW)
+			output->uncongested_ts = 0;
+		return;
+	}
+
+	if (new_bitrate == cur_bitrate)
+		return;
+
+	blog(LOG_INFO, "Output '%s': %s video bitrate to %u kbps "
+			"(congestion: %.2f)", output->context.name,
+			new_bitrate < cur_bitrate ? "lowering" : "raising",
+			new_bitrate, congestion);
+
+	output->bitrate_change_ts = ts;
+	output->bitrate_adjusted  = new_bitrate != max_bitrate;
+	obs_encoder_set_dynamic_bitrate(encoder,
+			output->bitrate_adjusted ? new_bitrate : 0);
+}
+
 int obs_output_get_total_frames(const obs_output_t *output)
 {
 	return output ? output->total_frames : 0;
@@ -487,6 +647,19 @@ void obs_output_set_audio_conversion(obs_output_t *output,
 	output->audio_conversion_set = true;
 }
 
+void obs_output_set_mixer(obs_output_t *output, size_t mixer_idx)
+{
+	if (!output || output->active || mixer_idx >= MAX_AUDIO_MIXES)
+		return;
+
+	output->mixer_idx = mixer_idx;
+}
+
+size_t obs_output_get_mixer(const obs_output_t *output)
+{
+	return output ? output->mixer_idx : 0;
+}
+
 static bool can_begin_data_capture(const struct obs_output *output,
 		bool encoded, bool has_video, bool has_audio, bool has_service)
 {
@@ -502,7 +675,7 @@ static bool can_begin_data_capture(const struct obs_output *output,
 
 	if (has_audio) {
 		if (encoded) {
-			if (!output->audio_encoder)
+			if (!output->audio_encoders[0])
 				return false;
 		} else {
 			if (!output->audio)
@@ -561,27 +734,32 @@ static inline struct audio_convert_info *get_audio_conversion(
 	return output->audio_conversion_set ? &output->audio_conversion : NULL;
 }
 
-static void apply_interleaved_packet_offset(struct obs_output *output,
-		struct encoder_packet *out)
+/* a track can hold up packets of the other tracks for at most this long, so
+ * an encoder that stalls can't make the other tracks queue up without limit */
+#define MAX_INTERLEAVE_DELAY_USEC 2000000LL
+
+static inline size_t get_track_idx(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO ? 0 : 1 + packet->track_idx;
+}
+
+static inline bool peek_track(struct interleave_track *track,
+		struct encoder_packet *packet)
 {
-	int64_t offset;
+	if (!track->packets.size)
+		return false;
 
+	circlebuf_peek_front(&track->packets, packet, sizeof(*packet));
+	return true;
+}
+
+static void apply_interleaved_packet_offset(struct encoder_packet *out,
+		int64_t offset)
+{
 	/* audio and video need to start at timestamp 0, and the encoders
 	 * may not currently be at 0 when we get data.  so, we store the
 	 * current dts as offset and subtract that value from the dts/pts
 	 * of the output packet. */
-	if (out->type == OBS_ENCODER_VIDEO) {
-		if (!output->received_video)
-			output->received_video = true;
-
-		offset = output->video_offset;
-	} else {
-		if (!output->received_audio)
-			output->received_audio = true;
-
-		offset = output->audio_offset;
-	}
-
 	out->dts -= offset;
 	out->pts -= offset;
 
@@ -594,200 +772,241 @@ static void apply_interleaved_packet_offset(struct obs_output *output,
 	out->dts_usec = packet_dts_usec(out);
 }
 
-static inline bool has_higher_opposing_ts(struct obs_output *output,
-		struct encoder_packet *packet)
-{
-	if (packet->type == OBS_ENCODER_VIDEO)
-		return output->highest_audio_ts > packet->dts_usec;
-	else
-		return output->highest_video_ts > packet->dts_usec;
-}
-
-static inline void send_interleaved(struct obs_output *output)
+/* audio tracks are numbered from 0 without gaps, the first track without an
+ * encoder ends the list */
+static inline size_t num_audio_tracks(const struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	size_t count = 0;
 
-	/* do not send an interleaved packet if there's no packet of the
-	 * opposing type of a higher timstamp in the interleave buffer.
-	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
-		return;
+	while (count < MAX_AUDIO_MIXES && output->audio_encoders[count])
+		count++;
 
-	if (out.type == OBS_ENCODER_VIDEO)
-		output->total_frames++;
-
-	da_erase(output->interleaved_packets, 0);
-	output->info.encoded_packet(output->context.data, &out);
-	obs_free_encoder_packet(&out);
+	return count;
 }
 
-static inline void set_higher_ts(struct obs_output *output,
-		struct encoder_packet *packet)
+static inline size_t get_audio_track_idx(const struct obs_output *output,
+		const struct encoder_packet *packet)
 {
-	if (packet->type == OBS_ENCODER_VIDEO) {
-		if (output->highest_video_ts < packet->dts_usec)
-			output->highest_video_ts = packet->dts_usec;
-	} else {
-		if (output->highest_audio_ts < packet->dts_usec)
-			output->highest_audio_ts = packet->dts_usec;
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (output->audio_encoders[i] == packet->encoder)
+			return i;
 	}
+
+	return 0;
 }
 
-static bool can_prune_interleaved_packet(struct obs_output *output, size_t idx)
+static void reset_interleaver(struct obs_output *output, bool has_video,
+		bool has_audio)
 {
-	struct encoder_packet *packet;
-	struct encoder_packet *next;
-
-	if (idx >= (output->interleaved_packets.num - 1))
-		return false;
-
-	packet = &output->interleaved_packets.array[idx];
+	size_t audio_tracks = has_audio ? num_audio_tracks(output) : 0;
 
-	/* audio packets will almost always come before video packets,
-	 * so it should only ever be necessary to prune audio packets */
-	if (packet->type != OBS_ENCODER_AUDIO)
-		return false;
+	free_packets(output);
 
-	next = &output->interleaved_packets.array[idx + 1];
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &output->tracks[i];
+		track->offset   = 0;
+		track->received = false;
+		track->enabled  = false;
+	}
 
-	if (next->type == OBS_ENCODER_VIDEO &&
-	    next->dts_usec == packet->dts_usec)
-		return false;
+	output->tracks[0].enabled = has_video;
+	for (size_t i = 0; i < audio_tracks; i++)
+		output->tracks[1 + i].enabled = true;
 
-	return true;
+	output->interleave_started = false;
+	output->interleave_forced  = false;
+	output->highest_ts         = 0;
 }
 
-static void prune_interleaved_packets(struct obs_output *output)
+/* audio packets will almost always come before video packets, so audio that
+ * precedes the first video packet is dropped before starting */
+static void prune_track(struct interleave_track *track, int64_t start_usec)
 {
-	size_t start_idx = 0;
+	struct encoder_packet packet;
 
-	while (can_prune_interleaved_packet(output, start_idx))
-		start_idx++;
+	while (peek_track(track, &packet) && packet.dts_usec < start_usec) {
+		circlebuf_pop_front(&track->packets, NULL, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
 
-	if (start_idx) {
-		for (size_t i = 0; i < start_idx; i++) {
-			struct encoder_packet *packet =
-				&output->interleaved_packets.array[i];
-			obs_free_encoder_packet(packet);
-		}
+	track->received = track->packets.size != 0;
+}
 
-		da_erase_range(output->interleaved_packets, 0, start_idx);
-	}
+static inline void set_highest_ts(struct obs_output *output,
+		const struct encoder_packet *packet)
+{
+	if (output->highest_ts < packet->dts_usec)
+		output->highest_ts = packet->dts_usec;
 }
 
-static struct encoder_packet *find_first_packet_type(struct obs_output *output,
-		enum obs_encoder_type type)
+static void offset_track(struct obs_output *output,
+		struct interleave_track *track)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+	size_t count = track->packets.size / sizeof(struct encoder_packet);
 
-		if (packet->type == type)
-			return packet;
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&track->packets, &packet, sizeof(packet));
+		apply_interleaved_packet_offset(&packet, track->offset);
+		set_highest_ts(output, &packet);
+		circlebuf_push_back(&track->packets, &packet, sizeof(packet));
 	}
-
-	return NULL;
 }
 
-static bool initialize_interleaved_packets(struct obs_output *output)
+/* once every track has received data, the first packet of each track becomes
+ * its timestamp 0 */
+static bool start_interleaving(struct obs_output *output)
 {
-	struct encoder_packet *video;
-	struct encoder_packet *audio;
+	struct interleave_track *video = &output->tracks[0];
+	struct encoder_packet   first;
 
-	video = find_first_packet_type(output, OBS_ENCODER_VIDEO);
-	audio = find_first_packet_type(output, OBS_ENCODER_AUDIO);
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &output->tracks[i];
+		if (track->enabled && !track->received)
+			return false;
+	}
 
-	if (!audio)
-		output->received_audio = false;
-	if (!video)
-		output->received_video = false;
-	if (!audio || !video) {
-		return false;
+	if (video->enabled && peek_track(video, &first)) {
+		for (size_t i = 1; i < MAX_INTERLEAVE_TRACKS; i++) {
+			if (output->tracks[i].enabled)
+				prune_track(&output->tracks[i],
+						first.dts_usec);
+		}
+	}
+
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &output->tracks[i];
+		if (track->enabled && !track->received)
+			return false;
 	}
 
-	/* get new offsets */
-	output->video_offset = video->dts;
-	output->audio_offset = audio->dts;
+	output->highest_ts = 0;
 
-	/* subtract offsets from highest TS offset variables */
-	output->highest_audio_ts -= audio->dts_usec;
-	output->highest_video_ts -= video->dts_usec;
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &output->tracks[i];
+		if (!track->enabled)
+			continue;
 
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
+		peek_track(track, &first);
+		track->offset = first.dts;
+		offset_track(output, track);
 	}
 
+	output->interleave_started = true;
 	return true;
 }
 
-static inline void insert_interleaved_packet(struct obs_output *output,
-		struct encoder_packet *out)
+/* finds the track with the lowest dts at its front.  packets can only be sent
+ * once every track has something queued, otherwise a later packet on an empty
+ * track could still have a lower timestamp.  the exception is a track that has
+ * fallen too far behind, which no longer holds up the others. */
+static struct interleave_track *next_interleaved_track(
+		struct obs_output *output)
 {
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
+	struct interleave_track *next    = NULL;
+	struct encoder_packet   next_packet;
+	bool                    waiting  = false;
+
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &output->tracks[i];
+		struct encoder_packet   packet;
+
+		if (!track->enabled)
+			continue;
+
+		if (!peek_track(track, &packet)) {
+			waiting = true;
+			continue;
+		}
 
-		if (out->dts_usec < cur_packet->dts_usec)
-			break;
+		if (!next || packet.dts_usec < next_packet.dts_usec) {
+			next        = track;
+			next_packet = packet;
+		}
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
+	if (!next || !waiting)
+		return next;
+
+	if (output->highest_ts - next_packet.dts_usec <
+			MAX_INTERLEAVE_DELAY_USEC)
+		return NULL;
+
+	if (!output->interleave_forced) {
+		blog(LOG_WARNING, "output '%s': a track has stopped receiving "
+				"data, interleaving without it",
+				output->context.name);
+		output->interleave_forced = true;
+	}
+
+	return next;
+}
+
+static inline void send_to_output(struct obs_output *output,
+		struct encoder_packet *packet)
+{
+	enum bmem_tag prev_tag = bmem_set_thread_tag(BMEM_TAG_OUTPUT);
+	output->info.encoded_packet(output->context.data, packet);
+	bmem_set_thread_tag(prev_tag);
 }
 
-static void resort_interleaved_packets(struct obs_output *output)
+static void send_interleaved(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
+	struct interleave_track *track;
 
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-			sizeof(output->interleaved_packets));
+	while ((track = next_interleaved_track(output)) != NULL) {
+		struct encoder_packet out;
+		circlebuf_pop_front(&track->packets, &out, sizeof(out));
 
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
+		if (out.type == OBS_ENCODER_VIDEO)
+			output->total_frames++;
 
-	da_free(old_array);
+		send_to_output(output, &out);
+		obs_encoder_packet_release(&out);
+	}
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
 {
-	struct obs_output     *output = data;
-	struct encoder_packet out;
-	bool                  was_started;
+	struct obs_output       *output = data;
+	struct interleave_track *track;
+	struct encoder_packet   out;
+	size_t                  idx;
 
-	pthread_mutex_lock(&output->interleaved_mutex);
+	os_mutex_lock(&output->interleaved_mutex, "interleaved_mutex");
 
-	was_started = output->received_audio && output->received_video;
+	obs_encoder_packet_ref(&out, packet);
+	if (out.type == OBS_ENCODER_AUDIO)
+		out.track_idx = get_audio_track_idx(output, &out);
 
-	obs_duplicate_encoder_packet(&out, packet);
-	apply_interleaved_packet_offset(output, &out);
-	insert_interleaved_packet(output, &out);
-	set_higher_ts(output, &out);
+	idx   = get_track_idx(&out);
+	track = &output->tracks[idx];
+	if (!track->enabled) {
+		obs_encoder_packet_release(&out);
+		goto unlock;
+	}
 
-	/* when both video and audio have been received, we're ready
-	 * to start sending out packets (one at a time) */
-	if (output->received_audio && output->received_video) {
-		if (!was_started) {
-			prune_interleaved_packets(output);
-			if (initialize_interleaved_packets(output)) {
-				resort_interleaved_packets(output);
-				send_interleaved(output);
-			}
-		} else {
+	if (output->interleave_started) {
+		apply_interleaved_packet_offset(&out, track->offset);
+		set_highest_ts(output, &out);
+		circlebuf_push_back(&track->packets, &out, sizeof(out));
+		send_interleaved(output);
+	} else {
+		circlebuf_push_back(&track->packets, &out, sizeof(out));
+		track->received = true;
+
+		if (start_interleaving(output))
 			send_interleaved(output);
-		}
 	}
 
-	pthread_mutex_unlock(&output->interleaved_mutex);
+unlock:
+	os_mutex_unlock(&output->interleaved_mutex, "interleaved_mutex");
 }
 
 static void default_encoded_callback(void *param, struct encoder_packet *packet)
 {
 	struct obs_output *output = param;
-	output->info.encoded_packet(output->context.data, packet);
+	send_to_output(output, packet);
 
 	if (packet->type == OBS_ENCODER_VIDEO)
 		output->total_frames++;
@@ -800,36 +1019,49 @@ static void default_raw_video_callback(void *param, struct video_data *frame)
 	output->total_frames++;
 }
 
+typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
+
+/* packets only need to be interleaved when there's more than one track */
+static inline encoded_callback_t get_encoded_callback(
+		const struct obs_output *output, bool has_video, bool has_audio)
+{
+	size_t tracks = (has_video ? 1 : 0) +
+		(has_audio ? num_audio_tracks(output) : 0);
+
+	return tracks > 1 ? interleave_packets : default_encoded_callback;
+}
+
 static void hook_data_capture(struct obs_output *output, bool encoded,
 		bool has_video, bool has_audio)
 {
-	void (*encoded_callback)(void *data, struct encoder_packet *packet);
+	encoded_callback_t encoded_callback;
 
 	if (encoded) {
-		output->received_audio   = false;
-		output->received_video   = false;
-		output->highest_audio_ts = 0;
-		output->highest_video_ts = 0;
-		output->video_offset     = 0;
-		output->audio_offset     = 0;
-		free_packets(output);
+		os_mutex_lock(&output->interleaved_mutex,
+				"interleaved_mutex");
+		reset_interleaver(output, has_video, has_audio);
+		os_mutex_unlock(&output->interleaved_mutex,
+				"interleaved_mutex");
 
-		encoded_callback = (has_video && has_audio) ?
-			interleave_packets : default_encoded_callback;
+		encoded_callback = get_encoded_callback(output, has_video,
+				has_audio);
 
 		if (has_video)
 			obs_encoder_start(output->video_encoder,
 					encoded_callback, output);
-		if (has_audio)
-			obs_encoder_start(output->audio_encoder,
-					encoded_callback, output);
+		if (has_audio) {
+			size_t tracks = num_audio_tracks(output);
+			for (size_t i = 0; i < tracks; i++)
+				obs_encoder_start(output->audio_encoders[i],
+						encoded_callback, output);
+		}
 	} else {
 		if (has_video)
 			video_output_connect(output->video,
 					get_video_conversion(output),
 					default_raw_video_callback, output);
 		if (has_audio)
-			audio_output_connect(output->audio,
+			audio_output_connect(output->audio, output->mixer_idx,
 					get_audio_conversion(output),
 					output->info.raw_audio,
 					output->context.data);
@@ -882,6 +1114,10 @@ static inline void convert_flags(const struct obs_output *output,
 	*has_video   = (flags & OBS_OUTPUT_VIDEO)   != 0;
 	*has_audio   = (flags & OBS_OUTPUT_AUDIO)   != 0;
 	*has_service = (flags & OBS_OUTPUT_SERVICE) != 0;
+
+	/* with video disabled, outputs only capture audio */
+	if (!obs->video.video)
+		*has_video = false;
 }
 
 bool obs_output_can_begin_data_capture(const obs_output_t *output,
@@ -915,14 +1151,28 @@ bool obs_output_initialize_encoders(obs_output_t *output, uint32_t flags)
 		return false;
 	if (has_video && !obs_encoder_initialize(output->video_encoder))
 		return false;
-	if (has_audio && !obs_encoder_initialize(output->audio_encoder))
-		return false;
+	if (has_audio) {
+		size_t tracks = num_audio_tracks(output);
 
-	if (has_video && has_audio && !output->audio_encoder->active &&
-	    !output->video_encoder->active) {
-		output->audio_encoder->wait_for_video = true;
-		output->video_encoder->paired_encoder = output->audio_encoder;
-		output->audio_encoder->paired_encoder = output->video_encoder;
+		for (size_t i = 0; i < tracks; i++) {
+			if (!obs_encoder_initialize(output->audio_encoders[i]))
+				return false;
+		}
+	}
+
+	/* every audio track starts in sync with the video */
+	if (has_video && has_audio && !output->video_encoder->active) {
+		size_t tracks = num_audio_tracks(output);
+
+		for (size_t i = 0; i < tracks; i++) {
+			obs_encoder_t *audio = output->audio_encoders[i];
+			if (audio->active)
+				continue;
+
+			audio->wait_for_video = true;
+			audio->paired_encoder = output->video_encoder;
+			output->video_encoder->paired_encoder = audio;
+		}
 	}
 
 	return true;
@@ -935,7 +1185,10 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 	if (!output) return false;
 	if (output->active) return false;
 
-	output->total_frames   = 0;
+	output->total_frames      = 0;
+	output->bitrate_adjusted  = false;
+	output->bitrate_change_ts = 0;
+	output->uncongested_ts    = 0;
 
 	convert_flags(output, flags, &encoded, &has_video, &has_audio,
 			&has_service);
@@ -964,7 +1217,7 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 void obs_output_end_data_capture(obs_output_t *output)
 {
 	bool encoded, has_video, has_audio, has_service;
-	void (*encoded_callback)(void *data, struct encoder_packet *packet);
+	encoded_callback_t encoded_callback;
 
 	if (!output) return;
 	if (!output->active) return;
@@ -973,21 +1226,32 @@ void obs_output_end_data_capture(obs_output_t *output)
 			&has_service);
 
 	if (encoded) {
-		encoded_callback = (has_video && has_audio) ?
-			interleave_packets : default_encoded_callback;
+		/* don't leave the encoder throttled for any other outputs that
+		 * might still be using it */
+		if (has_video && output->bitrate_adjusted) {
+			obs_encoder_set_dynamic_bitrate(output->video_encoder, 0);
+			output->bitrate_adjusted = false;
+		}
+
+		encoded_callback = get_encoded_callback(output, has_video,
+				has_audio);
 
 		if (has_video)
 			obs_encoder_stop(output->video_encoder,
 					encoded_callback, output);
-		if (has_audio)
-			obs_encoder_stop(output->audio_encoder,
-					encoded_callback, output);
+		if (has_audio) {
+			size_t tracks = num_audio_tracks(output);
+			for (size_t i = 0; i < tracks; i++)
+				obs_encoder_stop(output->audio_encoders[i],
+						encoded_callback, output);
+		}
 	} else {
 		if (has_video)
 			video_output_disconnect(output->video,
 					default_raw_video_callback, output);
 		if (has_audio)
 			audio_output_disconnect(output->audio,
+					output->mixer_idx,
 					output->info.raw_audio,
 					output->context.data);
 	}
@@ -22,6 +22,7 @@
 #define OBS_OUTPUT_AV          (OBS_OUTPUT_VIDEO | OBS_OUTPUT_AUDIO)
 #define OBS_OUTPUT_ENCODED     (1<<2)
 #define OBS_OUTPUT_SERVICE     (1<<3)
+#define OBS_OUTPUT_MULTI_TRACK (1<<4)
 
 struct encoder_packet;
 
@@ -56,6 +57,18 @@ struct obs_output_info {
 	uint64_t (*get_total_bytes)(void *data);
 
 	int (*get_dropped_frames)(void *data);
+
+	/**
+	 * Returns the estimated rate (in kbps) that the output is able to
+	 * send data at, or 0 if unknown
+	 */
+	uint32_t (*get_send_rate)(void *data);
+
+	/**
+	 * Returns the number of packets the output has queued but not yet
+	 * written or sent
+	 */
+	size_t (*get_queued_packets)(void *data);
 };
 
 EXPORT void obs_register_output_s(const struct obs_output_info *info,
@@ -0,0 +1,345 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "util/platform.h"
+#include "util/dstr.h"
+#include "obs.h"
+#include "obs-internal.h"
+
+/*
+ * Pixel effects wrap a pixel function in the same vertex shader and
+ * techniques as default.effect.  Fused effects paste several pixel functions
+ * in to one effect, each with its names prefixed by "f<index>_", and call
+ * them one after the other on the sampled pixel.
+ */
+
+static const char *pixel_effect_header =
+"uniform float4x4 ViewProj;\n"
+"uniform float4x4 color_matrix;\n"
+"uniform float3 color_range_min = {0.0, 0.0, 0.0};\n"
+"uniform float3 color_range_max = {1.0, 1.0, 1.0};\n"
+"uniform texture2d image;\n"
+"\n"
+"sampler_state def_sampler {\n"
+"	Filter   = Linear;\n"
+"	AddressU = Clamp;\n"
+"	AddressV = Clamp;\n"
+"};\n"
+"\n"
+"struct VertInOut {\n"
+"	float4 pos : POSITION;\n"
+"	float2 uv  : TEXCOORD0;\n"
+"};\n"
+"\n"
+"VertInOut VSDefault(VertInOut vert_in)\n"
+"{\n"
+"	VertInOut vert_out;\n"
+"	vert_out.pos = mul(float4(vert_in.pos.xyz, 1.0), ViewProj);\n"
+"	vert_out.uv  = vert_in.uv;\n"
+"	return vert_out;\n"
+"}\n"
+"\n";
+
+static const char *pixel_effect_footer =
+"float4 PSDraw(VertInOut vert_in) : TARGET\n"
+"{\n"
+"	return ApplyPixelFunctions(image.Sample(def_sampler, vert_in.uv));\n"
+"}\n"
+"\n"
+"float4 PSDrawMatrix(VertInOut vert_in) : TARGET\n"
+"{\n"
+"	float4 yuv = image.Sample(def_sampler, vert_in.uv);\n"
+"	yuv.xyz = clamp(yuv.xyz, color_range_min, color_range_max);\n"
+"	return ApplyPixelFunctions(\n"
+"		saturate(mul(float4(yuv.xyz, 1.0), color_matrix)));\n"
+"}\n"
+"\n"
+"technique Draw\n"
+"{\n"
+"	pass\n"
+"	{\n"
+"		vertex_shader = VSDefault(vert_in);\n"
+"		pixel_shader  = PSDraw(vert_in);\n"
+"	}\n"
+"}\n"
+"\n"
+"technique DrawMatrix\n"
+"{\n"
+"	pass\n"
+"	{\n"
+"		vertex_shader = VSDefault(vert_in);\n"
+"		pixel_shader  = PSDrawMatrix(vert_in);\n"
+"	}\n"
+"}\n";
+
+/* names the pixel effect itself declares, the rest belong to the function */
+static const char *header_params[] = {
+	"ViewProj",
+	"color_matrix",
+	"color_range_min",
+	"color_range_max",
+	"image",
+	NULL
+};
+
+static char *build_effect_text(char *const *functions, size_t num,
+		bool prefixed)
+{
+	struct dstr text = {0};
+
+	dstr_copy(&text, pixel_effect_header);
+
+	for (size_t i = 0; i < num; i++) {
+		dstr_cat(&text, functions[i]);
+		dstr_cat(&text, "\n\n");
+	}
+
+	dstr_cat(&text, "float4 ApplyPixelFunctions(float4 rgba)\n{\n");
+	for (size_t i = 0; i < num; i++) {
+		if (prefixed)
+			dstr_catf(&text, "\trgba = f%u_PixelFunction(rgba);\n",
+					(unsigned int)i);
+		else
+			dstr_cat(&text, "\trgba = PixelFunction(rgba);\n");
+	}
+	dstr_cat(&text, "\treturn rgba;\n}\n\n");
+
+	dstr_cat(&text, pixel_effect_footer);
+	return text.array;
+}
+
+static bool is_header_param(const char *name)
+{
+	for (const char **param = header_params; *param; param++) {
+		if (strcmp(*param, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static struct obs_pixel_function *get_pixel_function(const char *file)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_pixel_function *func;
+	char *text;
+
+	func = hash_map_find(&video->pixel_function_map, file);
+	if (func)
+		return func;
+
+	text = os_quick_read_utf8_file(file);
+	if (!text) {
+		blog(LOG_WARNING, "Could not read pixel function file '%s'",
+				file);
+		return NULL;
+	}
+
+	func = bzalloc(sizeof(struct obs_pixel_function));
+	func->file = bstrdup(file);
+	func->text = text;
+
+	da_push_back(video->pixel_functions, &func);
+	func->id = (uint32_t)video->pixel_functions.num;
+
+	hash_map_set(&video->pixel_function_map, func->file, func);
+	return func;
+}
+
+obs_pixel_effect_t *obs_pixel_effect_create(const char *file)
+{
+	struct obs_pixel_function *func;
+	struct obs_pixel_effect *pe;
+	gs_effect_t *effect;
+	char *errors = NULL;
+	char *text;
+
+	if (!obs || !file)
+		return NULL;
+
+	func = get_pixel_function(file);
+	if (!func)
+		return NULL;
+
+	text = build_effect_text(&func->text, 1, false);
+	effect = gs_effect_create(text, file, &errors);
+	bfree(text);
+
+	if (!effect) {
+		blog(LOG_WARNING, "Failed to create pixel effect from "
+		                  "'%s':\n%s", file, errors ? errors : "");
+		bfree(errors);
+		return NULL;
+	}
+
+	pe = bzalloc(sizeof(struct obs_pixel_effect));
+	pe->function = func;
+	pe->effect   = effect;
+
+	for (size_t i = 0; i < gs_effect_get_num_params(effect); i++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(effect, i);
+		struct gs_effect_param_info info;
+
+		gs_effect_get_param_info(param, &info);
+		if (!is_header_param(info.name))
+			da_push_back(pe->params, &param);
+	}
+
+	return pe;
+}
+
+void obs_pixel_effect_destroy(obs_pixel_effect_t *pe)
+{
+	if (pe) {
+		gs_effect_destroy(pe->effect);
+		da_free(pe->params);
+		bfree(pe);
+	}
+}
+
+gs_effect_t *obs_pixel_effect_get_effect(const obs_pixel_effect_t *pe)
+{
+	return pe ? pe->effect : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void map_fused_params(struct obs_fused_effect *fused,
+		obs_pixel_effect_t *const *pes)
+{
+	struct dstr name = {0};
+
+	for (size_t i = 0; i < fused->num; i++) {
+		const obs_pixel_effect_t *pe = pes[i];
+
+		for (size_t j = 0; j < pe->params.num; j++) {
+			struct gs_effect_param_info info;
+			gs_eparam_t *param;
+
+			gs_effect_get_param_info(pe->params.array[j], &info);
+			dstr_printf(&name, "f%u_%s", (unsigned int)i,
+					info.name);
+
+			param = gs_effect_get_param_by_name(fused->effect,
+					name.array);
+			da_push_back(fused->params, &param);
+		}
+	}
+
+	dstr_free(&name);
+}
+
+static void compile_fused_effect(struct obs_fused_effect *fused,
+		obs_pixel_effect_t *const *pes)
+{
+	char *functions[MAX_FUSED_FILTERS] = {0};
+	struct dstr prefix = {0};
+	char *errors = NULL;
+	char *text = NULL;
+	size_t i;
+
+	for (i = 0; i < fused->num; i++) {
+		const struct obs_pixel_function *func = pes[i]->function;
+
+		dstr_printf(&prefix, "f%u_", (unsigned int)i);
+		functions[i] = gs_effect_prefix_names(func->text, func->file,
+				prefix.array, NULL);
+		if (!functions[i])
+			goto fail;
+	}
+
+	text = build_effect_text(functions, fused->num, true);
+	fused->effect = gs_effect_create(text, "fused pixel filters",
+			&errors);
+	if (!fused->effect)
+		goto fail;
+
+	map_fused_params(fused, pes);
+	goto done;
+
+fail:
+	blog(LOG_WARNING, "Failed to fuse pixel filters %s, they will be "
+	                  "drawn separately:\n%s", fused->key,
+	                  errors ? errors : "");
+
+done:
+	for (i = 0; i < fused->num; i++)
+		bfree(functions[i]);
+	dstr_free(&prefix);
+	bfree(errors);
+	bfree(text);
+}
+
+size_t obs_get_fused_effect(obs_pixel_effect_t *const *pes, size_t num)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_fused_effect *fused;
+	struct dstr key = {0};
+	void *idx;
+
+	for (size_t i = 0; i < num; i++)
+		dstr_catf(&key, i ? ",%u" : "%u",
+				(unsigned int)pes[i]->function->id);
+
+	/* the map holds index + 1, so that 0 is "not found" */
+	idx = hash_map_find(&video->fused_effect_map, key.array);
+	if (idx) {
+		dstr_free(&key);
+		return (size_t)idx - 1;
+	}
+
+	fused = bzalloc(sizeof(struct obs_fused_effect));
+	fused->key = key.array;
+	fused->num = num;
+	for (size_t i = 0; i < num; i++)
+		fused->ids[i] = pes[i]->function->id;
+
+	compile_fused_effect(fused, pes);
+
+	da_push_back(video->fused_effects, &fused);
+	hash_map_set(&video->fused_effect_map, fused->key,
+			(void*)video->fused_effects.num);
+	return video->fused_effects.num - 1;
+}
+
+void free_pixel_effects(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		struct obs_fused_effect *fused = video->fused_effects.array[i];
+
+		gs_effect_destroy(fused->effect);
+		da_free(fused->params);
+		bfree(fused->key);
+		bfree(fused);
+	}
+
+	for (size_t i = 0; i < video->pixel_functions.num; i++) {
+		struct obs_pixel_function *func =
+			video->pixel_functions.array[i];
+
+		bfree(func->file);
+		bfree(func->text);
+		bfree(func);
+	}
+
+	hash_map_free(&video->fused_effect_map);
+	hash_map_free(&video->pixel_function_map);
+	da_free(video->fused_effects);
+	da_free(video->pixel_functions);
+}
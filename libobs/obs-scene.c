@@ -34,7 +34,10 @@ static const char *obs_scene_signals[] = {
 
 static inline void signal_item_remove(struct obs_scene_item *item)
 {
-	struct calldata params = {0};
+	uint8_t stack[CALLDATA_FIXED_SIZE];
+	struct calldata params;
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", item->parent);
 	calldata_set_ptr(&params, "item", item);
 
@@ -52,9 +55,11 @@ static const char *scene_getname(void)
 static void *scene_create(obs_data_t *settings, struct obs_source *source)
 {
 	pthread_mutexattr_t attr;
-	struct obs_scene *scene = bmalloc(sizeof(struct obs_scene));
-	scene->source     = source;
-	scene->first_item = NULL;
+	struct obs_scene *scene = bzalloc(sizeof(struct obs_scene));
+	scene->source      = source;
+	scene->first_item  = NULL;
+	scene->dirty       = true;
+	scene->index.dirty = true;
 
 	signal_handler_add_array(obs_source_get_signal_handler(source),
 			obs_scene_signals);
@@ -101,6 +106,7 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 	pthread_mutex_destroy(&scene->mutex);
+	da_free(scene->index.items);
 	bfree(scene);
 }
 
@@ -129,6 +135,9 @@ static void scene_enum_sources(void *data,
 
 static inline void detach_sceneitem(struct obs_scene_item *item)
 {
+	item->parent->dirty = true;
+	item->parent->index.dirty = true;
+
 	if (item->prev)
 		item->prev->next = item->next;
 	else
@@ -145,6 +154,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 {
 	item->prev   = prev;
 	item->parent = parent;
+	parent->dirty = true;
+	parent->index.dirty = true;
 
 	if (prev) {
 		item->next = prev->next;
@@ -221,6 +232,59 @@ static void calculate_bounds_data(struct obs_scene_item *item,
 			(int)-width_diff, (int)-height_diff);
 }
 
+static void update_item_draw_area(struct obs_scene_item *item,
+		uint32_t width, uint32_t height)
+{
+	struct vec3 corners[4];
+	float       rot = fmodf(item->rot, 90.0f);
+
+	vec3_set(&corners[0], 0.0f,          0.0f,           0.0f);
+	vec3_set(&corners[1], (float)width,  0.0f,           0.0f);
+	vec3_set(&corners[2], 0.0f,          (float)height,  0.0f);
+	vec3_set(&corners[3], (float)width,  (float)height,  0.0f);
+
+	vec3_transform_array(corners, corners, 4, &item->draw_transform);
+
+	for (size_t i = 0; i < 4; i++) {
+		struct vec2 pos;
+
+		vec2_set(&pos, corners[i].x, corners[i].y);
+
+		if (i == 0) {
+			vec2_copy(&item->draw_min, &pos);
+			vec2_copy(&item->draw_max, &pos);
+		} else {
+			vec2_min(&item->draw_min, &item->draw_min, &pos);
+			vec2_max(&item->draw_max, &item->draw_max, &pos);
+		}
+	}
+
+	item->axis_aligned = close_float(rot, 0.0f, EPSILON);
+}
+
+static void update_item_box_area(struct obs_scene_item *item)
+{
+	struct vec3 corners[4];
+
+	vec3_set(&corners[0], 0.0f, 0.0f, 0.0f);
+	vec3_set(&corners[1], 1.0f, 0.0f, 0.0f);
+	vec3_set(&corners[2], 0.0f, 1.0f, 0.0f);
+	vec3_set(&corners[3], 1.0f, 1.0f, 0.0f);
+
+	vec3_transform_array(corners, corners, 4, &item->box_transform);
+
+	vec2_set(&item->box_min, corners[0].x, corners[0].y);
+	vec2_copy(&item->box_max, &item->box_min);
+
+	for (size_t i = 1; i < 4; i++) {
+		struct vec2 pos;
+
+		vec2_set(&pos, corners[i].x, corners[i].y);
+		vec2_min(&item->box_min, &item->box_min, &pos);
+		vec2_max(&item->box_max, &item->box_max, &pos);
+	}
+}
+
 static void update_item_transform(struct obs_scene_item *item)
 {
 	uint32_t        width         = obs_source_get_width(item->source);
@@ -230,7 +294,10 @@ static void update_item_transform(struct obs_scene_item *item)
 	struct vec2     base_origin;
 	struct vec2     origin;
 	struct vec2     scale         = item->scale;
-	struct calldata params        = {0};
+	struct calldata params;
+	uint8_t         stack[CALLDATA_FIXED_SIZE];
+
+	item->update_transform = false;
 
 	vec2_zero(&base_origin);
 	vec2_zero(&origin);
@@ -279,9 +346,15 @@ static void update_item_transform(struct obs_scene_item *item)
 
 	/* ----------------------- */
 
+	update_item_draw_area(item, width, height);
+	update_item_box_area(item);
+	item->parent->dirty = true;
+	item->parent->index.dirty = true;
+
 	item->last_width  = width;
 	item->last_height = height;
 
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", item->parent);
 	calldata_set_ptr(&params, "item", item);
 	signal_handler_signal(item->parent->source->context.signals,
@@ -297,6 +370,114 @@ static inline bool source_size_changed(struct obs_scene_item *item)
 	return item->last_width != width || item->last_height != height;
 }
 
+/* called with the scene mutex held */
+static inline void update_transform_if_needed(struct obs_scene_item *item)
+{
+	if (item->update_transform || source_size_changed(item))
+		update_item_transform(item);
+}
+
+/* lets callers get up to date transforms right after changing the item
+ * instead of on the next frame */
+static void flush_item_transform(struct obs_scene_item *item)
+{
+	struct obs_scene *scene = item->parent;
+
+	if (!item->update_transform || !scene)
+		return;
+
+	pthread_mutex_lock(&scene->mutex);
+	if (item->update_transform)
+		update_item_transform(item);
+	pthread_mutex_unlock(&scene->mutex);
+}
+
+/* only a few of the topmost opaque items are checked against, scenes tend to
+ * have at most a couple of large opaque items (backgrounds, captures) */
+#define MAX_OCCLUDERS 8
+
+static inline bool item_is_opaque(const struct obs_scene_item *item)
+{
+	const struct obs_source *source = item->source;
+
+	return (source->info.output_flags & OBS_SOURCE_OPAQUE) != 0 &&
+		source->filters.num == 0 && item->axis_aligned;
+}
+
+static inline bool area_contains(const struct vec2 *min,
+		const struct vec2 *max, const struct obs_scene_item *item)
+{
+	return item->draw_min.x >= min->x - LARGE_EPSILON &&
+	       item->draw_min.y >= min->y - LARGE_EPSILON &&
+	       item->draw_max.x <= max->x + LARGE_EPSILON &&
+	       item->draw_max.y <= max->y + LARGE_EPSILON;
+}
+
+/* async sources (and composite sources, which may contain them) consume
+ * their frames when they're rendered, so they always have to be rendered */
+static inline bool item_can_cull(const struct obs_scene_item *item)
+{
+	const struct obs_source *source = item->source;
+
+	return (source->info.output_flags & OBS_SOURCE_ASYNC) == 0 &&
+		!source->info.enum_sources;
+}
+
+static inline bool item_off_canvas(const struct obs_scene_item *item,
+		float cx, float cy)
+{
+	return item->draw_max.x <= 0.0f || item->draw_max.y <= 0.0f ||
+	       item->draw_min.x >= cx   || item->draw_min.y >= cy   ||
+	       item->draw_min.x >= item->draw_max.x ||
+	       item->draw_min.y >= item->draw_max.y;
+}
+
+static bool item_occluded(const struct obs_scene_item *item,
+		const struct obs_scene_item **occluders, size_t num_occluders)
+{
+	for (size_t i = 0; i < num_occluders; i++) {
+		const struct obs_scene_item *occluder = occluders[i];
+
+		if (area_contains(&occluder->draw_min, &occluder->draw_max,
+					item))
+			return true;
+	}
+
+	return false;
+}
+
+/* goes through the items from top to bottom, marking items that are either
+ * outside of the canvas or completely covered by opaque items above them */
+static void cull_items(struct obs_scene *scene)
+{
+	const struct obs_scene_item *occluders[MAX_OCCLUDERS];
+	struct obs_scene_item       *item = scene->first_item;
+	size_t                      num_occluders = 0;
+	float                       cx = (float)obs->video.base_width;
+	float                       cy = (float)obs->video.base_height;
+
+	if (!item)
+		return;
+
+	while (item->next)
+		item = item->next;
+
+	for (; item; item = item->prev) {
+		if (obs_source_removed(item->source))
+			continue;
+
+		update_transform_if_needed(item);
+
+		item->culled = item_can_cull(item) &&
+			(item_off_canvas(item, cx, cy) ||
+			 item_occluded(item, occluders, num_occluders));
+
+		if (!item->culled && num_occluders < MAX_OCCLUDERS &&
+		    item_is_opaque(item))
+			occluders[num_occluders++] = item;
+	}
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	struct obs_scene *scene = data;
@@ -304,6 +485,8 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 
 	pthread_mutex_lock(&scene->mutex);
 
+	cull_items(scene);
+
 	item = scene->first_item;
 
 	while (item) {
@@ -315,13 +498,12 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 			continue;
 		}
 
-		if (source_size_changed(item))
-			update_item_transform(item);
-
-		gs_matrix_push();
-		gs_matrix_mul(&item->draw_transform);
-		obs_source_video_render(item->source);
-		gs_matrix_pop();
+		if (!item->culled) {
+			gs_matrix_push();
+			gs_matrix_mul(&item->draw_transform);
+			obs_source_video_render(item->source);
+			gs_matrix_pop();
+		}
 
 		item = item->next;
 	}
@@ -363,7 +545,7 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 
 	obs_source_release(source);
 
-	update_item_transform(item);
+	item->update_transform = true;
 }
 
 static void scene_load(void *scene, obs_data_t *settings)
@@ -426,6 +608,15 @@ static void scene_save(void *data, obs_data_t *settings)
 	obs_data_array_release(array);
 }
 
+static bool scene_video_unchanged(void *data)
+{
+	struct obs_scene *scene = data;
+	bool unchanged = !scene->dirty;
+
+	scene->dirty = false;
+	return unchanged;
+}
+
 static uint32_t scene_getwidth(void *data)
 {
 	UNUSED_PARAMETER(data);
@@ -440,18 +631,19 @@ static uint32_t scene_getheight(void *data)
 
 const struct obs_source_info scene_info =
 {
-	.id            = "scene",
-	.type          = OBS_SOURCE_TYPE_INPUT,
-	.output_flags  = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
-	.get_name      = scene_getname,
-	.create        = scene_create,
-	.destroy       = scene_destroy,
-	.video_render  = scene_video_render,
-	.get_width     = scene_getwidth,
-	.get_height    = scene_getheight,
-	.load          = scene_load,
-	.save          = scene_save,
-	.enum_sources  = scene_enum_sources
+	.id              = "scene",
+	.type            = OBS_SOURCE_TYPE_INPUT,
+	.output_flags    = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.get_name        = scene_getname,
+	.create          = scene_create,
+	.destroy         = scene_destroy,
+	.video_render    = scene_video_render,
+	.get_width       = scene_getwidth,
+	.get_height      = scene_getheight,
+	.load            = scene_load,
+	.save            = scene_save,
+	.enum_sources    = scene_enum_sources,
+	.video_unchanged = scene_video_unchanged
 };
 
 obs_scene_t *obs_scene_create(const char *name)
@@ -538,11 +730,178 @@ void obs_scene_enum_items(obs_scene_t *scene,
 	pthread_mutex_unlock(&scene->mutex);
 }
 
+static inline bool area_overlaps(const struct vec2 *min1,
+		const struct vec2 *max1,
+		const struct vec2 *min2, const struct vec2 *max2)
+{
+	return min1->x <= max2->x && max1->x >= min2->x &&
+	       min1->y <= max2->y && max1->y >= min2->y;
+}
+
+static inline int get_index_cell(float pos, float min, float cell_size)
+{
+	int cell = (int)((pos - min) / cell_size);
+
+	if (cell < 0)
+		return 0;
+	if (cell >= SCENE_INDEX_GRID)
+		return SCENE_INDEX_GRID - 1;
+	return cell;
+}
+
+static void get_index_cells(const struct scene_item_index *index,
+		const struct vec2 *min, const struct vec2 *max,
+		int *x1, int *y1, int *x2, int *y2)
+{
+	*x1 = get_index_cell(min->x, index->min.x, index->cell_size.x);
+	*y1 = get_index_cell(min->y, index->min.y, index->cell_size.y);
+	*x2 = get_index_cell(max->x, index->min.x, index->cell_size.x);
+	*y2 = get_index_cell(max->y, index->min.y, index->cell_size.y);
+}
+
+/* called with the scene mutex held */
+static void rebuild_item_index(struct obs_scene *scene)
+{
+	struct scene_item_index *index = &scene->index;
+	struct obs_scene_item   *item  = scene->first_item;
+	uint32_t                pos[SCENE_INDEX_CELLS];
+	uint32_t                order = 0;
+	int                     x1, y1, x2, y2;
+
+	index->dirty = false;
+	memset(index->offsets, 0, sizeof(index->offsets));
+	da_resize(index->items, 0);
+
+	if (!item)
+		return;
+
+	vec2_copy(&index->min, &item->box_min);
+	vec2_copy(&index->max, &item->box_max);
+
+	for (; item; item = item->next) {
+		vec2_min(&index->min, &index->min, &item->box_min);
+		vec2_max(&index->max, &index->max, &item->box_max);
+		item->index_order = order++;
+	}
+
+	vec2_sub(&index->cell_size, &index->max, &index->min);
+	vec2_divf(&index->cell_size, &index->cell_size,
+			(float)SCENE_INDEX_GRID);
+	vec2_maxf(&index->cell_size, &index->cell_size, 1.0f);
+
+	/* count the items of each cell, then place them */
+	for (item = scene->first_item; item; item = item->next) {
+		get_index_cells(index, &item->box_min, &item->box_max,
+				&x1, &y1, &x2, &y2);
+
+		for (int y = y1; y <= y2; y++)
+			for (int x = x1; x <= x2; x++)
+				index->offsets[y * SCENE_INDEX_GRID + x + 1]++;
+	}
+
+	for (size_t i = 0; i < SCENE_INDEX_CELLS; i++) {
+		index->offsets[i + 1] += index->offsets[i];
+		pos[i] = index->offsets[i];
+	}
+
+	da_resize(index->items, index->offsets[SCENE_INDEX_CELLS]);
+
+	for (item = scene->first_item; item; item = item->next) {
+		get_index_cells(index, &item->box_min, &item->box_max,
+				&x1, &y1, &x2, &y2);
+
+		for (int y = y1; y <= y2; y++)
+			for (int x = x1; x <= x2; x++)
+				index->items.array[pos[y * SCENE_INDEX_GRID +
+					x]++] = item;
+	}
+}
+
+static int compare_index_order(const void *a, const void *b)
+{
+	const struct obs_scene_item *item1 = *(struct obs_scene_item**)a;
+	const struct obs_scene_item *item2 = *(struct obs_scene_item**)b;
+
+	return (int)item1->index_order - (int)item2->index_order;
+}
+
+void obs_scene_enum_items_in_area(obs_scene_t *scene,
+		const struct vec2 *min, const struct vec2 *max,
+		bool (*callback)(obs_scene_t*, obs_sceneitem_t*, void*),
+		void *param)
+{
+	DARRAY(struct obs_scene_item*) found;
+	struct scene_item_index *index;
+	struct obs_scene_item   *item;
+	int                     x1, y1, x2, y2;
+
+	if (!scene || !min || !max || !callback)
+		return;
+
+	da_init(found);
+	index = &scene->index;
+
+	pthread_mutex_lock(&scene->mutex);
+
+	/* transforms are otherwise only brought up to date when rendering */
+	for (item = scene->first_item; item; item = item->next)
+		update_transform_if_needed(item);
+
+	if (index->dirty)
+		rebuild_item_index(scene);
+
+	if (!scene->first_item ||
+	    !area_overlaps(min, max, &index->min, &index->max))
+		goto unlock;
+
+	/* items that span several cells are in each of them, so the stamp
+	 * makes sure each item is only added once */
+	index->stamp++;
+	get_index_cells(index, min, max, &x1, &y1, &x2, &y2);
+
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			size_t cell = y * SCENE_INDEX_GRID + x;
+
+			for (uint32_t i = index->offsets[cell];
+			     i < index->offsets[cell + 1]; i++) {
+				item = index->items.array[i];
+
+				if (item->index_stamp == index->stamp ||
+				    !area_overlaps(min, max, &item->box_min,
+					    &item->box_max))
+					continue;
+
+				item->index_stamp = index->stamp;
+				obs_sceneitem_addref(item);
+				da_push_back(found, &item);
+			}
+		}
+	}
+
+	if (x1 != x2 || y1 != y2)
+		qsort(found.array, found.num, sizeof(*found.array),
+				compare_index_order);
+
+	for (size_t i = 0; i < found.num; i++) {
+		if (!callback(scene, found.array[i], param))
+			break;
+	}
+
+	for (size_t i = 0; i < found.num; i++)
+		obs_sceneitem_release(found.array[i]);
+
+unlock:
+	pthread_mutex_unlock(&scene->mutex);
+	da_free(found);
+}
+
 obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 {
 	struct obs_scene_item *last;
 	struct obs_scene_item *item;
-	struct calldata params = {0};
+	uint8_t stack[CALLDATA_FIXED_SIZE];
+	struct calldata params;
 
 	if (!scene)
 		return NULL;
@@ -558,6 +917,7 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 	item->parent  = scene;
 	item->ref     = 1;
 	item->align   = OBS_ALIGN_TOP | OBS_ALIGN_LEFT;
+	item->update_transform = true;
 	vec2_set(&item->scale, 1.0f, 1.0f);
 	matrix4_identity(&item->draw_transform);
 	matrix4_identity(&item->box_transform);
@@ -578,8 +938,12 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 		item->prev = last;
 	}
 
+	scene->dirty = true;
+	scene->index.dirty = true;
+
 	pthread_mutex_unlock(&scene->mutex);
 
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", scene);
 	calldata_set_ptr(&params, "item", item);
 	signal_handler_signal(scene->source->context.signals, "item_add",
@@ -657,7 +1021,8 @@ obs_source_t *obs_sceneitem_get_source(const obs_sceneitem_t *item)
 
 void obs_sceneitem_select(obs_sceneitem_t *item, bool select)
 {
-	struct calldata params = {0};
+	uint8_t stack[CALLDATA_FIXED_SIZE];
+	struct calldata params;
 	const char *command = select ? "item_select" : "item_deselect";
 
 	if (!item || item->selected == select)
@@ -665,6 +1030,7 @@ void obs_sceneitem_select(obs_sceneitem_t *item, bool select)
 
 	item->selected = select;
 
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", item->parent);
 	calldata_set_ptr(&params, "item",  item);
 	signal_handler_signal(item->parent->source->context.signals,
@@ -682,7 +1048,7 @@ void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
 {
 	if (item) {
 		vec2_copy(&item->pos, pos);
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -690,7 +1056,7 @@ void obs_sceneitem_set_rot(obs_sceneitem_t *item, float rot)
 {
 	if (item) {
 		item->rot = rot;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -698,7 +1064,7 @@ void obs_sceneitem_set_scale(obs_sceneitem_t *item, const struct vec2 *scale)
 {
 	if (item) {
 		vec2_copy(&item->scale, scale);
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -706,7 +1072,7 @@ void obs_sceneitem_set_alignment(obs_sceneitem_t *item, uint32_t alignment)
 {
 	if (item) {
 		item->align = alignment;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -714,7 +1080,8 @@ static inline void signal_move_dir(struct obs_scene_item *item,
 		enum obs_order_movement movement)
 {
 	const char *command = NULL;
-	struct calldata params = {0};
+	uint8_t stack[CALLDATA_FIXED_SIZE];
+	struct calldata params;
 
 	switch (movement) {
 	case OBS_ORDER_MOVE_UP:     command = "item_move_up";     break;
@@ -723,6 +1090,7 @@ static inline void signal_move_dir(struct obs_scene_item *item,
 	case OBS_ORDER_MOVE_BOTTOM: command = "item_move_bottom"; break;
 	}
 
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "scene", item->parent);
 	calldata_set_ptr(&params, "item",  item);
 
@@ -780,7 +1148,7 @@ void obs_sceneitem_set_bounds_type(obs_sceneitem_t *item,
 {
 	if (item) {
 		item->bounds_type = type;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -789,7 +1157,7 @@ void obs_sceneitem_set_bounds_alignment(obs_sceneitem_t *item,
 {
 	if (item) {
 		item->bounds_align = alignment;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -797,7 +1165,7 @@ void obs_sceneitem_set_bounds(obs_sceneitem_t *item, const struct vec2 *bounds)
 {
 	if (item) {
 		item->bounds = *bounds;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
@@ -864,20 +1232,24 @@ void obs_sceneitem_set_info(obs_sceneitem_t *item,
 		item->bounds_type  = info->bounds_type;
 		item->bounds_align = info->bounds_alignment;
 		item->bounds       = info->bounds;
-		update_item_transform(item);
+		item->update_transform = true;
 	}
 }
 
 void obs_sceneitem_get_draw_transform(const obs_sceneitem_t *item,
 		struct matrix4 *transform)
 {
-	if (item)
+	if (item) {
+		flush_item_transform((struct obs_scene_item*)item);
 		matrix4_copy(transform, &item->draw_transform);
+	}
 }
 
 void obs_sceneitem_get_box_transform(const obs_sceneitem_t *item,
 		struct matrix4 *transform)
 {
-	if (item)
+	if (item) {
+		flush_item_transform((struct obs_scene_item*)item);
 		matrix4_copy(transform, &item->box_transform);
+	}
 }
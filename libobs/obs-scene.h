@@ -42,9 +42,27 @@ struct obs_scene_item {
 	uint32_t              last_width;
 	uint32_t              last_height;
 
+	/* the transform settings changed since the transforms were last
+	 * computed.  they're recomputed (and item_transform is signalled) at
+	 * most once per frame, or earlier if they're requested */
+	volatile bool         update_transform;
+
 	struct matrix4        box_transform;
 	struct matrix4        draw_transform;
 
+	/* area the source is drawn to in scene coordinates, used to skip
+	 * items that are off-canvas or covered by opaque items */
+	struct vec2           draw_min;
+	struct vec2           draw_max;
+	bool                  axis_aligned;
+	bool                  culled;
+
+	/* bounding box of the item's box transform, for the item index */
+	struct vec2           box_min;
+	struct vec2           box_max;
+	uint32_t              index_order;
+	uint32_t              index_stamp;
+
 	enum obs_bounds_type  bounds_type;
 	uint32_t              bounds_align;
 	struct vec2           bounds;
@@ -54,9 +72,36 @@ struct obs_scene_item {
 	struct obs_scene_item *next;
 };
 
+/* the item index divides the area covered by the items in to a grid, and
+ * lists the items that overlap each cell, so that looking up the items at a
+ * position (for example for hit-testing in the preview) doesn't have to go
+ * through every item */
+#define SCENE_INDEX_GRID  16
+#define SCENE_INDEX_CELLS (SCENE_INDEX_GRID * SCENE_INDEX_GRID)
+
+struct scene_item_index {
+	bool                  dirty;
+	struct vec2           min;
+	struct vec2           max;
+	struct vec2           cell_size;
+	uint32_t              stamp;
+
+	/* items of cell n are items[offsets[n]] to items[offsets[n+1]], in
+	 * scene order */
+	uint32_t              offsets[SCENE_INDEX_CELLS + 1];
+	DARRAY(struct obs_scene_item*) items;
+};
+
 struct obs_scene {
 	struct obs_source     *source;
 
 	pthread_mutex_t       mutex;
 	struct obs_scene_item *first_item;
+
+	/* items were added, removed, moved or reordered since the last
+	 * frame */
+	volatile bool         dirty;
+
+	/* protected by the scene mutex */
+	struct scene_item_index index;
 };
@@ -22,6 +22,7 @@
 #include "media-io/audio-io.h"
 #include "util/threading.h"
 #include "util/platform.h"
+#include "util/simd.h"
 #include "callback/calldata.h"
 #include "graphics/matrix3.h"
 #include "graphics/vec3.h"
@@ -112,6 +113,7 @@ bool obs_source_init(struct obs_source *source,
 	source->user_volume = 1.0f;
 	source->present_volume = 0.0f;
 	source->sync_offset = 0;
+	da_init_inline(source->filters);
 	pthread_mutex_init_value(&source->filter_mutex);
 	pthread_mutex_init_value(&source->video_mutex);
 	pthread_mutex_init_value(&source->audio_mutex);
@@ -142,9 +144,10 @@ bool obs_source_init(struct obs_source *source,
 static inline void obs_source_dosignal(struct obs_source *source,
 		const char *signal_obs, const char *signal_source)
 {
+	uint8_t stack[CALLDATA_FIXED_SIZE];
 	struct calldata data;
 
-	calldata_init(&data);
+	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
 	if (signal_obs)
 		signal_handler_signal(obs->signals, signal_obs, &data);
@@ -154,8 +157,23 @@ static inline void obs_source_dosignal(struct obs_source *source,
 	calldata_free(&data);
 }
 
-obs_source_t *obs_source_create(enum obs_source_type type, const char *id,
-		const char *name, obs_data_t *settings)
+/* remembers the settings the plugin is created with, so that its first
+ * update_diff only reports what changed since then */
+static void reset_update_state(struct obs_source *source)
+{
+	if (!source->info.update_diff)
+		return;
+
+	if (!source->update_state)
+		source->update_state = obs_data_create();
+
+	obs_data_get_changes(source->context.settings, source->update_state,
+			NULL);
+}
+
+obs_source_t *obs_source_create_internal(enum obs_source_type type,
+		const char *id, const char *name, obs_data_t *settings,
+		bool defer)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -178,16 +196,21 @@ obs_source_t *obs_source_create(enum obs_source_type type, const char *id,
 
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info)
+	if (info && defer) {
+		source->create_deferred = 1;
+	} else if (info) {
+		reset_update_state(source);
 		source->context.data = info->create(source->context.settings,
 				source);
-	if (!source->context.data)
+	}
+	if (!source->context.data && !source->create_deferred)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
 	if (!obs_source_init(source, info))
 		goto fail;
 
-	blog(LOG_INFO, "source '%s' (%s) created", name, id);
+	blog(LOG_INFO, "source '%s' (%s) %s", name, id,
+			defer ? "loaded, creation deferred" : "created");
 	obs_source_dosignal(source, "source_create", NULL);
 	return source;
 
@@ -197,6 +220,42 @@ fail:
 	return NULL;
 }
 
+obs_source_t *obs_source_create(enum obs_source_type type, const char *id,
+		const char *name, obs_data_t *settings)
+{
+	return obs_source_create_internal(type, id, name, settings, false);
+}
+
+void obs_source_instantiate(obs_source_t *source)
+{
+	enum bmem_tag prev_tag;
+	void *data;
+
+	if (!source || os_atomic_load_long(&source->create_deferred) <= 0)
+		return;
+
+	/* only the first caller creates the source */
+	if (os_atomic_dec_long(&source->create_deferred) != 0)
+		return;
+
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_SOURCE);
+	reset_update_state(source);
+	data = source->info.create(source->context.settings, source);
+	bmem_set_thread_tag(prev_tag);
+	if (!data) {
+		blog(LOG_ERROR, "Failed to create source '%s'!",
+				source->context.name);
+		return;
+	}
+
+	if (source->load_deferred && source->info.load)
+		source->info.load(data, source->context.settings);
+
+	source->context.data = data;
+	blog(LOG_INFO, "source '%s' (%s) created", source->context.name,
+			source->info.id);
+}
+
 void obs_source_frame_init(struct obs_source_frame *frame,
 		enum video_format format, uint32_t width, uint32_t height)
 {
@@ -216,6 +275,208 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* cached source trees */
+
+struct tree_list {
+	DARRAY(obs_source_t*) sources;
+};
+
+static void add_tree_child(obs_source_t *parent, obs_source_t *child,
+		void *param)
+{
+	struct tree_list *list = param;
+
+	obs_source_addref(child);
+	da_push_back(list->sources, &child);
+
+	UNUSED_PARAMETER(parent);
+}
+
+static void release_tree_list(struct tree_list *list)
+{
+	for (size_t i = 0; i < list->sources.num; i++)
+		obs_source_release(list->sources.array[i]);
+	da_free(list->sources);
+}
+
+/* the references are moved to a list that is released once tree_mutex is
+ * unlocked, as releasing them can destroy sources */
+static void clear_tree_cache(obs_source_t *source, struct tree_list *release)
+{
+	for (size_t i = 0; i < source->tree_cache.num; i++) {
+		obs_source_t *child = source->tree_cache.array[i];
+		da_erase_item(child->tree_cache_roots, &source);
+	}
+
+	da_push_back_da(release->sources, source->tree_cache);
+	da_free(source->tree_cache);
+	source->tree_cache_valid = false;
+}
+
+/* a cache that's in use is cleared by its last user */
+static void invalidate_tree_cache(obs_source_t *source,
+		struct tree_list *release)
+{
+	source->tree_cache_valid = false;
+	if (!source->tree_cache_users)
+		clear_tree_cache(source, release);
+}
+
+/* adding or removing a child changes the tree of the parent and of every
+ * source whose tree contains the parent */
+static void invalidate_tree_caches(obs_source_t *parent)
+{
+	struct tree_list release = {0};
+	size_t i;
+
+	pthread_mutex_lock(&obs->data.tree_mutex);
+
+	obs->data.tree_generation++;
+	invalidate_tree_cache(parent, &release);
+
+	/* clearing a cache removes its source from tree_cache_roots, so this
+	 * goes backwards */
+	for (i = parent->tree_cache_roots.num; i > 0; i--)
+		invalidate_tree_cache(parent->tree_cache_roots.array[i - 1],
+				&release);
+
+	pthread_mutex_unlock(&obs->data.tree_mutex);
+
+	release_tree_list(&release);
+}
+
+/*
+ * adds a user to the tree cache of the source, building the cache first if
+ * needed.  if the cache can't be replaced because it's still in use after
+ * being invalidated, returns false and the tree is left in list instead.
+ */
+static bool acquire_tree_cache(obs_source_t *source, struct tree_list *list)
+{
+	long generation;
+	bool cached;
+
+	pthread_mutex_lock(&obs->data.tree_mutex);
+	cached = source->tree_cache_valid;
+	if (cached)
+		source->tree_cache_users++;
+	generation = obs->data.tree_generation;
+	pthread_mutex_unlock(&obs->data.tree_mutex);
+
+	if (cached)
+		return true;
+
+	/* enumerating locks the scenes, which can't be done while holding
+	 * tree_mutex because scenes add and remove children while locked */
+	obs_source_enum_tree(source, add_tree_child, list);
+
+	pthread_mutex_lock(&obs->data.tree_mutex);
+
+	cached = source->tree_cache_valid || !source->tree_cache_users;
+
+	if (!source->tree_cache_valid && !source->tree_cache_users) {
+		da_move(source->tree_cache, list->sources);
+
+		for (size_t i = 0; i < source->tree_cache.num; i++) {
+			obs_source_t *child = source->tree_cache.array[i];
+
+			if (da_find(child->tree_cache_roots, &source, 0) ==
+					DARRAY_INVALID)
+				da_push_back(child->tree_cache_roots, &source);
+		}
+
+		/* a child added or removed during the enumeration may have
+		 * been missed, in which case the cache is only used once */
+		source->tree_cache_valid =
+			generation == obs->data.tree_generation;
+	}
+
+	if (cached)
+		source->tree_cache_users++;
+
+	pthread_mutex_unlock(&obs->data.tree_mutex);
+	return cached;
+}
+
+static void release_tree_cache(obs_source_t *source)
+{
+	struct tree_list release = {0};
+
+	pthread_mutex_lock(&obs->data.tree_mutex);
+	if (--source->tree_cache_users == 0 && !source->tree_cache_valid)
+		clear_tree_cache(source, &release);
+	pthread_mutex_unlock(&obs->data.tree_mutex);
+
+	release_tree_list(&release);
+}
+
+static void free_tree_cache(obs_source_t *source)
+{
+	struct tree_list release = {0};
+
+	pthread_mutex_lock(&obs->data.tree_mutex);
+
+	clear_tree_cache(source, &release);
+
+	/* caches hold references, so a destroyed source is only still in
+	 * other caches when sources are freed at shutdown */
+	for (size_t i = 0; i < source->tree_cache_roots.num; i++) {
+		obs_source_t *root = source->tree_cache_roots.array[i];
+		size_t idx;
+
+		while ((idx = da_find(root->tree_cache, &source, 0)) !=
+				DARRAY_INVALID)
+			da_erase(root->tree_cache, idx);
+
+		invalidate_tree_cache(root, &release);
+	}
+
+	da_free(source->tree_cache_roots);
+
+	pthread_mutex_unlock(&obs->data.tree_mutex);
+
+	release_tree_list(&release);
+}
+
+/*
+ * visits the same sources as obs_source_enum_tree, from the cache when
+ * possible.  enum_callback always gets the source as the parent.
+ */
+static void enum_cached_tree(obs_source_t *source,
+		obs_source_enum_proc_t enum_callback, void *param)
+{
+	struct tree_list list = {0};
+	bool cached;
+
+	if (!source_valid(source)      ||
+	    !source->info.enum_sources ||
+	    source->enum_refs)
+		return;
+
+	obs_source_addref(source);
+
+	cached = acquire_tree_cache(source, &list);
+
+	os_atomic_inc_long(&source->enum_refs);
+
+	if (cached) {
+		for (size_t i = 0; i < source->tree_cache.num; i++)
+			enum_callback(source, source->tree_cache.array[i],
+					param);
+	} else {
+		for (size_t i = 0; i < list.sources.num; i++)
+			enum_callback(source, list.sources.array[i], param);
+	}
+
+	os_atomic_dec_long(&source->enum_refs);
+
+	if (cached)
+		release_tree_cache(source);
+	release_tree_list(&list);
+
+	obs_source_release(source);
+}
+
 void obs_source_destroy(struct obs_source *source)
 {
 	size_t i;
@@ -225,10 +486,16 @@ void obs_source_destroy(struct obs_source *source)
 
 	obs_context_data_remove(&source->context);
 
+	if (source->frames_dropped)
+		blog(LOG_INFO, "source '%s' dropped %"PRIu64" async frames",
+				source->context.name, source->frames_dropped);
+
 	blog(LOG_INFO, "source '%s' destroyed", source->context.name);
 
 	obs_source_dosignal(source, "source_destroy", "destroy");
 
+	free_tree_cache(source);
+
 	if (source->context.data) {
 		source->info.destroy(source->context.data);
 		source->context.data = NULL;
@@ -242,24 +509,40 @@ void obs_source_destroy(struct obs_source *source)
 
 	for (i = 0; i < source->video_frames.num; i++)
 		obs_source_frame_destroy(source->video_frames.array[i]);
+	for (i = 0; i < source->async_cache.num; i++)
+		obs_source_frame_destroy(source->async_cache.array[i]);
 
 	gs_enter_context(obs->video.graphics);
+	for (i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload_slot *slot = &source->async_upload[i];
+		if (slot->mapped)
+			gs_texture_unmap(slot->texture);
+		gs_texture_destroy(slot->texture);
+	}
 	gs_texrender_destroy(source->async_convert_texrender);
 	gs_texture_destroy(source->async_texture);
+	gs_texrender_destroy(source->render_cache);
+	gs_texrender_destroy(source->transition_freeze);
+	for (i = 0; i < GPU_TIMER_FRAMES; i++)
+		gs_timer_destroy(source->gpu_timers[i]);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
 
+	calldata_free(&source->vol_calldata);
+
 	audio_line_destroy(source->audio_line);
 	audio_resampler_destroy(source->resampler);
 
-	gs_texrender_destroy(source->filter_texrender);
 	da_free(source->video_frames);
+	da_free(source->async_cache);
+	da_free(source->audio_cb_list);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->video_mutex);
+	obs_data_release(source->update_state);
 	obs_context_data_free(&source->context);
 	
 	if (source->owns_info_id)
@@ -289,10 +572,10 @@ void obs_source_remove(obs_source_t *source)
 	size_t id;
 	bool   exists;
 
-	pthread_mutex_lock(&data->sources_mutex);
+	pthread_mutex_lock(&data->user_sources_mutex);
 
 	if (!source || source->removed) {
-		pthread_mutex_unlock(&data->sources_mutex);
+		pthread_mutex_unlock(&data->user_sources_mutex);
 		return;
 	}
 
@@ -304,10 +587,11 @@ void obs_source_remove(obs_source_t *source)
 	exists = (id != DARRAY_INVALID);
 	if (exists) {
 		da_erase(data->user_sources, id);
+		obs_user_source_name_remove(source, source->context.name);
 		obs_source_release(source);
 	}
 
-	pthread_mutex_unlock(&data->sources_mutex);
+	pthread_mutex_unlock(&data->user_sources_mutex);
 
 	if (exists)
 		obs_source_dosignal(source, "source_remove", "remove");
@@ -367,37 +651,100 @@ uint32_t obs_source_get_output_flags(const obs_source_t *source)
 	return source ? source->info.output_flags : 0;
 }
 
+static inline bool has_update(const struct obs_source *source)
+{
+	return source->info.update || source->info.update_diff;
+}
+
+static void call_update(obs_source_t *source)
+{
+	obs_data_t *changed;
+
+	if (!source->context.data)
+		return;
+
+	if (!source->info.update_diff) {
+		if (source->info.update)
+			source->info.update(source->context.data,
+					source->context.settings);
+		return;
+	}
+
+	changed = obs_data_create();
+	obs_data_get_changes(source->context.settings, source->update_state,
+			changed);
+	source->info.update_diff(source->context.data,
+			source->context.settings, changed);
+	obs_data_release(changed);
+}
+
 static void obs_source_deferred_update(obs_source_t *source)
 {
-	if (source->context.data && source->info.update)
-		source->info.update(source->context.data,
-				source->context.settings);
+	call_update(source);
 
 	source->defer_update = false;
+	source->video_dirty  = true;
+}
+
+static void obs_source_queued_update(void *param)
+{
+	obs_source_t *source = param;
+
+	/* changes made while updating queue another update */
+	os_atomic_set_long(&source->update_queued, 0);
+
+	call_update(source);
+
+	source->video_dirty = true;
+	obs_source_release(source);
+}
+
+/* async and audio-only sources don't have their plugin code called by the
+ * video thread, so their updates (which often reopen a device) can run on
+ * the update worker rather than blocking the caller.  any number of updates
+ * made before the worker gets to the source are applied with a single call */
+static void queue_source_update(obs_source_t *source)
+{
+	if (!obs->data.update_pool) {
+		obs_source_deferred_update(source);
+		return;
+	}
+
+	if (os_atomic_exchange_long(&source->update_queued, 1) != 0)
+		return;
+
+	obs_source_addref(source);
+	task_pool_submit(obs->data.update_pool, obs_source_queued_update,
+			source);
 }
 
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
 {
+	uint32_t flags;
+
 	if (!source) return;
 
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
-	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
+	flags = source->info.output_flags;
+
+	if ((flags & OBS_SOURCE_VIDEO) != 0 &&
+	    (flags & OBS_SOURCE_ASYNC) == 0) {
 		source->defer_update = true;
-	} else if (source->context.data && source->info.update) {
-		source->info.update(source->context.data,
-				source->context.settings);
+	} else if (source->context.data && has_update(source)) {
+		queue_source_update(source);
 	}
 }
 
 void obs_source_update_properties(obs_source_t *source)
 {
+	uint8_t stack[CALLDATA_FIXED_SIZE];
 	calldata_t calldata;
 
 	if (!source) return;
 
-	calldata_init(&calldata);
+	calldata_init_fixed(&calldata, stack, sizeof(stack));
 	calldata_set_ptr(&calldata, "source", source);
 
 	signal_handler_signal(obs_source_get_signal_handler(source),
@@ -478,6 +825,8 @@ void obs_source_send_key_click(obs_source_t *source,
 
 static void activate_source(obs_source_t *source)
 {
+	obs_source_instantiate(source);
+
 	if (source->context.data && source->info.activate)
 		source->info.activate(source->context.data);
 	obs_source_dosignal(source, "source_activate", "activate");
@@ -492,6 +841,8 @@ static void deactivate_source(obs_source_t *source)
 
 static void show_source(obs_source_t *source)
 {
+	obs_source_instantiate(source);
+
 	if (source->context.data && source->info.show)
 		source->info.show(source->context.data);
 	obs_source_dosignal(source, "source_show", "show");
@@ -548,13 +899,13 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 
 	if (os_atomic_inc_long(&source->show_refs) == 1) {
 		show_source(source);
-		obs_source_enum_tree(source, show_tree, NULL);
+		enum_cached_tree(source, show_tree, NULL);
 	}
 
 	if (type == MAIN_VIEW) {
 		if (os_atomic_inc_long(&source->activate_refs) == 1) {
 			activate_source(source);
-			obs_source_enum_tree(source, activate_tree, NULL);
+			enum_cached_tree(source, activate_tree, NULL);
 			obs_source_set_present_volume(source, 1.0f);
 		}
 	}
@@ -566,33 +917,67 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 
 	if (os_atomic_dec_long(&source->show_refs) == 0) {
 		hide_source(source);
-		obs_source_enum_tree(source, hide_tree, NULL);
+		enum_cached_tree(source, hide_tree, NULL);
 	}
 
 	if (type == MAIN_VIEW) {
 		if (os_atomic_dec_long(&source->activate_refs) == 0) {
 			deactivate_source(source);
-			obs_source_enum_tree(source, deactivate_tree, NULL);
+			enum_cached_tree(source, deactivate_tree, NULL);
 			obs_source_set_present_volume(source, 0.0f);
 		}
 	}
 }
 
+static inline bool obs_source_suspended(const obs_source_t *source)
+{
+	return (source->info.output_flags & OBS_SOURCE_SUSPEND_WHEN_HIDDEN) &&
+		os_atomic_load_long(&source->show_refs) == 0;
+}
+
+void obs_source_inc_showing(obs_source_t *source)
+{
+	obs_source_activate(source, AUX_VIEW);
+}
+
+void obs_source_dec_showing(obs_source_t *source)
+{
+	obs_source_deactivate(source, AUX_VIEW);
+}
+
 void obs_source_video_tick(obs_source_t *source, float seconds)
 {
+	uint64_t start_ns;
+	bool     dirty;
+
 	if (!source) return;
 
+	start_ns = os_gettime_ns();
+
 	if (source->defer_update)
 		obs_source_deferred_update(source);
 
-	/* reset the filter render texture information once every frame */
-	if (source->filter_texrender)
-		gs_texrender_reset(source->filter_texrender);
-
-	if (source->context.data && source->info.video_tick)
+	if (source->context.data && source->info.video_tick &&
+	    !obs_source_suspended(source))
 		source->info.video_tick(source->context.data, seconds);
 
+	/* async sources may get new frames at any time */
+	dirty = source->video_dirty ||
+		(source->info.output_flags & OBS_SOURCE_ASYNC) != 0;
+	source->video_dirty     = false;
+	source->video_unchanged = !dirty && source->context.data &&
+		source->info.video_unchanged &&
+		source->info.video_unchanged(source->context.data);
+
 	source->async_rendered = false;
+
+	/* ticking starts a new frame, so this is where the render time of the
+	 * previous frame is complete */
+	source->avg_render_ns = update_avg_ns(source->avg_render_ns,
+			source->cur_render_ns);
+	source->cur_render_ns = 0;
+	source->avg_tick_ns   = update_avg_ns(source->avg_tick_ns,
+			os_gettime_ns() - start_ns);
 }
 
 /* unless the value is 3+ hours worth of frames, this won't overflow */
@@ -627,6 +1012,66 @@ static inline void handle_ts_jump(obs_source_t *source, uint64_t expected,
 		reset_audio_timing(source, ts, os_time);
 }
 
+/* returns the sum of the squared samples, and the largest squared sample */
+static inline float calc_sum_max_pow2(const float *array, size_t count,
+		float *max_out)
+{
+	float  sum_val = 0.0f;
+	float  max_val = 0.0f;
+	size_t i       = 0;
+
+#if defined(SIMD_SSE2)
+	__m128 sum4 = _mm_setzero_ps();
+	__m128 max4 = _mm_setzero_ps();
+	float  sums[4], maxes[4];
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(array + i);
+		val  = _mm_mul_ps(val, val);
+		sum4 = _mm_add_ps(sum4, val);
+		max4 = _mm_max_ps(max4, val);
+	}
+
+	_mm_storeu_ps(sums,  sum4);
+	_mm_storeu_ps(maxes, max4);
+
+	for (size_t j = 0; j < 4; j++) {
+		sum_val += sums[j];
+		max_val  = (max_val > maxes[j]) ? max_val : maxes[j];
+	}
+
+#elif defined(SIMD_NEON)
+	float32x4_t sum4 = vdupq_n_f32(0.0f);
+	float32x4_t max4 = vdupq_n_f32(0.0f);
+	float       sums[4], maxes[4];
+
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t val = vld1q_f32(array + i);
+		val  = vmulq_f32(val, val);
+		sum4 = vaddq_f32(sum4, val);
+		max4 = vmaxq_f32(max4, val);
+	}
+
+	vst1q_f32(sums,  sum4);
+	vst1q_f32(maxes, max4);
+
+	for (size_t j = 0; j < 4; j++) {
+		sum_val += sums[j];
+		max_val  = (max_val > maxes[j]) ? max_val : maxes[j];
+	}
+#endif
+
+	for (; i < count; i++) {
+		float val_pow2 = array[i] * array[i];
+
+		sum_val += val_pow2;
+		max_val  = (max_val > val_pow2) ? max_val : val_pow2;
+	}
+
+	*max_out = max_val;
+	return sum_val;
+}
+
 static void calc_volume_levels(struct obs_source *source, float *array,
 		size_t frames, float volume)
 {
@@ -641,13 +1086,10 @@ static void calc_volume_levels(struct obs_source *source, float *array,
 	const size_t   vol_peak_delay = sample_rate * 3;
 	const float    alpha          = 0.15f;
 
-	for (size_t i = 0; i < count; i++) {
-		float val      = array[i];
-		float val_pow2 = val * val;
+	if (!count)
+		return;
 
-		sum_val += val_pow2;
-		max_val  = (max_val > val_pow2) ? max_val : val_pow2;
-	}
+	sum_val = calc_sum_max_pow2(array, count, &max_val);
 
 	/*
 	  We want the volume meters scale linearly in respect to current
@@ -674,29 +1116,61 @@ static void calc_volume_levels(struct obs_source *source, float *array,
 	}
 
 	source->vol_mag = alpha * rms_val + source->vol_mag * (1.0f - alpha);
+
+	if (source->vol_max > source->vol_report_max)
+		source->vol_report_max = source->vol_max;
+}
+
+static inline bool volume_level_update_due(struct obs_source *source,
+		uint64_t timestamp)
+{
+	uint32_t rate = obs->audio.level_update_rate;
+	uint64_t interval;
+
+	if (!rate)
+		return true;
+
+	interval = 1000000000ULL / rate;
+
+	/* also handles timestamp jumps backwards */
+	if (timestamp < source->vol_last_update ||
+	    timestamp - source->vol_last_update >= interval) {
+		source->vol_last_update = timestamp;
+		return true;
+	}
+
+	return false;
 }
 
-/* TODO update peak/etc later */
+/*
+ * Levels are calculated for every audio packet, but are only signalled at the
+ * configured level update rate.  The highest level since the last update is
+ * reported so short transients still show up on meters, and the calldata is
+ * kept with the source so signalling doesn't allocate each time.
+ */
 static void obs_source_update_volume_level(obs_source_t *source,
 		struct audio_data *in)
 {
 	if (source && in) {
-		struct calldata data = {0};
+		struct calldata *data = &source->vol_calldata;
 
 		calc_volume_levels(source, (float*)in->data[0], in->frames,
 				in->volume);
 
-		calldata_set_ptr  (&data, "source",    source);
-		calldata_set_float(&data, "level",     source->vol_max);
-		calldata_set_float(&data, "magnitude", source->vol_mag);
-		calldata_set_float(&data, "peak",      source->vol_peak);
+		if (!volume_level_update_due(source, os_gettime_ns()))
+			return;
+
+		calldata_set_ptr  (data, "source",    source);
+		calldata_set_float(data, "level",     source->vol_report_max);
+		calldata_set_float(data, "magnitude", source->vol_mag);
+		calldata_set_float(data, "peak",      source->vol_peak);
+
+		source->vol_report_max = 0.0f;
 
 		signal_handler_signal(source->context.signals, "volume_level",
-				&data);
+				data);
 		signal_handler_signal(obs->signals, "source_volume_level",
-				&data);
-
-		calldata_free(&data);
+				data);
 	}
 }
 
@@ -739,6 +1213,11 @@ static void source_output_audio_line(obs_source_t *source,
 	in.volume = source->user_volume * source->present_volume *
 		obs->audio.user_volume * obs->audio.present_volume;
 
+	for (size_t i = 0; i < source->audio_cb_list.num; i++) {
+		struct audio_cb_info *info = source->audio_cb_list.array + i;
+		info->callback(info->param, source, &in);
+	}
+
 	audio_line_output(source->audio_line, &in);
 	obs_source_update_volume_level(source, &in);
 }
@@ -795,7 +1274,21 @@ static inline bool set_planar420_sizes(struct obs_source *source,
 	source->async_texture_format  = GS_R8;
 	source->async_plane_offset[0] = frame->width * frame->height;
 	source->async_plane_offset[1] = source->async_plane_offset[0] +
-		frame->width * frame->height / 4;
+		frame->width / 2 * ((frame->height + 1) / 2);
+	return true;
+}
+
+static inline bool set_nv12_sizes(struct obs_source *source,
+		struct obs_source_frame *frame)
+{
+	uint32_t size = frame->width * frame->height;
+	size += size/2;
+
+	source->async_convert_width   = frame->width;
+	source->async_convert_height  = (size / frame->width + 1) & 0xFFFFFFFE;
+	source->async_texture_format  = GS_R8;
+	source->async_plane_offset[0] = frame->width * frame->height;
+	source->async_plane_offset[1] = 0;
 	return true;
 }
 
@@ -811,9 +1304,7 @@ static inline bool init_gpu_conversion(struct obs_source *source,
 			return set_planar420_sizes(source, frame);
 
 		case CONVERT_NV12:
-			assert(false && "NV12 not yet implemented");
-			/* TODO: implement conversion */
-			break;
+			return set_nv12_sizes(source, frame);
 
 		case CONVERT_NONE:
 			assert(false && "No conversion requested");
@@ -834,6 +1325,84 @@ static inline enum gs_color_format convert_video_format(
 	return GS_BGRX;
 }
 
+extern char *find_libobs_data_file(const char *file);
+
+static gs_effect_t *compile_conversion_variant(
+		const struct obs_conversion_variant *var)
+{
+	char *filename = find_libobs_data_file("format_conversion.effect");
+	char *file_string = NULL;
+	struct dstr effect_string = {0};
+	gs_effect_t *effect = NULL;
+
+	if (filename)
+		file_string = os_quick_read_utf8_file(filename);
+	if (!file_string)
+		goto exit;
+
+	/* all of the sizes are integers, which also keeps the locale's
+	 * decimal separator out of the printed values */
+	dstr_printf(&effect_string,
+			"#define FIXED_SIZE\n"
+			"#define FIXED_WIDTH %u.0\n"
+			"#define FIXED_HEIGHT %u.0\n"
+			"#define FIXED_INPUT_WIDTH %u.0\n"
+			"#define FIXED_INPUT_HEIGHT %u.0\n"
+			"#define FIXED_U_PLANE_OFFSET %d.0\n"
+			"#define FIXED_V_PLANE_OFFSET %d.0\n",
+			var->width, var->height,
+			var->input_width, var->input_height,
+			var->plane_offset[0], var->plane_offset[1]);
+	dstr_cat(&effect_string, file_string);
+
+	effect = gs_effect_create(effect_string.array, filename, NULL);
+	if (!effect)
+		blog(LOG_WARNING, "Failed to compile the format conversion "
+		                  "effect for %ux%u, using the generic one",
+		                  var->width, var->height);
+
+exit:
+	dstr_free(&effect_string);
+	bfree(file_string);
+	bfree(filename);
+	return effect;
+}
+
+/*
+ * The conversion effect is compiled once for each frame size in use, so that
+ * the sizes are constants in the shaders rather than parameters.  The
+ * variants are kept until the graphics are freed.
+ */
+static gs_effect_t *get_conversion_effect(const struct obs_source *source)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_conversion_variant var = {0};
+
+	var.width           = source->async_width;
+	var.height          = source->async_height;
+	var.input_width     = source->async_convert_width;
+	var.input_height    = source->async_convert_height;
+	var.plane_offset[0] = source->async_plane_offset[0];
+	var.plane_offset[1] = source->async_plane_offset[1];
+
+	for (size_t i = 0; i < video->conversion_variants.num; i++) {
+		struct obs_conversion_variant *cur =
+			video->conversion_variants.array + i;
+
+		if (cur->width           == var.width &&
+		    cur->height          == var.height &&
+		    cur->input_width     == var.input_width &&
+		    cur->input_height    == var.input_height &&
+		    cur->plane_offset[0] == var.plane_offset[0] &&
+		    cur->plane_offset[1] == var.plane_offset[1])
+			return cur->effect;
+	}
+
+	var.effect = compile_conversion_variant(&var);
+	da_push_back(video->conversion_variants, &var);
+	return var.effect;
+}
+
 static inline bool set_async_texture_size(struct obs_source *source,
 		struct obs_source_frame *frame)
 {
@@ -878,26 +1447,75 @@ static inline bool set_async_texture_size(struct obs_source *source,
 
 	source->async_width  = frame->width;
 	source->async_height = frame->height;
+
+	source->async_conversion_effect = source->async_gpu_conversion ?
+		get_conversion_effect(source) : NULL;
 	return true;
 }
 
-static void upload_raw_frame(gs_texture_t *tex,
-		const struct obs_source_frame *frame)
+/*
+ * Planar frames are uploaded as one continuous stream of bytes, with the
+ * planes directly following each other, which is what the conversion shaders
+ * expect.  Copying the planes row by row also handles frames that have padded
+ * lines or planes that aren't contiguous in memory.
+ */
+static inline void copy_plane(uint8_t *dst, uint32_t dst_linesize,
+		uint32_t tex_width, size_t *pos, const uint8_t *src,
+		uint32_t src_linesize, uint32_t row_size, uint32_t rows)
 {
-	switch (get_convert_type(frame->format)) {
-		case CONVERT_422_U:
-		case CONVERT_422_Y:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->linesize[0], false);
-			break;
+	for (uint32_t y = 0; y < rows; y++) {
+		size_t offset = *pos;
+		memcpy(dst + (offset / tex_width) * dst_linesize +
+				offset % tex_width,
+				src + y * src_linesize, row_size);
+		*pos += row_size;
+	}
+}
 
-		case CONVERT_420:
+static void upload_planar_frame(gs_texture_t *tex,
+		const struct obs_source_frame *frame, bool interleaved_chroma)
+{
+	uint32_t width       = frame->width;
+	uint32_t half_height = (frame->height + 1) / 2;
+	uint32_t linesize;
+	uint8_t  *ptr;
+	size_t   pos = 0;
+
+	if (!gs_texture_map(tex, &ptr, &linesize))
+		return;
+
+	copy_plane(ptr, linesize, width, &pos, frame->data[0],
+			frame->linesize[0], width, frame->height);
+
+	if (interleaved_chroma) {
+		copy_plane(ptr, linesize, width, &pos, frame->data[1],
+				frame->linesize[1], width, half_height);
+	} else {
+		copy_plane(ptr, linesize, width, &pos, frame->data[1],
+				frame->linesize[1], width / 2, half_height);
+		copy_plane(ptr, linesize, width, &pos, frame->data[2],
+				frame->linesize[2], width / 2, half_height);
+	}
+
+	gs_texture_unmap(tex);
+}
+
+static void upload_raw_frame(gs_texture_t *tex,
+		const struct obs_source_frame *frame)
+{
+	switch (get_convert_type(frame->format)) {
+		case CONVERT_422_U:
+		case CONVERT_422_Y:
 			gs_texture_set_image(tex, frame->data[0],
-					frame->width, false);
+					frame->linesize[0], false);
+			break;
+
+		case CONVERT_420:
+			upload_planar_frame(tex, frame, false);
 			break;
 
 		case CONVERT_NV12:
-			assert(false && "Conversion not yet implemented");
+			upload_planar_frame(tex, frame, true);
 			break;
 
 		case CONVERT_NONE:
@@ -922,8 +1540,7 @@ static const char *select_conversion_technique(enum video_format format)
 			return "I420_Reverse";
 
 		case VIDEO_FORMAT_NV12:
-			assert(false && "Conversion not yet implemented");
-			break;
+			return "NV12_Reverse";
 
 		case VIDEO_FORMAT_BGRA:
 		case VIDEO_FORMAT_BGRX:
@@ -935,41 +1552,212 @@ static const char *select_conversion_technique(enum video_format format)
 	return NULL;
 }
 
-static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
+static void get_async_texture_size(enum video_format format,
+		uint32_t width, uint32_t height, uint32_t *cx, uint32_t *cy,
+		enum gs_color_format *color_format)
 {
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
-	gs_effect_set_float(param, val);
+	switch (get_convert_type(format)) {
+		case CONVERT_422_U:
+		case CONVERT_422_Y:
+			*cx           = width / 2;
+			*cy           = height;
+			*color_format = GS_BGRA;
+			break;
+
+		case CONVERT_420:
+		case CONVERT_NV12:
+			*cx           = width;
+			*cy           = ((width * height + width * height / 2) /
+					width + 1) & 0xFFFFFFFE;
+			*color_format = GS_R8;
+			break;
+
+		case CONVERT_NONE:
+			*cx           = width;
+			*cy           = height;
+			*color_format = convert_video_format(format);
+			break;
+	}
 }
 
-static bool update_async_texrender(struct obs_source *source,
+/* called with video_mutex locked */
+static void async_upload_release(void *param, struct obs_source_frame *frame)
+{
+	struct async_upload_slot *slot = param;
+
+	/* frames that were dropped before being rendered are still mapped and
+	 * can be handed out again right away */
+	if (slot->state == ASYNC_UPLOAD_ACQUIRED)
+		slot->state = ASYNC_UPLOAD_MAPPED;
+
+	UNUSED_PARAMETER(frame);
+}
+
+static inline struct async_upload_slot *get_async_upload_slot(
 		const struct obs_source_frame *frame)
 {
-	gs_texture_t   *tex       = source->async_texture;
-	gs_texrender_t *texrender = source->async_convert_texrender;
+	return frame->release == async_upload_release ?
+		frame->release_param : NULL;
+}
 
-	gs_texrender_reset(texrender);
+static bool map_async_upload_slot(struct async_upload_slot *slot,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = &slot->frame;
+	uint32_t linesize;
+	uint8_t  *ptr;
 
-	upload_raw_frame(tex, frame);
+	if (!gs_texture_map(slot->texture, &ptr, &linesize))
+		return false;
 
-	uint32_t cx = source->async_width;
-	uint32_t cy = source->async_height;
+	memset(frame, 0, sizeof(*frame));
+	frame->format        = format;
+	frame->width         = width;
+	frame->height        = height;
+	frame->release       = async_upload_release;
+	frame->release_param = slot;
 
-	float convert_width  = (float)source->async_convert_width;
-	float convert_height = (float)source->async_convert_height;
+	switch (get_convert_type(format)) {
+		case CONVERT_420:
+		case CONVERT_NV12:
+			/* the planes directly follow each other in the texture,
+			 * which only works if its lines aren't padded */
+			if (linesize != width) {
+				gs_texture_unmap(slot->texture);
+				return false;
+			}
+
+			frame->data[0]     = ptr;
+			frame->data[1]     = ptr + width * height;
+			frame->linesize[0] = width;
+
+			if (format == VIDEO_FORMAT_NV12) {
+				frame->linesize[1] = width;
+			} else {
+				frame->linesize[1] = width / 2;
+				frame->linesize[2] = width / 2;
+				frame->data[2]     = frame->data[1] +
+					width / 2 * ((height + 1) / 2);
+			}
+			break;
 
-	gs_effect_t *conv = obs->video.conversion_effect;
-	gs_technique_t *tech = gs_effect_get_technique(conv,
-			select_conversion_technique(frame->format));
+		case CONVERT_422_U:
+		case CONVERT_422_Y:
+		case CONVERT_NONE:
+			frame->data[0]     = ptr;
+			frame->linesize[0] = linesize;
+			break;
+	}
 
-	if (!gs_texrender_begin(texrender, cx, cy))
-		return false;
+	return true;
+}
 
-	gs_technique_begin(tech);
-	gs_technique_begin_pass(tech, 0);
+/*
+ * Maps the upload slots that aren't in use, so that the next frames of the
+ * source can be written straight into them.  Mapping and unmapping is done
+ * without holding video_mutex, a slot that is unmapped can only be touched by
+ * the graphics thread.
+ */
+static void update_async_upload(struct obs_source *source)
+{
+	enum gs_color_format color_format;
+	enum video_format    format;
+	uint32_t             width, height, cx, cy;
+	bool                 failed;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+	format = source->async_upload_format;
+	width  = source->async_upload_width;
+	height = source->async_upload_height;
+	failed = source->async_upload_failed;
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
+
+	if (format == VIDEO_FORMAT_NONE || !width || !height || failed)
+		return;
+
+	get_async_texture_size(format, width, height, &cx, &cy, &color_format);
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload_slot *slot = &source->async_upload[i];
+		bool matches = slot->texture &&
+			slot->frame.format == format &&
+			slot->frame.width  == width  &&
+			slot->frame.height == height;
+
+		os_mutex_lock(&source->video_mutex, "video_mutex");
+		if (slot->state == ASYNC_UPLOAD_MAPPED && !matches)
+			slot->state = ASYNC_UPLOAD_UNMAPPED;
+		failed = slot->state != ASYNC_UPLOAD_UNMAPPED;
+		os_mutex_unlock(&source->video_mutex, "video_mutex");
+
+		if (failed)
+			continue;
+
+		if (slot->mapped) {
+			gs_texture_unmap(slot->texture);
+			slot->mapped = false;
+		}
+
+		if (!matches) {
+			gs_texture_destroy(slot->texture);
+			slot->texture = gs_texture_create(cx, cy, color_format,
+					1, NULL, GS_DYNAMIC);
+		}
+
+		if (!slot->texture ||
+		    !map_async_upload_slot(slot, format, width, height)) {
+			blog(LOG_DEBUG, "Direct upload not available for "
+			                "source '%s'", source->context.name);
+
+			os_mutex_lock(&source->video_mutex, "video_mutex");
+			source->async_upload_failed = true;
+			os_mutex_unlock(&source->video_mutex, "video_mutex");
+			break;
+		}
 
-	gs_effect_set_texture(gs_effect_get_param_by_name(conv, "image"), tex);
-	set_eparam(conv, "width",  (float)cx);
-	set_eparam(conv, "height", (float)cy);
+		slot->mapped = true;
+
+		os_mutex_lock(&source->video_mutex, "video_mutex");
+		slot->state = ASYNC_UPLOAD_MAPPED;
+		os_mutex_unlock(&source->video_mutex, "video_mutex");
+	}
+}
+
+/* unmapping the slot uploads the frame, its texture then becomes the async
+ * texture of the source and the previous one is mapped again later */
+static void use_async_upload(struct obs_source *source,
+		struct async_upload_slot *slot)
+{
+	gs_texture_t *tex = slot->texture;
+
+	gs_texture_unmap(tex);
+	slot->mapped  = false;
+	slot->texture = source->async_texture;
+	source->async_texture = tex;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+	slot->state = ASYNC_UPLOAD_UNMAPPED;
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
+}
+
+static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
+{
+	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
+	gs_effect_set_float(param, val);
+}
+
+/* only needed by the generic conversion effect, the variants have the sizes
+ * compiled in */
+static void set_conversion_params(gs_effect_t *conv,
+		const struct obs_source *source)
+{
+	float cx             = (float)source->async_width;
+	float cy             = (float)source->async_height;
+	float convert_width  = (float)source->async_convert_width;
+	float convert_height = (float)source->async_convert_height;
+
+	set_eparam(conv, "width",  cx);
+	set_eparam(conv, "height", cy);
 	set_eparam(conv, "width_i",  1.0f / cx);
 	set_eparam(conv, "height_i", 1.0f / cy);
 	set_eparam(conv, "width_d2",  cx * 0.5f);
@@ -986,6 +1774,43 @@ static bool update_async_texrender(struct obs_source *source,
 			(float)source->async_plane_offset[0]);
 	set_eparam(conv, "v_plane_offset",
 			(float)source->async_plane_offset[1]);
+}
+
+static bool update_async_texrender(struct obs_source *source,
+		const struct obs_source_frame *frame, bool upload)
+{
+	gs_texture_t   *tex       = source->async_texture;
+	gs_texrender_t *texrender = source->async_convert_texrender;
+
+	gs_texrender_reset(texrender);
+
+	if (upload)
+		upload_raw_frame(tex, frame);
+
+	uint32_t cx = source->async_width;
+	uint32_t cy = source->async_height;
+
+	gs_effect_t *conv = source->async_conversion_effect;
+	if (!conv)
+		conv = obs->video.conversion_effect;
+
+	gs_technique_t *tech = gs_effect_get_technique(conv,
+			select_conversion_technique(frame->format));
+
+	if (!gs_texrender_begin(texrender, cx, cy))
+		return false;
+
+	gs_technique_begin(tech);
+	gs_technique_begin_pass(tech, 0);
+
+	if (conv == obs->video.conversion_effect) {
+		gs_effect_set_texture(obs->video.conversion_image, tex);
+		set_conversion_params(conv, source);
+	} else {
+		gs_effect_set_texture(
+				gs_effect_get_param_by_name(conv, "image"),
+				tex);
+	}
 
 	gs_ortho(0.f, (float)cx, 0.f, (float)cy, -100.f, 100.f);
 
@@ -1005,6 +1830,7 @@ static bool update_async_texture(struct obs_source *source,
 	gs_texture_t      *tex       = source->async_texture;
 	gs_texrender_t    *texrender = source->async_convert_texrender;
 	enum convert_type type      = get_convert_type(frame->format);
+	struct async_upload_slot *slot = get_async_upload_slot(frame);
 	uint8_t           *ptr;
 	uint32_t          linesize;
 
@@ -1018,8 +1844,14 @@ static bool update_async_texture(struct obs_source *source,
 	memcpy(source->async_color_range_max, frame->color_range_max,
 			sizeof frame->color_range_max);
 
+	if (slot)
+		use_async_upload(source, slot);
+
 	if (source->async_gpu_conversion && texrender)
-		return update_async_texrender(source, frame);
+		return update_async_texrender(source, frame, !slot);
+
+	if (slot)
+		return true;
 
 	if (type == CONVERT_NONE) {
 		gs_texture_set_image(tex, frame->data[0], frame->linesize[0],
@@ -1079,7 +1911,10 @@ static inline void obs_source_draw_texture(struct obs_source *source,
 		gs_effect_set_val(param, color_matrix, sizeof(float) * 16);
 	}
 
-	param = gs_effect_get_param_by_name(effect, "image");
+	if (effect == obs->video.default_effect)
+		param = obs->video.default_image;
+	else
+		param = gs_effect_get_param_by_name(effect, "image");
 	gs_effect_set_texture(param, tex);
 
 	gs_draw_sprite(tex, source->async_flip ? GS_FLIP_V : 0, 0, 0);
@@ -1090,13 +1925,13 @@ static void obs_source_draw_async_texture(struct obs_source *source)
 	gs_effect_t    *effect        = gs_get_effect();
 	bool           yuv           = format_is_yuv(source->async_format);
 	bool           limited_range = yuv && !source->async_full_range;
-	const char     *type         = yuv ? "DrawMatrix" : "Draw";
 	bool           def_draw      = (!effect);
 	gs_technique_t *tech          = NULL;
 
 	if (def_draw) {
-		effect = obs_get_default_effect();
-		tech = gs_effect_get_technique(effect, type);
+		effect = obs->video.default_effect;
+		tech = yuv ? obs->video.default_draw_matrix :
+			obs->video.default_draw;
 		gs_technique_begin(tech);
 		gs_technique_begin_pass(tech, 0);
 	}
@@ -1115,15 +1950,14 @@ static void obs_source_draw_async_texture(struct obs_source *source)
 static void obs_source_render_async_video(obs_source_t *source)
 {
 	if (!source->async_rendered) {
-		struct obs_source_frame *frame = obs_source_get_frame(source);
+		struct obs_source_frame *frame;
+
+		update_async_upload(source);
+		frame = obs_source_get_frame(source);
 
 		source->async_rendered = true;
-		if (frame) {
-			if (!set_async_texture_size(source, frame))
-				return;
-			if (!update_async_texture(source, frame))
-				return;
-		}
+		if (frame && set_async_texture_size(source, frame))
+			update_async_texture(source, frame);
 
 		obs_source_release_frame(source, frame);
 	}
@@ -1143,8 +1977,8 @@ static inline void obs_source_default_render(obs_source_t *source,
 		bool color_matrix)
 {
 	gs_effect_t    *effect     = obs->video.default_effect;
-	const char     *tech_name = color_matrix ? "DrawMatrix" : "Draw";
-	gs_technique_t *tech       = gs_effect_get_technique(effect, tech_name);
+	gs_technique_t *tech       = color_matrix ?
+		obs->video.default_draw_matrix : obs->video.default_draw;
 	size_t         passes, i;
 
 	passes = gs_technique_begin(tech);
@@ -1157,6 +1991,8 @@ static inline void obs_source_default_render(obs_source_t *source,
 	gs_technique_end(tech);
 }
 
+static bool render_fused_filters(obs_source_t *filter);
+
 static inline void obs_source_main_render(obs_source_t *source)
 {
 	uint32_t flags      = source->info.output_flags;
@@ -1166,6 +2002,9 @@ static inline void obs_source_main_render(obs_source_t *source)
 	                      source->filters.num == 0 &&
 	                      !custom_draw;
 
+	if (source->filter_parent && render_fused_filters(source))
+		return;
+
 	if (default_effect)
 		obs_source_default_render(source, color_matrix);
 	else if (source->context.data)
@@ -1173,10 +2012,8 @@ static inline void obs_source_main_render(obs_source_t *source)
 				custom_draw ? NULL : gs_get_effect());
 }
 
-void obs_source_video_render(obs_source_t *source)
+static inline void render_source_video(obs_source_t *source)
 {
-	if (!source_valid(source)) return;
-
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
@@ -1190,6 +2027,221 @@ void obs_source_video_render(obs_source_t *source)
 		obs_source_render_async_video(source);
 }
 
+static inline void collect_gpu_time(obs_source_t *source, size_t slot)
+{
+	struct obs_core_video *video = &obs->video;
+	uint64_t ticks;
+
+	if (!source->gpu_timers_used[slot])
+		return;
+
+	source->gpu_timers_used[slot] = false;
+
+	if (video->gpu_timing_valid &&
+	    gs_timer_get_data(source->gpu_timers[slot], &ticks))
+		source->avg_gpu_ns = update_avg_ns(source->avg_gpu_ns,
+				(uint64_t)((double)ticks * 1000000000.0 /
+				(double)video->gpu_timer_frequency));
+}
+
+/* only the first render of a source each frame is timed on the GPU, GPU
+ * timers can't be read back right away and there's no telling how many
+ * times a source will be rendered in a frame */
+static bool begin_gpu_timer(obs_source_t *source)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t slot = (size_t)(video->gpu_timer_frame % GPU_TIMER_FRAMES);
+
+	if (!video->gpu_range_active ||
+	    source->gpu_timer_frame == video->gpu_timer_frame)
+		return false;
+
+	source->gpu_timer_frame = video->gpu_timer_frame;
+	collect_gpu_time(source, slot);
+
+	if (!source->gpu_timers[slot])
+		source->gpu_timers[slot] = gs_timer_create();
+	if (!source->gpu_timers[slot])
+		return false;
+
+	gs_timer_begin(source->gpu_timers[slot]);
+	return true;
+}
+
+static inline void end_gpu_timer(obs_source_t *source)
+{
+	size_t slot = (size_t)(obs->video.gpu_timer_frame % GPU_TIMER_FRAMES);
+
+	gs_timer_end(source->gpu_timers[slot]);
+	source->gpu_timers_used[slot] = true;
+}
+
+/* sources can only be drawn from the cache where nothing else decides how
+ * they're drawn, filters and sources drawn with an effect are excluded */
+static inline bool can_cache_render(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	return (flags & OBS_SOURCE_VIDEO) != 0 &&
+		(flags & OBS_SOURCE_NO_RENDER_CACHE) == 0 &&
+		!source->filter_parent && !gs_get_effect();
+}
+
+/* sources are kept in the cache for a while after they were last drawn more
+ * than once, so a display that redraws less often than every frame (a
+ * multiview, for example) still finds them cached */
+#define RENDER_CACHE_HOLD_FRAMES 30
+
+/* returns whether the source is drawn more than once a frame, going by this
+ * frame and the last few */
+static bool update_render_count(obs_source_t *source)
+{
+	uint64_t frame = obs->video.render_frame;
+
+	if (source->render_count_frame != frame) {
+		source->render_count       = 0;
+		source->render_count_frame = frame;
+	}
+
+	if (++source->render_count > 1)
+		source->multi_render_frame = frame;
+
+	return source->multi_render_frame &&
+		frame - source->multi_render_frame <= RENDER_CACHE_HOLD_FRAMES;
+}
+
+/* renders the source in to its cache unless it already was this frame */
+static gs_texture_t *get_render_cache_texture(obs_source_t *source,
+		uint32_t cx, uint32_t cy)
+{
+	uint64_t frame = obs->video.render_frame;
+
+	if (!source->render_cache)
+		source->render_cache = gs_texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	if (source->render_cache_frame != frame) {
+		struct vec4 clear_color;
+
+		gs_texrender_reset(source->render_cache);
+		if (!gs_texrender_begin(source->render_cache, cx, cy))
+			return NULL;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		render_source_video(source);
+
+		gs_texrender_end(source->render_cache);
+		source->render_cache_frame = frame;
+	}
+
+	return gs_texrender_get_texture(source->render_cache);
+}
+
+static bool render_cached(obs_source_t *source)
+{
+	uint32_t       cx     = obs_source_get_width(source);
+	uint32_t       cy     = obs_source_get_height(source);
+	gs_effect_t    *effect = obs->video.default_effect;
+	gs_technique_t *tech;
+	gs_texture_t   *tex;
+	size_t         passes;
+
+	if (!cx || !cy)
+		return false;
+
+	tex = get_render_cache_texture(source, cx, cy);
+	if (!tex)
+		return false;
+
+	tech = gs_effect_get_technique(effect, "Draw");
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			tex);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(tex, 0, cx, cy);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	return true;
+}
+
+void obs_source_video_render(obs_source_t *source)
+{
+	uint64_t start_ns;
+	bool     gpu_timed;
+
+	if (!source_valid(source)) return;
+
+	/* a source renders itself again through its own filters, only the
+	 * outermost call is accounted for */
+	if (source->render_depth++) {
+		render_source_video(source);
+		source->render_depth--;
+		return;
+	}
+
+	start_ns  = os_gettime_ns();
+	gpu_timed = begin_gpu_timer(source);
+
+	if (!can_cache_render(source) || !update_render_count(source) ||
+	    !render_cached(source))
+		render_source_video(source);
+
+	if (gpu_timed)
+		end_gpu_timer(source);
+
+	source->cur_render_ns += os_gettime_ns() - start_ns;
+	source->render_depth--;
+}
+
+gs_texture_t *obs_source_get_frame_texture(obs_source_t *source)
+{
+	uint32_t     cx, cy;
+	uint64_t     start_ns;
+	gs_texture_t *tex;
+
+	if (!source_valid(source) || !can_cache_render(source))
+		return NULL;
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+	if (!cx || !cy)
+		return NULL;
+
+	/* counts as a draw, so other draws of the source this frame and the
+	 * next few go through the cache as well */
+	update_render_count(source);
+
+	start_ns = os_gettime_ns();
+	source->render_depth++;
+	tex = get_render_cache_texture(source, cx, cy);
+	source->render_depth--;
+	source->cur_render_ns += os_gettime_ns() - start_ns;
+
+	return tex;
+}
+
+void obs_source_get_render_stats(const obs_source_t *source,
+		struct obs_source_render_stats *stats)
+{
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(struct obs_source_render_stats));
+	if (!source)
+		return;
+
+	stats->tick_ns   = source->avg_tick_ns;
+	stats->render_ns = source->avg_render_ns;
+	stats->gpu_ns    = source->avg_gpu_ns;
+}
+
 uint32_t obs_source_get_width(const obs_source_t *source)
 {
 	if (!source_valid(source)) return 0;
@@ -1223,7 +2275,7 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 	if (!source || !filter)
 		return;
 
-	pthread_mutex_lock(&source->filter_mutex);
+	os_mutex_lock(&source->filter_mutex, "filter_mutex");
 
 	if (da_find(source->filters, &filter, 0) != DARRAY_INVALID) {
 		blog(LOG_WARNING, "Tried to add a filter that was already "
@@ -1238,10 +2290,11 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	da_push_back(source->filters, &filter);
 
-	pthread_mutex_unlock(&source->filter_mutex);
+	os_mutex_unlock(&source->filter_mutex, "filter_mutex");
 
 	filter->filter_parent = source;
 	filter->filter_target = source;
+	source->video_dirty   = true;
 }
 
 void obs_source_filter_remove(obs_source_t *source, obs_source_t *filter)
@@ -1251,7 +2304,7 @@ void obs_source_filter_remove(obs_source_t *source, obs_source_t *filter)
 	if (!source || !filter)
 		return;
 
-	pthread_mutex_lock(&source->filter_mutex);
+	os_mutex_lock(&source->filter_mutex, "filter_mutex");
 
 	idx = da_find(source->filters, &filter, 0);
 	if (idx == DARRAY_INVALID)
@@ -1264,10 +2317,11 @@ void obs_source_filter_remove(obs_source_t *source, obs_source_t *filter)
 
 	da_erase(source->filters, idx);
 
-	pthread_mutex_unlock(&source->filter_mutex);
+	os_mutex_unlock(&source->filter_mutex, "filter_mutex");
 
 	filter->filter_parent = NULL;
 	filter->filter_target = NULL;
+	source->video_dirty   = true;
 }
 
 void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
@@ -1309,6 +2363,8 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 			source : source->filters.array[idx+1];
 		source->filters.array[i]->filter_target = next_filter;
 	}
+
+	source->video_dirty = true;
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -1396,12 +2452,122 @@ static void copy_frame_data(struct obs_source_frame *dst,
 	}
 }
 
-static inline struct obs_source_frame *cache_video(
+#define MAX_ASYNC_CACHE_FRAMES 8
+#define MAX_ASYNC_FRAMES       30
+
+static inline void free_async_cache(struct obs_source *source)
+{
+	for (size_t i = 0; i < source->async_cache.num; i++)
+		obs_source_frame_destroy(source->async_cache.array[i]);
+	da_resize(source->async_cache, 0);
+}
+
+/* must be called with video_mutex locked */
+static struct obs_source_frame *get_cached_frame(struct obs_source *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = NULL;
+
+	if (source->async_cache_format != format ||
+	    source->async_cache_width  != width  ||
+	    source->async_cache_height != height) {
+		free_async_cache(source);
+		source->async_cache_format = format;
+		source->async_cache_width  = width;
+		source->async_cache_height = height;
+	}
+
+	if (source->async_cache.num) {
+		frame = source->async_cache.array[source->async_cache.num - 1];
+		da_pop_back(source->async_cache);
+	}
+
+	return frame ? frame : obs_source_frame_create(format, width, height);
+}
+
+/* must be called with video_mutex locked */
+static void recycle_frame(struct obs_source *source,
+		struct obs_source_frame *frame)
+{
+	if (!frame)
+		return;
+
+	if (!frame->release &&
+	    frame->format == source->async_cache_format &&
+	    frame->width  == source->async_cache_width  &&
+	    frame->height == source->async_cache_height &&
+	    source->async_cache.num < MAX_ASYNC_CACHE_FRAMES)
+		da_push_back(source->async_cache, &frame);
+	else
+		obs_source_frame_destroy(frame);
+}
+
+/* frees all but the newest 'keep' queued frames, with video_mutex locked */
+static void drop_queued_frames(obs_source_t *source, size_t keep)
+{
+	size_t num;
+
+	if (source->video_frames.num <= keep)
+		return;
+
+	num = source->video_frames.num - keep;
+	for (size_t i = 0; i < num; i++)
+		recycle_frame(source, source->video_frames.array[i]);
+
+	da_erase_range(source->video_frames, 0, num);
+	source->frames_dropped += num;
+}
+
+/*
+ * Gets a frame that is mapped for direct upload.  Filters may read the frame
+ * data, which is slow (or not possible at all) for mapped texture memory, so
+ * this is only done for sources without filters.
+ *
+ * must be called with video_mutex locked
+ */
+static struct obs_source_frame *get_upload_frame(struct obs_source *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	if (source->filters.num)
+		return NULL;
+
+	if (source->async_upload_format != format ||
+	    source->async_upload_width  != width  ||
+	    source->async_upload_height != height) {
+		source->async_upload_format = format;
+		source->async_upload_width  = width;
+		source->async_upload_height = height;
+		source->async_upload_failed = false;
+		return NULL;
+	}
+
+	for (size_t i = 0; i < ASYNC_UPLOAD_SLOTS; i++) {
+		struct async_upload_slot *slot = &source->async_upload[i];
+
+		if (slot->state == ASYNC_UPLOAD_MAPPED &&
+		    slot->frame.format == format &&
+		    slot->frame.width  == width  &&
+		    slot->frame.height == height) {
+			slot->state = ASYNC_UPLOAD_ACQUIRED;
+			return &slot->frame;
+		}
+	}
+
+	return NULL;
+}
+
+static inline struct obs_source_frame *cache_video(struct obs_source *source,
 		const struct obs_source_frame *frame)
 {
-	/* TODO: use an actual cache */
-	struct obs_source_frame *new_frame = obs_source_frame_create(
-			frame->format, frame->width, frame->height);
+	struct obs_source_frame *new_frame;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+	new_frame = get_upload_frame(source, frame->format, frame->width,
+			frame->height);
+	if (!new_frame)
+		new_frame = get_cached_frame(source, frame->format,
+				frame->width, frame->height);
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
 
 	copy_frame_data(new_frame, frame);
 	return new_frame;
@@ -1415,24 +2581,99 @@ static inline void cycle_frames(struct obs_source *source)
 		ready_async_frame(source, os_gettime_ns());
 }
 
+static void output_cached_video(struct obs_source *source,
+		struct obs_source_frame *output)
+{
+	os_mutex_lock(&source->filter_mutex, "filter_mutex");
+	output = filter_async_video(source, output);
+	os_mutex_unlock(&source->filter_mutex, "filter_mutex");
+
+	if (output) {
+		os_mutex_lock(&source->video_mutex, "video_mutex");
+		cycle_frames(source);
+
+		/* in unbuffered mode only the newest frame is ever presented,
+		 * so older ones can be freed right away */
+		if ((source->flags & OBS_SOURCE_UNBUFFERED) != 0)
+			drop_queued_frames(source, 0);
+
+		/* if frames aren't being taken out of the queue (a stalled
+		 * video thread, or timestamps far in the future), don't let
+		 * the queue grow without limit, drop the oldest instead */
+		else if (source->video_frames.num >= MAX_ASYNC_FRAMES)
+			drop_queued_frames(source, MAX_ASYNC_FRAMES - 1);
+
+		da_push_back(source->video_frames, &output);
+		os_mutex_unlock(&source->video_mutex, "video_mutex");
+	}
+}
+
 void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame)
 {
+	enum bmem_tag prev_tag;
+
 	if (!source || !frame)
 		return;
 
-	struct obs_source_frame *output = cache_video(frame);
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_SOURCE);
+	output_cached_video(source, cache_video(source, frame));
+	bmem_set_thread_tag(prev_tag);
+}
 
-	pthread_mutex_lock(&source->filter_mutex);
-	output = filter_async_video(source, output);
-	pthread_mutex_unlock(&source->filter_mutex);
+struct obs_source_frame *obs_source_alloc_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
 
-	if (output) {
-		pthread_mutex_lock(&source->video_mutex);
-		cycle_frames(source);
-		da_push_back(source->video_frames, &output);
-		pthread_mutex_unlock(&source->video_mutex);
-	}
+	if (!source)
+		return NULL;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+	frame = get_cached_frame(source, format, width, height);
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
+
+	return frame;
+}
+
+struct obs_source_frame *obs_source_acquire_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+
+	if (!source)
+		return NULL;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+	frame = get_upload_frame(source, format, width, height);
+	if (!frame)
+		frame = get_cached_frame(source, format, width, height);
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
+
+	return frame;
+}
+
+void obs_source_output_video_owned(obs_source_t *source,
+		struct obs_source_frame *frame)
+{
+	if (!source || !frame)
+		return;
+
+	output_cached_video(source, frame);
+}
+
+void obs_source_flush_video(obs_source_t *source)
+{
+	if (!source)
+		return;
+
+	os_mutex_lock(&source->video_mutex, "video_mutex");
+
+	for (size_t i = 0; i < source->video_frames.num; i++)
+		recycle_frame(source, source->video_frames.array[i]);
+	da_resize(source->video_frames, 0);
+
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
 }
 
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
@@ -1469,6 +2710,10 @@ static inline void reset_resampler(obs_source_t *source,
 	source->sample_info.samples_per_sec = audio->samples_per_sec;
 	source->sample_info.speakers        = audio->speakers;
 
+	audio_resampler_destroy(source->resampler);
+	source->resampler = NULL;
+
+	/* no resampler at all if the formats match, the data is copied as-is */
 	if (source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
 	    source->sample_info.format          == obs_info->format          &&
 	    source->sample_info.speakers        == obs_info->speakers) {
@@ -1476,7 +2721,6 @@ static inline void reset_resampler(obs_source_t *source,
 		return;
 	}
 
-	audio_resampler_destroy(source->resampler);
 	source->resampler = audio_resampler_create(&output_info,
 			&source->sample_info);
 
@@ -1510,9 +2754,29 @@ static inline void copy_audio_data(obs_source_t *source,
 		source->audio_storage_size = size;
 }
 
-/* resamples/remixes new audio to the designated main audio output format */
-static void process_audio(obs_source_t *source,
-		const struct obs_source_audio *audio)
+static inline bool has_audio_filters(const obs_source_t *source)
+{
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+
+		if (filter->context.data && filter->info.filter_audio)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * resamples/remixes new audio to the designated main audio output format.
+ *
+ * the resampler writes into its own buffer, which is handed on directly.
+ * audio that is already in the output format is only copied to the source's
+ * own storage when filters need a writable buffer; otherwise the caller's
+ * data goes straight to the audio line, which makes its own copy anyway.
+ */
+static bool process_audio(obs_source_t *source,
+		const struct obs_source_audio *audio, bool writable,
+		struct obs_audio_data *out)
 {
 	if (source->sample_info.samples_per_sec != audio->samples_per_sec ||
 	    source->sample_info.format          != audio->format          ||
@@ -1520,46 +2784,57 @@ static void process_audio(obs_source_t *source,
 		reset_resampler(source, audio);
 
 	if (source->audio_failed)
-		return;
+		return false;
+
+	memset(out, 0, sizeof(*out));
 
 	if (source->resampler) {
-		uint8_t  *output[MAX_AV_PLANES];
-		uint32_t frames;
 		uint64_t offset;
 
-		memset(output, 0, sizeof(output));
-
 		audio_resampler_resample(source->resampler,
-				output, &frames, &offset,
+				out->data, &out->frames, &offset,
 				audio->data, audio->frames);
 
-		copy_audio_data(source, (const uint8_t *const *)output, frames,
-				audio->timestamp - offset);
-	} else {
+		out->timestamp = audio->timestamp - offset;
+
+	} else if (writable) {
 		copy_audio_data(source, audio->data, audio->frames,
 				audio->timestamp);
+		*out = source->audio_data;
+
+	} else {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			out->data[i] = (uint8_t*)audio->data[i];
+
+		out->frames    = audio->frames;
+		out->timestamp = audio->timestamp;
 	}
+
+	return true;
 }
 
 void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio)
 {
 	uint32_t flags;
-	struct obs_audio_data *output;
+	struct obs_audio_data processed;
+	struct obs_audio_data *output = NULL;
 
 	if (!source || !audio)
 		return;
 
 	flags = source->info.output_flags;
-	process_audio(source, audio);
 
-	pthread_mutex_lock(&source->filter_mutex);
-	output = filter_async_audio(source, &source->audio_data);
+	os_mutex_lock(&source->filter_mutex, "filter_mutex");
+
+	if (process_audio(source, audio, has_audio_filters(source),
+				&processed))
+		output = filter_async_audio(source, &processed);
 
 	if (output) {
 		bool async = (flags & OBS_SOURCE_ASYNC) != 0;
 
-		pthread_mutex_lock(&source->audio_mutex);
+		os_mutex_lock(&source->audio_mutex, "audio_mutex");
 
 		/* wait for video to start before outputting any audio so we
 		 * have a base for sync */
@@ -1574,10 +2849,10 @@ void obs_source_output_audio(obs_source_t *source,
 			source_output_audio_line(source, &data);
 		}
 
-		pthread_mutex_unlock(&source->audio_mutex);
+		os_mutex_unlock(&source->audio_mutex, "audio_mutex");
 	}
 
-	pthread_mutex_unlock(&source->filter_mutex);
+	os_mutex_unlock(&source->filter_mutex, "filter_mutex");
 }
 
 static inline bool frame_out_of_bounds(const obs_source_t *source, uint64_t ts)
@@ -1599,12 +2874,7 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 	uint64_t frame_offset = 0;
 
 	if ((source->flags & OBS_SOURCE_UNBUFFERED) != 0) {
-		while (source->video_frames.num > 1) {
-			da_erase(source->video_frames, 0);
-			obs_source_frame_destroy(next_frame);
-			next_frame = source->video_frames.array[0];
-		}
-
+		drop_queued_frames(source, 1);
 		return true;
 	}
 
@@ -1649,7 +2919,9 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 				next_frame->timestamp);
 #endif
 
-		obs_source_frame_destroy(frame);
+		if (frame)
+			source->frames_dropped++;
+		recycle_frame(source, frame);
 
 		if (source->video_frames.num == 1)
 			return true;
@@ -1704,7 +2976,7 @@ struct obs_source_frame *obs_source_get_frame(obs_source_t *source)
 	if (!source)
 		return NULL;
 
-	pthread_mutex_lock(&source->video_mutex);
+	os_mutex_lock(&source->video_mutex, "video_mutex");
 
 	sys_time = os_gettime_ns();
 
@@ -1729,7 +3001,7 @@ struct obs_source_frame *obs_source_get_frame(obs_source_t *source)
 unlock:
 	source->last_sys_timestamp = sys_time;
 
-	pthread_mutex_unlock(&source->video_mutex);
+	os_mutex_unlock(&source->video_mutex, "video_mutex");
 
 	if (frame)
 		obs_source_addref(source);
@@ -1741,7 +3013,10 @@ void obs_source_release_frame(obs_source_t *source,
 		struct obs_source_frame *frame)
 {
 	if (source && frame) {
-		obs_source_frame_destroy(frame);
+		os_mutex_lock(&source->video_mutex, "video_mutex");
+		recycle_frame(source, frame);
+		os_mutex_unlock(&source->video_mutex, "video_mutex");
+
 		obs_source_release(source);
 	}
 }
@@ -1756,10 +3031,25 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 	if (!source) return;
 
 	if (!name || !*name || strcmp(name, source->context.name) != 0) {
+		struct obs_core_data *core_data = &obs->data;
 		struct calldata data;
 		char *prev_name = bstrdup(source->context.name);
+
+		/* the previous name string stays valid in the rename cache */
+		const char *old_name = source->context.name;
+
+		pthread_mutex_lock(&core_data->user_sources_mutex);
+
 		obs_context_data_setname(&source->context, name);
 
+		if (da_find(core_data->user_sources, &source, 0) !=
+				DARRAY_INVALID) {
+			obs_user_source_name_remove(source, old_name);
+			obs_user_source_name_add(source);
+		}
+
+		pthread_mutex_unlock(&core_data->user_sources_mutex);
+
 		calldata_init(&data);
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_string(&data, "new_name", source->context.name);
@@ -1816,26 +3106,293 @@ static inline void render_filter_tex(gs_texture_t *tex, gs_effect_t *effect,
 	gs_technique_end(tech);
 }
 
-void obs_source_process_filter(obs_source_t *filter, gs_effect_t *effect,
-		uint32_t width, uint32_t height, enum gs_color_format format,
-		enum obs_allow_direct_render allow_direct)
+static gs_texrender_t *borrow_filter_texture(uint32_t cx, uint32_t cy,
+		enum gs_color_format format)
 {
-	obs_source_t *target, *parent;
-	uint32_t     target_flags, parent_flags;
-	int          cx, cy;
-	bool         use_matrix, expects_def, can_directly;
+	struct obs_core_video *video = &obs->video;
+	struct filter_texture *ft;
 
-	if (!filter) return;
+	for (size_t i = 0; i < video->filter_textures.num; i++) {
+		ft = video->filter_textures.array[i];
+
+		if (!ft->in_use && ft->cx == cx && ft->cy == cy &&
+		    ft->format == format) {
+			ft->in_use     = true;
+			ft->last_frame = video->render_frame;
+			gs_texrender_reset(ft->texrender);
+			return ft->texrender;
+		}
+	}
+
+	ft = bzalloc(sizeof(struct filter_texture));
+	ft->texrender  = gs_texrender_create(format, GS_ZS_NONE);
+	ft->cx         = cx;
+	ft->cy         = cy;
+	ft->format     = format;
+	ft->in_use     = true;
+	ft->last_frame = video->render_frame;
+	da_push_back(video->filter_textures, &ft);
+
+	return ft->texrender;
+}
+
+static void return_filter_texture(gs_texrender_t *texrender)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->filter_textures.num; i++) {
+		struct filter_texture *ft = video->filter_textures.array[i];
+
+		if (ft->texrender == texrender) {
+			ft->in_use = false;
+			break;
+		}
+	}
+}
+
+static inline void destroy_filter_texture(struct obs_core_video *video,
+		size_t idx)
+{
+	struct filter_texture *ft = video->filter_textures.array[idx];
+
+	gs_texrender_destroy(ft->texrender);
+	bfree(ft);
+	da_erase(video->filter_textures, idx);
+}
+
+/* called from the graphics thread once a frame */
+void expire_filter_textures(void)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t i = video->filter_textures.num;
+
+	while (i--) {
+		struct filter_texture *ft = video->filter_textures.array[i];
+
+		if (!ft->in_use && video->render_frame - ft->last_frame >
+				FILTER_TEXTURE_TIMEOUT_FRAMES)
+			destroy_filter_texture(video, i);
+	}
+}
+
+void free_filter_textures(void)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t i = video->filter_textures.num;
+
+	while (i--)
+		destroy_filter_texture(video, i);
+
+	da_free(video->filter_textures);
+}
+
+static gs_stagesurf_t *get_snapshot_surface(uint32_t cx, uint32_t cy)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->snapshot_surfaces.num; i++) {
+		gs_stagesurf_t *surf = video->snapshot_surfaces.array[i];
+
+		if (gs_stagesurface_get_width(surf) == cx &&
+		    gs_stagesurface_get_height(surf) == cy) {
+			da_erase(video->snapshot_surfaces, i);
+			return surf;
+		}
+	}
+
+	return gs_stagesurface_create(cx, cy, GS_RGBA);
+}
+
+static void return_snapshot_surface(gs_stagesurf_t *surf)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (video->snapshot_surfaces.num < SNAPSHOT_POOL_SIZE)
+		da_push_back(video->snapshot_surfaces, &surf);
+	else
+		gs_stagesurface_destroy(surf);
+}
+
+static inline void finish_snapshot(struct obs_snapshot *snap,
+		const uint8_t *data, uint32_t linesize)
+{
+	snap->callback(snap->param, snap->source, data, linesize,
+			snap->cx, snap->cy);
+	obs_source_release(snap->source);
+}
+
+/* renders the source stretched over the snapshot size, then copies it to a
+ * staging surface to be mapped on a later frame */
+static bool stage_snapshot(struct obs_snapshot *snap)
+{
+	uint32_t       width  = obs_source_get_width(snap->source);
+	uint32_t       height = obs_source_get_height(snap->source);
+	gs_texrender_t *texrender;
+	struct vec4    clear_color;
+	bool           success = false;
+
+	if (!width || !height)
+		return false;
+
+	texrender = borrow_filter_texture(snap->cx, snap->cy, GS_RGBA);
+
+	if (gs_texrender_begin(texrender, snap->cx, snap->cy)) {
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)width, 0.0f, (float)height,
+				-100.0f, 100.0f);
+
+		obs_source_video_render(snap->source);
+		gs_texrender_end(texrender);
+
+		snap->stagesurf = get_snapshot_surface(snap->cx, snap->cy);
+		if (snap->stagesurf) {
+			gs_stage_texture(snap->stagesurf,
+					gs_texrender_get_texture(texrender));
+			snap->staged_frame = obs->video.render_frame;
+			success = true;
+		}
+	}
+
+	return_filter_texture(texrender);
+	return success;
+}
+
+/* maps a staged snapshot once the GPU is done with it.  waiting is only
+ * forced after a few frames, the copy is tiny and is normally done by the
+ * next frame */
+static bool map_snapshot(struct obs_snapshot *snap)
+{
+	uint64_t frames = obs->video.render_frame - snap->staged_frame;
+	uint8_t  *data;
+	uint32_t linesize;
+	bool     mapped;
+
+	mapped = gs_stagesurface_try_map(snap->stagesurf, &data, &linesize);
+	if (!mapped && frames < SNAPSHOT_MAX_WAIT_FRAMES)
+		return false;
+	if (!mapped)
+		mapped = gs_stagesurface_map(snap->stagesurf, &data, &linesize);
+
+	if (mapped) {
+		finish_snapshot(snap, data, linesize);
+		gs_stagesurface_unmap(snap->stagesurf);
+	} else {
+		finish_snapshot(snap, NULL, 0);
+	}
+
+	return_snapshot_surface(snap->stagesurf);
+	return true;
+}
+
+/* called from the graphics thread once a frame */
+void process_snapshots(void)
+{
+	struct obs_core_video *video = &obs->video;
+	DARRAY(struct obs_snapshot) requests;
+	size_t i = video->snapshots_staged.num;
+
+	while (i--) {
+		if (map_snapshot(video->snapshots_staged.array + i))
+			da_erase(video->snapshots_staged, i);
+	}
+
+	pthread_mutex_lock(&video->snapshot_mutex);
+	requests.da = video->snapshot_requests.da;
+	da_init(video->snapshot_requests);
+	pthread_mutex_unlock(&video->snapshot_mutex);
+
+	for (i = 0; i < requests.num; i++) {
+		struct obs_snapshot *snap = requests.array + i;
+
+		if (stage_snapshot(snap))
+			da_push_back(video->snapshots_staged, snap);
+		else
+			finish_snapshot(snap, NULL, 0);
+	}
+
+	da_free(requests);
+}
+
+/* called once the video thread has stopped, sources are still valid */
+void free_snapshots(void)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_snapshot   *snap;
+	gs_stagesurf_t        *surf;
+
+	if (video->graphics) {
+		gs_enter_context(video->graphics);
+
+		for (size_t i = 0; i < video->snapshots_staged.num; i++) {
+			snap = video->snapshots_staged.array + i;
+			gs_stagesurface_destroy(snap->stagesurf);
+		}
+		for (size_t i = 0; i < video->snapshot_surfaces.num; i++) {
+			surf = video->snapshot_surfaces.array[i];
+			gs_stagesurface_destroy(surf);
+		}
+
+		gs_leave_context();
+	}
+
+	for (size_t i = 0; i < video->snapshots_staged.num; i++)
+		finish_snapshot(video->snapshots_staged.array + i, NULL, 0);
+
+	pthread_mutex_lock(&video->snapshot_mutex);
+	for (size_t i = 0; i < video->snapshot_requests.num; i++)
+		finish_snapshot(video->snapshot_requests.array + i, NULL, 0);
+	da_free(video->snapshot_requests);
+	pthread_mutex_unlock(&video->snapshot_mutex);
+
+	da_free(video->snapshots_staged);
+	da_free(video->snapshot_surfaces);
+}
+
+bool obs_source_request_snapshot(obs_source_t *source,
+		uint32_t cx, uint32_t cy, obs_source_snapshot_cb callback,
+		void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_snapshot snap = {0};
+
+	if (!source || !callback || !video->video)
+		return false;
+	if (!cx || !cy || cx > OBS_SNAPSHOT_MAX_SIZE ||
+	    cy > OBS_SNAPSHOT_MAX_SIZE)
+		return false;
+
+	obs_source_addref(source);
+
+	snap.source   = source;
+	snap.cx       = cx;
+	snap.cy       = cy;
+	snap.callback = callback;
+	snap.param    = param;
+
+	pthread_mutex_lock(&video->snapshot_mutex);
+	da_push_back(video->snapshot_requests, &snap);
+	pthread_mutex_unlock(&video->snapshot_mutex);
+	return true;
+}
+
+/* draws the target of a filter with the filter's effect, either directly or
+ * through a render target */
+static void process_filter_target(obs_source_t *target, obs_source_t *parent,
+		gs_effect_t *effect, uint32_t width, uint32_t height,
+		enum gs_color_format format, bool can_directly)
+{
+	gs_texrender_t *texrender;
+	uint32_t       target_flags, parent_flags;
+	uint32_t       cx, cy;
+	bool           use_matrix, expects_def;
 
-	target       = obs_filter_get_target(filter);
-	parent       = obs_filter_get_parent(filter);
 	target_flags = target->info.output_flags;
 	parent_flags = parent->info.output_flags;
 	cx           = obs_source_get_width(target);
 	cy           = obs_source_get_height(target);
 	use_matrix   = !!(target_flags & OBS_SOURCE_COLOR_MATRIX);
 	expects_def  = !(parent_flags & OBS_SOURCE_CUSTOM_DRAW);
-	can_directly = allow_direct == OBS_ALLOW_DIRECT_RENDERING;
 
 	/* if the parent does not use any custom effects, and this is the last
 	 * filter in the chain for the parent, then render the parent directly
@@ -1846,23 +3403,113 @@ void obs_source_process_filter(obs_source_t *filter, gs_effect_t *effect,
 		return;
 	}
 
-	if (!filter->filter_texrender)
-		filter->filter_texrender = gs_texrender_create(format,
-				GS_ZS_NONE);
+	texrender = borrow_filter_texture(cx, cy, format);
 
-	if (gs_texrender_begin(filter->filter_texrender, cx, cy)) {
+	if (gs_texrender_begin(texrender, cx, cy)) {
 		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
 		if (expects_def && parent == target)
 			obs_source_default_render(parent, use_matrix);
 		else
 			obs_source_video_render(target);
-		gs_texrender_end(filter->filter_texrender);
+		gs_texrender_end(texrender);
 	}
 
 	/* --------------------------- */
 
-	render_filter_tex(gs_texrender_get_texture(filter->filter_texrender),
+	render_filter_tex(gs_texrender_get_texture(texrender),
 			effect, width, height, use_matrix);
+
+	return_filter_texture(texrender);
+}
+
+void obs_source_process_filter(obs_source_t *filter, gs_effect_t *effect,
+		uint32_t width, uint32_t height, enum gs_color_format format,
+		enum obs_allow_direct_render allow_direct)
+{
+	if (!filter) return;
+
+	process_filter_target(obs_filter_get_target(filter),
+			obs_filter_get_parent(filter), effect, width, height,
+			format, allow_direct == OBS_ALLOW_DIRECT_RENDERING);
+}
+
+static inline bool fused_effect_matches(const struct obs_fused_effect *fused,
+		obs_pixel_effect_t *const *pes, size_t num)
+{
+	if (!fused || fused->num != num)
+		return false;
+
+	for (size_t i = 0; i < num; i++) {
+		if (fused->ids[i] != pes[i]->function->id)
+			return false;
+	}
+
+	return true;
+}
+
+static void set_fused_params(struct obs_fused_effect *fused,
+		obs_pixel_effect_t *const *pes)
+{
+	size_t idx = 0;
+
+	for (size_t i = 0; i < fused->num; i++) {
+		const obs_pixel_effect_t *pe = pes[i];
+
+		for (size_t j = 0; j < pe->params.num; j++)
+			gs_effect_copy_val(fused->params.array[idx++],
+					pe->params.array[j]);
+	}
+}
+
+/* draws the filter and the filters after it that have pixel effects in a
+ * single pass, returns false if the filter has to draw itself */
+static bool render_fused_filters(obs_source_t *filter)
+{
+	obs_pixel_effect_t      *chain[MAX_FUSED_FILTERS];
+	obs_pixel_effect_t      *pes[MAX_FUSED_FILTERS];
+	obs_source_t            *parent = filter->filter_parent;
+	obs_source_t            *target = filter;
+	struct obs_core_video   *video  = &obs->video;
+	struct obs_fused_effect *fused  = NULL;
+	size_t                  idx     = filter->fused_effect_idx;
+	size_t                  num     = 0;
+
+	while (num < MAX_FUSED_FILTERS && target != parent) {
+		obs_pixel_effect_t *pe = NULL;
+
+		if (target->info.get_pixel_effect && target->context.data)
+			pe = target->info.get_pixel_effect(
+					target->context.data);
+		if (!pe)
+			break;
+
+		chain[num++] = pe;
+		target = target->filter_target;
+	}
+
+	if (num < 2)
+		return false;
+
+	/* the filter closest to the parent is applied first */
+	for (size_t i = 0; i < num; i++)
+		pes[i] = chain[num - i - 1];
+
+	if (idx < video->fused_effects.num)
+		fused = video->fused_effects.array[idx];
+
+	if (!fused_effect_matches(fused, pes, num)) {
+		idx   = obs_get_fused_effect(pes, num);
+		fused = video->fused_effects.array[idx];
+		filter->fused_effect_idx = idx;
+	}
+
+	if (!fused->effect)
+		return false;
+
+	set_fused_params(fused, pes);
+	process_filter_target(target, parent, fused->effect, 0, 0, GS_RGBA,
+			true);
+	return true;
 }
 
 signal_handler_t *obs_source_get_signal_handler(const obs_source_t *source)
@@ -1878,7 +3525,10 @@ proc_handler_t *obs_source_get_proc_handler(const obs_source_t *source)
 void obs_source_set_volume(obs_source_t *source, float volume)
 {
 	if (source) {
-		struct calldata data = {0};
+		uint8_t stack[CALLDATA_FIXED_SIZE];
+		struct calldata data;
+
+		calldata_init_fixed(&data, stack, sizeof(stack));
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
 
@@ -1910,8 +3560,7 @@ void obs_source_set_present_volume(obs_source_t *source, float volume)
 		 * transition source, let the transition handle presentation
 		 * volume for the child sources itself. */
 		if (source->info.type != OBS_SOURCE_TYPE_TRANSITION)
-			obs_source_enum_tree(source, set_tree_preset_vol,
-					&volume);
+			enum_cached_tree(source, set_tree_preset_vol, &volume);
 	}
 }
 
@@ -1925,6 +3574,41 @@ float obs_source_get_present_volume(const obs_source_t *source)
 	return source ? source->present_volume : 0.0f;
 }
 
+void obs_source_add_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param)
+{
+	struct audio_cb_info info = {callback, param};
+
+	if (!source) return;
+
+	os_mutex_lock(&source->audio_mutex, "audio_mutex");
+	da_push_back(source->audio_cb_list, &info);
+	os_mutex_unlock(&source->audio_mutex, "audio_mutex");
+}
+
+void obs_source_remove_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param)
+{
+	struct audio_cb_info info = {callback, param};
+
+	if (!source) return;
+
+	os_mutex_lock(&source->audio_mutex, "audio_mutex");
+	da_erase_item(source->audio_cb_list, &info);
+	os_mutex_unlock(&source->audio_mutex, "audio_mutex");
+}
+
+void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
+{
+	if (source)
+		audio_line_set_mixers(source->audio_line, mixers);
+}
+
+uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
+{
+	return source ? audio_line_get_mixers(source->audio_line) : 0;
+}
+
 void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 {
 	if (source)
@@ -1999,10 +3683,51 @@ void obs_source_enum_tree(obs_source_t *source,
 	obs_source_release(source);
 }
 
+static inline bool source_self_unchanged(obs_source_t *source)
+{
+	bool unchanged = source->video_unchanged;
+
+	os_mutex_lock(&source->filter_mutex, "filter_mutex");
+
+	for (size_t i = 0; unchanged && i < source->filters.num; i++)
+		unchanged = source->filters.array[i]->video_unchanged;
+
+	os_mutex_unlock(&source->filter_mutex, "filter_mutex");
+	return unchanged;
+}
+
+static void check_child_unchanged(obs_source_t *parent, obs_source_t *child,
+		void *param)
+{
+	bool *unchanged = param;
+
+	if (*unchanged)
+		*unchanged = source_self_unchanged(child);
+
+	UNUSED_PARAMETER(parent);
+}
+
+bool obs_source_tree_unchanged(obs_source_t *source)
+{
+	bool unchanged;
+
+	if (!source_valid(source))
+		return true;
+
+	unchanged = source_self_unchanged(source);
+	if (unchanged)
+		enum_cached_tree(source, check_child_unchanged,
+				&unchanged);
+
+	return unchanged;
+}
+
 void obs_source_add_child(obs_source_t *parent, obs_source_t *child)
 {
 	if (!parent || !child) return;
 
+	invalidate_tree_caches(parent);
+
 	for (int i = 0; i < parent->show_refs; i++) {
 		enum view_type type;
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
@@ -2019,6 +3744,8 @@ void obs_source_remove_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	invalidate_tree_caches(parent);
 }
 
 static void reset_transition_vol(obs_source_t *parent, obs_source_t *child,
@@ -2051,7 +3778,7 @@ static void apply_transition_vol(obs_source_t *parent, obs_source_t *child,
 void obs_transition_begin_frame(obs_source_t *transition)
 {
 	if (!transition) return;
-	obs_source_enum_tree(transition, reset_transition_vol, NULL);
+	enum_cached_tree(transition, reset_transition_vol, NULL);
 }
 
 void obs_source_set_transition_vol(obs_source_t *source, float vol)
@@ -2059,13 +3786,61 @@ void obs_source_set_transition_vol(obs_source_t *source, float vol)
 	if (!source) return;
 
 	add_transition_vol(NULL, source, &vol);
-	obs_source_enum_tree(source, add_transition_vol, &vol);
+	enum_cached_tree(source, add_transition_vol, &vol);
 }
 
 void obs_transition_end_frame(obs_source_t *transition)
 {
 	if (!transition) return;
-	obs_source_enum_tree(transition, apply_transition_vol, NULL);
+	enum_cached_tree(transition, apply_transition_vol, NULL);
+}
+
+bool obs_transition_freeze_source(obs_source_t *transition,
+		obs_source_t *source)
+{
+	uint32_t    cx, cy;
+	struct vec4 clear_color;
+
+	if (!transition || !source_valid(source))
+		return false;
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+	if (!cx || !cy)
+		return false;
+
+	if (!transition->transition_freeze)
+		transition->transition_freeze = gs_texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	gs_texrender_reset(transition->transition_freeze);
+	if (!gs_texrender_begin(transition->transition_freeze, cx, cy))
+		return false;
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	obs_source_video_render(source);
+
+	gs_texrender_end(transition->transition_freeze);
+	transition->transition_frozen = true;
+	return true;
+}
+
+gs_texture_t *obs_transition_get_frozen_texture(
+		const obs_source_t *transition)
+{
+	if (!transition || !transition->transition_frozen)
+		return NULL;
+
+	return gs_texrender_get_texture(transition->transition_freeze);
+}
+
+void obs_transition_clear_frozen(obs_source_t *transition)
+{
+	if (transition)
+		transition->transition_frozen = false;
 }
 
 void obs_source_save(obs_source_t *source)
@@ -2076,14 +3851,21 @@ void obs_source_save(obs_source_t *source)
 
 void obs_source_load(obs_source_t *source)
 {
+	if (source && os_atomic_load_long(&source->create_deferred) > 0) {
+		source->load_deferred = true;
+		return;
+	}
+
 	if (!source_valid(source) || !source->info.load) return;
 	source->info.load(source->context.data, source->context.settings);
 }
 
 static inline void signal_flags_updated(obs_source_t *source)
 {
-	struct calldata data = {0};
+	uint8_t stack[CALLDATA_FIXED_SIZE];
+	struct calldata data;
 
+	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_int(&data, "flags", source->flags);
 
@@ -2107,6 +3889,54 @@ uint32_t obs_source_get_flags(const obs_source_t *source)
 	return source ? source->flags : 0;
 }
 
+uint64_t obs_source_get_frames_dropped(const obs_source_t *source)
+{
+	return source ? source->frames_dropped : 0;
+}
+
+bool obs_source_async_queue_full(const obs_source_t *source)
+{
+	/* only a hint, so the queue size is read without locking */
+	return source && source->video_frames.num >= MAX_ASYNC_FRAMES;
+}
+
+static size_t get_frame_size(const struct obs_source_frame *frame)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < MAX_AV_PLANES && frame->data[i]; i++) {
+		uint32_t height = frame->height;
+
+		if (i > 0 && (frame->format == VIDEO_FORMAT_I420 ||
+		              frame->format == VIDEO_FORMAT_NV12))
+			height /= 2;
+
+		size += (size_t)frame->linesize[i] * height;
+	}
+
+	return size;
+}
+
+void obs_source_get_async_queue_info(obs_source_t *source,
+		size_t *num_frames, size_t *bytes)
+{
+	size_t num = 0;
+	size_t size = 0;
+
+	if (source) {
+		os_mutex_lock(&source->video_mutex, "video_mutex");
+		num = source->video_frames.num;
+		for (size_t i = 0; i < num; i++)
+			size += get_frame_size(source->video_frames.array[i]);
+		os_mutex_unlock(&source->video_mutex, "video_mutex");
+	}
+
+	if (num_frames)
+		*num_frames = num;
+	if (bytes)
+		*bytes = size;
+}
+
 void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix,
 		const struct vec3 *color_range_min,
 		const struct vec3 *color_range_max)
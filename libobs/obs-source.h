@@ -103,6 +103,36 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_INTERACTION (1<<5)
 
+/**
+ * Source must be rendered every time it is drawn.
+ *
+ * When a source is drawn more than once in a frame (for example when it is
+ * used in multiple scenes or views), it is normally rendered to a texture
+ * once and that texture is drawn instead.  Specify this flag if the output
+ * of the source depends on the context it is drawn in.
+ */
+#define OBS_SOURCE_NO_RENDER_CACHE (1<<6)
+
+/**
+ * Source is opaque.
+ *
+ * Specify this flag if the source always covers its whole area with fully
+ * opaque pixels.  Scenes will then skip drawing items that are entirely
+ * covered by the source (as long as it's not rotated and has no filters).
+ */
+#define OBS_SOURCE_OPAQUE          (1<<7)
+
+/**
+ * Source only needs to do work while it's shown.
+ *
+ * Specify this flag if the source captures or uploads its video in its
+ * video_tick callback.  The video_tick callback will not be called while the
+ * source isn't shown in any view (including preview and properties windows),
+ * so hidden captures stop costing anything.  Use the show/hide callbacks to
+ * release or reacquire anything that is held between ticks.
+ */
+#define OBS_SOURCE_SUSPEND_WHEN_HIDDEN (1<<8)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -352,6 +382,53 @@ struct obs_source_info {
 	 */
 	void (*key_click)(void *data, const struct obs_key_event *event,
 			bool key_up);
+
+	/**
+	 * Returns whether the video of the source is exactly the same as in
+	 * the last frame (optional).  Called every frame after video_tick.
+	 *
+	 * Sources that don't implement this are treated as changing every
+	 * frame.  Updated settings and filter changes are already accounted
+	 * for, there's no need to report those.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the video of the source is unchanged
+	 */
+	bool (*video_unchanged)(void *data);
+
+	/**
+	 * Gets the pixel effect of a filter that only changes each pixel by
+	 * itself (optional).  Called each frame before the filter renders,
+	 * the filter sets the effect's parameters here.
+	 *
+	 *   When the filter's target is also a filter with a pixel effect,
+	 * the filters are drawn together in a single pass with an effect
+	 * generated from their pixel functions, and video_render isn't called.
+	 * video_render must still draw the filter on its own, usually with
+	 * obs_source_process_filter and the pixel effect's effect.
+	 *
+	 * @param  data  Filter data
+	 * @return       The filter's pixel effect, or NULL to always draw the
+	 *               filter with video_render
+	 */
+	obs_pixel_effect_t *(*get_pixel_effect)(void *data);
+
+	/**
+	 * Updates the settings for this source, like update, but also tells
+	 * which settings changed since the source was created or last
+	 * updated (optional).  Called instead of update if implemented.
+	 *
+	 *   Sources can use this to only reinitialize what the changed
+	 * settings affect, e.g. to not reopen a device when only a cosmetic
+	 * setting changed.
+	 *
+	 * @param data      Source data
+	 * @param settings  New settings for this source
+	 * @param changed   The name of every changed setting is set to true,
+	 *                  check with obs_data_get_bool
+	 */
+	void (*update_diff)(void *data, obs_data_t *settings,
+			obs_data_t *changed);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
@@ -20,12 +20,40 @@
 #include "graphics/vec4.h"
 #include "media-io/format-conversion.h"
 
+static inline bool source_tick_has_dependencies(struct obs_source *source)
+{
+	/* sources that contain other sources (scenes, transitions) and
+	 * filters must be ticked after the sources they depend on */
+	return source->info.enum_sources || source->filter_parent;
+}
+
+static inline bool tick_addref(struct obs_source *source)
+{
+	/* if the reference count was already 0, the source is in the middle
+	 * of being destroyed and must not be touched */
+	if (os_atomic_inc_long(&source->refs) == 1) {
+		os_atomic_dec_long(&source->refs);
+		return false;
+	}
+
+	return true;
+}
+
+static void tick_parallel_source(void *param, size_t idx)
+{
+	struct obs_core_video *video = &obs->video;
+	float *seconds = param;
+
+	obs_source_video_tick(video->tick_parallel.array[idx], *seconds);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
-	struct obs_core_data *data = &obs->data;
-	struct obs_source    *source;
-	uint64_t             delta_time;
-	float                seconds;
+	struct obs_core_data  *data  = &obs->data;
+	struct obs_core_video *video = &obs->video;
+	struct obs_source     *source;
+	uint64_t              delta_time;
+	float                 seconds;
 
 	if (!last_time)
 		last_time = cur_time -
@@ -34,16 +62,37 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	delta_time = cur_time - last_time;
 	seconds = (float)((double)delta_time / 1000000000.0);
 
-	pthread_mutex_lock(&data->sources_mutex);
+	/* take references so the sources can be ticked outside of the sources
+	 * mutex; a source tick on a pool thread could otherwise deadlock by
+	 * creating or destroying a source */
+	os_mutex_lock(&data->sources_mutex, "sources_mutex");
 
 	source = data->first_source;
 	while (source) {
-		if (source->refs)
-			obs_source_video_tick(source, seconds);
+		if (source->refs && tick_addref(source)) {
+			if (source_tick_has_dependencies(source))
+				da_push_back(video->tick_serial, &source);
+			else
+				da_push_back(video->tick_parallel, &source);
+		}
 		source = (struct obs_source*)source->context.next;
 	}
 
-	pthread_mutex_unlock(&data->sources_mutex);
+	os_mutex_unlock(&data->sources_mutex, "sources_mutex");
+
+	task_pool_run(video->tick_pool, video->tick_parallel.num,
+			tick_parallel_source, &seconds);
+
+	for (size_t i = 0; i < video->tick_serial.num; i++)
+		obs_source_video_tick(video->tick_serial.array[i], seconds);
+
+	for (size_t i = 0; i < video->tick_parallel.num; i++)
+		obs_source_release(video->tick_parallel.array[i]);
+	for (size_t i = 0; i < video->tick_serial.num; i++)
+		obs_source_release(video->tick_serial.array[i]);
+
+	da_resize(video->tick_parallel, 0);
+	da_resize(video->tick_serial, 0);
 
 	return cur_time;
 }
@@ -51,6 +100,87 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 /* in obs-display.c */
 extern void render_display(struct obs_display *display);
 
+static void collect_stage_timers(struct obs_core_video *video,
+		struct obs_video_mix *mix, size_t slot)
+{
+	for (size_t i = 0; i < NUM_RENDER_STAGES; i++) {
+		struct render_stage_timer *stage = &mix->stage_timers[i];
+		uint64_t ticks;
+
+		if (!stage->used[slot])
+			continue;
+
+		stage->used[slot] = false;
+
+		if (video->gpu_timing_valid &&
+		    gs_timer_get_data(stage->timers[slot], &ticks))
+			stage->avg_ns = update_avg_ns(stage->avg_ns,
+				(uint64_t)((double)ticks * 1000000000.0 /
+				(double)video->gpu_timer_frequency));
+	}
+}
+
+/* wraps everything rendered in a frame in a GPU timer range, which sources
+ * need to be able to interpret their GPU timers */
+static void begin_gpu_timing(struct obs_core_video *video)
+{
+	gs_timer_range_t *range;
+	uint64_t         frequency = 0;
+	bool             disjoint  = true;
+	size_t           slot;
+
+	if (video->gpu_range_active)
+		return;
+
+	video->gpu_timer_frame++;
+	slot = (size_t)(video->gpu_timer_frame % GPU_TIMER_FRAMES);
+
+	if (!video->gpu_timer_ranges[slot])
+		video->gpu_timer_ranges[slot] = gs_timer_range_create();
+
+	range = video->gpu_timer_ranges[slot];
+	if (!range)
+		return;
+
+	/* the results of the range used GPU_TIMER_FRAMES ago apply to the
+	 * source timers that get read back this frame */
+	video->gpu_timing_valid = video->gpu_ranges_used[slot] &&
+		gs_timer_range_get_data(range, &disjoint, &frequency) &&
+		!disjoint && frequency != 0;
+	video->gpu_timer_frequency = frequency;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; i < video->mixes.num; i++)
+		collect_stage_timers(video, video->mixes.array[i], slot);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	gs_timer_range_begin(range);
+	video->gpu_ranges_used[slot] = true;
+	video->gpu_range_active      = true;
+}
+
+static void end_gpu_timing(struct obs_core_video *video)
+{
+	size_t slot = (size_t)(video->gpu_timer_frame % GPU_TIMER_FRAMES);
+
+	if (!video->gpu_range_active)
+		return;
+
+	gs_timer_range_end(video->gpu_timer_ranges[slot]);
+	video->gpu_range_active = false;
+}
+
+static inline bool has_displays(void)
+{
+	bool displays;
+
+	pthread_mutex_lock(&obs->data.displays_mutex);
+	displays = obs->data.first_display != NULL;
+	pthread_mutex_unlock(&obs->data.displays_mutex);
+
+	return displays;
+}
+
 static inline void render_displays(void)
 {
 	struct obs_display *display;
@@ -58,8 +188,17 @@ static inline void render_displays(void)
 	if (!obs->data.valid)
 		return;
 
+	if (obs->data.displays_disabled)
+		return;
+
+	/* headless with no displays: nothing to render or present */
+	if (obs->video.headless && !has_displays())
+		return;
+
 	gs_enter_context(obs->video.graphics);
 
+	begin_gpu_timing(&obs->video);
+
 	/* render extra displays/swaps */
 	pthread_mutex_lock(&obs->data.displays_mutex);
 
@@ -72,7 +211,8 @@ static inline void render_displays(void)
 	pthread_mutex_unlock(&obs->data.displays_mutex);
 
 	/* render main display */
-	render_display(&obs->video.main_display);
+	if (!obs->video.headless)
+		render_display(&obs->video.main_display);
 
 	gs_leave_context();
 }
@@ -86,341 +226,438 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+static inline void wait_for_readback(struct obs_video_mix *mix)
+{
+	if (mix->readback_pending) {
+		os_event_wait(mix->readback_complete);
+		mix->readback_pending = false;
+	}
+}
+
+static inline void unmap_last_surface(struct obs_video_mix *mix)
 {
-	if (video->mapped_surface) {
-		gs_stagesurface_unmap(video->mapped_surface);
-		video->mapped_surface = NULL;
+	wait_for_readback(mix);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (mix->mapped_surfaces[i]) {
+			gs_stagesurface_unmap(mix->mapped_surfaces[i]);
+			mix->mapped_surfaces[i] = NULL;
+		}
 	}
 }
 
-static inline void render_main_texture(struct obs_core_video *video,
+static inline void render_main_texture(struct obs_video_mix *mix,
 		int cur_texture)
 {
 	struct vec4 clear_color;
 	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	gs_set_render_target(video->render_textures[cur_texture], NULL);
+	gs_set_render_target(mix->render_textures[cur_texture], NULL);
 	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
 
-	set_render_size(video->base_width, video->base_height);
-	obs_view_render(&obs->data.main_view);
+	set_render_size(obs->video.base_width, obs->video.base_height);
+	obs_view_render(mix->view);
 
-	video->textures_rendered[cur_texture] = true;
+	mix->textures_rendered[cur_texture] = true;
 }
 
 static inline gs_effect_t *get_scale_effect_internal(
-		struct obs_core_video *video)
+		struct obs_video_mix *mix)
 {
-	switch (video->scale_type) {
-	case OBS_SCALE_BILINEAR: return video->default_effect;
-	case OBS_SCALE_LANCZOS:  return video->lanczos_effect;
+	switch (mix->scale_type) {
+	case OBS_SCALE_BILINEAR: return obs->video.default_effect;
+	case OBS_SCALE_LANCZOS:  return obs->video.lanczos_effect;
+	case OBS_SCALE_AREA:     return obs->video.area_effect;
 	case OBS_SCALE_BICUBIC:;
 	}
 
-	return video->bicubic_effect;
+	return obs->video.bicubic_effect;
 }
 
-static inline bool resolution_close(struct obs_core_video *video,
-		uint32_t width, uint32_t height)
+static inline bool resolution_close(uint32_t width, uint32_t height)
 {
-	long width_cmp  = (long)video->base_width  - (long)width;
-	long height_cmp = (long)video->base_height - (long)height;
+	long width_cmp  = (long)obs->video.base_width  - (long)width;
+	long height_cmp = (long)obs->video.base_height - (long)height;
 
 	return labs(width_cmp) <= 16 && labs(height_cmp) <= 16;
 }
 
-static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
+static inline gs_effect_t *get_scale_effect(struct obs_video_mix *mix,
 		uint32_t width, uint32_t height)
 {
-	if (resolution_close(video, width, height)) {
-		return video->default_effect;
+	if (resolution_close(width, height)) {
+		return obs->video.default_effect;
 	} else {
 		/* if the scale method couldn't be loaded, use either bicubic
 		 * or bilinear by default */
-		gs_effect_t *effect = get_scale_effect_internal(video);
+		gs_effect_t *effect = get_scale_effect_internal(mix);
 		if (!effect)
-			effect = !!video->bicubic_effect ?
-				video->bicubic_effect :
-				video->default_effect;
+			effect = !!obs->video.bicubic_effect ?
+				obs->video.bicubic_effect :
+				obs->video.default_effect;
 		return effect;
 	}
 }
 
-static inline void render_output_texture(struct obs_core_video *video,
+static void render_scale_pass(gs_effect_t *effect, const char *tech_name,
+		gs_texture_t *texture, gs_texture_t *target)
+{
+	gs_technique_t *tech  = gs_effect_get_technique(effect, tech_name);
+	gs_eparam_t    *image = gs_effect_get_param_by_name(effect, "image");
+	uint32_t       width  = gs_texture_get_width(target);
+	uint32_t       height = gs_texture_get_height(target);
+	size_t         passes, i;
+
+	gs_set_render_target(target, NULL);
+	set_render_size(width, height);
+
+	gs_effect_set_texture(image, texture);
+
+	passes = gs_technique_begin(tech);
+	for (i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(texture, 0, width, height);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+}
+
+/* scale filters with separate horizontal and vertical techniques are drawn
+ * in two passes through the scale texture, which takes n + n samples per
+ * pixel rather than n * n */
+static inline void render_output_texture(struct obs_video_mix *mix,
 		int cur_texture, int prev_texture)
 {
-	gs_texture_t *texture = video->render_textures[prev_texture];
-	gs_texture_t *target  = video->output_textures[cur_texture];
+	struct obs_video_mix *source_mix = mix->parent ? mix->parent : mix;
+	int          source_texture = mix->parent ?
+		mix->parent->last_render_texture : prev_texture;
+	gs_texture_t *texture = source_mix->render_textures[source_texture];
+	gs_texture_t *target  = mix->output_textures[cur_texture];
 	uint32_t     width   = gs_texture_get_width(target);
 	uint32_t     height  = gs_texture_get_height(target);
 	struct vec2  base_i;
+	struct vec2  ratio;
 
 	vec2_set(&base_i,
-		1.0f / (float)video->base_width,
-		1.0f / (float)video->base_height);
+		1.0f / (float)obs->video.base_width,
+		1.0f / (float)obs->video.base_height);
+	vec2_set(&ratio,
+		(float)obs->video.base_width  / (float)width,
+		(float)obs->video.base_height / (float)height);
+
+	gs_effect_t    *effect  = get_scale_effect(mix, width, height);
+	bool           separate = mix->scale_texture &&
+		!!gs_effect_get_technique(effect, "DrawHorizontal");
+
+	if (!separate && !gs_effect_get_technique(effect, "DrawMatrix"))
+		effect = obs->video.default_effect;
 
-	gs_effect_t    *effect  = get_scale_effect(video, width, height);
-	gs_technique_t *tech    = gs_effect_get_technique(effect, "DrawMatrix");
-	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t    *matrix  = gs_effect_get_param_by_name(effect,
 			"color_matrix");
 	gs_eparam_t    *bres_i  = gs_effect_get_param_by_name(effect,
 			"base_dimension_i");
-	size_t      passes, i;
+	gs_eparam_t    *sratio  = gs_effect_get_param_by_name(effect,
+			"scale_ratio");
 
-	if (!video->textures_rendered[prev_texture])
+	if (!source_mix->textures_rendered[source_texture])
 		return;
 
-	gs_set_render_target(target, NULL);
-	set_render_size(width, height);
-
 	if (bres_i)
 		gs_effect_set_vec2(bres_i, &base_i);
+	if (sratio)
+		gs_effect_set_vec2(sratio, &ratio);
 
-	gs_effect_set_val(matrix, video->color_matrix, sizeof(float) * 16);
-	gs_effect_set_texture(image, texture);
+	gs_effect_set_val(matrix, mix->color_matrix, sizeof(float) * 16);
 
 	gs_enable_blending(false);
-	passes = gs_technique_begin(tech);
-	for (i = 0; i < passes; i++) {
-		gs_technique_begin_pass(tech, i);
-		gs_draw_sprite(texture, 0, width, height);
-		gs_technique_end_pass(tech);
+	if (separate) {
+		render_scale_pass(effect, "DrawHorizontal", texture,
+				mix->scale_texture);
+		render_scale_pass(effect, "DrawVerticalMatrix",
+				mix->scale_texture, target);
+	} else {
+		render_scale_pass(effect, "DrawMatrix", texture, target);
 	}
-	gs_technique_end(tech);
 	gs_enable_blending(true);
 
-	video->textures_output[cur_texture] = true;
+	mix->textures_output[cur_texture] = true;
 }
 
-static inline void set_eparam(gs_effect_t *effect, const char *name, float val)
-{
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
-	gs_effect_set_float(param, val);
-}
-
-static void render_convert_texture(struct obs_core_video *video,
+/* each plane is drawn in to its own texture at the plane's resolution */
+static void render_convert_texture(struct obs_video_mix *mix,
 		int cur_texture, int prev_texture)
 {
-	gs_texture_t *texture = video->output_textures[prev_texture];
-	gs_texture_t *target  = video->convert_textures[cur_texture];
-	float        fwidth  = (float)video->output_width;
-	float        fheight = (float)video->output_height;
-	size_t       passes, i;
+	gs_texture_t *texture = mix->output_textures[prev_texture];
 
-	gs_effect_t    *effect  = video->conversion_effect;
-	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
-	gs_technique_t *tech    = gs_effect_get_technique(effect,
-			video->conversion_tech);
+	gs_eparam_t    *image   = obs->video.conversion_image;
 
-	if (!video->textures_output[prev_texture])
+	if (!mix->textures_output[prev_texture])
 		return;
 
-	set_eparam(effect, "u_plane_offset", (float)video->plane_offsets[1]);
-	set_eparam(effect, "v_plane_offset", (float)video->plane_offsets[2]);
-	set_eparam(effect, "width",  fwidth);
-	set_eparam(effect, "height", fheight);
-	set_eparam(effect, "width_i",  1.0f / fwidth);
-	set_eparam(effect, "height_i", 1.0f / fheight);
-	set_eparam(effect, "width_d2",  fwidth  * 0.5f);
-	set_eparam(effect, "height_d2", fheight * 0.5f);
-	set_eparam(effect, "width_d2_i",  1.0f / (fwidth  * 0.5f));
-	set_eparam(effect, "height_d2_i", 1.0f / (fheight * 0.5f));
-	set_eparam(effect, "input_height", (float)video->conversion_height);
+	gs_enable_blending(false);
 
-	gs_effect_set_texture(image, texture);
+	for (size_t p = 0; p < mix->num_planes; p++) {
+		gs_texture_t   *target = mix->convert_textures[cur_texture][p];
+		uint32_t       width   = mix->plane_widths[p];
+		uint32_t       height  = mix->plane_heights[p];
+		gs_technique_t *tech   = mix->plane_techs[p];
+		size_t         passes, i;
 
-	gs_set_render_target(target, NULL);
-	set_render_size(video->output_width, video->conversion_height);
+		gs_effect_set_texture(image, texture);
 
-	gs_enable_blending(false);
-	passes = gs_technique_begin(tech);
-	for (i = 0; i < passes; i++) {
-		gs_technique_begin_pass(tech, i);
-		gs_draw_sprite(texture, 0, video->output_width,
-				video->conversion_height);
-		gs_technique_end_pass(tech);
+		gs_set_render_target(target, NULL);
+		set_render_size(width, height);
+
+		passes = gs_technique_begin(tech);
+		for (i = 0; i < passes; i++) {
+			gs_technique_begin_pass(tech, i);
+			gs_draw_sprite(texture, 0, width, height);
+			gs_technique_end_pass(tech);
+		}
+		gs_technique_end(tech);
 	}
-	gs_technique_end(tech);
+
 	gs_enable_blending(true);
 
-	video->textures_converted[cur_texture] = true;
+	mix->textures_converted[cur_texture] = true;
 }
 
-static inline void stage_output_texture(struct obs_core_video *video,
+static inline void stage_output_texture(struct obs_video_mix *mix,
 		int cur_texture, int prev_texture)
 {
-	gs_texture_t   *texture;
-	bool        texture_ready;
-	gs_stagesurf_t *copy = video->copy_surfaces[cur_texture];
-
-	if (video->gpu_conversion) {
-		texture = video->convert_textures[prev_texture];
-		texture_ready = video->textures_converted[prev_texture];
+	gs_texture_t   **textures;
+	size_t         num_planes;
+	bool           texture_ready;
+	uint64_t       timestamp;
+
+	if (mix->gpu_conversion) {
+		textures = mix->convert_textures[prev_texture];
+		num_planes = mix->num_planes;
+		texture_ready = mix->textures_converted[prev_texture];
+		timestamp = mix->convert_timestamps[prev_texture];
 	} else {
-		texture = video->output_textures[prev_texture];
-		texture_ready = video->output_textures[prev_texture];
+		textures = &mix->output_textures[prev_texture];
+		num_planes = 1;
+		texture_ready = mix->textures_output[prev_texture];
+		timestamp = mix->output_timestamps[prev_texture];
 	}
 
-	unmap_last_surface(video);
+	unmap_last_surface(mix);
 
 	if (!texture_ready)
 		return;
 
-	gs_stage_texture(copy, texture);
+	for (size_t p = 0; p < num_planes; p++)
+		gs_stage_texture(mix->copy_surfaces[cur_texture][p],
+				textures[p]);
 
-	video->textures_copied[cur_texture] = true;
+	mix->copy_timestamps[cur_texture] = timestamp;
+	mix->textures_copied[cur_texture] = true;
 }
 
-static inline void render_video(struct obs_core_video *video, int cur_texture,
-		int prev_texture, uint64_t timestamp)
+static inline bool begin_stage_timer(struct obs_video_mix *mix,
+		enum render_stage stage)
 {
-	gs_begin_scene();
+	struct render_stage_timer *timer = &mix->stage_timers[stage];
+	size_t slot = (size_t)(obs->video.gpu_timer_frame % GPU_TIMER_FRAMES);
 
-	gs_enable_depth_test(false);
-	gs_set_cull_mode(GS_NEITHER);
+	if (!obs->video.gpu_range_active)
+		return false;
 
-	circlebuf_push_back(&video->timestamp_buffer, &timestamp,
-			sizeof(timestamp));
+	if (!timer->timers[slot])
+		timer->timers[slot] = gs_timer_create();
+	if (!timer->timers[slot])
+		return false;
 
-	render_main_texture(video, cur_texture);
-	render_output_texture(video, cur_texture, prev_texture);
-	if (video->gpu_conversion)
-		render_convert_texture(video, cur_texture, prev_texture);
+	gs_timer_begin(timer->timers[slot]);
+	return true;
+}
 
-	stage_output_texture(video, cur_texture, prev_texture);
+static inline void end_stage_timer(struct obs_video_mix *mix,
+		enum render_stage stage, bool began)
+{
+	struct render_stage_timer *timer = &mix->stage_timers[stage];
+	size_t slot = (size_t)(obs->video.gpu_timer_frame % GPU_TIMER_FRAMES);
 
-	gs_set_render_target(NULL, NULL);
-	gs_enable_blending(true);
+	if (!began)
+		return;
 
-	gs_end_scene();
+	gs_timer_end(timer->timers[slot]);
+	timer->used[slot] = true;
 }
 
-static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+/* the output lags the render by one frame and the conversion by two, so all
+ * stages are up to date num_textures + 2 frames after the last change */
+static inline bool mix_up_to_date(struct obs_video_mix *mix)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
-
-	if (!video->textures_copied[prev_texture])
+	if (!obs_view_unchanged(mix->view)) {
+		mix->static_frames = 0;
 		return false;
+	}
 
-	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
+	if (mix->static_frames < (uint32_t)mix->num_textures + 2) {
+		mix->static_frames++;
 		return false;
+	}
 
-	video->mapped_surface = surface;
 	return true;
 }
 
-static inline uint32_t calc_linesize(uint32_t pos, uint32_t linesize)
+static inline void render_stages(struct obs_video_mix *mix, int cur_texture,
+		int prev_texture)
 {
-	uint32_t size = pos % linesize;
-	return size ? size : linesize;
-}
+	bool timed;
 
-static void copy_dealign(
-		uint8_t *dst, uint32_t dst_pos, uint32_t dst_linesize,
-		const uint8_t *src, uint32_t src_pos, uint32_t src_linesize,
-		uint32_t remaining)
-{
-	while (remaining) {
-		uint32_t src_remainder = src_pos % src_linesize;
-		uint32_t dst_offset = dst_linesize - src_remainder;
-		uint32_t src_offset = src_linesize - src_remainder;
+	if (!mix->parent) {
+		timed = begin_stage_timer(mix, RENDER_STAGE_MAIN);
+		render_main_texture(mix, cur_texture);
+		end_stage_timer(mix, RENDER_STAGE_MAIN, timed);
+	}
 
-		if (remaining < dst_offset) {
-			memcpy(dst + dst_pos, src + src_pos, remaining);
-			src_pos += remaining;
-			dst_pos += remaining;
-			remaining = 0;
-		} else {
-			memcpy(dst + dst_pos, src + src_pos, dst_offset);
-			src_pos += src_offset;
-			dst_pos += dst_offset;
-			remaining -= dst_offset;
-		}
+	timed = begin_stage_timer(mix, RENDER_STAGE_SCALE);
+	render_output_texture(mix, cur_texture, prev_texture);
+	end_stage_timer(mix, RENDER_STAGE_SCALE, timed);
+
+	if (mix->gpu_conversion) {
+		timed = begin_stage_timer(mix, RENDER_STAGE_CONVERT);
+		render_convert_texture(mix, cur_texture, prev_texture);
+		end_stage_timer(mix, RENDER_STAGE_CONVERT, timed);
 	}
 }
 
-static inline uint32_t make_aligned_linesize_offset(uint32_t offset,
-		uint32_t dst_linesize, uint32_t src_linesize)
+static inline void render_video(struct obs_video_mix *mix, int cur_texture,
+		int prev_texture, uint64_t timestamp)
 {
-	uint32_t remainder = offset % dst_linesize;
-	return (offset / dst_linesize) * src_linesize + remainder;
-}
+	gs_begin_scene();
 
-static void fix_gpu_converted_alignment(struct obs_core_video *video,
-		struct video_data *frame, int cur_texture)
-{
-	struct obs_source_frame *new_frame =
-		&video->convert_frames[cur_texture];
-	uint32_t src_linesize = frame->linesize[0];
-	uint32_t dst_linesize = video->output_width * 4;
-	uint32_t src_pos      = 0;
+	gs_enable_depth_test(false);
+	gs_set_cull_mode(GS_NEITHER);
 
-	for (size_t i = 0; i < 3; i++) {
-		if (video->plane_linewidth[i] == 0)
-			break;
+	/* a rendition scales the texture its parent rendered this frame, so
+	 * its output stage is one frame ahead of the parent's */
+	mix->render_timestamps[cur_texture]  = timestamp;
+	mix->output_timestamps[cur_texture]  = mix->parent ? timestamp :
+		mix->render_timestamps[prev_texture];
+	mix->convert_timestamps[cur_texture] =
+		mix->output_timestamps[prev_texture];
+	mix->last_render_texture = cur_texture;
 
-		src_pos = make_aligned_linesize_offset(video->plane_offsets[i],
-				dst_linesize, src_linesize);
+	if (!mix_up_to_date(mix))
+		render_stages(mix, cur_texture, prev_texture);
 
-		copy_dealign(new_frame->data[i], 0, dst_linesize,
-				frame->data[0], src_pos, src_linesize,
-				video->plane_sizes[i]);
-	}
+	if (mix->cpu_output_active)
+		stage_output_texture(mix, cur_texture, prev_texture);
 
-	/* replace with cached frames */
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		frame->data[i]     = new_frame->data[i];
-		frame->linesize[i] = new_frame->linesize[i];
-	}
+	gs_set_render_target(NULL, NULL);
+	gs_enable_blending(true);
+
+	gs_end_scene();
 }
 
-static bool set_gpu_converted_data(struct obs_core_video *video,
-		struct video_data *frame, int cur_texture)
+static inline bool map_surface(struct obs_video_mix *mix,
+		gs_stagesurf_t *surface, uint8_t **data, uint32_t *linesize)
+{
+	/* offline, every frame has to be output */
+	if (video_output_get_info(mix->video)->offline)
+		return gs_stagesurface_map(surface, data, linesize);
+
+	return gs_stagesurface_try_map(surface, data, linesize);
+}
+
+/* with GPU conversion, each plane's staging surface is mapped in to the
+ * matching plane of the frame.  if the GPU hasn't finished copying to a
+ * surface yet, the frame is skipped rather than stalling the video thread;
+ * the video output repeats the previous frame in its place */
+static inline bool download_frame(struct obs_video_mix *mix,
+		int map_texture, struct video_data *frame)
 {
-	if (frame->linesize[0] == video->output_width*4) {
-		for (size_t i = 0; i < 3; i++) {
-			if (video->plane_linewidth[i] == 0)
-				break;
+	size_t num_planes = mix->gpu_conversion ? mix->num_planes : 1;
+
+	if (!mix->cpu_output_active || !mix->textures_copied[map_texture])
+		return false;
+
+	for (size_t p = 0; p < num_planes; p++) {
+		gs_stagesurf_t *surface = mix->copy_surfaces[map_texture][p];
 
-			frame->linesize[i] = video->plane_linewidth[i];
-			frame->data[i] =
-				frame->data[0] + video->plane_offsets[i];
+		if (!map_surface(mix, surface, &frame->data[p],
+					&frame->linesize[p])) {
+			unmap_last_surface(mix);
+			mix->readbacks_skipped++;
+			return false;
 		}
 
-	} else {
-		fix_gpu_converted_alignment(video, frame, cur_texture);
+		mix->mapped_surfaces[p] = surface;
 	}
 
 	return true;
 }
 
-static bool convert_frame(struct obs_core_video *video,
-		struct video_data *frame,
-		const struct video_output_info *info, int cur_texture)
+/* rows converted per job, bands have to start on even rows */
+#define CONVERT_BAND_MIN_ROWS 64
+
+struct convert_job {
+	const struct video_data        *frame;
+	struct obs_source_frame        *new_frame;
+	enum video_format              format;
+	uint32_t                       height;
+	uint32_t                       band_height;
+};
+
+static void convert_frame_band(void *param, size_t idx)
 {
-	struct obs_source_frame *new_frame =
-		&video->convert_frames[cur_texture];
+	struct convert_job *job = param;
+	uint32_t start_y = (uint32_t)idx * job->band_height;
+	uint32_t end_y   = start_y + job->band_height;
 
-	if (info->format == VIDEO_FORMAT_I420) {
-		compress_uyvx_to_i420(
-				frame->data[0], frame->linesize[0],
-				0, info->height,
-				new_frame->data, new_frame->linesize);
+	if (end_y > job->height)
+		end_y = job->height;
 
-	} else if (info->format == VIDEO_FORMAT_NV12) {
+	if (job->format == VIDEO_FORMAT_I420)
+		compress_uyvx_to_i420(
+				job->frame->data[0], job->frame->linesize[0],
+				start_y, end_y,
+				job->new_frame->data,
+				job->new_frame->linesize);
+	else
 		compress_uyvx_to_nv12(
-				frame->data[0], frame->linesize[0],
-				0, info->height,
-				new_frame->data, new_frame->linesize);
+				job->frame->data[0], job->frame->linesize[0],
+				start_y, end_y,
+				job->new_frame->data,
+				job->new_frame->linesize);
+}
 
-	} else {
+/* the frame is split into row bands that are converted on the task pool */
+static bool convert_frame(struct obs_video_mix *mix,
+		struct video_data *frame,
+		const struct video_output_info *info, int cur_texture)
+{
+	struct obs_source_frame *new_frame =
+		&mix->convert_frames[cur_texture];
+	size_t   threads = task_pool_get_num_threads(obs->video.tick_pool) + 1;
+	uint32_t band_height;
+	struct convert_job job;
+
+	if (info->format != VIDEO_FORMAT_I420 &&
+	    info->format != VIDEO_FORMAT_NV12) {
 		blog(LOG_ERROR, "convert_frame: unsupported texture format");
 		return false;
 	}
 
+	band_height = (uint32_t)((info->height + threads - 1) / threads);
+	band_height = (band_height + 1) & ~1;
+	if (band_height < CONVERT_BAND_MIN_ROWS)
+		band_height = CONVERT_BAND_MIN_ROWS;
+
+	job.frame       = frame;
+	job.new_frame   = new_frame;
+	job.format      = info->format;
+	job.height      = info->height;
+	job.band_height = band_height;
+
+	task_pool_run(obs->video.tick_pool,
+			(info->height + band_height - 1) / band_height,
+			convert_frame_band, &job);
+
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
 		frame->data[i]     = new_frame->data[i];
 		frame->linesize[i] = new_frame->linesize[i];
@@ -429,68 +666,291 @@ static bool convert_frame(struct obs_core_video *video,
 	return true;
 }
 
-static inline void output_video_data(struct obs_core_video *video,
+static inline void output_video_data(struct obs_video_mix *mix,
 		struct video_data *frame, int cur_texture)
 {
 	const struct video_output_info *info;
-	info = video_output_get_info(video->video);
+	info = video_output_get_info(mix->video);
 
-	if (video->gpu_conversion) {
-		if (!set_gpu_converted_data(video, frame, cur_texture))
+	if (!mix->gpu_conversion && format_is_yuv(info->format)) {
+		if (!convert_frame(mix, frame, info, cur_texture))
 			return;
+	}
 
-	} else if (format_is_yuv(info->format)) {
-		if (!convert_frame(video, frame, info, cur_texture))
-			return;
+	video_output_swap_frame(mix->video, frame);
+}
+
+static inline void queue_readback(struct obs_video_mix *mix,
+		struct video_data *frame, int cur_texture)
+{
+	struct obs_readback_frame readback;
+	readback.frame       = *frame;
+	readback.cur_texture = cur_texture;
+
+	pthread_mutex_lock(&mix->readback_mutex);
+	circlebuf_push_back(&mix->readback_queue, &readback,
+			sizeof(readback));
+	pthread_mutex_unlock(&mix->readback_mutex);
+
+	mix->readback_pending = true;
+	os_sem_post(mix->readback_sem);
+}
+
+static inline void output_gpu_encoders(struct obs_video_mix *mix,
+		int cur_texture)
+{
+	gs_texture_t **textures = mix->convert_textures[cur_texture];
+	uint64_t     timestamp = mix->convert_timestamps[cur_texture];
+
+	if (!mix->textures_converted[cur_texture])
+		return;
+
+	pthread_mutex_lock(&mix->gpu_encoder_mutex);
+
+	/* iterate backwards, a failing encoder removes itself */
+	for (size_t i = mix->gpu_encoders.num; i > 0; i--)
+		obs_encoder_encode_texture(mix->gpu_encoders.array[i - 1],
+				textures, timestamp);
+
+	pthread_mutex_unlock(&mix->gpu_encoder_mutex);
+}
+
+static inline void output_texture_callbacks(struct obs_video_mix *mix,
+		int cur_texture)
+{
+	gs_texture_t *texture   = mix->output_textures[cur_texture];
+	uint64_t     timestamp = mix->output_timestamps[cur_texture];
+
+	if (!mix->textures_output[cur_texture])
+		return;
+
+	pthread_mutex_lock(&mix->texture_cb_mutex);
+
+	for (size_t i = 0; i < mix->texture_callbacks.num; i++) {
+		struct video_texture_cb *cb = mix->texture_callbacks.array + i;
+		cb->callback(cb->param, texture, timestamp);
 	}
 
-	video_output_swap_frame(video->video, frame);
+	pthread_mutex_unlock(&mix->texture_cb_mutex);
 }
 
-static inline void output_frame(uint64_t timestamp)
+/* frames are only staged and read back while something is connected to the
+ * video output.  when that stops, any mapped surface is released and the
+ * staged surfaces are discarded rather than output later */
+static void update_cpu_output(struct obs_video_mix *mix)
 {
-	struct obs_core_video *video = &obs->video;
-	int cur_texture  = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
+	bool active = video_output_active(mix->video);
+
+	if (active == mix->cpu_output_active)
+		return;
+
+	unmap_last_surface(mix);
+
+	for (int i = 0; i < NUM_TEXTURES_MAX; i++)
+		mix->textures_copied[i] = false;
+
+	mix->cpu_output_active = active;
+}
+
+static inline bool has_gpu_outputs(struct obs_video_mix *mix)
+{
+	bool active;
+
+	pthread_mutex_lock(&mix->gpu_encoder_mutex);
+	active = mix->gpu_encoders.num != 0;
+	pthread_mutex_unlock(&mix->gpu_encoder_mutex);
+
+	if (!active) {
+		pthread_mutex_lock(&mix->texture_cb_mutex);
+		active = mix->texture_callbacks.num != 0;
+		pthread_mutex_unlock(&mix->texture_cb_mutex);
+	}
+
+	return active;
+}
+
+/* the textures go stale while a mix is idle, so none of them are used once
+ * it becomes active again, and obs_render_main_texture renders the view
+ * directly in the meantime */
+static void set_mix_idle(struct obs_video_mix *mix, bool idle)
+{
+	if (mix->idle == idle)
+		return;
+
+	for (int i = 0; i < NUM_TEXTURES_MAX; i++) {
+		mix->textures_rendered[i]  = false;
+		mix->textures_output[i]    = false;
+		mix->textures_converted[i] = false;
+	}
+
+	mix->static_frames = 0;
+	mix->idle          = idle;
+}
+
+/* mixes that nothing is connected to skip the render, scale, convert and
+ * stage passes entirely, which leaves a preview rendering only when its
+ * display redraws.  a rendition scales its parent's render texture, so an
+ * active rendition keeps the parent rendering */
+static void update_idle_mixes(struct obs_core_video *video)
+{
+	struct obs_video_mix *mix;
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		mix = video->mixes.array[i];
+		mix->has_outputs = video_output_active(mix->video) ||
+			has_gpu_outputs(mix);
+	}
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		mix = video->mixes.array[i];
+		if (mix->parent && mix->has_outputs)
+			mix->parent->has_outputs = true;
+	}
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		mix = video->mixes.array[i];
+		set_mix_idle(mix, !mix->has_outputs);
+	}
+}
+
+/*
+ * Each stage of the pipeline (render -> scale -> convert -> stage) works on
+ * the previous stage's result from the last frame.  The staging surface that
+ * gets mapped is the oldest one in the ring (the one that is about to be
+ * staged to again next frame), which gives the GPU num_textures-1 frames to
+ * finish the copy before the CPU waits on it.  The render timestamp of each
+ * texture's content is carried along with it from stage to stage.
+ */
+static inline void output_mix_frame(struct obs_video_mix *mix,
+		uint64_t timestamp)
+{
+	int num_textures = mix->num_textures;
+	int cur_texture  = mix->cur_texture;
+	int prev_texture = cur_texture == 0 ? num_textures-1 : cur_texture-1;
+	int map_texture  = cur_texture == num_textures-1 ? 0 : cur_texture+1;
 	struct video_data frame;
-	bool frame_ready;
 
 	memset(&frame, 0, sizeof(struct video_data));
 
+	update_cpu_output(mix);
+
+	if (mix->idle)
+		return;
+
+	render_video(mix, cur_texture, prev_texture, timestamp);
+	output_gpu_encoders(mix, cur_texture);
+	output_texture_callbacks(mix, cur_texture);
+
+	if (download_frame(mix, map_texture, &frame)) {
+		frame.timestamp = mix->copy_timestamps[map_texture];
+		queue_readback(mix, &frame, cur_texture);
+	}
+
+	if (++mix->cur_texture == num_textures)
+		mix->cur_texture = 0;
+}
+
+/* every mix is rendered from the same tick of the sources, so sources shared
+ * between mixes are only ticked once per frame */
+static inline void output_frame(uint64_t timestamp)
+{
+	struct obs_core_video *video = &obs->video;
+
 	gs_enter_context(video->graphics);
 
-	render_video(video, cur_texture, prev_texture, timestamp);
-	frame_ready = download_frame(video, prev_texture, &frame);
+	begin_gpu_timing(video);
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	update_idle_mixes(video);
+	for (size_t i = 0; i < video->mixes.num; i++)
+		output_mix_frame(video->mixes.array[i], timestamp);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	end_gpu_timing(video);
+	process_snapshots();
+	expire_filter_textures();
 
 	gs_flush();
 
 	gs_leave_context();
+}
 
-	if (frame_ready) {
-		circlebuf_pop_front(&video->timestamp_buffer, &frame.timestamp,
-				sizeof(frame.timestamp));
+static inline void update_frame_stats(struct obs_core_video *video,
+		uint64_t frame_start)
+{
+	uint64_t frame_ns = os_gettime_ns() - frame_start;
+	uint64_t avg = (uint64_t)os_atomic_load_64(&video->frame_ns);
 
-		output_video_data(video, &frame, cur_texture);
-	}
+	os_atomic_set_64(&video->frame_ns,
+			(int64_t)update_avg_ns(avg, frame_ns));
 
-	if (++video->cur_texture == NUM_TEXTURES)
-		video->cur_texture = 0;
+	if (frame_ns > video_output_get_frame_time(video->video))
+		os_atomic_inc_long(&video->lagged_frames);
 }
 
 void *obs_video_thread(void *param)
 {
 	uint64_t last_time = 0;
 
+	bmem_set_thread_tag(BMEM_TAG_GRAPHICS);
+	os_set_thread_role(OS_THREAD_ROLE_VIDEO);
+
 	while (video_output_wait(obs->video.video)) {
 		uint64_t cur_time = video_output_get_time(obs->video.video);
+		uint64_t frame_start = os_gettime_ns();
+
+		profile_start("obs_video_thread");
+
+		obs->video.render_frame++;
 
+		profile_start("tick_sources");
+		bmem_set_thread_tag(BMEM_TAG_SOURCE);
 		last_time = tick_sources(cur_time, last_time);
+		bmem_set_thread_tag(BMEM_TAG_GRAPHICS);
+		profile_end("tick_sources");
 
+		profile_start("render_displays");
 		render_displays();
+		profile_end("render_displays");
 
+		profile_start("output_frame");
 		output_frame(cur_time);
+		profile_end("output_frame");
+
+		profile_end("obs_video_thread");
+
+		update_frame_stats(&obs->video, frame_start);
+
+		/* offline, the audio mix follows the virtual video clock */
+		if (video_output_get_info(obs->video.video)->offline)
+			audio_output_set_time(obs->audio.audio, cur_time);
 	}
 
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
+
+void *obs_readback_thread(void *param)
+{
+	struct obs_video_mix *mix = param;
+
+	os_set_thread_role(OS_THREAD_ROLE_VIDEO);
+
+	while (os_sem_wait(mix->readback_sem) == 0) {
+		struct obs_readback_frame readback;
+
+		if (mix->readback_stop)
+			break;
+
+		pthread_mutex_lock(&mix->readback_mutex);
+		circlebuf_pop_front(&mix->readback_queue, &readback,
+				sizeof(readback));
+		pthread_mutex_unlock(&mix->readback_mutex);
+
+		output_video_data(mix, &readback.frame, readback.cur_texture);
+
+		os_event_signal(mix->readback_complete);
+	}
+
+	return NULL;
+}
@@ -23,6 +23,7 @@ bool obs_view_init(struct obs_view *view)
 	if (!view) return false;
 
 	pthread_mutex_init_value(&view->channels_mutex);
+	view->changed = true;
 
 	if (pthread_mutex_init(&view->channels_mutex, NULL) != 0) {
 		blog(LOG_ERROR, "obs_view_init: Failed to create mutex");
@@ -58,6 +59,7 @@ void obs_view_free(struct obs_view *view)
 void obs_view_destroy(obs_view_t *view)
 {
 	if (view) {
+		obs_view_remove(view);
 		obs_view_free(view);
 		bfree(view);
 	}
@@ -71,13 +73,13 @@ obs_source_t *obs_view_get_source(obs_view_t *view, uint32_t channel)
 	if (!view) return NULL;
 	if (channel >= MAX_CHANNELS) return NULL;
 
-	pthread_mutex_lock(&view->channels_mutex);
+	os_mutex_lock(&view->channels_mutex, "channels_mutex");
 
 	source = view->channels[channel];
 	if (source)
 		obs_source_addref(source);
 
-	pthread_mutex_unlock(&view->channels_mutex);
+	os_mutex_unlock(&view->channels_mutex, "channels_mutex");
 
 	return source;
 }
@@ -92,14 +94,15 @@ void obs_view_set_source(obs_view_t *view, uint32_t channel,
 	if (!view) return;
 	if (channel >= MAX_CHANNELS) return;
 
-	pthread_mutex_lock(&view->channels_mutex);
+	os_mutex_lock(&view->channels_mutex, "channels_mutex");
 
 	obs_source_addref(source);
 
 	prev_source = view->channels[channel];
 	view->channels[channel] = source;
+	view->changed = true;
 
-	pthread_mutex_unlock(&view->channels_mutex);
+	os_mutex_unlock(&view->channels_mutex, "channels_mutex");
 
 	if (source)
 		obs_source_activate(source, AUX_VIEW);
@@ -112,24 +115,139 @@ void obs_view_set_source(obs_view_t *view, uint32_t channel,
 
 void obs_view_render(obs_view_t *view)
 {
+	struct obs_source *sources[MAX_CHANNELS] = {0};
+	struct obs_source *removed[MAX_CHANNELS] = {0};
+
 	if (!view) return;
 
-	pthread_mutex_lock(&view->channels_mutex);
+	/* render from references taken under the lock, so setting a channel
+	 * never has to wait for a whole frame to render */
+	os_mutex_lock(&view->channels_mutex, "channels_mutex");
 
 	for (size_t i = 0; i < MAX_CHANNELS; i++) {
-		struct obs_source *source;
+		struct obs_source *source = view->channels[i];
+		if (!source)
+			continue;
+
+		if (source->removed) {
+			removed[i] = source;
+			view->channels[i] = NULL;
+		} else {
+			obs_source_addref(source);
+			sources[i] = source;
+		}
+	}
 
-		source = view->channels[i];
+	os_mutex_unlock(&view->channels_mutex, "channels_mutex");
 
-		if (source) {
-			if (source->removed) {
-				obs_source_release(source);
-				view->channels[i] = NULL;
-			} else {
-				obs_source_video_render(source);
-			}
+	for (size_t i = 0; i < MAX_CHANNELS; i++) {
+		if (sources[i]) {
+			obs_source_video_render(sources[i]);
+			obs_source_release(sources[i]);
 		}
+
+		obs_source_release(removed[i]);
+	}
+}
+
+bool obs_view_unchanged(struct obs_view *view)
+{
+	bool unchanged = !view->changed;
+
+	view->changed = false;
+
+	os_mutex_lock(&view->channels_mutex, "channels_mutex");
+
+	for (size_t i = 0; unchanged && i < MAX_CHANNELS; i++) {
+		struct obs_source *source = view->channels[i];
+
+		if (source)
+			unchanged = !source->removed &&
+				obs_source_tree_unchanged(source);
+	}
+
+	os_mutex_unlock(&view->channels_mutex, "channels_mutex");
+	return unchanged;
+}
+
+static struct obs_video_mix *find_view_mix(struct obs_view *view)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_video_mix *mix = video->mixes.array[i];
+		if (mix->view == view)
+			return mix;
 	}
 
-	pthread_mutex_unlock(&view->channels_mutex);
+	return NULL;
+}
+
+video_t *obs_view_add(obs_view_t *view, const struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_video_info mix_ovi;
+	struct obs_video_mix  *mix;
+
+	if (!obs || !view || !ovi || !video->main_mix) return NULL;
+
+	if (!obs_get_video_info(&mix_ovi))
+		return NULL;
+
+	mix_ovi.output_width   = ovi->output_width  & 0xFFFFFFFC;
+	mix_ovi.output_height  = ovi->output_height & 0xFFFFFFFE;
+	mix_ovi.output_format  = ovi->output_format;
+	mix_ovi.colorspace     = ovi->colorspace;
+	mix_ovi.range          = ovi->range;
+	mix_ovi.scale_type     = ovi->scale_type;
+	mix_ovi.gpu_conversion = ovi->gpu_conversion;
+
+	if (!mix_ovi.output_width || !mix_ovi.output_height) {
+		blog(LOG_ERROR, "obs_view_add: Invalid output size");
+		return NULL;
+	}
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	mix = find_view_mix(view);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	if (mix) {
+		blog(LOG_WARNING, "obs_view_add: View already has a mix");
+		return NULL;
+	}
+
+	mix = obs_video_mix_create(view, &mix_ovi);
+	if (!mix)
+		return NULL;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	da_push_back(video->mixes, &mix);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	return mix->video;
+}
+
+void obs_view_remove(obs_view_t *view)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_video_mix  *mix;
+
+	if (!obs || !view || !video->main_mix) return;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+
+	mix = find_view_mix(view);
+	if (mix == video->main_mix)
+		mix = NULL;
+	if (mix)
+		da_erase_item(video->mixes, &mix);
+
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	/* the graphics thread only touches mixes while holding mixes_mutex,
+	 * so the mix is no longer in use once it's out of the list */
+	if (mix) {
+		obs_video_mix_stop(mix);
+		obs_video_mix_destroy(mix);
+	}
 }
@@ -41,7 +41,7 @@ static inline void make_gs_init_data(struct gs_init_data *gid,
 }
 
 static inline void make_video_info(struct video_output_info *vi,
-		struct obs_video_info *ovi)
+		const struct obs_video_info *ovi)
 {
 	vi->name    = "video";
 	vi->format  = ovi->output_format;
@@ -51,150 +51,134 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->height  = ovi->output_height;
 	vi->range   = ovi->range;
 	vi->colorspace = ovi->colorspace;
+	vi->offline = ovi->offline;
 }
 
-#define PIXEL_SIZE 4
-
-#define GET_ALIGN(val, align) \
-	(((val) + (align-1)) & ~(align-1))
-
-static inline void set_420p_sizes(const struct obs_video_info *ovi)
+static inline void add_plane(struct obs_video_mix *mix, const char *tech,
+		uint32_t width, uint32_t height, enum gs_color_format format)
 {
-	struct obs_core_video *video = &obs->video;
-	uint32_t chroma_pixels;
-	uint32_t total_bytes;
-
-	chroma_pixels = (ovi->output_width * ovi->output_height / 4);
-	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
-
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
-	video->plane_offsets[2] = video->plane_offsets[1] + chroma_pixels;
-
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width/2;
-	video->plane_linewidth[2] = ovi->output_width/2;
-
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/4;
-	video->plane_sizes[2] = video->plane_sizes[1];
-
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
-
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
+	size_t plane = mix->num_planes++;
 
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar420";
+	mix->plane_techs[plane]   = gs_effect_get_technique(
+			obs->video.conversion_effect, tech);
+	mix->plane_widths[plane]  = width;
+	mix->plane_heights[plane] = height;
+	mix->plane_formats[plane] = format;
 }
 
-static inline void set_nv12_sizes(const struct obs_video_info *ovi)
+/* each plane of the output format is converted in to its own texture, so
+ * the mapped staging surfaces can be output as the frame's planes as-is */
+static inline void calc_gpu_conversion_planes(struct obs_video_mix *mix,
+		const struct obs_video_info *ovi)
 {
-	struct obs_core_video *video = &obs->video;
-	uint32_t chroma_pixels;
-	uint32_t total_bytes;
-
-	chroma_pixels = (ovi->output_width * ovi->output_height / 2);
-	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
-
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
-
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width;
-
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/2;
-
-	total_bytes = video->plane_offsets[1] + chroma_pixels;
-
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
-
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "NV12";
-}
+	uint32_t width  = ovi->output_width;
+	uint32_t height = ovi->output_height;
 
-static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
-{
-	obs->video.conversion_height = 0;
-	memset(obs->video.plane_offsets, 0, sizeof(obs->video.plane_offsets));
-	memset(obs->video.plane_sizes, 0, sizeof(obs->video.plane_sizes));
-	memset(obs->video.plane_linewidth, 0,
-		sizeof(obs->video.plane_linewidth));
+	mix->num_planes = 0;
 
 	switch ((uint32_t)ovi->output_format) {
 	case VIDEO_FORMAT_I420:
-		set_420p_sizes(ovi);
+		add_plane(mix, "PlaneY", width,   height,   GS_R8);
+		add_plane(mix, "PlaneU", width/2, height/2, GS_R8);
+		add_plane(mix, "PlaneV", width/2, height/2, GS_R8);
 		break;
 	case VIDEO_FORMAT_NV12:
-		set_nv12_sizes(ovi);
+		add_plane(mix, "PlaneY",  width,   height,   GS_R8);
+		add_plane(mix, "PlaneUV", width/2, height/2, GS_R8G8);
 		break;
 	}
 }
 
-static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
+static bool obs_init_gpu_conversion(struct obs_video_mix *mix,
+		const struct obs_video_info *ovi)
 {
-	struct obs_core_video *video = &obs->video;
-
-	calc_gpu_conversion_sizes(ovi);
+	calc_gpu_conversion_planes(mix, ovi);
 
-	if (!video->conversion_height) {
+	if (!mix->num_planes) {
 		blog(LOG_INFO, "GPU conversion not available for format: %u",
 				(unsigned int)ovi->output_format);
-		video->gpu_conversion = false;
+		mix->gpu_conversion = false;
 		return true;
 	}
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
-		video->convert_textures[i] = gs_texture_create(
-				ovi->output_width, video->conversion_height,
-				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
+	for (int i = 0; i < mix->num_textures; i++) {
+		for (size_t p = 0; p < mix->num_planes; p++) {
+			mix->convert_textures[i][p] = gs_texture_create(
+					mix->plane_widths[p],
+					mix->plane_heights[p],
+					mix->plane_formats[p], 1, NULL,
+					GS_RENDER_TARGET);
 
-		if (!video->convert_textures[i])
-			return false;
+			if (!mix->convert_textures[i][p])
+				return false;
+		}
 	}
 
 	return true;
 }
 
-static bool obs_init_textures(struct obs_video_info *ovi)
+static bool obs_init_textures(struct obs_video_mix *mix,
+		const struct obs_video_info *ovi)
 {
-	struct obs_core_video *video = &obs->video;
 	bool yuv = format_is_yuv(ovi->output_format);
-	uint32_t output_height = video->gpu_conversion ?
-		video->conversion_height : ovi->output_height;
-	size_t i;
+	int i;
+
+	for (i = 0; i < mix->num_textures; i++) {
+		if (mix->gpu_conversion) {
+			for (size_t p = 0; p < mix->num_planes; p++) {
+				mix->copy_surfaces[i][p] =
+					gs_stagesurface_create(
+						mix->plane_widths[p],
+						mix->plane_heights[p],
+						mix->plane_formats[p]);
+
+				if (!mix->copy_surfaces[i][p])
+					return false;
+			}
+		} else {
+			mix->copy_surfaces[i][0] = gs_stagesurface_create(
+					ovi->output_width, ovi->output_height,
+					GS_RGBA);
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
-		video->copy_surfaces[i] = gs_stagesurface_create(
-				ovi->output_width, output_height, GS_RGBA);
+			if (!mix->copy_surfaces[i][0])
+				return false;
+		}
 
-		if (!video->copy_surfaces[i])
-			return false;
+		if (!mix->parent) {
+			mix->render_textures[i] = gs_texture_create(
+					obs->video.base_width,
+					obs->video.base_height,
+					GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
-		video->render_textures[i] = gs_texture_create(
-				ovi->base_width, ovi->base_height,
-				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
-
-		if (!video->render_textures[i])
-			return false;
+			if (!mix->render_textures[i])
+				return false;
+		}
 
-		video->output_textures[i] = gs_texture_create(
+		mix->output_textures[i] = gs_texture_create(
 				ovi->output_width, ovi->output_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
 
-		if (!video->output_textures[i])
+		if (!mix->output_textures[i])
 			return false;
 
-		if (yuv)
-			obs_source_frame_init(&video->convert_frames[i],
+		if (yuv && !mix->gpu_conversion)
+			obs_source_frame_init(&mix->convert_frames[i],
 					ovi->output_format,
 					ovi->output_width,ovi->output_height);
 	}
 
+	/* 16 bit float so that the overshoot of the sharpening filters isn't
+	 * clipped between the two passes */
+	if (ovi->output_width  != obs->video.base_width ||
+	    ovi->output_height != obs->video.base_height) {
+		mix->scale_texture = gs_texture_create(
+				ovi->output_width, obs->video.base_height,
+				GS_RGBA16F, 1, NULL, GS_RENDER_TARGET);
+
+		if (!mix->scale_texture)
+			return false;
+	}
+
 	return true;
 }
 
@@ -254,6 +238,11 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 			NULL);
 	bfree(filename);
 
+	filename = find_libobs_data_file("area_scale.effect");
+	video->area_effect = gs_effect_create_from_file(filename,
+			NULL);
+	bfree(filename);
+
 	if (!video->default_effect)
 		success = false;
 	if (gs_get_device_type() == GS_DEVICE_OPENGL) {
@@ -265,12 +254,21 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	if (!video->conversion_effect)
 		success = false;
 
+	video->default_draw = gs_effect_get_technique(video->default_effect,
+			"Draw");
+	video->default_draw_matrix = gs_effect_get_technique(
+			video->default_effect, "DrawMatrix");
+	video->default_image = gs_effect_get_param_by_name(
+			video->default_effect, "image");
+	video->conversion_image = gs_effect_get_param_by_name(
+			video->conversion_effect, "image");
+
 	gs_leave_context();
 	return success ? OBS_VIDEO_SUCCESS : OBS_VIDEO_FAIL;
 }
 
-static inline void set_video_matrix(struct obs_core_video *video,
-		struct obs_video_info *ovi)
+static inline void set_video_matrix(struct obs_video_mix *mix,
+		const struct obs_video_info *ovi)
 {
 	struct matrix4 mat;
 	struct vec4 r_row;
@@ -288,52 +286,259 @@ static inline void set_video_matrix(struct obs_core_video *video,
 		matrix4_identity(&mat);
 	}
 
-	memcpy(video->color_matrix, &mat, sizeof(float) * 16);
+	memcpy(mix->color_matrix, &mat, sizeof(float) * 16);
 }
 
-static int obs_init_video(struct obs_video_info *ovi)
+static bool init_gpu_encoder_mutex(struct obs_video_mix *mix)
 {
-	struct obs_core_video *video = &obs->video;
+	pthread_mutexattr_t attr;
+	bool success = false;
+
+	/* recursive, an encoder that fails stops itself from the callback */
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		goto fail;
+	if (pthread_mutex_init(&mix->gpu_encoder_mutex, &attr) != 0)
+		goto fail;
+
+	success = true;
+
+fail:
+	pthread_mutexattr_destroy(&attr);
+	return success;
+}
+
+static bool init_mix_output(struct obs_video_mix *mix,
+		const struct obs_video_info *ovi)
+{
+	bool success;
+
+	gs_enter_context(obs->video.graphics);
+
+	success = (!mix->gpu_conversion ||
+			obs_init_gpu_conversion(mix, ovi)) &&
+		obs_init_textures(mix, ovi);
+
+	gs_leave_context();
+
+	if (!success)
+		return false;
+
+	if (pthread_mutex_init(&mix->readback_mutex, NULL) != 0)
+		return false;
+	if (!init_gpu_encoder_mutex(mix))
+		return false;
+	if (pthread_mutex_init(&mix->texture_cb_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&mix->readback_sem, 0) != 0)
+		return false;
+	if (os_event_init(&mix->readback_complete, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	mix->readback_stop = false;
+	if (pthread_create(&mix->readback_thread, NULL, obs_readback_thread,
+				mix) != 0)
+		return false;
+
+	mix->readback_thread_initialized = true;
+	return true;
+}
+
+static struct obs_video_mix *create_mix(struct obs_view *view,
+		struct obs_video_mix *parent,
+		const struct obs_video_info *ovi)
+{
+	struct obs_video_mix *mix = bzalloc(sizeof(struct obs_video_mix));
 	struct video_output_info vi;
-	int errorcode;
 
 	make_video_info(&vi, ovi);
-	video->base_width     = ovi->base_width;
-	video->base_height    = ovi->base_height;
-	video->output_width   = ovi->output_width;
-	video->output_height  = ovi->output_height;
-	video->gpu_conversion = ovi->gpu_conversion;
-	video->scale_type     = ovi->scale_type;
+	mix->view           = view;
+	mix->parent         = parent;
+	mix->output_width   = ovi->output_width;
+	mix->output_height  = ovi->output_height;
+	mix->gpu_conversion = ovi->gpu_conversion;
+	mix->scale_type     = ovi->scale_type;
+	mix->num_textures   = (int)ovi->num_textures;
+
+	pthread_mutex_init_value(&mix->readback_mutex);
+	pthread_mutex_init_value(&mix->gpu_encoder_mutex);
+	pthread_mutex_init_value(&mix->texture_cb_mutex);
+
+	set_video_matrix(mix, ovi);
+
+	if (video_output_open(&mix->video, &vi) != VIDEO_OUTPUT_SUCCESS) {
+		blog(LOG_ERROR, "Could not open video output for mix");
+		goto fail;
+	}
 
-	set_video_matrix(video, ovi);
+	if (!init_mix_output(mix, ovi))
+		goto fail;
 
-	errorcode = video_output_open(&video->video, &vi);
+	return mix;
 
-	if (errorcode != VIDEO_OUTPUT_SUCCESS) {
-		if (errorcode == VIDEO_OUTPUT_INVALIDPARAM) {
-			blog(LOG_ERROR, "Invalid video parameters specified");
-			return OBS_VIDEO_INVALID_PARAM;
-		} else {
-			blog(LOG_ERROR, "Could not open video output");
+fail:
+	obs_video_mix_stop(mix);
+	obs_video_mix_destroy(mix);
+	return NULL;
+}
+
+struct obs_video_mix *obs_video_mix_create(struct obs_view *view,
+		const struct obs_video_info *ovi)
+{
+	return create_mix(view, NULL, ovi);
+}
+
+struct obs_video_mix *obs_video_mix_create_rendition(
+		struct obs_video_mix *parent,
+		const struct obs_video_info *ovi)
+{
+	return create_mix(parent->view, parent, ovi);
+}
+
+/* the readback thread is stopped after the video thread, as the video thread
+ * may still be waiting on a pending readback */
+void obs_video_mix_stop(struct obs_video_mix *mix)
+{
+	if (mix->readback_thread_initialized) {
+		mix->readback_stop = true;
+		os_sem_post(mix->readback_sem);
+		pthread_join(mix->readback_thread, NULL);
+		mix->readback_thread_initialized = false;
+	}
+}
+
+void obs_video_mix_destroy(struct obs_video_mix *mix)
+{
+	if (!mix)
+		return;
+
+	if (mix->readbacks_skipped)
+		blog(LOG_INFO, "%"PRIu32" frame(s) were skipped because the "
+				"GPU had not finished copying them",
+				mix->readbacks_skipped);
+
+	video_output_close(mix->video);
+
+	gs_enter_context(obs->video.graphics);
+
+	for (size_t p = 0; p < MAX_AV_PLANES; p++)
+		if (mix->mapped_surfaces[p])
+			gs_stagesurface_unmap(mix->mapped_surfaces[p]);
+
+	for (size_t i = 0; i < NUM_TEXTURES_MAX; i++) {
+		for (size_t p = 0; p < MAX_AV_PLANES; p++) {
+			gs_stagesurface_destroy(mix->copy_surfaces[i][p]);
+			gs_texture_destroy(mix->convert_textures[i][p]);
 		}
+		gs_texture_destroy(mix->render_textures[i]);
+		gs_texture_destroy(mix->output_textures[i]);
+		obs_source_frame_free(&mix->convert_frames[i]);
+	}
+
+	gs_texture_destroy(mix->scale_texture);
+
+	for (size_t i = 0; i < NUM_RENDER_STAGES; i++)
+		for (size_t j = 0; j < GPU_TIMER_FRAMES; j++)
+			gs_timer_destroy(mix->stage_timers[i].timers[j]);
+
+	gs_leave_context();
+
+	circlebuf_free(&mix->readback_queue);
+	da_free(mix->gpu_encoders);
+	da_free(mix->texture_callbacks);
+
+	os_event_destroy(mix->readback_complete);
+	os_sem_destroy(mix->readback_sem);
+	pthread_mutex_destroy(&mix->readback_mutex);
+	pthread_mutex_destroy(&mix->gpu_encoder_mutex);
+	pthread_mutex_destroy(&mix->texture_cb_mutex);
+	bfree(mix);
+}
+
+struct obs_video_mix *obs_get_video_mix(const video_t *video)
+{
+	struct obs_core_video *core = &obs->video;
+	struct obs_video_mix  *mix  = NULL;
+
+	if (!video)
+		return NULL;
+
+	pthread_mutex_lock(&core->mixes_mutex);
+
+	for (size_t i = 0; i < core->mixes.num; i++) {
+		if (core->mixes.array[i]->video == video) {
+			mix = core->mixes.array[i];
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&core->mixes_mutex);
+	return mix;
+}
+
+static inline bool has_window(const struct gs_window *window)
+{
+#if defined(_WIN32)
+	return window->hwnd != NULL;
+#elif defined(__APPLE__)
+	return window->view != NULL;
+#else
+	return window->id != 0;
+#endif
+}
+
+static int obs_init_video(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	int errorcode;
+
+	video->base_width  = ovi->base_width;
+	video->base_height = ovi->base_height;
+	video->headless    = !has_window(&ovi->window);
+
+	if (video->headless)
+		blog(LOG_INFO, "No window specified, running headless");
+
+	video->frame_ns      = 0;
+	video->encode_ns     = 0;
+	video->lagged_frames = 0;
+
+	/* a realtime reset hands the audio mix back to the system clock */
+	if (!ovi->offline)
+		audio_output_set_time(obs->audio.audio, 0);
+
+	pthread_mutex_init_value(&video->mixes_mutex);
+	if (pthread_mutex_init(&video->mixes_mutex, NULL) != 0)
 		return OBS_VIDEO_FAIL;
+
+	pthread_mutex_init_value(&video->snapshot_mutex);
+	if (pthread_mutex_init(&video->snapshot_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+
+	if (!ovi->output_width || !ovi->output_height ||
+	    !ovi->fps_num || !ovi->fps_den) {
+		blog(LOG_ERROR, "Invalid video parameters specified");
+		return OBS_VIDEO_INVALID_PARAM;
 	}
 
+	video->main_mix = obs_video_mix_create(&obs->data.main_view, ovi);
+	if (!video->main_mix)
+		return OBS_VIDEO_FAIL;
+
+	video->video = video->main_mix->video;
+	da_push_back(video->mixes, &video->main_mix);
+
 	if (!obs_display_init(&video->main_display, NULL))
 		return OBS_VIDEO_FAIL;
 
 	video->main_display.cx = ovi->window_width;
 	video->main_display.cy = ovi->window_height;
 
-	gs_enter_context(video->graphics);
-
-	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
-		return OBS_VIDEO_FAIL;
-	if (!obs_init_textures(ovi))
+	video->tick_pool = task_pool_create(0);
+	if (!video->tick_pool)
 		return OBS_VIDEO_FAIL;
 
-	gs_leave_context();
-
 	errorcode = pthread_create(&video->video_thread, NULL,
 			obs_video_thread, obs);
 	if (errorcode != 0)
@@ -354,8 +559,12 @@ static void stop_video(void)
 			pthread_join(video->video_thread, &thread_retval);
 			video->thread_initialized = false;
 		}
+
+		free_snapshots();
 	}
 
+	for (size_t i = 0; i < video->mixes.num; i++)
+		obs_video_mix_stop(video->mixes.array[i]);
 }
 
 static void obs_free_video(void)
@@ -365,37 +574,38 @@ static void obs_free_video(void)
 	if (video->video) {
 		obs_display_free(&video->main_display);
 
-		video_output_close(video->video);
-		video->video = NULL;
+		/* also removes any mixes added with obs_view_add */
+		for (size_t i = 0; i < video->mixes.num; i++)
+			obs_video_mix_destroy(video->mixes.array[i]);
+
+		da_free(video->mixes);
+		pthread_mutex_destroy(&video->mixes_mutex);
+		pthread_mutex_destroy(&video->snapshot_mutex);
+		video->main_mix = NULL;
+		video->video    = NULL;
 
 		if (!video->graphics)
 			return;
 
 		gs_enter_context(video->graphics);
 
-		if (video->mapped_surface) {
-			gs_stagesurface_unmap(video->mapped_surface);
-			video->mapped_surface = NULL;
+		for (size_t i = 0; i < GPU_TIMER_FRAMES; i++) {
+			gs_timer_range_destroy(video->gpu_timer_ranges[i]);
+			video->gpu_timer_ranges[i] = NULL;
+			video->gpu_ranges_used[i]  = false;
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
-			gs_stagesurface_destroy(video->copy_surfaces[i]);
-			gs_texture_destroy(video->render_textures[i]);
-			gs_texture_destroy(video->convert_textures[i]);
-			gs_texture_destroy(video->output_textures[i]);
-			obs_source_frame_free(&video->convert_frames[i]);
-
-			video->copy_surfaces[i]    = NULL;
-			video->render_textures[i]  = NULL;
-			video->convert_textures[i] = NULL;
-			video->output_textures[i]  = NULL;
-		}
+		video->gpu_range_active = false;
+		video->gpu_timing_valid = false;
 
-		gs_leave_context();
+		free_filter_textures();
 
-		circlebuf_free(&video->timestamp_buffer);
+		gs_leave_context();
 
-		video->cur_texture = 0;
+		task_pool_destroy(video->tick_pool);
+		video->tick_pool = NULL;
+		da_free(video->tick_parallel);
+		da_free(video->tick_serial);
 	}
 }
 
@@ -406,12 +616,18 @@ static void obs_free_graphics(void)
 	if (video->graphics) {
 		gs_enter_context(video->graphics);
 
+		free_pixel_effects();
 		gs_effect_destroy(video->default_effect);
 		gs_effect_destroy(video->default_rect_effect);
 		gs_effect_destroy(video->solid_effect);
 		gs_effect_destroy(video->conversion_effect);
+		for (size_t i = 0; i < video->conversion_variants.num; i++)
+			gs_effect_destroy(
+				video->conversion_variants.array[i].effect);
+		da_free(video->conversion_variants);
 		gs_effect_destroy(video->bicubic_effect);
 		gs_effect_destroy(video->lanczos_effect);
+		gs_effect_destroy(video->area_effect);
 		video->default_effect = NULL;
 
 		gs_leave_context();
@@ -445,10 +661,13 @@ static bool obs_init_audio(struct audio_output_info *ai)
 static void obs_free_audio(void)
 {
 	struct obs_core_audio *audio = &obs->audio;
+	uint32_t level_update_rate = audio->level_update_rate;
+
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
 	memset(audio, 0, sizeof(struct obs_core_audio));
+	audio->level_update_rate = level_update_rate;
 }
 
 static bool obs_init_data(void)
@@ -459,6 +678,7 @@ static bool obs_init_data(void)
 	assert(data != NULL);
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
+	pthread_mutex_init_value(&obs->data.tree_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -470,6 +690,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->displays_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->tree_mutex, &attr) != 0)
+		goto fail;
 	if (pthread_mutex_init(&data->outputs_mutex, &attr) != 0)
 		goto fail;
 	if (pthread_mutex_init(&data->encoders_mutex, &attr) != 0)
@@ -479,6 +701,7 @@ static bool obs_init_data(void)
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
+	data->update_pool = task_pool_create(1);
 	data->valid = true;
 
 fail:
@@ -504,6 +727,13 @@ static void obs_free_data(void)
 
 	data->valid = false;
 
+	/* queued updates hold source references */
+	if (data->update_pool) {
+		task_pool_wait(data->update_pool);
+		task_pool_destroy(data->update_pool);
+		data->update_pool = NULL;
+	}
+
 	obs_view_free(&data->main_view);
 
 	blog(LOG_INFO, "Freeing OBS context data");
@@ -515,6 +745,7 @@ static void obs_free_data(void)
 	while (data->user_sources.num)
 		obs_source_remove(data->user_sources.array[0]);
 	da_free(data->user_sources);
+	hash_map_free(&data->user_source_names);
 
 	FREE_OBS_LINKED_LIST(source);
 	FREE_OBS_LINKED_LIST(output);
@@ -525,6 +756,7 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->user_sources_mutex);
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
+	pthread_mutex_destroy(&data->tree_mutex);
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
@@ -579,6 +811,7 @@ static bool obs_init(const char *locale)
 		return false;
 
 	obs->locale = bstrdup(locale);
+	obs->audio.level_update_rate = DEFAULT_LEVEL_UPDATE_RATE;
 	obs_register_source(&scene_info);
 	add_default_module_paths();
 	return true;
@@ -593,6 +826,8 @@ bool obs_startup(const char *locale)
 		return false;
 	}
 
+	profiler_start();
+
 	success = obs_init(locale);
 	if (!success)
 		obs_shutdown();
@@ -640,6 +875,10 @@ void obs_shutdown(void)
 	bfree(obs->locale);
 	bfree(obs);
 	obs = NULL;
+
+	profiler_stop();
+	profiler_print();
+	profiler_free();
 }
 
 bool obs_initialized(void)
@@ -679,6 +918,24 @@ const char *obs_get_locale(void)
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
+static bool video_mixes_active(void)
+{
+	struct obs_core_video *video = &obs->video;
+	bool active = false;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		if (video_output_active(video->mixes.array[i]->video)) {
+			active = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->mixes_mutex);
+	return active;
+}
+
 static inline bool size_valid(uint32_t width, uint32_t height)
 {
 	return (width >= OBS_SIZE_MIN && height >= OBS_SIZE_MIN &&
@@ -690,11 +947,11 @@ int obs_reset_video(struct obs_video_info *ovi)
 	if (!obs) return OBS_VIDEO_FAIL;
 
 	/* don't allow changing of video settings if active. */
-	if (obs->video.video && video_output_active(obs->video.video))
+	if (obs->video.video && video_mixes_active())
 		return OBS_VIDEO_CURRENTLY_ACTIVE;
 
-	if (!size_valid(ovi->output_width, ovi->output_height) ||
-	    !size_valid(ovi->base_width,   ovi->base_height))
+	if (ovi && (!size_valid(ovi->output_width, ovi->output_height) ||
+	            !size_valid(ovi->base_width,   ovi->base_height)))
 		return OBS_VIDEO_INVALID_PARAM;
 
 	struct obs_core_video *video = &obs->video;
@@ -702,8 +959,10 @@ int obs_reset_video(struct obs_video_info *ovi)
 	stop_video();
 	obs_free_video();
 
+	/* audio-only: no graphics, no video thread and no video output */
 	if (!ovi) {
 		obs_free_graphics();
+		blog(LOG_INFO, "video disabled, running audio only");
 		return OBS_VIDEO_SUCCESS;
 	}
 
@@ -711,6 +970,10 @@ int obs_reset_video(struct obs_video_info *ovi)
 	ovi->output_width  &= 0xFFFFFFFC;
 	ovi->output_height &= 0xFFFFFFFE;
 
+	if (ovi->num_textures < NUM_TEXTURES_DEFAULT ||
+	    ovi->num_textures > NUM_TEXTURES_MAX)
+		ovi->num_textures = NUM_TEXTURES_DEFAULT;
+
 	if (!video->graphics) {
 		int errorcode = obs_init_graphics(ovi);
 		if (errorcode != OBS_VIDEO_SUCCESS) {
@@ -722,10 +985,12 @@ int obs_reset_video(struct obs_video_info *ovi)
 	blog(LOG_INFO, "video settings reset:\n"
 	               "\tbase resolution:   %dx%d\n"
 	               "\toutput resolution: %dx%d\n"
-	               "\tfps:               %d/%d",
+	               "\tfps:               %d/%d\n"
+	               "\tbuffered frames:   %d",
 	               ovi->base_width, ovi->base_height,
 	               ovi->output_width, ovi->output_height,
-	               ovi->fps_num, ovi->fps_den);
+	               ovi->fps_num, ovi->fps_den,
+	               (int)ovi->num_textures);
 
 	return obs_init_video(ovi);
 }
@@ -745,10 +1010,11 @@ bool obs_reset_audio(struct audio_output_info *ai)
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec: %d\n"
 	               "\tspeakers:        %d\n"
-	               "\tbuffering (ms):  %d\n",
+	               "\tbuffering (ms):  %d%s\n",
 	               (int)ai->samples_per_sec,
 	               (int)ai->speakers,
-	               (int)ai->buffer_ms);
+	               (int)ai->buffer_ms,
+	               ai->adaptive_buffering ? " (adaptive)" : "");
 
 	return obs_init_audio(ai);
 }
@@ -768,8 +1034,8 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	memset(ovi, 0, sizeof(struct obs_video_info));
 	ovi->base_width    = video->base_width;
 	ovi->base_height   = video->base_height;
-	ovi->gpu_conversion= video->gpu_conversion;
-	ovi->scale_type    = video->scale_type;
+	ovi->gpu_conversion= video->main_mix->gpu_conversion;
+	ovi->scale_type    = video->main_mix->scale_type;
 	ovi->colorspace    = info->colorspace;
 	ovi->range         = info->range;
 	ovi->output_width  = info->width;
@@ -777,6 +1043,8 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	ovi->output_format = info->format;
 	ovi->fps_num       = info->fps_num;
 	ovi->fps_den       = info->fps_den;
+	ovi->num_textures  = (uint32_t)video->main_mix->num_textures;
+	ovi->offline       = info->offline;
 
 	return true;
 }
@@ -795,6 +1063,70 @@ bool obs_get_audio_info(struct audio_output_info *aoi)
 	return true;
 }
 
+bool obs_get_video_gpu_stats(struct obs_video_gpu_stats *stats)
+{
+	struct obs_video_mix *mix;
+
+	if (!obs || !stats || !obs->video.video)
+		return false;
+
+	mix = obs->video.main_mix;
+
+	/* stage timers are only ever created if the device supports them */
+	if (!mix->stage_timers[RENDER_STAGE_MAIN].timers[0])
+		return false;
+
+	stats->render_ns  = mix->stage_timers[RENDER_STAGE_MAIN].avg_ns;
+	stats->scale_ns   = mix->stage_timers[RENDER_STAGE_SCALE].avg_ns;
+	stats->convert_ns = mix->stage_timers[RENDER_STAGE_CONVERT].avg_ns;
+	return true;
+}
+
+void obs_get_perf_stats(struct obs_perf_stats *stats)
+{
+	struct obs_video_gpu_stats gpu_stats;
+	struct obs_output *output;
+	video_t *video;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	video = obs->video.video;
+	if (video) {
+		stats->frame_ns  = (uint64_t)os_atomic_load_64(
+				&obs->video.frame_ns);
+		stats->encode_ns = (uint64_t)os_atomic_load_64(
+				&obs->video.encode_ns);
+		stats->lagged_frames = (uint32_t)os_atomic_load_long(
+				&obs->video.lagged_frames);
+		stats->total_frames   = video_output_get_total_frames(video);
+		stats->skipped_frames = video_output_get_skipped_frames(video);
+	}
+
+	if (obs_get_video_gpu_stats(&gpu_stats))
+		stats->gpu_render_ns = gpu_stats.render_ns +
+			gpu_stats.scale_ns + gpu_stats.convert_ns;
+
+	if (obs->audio.audio)
+		stats->audio_buffer_ms =
+			audio_output_get_buffer_ms(obs->audio.audio);
+
+	pthread_mutex_lock(&obs->data.outputs_mutex);
+
+	output = obs->data.first_output;
+	while (output && stats->num_outputs < OBS_PERF_MAX_OUTPUTS) {
+		obs_output_get_perf_stats(output,
+				&stats->outputs[stats->num_outputs++]);
+		output = (struct obs_output*)output->context.next;
+	}
+
+	pthread_mutex_unlock(&obs->data.outputs_mutex);
+}
+
 bool obs_enum_input_types(size_t idx, const char **id)
 {
 	if (!obs) return false;
@@ -877,6 +1209,97 @@ video_t *obs_get_video(void)
 	return (obs != NULL) ? obs->video.video : NULL;
 }
 
+video_t *obs_add_video_rendition(const struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_video_info mix_ovi;
+	struct obs_video_mix  *mix;
+
+	if (!obs || !ovi || !video->main_mix) return NULL;
+
+	if (!obs_get_video_info(&mix_ovi))
+		return NULL;
+
+	mix_ovi.output_width   = ovi->output_width  & 0xFFFFFFFC;
+	mix_ovi.output_height  = ovi->output_height & 0xFFFFFFFE;
+	mix_ovi.output_format  = ovi->output_format;
+	mix_ovi.colorspace     = ovi->colorspace;
+	mix_ovi.range          = ovi->range;
+	mix_ovi.scale_type     = ovi->scale_type;
+	mix_ovi.gpu_conversion = ovi->gpu_conversion;
+
+	if (!mix_ovi.output_width || !mix_ovi.output_height) {
+		blog(LOG_ERROR, "obs_add_video_rendition: Invalid output size");
+		return NULL;
+	}
+
+	mix = obs_video_mix_create_rendition(video->main_mix, &mix_ovi);
+	if (!mix)
+		return NULL;
+
+	/* renditions are always after the main mix in the list, so the main
+	 * mix has rendered the frame by the time they scale it */
+	pthread_mutex_lock(&video->mixes_mutex);
+	da_push_back(video->mixes, &mix);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	return mix->video;
+}
+
+void obs_remove_video_rendition(video_t *output)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_video_mix  *mix   = NULL;
+
+	if (!obs || !output || !video->main_mix) return;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_video_mix *cur = video->mixes.array[i];
+		if (cur->video == output && cur->parent) {
+			mix = cur;
+			da_erase(video->mixes, i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	if (mix) {
+		obs_video_mix_stop(mix);
+		obs_video_mix_destroy(mix);
+	}
+}
+
+void obs_add_video_texture_callback(video_t *video,
+		obs_video_texture_cb callback, void *param)
+{
+	struct obs_video_mix   *mix = obs_get_video_mix(video);
+	struct video_texture_cb data = {callback, param};
+
+	if (!mix || !callback)
+		return;
+
+	pthread_mutex_lock(&mix->texture_cb_mutex);
+	da_push_back(mix->texture_callbacks, &data);
+	pthread_mutex_unlock(&mix->texture_cb_mutex);
+}
+
+void obs_remove_video_texture_callback(video_t *video,
+		obs_video_texture_cb callback, void *param)
+{
+	struct obs_video_mix   *mix = obs_get_video_mix(video);
+	struct video_texture_cb data = {callback, param};
+
+	if (!mix)
+		return;
+
+	pthread_mutex_lock(&mix->texture_cb_mutex);
+	da_erase_item(mix->texture_callbacks, &data);
+	pthread_mutex_unlock(&mix->texture_cb_mutex);
+}
+
 /* TODO: optimize this later so it's not just O(N) string lookups */
 static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
@@ -944,10 +1367,11 @@ bool obs_add_source(obs_source_t *source)
 	if (!obs) return false;
 	if (!source) return false;
 
-	pthread_mutex_lock(&obs->data.sources_mutex);
+	pthread_mutex_lock(&obs->data.user_sources_mutex);
 	da_push_back(obs->data.user_sources, &source);
+	obs_user_source_name_add(source);
 	obs_source_addref(source);
-	pthread_mutex_unlock(&obs->data.sources_mutex);
+	pthread_mutex_unlock(&obs->data.user_sources_mutex);
 
 	calldata_set_ptr(&params, "source", source);
 	signal_handler_signal(obs->signals, "source_add", &params);
@@ -973,7 +1397,7 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 	struct obs_view *view = &obs->data.main_view;
 	struct calldata params = {0};
 
-	pthread_mutex_lock(&view->channels_mutex);
+	os_mutex_lock(&view->channels_mutex, "channels_mutex");
 
 	obs_source_addref(source);
 
@@ -988,7 +1412,7 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	view->channels[channel] = source;
 
-	pthread_mutex_unlock(&view->channels_mutex);
+	os_mutex_unlock(&view->channels_mutex, "channels_mutex");
 
 	if (source)
 		obs_source_activate(source, MAIN_VIEW);
@@ -1058,24 +1482,50 @@ void obs_enum_services(bool (*enum_proc)(void*, obs_service_t*), void *param)
 			enum_proc, param);
 }
 
-obs_source_t *obs_get_source_by_name(const char *name)
+void obs_user_source_name_add(obs_source_t *source)
+{
+	struct hash_map *names = &obs->data.user_source_names;
+	const char *name = source->context.name;
+
+	if (name && !hash_map_find(names, name))
+		hash_map_set(names, name, source);
+}
+
+void obs_user_source_name_remove(obs_source_t *source, const char *name)
 {
 	struct obs_core_data *data = &obs->data;
-	struct obs_source *source = NULL;
-	size_t i;
 
-	if (!obs) return NULL;
+	if (!name || hash_map_find(&data->user_source_names, name) != source)
+		return;
 
-	pthread_mutex_lock(&data->user_sources_mutex);
+	hash_map_remove(&data->user_source_names, name);
 
-	for (i = 0; i < data->user_sources.num; i++) {
+	/* another source may have been added with the same name */
+	for (size_t i = 0; i < data->user_sources.num; i++) {
 		struct obs_source *cur_source = data->user_sources.array[i];
-		if (strcmp(cur_source->context.name, name) == 0) {
-			source = cur_source;
-			obs_source_addref(source);
+		const char *cur_name = cur_source->context.name;
+
+		if (cur_source != source && cur_name &&
+		    strcmp(cur_name, name) == 0) {
+			hash_map_set(&data->user_source_names, cur_name,
+					cur_source);
 			break;
 		}
 	}
+}
+
+obs_source_t *obs_get_source_by_name(const char *name)
+{
+	struct obs_core_data *data = &obs->data;
+	struct obs_source *source = NULL;
+
+	if (!obs || !name) return NULL;
+
+	pthread_mutex_lock(&data->user_sources_mutex);
+
+	source = hash_map_find(&data->user_source_names, name);
+	if (source)
+		obs_source_addref(source);
 
 	pthread_mutex_unlock(&data->user_sources_mutex);
 	return source;
@@ -1181,6 +1631,61 @@ void obs_render_main_view(void)
 	obs_view_render(&obs->data.main_view);
 }
 
+void obs_render_main_texture(void)
+{
+	struct obs_video_mix *mix;
+	gs_texture_t         *tex;
+	gs_technique_t       *tech;
+	size_t               passes;
+	int                  idx;
+
+	if (!obs) return;
+
+	/* displays are drawn before the mixes, so this is the texture the
+	 * main mix rendered last frame.  an idle main mix doesn't render, and
+	 * the view is drawn directly instead */
+	mix = obs->video.main_mix;
+	idx = mix ? mix->last_render_texture : 0;
+
+	if (!mix || !mix->textures_rendered[idx]) {
+		obs_render_main_view();
+		return;
+	}
+
+	tex  = mix->render_textures[idx];
+	tech = obs->video.default_draw;
+	gs_effect_set_texture(obs->video.default_image, tex);
+
+	gs_enable_blending(false);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(tex, 0, 0, 0);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	gs_enable_blending(true);
+}
+
+void obs_set_main_display_interval(uint32_t interval)
+{
+	if (!obs) return;
+	obs_display_set_interval(&obs->video.main_display, interval);
+}
+
+void obs_set_displays_enabled(bool enabled)
+{
+	if (!obs) return;
+	obs->data.displays_disabled = !enabled;
+}
+
+bool obs_displays_enabled(void)
+{
+	return obs ? !obs->data.displays_disabled : false;
+}
+
 void obs_set_master_volume(float volume)
 {
 	struct calldata data = {0};
@@ -1211,6 +1716,17 @@ float obs_get_present_volume(void)
 	return obs ? obs->audio.present_volume : 0.0f;
 }
 
+void obs_set_volume_level_update_rate(uint32_t updates_per_sec)
+{
+	if (!obs) return;
+	obs->audio.level_update_rate = updates_per_sec;
+}
+
+uint32_t obs_get_volume_level_update_rate(void)
+{
+	return obs ? obs->audio.level_update_rate : 0;
+}
+
 obs_source_t *obs_load_source(obs_data_t *source_data)
 {
 	obs_source_t *source;
@@ -1218,18 +1734,32 @@ obs_source_t *obs_load_source(obs_data_t *source_data)
 	const char   *id      = obs_data_get_string(source_data, "id");
 	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
 	double       volume;
+	uint32_t     mixers;
 
-	source = obs_source_create(OBS_SOURCE_TYPE_INPUT, id, name, settings);
+	source = obs_source_create_internal(OBS_SOURCE_TYPE_INPUT, id, name,
+			settings, obs->data.defer_source_creation &&
+			strcmp(id, "scene") != 0);
 
 	obs_data_set_default_double(source_data, "volume", 1.0);
 	volume = obs_data_get_double(source_data, "volume");
 	obs_source_set_volume(source, (float)volume);
 
+	obs_data_set_default_int(source_data, "mixers",
+			(1 << MAX_AUDIO_MIXES) - 1);
+	mixers = (uint32_t)obs_data_get_int(source_data, "mixers");
+	obs_source_set_audio_mixers(source, mixers);
+
 	obs_data_release(settings);
 
 	return source;
 }
 
+void obs_set_deferred_source_creation(bool defer)
+{
+	if (!obs) return;
+	obs->data.defer_source_creation = defer;
+}
+
 void obs_load_sources(obs_data_array_t *array)
 {
 	size_t count;
@@ -1263,6 +1793,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_data_t *source_data = obs_data_create();
 	obs_data_t *settings    = obs_source_get_settings(source);
 	float      volume      = obs_source_get_volume(source);
+	uint32_t   mixers      = obs_source_get_audio_mixers(source);
 	const char *name       = obs_source_get_name(source);
 	const char *id         = obs_source_get_id(source);
 
@@ -1272,6 +1803,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_data_set_string(source_data, "id",       id);
 	obs_data_set_obj   (source_data, "settings", settings);
 	obs_data_set_double(source_data, "volume",   volume);
+	obs_data_set_int   (source_data, "mixers",   mixers);
 
 	obs_data_release(settings);
 
@@ -49,6 +49,7 @@ struct obs_service;
 struct obs_module;
 struct obs_fader;
 struct obs_volmeter;
+struct obs_pixel_effect;
 
 typedef struct obs_display    obs_display_t;
 typedef struct obs_view       obs_view_t;
@@ -61,6 +62,7 @@ typedef struct obs_service    obs_service_t;
 typedef struct obs_module     obs_module_t;
 typedef struct obs_fader      obs_fader_t;
 typedef struct obs_volmeter   obs_volmeter_t;
+typedef struct obs_pixel_effect obs_pixel_effect_t;
 
 #include "obs-source.h"
 #include "obs-encoder.h"
@@ -107,7 +109,8 @@ enum obs_allow_direct_render {
 enum obs_scale_type {
 	OBS_SCALE_BICUBIC,
 	OBS_SCALE_BILINEAR,
-	OBS_SCALE_LANCZOS
+	OBS_SCALE_LANCZOS,
+	OBS_SCALE_AREA
 };
 
 /**
@@ -161,7 +164,12 @@ struct obs_video_info {
 	/** Video adapter index to use (NOTE: avoid for optimus laptops) */
 	uint32_t            adapter;
 
-	struct gs_window    window;        /**< Window to render to */
+	/**
+	 * Window to render to.  Leave zeroed to run headless: the main
+	 * display is then never rendered, and displays are only rendered
+	 * when created with obs_display_create.
+	 */
+	struct gs_window    window;
 
 	/** Use shaders to convert to different color formats */
 	bool                gpu_conversion;
@@ -170,6 +178,24 @@ struct obs_video_info {
 	enum video_range_type range;       /**< YUV range (if YUV) */
 
 	enum obs_scale_type scale_type;    /**< How to scale if scaling */
+
+	/**
+	 * Number of frames the GPU render/stage ring is buffered by (2-4).
+	 * Higher values add latency but give the GPU more time to finish
+	 * writing a staging surface before it gets mapped.  0 uses the
+	 * default value.
+	 */
+	uint32_t            num_textures;
+
+	/**
+	 * Render offline: frames are rendered as fast as the GPU and the
+	 * encoders allow instead of in real time, on a virtual clock that
+	 * advances one frame per frame rendered.  The audio mix follows the
+	 * same clock.  Meant for batch rendering from recorded inputs;
+	 * sources timestamping their data with the system clock (such as
+	 * capture devices) will not line up.
+	 */
+	bool                offline;
 };
 
 /**
@@ -219,6 +245,18 @@ struct obs_source_frame {
 	float               color_range_min[3];
 	float               color_range_max[3];
 	bool                flip;
+
+	/**
+	 * Optional.  If set, this is called instead of freeing the frame once
+	 * libobs no longer needs it, which allows frames output with
+	 * obs_source_output_video_owned to point directly to memory owned by
+	 * the source (such as capture device buffers).  The callback is
+	 * responsible for freeing the frame structure itself.  It can be
+	 * called from any thread, including after the source was destroyed.
+	 */
+	void                (*release)(void *param,
+	                               struct obs_source_frame *frame);
+	void                *release_param;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -258,8 +296,14 @@ EXPORT const char *obs_get_locale(void);
  * @note The graphics module cannot be changed without fully destroying the
  *       OBS context.
  *
+ * Passing NULL shuts video down along with the graphics subsystem, for
+ * audio-only use: no video thread runs and obs_get_video returns NULL.
+ * Audio sources, audio encoders and outputs that support it (the FLV and
+ * RTMP outputs, for example) keep working, outputs simply don't capture
+ * video.  Video can be enabled again with another call.
+ *
  * @param   ovi  Pointer to an obs_video_info structure containing the
- *               specification of the graphics subsystem,
+ *               specification of the graphics subsystem, or NULL
  * @return       OBS_VIDEO_SUCCESS if sucessful
  *               OBS_VIDEO_NOT_SUPPORTED if the adapter lacks capabilities
  *               OBS_VIDEO_INVALID_PARAM if a parameter is invalid
@@ -282,6 +326,58 @@ EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct audio_output_info *ai);
 
+/** Average GPU time per frame of each pass of the output render, in ns */
+struct obs_video_gpu_stats {
+	uint64_t render_ns;  /**< rendering the main view */
+	uint64_t scale_ns;   /**< scaling to the output resolution */
+	uint64_t convert_ns; /**< converting to the output format */
+};
+
+/**
+ * Gets the average GPU time of the output render passes.  The results are
+ * read back a few frames after they were issued so the render is never
+ * stalled.  Returns false if there is no video or the graphics device has
+ * no timer query support.
+ */
+EXPORT bool obs_get_video_gpu_stats(struct obs_video_gpu_stats *stats);
+
+#define OBS_PERF_MAX_OUTPUTS 8
+
+/** Performance counters of one output */
+struct obs_perf_output_stats {
+	char     name[64];
+	bool     active;
+	int      frames_dropped;
+	size_t   queued_packets;  /**< interleaved and output queued packets */
+};
+
+/**
+ * Snapshot of the performance counters of the whole pipeline.  Frame counts
+ * are totals since video was reset; times are running averages.
+ */
+struct obs_perf_stats {
+	uint64_t frame_ns;        /**< video thread time per frame */
+	uint64_t gpu_render_ns;   /**< GPU time of the output render passes */
+	uint64_t encode_ns;       /**< time of a video encode call */
+
+	uint32_t total_frames;
+	uint32_t skipped_frames;  /**< frames the video output missed */
+	uint32_t lagged_frames;   /**< frames that took longer than the
+	                               frame interval to render */
+
+	uint64_t audio_buffer_ms;
+
+	size_t   num_outputs;
+	struct obs_perf_output_stats outputs[OBS_PERF_MAX_OUTPUTS];
+};
+
+/**
+ * Fills in all performance counters at once.  This only reads counters that
+ * are already kept up to date, so it is cheap enough to call from a UI timer.
+ * Only the first OBS_PERF_MAX_OUTPUTS outputs are included.
+ */
+EXPORT void obs_get_perf_stats(struct obs_perf_stats *stats);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -422,6 +518,40 @@ EXPORT audio_t *obs_get_audio(void);
 /** Gets the main video output handler for this OBS context */
 EXPORT video_t *obs_get_video(void);
 
+/**
+ * Adds a rendition of the main video at another output size.
+ *
+ *   The main view is not rendered again; each frame the main render texture
+ * is scaled and converted to the rendition's output size and format on the
+ * GPU, so encoders using the rendition don't have to scale on the CPU.  Only
+ * the output size/format, color settings, scale type and GPU conversion are
+ * taken from ovi.  Renditions are removed when video is reset.
+ *
+ * @return  The video output of the rendition, or NULL on failure
+ */
+EXPORT video_t *obs_add_video_rendition(const struct obs_video_info *ovi);
+
+/** Removes a rendition added with obs_add_video_rendition */
+EXPORT void obs_remove_video_rendition(video_t *video);
+
+typedef void (*obs_video_texture_cb)(void *param, gs_texture_t *texture,
+		uint64_t timestamp);
+
+/**
+ * Adds a callback that receives the output texture of a video output (the
+ * main video, a view's video or a rendition) each frame.
+ *
+ *   The callback is called from the graphics thread, inside the graphics
+ * context, with the RGBA texture at the output size.  It is only valid for
+ * the duration of the call, so it can be copied or drawn from on the GPU
+ * (e.g. to share it with other applications) without any readback.  The
+ * callback must not add or remove texture callbacks itself.
+ */
+EXPORT void obs_add_video_texture_callback(video_t *video,
+		obs_video_texture_cb callback, void *param);
+EXPORT void obs_remove_video_texture_callback(video_t *video,
+		obs_video_texture_cb callback, void *param);
+
 /**
  * Adds a source to the user source list and increments the reference counter
  * for that source.
@@ -516,6 +646,22 @@ EXPORT void obs_resize(uint32_t cx, uint32_t cy);
 /** Renders the main view */
 EXPORT void obs_render_main_view(void);
 
+/**
+ * Draws the last frame rendered for the main output at base resolution,
+ * rather than rendering the main view again.  Meant for previews, which
+ * then cost a single textured quad per frame.  The frame is the one rendered
+ * on the previous video tick.  Falls back to rendering the main view if no
+ * frame has been rendered yet.
+ */
+EXPORT void obs_render_main_texture(void);
+
+/**
+ * Only redraws the main display once every 'interval' frames, or not at all
+ * when 0.  Used to reduce preview updates while the window is in the
+ * background or minimized.  Defaults to 1.
+ */
+EXPORT void obs_set_main_display_interval(uint32_t interval);
+
 /** Sets the master user volume */
 EXPORT void obs_set_master_volume(float volume);
 
@@ -528,12 +674,30 @@ EXPORT float obs_get_master_volume(void);
 /** Gets the master presentation volume */
 EXPORT float obs_get_present_volume(void);
 
+/**
+ * Sets how many times per second sources send volume level signals.  Levels
+ * are still calculated for every audio packet.  0 signals every packet.
+ */
+EXPORT void obs_set_volume_level_update_rate(uint32_t updates_per_sec);
+
+/** Gets the number of volume level signals per second */
+EXPORT uint32_t obs_get_volume_level_update_rate(void);
+
 /** Saves a source to settings data */
 EXPORT obs_data_t *obs_save_source(obs_source_t *source);
 
 /** Loads a source from settings data */
 EXPORT obs_source_t *obs_load_source(obs_data_t *data);
 
+/**
+ * Sets whether sources loaded with obs_load_source/obs_load_sources are
+ * created by their plugin right away, or only when they're first shown or
+ * activated (or obs_source_instantiate is called).  Until then, a source only
+ * holds its settings, so sources of scenes that are never shown don't open
+ * devices or load files.  Scenes are always created right away.
+ */
+EXPORT void obs_set_deferred_source_creation(bool defer);
+
 /** Loads sources from a data array */
 EXPORT void obs_load_sources(obs_data_array_t *array);
 
@@ -566,6 +730,25 @@ EXPORT obs_source_t *obs_view_get_source(obs_view_t *view,
 /** Renders the sources of this view context */
 EXPORT void obs_view_render(obs_view_t *view);
 
+/**
+ * Adds a video mix for this view context, which renders the view to its own
+ * set of textures and outputs it to its own video output.
+ *
+ *   The mix is rendered on the graphics thread along with the main view, so
+ * sources shared between views are only ticked once.  Mixes always use the
+ * base resolution, frame rate and buffering of the main video; only the
+ * output size/format, color settings, scale type and GPU conversion are
+ * taken from ovi.  Mixes are removed when video is reset.
+ *
+ * @return  The video output of the mix, or NULL if the view already has a
+ *          mix or the mix could not be created
+ */
+EXPORT video_t *obs_view_add(obs_view_t *view,
+		const struct obs_video_info *ovi);
+
+/** Removes the video mix of this view context, if any */
+EXPORT void obs_view_remove(obs_view_t *view);
+
 
 /* ------------------------------------------------------------------------- */
 /* Display context */
@@ -604,6 +787,43 @@ EXPORT void obs_display_remove_draw_callback(obs_display_t *display,
 		void (*draw)(void *param, uint32_t cx, uint32_t cy),
 		void *param);
 
+/**
+ * Only redraws this display once every 'interval' frames, or not at all
+ * when 0.  Defaults to 1.
+ */
+EXPORT void obs_display_set_interval(obs_display_t *display,
+		uint32_t interval);
+
+/**
+ * Limits how often this display is redrawn to at most 'fps' frames per
+ * second, in whole output frames.  0 redraws it at the output frame rate,
+ * which is the default.
+ */
+EXPORT void obs_display_set_fps(obs_display_t *display, uint32_t fps);
+
+/**
+ * Draws the sources in a grid of 'columns' columns (0 for a square grid),
+ * before any draw callbacks.  Each source is rendered straight in to its
+ * cell at the cell's size, scaled down from the base resolution, so a cell
+ * costs no more than a preview of that size.  Sources that are also drawn
+ * elsewhere (the program scene, for example) are only rendered once per
+ * frame.  Combine with obs_display_set_fps to refresh the grid less often.
+ *
+ * The display keeps a reference to the sources.  Passing no sources turns
+ * the grid off.
+ */
+EXPORT void obs_display_set_multiview(obs_display_t *display,
+		obs_source_t **sources, size_t num, uint32_t columns);
+
+/**
+ * Enables or disables drawing all displays, including the main display.
+ * While disabled, the video thread doesn't touch any swap chain.
+ */
+EXPORT void obs_set_displays_enabled(bool enabled);
+
+/** Returns whether displays are drawn */
+EXPORT bool obs_displays_enabled(void);
+
 
 /* ------------------------------------------------------------------------- */
 /* Sources */
@@ -653,12 +873,73 @@ EXPORT obs_properties_t *obs_get_source_properties(enum obs_source_type type,
  */
 EXPORT obs_properties_t *obs_source_properties(const obs_source_t *source);
 
-/** Updates settings for this source */
+/**
+ * Updates settings for this source.  The source's update callback is not
+ * called from this function: synchronous video sources are updated on the
+ * video thread before their next tick, and other sources on a worker thread,
+ * with several updates in a row applied at once.
+ */
 EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Gets the source as rendered this frame, at its own size, for drawing it
+ * with a custom effect (the incoming scene of a transition, for example).
+ * The source is rendered in to its render-once cache unless something drew
+ * it already this frame, so a scene that is also on the preview or a
+ * multiview isn't rendered twice.  Call from the graphics thread, the
+ * texture is only valid for the current frame.
+ *
+ * @return NULL if the source has no video or can't be cached (filters and
+ *         sources with OBS_SOURCE_NO_RENDER_CACHE)
+ */
+EXPORT gs_texture_t *obs_source_get_frame_texture(obs_source_t *source);
+
+/** Average per-frame render cost of a source, in nanoseconds */
+struct obs_source_render_stats {
+	uint64_t tick_ns;   /**< CPU time spent ticking the source */
+	uint64_t render_ns; /**< CPU time spent rendering (with filters) */
+	uint64_t gpu_ns;    /**< GPU time of the first render, 0 if unknown */
+};
+
+/**
+ * Gets the average time a source has spent ticking and rendering per frame.
+ * GPU times are only available on devices that support timer queries, and
+ * lag a few frames behind the CPU times.
+ */
+EXPORT void obs_source_get_render_stats(const obs_source_t *source,
+		struct obs_source_render_stats *stats);
+
+typedef void (*obs_source_snapshot_cb)(void *param, obs_source_t *source,
+		const uint8_t *data, uint32_t linesize,
+		uint32_t cx, uint32_t cy);
+
+/** Largest width/height of a snapshot */
+#define OBS_SNAPSHOT_MAX_SIZE 512
+
+/**
+ * Requests a downscaled RGBA image of a source, for thumbnails and previews.
+ * The source is rendered straight in to a cx x cy render target on the
+ * graphics thread (stretched to that size, keep the aspect ratio yourself)
+ * and read back a frame later through a small staging surface, so a
+ * snapshot costs about as much as drawing the source in a preview of that
+ * size plus cx * cy * 4 bytes of readback.
+ *
+ *   The callback is called once, from the graphics thread, and the data is
+ * only valid for the duration of the call.  data is NULL if the source had
+ * no video to render or video was shut down before the snapshot was taken.
+ * The source is referenced until the callback returns.
+ *
+ * @return false if the size is 0 or larger than OBS_SNAPSHOT_MAX_SIZE, or
+ *         video isn't initialized, in which case the callback is never
+ *         called
+ */
+EXPORT bool obs_source_request_snapshot(obs_source_t *source,
+		uint32_t cx, uint32_t cy, obs_source_snapshot_cb callback,
+		void *param);
+
 /** Gets the width of a source (if it has video) */
 EXPORT uint32_t obs_source_get_width(const obs_source_t *source);
 
@@ -716,6 +997,15 @@ EXPORT float obs_source_get_volume(const obs_source_t *source);
 /** Gets the presentation volume for a source */
 EXPORT float obs_source_get_present_volume(const obs_source_t *source);
 
+/**
+ * Sets the mask of audio mixes (tracks) the source's audio is mixed in to,
+ * bit N being mix N.  By default a source is in every mix
+ */
+EXPORT void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers);
+
+/** Gets the mask of audio mixes the source's audio is mixed in to */
+EXPORT uint32_t obs_source_get_audio_mixers(const obs_source_t *source);
+
 /** Sets the audio sync offset (in nanoseconds) for a source */
 EXPORT void obs_source_set_sync_offset(obs_source_t *source, int64_t offset);
 
@@ -735,6 +1025,16 @@ EXPORT void obs_source_enum_tree(obs_source_t *source,
 /** Returns true if active, false if not */
 EXPORT bool obs_source_active(const obs_source_t *source);
 
+/**
+ * Marks the source as shown in an extra view (such as a properties window)
+ * that draws it outside of the main output.  Every call must be paired with a
+ * call to obs_source_dec_showing.
+ */
+EXPORT void obs_source_inc_showing(obs_source_t *source);
+
+/** Releases a reference taken with obs_source_inc_showing */
+EXPORT void obs_source_dec_showing(obs_source_t *source);
+
 /**
  * Sometimes sources need to be told when to save their settings so they
  * don't have to constantly update and keep track of their settings.  This will
@@ -751,7 +1051,18 @@ EXPORT void obs_source_save(obs_source_t *source);
  */
 EXPORT void obs_source_load(obs_source_t *source);
 
-/** Specifies that async video frames should be played as soon as possible */
+/**
+ * Creates the plugin data of a source whose creation was deferred when it
+ * was loaded, such as before showing its properties.  Does nothing if the
+ * source has already been created.
+ */
+EXPORT void obs_source_instantiate(obs_source_t *source);
+
+/**
+ * Specifies that async video frames should be played as soon as possible.
+ * Only the newest frame is kept, older frames are freed as soon as a new
+ * frame is output.
+ */
 #define OBS_SOURCE_UNBUFFERED (1<<0)
 
 /** Sets source flags.  Note that these are different from the main output
@@ -761,6 +1072,42 @@ EXPORT void obs_source_set_flags(obs_source_t *source, uint32_t flags);
 /** Gets source flags. */
 EXPORT uint32_t obs_source_get_flags(const obs_source_t *source);
 
+/**
+ * Returns the number of async video frames that were released without being
+ * presented, either because newer frames were available or because the
+ * source is set to OBS_SOURCE_UNBUFFERED
+ */
+EXPORT uint64_t obs_source_get_frames_dropped(const obs_source_t *source);
+
+/**
+ * Returns true if the source's async video frame queue is at its limit, in
+ * which case outputting another frame drops the oldest queued one (counted in
+ * obs_source_get_frames_dropped).  Sources that decode or convert their
+ * frames can check this to skip that work while nothing is consuming them.
+ */
+EXPORT bool obs_source_async_queue_full(const obs_source_t *source);
+
+/** Gets the number of queued async video frames and the memory they use */
+EXPORT void obs_source_get_async_queue_info(obs_source_t *source,
+		size_t *num_frames, size_t *bytes);
+
+typedef void (*obs_source_audio_capture_t)(void *param, obs_source_t *source,
+		const struct audio_data *audio_data);
+
+/**
+ * Adds a callback that receives the source's audio as it's output, after
+ * filtering and resampling to the output format, but before it goes through
+ * the buffered mix.  audio_data->volume holds the volume the mix applies.
+ *
+ *   This is meant for taps such as local monitoring that can't wait for the
+ * mix's buffering.  The callback is called on the source's audio thread and
+ * must not block.
+ */
+EXPORT void obs_source_add_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param);
+EXPORT void obs_source_remove_audio_capture_callback(obs_source_t *source,
+		obs_source_audio_capture_t callback, void *param);
+
 /* ------------------------------------------------------------------------- */
 /* Functions used by sources */
 
@@ -799,6 +1146,39 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Gets an async video frame to be filled in by the source and then output
+ * with obs_source_output_video_owned.  Frames are recycled from previously
+ * released frames of the same format and size when possible, so data can be
+ * written directly into the frame without an extra copy.
+ */
+EXPORT struct obs_source_frame *obs_source_alloc_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height);
+
+/**
+ * Like obs_source_alloc_frame, but when possible the planes of the returned
+ * frame point directly into mapped texture memory, which saves copying the
+ * frame again when it is uploaded.  The frame data must only be written to,
+ * and the frame must be output with obs_source_output_video_owned.
+ */
+EXPORT struct obs_source_frame *obs_source_acquire_frame(obs_source_t *source,
+		enum video_format format, uint32_t width, uint32_t height);
+
+/**
+ * Outputs asynchronous video data without copying it.  Takes ownership of
+ * the frame, which must have been allocated with obs_source_alloc_frame,
+ * obs_source_acquire_frame or obs_source_frame_create, or have a release
+ * callback set if its data is owned by the source.
+ */
+EXPORT void obs_source_output_video_owned(obs_source_t *source,
+		struct obs_source_frame *frame);
+
+/**
+ * Releases all async video frames that are queued but were not displayed
+ * yet.  Sources with their own frame memory call this before freeing it.
+ */
+EXPORT void obs_source_flush_video(obs_source_t *source);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
@@ -818,6 +1198,23 @@ EXPORT void obs_source_process_filter(obs_source_t *filter, gs_effect_t *effect,
 		uint32_t width, uint32_t height, enum gs_color_format format,
 		enum obs_allow_direct_render allow_direct);
 
+/**
+ * Creates a pixel effect from a pixel function file, for filters that only
+ * change each pixel by itself (see get_pixel_effect in obs_source_info).
+ *
+ *   The file declares the uniforms it uses and the function
+ * "float4 PixelFunction(float4 rgba)", along with any helper functions.
+ * The resulting effect has an "image" parameter and Draw/DrawMatrix
+ * techniques that apply the function to the image, so it can also be used
+ * with obs_source_process_filter.  Must be called within the graphics
+ * context.
+ */
+EXPORT obs_pixel_effect_t *obs_pixel_effect_create(const char *file);
+EXPORT void obs_pixel_effect_destroy(obs_pixel_effect_t *pe);
+
+/** Gets the effect to set the pixel function's parameters with */
+EXPORT gs_effect_t *obs_pixel_effect_get_effect(const obs_pixel_effect_t *pe);
+
 /**
  * Adds a child source.  Must be called by parent sources on child sources
  * when the child is added.  This ensures that the source is properly activated
@@ -865,6 +1262,29 @@ EXPORT void obs_source_set_transition_vol(obs_source_t *source, float vol);
 /** Ends transition frame and applies new presentation volumes to all sources */
 EXPORT void obs_transition_end_frame(obs_source_t *transition);
 
+/**
+ * Renders a source once in to a texture kept by the transition, for
+ * transitions that show the outgoing scene frozen rather than rendering it
+ * live for the whole transition.  Call from the graphics thread (the
+ * transition's video_render) at the start of the transition, and draw
+ * obs_transition_get_frozen_texture in place of the source from then on.
+ * Freezing again replaces the texture.
+ *
+ * @return false if the source has no video to render
+ */
+EXPORT bool obs_transition_freeze_source(obs_source_t *transition,
+		obs_source_t *source);
+
+/**
+ * Gets the texture frozen with obs_transition_freeze_source, at the size of
+ * the source when it was frozen.  NULL if nothing is frozen.
+ */
+EXPORT gs_texture_t *obs_transition_get_frozen_texture(
+		const obs_source_t *transition);
+
+/** Drops the frozen texture once the transition is done */
+EXPORT void obs_transition_clear_frozen(obs_source_t *transition);
+
 
 /* ------------------------------------------------------------------------- */
 /* Scenes */
@@ -895,6 +1315,19 @@ EXPORT void obs_scene_enum_items(obs_scene_t *scene,
 		bool (*callback)(obs_scene_t*, obs_sceneitem_t*, void*),
 		void *param);
 
+/**
+ * Enumerates the scene items whose box (see
+ * obs_sceneitem_get_box_transform) overlaps the given area, in the same order
+ * as obs_scene_enum_items.  The items are looked up in an index that is only
+ * rebuilt when items change, so this is much cheaper than going through
+ * every item for hit-testing.  The callback still needs to do an exact test
+ * for rotated items.
+ */
+EXPORT void obs_scene_enum_items_in_area(obs_scene_t *scene,
+		const struct vec2 *min, const struct vec2 *max,
+		bool (*callback)(obs_scene_t*, obs_sceneitem_t*, void*),
+		void *param);
+
 /** Adds/creates a new scene item for a source */
 EXPORT obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source);
 
@@ -1039,16 +1472,21 @@ EXPORT void obs_output_set_video_encoder(obs_output_t *output,
 
 /**
  * Sets the current audio encoder associated with this output,
- * required for encoded outputs
+ * required for encoded outputs.
+ *
+ * Outputs with the OBS_OUTPUT_MULTI_TRACK flag can have up to
+ * MAX_AUDIO_MIXES audio encoders, one per track, other outputs only use
+ * track 0.
  */
 EXPORT void obs_output_set_audio_encoder(obs_output_t *output,
-		obs_encoder_t *encoder);
+		obs_encoder_t *encoder, size_t idx);
 
 /** Returns the current video encoder associated with this output */
 EXPORT obs_encoder_t *obs_output_get_video_encoder(const obs_output_t *output);
 
-/** Returns the current audio encoder associated with this output */
-EXPORT obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output);
+/** Returns the audio encoder of the given track of this output */
+EXPORT obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
+		size_t idx);
 
 /** Sets the current service associated with this output. */
 EXPORT void obs_output_set_service(obs_output_t *output,
@@ -1067,6 +1505,26 @@ EXPORT uint64_t obs_output_get_total_bytes(const obs_output_t *output);
 EXPORT int obs_output_get_frames_dropped(const obs_output_t *output);
 EXPORT int obs_output_get_total_frames(const obs_output_t *output);
 
+/**
+ * Gets the estimated rate (in kbps) the output is able to send data at, or 0
+ * if the output does not provide an estimate
+ */
+EXPORT uint32_t obs_output_get_send_rate(const obs_output_t *output);
+
+/**
+ * Reports how congested the output currently is, which is used to lower the
+ * bitrate of its video encoder while congested and raise it back up to the
+ * configured bitrate once the congestion clears.
+ *
+ *   congestion: 0.0 means nothing is buffered, 1.0 means the output is about
+ *               to start dropping frames.
+ *
+ * Only works with encoders that have a "bitrate" setting and support
+ * updating settings while active.
+ */
+EXPORT void obs_output_report_congestion(obs_output_t *output,
+		float congestion);
+
 /**
  * Sets the preferred scaled resolution for this output.  Set width and height
  * to 0 to disable scaling.
@@ -1095,6 +1553,15 @@ EXPORT void obs_output_set_video_conversion(obs_output_t *output,
 EXPORT void obs_output_set_audio_conversion(obs_output_t *output,
 		const struct audio_convert_info *conversion);
 
+/**
+ * Sets the audio mix (track) the output receives, 0 by default.  Used only
+ * for raw output, encoded output uses the audio encoder's mix
+ */
+EXPORT void obs_output_set_mixer(obs_output_t *output, size_t mixer_idx);
+
+/** Gets the audio mix (track) the output receives */
+EXPORT size_t obs_output_get_mixer(const obs_output_t *output);
+
 /** Returns whether data capture can begin with the specified flags */
 EXPORT bool obs_output_can_begin_data_capture(const obs_output_t *output,
 		uint32_t flags);
@@ -1148,13 +1615,17 @@ EXPORT obs_encoder_t *obs_video_encoder_create(const char *id, const char *name,
 /**
  * Creates an audio encoder context
  *
- * @param  id        Audio Encoder ID
- * @param  name      Name to assign to this context
- * @param  settings  Settings
- * @return           The video encoder context, or NULL if failed or not found.
+ * @param  id         Audio Encoder ID
+ * @param  name       Name to assign to this context
+ * @param  settings   Settings
+ * @param  mixer_idx  Index of the audio mix (track) to encode
+ * @return            The video encoder context, or NULL if failed or not found.
  */
 EXPORT obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
-		obs_data_t *settings);
+		obs_data_t *settings, size_t mixer_idx);
+
+/** Returns the index of the audio mix (track) an audio encoder encodes */
+EXPORT size_t obs_encoder_get_mixer_index(const obs_encoder_t *encoder);
 
 /** Destroys an encoder context */
 EXPORT void obs_encoder_destroy(obs_encoder_t *encoder);
@@ -1203,6 +1674,13 @@ EXPORT bool obs_encoder_get_extra_data(const obs_encoder_t *encoder,
 /** Returns the current settings for this encoder */
 EXPORT obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder);
 
+/**
+ * Returns the number of frames a video encoder can hold back before it
+ * outputs the packet of a frame, or 0 if unknown.  Only valid while the
+ * encoder is initialized.
+ */
+EXPORT uint32_t obs_encoder_get_frame_delay(const obs_encoder_t *encoder);
+
 /** Sets the video output context to be used with this encoder */
 EXPORT void obs_encoder_set_video(obs_encoder_t *encoder, video_t *video);
 
@@ -1224,12 +1702,59 @@ EXPORT audio_t *obs_encoder_audio(const obs_encoder_t *encoder);
 /** Returns true if encoder is active, false otherwise */
 EXPORT bool obs_encoder_active(const obs_encoder_t *encoder);
 
-/** Duplicates an encoder packet */
+/**
+ * Enables or disables warm standby for an encoder.
+ *
+ * An encoder in standby is initialized right away and keeps encoding even
+ * while no output uses it (the packets are discarded), so outputs using it
+ * start without waiting for the encoder to be created.  The encoder stays
+ * active in standby, so video/audio can't be reset and settings that
+ * require a new encoder won't apply until standby is disabled.
+ *
+ * @return  false if the encoder could not be initialized
+ */
+EXPORT bool obs_encoder_set_standby(obs_encoder_t *encoder, bool standby);
+
+/** Returns true if the encoder is in standby */
+EXPORT bool obs_encoder_standby(const obs_encoder_t *encoder);
+
+/**
+ * Asks a video encoder to make the next frame a keyframe, for outputs that
+ * need one to (re)start from.  Outputs starting on an encoder that is already
+ * running request one automatically.  Does nothing if the encoder doesn't
+ * implement request_keyframe.
+ */
+EXPORT void obs_encoder_request_keyframe(obs_encoder_t *encoder);
+
+/**
+ * Duplicates an encoder packet with a full copy of its data.  Use
+ * obs_encoder_packet_ref instead when the data is reference counted.
+ */
 EXPORT void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 		const struct encoder_packet *src);
 
+/** Frees a packet created with obs_duplicate_encoder_packet */
 EXPORT void obs_free_encoder_packet(struct encoder_packet *packet);
 
+/**
+ * Creates a reference counted copy of an encoder packet.  Packets passed to
+ * outputs are always reference counted, so outputs only need this for
+ * packets they create themselves.
+ */
+EXPORT void obs_encoder_packet_create_instance(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/**
+ * Adds a reference to the data of a reference counted packet and copies the
+ * rest of the packet.  Each reference must be released with
+ * obs_encoder_packet_release.
+ */
+EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
+		const struct encoder_packet *src);
+
+/** Releases a reference to packet data, freeing it with the last one */
+EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
+
 
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
@@ -1301,7 +1826,10 @@ static inline struct obs_source_frame *obs_source_frame_create(
 
 static inline void obs_source_frame_destroy(struct obs_source_frame *frame)
 {
-	if (frame) {
+	if (frame && frame->release) {
+		frame->release(frame->release_param, frame);
+
+	} else if (frame) {
 		bfree(frame->data[0]);
 		bfree(frame);
 	}
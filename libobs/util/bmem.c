@@ -16,76 +16,487 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "base.h"
 #include "bmem.h"
 #include "threading.h"
 
-/*
- * NOTE: totally jacked the mem alignment trick from ffmpeg, credit to them:
- *   http://www.ffmpeg.org/
- */
-
 #define ALIGNMENT 32
 
-/* TODO: use memalign for non-windows systems */
-#if defined(_WIN32)
-#define ALIGNED_MALLOC 1
-#else
-#define ALIGNMENT_HACK 1
-#endif
-
 static void *a_malloc(size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_malloc(size, ALIGNMENT);
-#elif ALIGNMENT_HACK
+#else
 	void *ptr = NULL;
-	long diff;
-
-	ptr  = malloc(size + ALIGNMENT);
-	diff = ((~(long)ptr) & (ALIGNMENT - 1)) + 1;
-	ptr  = (char *)ptr + diff;
-	((char *)ptr)[-1] = (char)diff;
-
+	if (posix_memalign(&ptr, ALIGNMENT, size) != 0)
+		return NULL;
 	return ptr;
-#else
-	return malloc(size);
 #endif
 }
 
 static void *a_realloc(void *ptr, size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_realloc(ptr, size, ALIGNMENT);
-#elif ALIGNMENT_HACK
-	long diff;
-
-	if (!ptr)
-		return a_malloc(size);
-	diff = ((char *)ptr)[-1];
-	ptr = realloc((char*)ptr - diff, size + diff);
-	if (ptr)
-		ptr = (char *)ptr + diff;
-	return ptr;
 #else
-	return realloc(ptr, size);
+	void *aligned;
+
+	ptr = realloc(ptr, size);
+	if (!ptr || ((uintptr_t)ptr & (ALIGNMENT - 1)) == 0)
+		return ptr;
+
+	/* realloc only guarantees the default alignment.  the new block is
+	 * size bytes long, so copying size bytes out of it is always valid */
+	aligned = a_malloc(size);
+	if (aligned)
+		memcpy(aligned, ptr, size);
+	free(ptr);
+	return aligned;
 #endif
 }
 
 static void a_free(void *ptr)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	_aligned_free(ptr);
-#elif ALIGNMENT_HACK
-	if (ptr)
-		free((char *)ptr - ((char*)ptr)[-1]);
 #else
 	free(ptr);
 #endif
 }
 
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
-static long num_allocs = 0;
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Small allocations come from per-thread caches of fixed size slots, carved
+ * out of larger slabs, so most bmalloc/bfree calls take no lock and don't
+ * touch the system allocator.  Every block is preceded by a header of
+ * ALIGNMENT bytes, which keeps the returned pointer aligned and tells bfree
+ * and brealloc where the block came from.
+ *
+ * Blocks may be freed on a different thread than the one that allocated
+ * them; they go to the cache of the freeing thread.  When a thread caches
+ * too many slots of a size class, half of them are moved to a shared list,
+ * where other threads refill from.  Slabs are never returned to the system.
+ *
+ * Allocations are counted per thread, bnum_allocs sums up the counters.
+ */
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define NUM_CLASSES     8
+#define SLAB_SIZE       (64 * 1024)
+#define MAX_CACHED_SIZE (64 * 1024)
+#define REFILL_SIZE     (16 * 1024)
+
+static const size_t class_sizes[NUM_CLASSES] = {
+	32, 64, 96, 128, 192, 256, 384, 512
+};
+
+struct block_header {
+	size_t   size;
+	uint32_t class_idx; /* 0 if allocated directly, class + 1 otherwise */
+	uint32_t tag;       /* 0 if not tracked, tag + 1 otherwise */
+};
+
+struct free_slot {
+	struct free_slot *next;
+};
+
+struct free_list {
+	struct free_slot *head;
+	size_t           count;
+};
+
+struct thread_cache {
+	struct free_list    lists[NUM_CLASSES];
+	volatile long       num_allocs;
+
+	struct thread_cache *prev;
+	struct thread_cache *next;
+};
+
+struct shared_list {
+	pthread_mutex_t  mutex;
+	struct free_list list;
+};
+
+static pthread_once_t      init_once = PTHREAD_ONCE_INIT;
+static pthread_key_t       cache_key;
+static pthread_mutex_t     caches_mutex;
+static struct thread_cache *first_cache = NULL;
+static struct shared_list  shared_lists[NUM_CLASSES];
+
+/* counts of threads that have exited, and of allocations made while a
+ * thread had no cache */
+static long retired_allocs = 0;
+
+static THREAD_LOCAL struct thread_cache *cur_cache = NULL;
+static THREAD_LOCAL bool                cache_destroyed = false;
+
+static inline size_t class_max_cached(size_t class_idx)
+{
+	return MAX_CACHED_SIZE / (ALIGNMENT + class_sizes[class_idx]);
+}
+
+static inline int get_class(size_t size)
+{
+	for (int i = 0; i < NUM_CLASSES; i++) {
+		if (size <= class_sizes[i])
+			return i;
+	}
+
+	return -1;
+}
+
+static inline struct block_header *get_header(void *ptr)
+{
+	return (struct block_header*)((uint8_t*)ptr - ALIGNMENT);
+}
+
+static inline void push_slot(struct free_list *list, struct free_slot *slot)
+{
+	slot->next = list->head;
+	list->head = slot;
+	list->count++;
+}
+
+static inline struct free_slot *pop_slot(struct free_list *list)
+{
+	struct free_slot *slot = list->head;
+	if (slot) {
+		list->head = slot->next;
+		list->count--;
+	}
+	return slot;
+}
+
+/* moves up to count slots from one list to another */
+static void move_slots(struct free_list *dst, struct free_list *src,
+		size_t count)
+{
+	struct free_slot *slot;
+
+	while (count-- && (slot = pop_slot(src)) != NULL)
+		push_slot(dst, slot);
+}
+
+static void push_shared(int class_idx, struct free_list *src, size_t count)
+{
+	struct shared_list *shared = &shared_lists[class_idx];
+
+	pthread_mutex_lock(&shared->mutex);
+	move_slots(&shared->list, src, count);
+	pthread_mutex_unlock(&shared->mutex);
+}
+
+static void destroy_thread_cache(void *data)
+{
+	struct thread_cache *cache = data;
+
+	for (int i = 0; i < NUM_CLASSES; i++)
+		push_shared(i, &cache->lists[i], cache->lists[i].count);
+
+	pthread_mutex_lock(&caches_mutex);
+	retired_allocs += cache->num_allocs;
+	if (cache->prev)
+		cache->prev->next = cache->next;
+	else
+		first_cache = cache->next;
+	if (cache->next)
+		cache->next->prev = cache->prev;
+	pthread_mutex_unlock(&caches_mutex);
+
+	a_free(cache);
+	cur_cache       = NULL;
+	cache_destroyed = true;
+}
+
+static void init_caches(void)
+{
+	pthread_key_create(&cache_key, destroy_thread_cache);
+	pthread_mutex_init(&caches_mutex, NULL);
+
+	for (int i = 0; i < NUM_CLASSES; i++)
+		pthread_mutex_init(&shared_lists[i].mutex, NULL);
+}
+
+/* returns NULL when the thread is exiting and its cache is already gone */
+static struct thread_cache *get_thread_cache(void)
+{
+	struct thread_cache *cache = cur_cache;
+
+	if (cache || cache_destroyed)
+		return cache;
+
+	pthread_once(&init_once, init_caches);
+
+	/* not from bmalloc, the cache is what bmalloc needs */
+	cache = a_malloc(sizeof(struct thread_cache));
+	if (!cache)
+		return NULL;
+
+	memset(cache, 0, sizeof(struct thread_cache));
+
+	pthread_mutex_lock(&caches_mutex);
+	cache->next = first_cache;
+	if (first_cache)
+		first_cache->prev = cache;
+	first_cache = cache;
+	pthread_mutex_unlock(&caches_mutex);
+
+	pthread_setspecific(cache_key, cache);
+	cur_cache = cache;
+	return cache;
+}
+
+static inline void count_alloc(long val)
+{
+	struct thread_cache *cache = get_thread_cache();
+
+	if (cache) {
+		cache->num_allocs += val;
+	} else {
+		pthread_mutex_lock(&caches_mutex);
+		retired_allocs += val;
+		pthread_mutex_unlock(&caches_mutex);
+	}
+}
+
+static bool new_slab(int class_idx, struct free_list *list)
+{
+	size_t  slot_size = ALIGNMENT + class_sizes[class_idx];
+	size_t  count     = SLAB_SIZE / slot_size;
+	uint8_t *slab     = alloc.malloc(SLAB_SIZE);
+
+	if (!slab)
+		return false;
+
+	for (size_t i = 0; i < count; i++) {
+		uint8_t             *slot   = slab + i * slot_size;
+		struct block_header *header = (struct block_header*)slot;
+
+		header->size      = 0;
+		header->class_idx = (uint32_t)class_idx + 1;
+		push_slot(list, (struct free_slot*)(slot + ALIGNMENT));
+	}
+
+	return true;
+}
+
+static void *slot_alloc(int class_idx, size_t size)
+{
+	struct thread_cache *cache = get_thread_cache();
+	struct shared_list  *shared = &shared_lists[class_idx];
+	struct free_list    *list;
+	struct free_list    exiting_list = {0};
+	struct free_slot    *slot;
+
+	list = cache ? &cache->lists[class_idx] : &exiting_list;
+
+	if (!list->head) {
+		size_t refill = REFILL_SIZE /
+			(ALIGNMENT + class_sizes[class_idx]);
+
+		pthread_mutex_lock(&shared->mutex);
+		move_slots(list, &shared->list, cache ? refill : 1);
+		if (!list->head && new_slab(class_idx, &shared->list))
+			move_slots(list, &shared->list, cache ? refill : 1);
+		pthread_mutex_unlock(&shared->mutex);
+	}
+
+	slot = pop_slot(list);
+	if (slot)
+		get_header(slot)->size = size;
+	return slot;
+}
+
+static void slot_free(struct block_header *header, void *ptr)
+{
+	int                 class_idx = (int)header->class_idx - 1;
+	struct thread_cache *cache    = get_thread_cache();
+	struct free_list    single    = {0};
+
+	if (!cache) {
+		push_slot(&single, ptr);
+		push_shared(class_idx, &single, 1);
+		return;
+	}
+
+	push_slot(&cache->lists[class_idx], ptr);
+
+	if (cache->lists[class_idx].count > class_max_cached(class_idx))
+		push_shared(class_idx, &cache->lists[class_idx],
+				cache->lists[class_idx].count / 2);
+}
+
+static void *block_alloc(size_t size)
+{
+	struct block_header *header;
+	int                 class_idx = get_class(size);
+
+	if (class_idx >= 0) {
+		void *ptr = slot_alloc(class_idx, size);
+		if (ptr)
+			return ptr;
+	}
+
+	header = alloc.malloc(size + ALIGNMENT);
+	if (!header)
+		return NULL;
+
+	header->size      = size;
+	header->class_idx = 0;
+	return (uint8_t*)header + ALIGNMENT;
+}
+
+static void block_free(void *ptr)
+{
+	struct block_header *header = get_header(ptr);
+
+	if (header->class_idx)
+		slot_free(header, ptr);
+	else
+		alloc.free(header);
+}
+
+static void *block_realloc(void *ptr, size_t size)
+{
+	struct block_header *header = get_header(ptr);
+	void                *new_ptr;
+
+	if (!header->class_idx) {
+		header = alloc.realloc(header, size + ALIGNMENT);
+		if (!header)
+			return NULL;
+
+		header->size = size;
+		return (uint8_t*)header + ALIGNMENT;
+	}
+
+	if (size <= class_sizes[header->class_idx - 1]) {
+		header->size = size;
+		return ptr;
+	}
+
+	new_ptr = block_alloc(size);
+	if (new_ptr) {
+		memcpy(new_ptr, ptr, header->size);
+		slot_free(header, ptr);
+	}
+	return new_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/* allocation tracking                                                       */
+
+struct tag_stats {
+	volatile int64_t bytes;
+	volatile int64_t peak_bytes;
+	volatile int64_t blocks;
+	volatile int64_t total_blocks;
+};
+
+static const char *tag_names[BMEM_TAG_COUNT] = {
+	"other",
+	"source",
+	"encoder",
+	"output",
+	"graphics",
+	"ui"
+};
+
+static volatile bool                  tracking_enabled = false;
+static struct tag_stats               tag_stats[BMEM_TAG_COUNT];
+static THREAD_LOCAL enum bmem_tag     cur_tag = BMEM_TAG_OTHER;
+
+static void track_bytes(uint32_t tag, int64_t bytes, int64_t blocks)
+{
+	struct tag_stats *stats = &tag_stats[tag - 1];
+	int64_t          total  = os_atomic_add_64(&stats->bytes, bytes);
+	int64_t          peak;
+
+	if (blocks) {
+		os_atomic_add_64(&stats->blocks, blocks);
+		if (blocks > 0)
+			os_atomic_add_64(&stats->total_blocks, blocks);
+	}
+
+	while (total > (peak = os_atomic_load_64(&stats->peak_bytes))) {
+		if (os_atomic_compare_swap_64(&stats->peak_bytes, peak, total))
+			break;
+	}
+}
+
+static inline uint32_t get_alloc_tag(void)
+{
+	return tracking_enabled ? (uint32_t)cur_tag + 1 : 0;
+}
+
+void bmem_enable_tracking(bool enable)
+{
+	tracking_enabled = enable;
+}
+
+bool bmem_tracking_enabled(void)
+{
+	return tracking_enabled;
+}
+
+enum bmem_tag bmem_set_thread_tag(enum bmem_tag tag)
+{
+	enum bmem_tag prev = cur_tag;
+	if (tag >= 0 && tag < BMEM_TAG_COUNT)
+		cur_tag = tag;
+	return prev;
+}
+
+const char *bmem_tag_name(enum bmem_tag tag)
+{
+	return (tag >= 0 && tag < BMEM_TAG_COUNT) ? tag_names[tag] : NULL;
+}
+
+void bmem_get_tag_stats(enum bmem_tag tag, struct bmem_tag_stats *stats)
+{
+	memset(stats, 0, sizeof(struct bmem_tag_stats));
+	if (tag < 0 || tag >= BMEM_TAG_COUNT)
+		return;
+
+	stats->bytes        = os_atomic_load_64(&tag_stats[tag].bytes);
+	stats->peak_bytes   = os_atomic_load_64(&tag_stats[tag].peak_bytes);
+	stats->blocks       = os_atomic_load_64(&tag_stats[tag].blocks);
+	stats->total_blocks = os_atomic_load_64(&tag_stats[tag].total_blocks);
+}
+
+void bmem_log_usage(void)
+{
+	if (!tracking_enabled)
+		return;
+
+	blog(LOG_INFO, "== Memory Usage =================================");
+
+	for (int i = 0; i < BMEM_TAG_COUNT; i++) {
+		struct bmem_tag_stats stats;
+		bmem_get_tag_stats((enum bmem_tag)i, &stats);
+
+		blog(LOG_INFO, "%-9s %10lld KB in use (peak %lld KB), "
+				"%lld blocks (%lld allocated in total)",
+				tag_names[i],
+				(long long)stats.bytes / 1024,
+				(long long)stats.peak_bytes / 1024,
+				(long long)stats.blocks,
+				(long long)stats.total_blocks);
+	}
+
+	blog(LOG_INFO, "=================================================");
+}
+
+/* ------------------------------------------------------------------------- */
 
 void base_set_allocator(struct base_allocator *defs)
 {
@@ -94,42 +505,74 @@ void base_set_allocator(struct base_allocator *defs)
 
 void *bmalloc(size_t size)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
+	struct block_header *header;
+	void *ptr = block_alloc(size ? size : 1);
 	if (!ptr)
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 
-	os_atomic_inc_long(&num_allocs);
+	header      = get_header(ptr);
+	header->tag = get_alloc_tag();
+	if (header->tag)
+		track_bytes(header->tag, (int64_t)header->size, 1);
+
+	count_alloc(1);
 	return ptr;
 }
 
 void *brealloc(void *ptr, size_t size)
 {
+	struct block_header *header;
+	uint32_t tag;
+	size_t   old_size;
+
 	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+		return bmalloc(size);
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
+	header   = get_header(ptr);
+	tag      = header->tag;
+	old_size = header->size;
+
+	ptr = block_realloc(ptr, size ? size : 1);
 	if (!ptr)
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 
+	header      = get_header(ptr);
+	header->tag = tag;
+	if (tag)
+		track_bytes(tag, (int64_t)header->size - (int64_t)old_size, 0);
+
 	return ptr;
 }
 
 void bfree(void *ptr)
 {
-	if (ptr)
-		os_atomic_dec_long(&num_allocs);
-	alloc.free(ptr);
+	if (ptr) {
+		struct block_header *header = get_header(ptr);
+
+		if (header->tag)
+			track_bytes(header->tag, -(int64_t)header->size, -1);
+
+		block_free(ptr);
+		count_alloc(-1);
+	}
 }
 
 long bnum_allocs(void)
 {
-	return num_allocs;
+	struct thread_cache *cache;
+	long                total;
+
+	pthread_once(&init_once, init_caches);
+	pthread_mutex_lock(&caches_mutex);
+
+	total = retired_allocs;
+	for (cache = first_cache; cache; cache = cache->next)
+		total += cache->num_allocs;
+
+	pthread_mutex_unlock(&caches_mutex);
+	return total;
 }
 
 int base_get_alignment(void)
@@ -41,6 +41,48 @@ EXPORT int base_get_alignment(void);
 
 EXPORT long bnum_allocs(void);
 
+/*
+ * Allocation tracking
+ *
+ *   Each thread has a current tag (BMEM_TAG_OTHER by default), which is
+ * recorded with every block the thread allocates while tracking is enabled.
+ * The bytes and blocks in use are then counted per tag, and freed from the
+ * tag the block was allocated with, regardless of the freeing thread.
+ * Blocks allocated while tracking was disabled are never counted.  When
+ * tracking is disabled, the cost is a single flag check per allocation.
+ */
+
+enum bmem_tag {
+	BMEM_TAG_OTHER,
+	BMEM_TAG_SOURCE,
+	BMEM_TAG_ENCODER,
+	BMEM_TAG_OUTPUT,
+	BMEM_TAG_GRAPHICS,
+	BMEM_TAG_UI,
+
+	BMEM_TAG_COUNT
+};
+
+struct bmem_tag_stats {
+	int64_t bytes;
+	int64_t peak_bytes;
+	int64_t blocks;
+	int64_t total_blocks;
+};
+
+EXPORT void bmem_enable_tracking(bool enable);
+EXPORT bool bmem_tracking_enabled(void);
+
+/** Sets the tag of the calling thread, returns the previous tag */
+EXPORT enum bmem_tag bmem_set_thread_tag(enum bmem_tag tag);
+
+EXPORT const char *bmem_tag_name(enum bmem_tag tag);
+EXPORT void bmem_get_tag_stats(enum bmem_tag tag,
+		struct bmem_tag_stats *stats);
+
+/** Logs the tracked memory usage of every tag */
+EXPORT void bmem_log_usage(void);
+
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
 static inline void *bzalloc(size_t size)
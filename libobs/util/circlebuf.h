@@ -38,6 +38,16 @@ struct circlebuf {
 	size_t capacity;
 };
 
+/*
+ * Contiguous regions of a circular buffer, for accessing data in place.  The
+ * second region is only used when the data wraps around the end of the
+ * buffer, otherwise its size is 0.
+ */
+struct circlebuf_span {
+	uint8_t *data[2];
+	size_t  size[2];
+};
+
 static inline void circlebuf_init(struct circlebuf *cb)
 {
 	memset(cb, 0, sizeof(struct circlebuf));
@@ -168,6 +178,70 @@ static inline void circlebuf_push_back(struct circlebuf *cb, const void *data,
 	cb->end_pos = new_end_pos;
 }
 
+/**
+ * Appends size bytes to the back of the buffer without writing them, and
+ * returns the regions they occupy so the caller can write the data in place.
+ * The regions are only valid until the buffer is next modified.
+ */
+static inline void circlebuf_push_back_span(struct circlebuf *cb, size_t size,
+		struct circlebuf_span *span)
+{
+	size_t new_end_pos = cb->end_pos + size;
+
+	cb->size += size;
+	circlebuf_ensure_capacity(cb);
+
+	span->data[0] = (uint8_t*)cb->data + cb->end_pos;
+	span->data[1] = (uint8_t*)cb->data;
+
+	if (new_end_pos > cb->capacity) {
+		span->size[0] = cb->capacity - cb->end_pos;
+		span->size[1] = size - span->size[0];
+		new_end_pos -= cb->capacity;
+	} else {
+		span->size[0] = size;
+		span->size[1] = 0;
+	}
+
+	cb->end_pos = new_end_pos;
+}
+
+/**
+ * Returns the regions holding the first size bytes of the buffer, without
+ * copying them.  The regions are only valid until the buffer is next
+ * modified; use circlebuf_consume to remove the data once it's been used.
+ */
+static inline void circlebuf_peek_front_span(struct circlebuf *cb, size_t size,
+		struct circlebuf_span *span)
+{
+	size_t start_size;
+	assert(size <= cb->size);
+
+	start_size = cb->capacity - cb->start_pos;
+
+	span->data[0] = (uint8_t*)cb->data + cb->start_pos;
+	span->data[1] = (uint8_t*)cb->data;
+
+	if (start_size < size) {
+		span->size[0] = start_size;
+		span->size[1] = size - start_size;
+	} else {
+		span->size[0] = size;
+		span->size[1] = 0;
+	}
+}
+
+/** Removes size bytes from the front of the buffer without copying them */
+static inline void circlebuf_consume(struct circlebuf *cb, size_t size)
+{
+	assert(size <= cb->size);
+
+	cb->size -= size;
+	cb->start_pos += size;
+	if (cb->start_pos >= cb->capacity)
+		cb->start_pos -= cb->capacity;
+}
+
 static inline void circlebuf_peek_front(struct circlebuf *cb, void *data,
 		size_t size)
 {
@@ -192,11 +266,7 @@ static inline void circlebuf_pop_front(struct circlebuf *cb, void *data,
 		size_t size)
 {
 	circlebuf_peek_front(cb, data, size);
-
-	cb->size -= size;
-	cb->start_pos += size;
-	if (cb->start_pos >= cb->capacity)
-		cb->start_pos -= cb->capacity;
+	circlebuf_consume(cb, size);
 }
 
 #ifdef __cplusplus
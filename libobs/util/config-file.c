@@ -16,51 +16,239 @@
 
 #include <stdio.h>
 #include <wchar.h>
+#include <ctype.h>
 #include "config-file.h"
 #include "platform.h"
+#include "threading.h"
 #include "base.h"
 #include "bmem.h"
 #include "darray.h"
+#include "hash-map.h"
 #include "lexer.h"
 #include "dstr.h"
 
+/* how long config_save_async waits for further changes before saving */
+#define CONFIG_SAVE_DELAY_MS 1000
+
+/* lookup keys that fit are built on the stack */
+#define KEY_BUF_SIZE 256
+
 struct config_item {
-	char *name;
-	char *value;
+	char    *name;
+	char    *value;
+	char    *key;
+
+	/* the value parsed for the numeric getters, updated when it's set */
+	int64_t  int_val;
+	uint64_t uint_val;
+	double   double_val;
+	bool     bool_val;
 };
 
 static inline void config_item_free(struct config_item *item)
 {
 	bfree(item->name);
 	bfree(item->value);
+	bfree(item->key);
+	bfree(item);
 }
 
 struct config_section {
 	char *name;
-	struct darray items; /* struct config_item */
+	char *key;
+	DARRAY(struct config_item*) items;
 };
 
 static inline void config_section_free(struct config_section *section)
 {
-	struct config_item *items = section->items.array;
-	size_t i;
-
-	for (i = 0; i < section->items.num; i++)
-		config_item_free(items+i);
+	for (size_t i = 0; i < section->items.num; i++)
+		config_item_free(section->items.array[i]);
 
-	darray_free(&section->items);
+	da_free(section->items);
 	bfree(section->name);
+	bfree(section->key);
+	bfree(section);
+}
+
+/*
+ * Sections and items are kept in file order for saving, and are looked up
+ * through hash maps.  Names are compared case-insensitively, so the keys of
+ * the maps are upper-cased: the section name for sections, and the section
+ * name and item name separated by ']' (which can't be part of a section
+ * name) for items.
+ */
+struct config_store {
+	DARRAY(struct config_section*) sections;
+	struct hash_map                section_map;
+	struct hash_map                item_map;
+};
+
+static void config_store_free(struct config_store *store)
+{
+	for (size_t i = 0; i < store->sections.num; i++)
+		config_section_free(store->sections.array[i]);
+
+	da_free(store->sections);
+	hash_map_free(&store->section_map);
+	hash_map_free(&store->item_map);
 }
 
 struct config_data {
-	char *file;
-	struct darray sections; /* struct config_section */
-	struct darray defaults; /* struct config_section */
+	char                *file;
+	struct config_store user;
+	struct config_store defaults;
+
+	/* held while setting values and saving.  getters don't lock, values
+	 * returned by them are only valid until they're set again anyway */
+	pthread_mutex_t     mutex;
+
+	/* user values changed since the file was loaded or last saved */
+	bool                dirty;
+
+	/* deferred saving, see config_save_async */
+	pthread_t           save_thread;
+	bool                save_thread_active;
+	os_event_t          *save_event;
+	volatile bool       save_stop;
+	bool                save_pending;
 };
 
+static inline char *copy_upper(char *dst, const char *src)
+{
+	while (*src)
+		*(dst++) = (char)toupper(*(src++));
+	return dst;
+}
+
+/* builds the key in buf if it fits, otherwise allocates it */
+static char *make_key(char *buf, size_t size, const char *section,
+		const char *name)
+{
+	size_t len;
+	char   *key;
+	char   *end;
+
+	if (!section)
+		section = "";
+
+	len = strlen(section) + (name ? strlen(name) + 1 : 0) + 1;
+	key = len <= size ? buf : bmalloc(len);
+
+	end = copy_upper(key, section);
+	if (name) {
+		*(end++) = ']';
+		end = copy_upper(end, name);
+	}
+
+	*end = 0;
+	return key;
+}
+
+static inline void free_key(char *key, char *buf)
+{
+	if (key != buf)
+		bfree(key);
+}
+
+static struct config_section *find_section(const struct config_store *store,
+		const char *section)
+{
+	char                  buf[KEY_BUF_SIZE];
+	char                  *key = make_key(buf, sizeof(buf), section, NULL);
+	struct config_section *sec = hash_map_find(&store->section_map, key);
+
+	free_key(key, buf);
+	return sec;
+}
+
+static struct config_item *find_item(const struct config_store *store,
+		const char *section, const char *name)
+{
+	char               buf[KEY_BUF_SIZE];
+	char               *key  = make_key(buf, sizeof(buf), section,
+			name ? name : "");
+	struct config_item *item = hash_map_find(&store->item_map, key);
+
+	free_key(key, buf);
+	return item;
+}
+
+static struct config_section *add_section(struct config_store *store,
+		char *name)
+{
+	struct config_section *sec = bzalloc(sizeof(struct config_section));
+
+	sec->name = name;
+	sec->key  = make_key(NULL, 0, name, NULL);
+
+	da_push_back(store->sections, &sec);
+	hash_map_set(&store->section_map, sec->key, sec);
+	return sec;
+}
+
+static inline int64_t str_to_int64(const char *str)
+{
+	if (!str || !*str)
+		return 0;
+
+	if (str[0] == '0' && str[1] == 'x')
+		return strtoll(str + 2, NULL, 16);
+	else
+		return strtoll(str, NULL, 10);
+}
+
+static inline uint64_t str_to_uint64(const char *str)
+{
+	if (!str || !*str)
+		return 0;
+
+	if (str[0] == '0' && str[1] == 'x')
+		return strtoull(str + 2, NULL, 16);
+	else
+		return strtoull(str, NULL, 10);
+}
+
+static void set_item_value(struct config_item *item, char *value)
+{
+	bfree(item->value);
+
+	item->value      = value;
+	item->int_val    = str_to_int64(value);
+	item->uint_val   = str_to_uint64(value);
+	item->double_val = strtod(value, NULL);
+	item->bool_val   = astrcmpi(value, "true") == 0 || !!item->uint_val;
+}
+
+static struct config_item *add_item(struct config_store *store,
+		struct config_section *sec, char *name, char *value)
+{
+	struct config_item *item = bzalloc(sizeof(struct config_item));
+
+	item->name = name;
+	item->key  = make_key(NULL, 0, sec->name, name);
+	set_item_value(item, value);
+
+	da_push_back(sec->items, &item);
+	hash_map_set(&store->item_map, item->key, item);
+	return item;
+}
+
+static struct config_data *config_alloc(const char *file)
+{
+	struct config_data *config = bzalloc(sizeof(struct config_data));
+
+	pthread_mutex_init_value(&config->mutex);
+	if (pthread_mutex_init(&config->mutex, NULL) != 0) {
+		bfree(config);
+		return NULL;
+	}
+
+	config->file = file ? bstrdup(file) : NULL;
+	return config;
+}
+
 config_t *config_create(const char *file)
 {
-	struct config_data *config;
 	FILE *f;
 
 	f = os_fopen(file, "wb");
@@ -68,8 +256,7 @@ config_t *config_create(const char *file)
 		return NULL;
 	fclose(f);
 
-	config = bzalloc(sizeof(struct config_data));
-	return config;
+	return config_alloc(file);
 }
 
 static inline void remove_ref_whitespace(struct strref *ref)
@@ -115,17 +302,24 @@ static bool config_parse_string(struct lexer *lex, struct strref *ref,
 	return success;
 }
 
-static void config_add_item(struct darray *items, struct strref *name,
+/* the first of several items with the same name is the one that's used */
+static void config_add_item(struct config_store *store,
+		struct config_section *section, struct strref *name,
 		struct strref *value)
 {
-	struct config_item item;
-	item.name  = bstrdup_n(name->array,  name->len);
-	item.value = bstrdup_n(value->array, value->len);
-	darray_push_back(sizeof(struct config_item), items, &item);
+	char *item_name = bstrdup_n(name->array, name->len);
+
+	if (find_item(store, section->name, item_name)) {
+		bfree(item_name);
+		return;
+	}
+
+	add_item(store, section, item_name,
+			bstrdup_n(value->array, value->len));
 }
 
-static void config_parse_section(struct config_section *section,
-		struct lexer *lex)
+static void config_parse_section(struct config_store *store,
+		struct config_section *section, struct lexer *lex)
 {
 	struct base_token token;
 
@@ -159,11 +353,11 @@ static void config_parse_section(struct config_section *section,
 		strref_clear(&value);
 		config_parse_string(lex, &value, 0);
 
-		config_add_item(&section->items, &name, &value);
+		config_add_item(store, section, &name, &value);
 	}
 }
 
-static void parse_config_data(struct darray *sections, struct lexer *lex)
+static void parse_config_data(struct config_store *store, struct lexer *lex)
 {
 	struct strref section_name;
 	struct base_token token;
@@ -172,6 +366,7 @@ static void parse_config_data(struct darray *sections, struct lexer *lex)
 
 	while (lexer_getbasetoken(lex, &token, PARSE_WHITESPACE)) {
 		struct config_section *section;
+		char                  *name;
 
 		while (token.type == BASETOKEN_WHITESPACE) {
 			if (!lexer_getbasetoken(lex, &token, PARSE_WHITESPACE))
@@ -193,15 +388,19 @@ static void parse_config_data(struct darray *sections, struct lexer *lex)
 		if (!section_name.len)
 			return;
 
-		section = darray_push_back_new(sizeof(struct config_section),
-				sections);
-		section->name = bstrdup_n(section_name.array,
-				section_name.len);
-		config_parse_section(section, lex);
+		/* sections that appear more than once are merged */
+		name    = bstrdup_n(section_name.array, section_name.len);
+		section = find_section(store, name);
+		if (section)
+			bfree(name);
+		else
+			section = add_section(store, name);
+
+		config_parse_section(store, section, lex);
 	}
 }
 
-static int config_parse_file(struct darray *sections, const char *file,
+static int config_parse_file(struct config_store *store, const char *file,
 		bool always_open)
 {
 	char *file_data;
@@ -223,7 +422,7 @@ static int config_parse_file(struct darray *sections, const char *file,
 	lexer_init(&lex);
 	lexer_start_move(&lex, file_data);
 
-	parse_config_data(sections, &lex);
+	parse_config_data(store, &lex);
 
 	lexer_free(&lex);
 	return CONFIG_SUCCESS;
@@ -238,13 +437,11 @@ int config_open(config_t **config, const char *file,
 	if (!config)
 		return CONFIG_ERROR;
 
-	*config = bzalloc(sizeof(struct config_data));
+	*config = config_alloc(file);
 	if (!*config)
 		return CONFIG_ERROR;
 
-	(*config)->file = bstrdup(file);
-
-	errorcode = config_parse_file(&(*config)->sections, file, always_open);
+	errorcode = config_parse_file(&(*config)->user, file, always_open);
 
 	if (errorcode != CONFIG_SUCCESS) {
 		config_close(*config);
@@ -261,15 +458,13 @@ int config_open_string(config_t **config, const char *str)
 	if (!config)
 		return CONFIG_ERROR;
 
-	*config = bzalloc(sizeof(struct config_data));
+	*config = config_alloc(NULL);
 	if (!*config)
 		return CONFIG_ERROR;
 
-	(*config)->file = NULL;
-
 	lexer_init(&lex);
 	lexer_start(&lex, str);
-	parse_config_data(&(*config)->sections, &lex);
+	parse_config_data(&(*config)->user, &lex);
 	lexer_free(&lex);
 
 	return CONFIG_SUCCESS;
@@ -283,27 +478,25 @@ int config_open_defaults(config_t *config, const char *file)
 	return config_parse_file(&config->defaults, file, false);
 }
 
-int config_save(config_t *config)
+/* writes the file if anything changed since it was loaded or last saved */
+static int save_locked(struct config_data *config)
 {
 	FILE *f;
 	struct dstr str;
 	size_t i, j;
 
-	if (!config)
-		return CONFIG_ERROR;
-	if (!config->file)
-		return CONFIG_ERROR;
-
-	dstr_init(&str);
+	config->save_pending = false;
+	if (!config->dirty)
+		return CONFIG_SUCCESS;
 
 	f = os_fopen(config->file, "wb");
 	if (!f)
 		return CONFIG_FILENOTFOUND;
 
-	for (i = 0; i < config->sections.num; i++) {
-		struct config_section *section = darray_item(
-				sizeof(struct config_section),
-				&config->sections, i);
+	dstr_init(&str);
+
+	for (i = 0; i < config->user.sections.num; i++) {
+		struct config_section *section = config->user.sections.array[i];
 
 		if (i) dstr_cat(&str, "\n");
 
@@ -312,9 +505,7 @@ int config_save(config_t *config)
 		dstr_cat(&str, "]\n");
 
 		for (j = 0; j < section->items.num; j++) {
-			struct config_item *item = darray_item(
-					sizeof(struct config_item),
-					&section->items, j);
+			struct config_item *item = section->items.array[j];
 
 			dstr_cat(&str, item->name);
 			dstr_cat(&str, "=");
@@ -331,109 +522,159 @@ int config_save(config_t *config)
 
 	dstr_free(&str);
 
+	config->dirty = false;
 	return CONFIG_SUCCESS;
 }
 
-void config_close(config_t *config)
+int config_save(config_t *config)
 {
-	struct config_section *defaults, *sections;
-	size_t i;
+	int errorcode;
 
-	if (!config) return;
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
 
-	defaults = config->defaults.array;
-	sections = config->sections.array;
+	pthread_mutex_lock(&config->mutex);
+	errorcode = save_locked(config);
+	pthread_mutex_unlock(&config->mutex);
 
-	for (i = 0; i < config->defaults.num; i++)
-		config_section_free(defaults+i);
-	for (i = 0; i < config->sections.num; i++)
-		config_section_free(sections+i);
+	return errorcode;
+}
 
-	darray_free(&config->defaults);
-	darray_free(&config->sections);
-	bfree(config->file);
-	bfree(config);
+static void save_if_pending(struct config_data *config)
+{
+	pthread_mutex_lock(&config->mutex);
+	if (config->save_pending)
+		save_locked(config);
+	pthread_mutex_unlock(&config->mutex);
 }
 
-size_t config_num_sections(config_t *config)
+static void *save_thread(void *data)
 {
-	return config->sections.num;
+	struct config_data *config = data;
+
+	for (;;) {
+		os_event_wait(config->save_event);
+
+		/* each request within the delay pushes the save back */
+		while (!config->save_stop &&
+		       os_event_timedwait(config->save_event,
+				       CONFIG_SAVE_DELAY_MS) == 0)
+			;
+
+		save_if_pending(config);
+
+		if (config->save_stop)
+			break;
+	}
+
+	return NULL;
 }
 
-const char *config_get_section(config_t *config, size_t idx)
+static bool start_save_thread(struct config_data *config)
 {
-	struct config_section *section;
+	if (os_event_init(&config->save_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
 
-	if (idx >= config->sections.num)
-		return NULL;
+	if (pthread_create(&config->save_thread, NULL, save_thread,
+				config) != 0) {
+		os_event_destroy(config->save_event);
+		config->save_event = NULL;
+		return false;
+	}
+
+	config->save_thread_active = true;
+	return true;
+}
+
+void config_save_async(config_t *config)
+{
+	bool deferred;
+
+	if (!config || !config->file)
+		return;
 
-	section = darray_item(sizeof(struct config_section), &config->sections,
-			idx);
+	pthread_mutex_lock(&config->mutex);
+	config->save_pending = true;
+	deferred = config->save_thread_active || start_save_thread(config);
+	pthread_mutex_unlock(&config->mutex);
 
-	return section->name;
+	if (deferred)
+		os_event_signal(config->save_event);
+	else
+		config_save(config);
 }
 
-static const struct config_item *config_find_item(const struct darray *sections,
-		const char *section, const char *name)
+/* a save requested with config_save_async is done before closing */
+static void stop_save_thread(struct config_data *config)
 {
-	size_t i, j;
+	if (!config->save_thread_active)
+		return;
 
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
+	config->save_stop = true;
+	os_event_signal(config->save_event);
+	pthread_join(config->save_thread, NULL);
 
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item = darray_item(
-						sizeof(struct config_item),
-						&sec->items, j);
+	os_event_destroy(config->save_event);
+	config->save_thread_active = false;
+}
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
-	}
+void config_close(config_t *config)
+{
+	if (!config) return;
 
-	return NULL;
+	stop_save_thread(config);
+
+	config_store_free(&config->defaults);
+	config_store_free(&config->user);
+	pthread_mutex_destroy(&config->mutex);
+	bfree(config->file);
+	bfree(config);
+}
+
+size_t config_num_sections(config_t *config)
+{
+	return config->user.sections.num;
 }
 
-static void config_set_item(struct darray *sections, const char *section,
+const char *config_get_section(config_t *config, size_t idx)
+{
+	if (idx >= config->user.sections.num)
+		return NULL;
+
+	return config->user.sections.array[idx]->name;
+}
+
+static void config_set_item(struct config_data *config,
+		struct config_store *store, const char *section,
 		const char *name, char *value)
 {
-	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
-	struct config_item *item;
-	size_t i, j;
+	struct config_section *sec;
+	struct config_item    *item;
 
-	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array+i;
-		struct config_item *items = cur_sec->items.array;
+	if (!section)
+		section = "";
+	if (!name)
+		name = "";
 
-		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items+j;
+	pthread_mutex_lock(&config->mutex);
 
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					return;
-				}
-			}
+	item = find_item(store, section, name);
+	if (item) {
+		set_item_value(item, value);
+	} else {
+		sec = find_section(store, section);
+		if (!sec)
+			sec = add_section(store, bstrdup(section));
 
-			sec = cur_sec;
-			break;
-		}
+		add_item(store, sec, bstrdup(name), value);
 	}
 
-	if (!sec) {
-		sec = darray_push_back_new(sizeof(struct config_section),
-				sections);
-		sec->name = bstrdup(section);
-	}
+	if (store == &config->user)
+		config->dirty = true;
 
-	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
-	item->name  = bstrdup(name);
-	item->value = value;
+	pthread_mutex_unlock(&config->mutex);
 }
 
 void config_set_string(config_t *config, const char *section,
@@ -441,7 +682,8 @@ void config_set_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->sections, section, name, bstrdup(value));
+	config_set_item(config, &config->user, section, name,
+			bstrdup(value));
 }
 
 void config_set_int(config_t *config, const char *section,
@@ -450,7 +692,8 @@ void config_set_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->sections, section, name, str.array);
+	config_set_item(config, &config->user, section, name,
+			str.array);
 }
 
 void config_set_uint(config_t *config, const char *section,
@@ -459,14 +702,16 @@ void config_set_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->sections, section, name, str.array);
+	config_set_item(config, &config->user, section, name,
+			str.array);
 }
 
 void config_set_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->sections, section, name, str);
+	config_set_item(config, &config->user, section, name,
+			str);
 }
 
 void config_set_double(config_t *config, const char *section,
@@ -475,7 +720,8 @@ void config_set_double(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%g", value);
-	config_set_item(&config->sections, section, name, str.array);
+	config_set_item(config, &config->user, section, name,
+			str.array);
 }
 
 void config_set_default_string(config_t *config, const char *section,
@@ -483,7 +729,8 @@ void config_set_default_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->defaults, section, name, bstrdup(value));
+	config_set_item(config, &config->defaults, section, name,
+			bstrdup(value));
 }
 
 void config_set_default_int(config_t *config, const char *section,
@@ -492,7 +739,8 @@ void config_set_default_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_item(config, &config->defaults, section, name,
+			str.array);
 }
 
 void config_set_default_uint(config_t *config, const char *section,
@@ -501,14 +749,16 @@ void config_set_default_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_item(config, &config->defaults, section, name,
+			str.array);
 }
 
 void config_set_default_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->defaults, section, name, str);
+	config_set_item(config, &config->defaults, section, name,
+			str);
 }
 
 void config_set_default_double(config_t *config, const char *section,
@@ -517,83 +767,56 @@ void config_set_default_double(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%g", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	config_set_item(config, &config->defaults, section, name,
+			str.array);
 }
 
-const char *config_get_string(const config_t *config, const char *section,
-		const char *name)
+/* user values take precedence over defaults */
+static inline const struct config_item *get_item(const config_t *config,
+		const char *section, const char *name)
 {
-	const struct config_item *item = config_find_item(&config->sections,
-			section, name);
-	if (!item)
-		item = config_find_item(&config->defaults, section, name);
+	const struct config_item *item;
+
+	item = find_item(&config->user, section, name);
 	if (!item)
-		return NULL;
+		item = find_item(&config->defaults, section, name);
 
-	return item->value;
+	return item;
 }
 
-static inline int64_t str_to_int64(const char *str)
-{
-	if (!str || !*str)
-		return 0;
-
-	if (str[0] == '0' && str[1] == 'x')
-		return strtoll(str + 2, NULL, 16);
-	else
-		return strtoll(str, NULL, 10);
-}
-
-static inline uint64_t str_to_uint64(const char *str)
+const char *config_get_string(const config_t *config, const char *section,
+		const char *name)
 {
-	if (!str || !*str)
-		return 0;
-
-	if (str[0] == '0' && str[1] == 'x')
-		return strtoull(str + 2, NULL, 16);
-	else
-		return strtoull(str, NULL, 10);
+	const struct config_item *item = get_item(config, section, name);
+	return item ? item->value : NULL;
 }
 
 int64_t config_get_int(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return str_to_int64(value);
-
-	return 0;
+	const struct config_item *item = get_item(config, section, name);
+	return item ? item->int_val : 0;
 }
 
 uint64_t config_get_uint(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return str_to_uint64(value);
-
-	return 0;
+	const struct config_item *item = get_item(config, section, name);
+	return item ? item->uint_val : 0;
 }
 
 bool config_get_bool(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return astrcmpi(value, "true") == 0 ||
-		       !!str_to_uint64(value);
-
-	return false;
+	const struct config_item *item = get_item(config, section, name);
+	return item ? item->bool_val : false;
 }
 
 double config_get_double(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return strtod(value, NULL);
-
-	return 0.0;
+	const struct config_item *item = get_item(config, section, name);
+	return item ? item->double_val : 0.0;
 }
 
 const char *config_get_default_string(const config_t *config,
@@ -601,63 +824,54 @@ const char *config_get_default_string(const config_t *config,
 {
 	const struct config_item *item;
 
-	item = config_find_item(&config->defaults, section, name);
-	if (!item)
-		return NULL;
-
-	return item->value;
+	item = find_item(&config->defaults, section, name);
+	return item ? item->value : NULL;
 }
 
 int64_t config_get_default_int(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return str_to_int64(value);
+	const struct config_item *item;
 
-	return 0;
+	item = find_item(&config->defaults, section, name);
+	return item ? item->int_val : 0;
 }
 
 uint64_t config_get_default_uint(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return str_to_uint64(value);
+	const struct config_item *item;
 
-	return 0;
+	item = find_item(&config->defaults, section, name);
+	return item ? item->uint_val : 0;
 }
 
 bool config_get_default_bool(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return astrcmpi(value, "true") == 0 ||
-		       !!str_to_uint64(value);
+	const struct config_item *item;
 
-	return false;
+	item = find_item(&config->defaults, section, name);
+	return item ? item->bool_val : false;
 }
 
 double config_get_default_double(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return strtod(value, NULL);
+	const struct config_item *item;
 
-	return 0.0;
+	item = find_item(&config->defaults, section, name);
+	return item ? item->double_val : 0.0;
 }
 
 bool config_has_user_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->sections, section, name) != NULL;
+	return find_item(&config->user, section, name) != NULL;
 }
 
 bool config_has_default_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->defaults, section, name) != NULL;
+	return find_item(&config->defaults, section, name) != NULL;
 }
-
@@ -45,7 +45,16 @@ EXPORT config_t *config_create(const char *file);
 EXPORT int config_open(config_t **config, const char *file,
 		enum config_open_type open_type);
 EXPORT int config_open_string(config_t **config, const char *str);
+/* only writes the file if a value was set since it was loaded or saved */
 EXPORT int config_save(config_t *config);
+
+/*
+ * Saves on a background thread once no save has been requested for a second,
+ * so code that changes values often can request a save after every change.
+ * config_close finishes a requested save before closing.
+ */
+EXPORT void config_save_async(config_t *config);
+
 EXPORT void config_close(config_t *config);
 
 EXPORT size_t config_num_sections(config_t *config);
@@ -38,25 +38,195 @@ extern "C" {
 
 #define DARRAY_INVALID ((size_t)-1)
 
+#define DARRAY_ARENA_ALIGNMENT  16
+#define DARRAY_ARENA_BLOCK_SIZE 4096
+
+struct darray_arena;
+
+/*
+ * Storage that is not owned by the array.  Arrays with inline storage use it
+ * until they outgrow it, then move to the heap like any other array.  Arrays
+ * backed by an arena allocate all of their memory from it, and never free
+ * any of it.
+ */
+struct darray_storage {
+	void *inline_array;
+	size_t inline_capacity;
+	struct darray_arena *arena;
+};
+
 struct darray {
 	void *array;
 	size_t num;
 	size_t capacity;
+	struct darray_storage *storage;
 };
 
+/*
+ * Frame arena.
+ *
+ *   Memory for arrays that only live for a single frame (or any other
+ * period).  Resetting the arena invalidates every array allocated from it
+ * at once; they must be initialized again before they are used.  After a
+ * reset, the memory of the previous period is kept as a single block, so
+ * the arena stops allocating once it has grown to its working size.
+ */
+
+struct darray_arena_block {
+	struct darray_arena_block *next;
+	size_t size;
+	size_t used;
+};
+
+struct darray_arena {
+	struct darray_storage storage;
+	struct darray_arena_block *blocks;
+};
+
+static inline void darray_arena_init(struct darray_arena *arena)
+{
+	arena->storage.inline_array    = NULL;
+	arena->storage.inline_capacity = 0;
+	arena->storage.arena           = arena;
+	arena->blocks                  = NULL;
+}
+
+static inline void darray_arena_free(struct darray_arena *arena)
+{
+	struct darray_arena_block *block = arena->blocks;
+
+	while (block) {
+		struct darray_arena_block *next = block->next;
+		bfree(block);
+		block = next;
+	}
+
+	arena->blocks = NULL;
+}
+
+static inline struct darray_arena_block *darray_arena_new_block(size_t size)
+{
+	struct darray_arena_block *block = bmalloc(
+			sizeof(struct darray_arena_block) + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+static inline void darray_arena_reset(struct darray_arena *arena)
+{
+	struct darray_arena_block *block = arena->blocks;
+	size_t total = 0;
+
+	if (!block)
+		return;
+
+	if (!block->next) {
+		block->used = 0;
+		return;
+	}
+
+	for (; block; block = block->next)
+		total += block->size;
+
+	darray_arena_free(arena);
+	arena->blocks = darray_arena_new_block(total);
+}
+
+static inline void *darray_arena_alloc(struct darray_arena *arena,
+		size_t size)
+{
+	struct darray_arena_block *block = arena->blocks;
+	size_t header = (sizeof(struct darray_arena_block) +
+			DARRAY_ARENA_ALIGNMENT - 1) &
+		~(size_t)(DARRAY_ARENA_ALIGNMENT - 1);
+	size_t offset;
+
+	size = (size + DARRAY_ARENA_ALIGNMENT - 1) &
+		~(size_t)(DARRAY_ARENA_ALIGNMENT - 1);
+
+	if (!block || block->used + size > block->size) {
+		size_t block_size = block ? block->size * 2 :
+			DARRAY_ARENA_BLOCK_SIZE;
+		if (block_size < size)
+			block_size = size;
+
+		block = darray_arena_new_block(block_size + header);
+		block->next = arena->blocks;
+		block->used = header - sizeof(struct darray_arena_block);
+		arena->blocks = block;
+	}
+
+	offset = block->used;
+	block->used += size;
+	return (uint8_t*)(block + 1) + offset;
+}
+
 static inline void darray_init(struct darray *dst)
 {
 	dst->array    = NULL;
 	dst->num      = 0;
 	dst->capacity = 0;
+	dst->storage  = NULL;
 }
 
-static inline void darray_free(struct darray *dst)
+/* inline storage must be part of the object that contains the array, and the
+ * object must not be copied or moved in memory after this */
+static inline void darray_init_inline(struct darray *dst,
+		struct darray_storage *storage, void *array, size_t capacity)
 {
-	bfree(dst->array);
-	dst->array    = NULL;
+	storage->inline_array    = array;
+	storage->inline_capacity = capacity;
+	storage->arena           = NULL;
+
+	dst->array    = array;
 	dst->num      = 0;
-	dst->capacity = 0;
+	dst->capacity = capacity;
+	dst->storage  = storage;
+}
+
+static inline void darray_init_arena(struct darray *dst,
+		struct darray_arena *arena)
+{
+	darray_init(dst);
+	dst->storage = &arena->storage;
+}
+
+static inline bool darray_uses_arena(const struct darray *da)
+{
+	return da->storage && da->storage->arena;
+}
+
+/* whether the current memory of the array was allocated by the array */
+static inline bool darray_owns_array(const struct darray *da)
+{
+	if (!da->array || darray_uses_arena(da))
+		return false;
+	return !da->storage || da->array != da->storage->inline_array;
+}
+
+static inline void *darray_alloc(const struct darray *dst, size_t size)
+{
+	return darray_uses_arena(dst) ?
+		darray_arena_alloc(dst->storage->arena, size) :
+		bmalloc(size);
+}
+
+static inline void darray_free(struct darray *dst)
+{
+	if (darray_owns_array(dst))
+		bfree(dst->array);
+
+	dst->num = 0;
+
+	if (dst->storage && dst->storage->inline_array) {
+		dst->array    = dst->storage->inline_array;
+		dst->capacity = dst->storage->inline_capacity;
+	} else {
+		dst->array    = NULL;
+		dst->capacity = 0;
+	}
 }
 
 static inline size_t darray_alloc_size(const size_t element_size,
@@ -84,13 +254,13 @@ static inline void darray_reserve(const size_t element_size,
 		struct darray *dst, const size_t capacity)
 {
 	void *ptr;
-	if (capacity == 0 || capacity <= dst->num)
+	if (capacity == 0 || capacity <= dst->capacity)
 		return;
 
-	ptr = bmalloc(element_size*capacity);
+	ptr = darray_alloc(dst, element_size*capacity);
 	if (dst->num)
 		memcpy(ptr, dst->array, element_size*dst->num);
-	if (dst->array)
+	if (darray_owns_array(dst))
 		bfree(dst->array);
 	dst->array = ptr;
 	dst->capacity = capacity;
@@ -107,10 +277,10 @@ static inline void darray_ensure_capacity(const size_t element_size,
 	new_cap = (!dst->capacity) ? new_size : dst->capacity*2;
 	if (new_size > new_cap)
 		new_cap = new_size;
-	ptr = bmalloc(element_size*new_cap);
+	ptr = darray_alloc(dst, element_size*new_cap);
 	if (dst->capacity)
 		memcpy(ptr, dst->array, element_size*dst->capacity);
-	if (dst->array)
+	if (darray_owns_array(dst))
 		bfree(dst->array);
 	dst->array = ptr;
 	dst->capacity = new_cap;
@@ -158,13 +328,23 @@ static inline void darray_copy_array(const size_t element_size,
 	memcpy(dst->array, array, element_size*dst->num);
 }
 
-static inline void darray_move(struct darray *dst, struct darray *src)
+static inline void darray_move(const size_t element_size,
+		struct darray *dst, struct darray *src)
 {
 	darray_free(dst);
-	memcpy(dst, src, sizeof(struct darray));
+
+	/* memory that isn't owned by the source has to be copied */
+	if (!darray_owns_array(src) || darray_uses_arena(dst)) {
+		darray_copy(element_size, dst, src);
+		darray_free(src);
+		return;
+	}
+
+	dst->array    = src->array;
+	dst->num      = src->num;
+	dst->capacity = src->capacity;
 	src->array    = NULL;
-	src->capacity = 0;
-	src->num      = 0;
+	darray_free(src);
 }
 
 static inline size_t darray_find(const size_t element_size,
@@ -258,10 +438,10 @@ static inline void *darray_insert_new(const size_t element_size,
 	if (idx == dst->num)
 		return darray_push_back_new(element_size, dst);
 
-	item = darray_item(element_size, dst, idx);
-
 	move_count = dst->num - idx;
 	darray_ensure_capacity(element_size, dst, ++dst->num);
+
+	item = darray_item(element_size, dst, idx);
 	memmove(darray_item(element_size, dst, idx+1), item,
 			move_count*element_size);
 
@@ -451,10 +631,33 @@ static inline void darray_swap(const size_t element_size,
 		};                       \
 	}
 
+/*
+ * Dynamic array with inline storage for the first n elements, which avoids
+ * allocating at all for arrays that usually stay small.  Must be initialized
+ * with da_init_inline, and must not be copied or moved in memory.
+ */
+#define DARRAY_INLINE(type, n)                    \
+	struct {                                  \
+		DARRAY(type);                     \
+		struct darray_storage storage;    \
+		type inline_array[n];             \
+	}
+
 #define da_init(v) darray_init(&v.da)
 
+#define da_init_inline(v) \
+	darray_init_inline(&v.da, &v.storage, v.inline_array, \
+			sizeof(v.inline_array) / sizeof(*v.inline_array))
+
+/* the array is invalidated by the next darray_arena_reset of the arena */
+#define da_init_arena(v, arena) darray_init_arena(&v.da, arena)
+
 #define da_free(v) darray_free(&v.da)
 
+/* empties the array but keeps its memory, for scratch arrays that are filled
+ * again every frame (da_reserve never shrinks an array either) */
+#define da_clear(v) darray_resize(sizeof(*v.array), &v.da, 0)
+
 #define da_alloc_size(v) (sizeof(*v.array)*v.num)
 
 #define da_end(v) darray_end(sizeof(*v.array), &v.da)
@@ -470,7 +673,8 @@ static inline void darray_swap(const size_t element_size,
 #define da_copy_array(dst, src_array, n) \
 	darray_copy_array(sizeof(*dst.array), &dst.da, src_array, n)
 
-#define da_move(dst, src) darray_move(&dst.da, &src.da)
+#define da_move(dst, src) \
+	darray_move(sizeof(*dst.array), &dst.da, &src.da)
 
 #define da_find(v, item, idx) \
 	darray_find(sizeof(*v.array), &v.da, item, idx)
@@ -656,11 +656,12 @@ wchar_t *dstr_to_wcs(const struct dstr *str)
 
 void dstr_from_wcs(struct dstr *dst, const wchar_t *wstr)
 {
-	size_t len = wchar_to_utf8(wstr, 0, NULL, 0, 0);
+	size_t wlen = wstr ? wcslen(wstr) : 0;
+	size_t len = wlen ? wchar_to_utf8(wstr, wlen, NULL, 0, 0) : 0;
 
 	if (len) {
 		dstr_resize(dst, len);
-		wchar_to_utf8(wstr, 0, dst->array, len+1, 0);
+		wchar_to_utf8(wstr, wlen, dst->array, len+1, 0);
 	} else {
 		dstr_free(dst);
 	}
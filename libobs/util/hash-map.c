@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2015 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "bmem.h"
+#include "hash-map.h"
+
+#define MIN_CAPACITY 16
+
+/* marks removed entries, so probing continues past them */
+static const char removed_key = 0;
+#define REMOVED_KEY (&removed_key)
+
+static inline bool entry_used(const struct hash_map_entry *entry)
+{
+	return entry->key && entry->key != REMOVED_KEY;
+}
+
+uint32_t hash_map_hash(const char *key)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*key) {
+		hash ^= (uint8_t)*(key++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+void hash_map_free(struct hash_map *map)
+{
+	if (map) {
+		bfree(map->entries);
+		hash_map_init(map);
+	}
+}
+
+static struct hash_map_entry *find_entry(const struct hash_map *map,
+		const char *key, uint32_t hash)
+{
+	size_t mask, idx;
+
+	if (!map->capacity)
+		return NULL;
+
+	mask = map->capacity - 1;
+	idx  = hash & mask;
+
+	for (;;) {
+		struct hash_map_entry *entry = map->entries + idx;
+
+		if (!entry->key)
+			return NULL;
+		if (entry->key != REMOVED_KEY && entry->hash == hash &&
+		    strcmp(entry->key, key) == 0)
+			return entry;
+
+		idx = (idx + 1) & mask;
+	}
+}
+
+static inline struct hash_map_entry *find_free_entry(struct hash_map *map,
+		uint32_t hash)
+{
+	size_t mask = map->capacity - 1;
+	size_t idx  = hash & mask;
+
+	while (entry_used(map->entries + idx))
+		idx = (idx + 1) & mask;
+
+	return map->entries + idx;
+}
+
+static void resize(struct hash_map *map, size_t capacity)
+{
+	struct hash_map_entry *old_entries = map->entries;
+	size_t old_capacity = map->capacity;
+
+	map->entries  = bzalloc(capacity * sizeof(struct hash_map_entry));
+	map->capacity = capacity;
+	map->used     = map->num;
+
+	for (size_t i = 0; i < old_capacity; i++) {
+		struct hash_map_entry *entry = old_entries + i;
+
+		if (entry_used(entry))
+			*find_free_entry(map, entry->hash) = *entry;
+	}
+
+	bfree(old_entries);
+}
+
+/* keeps the load (including removed entries) at or under 3/4 */
+static inline void ensure_capacity(struct hash_map *map)
+{
+	size_t capacity;
+
+	if ((map->used + 1) * 4 <= map->capacity * 3)
+		return;
+
+	if (!map->capacity)
+		capacity = MIN_CAPACITY;
+	else if ((map->num + 1) * 2 > map->capacity)
+		capacity = map->capacity * 2;
+	else
+		/* mostly removed entries, rehashing at the same size is
+		 * enough */
+		capacity = map->capacity;
+
+	resize(map, capacity);
+}
+
+void *hash_map_find(const struct hash_map *map, const char *key)
+{
+	struct hash_map_entry *entry;
+
+	if (!map || !key)
+		return NULL;
+
+	entry = find_entry(map, key, hash_map_hash(key));
+	return entry ? entry->value : NULL;
+}
+
+void hash_map_set(struct hash_map *map, const char *key, void *value)
+{
+	struct hash_map_entry *entry;
+	uint32_t hash;
+
+	if (!map || !key)
+		return;
+
+	hash  = hash_map_hash(key);
+	entry = find_entry(map, key, hash);
+
+	if (!entry) {
+		ensure_capacity(map);
+
+		entry = find_free_entry(map, hash);
+		if (!entry->key)
+			map->used++;
+		map->num++;
+	}
+
+	entry->key   = key;
+	entry->value = value;
+	entry->hash  = hash;
+}
+
+bool hash_map_remove(struct hash_map *map, const char *key)
+{
+	struct hash_map_entry *entry;
+
+	if (!map || !key)
+		return false;
+
+	entry = find_entry(map, key, hash_map_hash(key));
+	if (!entry)
+		return false;
+
+	entry->key   = REMOVED_KEY;
+	entry->value = NULL;
+	map->num--;
+	return true;
+}
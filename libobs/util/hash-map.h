@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * String hash map
+ *
+ *   Open addressing (linear probing) map from strings to pointers.  Keys are
+ * not copied, the caller must keep each key valid for as long as it's in the
+ * map, and must set it again if the key's memory moves.  Not thread safe.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hash_map_entry {
+	const char *key;
+	void       *value;
+	uint32_t   hash;
+};
+
+struct hash_map {
+	struct hash_map_entry *entries;
+	size_t                capacity;
+	size_t                num;
+
+	/* entries in use plus removed entries, used for resizing */
+	size_t                used;
+};
+
+static inline void hash_map_init(struct hash_map *map)
+{
+	map->entries  = NULL;
+	map->capacity = 0;
+	map->num      = 0;
+	map->used     = 0;
+}
+
+EXPORT void hash_map_free(struct hash_map *map);
+
+EXPORT uint32_t hash_map_hash(const char *key);
+
+/* returns NULL if the key isn't in the map */
+EXPORT void *hash_map_find(const struct hash_map *map, const char *key);
+
+/* adds the key, or replaces the existing key pointer and value */
+EXPORT void hash_map_set(struct hash_map *map, const char *key, void *value);
+
+EXPORT bool hash_map_remove(struct hash_map *map, const char *key);
+
+#ifdef __cplusplus
+}
+#endif
@@ -26,6 +26,8 @@
 #include <CoreServices/CoreServices.h>
 #include <mach/mach.h>
 #include <mach/mach_time.h>
+#include <pthread.h>
+#include <pthread/qos.h>
 
 #import <Cocoa/Cocoa.h>
 
@@ -214,3 +216,26 @@ void os_end_high_performance(os_performance_token_t *token)
 	}
 }
 
+static const qos_class_t role_qos[OS_THREAD_ROLE_COUNT] = {
+	QOS_CLASS_DEFAULT,
+	QOS_CLASS_USER_INTERACTIVE,
+	QOS_CLASS_USER_INTERACTIVE,
+	QOS_CLASS_USER_INITIATED,
+	QOS_CLASS_USER_INITIATED
+};
+
+bool os_set_thread_role(enum os_thread_role role)
+{
+	if (role < 0 || role >= OS_THREAD_ROLE_COUNT)
+		return false;
+
+	return pthread_set_qos_class_self_np(role_qos[role], 0) == 0;
+}
+
+/* macOS only supports affinity tags (threads sharing an L2 cache), not
+ * binding threads to specific cores */
+bool os_set_thread_affinity(uint64_t mask)
+{
+	UNUSED_PARAMETER(mask);
+	return false;
+}
@@ -14,6 +14,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#if !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -23,16 +27,66 @@
 #include <unistd.h>
 #include <glob.h>
 #include <time.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #if !defined(__APPLE__)
 #include <sys/times.h>
 #include <sys/vtimes.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <pthread.h>
 #endif
 
 #include "darray.h"
 #include "dstr.h"
 #include "platform.h"
 
+bool os_fpreallocate(FILE *file, int64_t size)
+{
+	int fd = fileno(file);
+
+	if (fd == -1)
+		return false;
+
+	if (!size) {
+		struct stat st;
+
+		fflush(file);
+		if (fstat(fd, &st) != 0)
+			return false;
+		return ftruncate(fd, st.st_size) == 0;
+	}
+
+#if defined(__APPLE__)
+	struct stat st;
+	fstore_t store = {
+		.fst_flags   = F_ALLOCATECONTIG,
+		.fst_posmode = F_PEOFPOSMODE
+	};
+
+	if (fstat(fd, &st) != 0)
+		return false;
+
+	/* F_PEOFPOSMODE allocates past what's already allocated */
+	store.fst_length = (off_t)size - (off_t)st.st_blocks * 512;
+	if (store.fst_length <= 0)
+		return true;
+
+	if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+		store.fst_flags = F_ALLOCATEALL;
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+			return false;
+	}
+	return true;
+#elif defined(__linux__)
+	return fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0;
+#else
+	return false;
+#endif
+}
+
 void *os_dlopen(const char *path)
 {
 	struct dstr dylib_name;
@@ -144,6 +198,60 @@ void os_sleep_ms(uint32_t duration)
 	usleep(duration*1000);
 }
 
+/* the kernel usually wakes a thread within 50-100us of its timer */
+#define TIMER_SPIN_NS 150000ULL
+
+struct os_timer {
+	uint64_t spin_ns;
+};
+
+os_timer_t *os_timer_create(void)
+{
+	struct os_timer *timer = bzalloc(sizeof(struct os_timer));
+	timer->spin_ns = TIMER_SPIN_NS;
+	return timer;
+}
+
+void os_timer_destroy(os_timer_t *timer)
+{
+	bfree(timer);
+}
+
+bool os_timer_sleepto_ns(os_timer_t *timer, uint64_t time_target)
+{
+	uint64_t spin_ns = timer ? timer->spin_ns : TIMER_SPIN_NS;
+	uint64_t current = os_gettime_ns();
+
+	if (time_target <= current)
+		return false;
+
+	if (time_target - current > spin_ns) {
+#ifdef __APPLE__
+		os_sleepto_ns(time_target - spin_ns);
+#else
+		uint64_t        wake = time_target - spin_ns;
+		struct timespec ts;
+
+		ts.tv_sec  = (time_t)(wake / 1000000000);
+		ts.tv_nsec = (long)(wake % 1000000000);
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL) == EINTR);
+#endif
+	}
+
+	while (os_gettime_ns() < time_target)
+		sched_yield();
+
+	return true;
+}
+
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
 #if !defined(__APPLE__)
 
 uint64_t os_gettime_ns(void)
@@ -174,6 +282,16 @@ bool os_file_exists(const char *path)
 	return access(path, F_OK) == 0;
 }
 
+int64_t os_get_file_mod_time(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		return -1;
+
+	return (int64_t)st.st_mtime;
+}
+
 struct os_dir {
 	const char       *path;
 	DIR              *dir;
@@ -287,6 +405,11 @@ int os_unlink(const char *path)
 	return unlink(path);
 }
 
+int os_rename(const char *old_path, const char *new_path)
+{
+	return rename(old_path, new_path);
+}
+
 int os_mkdir(const char *path)
 {
 	if (mkdir(path, 0777) == 0)
@@ -295,6 +418,80 @@ int os_mkdir(const char *path)
 	return (errno == EEXIST) ? MKDIR_EXISTS : MKDIR_ERROR;
 }
 
+struct os_shmem {
+	char   *name;
+	void   *data;
+	size_t size;
+};
+
+os_shmem_t *os_shmem_create(const char *name, size_t size)
+{
+	struct os_shmem *shmem;
+	struct dstr     shm_name = {0};
+	void            *data;
+	int             fd;
+
+	if (!name || !*name || !size)
+		return NULL;
+
+	dstr_printf(&shm_name, "/%s", name);
+
+	fd = shm_open(shm_name.array, O_RDWR | O_CREAT, 0600);
+	if (fd == -1) {
+		blog(LOG_WARNING, "os_shmem_create: shm_open '%s' failed: %d",
+				shm_name.array, errno);
+		goto fail;
+	}
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		blog(LOG_WARNING, "os_shmem_create: ftruncate '%s' failed: %d",
+				shm_name.array, errno);
+		close(fd);
+		goto fail_unlink;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		blog(LOG_WARNING, "os_shmem_create: mmap '%s' failed: %d",
+				shm_name.array, errno);
+		goto fail_unlink;
+	}
+
+	shmem = bzalloc(sizeof(struct os_shmem));
+	shmem->name = shm_name.array;
+	shmem->data = data;
+	shmem->size = size;
+	return shmem;
+
+fail_unlink:
+	shm_unlink(shm_name.array);
+fail:
+	dstr_free(&shm_name);
+	return NULL;
+}
+
+void os_shmem_destroy(os_shmem_t *shmem)
+{
+	if (shmem) {
+		munmap(shmem->data, shmem->size);
+		shm_unlink(shmem->name);
+		bfree(shmem->name);
+		bfree(shmem);
+	}
+}
+
+void *os_shmem_get_data(os_shmem_t *shmem)
+{
+	return shmem ? shmem->data : NULL;
+}
+
+size_t os_shmem_get_size(const os_shmem_t *shmem)
+{
+	return shmem ? shmem->size : 0;
+}
+
 #if !defined(__APPLE__)
 os_performance_token_t *os_request_high_performance(const char *reason)
 {
@@ -306,5 +503,77 @@ void os_end_high_performance(os_performance_token_t *token)
 {
 	UNUSED_PARAMETER(token);
 }
+
+/* priorities within SCHED_RR (1-99), kept low so that system threads such as
+ * interrupt handlers still come first */
+static const int role_rt_priority[OS_THREAD_ROLE_COUNT] = {
+	0,  /* normal */
+	10, /* audio */
+	5,  /* video */
+	0,  /* encoder */
+	0   /* network */
+};
+
+/* fallback when real-time scheduling isn't permitted */
+static const int role_nice[OS_THREAD_ROLE_COUNT] = {
+	0,   /* normal */
+	-11, /* audio */
+	-10, /* video */
+	-5,  /* encoder */
+	-5   /* network */
+};
+
+bool os_set_thread_role(enum os_thread_role role)
+{
+	struct sched_param param = {0};
+	bool success = false;
+	uint64_t mask;
+
+	if (role < 0 || role >= OS_THREAD_ROLE_COUNT)
+		return false;
+
+	if (role_rt_priority[role]) {
+		param.sched_priority = role_rt_priority[role];
+		success = pthread_setschedparam(pthread_self(), SCHED_RR,
+				&param) == 0;
+	} else {
+		param.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	}
+
+	/* on linux, nice values apply to individual threads */
+	if (!success)
+		success = setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+				role_nice[role]) == 0;
+
+	if (!success)
+		blog(LOG_DEBUG, "os_set_thread_role: could not raise priority "
+		                "of thread for role %d", (int)role);
+
+	mask = os_get_thread_role_affinity(role);
+	if (mask)
+		os_set_thread_affinity(mask);
+
+	return success;
+}
+
+bool os_set_thread_affinity(uint64_t mask)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+
+	if (!mask) {
+		for (int i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	} else {
+		for (int i = 0; i < 64; i++) {
+			if (mask & (1ULL << i))
+				CPU_SET(i, &set);
+		}
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
 #endif
 
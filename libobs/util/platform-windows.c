@@ -18,6 +18,7 @@
 #include <mmsystem.h>
 #include <shellapi.h>
 #include <shlobj.h>
+#include <io.h>
 
 #include "base.h"
 #include "platform.h"
@@ -168,6 +169,78 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 }
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/* high resolution waitable timers (windows 10 1803+) wake within about half
+ * a millisecond, regular ones only at the timer resolution */
+#define TIMER_SPIN_NS        600000ULL
+#define TIMER_SPIN_NS_COARSE 2000000ULL
+
+struct os_timer {
+	HANDLE   handle;
+	uint64_t spin_ns;
+};
+
+os_timer_t *os_timer_create(void)
+{
+	struct os_timer *timer = bzalloc(sizeof(struct os_timer));
+
+	timer->handle = CreateWaitableTimerExW(NULL, NULL,
+			CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+			TIMER_ALL_ACCESS);
+	timer->spin_ns = TIMER_SPIN_NS;
+
+	if (!timer->handle) {
+		timer->handle  = CreateWaitableTimerW(NULL, false, NULL);
+		timer->spin_ns = TIMER_SPIN_NS_COARSE;
+	}
+
+	return timer;
+}
+
+void os_timer_destroy(os_timer_t *timer)
+{
+	if (timer) {
+		if (timer->handle)
+			CloseHandle(timer->handle);
+		bfree(timer);
+	}
+}
+
+bool os_timer_sleepto_ns(os_timer_t *timer, uint64_t time_target)
+{
+	uint64_t t = os_gettime_ns();
+
+	if (!timer || !timer->handle)
+		return os_sleepto_ns(time_target);
+	if (t >= time_target)
+		return false;
+
+	if (time_target - t > timer->spin_ns) {
+		LARGE_INTEGER due;
+
+		/* negative values are relative, in 100ns units */
+		due.QuadPart = -(LONGLONG)((time_target - t - timer->spin_ns) /
+				100);
+
+		if (SetWaitableTimer(timer->handle, &due, 0, NULL, NULL, false))
+			WaitForSingleObject(timer->handle, INFINITE);
+	}
+
+	for (;;) {
+		t = os_gettime_ns();
+		if (t >= time_target)
+			return true;
+
+		if (time_target - t > 100000)
+			Sleep(0);
+		else
+			YieldProcessor();
+	}
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	/* windows 8+ appears to have decreased sleep precision */
@@ -177,6 +250,123 @@ void os_sleep_ms(uint32_t duration)
 	Sleep(duration);
 }
 
+int os_get_logical_cores(void)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+/* avrt.dll is loaded on demand so libobs doesn't have to link to it */
+typedef HANDLE (WINAPI *AVSETMMTHREADCHARACTERISTICSW)(LPCWSTR, LPDWORD);
+typedef BOOL (WINAPI *AVREVERTMMTHREADCHARACTERISTICS)(HANDLE);
+typedef BOOL (WINAPI *AVSETMMTHREADPRIORITY)(HANDLE, int);
+
+#define AVRT_PRIORITY_HIGH_VAL 1
+
+static __declspec(thread) HANDLE mmcss_handle = NULL;
+
+static const wchar_t *role_mmcss_task[OS_THREAD_ROLE_COUNT] = {
+	NULL,
+	L"Pro Audio",
+	L"Capture",
+	NULL,
+	NULL
+};
+
+static const int role_priority[OS_THREAD_ROLE_COUNT] = {
+	THREAD_PRIORITY_NORMAL,
+	THREAD_PRIORITY_TIME_CRITICAL,
+	THREAD_PRIORITY_HIGHEST,
+	THREAD_PRIORITY_ABOVE_NORMAL,
+	THREAD_PRIORITY_ABOVE_NORMAL
+};
+
+static void revert_mmcss(void)
+{
+	AVREVERTMMTHREADCHARACTERISTICS revert;
+	HMODULE avrt;
+
+	if (!mmcss_handle)
+		return;
+
+	avrt = GetModuleHandleW(L"avrt");
+	revert = avrt ? (AVREVERTMMTHREADCHARACTERISTICS)GetProcAddress(avrt,
+			"AvRevertMmThreadCharacteristics") : NULL;
+	if (revert)
+		revert(mmcss_handle);
+
+	mmcss_handle = NULL;
+}
+
+static bool set_mmcss_task(const wchar_t *task, bool high)
+{
+	AVSETMMTHREADCHARACTERISTICSW set_task;
+	AVSETMMTHREADPRIORITY set_priority;
+	HMODULE avrt = LoadLibraryW(L"avrt");
+	DWORD idx = 0;
+
+	if (!avrt)
+		return false;
+
+	set_task = (AVSETMMTHREADCHARACTERISTICSW)GetProcAddress(avrt,
+			"AvSetMmThreadCharacteristicsW");
+	set_priority = (AVSETMMTHREADPRIORITY)GetProcAddress(avrt,
+			"AvSetMmThreadPriority");
+	if (!set_task)
+		return false;
+
+	mmcss_handle = set_task(task, &idx);
+	if (!mmcss_handle)
+		return false;
+
+	if (high && set_priority)
+		set_priority(mmcss_handle, AVRT_PRIORITY_HIGH_VAL);
+	return true;
+}
+
+bool os_set_thread_role(enum os_thread_role role)
+{
+	bool success = false;
+	uint64_t mask;
+
+	if (role < 0 || role >= OS_THREAD_ROLE_COUNT)
+		return false;
+
+	revert_mmcss();
+
+	if (role_mmcss_task[role])
+		success = set_mmcss_task(role_mmcss_task[role],
+				role == OS_THREAD_ROLE_AUDIO);
+	if (!success)
+		success = !!SetThreadPriority(GetCurrentThread(),
+				role_priority[role]);
+
+	if (!success)
+		blog(LOG_DEBUG, "os_set_thread_role: could not raise priority "
+		                "of thread for role %d", (int)role);
+
+	mask = os_get_thread_role_affinity(role);
+	if (mask)
+		os_set_thread_affinity(mask);
+
+	return success;
+}
+
+bool os_set_thread_affinity(uint64_t mask)
+{
+	DWORD_PTR process_mask, system_mask;
+
+	if (!mask) {
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask,
+					&system_mask))
+			return false;
+		mask = process_mask;
+	}
+
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+}
+
 uint64_t os_gettime_ns(void)
 {
 	LARGE_INTEGER current_time;
@@ -207,23 +397,68 @@ char *os_get_config_path(const char *name)
 	return path.array;
 }
 
+bool os_fpreallocate(FILE *file, int64_t size)
+{
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	FILE_ALLOCATION_INFO info;
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	/* allocation past the end of the file is released when the file is
+	 * closed, and setting an allocation size smaller than the file would
+	 * truncate it */
+	if (!size)
+		return true;
+	if (size < os_ftelli64(file))
+		return true;
+
+	/* unlike SetEndOfFile, this reserves the space without changing the
+	 * file size, so the file never contains unwritten data */
+	info.AllocationSize.QuadPart = size;
+	return !!SetFileInformationByHandle(handle, FileAllocationInfo,
+			&info, sizeof(info));
+}
+
 bool os_file_exists(const char *path)
 {
 	WIN32_FIND_DATAW wfd;
-	HANDLE hFind;
+	HANDLE hFind = INVALID_HANDLE_VALUE;
+	wchar_t buf[MAX_PATH];
 	wchar_t *path_utf16;
 
-	if (!os_utf8_to_wcs_ptr(path, 0, &path_utf16))
-		return false;
-
-	hFind = FindFirstFileW(path_utf16, &wfd);
-	if (hFind != INVALID_HANDLE_VALUE)
-		FindClose(hFind);
+	if (os_utf8_to_wcs_ptr_buf(path, 0, buf, MAX_PATH, &path_utf16)) {
+		hFind = FindFirstFileW(path_utf16, &wfd);
+		if (hFind != INVALID_HANDLE_VALUE)
+			FindClose(hFind);
+	}
 
-	bfree(path_utf16);
+	if (path_utf16 != buf)
+		bfree(path_utf16);
 	return hFind != INVALID_HANDLE_VALUE;
 }
 
+int64_t os_get_file_mod_time(const char *path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	wchar_t buf[MAX_PATH];
+	wchar_t *path_utf16;
+	BOOL success = false;
+
+	if (os_utf8_to_wcs_ptr_buf(path, 0, buf, MAX_PATH, &path_utf16))
+		success = GetFileAttributesExW(path_utf16,
+				GetFileExInfoStandard, &attr);
+
+	if (path_utf16 != buf)
+		bfree(path_utf16);
+
+	if (!success)
+		return -1;
+
+	return (int64_t)(((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) |
+	                 attr.ftLastWriteTime.dwLowDateTime);
+}
+
 struct os_dir {
 	HANDLE           handle;
 	WIN32_FIND_DATA  wfd;
@@ -365,29 +600,56 @@ void os_globfree(os_glob_t *pglob)
 
 int os_unlink(const char *path)
 {
+	wchar_t buf[MAX_PATH];
 	wchar_t *w_path;
 	bool success;
 
-	os_utf8_to_wcs_ptr(path, 0, &w_path);
+	os_utf8_to_wcs_ptr_buf(path, 0, buf, MAX_PATH, &w_path);
 	if (!w_path)
 		return -1;
 
 	success = !!DeleteFileW(w_path);
-	bfree(w_path);
+	if (w_path != buf)
+		bfree(w_path);
+
+	return success ? 0 : -1;
+}
+
+int os_rename(const char *old_path, const char *new_path)
+{
+	wchar_t *w_old_path = NULL;
+	wchar_t *w_new_path = NULL;
+	bool success = false;
+
+	os_utf8_to_wcs_ptr(old_path, 0, &w_old_path);
+	os_utf8_to_wcs_ptr(new_path, 0, &w_new_path);
+
+	if (w_old_path && w_new_path)
+		success = !!MoveFileExW(w_old_path, w_new_path,
+				MOVEFILE_REPLACE_EXISTING |
+				MOVEFILE_WRITE_THROUGH);
+
+	bfree(w_old_path);
+	bfree(w_new_path);
 
 	return success ? 0 : -1;
 }
 
 int os_mkdir(const char *path)
 {
+	wchar_t buf[MAX_PATH];
 	wchar_t *path_utf16;
 	BOOL success;
 
-	if (!os_utf8_to_wcs_ptr(path, 0, &path_utf16))
+	if (!os_utf8_to_wcs_ptr_buf(path, 0, buf, MAX_PATH, &path_utf16)) {
+		if (path_utf16 != buf)
+			bfree(path_utf16);
 		return MKDIR_ERROR;
+	}
 
 	success = CreateDirectory(path_utf16, NULL);
-	bfree(path_utf16);
+	if (path_utf16 != buf)
+		bfree(path_utf16);
 
 	if (!success)
 		return (GetLastError() == ERROR_ALREADY_EXISTS) ?
@@ -396,6 +658,68 @@ int os_mkdir(const char *path)
 	return MKDIR_SUCCESS;
 }
 
+struct os_shmem {
+	HANDLE map;
+	void   *data;
+	size_t size;
+};
+
+os_shmem_t *os_shmem_create(const char *name, size_t size)
+{
+	struct os_shmem *shmem;
+	wchar_t         *wname;
+	HANDLE          map;
+	void            *data;
+
+	if (!name || !*name || !size)
+		return NULL;
+	if (!os_utf8_to_wcs_ptr(name, 0, &wname))
+		return NULL;
+
+	map = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+			(DWORD)((uint64_t)size >> 32), (DWORD)size, wname);
+	bfree(wname);
+
+	if (!map) {
+		blog(LOG_WARNING, "os_shmem_create: CreateFileMapping '%s' "
+		                  "failed: %lu", name, GetLastError());
+		return NULL;
+	}
+
+	data = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!data) {
+		blog(LOG_WARNING, "os_shmem_create: MapViewOfFile '%s' "
+		                  "failed: %lu", name, GetLastError());
+		CloseHandle(map);
+		return NULL;
+	}
+
+	shmem = bzalloc(sizeof(struct os_shmem));
+	shmem->map  = map;
+	shmem->data = data;
+	shmem->size = size;
+	return shmem;
+}
+
+void os_shmem_destroy(os_shmem_t *shmem)
+{
+	if (shmem) {
+		UnmapViewOfFile(shmem->data);
+		CloseHandle(shmem->map);
+		bfree(shmem);
+	}
+}
+
+void *os_shmem_get_data(os_shmem_t *shmem)
+{
+	return shmem ? shmem->data : NULL;
+}
+
+size_t os_shmem_get_size(const os_shmem_t *shmem)
+{
+	return shmem ? shmem->size : 0;
+}
+
 
 BOOL WINAPI DllMain(HINSTANCE hinst_dll, DWORD reason, LPVOID reserved)
 {
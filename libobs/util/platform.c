@@ -30,17 +30,21 @@ FILE *os_wfopen(const wchar_t *path, const char *mode)
 
 	if (path) {
 #ifdef _MSC_VER
+		wchar_t mode_buf[16];
 		wchar_t *wcs_mode;
 
-		os_utf8_to_wcs_ptr(mode, 0, &wcs_mode);
+		os_utf8_to_wcs_ptr_buf(mode, 0, mode_buf, 16, &wcs_mode);
 		file = _wfopen(path, wcs_mode);
-		bfree(wcs_mode);
+		if (wcs_mode != mode_buf)
+			bfree(wcs_mode);
 #else
+		char path_buf[512];
 		char *mbs_path;
 
-		os_wcs_to_utf8_ptr(path, 0, &mbs_path);
+		os_wcs_to_utf8_ptr_buf(path, 0, path_buf, 512, &mbs_path);
 		file = fopen(mbs_path, mode);
-		bfree(mbs_path);
+		if (mbs_path != path_buf)
+			bfree(mbs_path);
 #endif
 	}
 
@@ -50,13 +54,15 @@ FILE *os_wfopen(const wchar_t *path, const char *mode)
 FILE *os_fopen(const char *path, const char *mode)
 {
 #ifdef _WIN32
+	wchar_t path_buf[512];
 	wchar_t *wpath = NULL;
 	FILE *file = NULL;
 
 	if (path) {
-		os_utf8_to_wcs_ptr(path, 0, &wpath);
+		os_utf8_to_wcs_ptr_buf(path, 0, path_buf, 512, &wpath);
 		file = os_wfopen(wpath, mode);
-		bfree(wpath);
+		if (wpath != path_buf)
+			bfree(wpath);
 	}
 
 	return file;
@@ -235,6 +241,37 @@ bool os_quick_write_utf8_file(const char *path, const char *str, size_t len,
 	return true;
 }
 
+bool os_safe_write_utf8_file(const char *path, const char *str, size_t len,
+		bool marker)
+{
+	struct dstr temp_path = {0};
+	bool        success   = false;
+	FILE        *f;
+
+	dstr_printf(&temp_path, "%s.tmp", path);
+
+	f = os_fopen(temp_path.array, "wb");
+	if (!f)
+		goto exit;
+
+	success = true;
+	if (marker && fwrite("\xEF\xBB\xBF", 1, 3, f) != 3)
+		success = false;
+	if (len && fwrite(str, 1, len, f) != len)
+		success = false;
+	if (fclose(f) != 0)
+		success = false;
+
+	if (success)
+		success = os_rename(temp_path.array, path) == 0;
+	if (!success)
+		os_unlink(temp_path.array);
+
+exit:
+	dstr_free(&temp_path);
+	return success;
+}
+
 size_t os_mbs_to_wcs(const char *str, size_t len, wchar_t *dst, size_t dst_size)
 {
 	size_t out_len;
@@ -275,7 +312,7 @@ size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst,
 
 		if (out_len)
 			out_len = utf8_to_wchar(str, in_len,
-					dst, out_len + 1, 0);
+					dst, out_len, 0);
 
 		dst[out_len] = 0;
 	}
@@ -323,7 +360,7 @@ size_t os_wcs_to_utf8(const wchar_t *str, size_t len, char *dst,
 
 		if (out_len)
 			out_len = wchar_to_utf8(str, in_len,
-					dst, out_len + 1, 0);
+					dst, out_len, 0);
 
 		dst[out_len] = 0;
 	}
@@ -357,6 +394,26 @@ size_t os_utf8_to_wcs_ptr(const char *str, size_t len, wchar_t **pstr)
 	}
 }
 
+size_t os_utf8_to_wcs_ptr_buf(const char *str, size_t len, wchar_t *buf,
+		size_t buf_size, wchar_t **pstr)
+{
+	if (!str) {
+		*pstr = NULL;
+		return 0;
+	}
+
+	if (!len)
+		len = strlen(str);
+
+	/* UTF-8 never has fewer bytes than the text has wide characters */
+	if (len < buf_size) {
+		*pstr = buf;
+		return os_utf8_to_wcs(str, len, buf, buf_size);
+	}
+
+	return os_utf8_to_wcs_ptr(str, len, pstr);
+}
+
 size_t os_wcs_to_mbs_ptr(const wchar_t *str, size_t len, char **pstr)
 {
 	if (str) {
@@ -383,6 +440,32 @@ size_t os_wcs_to_utf8_ptr(const wchar_t *str, size_t len, char **pstr)
 	}
 }
 
+size_t os_wcs_to_utf8_ptr_buf(const wchar_t *str, size_t len, char *buf,
+		size_t buf_size, char **pstr)
+{
+	size_t out_len;
+
+	if (!str) {
+		*pstr = NULL;
+		return 0;
+	}
+
+	if (!len)
+		len = wcslen(str);
+
+	/* conversion fails if the buffer is too small, so only try the buffer
+	 * if the text could possibly fit */
+	if (len < buf_size) {
+		out_len = os_wcs_to_utf8(str, len, buf, buf_size);
+		if (out_len || !len) {
+			*pstr = buf;
+			return out_len;
+		}
+	}
+
+	return os_wcs_to_utf8_ptr(str, len, pstr);
+}
+
 size_t os_utf8_to_mbs_ptr(const char *str, size_t len, char **pstr)
 {
 	char    *dst    = NULL;
@@ -414,3 +497,18 @@ size_t os_mbs_to_utf8_ptr(const char *str, size_t len, char **pstr)
 	*pstr = dst;
 	return out_len;
 }
+
+static uint64_t role_affinity[OS_THREAD_ROLE_COUNT] = {0};
+
+void os_set_thread_role_affinity(enum os_thread_role role, uint64_t mask)
+{
+	if (role >= 0 && role < OS_THREAD_ROLE_COUNT)
+		role_affinity[role] = mask;
+}
+
+uint64_t os_get_thread_role_affinity(enum os_thread_role role)
+{
+	if (role >= 0 && role < OS_THREAD_ROLE_COUNT)
+		return role_affinity[role];
+	return 0;
+}
@@ -37,6 +37,16 @@ EXPORT int64_t os_fgetsize(FILE *file);
 EXPORT int os_fseeki64(FILE *file, int64_t offset, int origin);
 EXPORT int64_t os_ftelli64(FILE *file);
 
+/*
+ * Reserves disk space for a file up to the given size without changing the
+ * file's size, so a file that's written as it grows doesn't end up
+ * fragmented and writes don't have to wait on the file system allocating.
+ * A size of zero releases space reserved past the end of the file, which
+ * should be done before the file is closed.  Returns false if reserving
+ * isn't supported for the file.
+ */
+EXPORT bool os_fpreallocate(FILE *file, int64_t size);
+
 EXPORT size_t os_fread_mbs(FILE *file, char **pstr);
 EXPORT size_t os_fread_utf8(FILE *file, char **pstr);
 
@@ -48,6 +58,13 @@ EXPORT char *os_quick_read_mbs_file(const char *path);
 EXPORT bool os_quick_write_mbs_file(const char *path, const char *str,
 		size_t len);
 
+/**
+ * Writes the file to path + ".tmp" and then renames it over path, so the
+ * previous file is left untouched if writing fails part way through.
+ */
+EXPORT bool os_safe_write_utf8_file(const char *path, const char *str,
+		size_t len, bool marker);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst,
 		size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst,
@@ -62,6 +79,16 @@ EXPORT size_t os_utf8_to_wcs_ptr(const char *str, size_t len, wchar_t **pstr);
 EXPORT size_t os_wcs_to_mbs_ptr(const wchar_t *str, size_t len, char **pstr);
 EXPORT size_t os_wcs_to_utf8_ptr(const wchar_t *str, size_t len, char **pstr);
 
+/*
+ * Same as the _ptr functions, but converts in to the buffer provided by the
+ * caller if the result fits, and only allocates if it doesn't.  *pstr should
+ * be freed with bfree only if it's not the buffer.
+ */
+EXPORT size_t os_utf8_to_wcs_ptr_buf(const char *str, size_t len,
+		wchar_t *buf, size_t buf_size, wchar_t **pstr);
+EXPORT size_t os_wcs_to_utf8_ptr_buf(const wchar_t *str, size_t len,
+		char *buf, size_t buf_size, char **pstr);
+
 EXPORT size_t os_utf8_to_mbs_ptr(const char *str, size_t len, char **pstr);
 EXPORT size_t os_mbs_to_utf8_ptr(const char *str, size_t len, char **pstr);
 
@@ -88,12 +115,79 @@ EXPORT void                   os_end_high_performance(os_performance_token_t *);
 EXPORT bool os_sleepto_ns(uint64_t time_target);
 EXPORT void os_sleep_ms(uint32_t duration);
 
+/*
+ * Precise timer for threads that wake at a fixed rate.
+ *
+ *   Sleeps on a high-resolution absolute timer (a high-resolution waitable
+ * timer on Windows, clock_nanosleep with TIMER_ABSTIME elsewhere) until
+ * shortly before the target, then spins for the rest.  A timer should only
+ * be used by one thread at a time.
+ */
+struct os_timer;
+typedef struct os_timer os_timer_t;
+
+EXPORT os_timer_t *os_timer_create(void);
+EXPORT void os_timer_destroy(os_timer_t *timer);
+
+/** Same as os_sleepto_ns, but wakes within a few microseconds of the target */
+EXPORT bool os_timer_sleepto_ns(os_timer_t *timer, uint64_t time_target);
+
 EXPORT uint64_t os_gettime_ns(void);
 
+/** Returns the number of logical processor cores available */
+EXPORT int os_get_logical_cores(void);
+
+/*
+ * Thread roles
+ *
+ *   Raises the scheduling priority of time-critical pipeline threads so they
+ * aren't preempted by other processes saturating the CPU:
+ *
+ *   - Windows: MMCSS ("Pro Audio" for audio, "Capture" for video), regular
+ *     thread priorities for the other roles
+ *   - Linux: SCHED_RR for audio and video when permitted (RLIMIT_RTPRIO),
+ *     otherwise a negative nice value when permitted (RLIMIT_NICE)
+ *   - macOS: QoS classes
+ *
+ *   Each role can also have an affinity mask (bit n = logical CPU n), for
+ * example to keep the audio thread on an isolated core.  Affinity masks are
+ * not supported on macOS.
+ */
+
+enum os_thread_role {
+	OS_THREAD_ROLE_NORMAL,
+	OS_THREAD_ROLE_AUDIO,
+	OS_THREAD_ROLE_VIDEO,
+	OS_THREAD_ROLE_ENCODER,
+	OS_THREAD_ROLE_NETWORK,
+
+	OS_THREAD_ROLE_COUNT
+};
+
+/**
+ * Applies a role to the calling thread.  Returns false if the priority could
+ * not be raised (the thread keeps running at its current priority).
+ */
+EXPORT bool os_set_thread_role(enum os_thread_role role);
+
+/** Restricts the calling thread to the CPUs in mask, 0 allows all CPUs */
+EXPORT bool os_set_thread_affinity(uint64_t mask);
+
+/** Sets the affinity mask applied to threads that take the role afterwards */
+EXPORT void os_set_thread_role_affinity(enum os_thread_role role,
+		uint64_t mask);
+EXPORT uint64_t os_get_thread_role_affinity(enum os_thread_role role);
+
 EXPORT char *os_get_config_path(const char *name);
 
 EXPORT bool os_file_exists(const char *path);
 
+/**
+ * Returns a value that changes whenever the file is modified, or -1 if the
+ * file can't be accessed.  Only useful for comparing against earlier values.
+ */
+EXPORT int64_t os_get_file_mod_time(const char *path);
+
 struct os_dir;
 typedef struct os_dir os_dir_t;
 
@@ -125,12 +219,32 @@ EXPORT void os_globfree(os_glob_t *pglob);
 
 EXPORT int os_unlink(const char *path);
 
+/** Renames a file, replacing new_path if it exists */
+EXPORT int os_rename(const char *old_path, const char *new_path);
+
 #define MKDIR_EXISTS   1
 #define MKDIR_SUCCESS  0
 #define MKDIR_ERROR   -1
 
 EXPORT int os_mkdir(const char *path);
 
+/*
+ * Named shared memory
+ *
+ *   Creates (or opens, if it already exists) a block of shared memory other
+ * processes can map by name.  On POSIX systems the block is a shm_open object
+ * named "/<name>" and is unlinked when destroyed; on Windows it is a paging
+ * file backed mapping named <name>.
+ */
+
+struct os_shmem;
+typedef struct os_shmem os_shmem_t;
+
+EXPORT os_shmem_t *os_shmem_create(const char *name, size_t size);
+EXPORT void os_shmem_destroy(os_shmem_t *shmem);
+EXPORT void *os_shmem_get_data(os_shmem_t *shmem);
+EXPORT size_t os_shmem_get_size(const os_shmem_t *shmem);
+
 #ifdef _MSC_VER
 #define strtoll _strtoi64
 #endif
@@ -0,0 +1,617 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "bmem.h"
+#include "base.h"
+#include "darray.h"
+#include "dstr.h"
+#include "platform.h"
+#include "threading.h"
+#include "profiler.h"
+
+/*
+ * Times are kept in a log-linear histogram of microseconds: each power of
+ * two is split into SUB_BUCKETS buckets, which keeps percentiles within
+ * about 6% of the actual value without having to store every sample.
+ */
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS     (1 << SUB_BUCKET_BITS)
+#define NUM_BUCKETS     (40 * SUB_BUCKETS)
+
+/* calls kept per thread while tracing, must be a power of two */
+#define TRACE_EVENTS    16384
+
+struct profile_entry {
+	char                           *name;
+
+	uint64_t                       calls;
+	uint64_t                       total_ns;
+	uint64_t                       min_ns;
+	uint64_t                       max_ns;
+	uint32_t                       buckets[NUM_BUCKETS];
+
+	DARRAY(struct profile_entry*)  children;
+};
+
+struct profile_call {
+	struct profile_entry           *entry;
+	uint64_t                       start_ns;
+};
+
+struct profile_event {
+	const char                     *name;
+	uint64_t                       start_ns;
+	uint64_t                       end_ns;
+};
+
+struct profile_lock {
+	struct profile_entry           *entry;
+	uint64_t                       lock_ns;
+};
+
+struct profile_thread {
+	/* only contended while printing */
+	pthread_mutex_t                mutex;
+	struct profile_entry           root;
+	DARRAY(struct profile_call)    stack;
+	bool                           warned_mismatch;
+
+	/* each lock has a "wait" and a "hold" child */
+	struct profile_entry           locks;
+	DARRAY(struct profile_lock)    held_locks;
+
+	/* ring of the last TRACE_EVENTS calls, allocated once tracing is
+	 * enabled */
+	struct profile_event           *events;
+	uint64_t                       num_events;
+};
+
+static pthread_mutex_t                 profiler_mutex;
+static pthread_key_t                   profiler_key;
+static bool                            profiler_initialized = false;
+static volatile bool                   profiler_enabled     = false;
+static volatile bool                   profiler_tracing     = false;
+static DARRAY(struct profile_thread*)  profiler_threads;
+
+/* ------------------------------------------------------------------------- */
+
+static inline size_t get_bucket(uint64_t usec)
+{
+	size_t bits = 0;
+	size_t idx;
+
+	if (usec < SUB_BUCKETS)
+		return (size_t)usec;
+
+	for (uint64_t val = usec; val >>= 1;)
+		bits++;
+
+	idx = (bits - SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+		(size_t)((usec >> (bits - SUB_BUCKET_BITS)) &
+				(SUB_BUCKETS - 1));
+	return idx < NUM_BUCKETS ? idx : NUM_BUCKETS - 1;
+}
+
+/* returns the lowest time (in microseconds) that falls into a bucket */
+static inline uint64_t get_bucket_usec(size_t idx)
+{
+	if (idx < SUB_BUCKETS)
+		return idx;
+
+	return (uint64_t)(SUB_BUCKETS + idx % SUB_BUCKETS) <<
+		(idx / SUB_BUCKETS - 1);
+}
+
+static void free_entry(struct profile_entry *entry)
+{
+	for (size_t i = 0; i < entry->children.num; i++) {
+		free_entry(entry->children.array[i]);
+		bfree(entry->children.array[i]);
+	}
+
+	da_free(entry->children);
+	bfree(entry->name);
+}
+
+static struct profile_entry *get_child(struct profile_entry *parent,
+		const char *name)
+{
+	struct profile_entry *entry;
+
+	for (size_t i = 0; i < parent->children.num; i++) {
+		entry = parent->children.array[i];
+		if (strcmp(entry->name, name) == 0)
+			return entry;
+	}
+
+	entry = bzalloc(sizeof(struct profile_entry));
+	entry->name   = bstrdup(name);
+	entry->min_ns = UINT64_MAX;
+	da_push_back(parent->children, &entry);
+	return entry;
+}
+
+static struct profile_thread *get_thread(void)
+{
+	struct profile_thread *thread = pthread_getspecific(profiler_key);
+	if (thread)
+		return thread;
+
+	thread = bzalloc(sizeof(struct profile_thread));
+	pthread_mutex_init_value(&thread->mutex);
+	pthread_mutex_init(&thread->mutex, NULL);
+	pthread_setspecific(profiler_key, thread);
+
+	pthread_mutex_lock(&profiler_mutex);
+	da_push_back(profiler_threads, &thread);
+	pthread_mutex_unlock(&profiler_mutex);
+
+	return thread;
+}
+
+static inline void add_time(struct profile_entry *entry, uint64_t time_ns)
+{
+	entry->calls++;
+	entry->total_ns += time_ns;
+	if (time_ns < entry->min_ns)
+		entry->min_ns = time_ns;
+	if (time_ns > entry->max_ns)
+		entry->max_ns = time_ns;
+	entry->buckets[get_bucket(time_ns / 1000)]++;
+}
+
+static inline void add_event(struct profile_thread *thread, const char *name,
+		uint64_t start_ns, uint64_t end_ns)
+{
+	struct profile_event *event;
+
+	if (!thread->events)
+		thread->events = bmalloc(sizeof(struct profile_event) *
+				TRACE_EVENTS);
+
+	event = thread->events + (thread->num_events++ & (TRACE_EVENTS - 1));
+	event->name     = name;
+	event->start_ns = start_ns;
+	event->end_ns   = end_ns;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void profile_start(const char *name)
+{
+	struct profile_thread *thread;
+	struct profile_entry  *parent;
+	struct profile_call   *call;
+
+	if (!profiler_enabled || !name)
+		return;
+
+	thread = get_thread();
+
+	pthread_mutex_lock(&thread->mutex);
+
+	parent = thread->stack.num ?
+		thread->stack.array[thread->stack.num - 1].entry :
+		&thread->root;
+
+	call = da_push_back_new(thread->stack);
+	call->entry = get_child(parent, name);
+
+	pthread_mutex_unlock(&thread->mutex);
+
+	call->start_ns = os_gettime_ns();
+}
+
+void profile_end(const char *name)
+{
+	uint64_t              end_ns = os_gettime_ns();
+	struct profile_thread *thread;
+	struct profile_entry  *entry;
+	uint64_t              start_ns;
+	uint64_t              time_ns;
+
+	if (!profiler_initialized || !name)
+		return;
+
+	thread = pthread_getspecific(profiler_key);
+	if (!thread || !thread->stack.num)
+		return;
+
+	pthread_mutex_lock(&thread->mutex);
+
+	entry    = thread->stack.array[thread->stack.num - 1].entry;
+	start_ns = thread->stack.array[thread->stack.num - 1].start_ns;
+	time_ns  = end_ns - start_ns;
+	da_pop_back(thread->stack);
+
+	if (strcmp(entry->name, name) != 0 && !thread->warned_mismatch) {
+		blog(LOG_WARNING, "profile_end: expected '%s', got '%s'",
+				entry->name, name);
+		thread->warned_mismatch = true;
+	}
+
+	add_time(entry, time_ns);
+
+	if (profiler_tracing)
+		add_event(thread, entry->name, start_ns, end_ns);
+
+	pthread_mutex_unlock(&thread->mutex);
+}
+
+void profile_lock_acquired(const char *name, uint64_t wait_start_ns)
+{
+	uint64_t              lock_ns = os_gettime_ns();
+	struct profile_thread *thread;
+	struct profile_entry  *entry;
+	struct profile_lock   *lock;
+
+	if (!profiler_enabled || !name)
+		return;
+
+	thread = get_thread();
+
+	pthread_mutex_lock(&thread->mutex);
+
+	entry = get_child(&thread->locks, name);
+	add_time(get_child(entry, "wait"), lock_ns - wait_start_ns);
+
+	lock = da_push_back_new(thread->held_locks);
+	lock->entry   = entry;
+	lock->lock_ns = lock_ns;
+
+	pthread_mutex_unlock(&thread->mutex);
+}
+
+void profile_lock_released(const char *name)
+{
+	uint64_t              unlock_ns = os_gettime_ns();
+	struct profile_thread *thread;
+
+	if (!profiler_initialized || !name)
+		return;
+
+	thread = pthread_getspecific(profiler_key);
+	if (!thread || !thread->held_locks.num)
+		return;
+
+	pthread_mutex_lock(&thread->mutex);
+
+	/* locks aren't always released in the reverse order */
+	for (size_t i = thread->held_locks.num; i > 0; i--) {
+		struct profile_lock *lock = thread->held_locks.array + i - 1;
+
+		if (strcmp(lock->entry->name, name) != 0)
+			continue;
+
+		add_time(get_child(lock->entry, "hold"),
+				unlock_ns - lock->lock_ns);
+		if (profiler_tracing)
+			add_event(thread, lock->entry->name, lock->lock_ns,
+					unlock_ns);
+
+		da_erase(thread->held_locks, i - 1);
+		break;
+	}
+
+	pthread_mutex_unlock(&thread->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint64_t get_percentile_ns(const struct profile_entry *entry,
+		double percentile)
+{
+	uint64_t target = (uint64_t)(entry->calls * percentile + 0.5);
+	uint64_t count  = 0;
+	uint64_t usec   = 0;
+
+	if (!target)
+		target = 1;
+
+	for (size_t i = 0; i < NUM_BUCKETS; i++) {
+		count += entry->buckets[i];
+		if (count >= target) {
+			usec = (get_bucket_usec(i) +
+				get_bucket_usec(i + 1)) / 2;
+			break;
+		}
+	}
+
+	/* the buckets are coarser than the exact min/max */
+	if (usec * 1000 < entry->min_ns)
+		return entry->min_ns;
+	if (usec * 1000 > entry->max_ns)
+		return entry->max_ns;
+	return usec * 1000;
+}
+
+static inline double get_percentile_ms(const struct profile_entry *entry,
+		double percentile)
+{
+	return (double)get_percentile_ns(entry, percentile) / 1000000.0;
+}
+
+static void print_entry(const struct profile_entry *entry, struct dstr *indent)
+{
+	if (entry->calls) {
+		blog(LOG_INFO, "%s%s: min=%.3f ms, avg=%.3f ms, max=%.3f ms, "
+				"median=%.3f ms, 90th=%.3f ms, 99th=%.3f ms, "
+				"calls=%llu",
+				indent->array, entry->name,
+				(double)entry->min_ns / 1000000.0,
+				(double)entry->total_ns /
+				(double)entry->calls / 1000000.0,
+				(double)entry->max_ns / 1000000.0,
+				get_percentile_ms(entry, 0.5),
+				get_percentile_ms(entry, 0.9),
+				get_percentile_ms(entry, 0.99),
+				(unsigned long long)entry->calls);
+	} else if (entry->children.num) {
+		/* only groups its children, such as a lock's wait/hold */
+		blog(LOG_INFO, "%s%s:", indent->array, entry->name);
+	} else {
+		blog(LOG_INFO, "%s%s: (no calls completed)", indent->array,
+				entry->name);
+	}
+
+	dstr_cat(indent, " | ");
+	for (size_t i = 0; i < entry->children.num; i++)
+		print_entry(entry->children.array[i], indent);
+	dstr_resize(indent, indent->len - 3);
+}
+
+void profiler_print(void)
+{
+	struct dstr indent = {0};
+
+	if (!profiler_initialized)
+		return;
+
+	dstr_copy(&indent, " | ");
+
+	blog(LOG_INFO, "== Profiler Results =============================");
+
+	pthread_mutex_lock(&profiler_mutex);
+
+	for (size_t i = 0; i < profiler_threads.num; i++) {
+		struct profile_thread *thread = profiler_threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+
+		blog(LOG_INFO, "Thread %d:", (int)i);
+		for (size_t j = 0; j < thread->root.children.num; j++)
+			print_entry(thread->root.children.array[j], &indent);
+
+		if (thread->locks.children.num) {
+			blog(LOG_INFO, "Thread %d locks:", (int)i);
+			for (size_t j = 0; j < thread->locks.children.num; j++)
+				print_entry(thread->locks.children.array[j],
+						&indent);
+		}
+
+		pthread_mutex_unlock(&thread->mutex);
+	}
+
+	pthread_mutex_unlock(&profiler_mutex);
+
+	blog(LOG_INFO, "=================================================");
+
+	bmem_log_usage();
+
+	dstr_free(&indent);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void merge_sections(struct profile_entry *merged,
+		const struct profile_entry *entry, const char *name)
+{
+	if (entry->name && strcmp(entry->name, name) == 0 && entry->calls) {
+		merged->calls    += entry->calls;
+		merged->total_ns += entry->total_ns;
+		if (entry->min_ns < merged->min_ns)
+			merged->min_ns = entry->min_ns;
+		if (entry->max_ns > merged->max_ns)
+			merged->max_ns = entry->max_ns;
+
+		for (size_t i = 0; i < NUM_BUCKETS; i++)
+			merged->buckets[i] += entry->buckets[i];
+	}
+
+	for (size_t i = 0; i < entry->children.num; i++)
+		merge_sections(merged, entry->children.array[i], name);
+}
+
+bool profiler_get_section_stats(const char *name,
+		struct profiler_section_stats *stats)
+{
+	struct profile_entry *merged;
+	bool found;
+
+	if (!profiler_initialized || !name || !stats)
+		return false;
+
+	/* too large for the stack with all of its buckets */
+	merged = bzalloc(sizeof(struct profile_entry));
+	merged->min_ns = UINT64_MAX;
+
+	pthread_mutex_lock(&profiler_mutex);
+
+	for (size_t i = 0; i < profiler_threads.num; i++) {
+		struct profile_thread *thread = profiler_threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+		merge_sections(merged, &thread->root, name);
+		pthread_mutex_unlock(&thread->mutex);
+	}
+
+	pthread_mutex_unlock(&profiler_mutex);
+
+	found = merged->calls != 0;
+	if (found) {
+		stats->calls     = merged->calls;
+		stats->min_ns    = merged->min_ns;
+		stats->avg_ns    = merged->total_ns / merged->calls;
+		stats->max_ns    = merged->max_ns;
+		stats->median_ns = get_percentile_ns(merged, 0.5);
+		stats->p90_ns    = get_percentile_ns(merged, 0.9);
+		stats->p99_ns    = get_percentile_ns(merged, 0.99);
+	}
+
+	bfree(merged);
+	return found;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void profiler_enable_trace(bool enable)
+{
+	profiler_tracing = enable;
+}
+
+static void write_thread_events(struct dstr *json,
+		const struct profile_thread *thread, int tid,
+		uint64_t window_start_ns)
+{
+	uint64_t num = thread->num_events;
+	uint64_t first;
+
+	/* name the thread after its outermost section, such as
+	 * obs_video_thread */
+	if (thread->root.children.num)
+		dstr_catf(json, "{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":1,\"tid\":%d,"
+				"\"args\":{\"name\":\"%s\"}},\n", tid,
+				thread->root.children.array[0]->name);
+
+	if (!thread->events)
+		return;
+
+	first = num > TRACE_EVENTS ? num - TRACE_EVENTS : 0;
+
+	for (uint64_t i = first; i < num; i++) {
+		const struct profile_event *event =
+			thread->events + (i & (TRACE_EVENTS - 1));
+
+		if (event->start_ns < window_start_ns)
+			continue;
+
+		dstr_catf(json, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+				"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n",
+				event->name, tid,
+				(double)(event->start_ns - window_start_ns) /
+				1000.0,
+				(double)(event->end_ns - event->start_ns) /
+				1000.0);
+	}
+}
+
+bool profiler_save_trace(const char *path, uint64_t window_ns)
+{
+	uint64_t    now_ns = os_gettime_ns();
+	uint64_t    window_start_ns;
+	struct dstr json = {0};
+	bool        success;
+
+	if (!profiler_initialized || !path)
+		return false;
+
+	window_start_ns = window_ns < now_ns ? now_ns - window_ns : 0;
+
+	dstr_copy(&json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	pthread_mutex_lock(&profiler_mutex);
+
+	for (size_t i = 0; i < profiler_threads.num; i++) {
+		struct profile_thread *thread = profiler_threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+		write_thread_events(&json, thread, (int)i, window_start_ns);
+		pthread_mutex_unlock(&thread->mutex);
+	}
+
+	pthread_mutex_unlock(&profiler_mutex);
+
+	/* JSON doesn't allow a trailing comma */
+	if (dstr_end(&json) == '\n' && json.len >= 2 &&
+	    json.array[json.len - 2] == ',')
+		dstr_resize(&json, json.len - 2);
+
+	dstr_cat(&json, "\n]}\n");
+
+	success = os_quick_write_utf8_file(path, json.array, json.len, false);
+	if (success)
+		blog(LOG_INFO, "Saved profiler trace to '%s'", path);
+	else
+		blog(LOG_WARNING, "Failed to save profiler trace to '%s'",
+				path);
+
+	dstr_free(&json);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void profiler_start(void)
+{
+	if (!profiler_initialized) {
+		pthread_mutex_init_value(&profiler_mutex);
+		if (pthread_mutex_init(&profiler_mutex, NULL) != 0)
+			return;
+		if (pthread_key_create(&profiler_key, NULL) != 0) {
+			pthread_mutex_destroy(&profiler_mutex);
+			return;
+		}
+
+		profiler_initialized = true;
+	}
+
+	profiler_enabled = true;
+}
+
+void profiler_stop(void)
+{
+	profiler_enabled = false;
+}
+
+void profiler_free(void)
+{
+	if (!profiler_initialized)
+		return;
+
+	profiler_enabled = false;
+	profiler_tracing = false;
+
+	for (size_t i = 0; i < profiler_threads.num; i++) {
+		struct profile_thread *thread = profiler_threads.array[i];
+
+		free_entry(&thread->root);
+		free_entry(&thread->locks);
+		da_free(thread->held_locks);
+		bfree(thread->events);
+		da_free(thread->stack);
+		pthread_mutex_destroy(&thread->mutex);
+		bfree(thread);
+	}
+
+	da_free(profiler_threads);
+
+	pthread_setspecific(profiler_key, NULL);
+	pthread_key_delete(profiler_key);
+	pthread_mutex_destroy(&profiler_mutex);
+	profiler_initialized = false;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Scoped profiler
+ *
+ *   Sections are marked with profile_start/profile_end pairs, which may be
+ * nested.  Each thread builds its own tree of sections (keyed by name under
+ * its parent section), so recording a section never contends with other
+ * threads.  For each section the number of calls, min/avg/max time and a
+ * histogram of times (for percentiles) are kept.
+ *
+ *   The names passed to profile_start/profile_end must match.  Using string
+ * literals is recommended, the name is only compared when opening a section.
+ *
+ *   While tracing is enabled, the start and end time of each call is kept as
+ * well (the most recent TRACE_EVENTS per thread), so the calls of all threads
+ * can be lined up against each other with profiler_save_trace.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Starts recording sections.  Sections are ignored until this is called */
+EXPORT void profiler_start(void);
+
+/** Stops recording new sections (sections already open still get closed) */
+EXPORT void profiler_stop(void);
+
+/** Logs the tree of recorded sections of every thread */
+EXPORT void profiler_print(void);
+
+/** Frees all recorded data.  No thread may be inside a section */
+EXPORT void profiler_free(void);
+
+struct profiler_section_stats {
+	uint64_t calls;
+	uint64_t min_ns;
+	uint64_t avg_ns;
+	uint64_t max_ns;
+	uint64_t median_ns;
+	uint64_t p90_ns;
+	uint64_t p99_ns;
+};
+
+/**
+ * Gets the combined times of every section with the given name, from all
+ * threads and at any depth.  Returns false if no call of it has completed.
+ */
+EXPORT bool profiler_get_section_stats(const char *name,
+		struct profiler_section_stats *stats);
+
+/** Starts or stops keeping the start and end times of every call */
+EXPORT void profiler_enable_trace(bool enable);
+
+/**
+ * Saves the calls that started within the last window_ns nanoseconds as
+ * Chrome trace event JSON, which can be opened in chrome://tracing or
+ * Perfetto.  Returns false if the file couldn't be written.
+ */
+EXPORT bool profiler_save_trace(const char *path, uint64_t window_ns);
+
+EXPORT void profile_start(const char *name);
+EXPORT void profile_end(const char *name);
+
+/**
+ * Records the time spent waiting for and then holding a named lock, used by
+ * os_mutex_lock/os_mutex_unlock (threading.h) when built with
+ * OBS_PROFILE_LOCKS.  Locks are listed per thread after the sections.
+ */
+EXPORT void profile_lock_acquired(const char *name, uint64_t wait_start_ns);
+EXPORT void profile_lock_released(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <string.h>
+#include "bmem.h"
+#include "threading.h"
+#include "ring-queue.h"
+
+#define CACHE_LINE_SIZE 64
+#define SLOT_HEADER     16
+
+/* positions are free-running counters that are allowed to wrap */
+#define pos_add(pos, val) ((long)((unsigned long)(pos) + (unsigned long)(val)))
+#define pos_diff(a, b)    ((long)((unsigned long)(a) - (unsigned long)(b)))
+
+static size_t round_capacity(size_t capacity)
+{
+	size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+	return size;
+}
+
+/* ------------------------------------------------------------------------- */
+/* single producer, single consumer                                          */
+
+struct spsc_queue {
+	uint8_t       *data;
+	size_t        element_size;
+	long          mask;
+
+	/* producer */
+	uint8_t       pad0[CACHE_LINE_SIZE];
+	volatile long head;
+	long          cached_tail;
+
+	/* consumer */
+	uint8_t       pad1[CACHE_LINE_SIZE];
+	volatile long tail;
+	long          cached_head;
+	uint8_t       pad2[CACHE_LINE_SIZE];
+};
+
+spsc_queue_t *spsc_queue_create(size_t element_size, size_t capacity)
+{
+	struct spsc_queue *queue;
+
+	if (!element_size || !capacity)
+		return NULL;
+
+	capacity = round_capacity(capacity);
+
+	queue = bzalloc(sizeof(struct spsc_queue));
+	queue->data         = bmalloc(element_size * capacity);
+	queue->element_size = element_size;
+	queue->mask         = (long)capacity - 1;
+	return queue;
+}
+
+void spsc_queue_destroy(spsc_queue_t *queue)
+{
+	if (queue) {
+		bfree(queue->data);
+		bfree(queue);
+	}
+}
+
+bool spsc_queue_push(spsc_queue_t *queue, const void *data)
+{
+	long head = queue->head;
+
+	if (pos_diff(head, queue->cached_tail) > queue->mask) {
+		queue->cached_tail = os_atomic_load_long_acquire(&queue->tail);
+		if (pos_diff(head, queue->cached_tail) > queue->mask)
+			return false;
+	}
+
+	memcpy(queue->data + (size_t)(head & queue->mask) *
+			queue->element_size, data, queue->element_size);
+	os_atomic_set_long_release(&queue->head, pos_add(head, 1));
+	return true;
+}
+
+bool spsc_queue_pop(spsc_queue_t *queue, void *data)
+{
+	long tail = queue->tail;
+
+	if (tail == queue->cached_head) {
+		queue->cached_head = os_atomic_load_long_acquire(&queue->head);
+		if (tail == queue->cached_head)
+			return false;
+	}
+
+	memcpy(data, queue->data + (size_t)(tail & queue->mask) *
+			queue->element_size, queue->element_size);
+	os_atomic_set_long_release(&queue->tail, pos_add(tail, 1));
+	return true;
+}
+
+size_t spsc_queue_size(const spsc_queue_t *queue)
+{
+	long head = os_atomic_load_long_acquire(&queue->head);
+	long tail = os_atomic_load_long_acquire(&queue->tail);
+	return (size_t)pos_diff(head, tail);
+}
+
+/* ------------------------------------------------------------------------- */
+/* multiple producers, multiple consumers                                    */
+
+struct mpmc_queue {
+	uint8_t       *slots;
+	size_t        slot_size;
+	size_t        element_size;
+	long          mask;
+
+	uint8_t       pad0[CACHE_LINE_SIZE];
+	volatile long head;
+	uint8_t       pad1[CACHE_LINE_SIZE];
+	volatile long tail;
+	uint8_t       pad2[CACHE_LINE_SIZE];
+};
+
+static inline volatile long *slot_seq(struct mpmc_queue *queue, long pos)
+{
+	return (volatile long*)(queue->slots +
+			(size_t)(pos & queue->mask) * queue->slot_size);
+}
+
+static inline uint8_t *slot_data(volatile long *seq)
+{
+	return (uint8_t*)seq + SLOT_HEADER;
+}
+
+mpmc_queue_t *mpmc_queue_create(size_t element_size, size_t capacity)
+{
+	struct mpmc_queue *queue;
+
+	if (!element_size || !capacity)
+		return NULL;
+
+	capacity = round_capacity(capacity);
+
+	queue = bzalloc(sizeof(struct mpmc_queue));
+	queue->element_size = element_size;
+	queue->slot_size    = (SLOT_HEADER + element_size + SLOT_HEADER - 1) &
+		~(size_t)(SLOT_HEADER - 1);
+	queue->slots        = bmalloc(queue->slot_size * capacity);
+	queue->mask         = (long)capacity - 1;
+
+	for (long i = 0; i <= queue->mask; i++)
+		*slot_seq(queue, i) = i;
+
+	return queue;
+}
+
+void mpmc_queue_destroy(mpmc_queue_t *queue)
+{
+	if (queue) {
+		bfree(queue->slots);
+		bfree(queue);
+	}
+}
+
+bool mpmc_queue_push(mpmc_queue_t *queue, const void *data)
+{
+	long pos = os_atomic_load_long_acquire(&queue->head);
+	volatile long *seq;
+
+	for (;;) {
+		long diff;
+
+		seq  = slot_seq(queue, pos);
+		diff = pos_diff(os_atomic_load_long_acquire(seq), pos);
+
+		if (diff == 0) {
+			if (os_atomic_compare_swap_long(&queue->head, pos,
+						pos_add(pos, 1)))
+				break;
+		} else if (diff < 0) {
+			return false;
+		}
+
+		pos = os_atomic_load_long_acquire(&queue->head);
+	}
+
+	memcpy(slot_data(seq), data, queue->element_size);
+	os_atomic_set_long_release(seq, pos_add(pos, 1));
+	return true;
+}
+
+bool mpmc_queue_pop(mpmc_queue_t *queue, void *data)
+{
+	long pos = os_atomic_load_long_acquire(&queue->tail);
+	volatile long *seq;
+
+	for (;;) {
+		long diff;
+
+		seq  = slot_seq(queue, pos);
+		diff = pos_diff(os_atomic_load_long_acquire(seq),
+				pos_add(pos, 1));
+
+		if (diff == 0) {
+			if (os_atomic_compare_swap_long(&queue->tail, pos,
+						pos_add(pos, 1)))
+				break;
+		} else if (diff < 0) {
+			return false;
+		}
+
+		pos = os_atomic_load_long_acquire(&queue->tail);
+	}
+
+	memcpy(data, slot_data(seq), queue->element_size);
+	os_atomic_set_long_release(seq, pos_add(pos, queue->mask + 1));
+	return true;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Bounded lock-free queues of fixed-size elements.
+ *
+ *   spsc_queue: one producer thread and one consumer thread.  Each side only
+ * writes its own position, so pushing and popping never contend.
+ *
+ *   mpmc_queue: any number of producer and consumer threads.  Each slot
+ * carries a sequence number, and a thread claims a slot by advancing the
+ * shared position with a compare-and-swap.
+ *
+ *   Capacity is rounded up to a power of two.  Neither queue ever blocks or
+ * grows: push returns false when the queue is full and pop returns false
+ * when it is empty, so callers decide whether to wait (e.g. on an os_sem_t),
+ * drop, or fall back to another path.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct spsc_queue;
+struct mpmc_queue;
+typedef struct spsc_queue spsc_queue_t;
+typedef struct mpmc_queue mpmc_queue_t;
+
+EXPORT spsc_queue_t *spsc_queue_create(size_t element_size, size_t capacity);
+EXPORT void spsc_queue_destroy(spsc_queue_t *queue);
+EXPORT bool spsc_queue_push(spsc_queue_t *queue, const void *data);
+EXPORT bool spsc_queue_pop(spsc_queue_t *queue, void *data);
+EXPORT size_t spsc_queue_size(const spsc_queue_t *queue);
+
+EXPORT mpmc_queue_t *mpmc_queue_create(size_t element_size, size_t capacity);
+EXPORT void mpmc_queue_destroy(mpmc_queue_t *queue);
+EXPORT bool mpmc_queue_push(mpmc_queue_t *queue, const void *data);
+EXPORT bool mpmc_queue_pop(mpmc_queue_t *queue, void *data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bmem.h"
+#include "platform.h"
+#include "threading.h"
+#include "ring-queue.h"
+#include "task-pool.h"
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define MAX_POOL_THREADS 16
+#define WORKER_QUEUE_SIZE 256
+
+struct pool_task {
+	task_pool_task_t task;
+	void             *param;
+};
+
+struct task_worker {
+	struct task_pool *pool;
+	size_t           idx;
+	mpmc_queue_t     *queue;
+	pthread_t        thread;
+};
+
+struct task_pool {
+	struct task_worker *workers;
+	size_t          num_threads;
+
+	os_sem_t        *wake_sem;
+	volatile long   stop;
+
+	/* batches (task_pool_run) */
+	pthread_mutex_t run_mutex;
+	os_event_t      *done_event;
+	task_pool_job_t job;
+	void            *param;
+	long            count;
+	volatile long   next;
+	volatile long   active;
+	volatile long   batch_slots;
+
+	/* submitted tasks */
+	os_event_t      *idle_event;
+	volatile long   pending;
+	volatile long   next_queue;
+};
+
+static THREAD_LOCAL struct task_worker *cur_worker = NULL;
+
+static inline void run_jobs(struct task_pool *pool)
+{
+	for (;;) {
+		long idx = os_atomic_inc_long(&pool->next) - 1;
+		if (idx >= pool->count)
+			break;
+
+		pool->job(pool->param, (size_t)idx);
+	}
+}
+
+/* every post of wake_sem is either for a batch slot or for a queued task, and
+ * a woken worker takes whichever of the two is available */
+static bool claim_batch_slot(struct task_pool *pool)
+{
+	long slots;
+
+	do {
+		slots = os_atomic_load_long(&pool->batch_slots);
+		if (slots <= 0)
+			return false;
+	} while (!os_atomic_compare_swap_long(&pool->batch_slots, slots,
+				slots - 1));
+
+	return true;
+}
+
+static inline void task_done(struct task_pool *pool)
+{
+	if (os_atomic_dec_long(&pool->pending) == 0)
+		os_event_signal(pool->idle_event);
+}
+
+/* pops from the queue of the given worker first, then steals from the rest */
+static bool run_one_task(struct task_pool *pool, size_t first)
+{
+	struct pool_task task;
+
+	for (size_t i = 0; i < pool->num_threads; i++) {
+		size_t idx = (first + i) % pool->num_threads;
+
+		if (mpmc_queue_pop(pool->workers[idx].queue, &task)) {
+			task.task(task.param);
+			task_done(pool);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void *task_pool_thread(void *param)
+{
+	struct task_worker *worker = param;
+	struct task_pool   *pool   = worker->pool;
+
+	cur_worker = worker;
+
+	while (os_sem_wait(pool->wake_sem) == 0) {
+		if (os_atomic_load_long(&pool->stop))
+			break;
+
+		if (claim_batch_slot(pool)) {
+			run_jobs(pool);
+
+			if (os_atomic_dec_long(&pool->active) == 0)
+				os_event_signal(pool->done_event);
+		} else {
+			run_one_task(pool, worker->idx);
+		}
+	}
+
+	return NULL;
+}
+
+task_pool_t *task_pool_create(size_t num_threads)
+{
+	struct task_pool *pool = bzalloc(sizeof(struct task_pool));
+
+	if (!num_threads) {
+		int cores = os_get_logical_cores();
+		num_threads = cores > 1 ? (size_t)(cores - 1) : 0;
+	}
+	if (num_threads > MAX_POOL_THREADS)
+		num_threads = MAX_POOL_THREADS;
+
+	pthread_mutex_init_value(&pool->run_mutex);
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&pool->wake_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&pool->done_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (os_event_init(&pool->idle_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	pool->workers = bzalloc(sizeof(struct task_worker) * (num_threads + 1));
+
+	for (size_t i = 0; i < num_threads; i++) {
+		struct task_worker *worker = &pool->workers[i];
+
+		worker->pool  = pool;
+		worker->idx   = i;
+		worker->queue = mpmc_queue_create(sizeof(struct pool_task),
+				WORKER_QUEUE_SIZE);
+
+		if (pthread_create(&worker->thread, NULL, task_pool_thread,
+					worker) != 0) {
+			mpmc_queue_destroy(worker->queue);
+			break;
+		}
+		pool->num_threads++;
+	}
+
+	return pool;
+
+fail:
+	task_pool_destroy(pool);
+	return NULL;
+}
+
+void task_pool_destroy(task_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	if (pool->workers)
+		task_pool_wait(pool);
+
+	os_atomic_set_long(&pool->stop, 1);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		os_sem_post(pool->wake_sem);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		mpmc_queue_destroy(pool->workers[i].queue);
+
+	os_event_destroy(pool->idle_event);
+	os_event_destroy(pool->done_event);
+	os_sem_destroy(pool->wake_sem);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->workers);
+	bfree(pool);
+}
+
+size_t task_pool_get_num_threads(const task_pool_t *pool)
+{
+	return pool ? pool->num_threads : 0;
+}
+
+void task_pool_run(task_pool_t *pool, size_t count,
+		task_pool_job_t job, void *param)
+{
+	size_t workers;
+
+	if (!count || !job)
+		return;
+
+	if (!pool || !pool->num_threads || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			job(param, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_mutex);
+
+	workers = pool->num_threads < count - 1 ?
+		pool->num_threads : count - 1;
+
+	pool->job    = job;
+	pool->param  = param;
+	pool->count  = (long)count;
+	pool->next   = 0;
+	pool->active = (long)workers;
+	os_atomic_set_long(&pool->batch_slots, (long)workers);
+
+	for (size_t i = 0; i < workers; i++)
+		os_sem_post(pool->wake_sem);
+
+	run_jobs(pool);
+	os_event_wait(pool->done_event);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
+
+void task_pool_submit(task_pool_t *pool, task_pool_task_t task, void *param)
+{
+	struct pool_task pool_task = {task, param};
+	size_t           first;
+
+	if (!task)
+		return;
+
+	if (!pool || !pool->num_threads) {
+		task(param);
+		return;
+	}
+
+	if (cur_worker && cur_worker->pool == pool)
+		first = cur_worker->idx;
+	else
+		first = (unsigned long)os_atomic_inc_long(&pool->next_queue) %
+			pool->num_threads;
+
+	os_atomic_inc_long(&pool->pending);
+
+	for (size_t i = 0; i < pool->num_threads; i++) {
+		size_t idx = (first + i) % pool->num_threads;
+
+		if (mpmc_queue_push(pool->workers[idx].queue, &pool_task)) {
+			os_sem_post(pool->wake_sem);
+			return;
+		}
+	}
+
+	task(param);
+	task_done(pool);
+}
+
+void task_pool_wait(task_pool_t *pool)
+{
+	size_t first;
+
+	if (!pool || !pool->num_threads)
+		return;
+
+	first = (cur_worker && cur_worker->pool == pool) ? cur_worker->idx : 0;
+
+	while (os_atomic_load_long(&pool->pending) > 0) {
+		if (!run_one_task(pool, first))
+			os_event_timedwait(pool->idle_event, 1);
+	}
+}
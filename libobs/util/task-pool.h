@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Fixed-size pool of worker threads for running a batch of independent jobs
+ * in parallel.
+ *
+ *   Jobs are claimed one at a time from a shared atomic counter, so threads
+ * that finish early keep pulling work from the rest of the batch instead of
+ * idling on a static partition.  The calling thread participates in the
+ * batch as well, and task_pool_run does not return until every job of the
+ * batch has completed.
+ *
+ *   Independent tasks can also be submitted without waiting for them.  Each
+ * worker has its own lock-free task queue; tasks submitted from a worker go
+ * to its own queue, others are spread over the workers, and a worker whose
+ * queue is empty steals tasks from the others.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct task_pool;
+typedef struct task_pool task_pool_t;
+
+typedef void (*task_pool_job_t)(void *param, size_t idx);
+
+/**
+ * Creates a task pool.  If num_threads is 0, the number of worker threads is
+ * based upon the number of logical cores.
+ */
+EXPORT task_pool_t *task_pool_create(size_t num_threads);
+EXPORT void task_pool_destroy(task_pool_t *pool);
+
+/** Returns the number of worker threads (not counting the calling thread) */
+EXPORT size_t task_pool_get_num_threads(const task_pool_t *pool);
+
+/**
+ * Calls job(param, idx) for each idx in [0, count) and waits for all of them
+ * to complete.  Jobs may run in any order and on any thread.  Only one batch
+ * runs at a time; concurrent calls are serialized.
+ */
+EXPORT void task_pool_run(task_pool_t *pool, size_t count,
+		task_pool_job_t job, void *param);
+
+typedef void (*task_pool_task_t)(void *param);
+
+/**
+ * Queues task(param) to run on one of the worker threads and returns
+ * immediately.  If the pool has no worker threads or its queues are full,
+ * the task is run on the calling thread before this returns.
+ */
+EXPORT void task_pool_submit(task_pool_t *pool, task_pool_task_t task,
+		void *param);
+
+/**
+ * Waits until every submitted task has completed, running queued tasks on
+ * the calling thread in the meantime.  Must not be called from a task.
+ */
+EXPORT void task_pool_wait(task_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,170 +14,272 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdio.h>
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
 
 /* ------------------------------------------------------------------------- */
+/*
+ * Lookup tables
+ *
+ *   Each file added to a lookup is stored as a single block of memory, which
+ * is also the format of compiled lookup files, so those are used as they are
+ * read without any parsing or further allocation:
+ *
+ *     [struct table_header]
+ *     [uint32_t slots[num_slots]]              entry index + 1, 0 if empty
+ *     [struct table_entry entries[num_entries]]
+ *     [char strings[strings_size]]             null terminated keys/values
+ *
+ *   Keys are case insensitive and are found by open addressing on their
+ * hash.  Tables of files that were added later take precedence.
+ */
 
-struct text_leaf {
-	char *lookup, *value;
-};
-
-static inline void text_leaf_destroy(struct text_leaf *leaf)
-{
-	if (leaf) {
-		bfree(leaf->lookup);
-		bfree(leaf->value);
-		bfree(leaf);
-	}
-}
+#define TABLE_MAGIC   0x4C53424F /* "OBSL" when stored little endian */
+#define TABLE_VERSION 1
 
-/* ------------------------------------------------------------------------- */
+struct table_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_slots;
+	uint32_t num_entries;
+	uint32_t strings_size;
+};
 
-struct text_node {
-	struct dstr str;
-	struct text_node *first_subnode;
-	struct text_leaf *leaf;
+struct table_entry {
+	uint32_t hash;
+	uint32_t key;
+	uint32_t value;
+};
 
-	struct text_node *next;
+struct lookup_table {
+	uint8_t                   *data;
+	size_t                    size;
+	const struct table_header *header;
+	const uint32_t            *slots;
+	const struct table_entry  *entries;
+	const char                *strings;
 };
 
-static void text_node_destroy(struct text_node *node)
+static inline uint32_t lookup_hash(const char *str)
 {
-	struct text_node *subnode;
-
-	if (!node)
-		return;
+	uint32_t hash = 2166136261U;
 
-	subnode = node->first_subnode;
-	while (subnode) {
-		struct text_node *destroy_node = subnode;
+	for (; *str; str++) {
+		uint8_t ch = (uint8_t)*str;
+		if (ch >= 'A' && ch <= 'Z')
+			ch += 0x20;
 
-		subnode = subnode->next;
-		text_node_destroy(destroy_node);
+		hash = (hash ^ ch) * 16777619U;
 	}
 
-	dstr_free(&node->str);
-	if (node->leaf)
-		text_leaf_destroy(node->leaf);
-	bfree(node);
+	return hash;
 }
 
-static struct text_node *text_node_bychar(struct text_node *node, char ch)
+/* validates the table so that lookups can't go out of bounds, even with a
+ * corrupt compiled file */
+static bool table_init(struct lookup_table *table, uint8_t *data, size_t size)
 {
-	struct text_node *subnode = node->first_subnode;
+	const struct table_header *header = (const struct table_header*)data;
+	size_t empty_slots = 0;
+	size_t offset;
 
-	while (subnode) {
-		if (!dstr_is_empty(&subnode->str) &&
-		    subnode->str.array[0] == ch)
-			return subnode;
+	if (size < sizeof(*header) || header->magic != TABLE_MAGIC ||
+	    header->version != TABLE_VERSION)
+		return false;
+	if (!header->num_slots || (header->num_slots & (header->num_slots - 1)))
+		return false;
+	if (header->num_slots > size / sizeof(uint32_t) ||
+	    header->num_entries > size / sizeof(struct table_entry) ||
+	    header->strings_size > size)
+		return false;
 
-		subnode = subnode->next;
+	offset = sizeof(*header) +
+		header->num_slots * sizeof(uint32_t) +
+		header->num_entries * sizeof(struct table_entry);
+	if (offset + header->strings_size != size || !header->strings_size)
+		return false;
+
+	table->data    = data;
+	table->size    = size;
+	table->header  = header;
+	table->slots   = (const uint32_t*)(data + sizeof(*header));
+	table->entries = (const struct table_entry*)
+		(table->slots + header->num_slots);
+	table->strings = (const char*)(data + offset);
+
+	if (table->strings[header->strings_size - 1] != 0)
+		return false;
+
+	for (uint32_t i = 0; i < header->num_slots; i++) {
+		if (table->slots[i] > header->num_entries)
+			return false;
+		if (!table->slots[i])
+			empty_slots++;
+	}
+
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		if (table->entries[i].key   >= header->strings_size ||
+		    table->entries[i].value >= header->strings_size)
+			return false;
 	}
 
-	return NULL;
+	/* probing stops at an empty slot */
+	return empty_slots != 0;
 }
 
-static struct text_node *text_node_byname(struct text_node *node,
-		const char *name)
+static const struct table_entry *table_find(const struct lookup_table *table,
+		const char *key, uint32_t hash)
 {
-	struct text_node *subnode = node->first_subnode;
+	uint32_t mask = table->header->num_slots - 1;
 
-	while (subnode) {
-		if (astrcmpi_n(subnode->str.array, name, subnode->str.len) == 0)
-			return subnode;
+	for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+		const struct table_entry *entry;
+		uint32_t slot = table->slots[i];
 
-		subnode = subnode->next;
-	}
+		if (!slot)
+			return NULL;
 
-	return NULL;
+		entry = table->entries + (slot - 1);
+		if (entry->hash == hash &&
+		    astrcmpi(table->strings + entry->key, key) == 0)
+			return entry;
+	}
 }
 
 /* ------------------------------------------------------------------------- */
 
-struct text_lookup {
-	struct dstr language;
-	struct text_node *top;
+struct table_builder {
+	DARRAY(struct table_entry) entries;
+	DARRAY(char)               strings;
 };
 
-static void lookup_createsubnode(const char *lookup_val,
-		struct text_leaf *leaf, struct text_node *node)
+static inline uint32_t builder_add_string(struct table_builder *builder,
+		const char *str, size_t len)
 {
-	struct text_node *new = bzalloc(sizeof(struct text_node));
-	new->leaf = leaf;
-	new->next = node->first_subnode;
-	dstr_copy(&new->str, lookup_val);
+	uint32_t offset = (uint32_t)builder->strings.num;
+	char     end    = 0;
 
-	node->first_subnode = new;
+	da_push_back_array(builder->strings, str, len);
+	da_push_back(builder->strings, &end);
+	return offset;
 }
 
-static void lookup_splitnode(const char *lookup_val, size_t len,
-		struct text_leaf *leaf, struct text_node *node)
+/* copies the value, converting \n, \t and \r escapes */
+static uint32_t builder_add_value(struct table_builder *builder,
+		const char *str, size_t len)
 {
-	struct text_node *split = bzalloc(sizeof(struct text_node));
+	uint32_t offset = (uint32_t)builder->strings.num;
+	char     end    = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		char ch = str[i];
+
+		if (ch == '\\' && i + 1 < len) {
+			char next = str[i + 1];
+			if (next == 'n' || next == 't' || next == 'r') {
+				ch = (next == 'n') ? '\n' :
+				     (next == 't') ? '\t' : '\r';
+				i++;
+			}
+		}
 
-	dstr_copy(&split->str, node->str.array+len);
-	split->leaf = node->leaf;
-	split->first_subnode = node->first_subnode;
-	node->first_subnode = split;
+		da_push_back(builder->strings, &ch);
+	}
 
-	dstr_resize(&node->str, len);
+	da_push_back(builder->strings, &end);
+	return offset;
+}
 
-	if (lookup_val[len] != 0) {
-		node->leaf = NULL;
-		lookup_createsubnode(lookup_val+len, leaf, node);
-	} else {
-		node->leaf = leaf;
-	}
+static void builder_add(struct table_builder *builder, const char *key,
+		uint32_t value)
+{
+	struct table_entry *entry = da_push_back_new(builder->entries);
+
+	entry->key   = builder_add_string(builder, key, strlen(key));
+	entry->value = value;
+	entry->hash  = lookup_hash(key);
 }
 
-static inline void lookup_replaceleaf(struct text_node *node,
-		struct text_leaf *leaf)
+static inline void builder_free(struct table_builder *builder)
 {
-	text_leaf_destroy(node->leaf);
-	node->leaf = leaf;
+	da_free(builder->entries);
+	da_free(builder->strings);
 }
 
-static void lookup_addstring(const char *lookup_val, struct text_leaf *leaf,
-		struct text_node *node)
+/* if a key was added more than once, the last one is used */
+static bool builder_finish(struct table_builder *builder,
+		struct lookup_table *table)
 {
-	struct text_node *child;
+	struct table_header *header;
+	struct table_entry  *entries;
+	uint32_t            *slots;
+	uint32_t            num_slots = 8;
+	uint32_t            mask;
+	uint8_t             *data;
+	size_t              size;
+	char                end = 0;
+
+	if (!builder->strings.num)
+		da_push_back(builder->strings, &end);
+
+	while (num_slots < builder->entries.num * 2)
+		num_slots <<= 1;
+	mask = num_slots - 1;
+
+	size = sizeof(*header) + num_slots * sizeof(uint32_t) +
+		builder->entries.num * sizeof(struct table_entry) +
+		builder->strings.num;
+	data = bzalloc(size);
+
+	header  = (struct table_header*)data;
+	slots   = (uint32_t*)(data + sizeof(*header));
+	entries = (struct table_entry*)(slots + num_slots);
+
+	header->magic        = TABLE_MAGIC;
+	header->version      = TABLE_VERSION;
+	header->num_slots    = num_slots;
+	header->num_entries  = (uint32_t)builder->entries.num;
+	header->strings_size = (uint32_t)builder->strings.num;
+
+	memcpy(entries, builder->entries.array,
+			builder->entries.num * sizeof(struct table_entry));
+	memcpy((uint8_t*)(entries + builder->entries.num),
+			builder->strings.array, builder->strings.num);
+
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		const char *key = builder->strings.array + entries[i].key;
+		uint32_t   pos  = entries[i].hash & mask;
+
+		while (slots[pos]) {
+			struct table_entry *cur = entries + (slots[pos] - 1);
+			if (cur->hash == entries[i].hash &&
+			    astrcmpi(builder->strings.array + cur->key,
+				    key) == 0)
+				break;
 
-	/* value already exists, so replace */
-	if (!lookup_val || !*lookup_val) {
-		lookup_replaceleaf(node, leaf);
-		return;
-	}
+			pos = (pos + 1) & mask;
+		}
 
-	child = text_node_bychar(node, *lookup_val);
-	if (child) {
-		size_t len;
+		slots[pos] = i + 1;
+	}
 
-		for (len = 0; len < child->str.len; len++) {
-			char val1 = child->str.array[len],
-			        val2 = lookup_val[len];
+	if (!table_init(table, data, size)) {
+		bfree(data);
+		return false;
+	}
 
-			if (val1 >= 'A' && val1 <= 'Z')
-				val1 += 0x20;
-			if (val2 >= 'A' && val2 <= 'Z')
-				val2 += 0x20;
+	return true;
+}
 
-			if (val1 != val2)
-				break;
-		}
+/* ------------------------------------------------------------------------- */
 
-		if (len == child->str.len) {
-			lookup_addstring(lookup_val+len, leaf, child);
-			return;
-		} else {
-			lookup_splitnode(lookup_val, len, leaf, child);
-		}
-	} else {
-		lookup_createsubnode(lookup_val, leaf, node);
-	}
-}
+struct text_lookup {
+	DARRAY(struct lookup_table) tables;
+};
 
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
 {
@@ -277,21 +379,7 @@ static inline bool lookup_goto_nextline(struct lexer *p)
 	return success;
 }
 
-static char *convert_string(const char *str, size_t len)
-{
-	struct dstr out;
-	out.array    = bstrdup_n(str, len);
-	out.capacity = len+1;
-	out.len      = len;
-
-	dstr_replace(&out, "\\n", "\n");
-	dstr_replace(&out, "\\t", "\t");
-	dstr_replace(&out, "\\r", "\r");
-
-	return out.array;
-}
-
-static void lookup_addfiledata(struct text_lookup *lookup,
+static void lookup_addfiledata(struct table_builder *builder,
 		const char *file_data)
 {
 	struct lexer lex;
@@ -303,7 +391,7 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 	strref_clear(&value);
 
 	while (lookup_gettoken(&lex, &name)) {
-		struct text_leaf *leaf;
+		struct table_entry *entry;
 		bool got_eq = false;
 
 		if (*name.array == '\n')
@@ -318,11 +406,13 @@ getval:
 			goto getval;
 		}
 
-		leaf = bmalloc(sizeof(struct text_leaf));
-		leaf->lookup = bstrdup_n(name.array,  name.len);
-		leaf->value  = convert_string(value.array, value.len);
-
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		entry = da_push_back_new(builder->entries);
+		entry->key   = builder_add_string(builder, name.array,
+				name.len);
+		entry->value = builder_add_value(builder, value.array,
+				value.len);
+		entry->hash  = lookup_hash(builder->strings.array +
+				entry->key);
 
 		if (!lookup_goto_nextline(&lex))
 			break;
@@ -331,29 +421,51 @@ getval:
 	lexer_free(&lex);
 }
 
-static inline bool lookup_getstring(const char *lookup_val,
-		const char **out, struct text_node *node)
+static uint8_t *read_file(const char *path, size_t *size)
 {
-	struct text_node *child;
-	char ch;
+	FILE    *file = os_fopen(path, "rb");
+	uint8_t *data = NULL;
+	int64_t file_size;
 
-	if (!node)
-		return false;
+	if (!file)
+		return NULL;
 
-	child = text_node_byname(node, lookup_val);
-	if (!child)
-		return false;
+	file_size = os_fgetsize(file);
+	if (file_size > 0 && (uint64_t)file_size < SIZE_MAX) {
+		data = bmalloc((size_t)file_size + 1);
 
-	lookup_val += child->str.len;
-	ch = *lookup_val;
-	if (ch)
-		return lookup_getstring(lookup_val, out, child);
+		if (fread(data, 1, (size_t)file_size, file) ==
+				(size_t)file_size) {
+			data[file_size] = 0;
+			*size = (size_t)file_size;
+		} else {
+			bfree(data);
+			data = NULL;
+		}
+	}
 
-	if (!child->leaf)
-		return false;
+	fclose(file);
+	return data;
+}
 
-	*out = child->leaf->value;
-	return true;
+static bool load_text_table(struct lookup_table *table, char *text)
+{
+	struct table_builder builder = {0};
+	bool success;
+
+	/* skip the UTF-8 BOM */
+	if (strncmp(text, "\xEF\xBB\xBF", 3) == 0)
+		text += 3;
+
+	for (char *ch = text; *ch; ch++) {
+		if (*ch == '\r')
+			*ch = ' ';
+	}
+
+	lookup_addfiledata(&builder, text);
+	success = builder_finish(&builder, table);
+	builder_free(&builder);
+	return success;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -372,37 +484,87 @@ lookup_t *text_lookup_create(const char *path)
 
 bool text_lookup_add(lookup_t *lookup, const char *path)
 {
-	struct dstr file_str;
-	char *temp = NULL;
+	struct lookup_table table;
+	uint8_t *data;
+	size_t  size;
+	bool    success;
+
+	data = read_file(path, &size);
+	if (!data)
+		return false;
+
+	if (size >= sizeof(uint32_t) && *(uint32_t*)data == TABLE_MAGIC) {
+		success = table_init(&table, data, size);
+		if (!success) {
+			blog(LOG_WARNING, "text_lookup_add: Invalid compiled "
+			                  "lookup file '%s'", path);
+			bfree(data);
+		}
+	} else {
+		success = load_text_table(&table, (char*)data);
+		bfree(data);
+	}
+
+	if (!success)
+		return false;
+
+	da_push_back(lookup->tables, &table);
+	return true;
+}
+
+bool text_lookup_save(lookup_t *lookup, const char *path)
+{
+	struct table_builder builder = {0};
+	struct lookup_table  merged;
+	bool  success = false;
 	FILE *file;
 
-	file = os_fopen(path, "rb");
-	if (!file)
+	if (!lookup)
 		return false;
 
-	os_fread_utf8(file, &temp);
-	dstr_init_move_array(&file_str, temp);
-	fclose(file);
+	for (size_t i = 0; i < lookup->tables.num; i++) {
+		const struct lookup_table *table = lookup->tables.array + i;
+
+		for (uint32_t j = 0; j < table->header->num_slots; j++) {
+			const struct table_entry *entry;
+			const char *value;
+
+			if (!table->slots[j])
+				continue;
+
+			entry = table->entries + (table->slots[j] - 1);
+			value = table->strings + entry->value;
+			builder_add(&builder, table->strings + entry->key,
+					builder_add_string(&builder, value,
+						strlen(value)));
+		}
+	}
 
-	if (!file_str.array)
+	if (!builder_finish(&builder, &merged)) {
+		builder_free(&builder);
 		return false;
+	}
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
+	builder_free(&builder);
 
-	dstr_replace(&file_str, "\r", " ");
-	lookup_addfiledata(lookup, file_str.array);
-	dstr_free(&file_str);
+	file = os_fopen(path, "wb");
+	if (file) {
+		success = fwrite(merged.data, 1, merged.size, file) ==
+			merged.size;
+		fclose(file);
+	}
 
-	return true;
+	bfree(merged.data);
+	return success;
 }
 
 void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
-		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
+		for (size_t i = 0; i < lookup->tables.num; i++)
+			bfree(lookup->tables.array[i].data);
 
+		da_free(lookup->tables);
 		bfree(lookup);
 	}
 }
@@ -410,7 +572,23 @@ void text_lookup_destroy(lookup_t *lookup)
 bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 		const char **out)
 {
-	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
+	uint32_t hash;
+
+	if (!lookup || !lookup_val)
+		return false;
+
+	hash = lookup_hash(lookup_val);
+
+	for (size_t i = lookup->tables.num; i > 0; i--) {
+		const struct lookup_table *table = lookup->tables.array + i - 1;
+		const struct table_entry  *entry;
+
+		entry = table_find(table, lookup_val, hash);
+		if (entry) {
+			*out = table->strings + entry->value;
+			return true;
+		}
+	}
+
 	return false;
 }
@@ -19,9 +19,13 @@
 /*
  * Text Lookup interface
  *
- *   Used for storing and looking up localized strings.  Stores locazation
- * strings in a radix/trie tree to efficiently look up associated strings via a
- * unique string identifier name.
+ *   Used for storing and looking up localized strings.  Stores localization
+ * strings in a hash table to efficiently look up associated strings via a
+ * unique (case insensitive) string identifier name.
+ *
+ *   Files can either be .ini style text files, or compiled lookup files
+ * written by text_lookup_save, which are used as they are read without having
+ * to be parsed.
  */
 
 #include "c99defs.h"
@@ -38,6 +42,7 @@ typedef struct text_lookup lookup_t;
 EXPORT lookup_t *text_lookup_create(const char *path);
 EXPORT bool text_lookup_add(lookup_t *lookup, const char *path);
 EXPORT void text_lookup_destroy(lookup_t *lookup);
+EXPORT bool text_lookup_save(lookup_t *lookup, const char *path);
 EXPORT bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 		const char **out);
 
@@ -248,3 +248,76 @@ long os_atomic_dec_long(volatile long *val)
 {
 	return __sync_sub_and_fetch(val, 1);
 }
+
+long os_atomic_load_long(const volatile long *val)
+{
+	return __sync_add_and_fetch((volatile long*)val, 0);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	__atomic_store_n(val, new_val, __ATOMIC_SEQ_CST);
+}
+
+long os_atomic_add_long(volatile long *val, long add)
+{
+	return __sync_add_and_fetch(val, add);
+}
+
+long os_atomic_exchange_long(volatile long *val, long new_val)
+{
+	return __atomic_exchange_n(val, new_val, __ATOMIC_SEQ_CST);
+}
+
+bool os_atomic_compare_swap_long(volatile long *val, long old_val,
+		long new_val)
+{
+	return __sync_bool_compare_and_swap(val, old_val, new_val);
+}
+
+long os_atomic_load_long_acquire(const volatile long *val)
+{
+	return __atomic_load_n(val, __ATOMIC_ACQUIRE);
+}
+
+void os_atomic_set_long_release(volatile long *val, long new_val)
+{
+	__atomic_store_n(val, new_val, __ATOMIC_RELEASE);
+}
+
+int64_t os_atomic_load_64(const volatile int64_t *val)
+{
+	return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+}
+
+void os_atomic_set_64(volatile int64_t *val, int64_t new_val)
+{
+	__atomic_store_n(val, new_val, __ATOMIC_SEQ_CST);
+}
+
+int64_t os_atomic_add_64(volatile int64_t *val, int64_t add)
+{
+	return __sync_add_and_fetch(val, add);
+}
+
+bool os_atomic_compare_swap_64(volatile int64_t *val, int64_t old_val,
+		int64_t new_val)
+{
+	return __sync_bool_compare_and_swap(val, old_val, new_val);
+}
+
+void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void os_atomic_set_ptr(void *volatile *ptr, void *new_val)
+{
+	__atomic_store_n(ptr, new_val, __ATOMIC_SEQ_CST);
+}
+
+bool os_atomic_compare_swap_ptr(void *volatile *ptr, void *old_val,
+		void *new_val)
+{
+	return __sync_bool_compare_and_swap(ptr, old_val, new_val);
+}
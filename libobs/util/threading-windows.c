@@ -160,3 +160,84 @@ long os_atomic_dec_long(volatile long *val)
 {
 	return InterlockedDecrement(val);
 }
+
+long os_atomic_load_long(const volatile long *val)
+{
+	return InterlockedOr((volatile long*)val, 0);
+}
+
+void os_atomic_set_long(volatile long *val, long new_val)
+{
+	InterlockedExchange(val, new_val);
+}
+
+long os_atomic_add_long(volatile long *val, long add)
+{
+	return InterlockedExchangeAdd(val, add) + add;
+}
+
+long os_atomic_exchange_long(volatile long *val, long new_val)
+{
+	return InterlockedExchange(val, new_val);
+}
+
+bool os_atomic_compare_swap_long(volatile long *val, long old_val,
+		long new_val)
+{
+	return InterlockedCompareExchange(val, new_val, old_val) == old_val;
+}
+
+/* aligned loads and stores of a long are atomic, and x86 does not reorder
+ * loads with later loads or stores with earlier stores, so only the compiler
+ * has to be kept from reordering */
+long os_atomic_load_long_acquire(const volatile long *val)
+{
+	long ret = *val;
+	_ReadWriteBarrier();
+	return ret;
+}
+
+void os_atomic_set_long_release(volatile long *val, long new_val)
+{
+	_ReadWriteBarrier();
+	*val = new_val;
+}
+
+int64_t os_atomic_load_64(const volatile int64_t *val)
+{
+	return InterlockedCompareExchange64((volatile int64_t*)val, 0, 0);
+}
+
+void os_atomic_set_64(volatile int64_t *val, int64_t new_val)
+{
+	InterlockedExchange64(val, new_val);
+}
+
+int64_t os_atomic_add_64(volatile int64_t *val, int64_t add)
+{
+	return InterlockedExchangeAdd64(val, add) + add;
+}
+
+bool os_atomic_compare_swap_64(volatile int64_t *val, int64_t old_val,
+		int64_t new_val)
+{
+	return InterlockedCompareExchange64(val, new_val, old_val) == old_val;
+}
+
+void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return InterlockedCompareExchangePointer((void *volatile*)ptr,
+			NULL, NULL);
+}
+
+void os_atomic_set_ptr(void *volatile *ptr, void *new_val)
+{
+	InterlockedExchangePointer(ptr, new_val);
+}
+
+bool os_atomic_compare_swap_ptr(void *volatile *ptr, void *old_val,
+		void *new_val)
+{
+	return InterlockedCompareExchangePointer(ptr, new_val, old_val) ==
+		old_val;
+}
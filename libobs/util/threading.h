@@ -73,6 +73,77 @@ EXPORT int  os_sem_wait(os_sem_t *sem);
 EXPORT long os_atomic_inc_long(volatile long *val);
 EXPORT long os_atomic_dec_long(volatile long *val);
 
+/* full memory barriers, for handing data between threads without a lock */
+EXPORT long os_atomic_load_long(const volatile long *val);
+EXPORT void os_atomic_set_long(volatile long *val, long new_val);
+
+/** Returns the new value */
+EXPORT long os_atomic_add_long(volatile long *val, long add);
+/** Returns the previous value */
+EXPORT long os_atomic_exchange_long(volatile long *val, long new_val);
+/** Sets val to new_val only if it equals old_val, returns true if it did */
+EXPORT bool os_atomic_compare_swap_long(volatile long *val, long old_val,
+		long new_val);
+
+/*
+ * Acquire/release ordering only: everything written before a release store
+ * is visible to a thread after its acquire load of the same value.  Cheaper
+ * than the full barriers above when a value is published by a single thread.
+ */
+EXPORT long os_atomic_load_long_acquire(const volatile long *val);
+EXPORT void os_atomic_set_long_release(volatile long *val, long new_val);
+
+/* 64-bit variants, atomic on 32-bit platforms as well (full barriers) */
+EXPORT int64_t os_atomic_load_64(const volatile int64_t *val);
+EXPORT void os_atomic_set_64(volatile int64_t *val, int64_t new_val);
+EXPORT int64_t os_atomic_add_64(volatile int64_t *val, int64_t add);
+EXPORT bool os_atomic_compare_swap_64(volatile int64_t *val, int64_t old_val,
+		int64_t new_val);
+
+/* pointer variants (full barriers) */
+EXPORT void *os_atomic_load_ptr(void *const volatile *ptr);
+EXPORT void os_atomic_set_ptr(void *volatile *ptr, void *new_val);
+EXPORT bool os_atomic_compare_swap_ptr(void *volatile *ptr, void *old_val,
+		void *new_val);
+
+/*
+ * Named locking of the main libobs locks.  When built with OBS_PROFILE_LOCKS
+ * (the PROFILE_LOCKS cmake option), the time spent waiting for and holding
+ * each lock is recorded in the profiler under the given name, which has to
+ * be a string literal.  Otherwise these are plain pthread calls.
+ */
+#ifdef OBS_PROFILE_LOCKS
+#include "platform.h"
+#include "profiler.h"
+
+static inline int os_mutex_lock(pthread_mutex_t *mutex, const char *name)
+{
+	uint64_t start_ns = os_gettime_ns();
+	int ret = pthread_mutex_lock(mutex);
+	if (ret == 0)
+		profile_lock_acquired(name, start_ns);
+	return ret;
+}
+
+static inline int os_mutex_unlock(pthread_mutex_t *mutex, const char *name)
+{
+	profile_lock_released(name);
+	return pthread_mutex_unlock(mutex);
+}
+#else
+static inline int os_mutex_lock(pthread_mutex_t *mutex, const char *name)
+{
+	UNUSED_PARAMETER(name);
+	return pthread_mutex_lock(mutex);
+}
+
+static inline int os_mutex_unlock(pthread_mutex_t *mutex, const char *name)
+{
+	UNUSED_PARAMETER(name);
+	return pthread_mutex_unlock(mutex);
+}
+#endif
+
 
 #ifdef __cplusplus
 }
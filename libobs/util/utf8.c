@@ -14,8 +14,12 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 #include <wchar.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "utf8.h"
+#include "simd.h"
 
 #define _NXT	0x80
 #define _SEQ2	0xc0
@@ -51,6 +55,133 @@ static int utf8_forbidden(unsigned char octet)
 	return 0;
 }
 
+/*
+ * ASCII fast paths: runs of ASCII characters (other than zero, which ends
+ * the string) are converted a block at a time, everything else goes through
+ * the per-character conversion.  Both return the number of characters
+ * converted from the start of the input.
+ */
+
+#ifdef SIMD_SSE2
+static inline void store_wide_ascii(wchar_t *out, __m128i v, __m128i zero)
+{
+	__m128i lo = _mm_unpacklo_epi8(v, zero);
+	__m128i hi = _mm_unpackhi_epi8(v, zero);
+
+	if (sizeof(wchar_t) == 2) {
+		_mm_storeu_si128((__m128i*)out,       lo);
+		_mm_storeu_si128((__m128i*)(out + 8), hi);
+	} else {
+		_mm_storeu_si128((__m128i*)out,
+				_mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(out + 4),
+				_mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(out + 8),
+				_mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*)(out + 12),
+				_mm_unpackhi_epi16(hi, zero));
+	}
+}
+
+/* packs 8 wide characters to bytes if they're all ASCII (and not zero) */
+static inline bool pack_ascii(const wchar_t *in, __m128i *bytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v, high, nul;
+
+	if (sizeof(wchar_t) == 2) {
+		v    = _mm_loadu_si128((const __m128i*)in);
+		high = _mm_and_si128(v, _mm_set1_epi16((short)0xff80));
+		high = _mm_cmpeq_epi16(high, zero);
+		nul  = _mm_cmpeq_epi16(v, zero);
+	} else {
+		__m128i a = _mm_loadu_si128((const __m128i*)in);
+		__m128i b = _mm_loadu_si128((const __m128i*)(in + 4));
+
+		high = _mm_and_si128(_mm_or_si128(a, b),
+				_mm_set1_epi32((int)0xffffff80));
+		high = _mm_cmpeq_epi32(high, zero);
+		nul  = _mm_or_si128(_mm_cmpeq_epi32(a, zero),
+				_mm_cmpeq_epi32(b, zero));
+		v    = _mm_packs_epi32(a, b);
+	}
+
+	if (_mm_movemask_epi8(_mm_andnot_si128(nul, high)) != 0xffff)
+		return false;
+
+	*bytes = _mm_packus_epi16(v, v);
+	return true;
+}
+#endif
+
+static size_t utf8_ascii_run(const unsigned char *in, size_t in_size,
+		wchar_t *out, size_t out_size)
+{
+	size_t done = 0;
+
+#ifdef SIMD_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	while (in_size - done >= 16 && out_size - done >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + done));
+
+		/* the high bit is set for non-ASCII bytes and for zeros */
+		if (_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero))))
+			break;
+
+		if (out)
+			store_wide_ascii(out + done, v, zero);
+		done += 16;
+	}
+#else
+	while (in_size - done >= 8 && out_size - done >= 8) {
+		uint64_t v;
+		memcpy(&v, in + done, 8);
+
+		/* the high bit is set for non-ASCII bytes and for zeros */
+		if ((v | ((v - 0x0101010101010101ULL) & ~v)) &
+				0x8080808080808080ULL)
+			break;
+
+		if (out) {
+			for (size_t i = 0; i < 8; i++)
+				out[done + i] = (wchar_t)in[done + i];
+		}
+		done += 8;
+	}
+#endif
+
+	return done;
+}
+
+static size_t wchar_ascii_run(const wchar_t *in, size_t in_size,
+		unsigned char *out, size_t out_size)
+{
+	size_t done = 0;
+
+#ifdef SIMD_SSE2
+	while (in_size - done >= 8 && out_size - done >= 8) {
+		__m128i bytes;
+
+		if (!pack_ascii(in + done, &bytes))
+			break;
+
+		if (out)
+			_mm_storel_epi64((__m128i*)(out + done), bytes);
+		done += 8;
+	}
+#endif
+
+	while (done < in_size && done < out_size &&
+	       in[done] > 0 && in[done] < 0x80) {
+		if (out)
+			out[done] = (unsigned char)in[done];
+		done++;
+	}
+
+	return done;
+}
+
 /*
  * DESCRIPTION
  *	This function translates UTF-8 string into UCS-4 string (all symbols
@@ -90,13 +221,24 @@ size_t utf8_to_wchar(const char *in, size_t insize, wchar_t *out,
 
 	total = 0;
 	p = (unsigned char *)in;
-	lim = (insize != 0) ? (p + insize) : (unsigned char*)-1;
+	lim = p + ((insize != 0) ? insize : strlen(in));
 	wlim = out + outsize;
 
 	for (; p < lim; p += n) {
 		if (!*p)
 			break;
 
+		if (*p < 0x80) {
+			n = utf8_ascii_run(p, (size_t)(lim - p), out,
+					out ? (size_t)(wlim - out) : SIZE_MAX);
+			if (n) {
+				total += n;
+				if (out)
+					out += n;
+				continue;
+			}
+		}
+
 		if (utf8_forbidden(*p) != 0 &&
 		    (flags & UTF8_IGNORE_ERROR) == 0)
 			return 0;
@@ -219,7 +361,7 @@ size_t wchar_to_utf8(const wchar_t *in, size_t insize, char *out,
 		return 0;
 
 	w = (wchar_t *)in;
-	wlim = (insize != 0) ? (w + insize) : (wchar_t*)-1;
+	wlim = w + ((insize != 0) ? insize : wcslen(in));
 	p = (unsigned char *)out;
 	lim = p + outsize;
 	total = 0;
@@ -228,6 +370,18 @@ size_t wchar_to_utf8(const wchar_t *in, size_t insize, char *out,
 		if (!*w)
 			break;
 
+		if (*w < 0x80) {
+			n = wchar_ascii_run(w, (size_t)(wlim - w), p,
+					out ? (size_t)(lim - p) : SIZE_MAX);
+			if (n) {
+				total += n;
+				if (out)
+					p += n;
+				w += n - 1;
+				continue;
+			}
+		}
+
 		if (wchar_forbidden(*w) != 0) {
 			if ((flags & UTF8_IGNORE_ERROR) == 0)
 				return 0;
@@ -0,0 +1,563 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * Runs libobs without any user interface or window: loads a scene collection
+ * saved by the main program, starts the outputs described in a JSON file,
+ * and keeps compositing until interrupted, the duration runs out, or every
+ * output has stopped.  The outputs file looks like:
+ *
+ * {
+ *   "video": { "base_width": 1920, "base_height": 1080,
+ *              "output_width": 1280, "output_height": 720,
+ *              "fps_num": 30, "fps_den": 1, "format": "NV12",
+ *              "offline": false },
+ *   "audio": { "samples_per_sec": 48000, "channels": 2 },
+ *   "outputs": [
+ *     { "id": "rtmp_output", "name": "stream", "settings": { },
+ *       "video_encoder": { "id": "obs_x264", "settings": { } },
+ *       "audio_encoder": { "id": "ffmpeg_aac", "settings": { } },
+ *       "service": { "id": "rtmp_custom", "settings": { } } }
+ *   ]
+ * }
+ *
+ * Raw outputs simply leave out the encoders and service.  With "offline"
+ * set, frames are rendered as fast as possible instead of in real time, and
+ * the duration is counted in rendered time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/bmem.h>
+
+#ifdef _WIN32
+#define DEFAULT_GRAPHICS_MODULE "libobs-d3d11"
+#else
+#define DEFAULT_GRAPHICS_MODULE "libobs-opengl"
+#endif
+
+/* keys the main program saves the global audio sources under */
+static const char *audio_device_keys[] = {
+	"DesktopAudioDevice1",
+	"DesktopAudioDevice2",
+	"AuxAudioDevice1",
+	"AuxAudioDevice2",
+	"AuxAudioDevice3"
+};
+
+struct headless_output {
+	obs_output_t  *output;
+	obs_encoder_t *video_encoder;
+	obs_encoder_t *audio_encoder;
+	obs_service_t *service;
+};
+
+struct headless {
+	const char                      *graphics_module;
+	const char                      *collection_path;
+	const char                      *outputs_path;
+	const char                      *locale;
+	const char                      *plugin_bin_path;
+	const char                      *plugin_data_path;
+	uint64_t                        duration_ns;
+	bool                            offline;
+
+	obs_data_t                      *outputs_config;
+	DARRAY(struct headless_output)  outputs;
+
+	os_event_t                      *stop_event;
+	volatile long                   active_outputs;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handle_signal(int sig)
+{
+	interrupted = 1;
+	UNUSED_PARAMETER(sig);
+}
+
+static obs_data_t *load_json_file(const char *path)
+{
+	char *json = os_quick_read_utf8_file(path);
+	obs_data_t *data;
+
+	if (!json) {
+		blog(LOG_ERROR, "Could not read '%s'", path);
+		return NULL;
+	}
+
+	data = obs_data_create_from_json(json);
+	bfree(json);
+
+	if (!data)
+		blog(LOG_ERROR, "Could not parse '%s'", path);
+	return data;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static enum video_format get_video_format(const char *name)
+{
+	if (astrcmpi(name, "I420") == 0)
+		return VIDEO_FORMAT_I420;
+	else if (astrcmpi(name, "RGBA") == 0)
+		return VIDEO_FORMAT_RGBA;
+	else if (astrcmpi(name, "BGRA") == 0)
+		return VIDEO_FORMAT_BGRA;
+	else if (astrcmpi(name, "BGRX") == 0)
+		return VIDEO_FORMAT_BGRX;
+
+	return VIDEO_FORMAT_NV12;
+}
+
+static bool reset_video(struct headless *hl)
+{
+	obs_data_t *video = obs_data_get_obj(hl->outputs_config, "video");
+	struct obs_video_info ovi = {0};
+	int ret;
+
+	if (!video)
+		video = obs_data_create();
+
+	obs_data_set_default_int(video, "base_width", 1920);
+	obs_data_set_default_int(video, "base_height", 1080);
+	obs_data_set_default_int(video, "fps_num", 30);
+	obs_data_set_default_int(video, "fps_den", 1);
+	obs_data_set_default_string(video, "format", "NV12");
+
+	ovi.graphics_module = hl->graphics_module;
+	ovi.base_width      = (uint32_t)obs_data_get_int(video, "base_width");
+	ovi.base_height     = (uint32_t)obs_data_get_int(video, "base_height");
+	ovi.output_width    = (uint32_t)obs_data_get_int(video,
+			"output_width");
+	ovi.output_height   = (uint32_t)obs_data_get_int(video,
+			"output_height");
+	ovi.fps_num         = (uint32_t)obs_data_get_int(video, "fps_num");
+	ovi.fps_den         = (uint32_t)obs_data_get_int(video, "fps_den");
+	ovi.output_format   = get_video_format(
+			obs_data_get_string(video, "format"));
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.gpu_conversion  = true;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+	ovi.offline         = obs_data_get_bool(video, "offline");
+	hl->offline         = ovi.offline;
+
+	if (!ovi.output_width || !ovi.output_height) {
+		ovi.output_width  = ovi.base_width;
+		ovi.output_height = ovi.base_height;
+	}
+
+	/* ovi.window is left zeroed: there is no window to render to, so
+	 * libobs skips rendering displays entirely */
+	ret = obs_reset_video(&ovi);
+	obs_data_release(video);
+
+	if (ret != OBS_VIDEO_SUCCESS) {
+		blog(LOG_ERROR, "Failed to initialize video with '%s': %d",
+				hl->graphics_module, ret);
+		return false;
+	}
+
+	return true;
+}
+
+static bool reset_audio(struct headless *hl)
+{
+	obs_data_t *audio = obs_data_get_obj(hl->outputs_config, "audio");
+	struct audio_output_info ai = {0};
+	bool success;
+
+	if (!audio)
+		audio = obs_data_create();
+
+	obs_data_set_default_int(audio, "samples_per_sec", 44100);
+	obs_data_set_default_int(audio, "channels", 2);
+	obs_data_set_default_int(audio, "buffer_ms", 1000);
+
+	ai.name            = "Main Audio Track";
+	ai.format          = AUDIO_FORMAT_FLOAT;
+	ai.samples_per_sec = (uint32_t)obs_data_get_int(audio,
+			"samples_per_sec");
+	ai.speakers        = obs_data_get_int(audio, "channels") == 1 ?
+		SPEAKERS_MONO : SPEAKERS_STEREO;
+	ai.buffer_ms       = (uint64_t)obs_data_get_int(audio, "buffer_ms");
+
+	success = obs_reset_audio(&ai);
+	obs_data_release(audio);
+
+	if (!success)
+		blog(LOG_ERROR, "Failed to initialize audio");
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void load_audio_device(const char *key, int channel, obs_data_t *parent)
+{
+	obs_data_t *data = obs_data_get_obj(parent, key);
+	if (!data)
+		return;
+
+	obs_source_t *source = obs_load_source(data);
+	if (source) {
+		obs_set_output_source(channel, source);
+		obs_source_release(source);
+	}
+
+	obs_data_release(data);
+}
+
+static bool load_collection(struct headless *hl)
+{
+	obs_data_t       *data = load_json_file(hl->collection_path);
+	obs_data_array_t *sources;
+	obs_source_t     *scene;
+	const char       *scene_name;
+
+	if (!data)
+		return false;
+
+	for (size_t i = 0; i < sizeof(audio_device_keys) /
+			sizeof(audio_device_keys[0]); i++)
+		load_audio_device(audio_device_keys[i], (int)i + 1, data);
+
+	sources = obs_data_get_array(data, "sources");
+	obs_load_sources(sources);
+	obs_data_array_release(sources);
+
+	scene_name = obs_data_get_string(data, "current_scene");
+	scene = obs_get_source_by_name(scene_name);
+	if (!scene)
+		blog(LOG_WARNING, "Scene '%s' not found, nothing will be "
+		                  "rendered", scene_name);
+
+	obs_set_output_source(0, scene);
+	obs_source_release(scene);
+
+	obs_data_release(data);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void output_stopped(void *param, calldata_t *params)
+{
+	struct headless *hl = param;
+	obs_output_t *output = calldata_ptr(params, "output");
+
+	blog(LOG_INFO, "Output '%s' stopped (code %d)",
+			obs_output_get_name(output),
+			(int)calldata_int(params, "code"));
+
+	if (os_atomic_dec_long(&hl->active_outputs) == 0)
+		os_event_signal(hl->stop_event);
+}
+
+static void free_output(struct headless_output *ho)
+{
+	obs_output_destroy(ho->output);
+	obs_encoder_destroy(ho->video_encoder);
+	obs_encoder_destroy(ho->audio_encoder);
+	obs_service_destroy(ho->service);
+}
+
+static bool create_output(struct headless *hl, obs_data_t *config,
+		struct headless_output *ho)
+{
+	const char *id   = obs_data_get_string(config, "id");
+	const char *name = obs_data_get_string(config, "name");
+	obs_data_t *settings = obs_data_get_obj(config, "settings");
+	obs_data_t *venc = obs_data_get_obj(config, "video_encoder");
+	obs_data_t *aenc = obs_data_get_obj(config, "audio_encoder");
+	obs_data_t *service = obs_data_get_obj(config, "service");
+	bool success = false;
+
+	if (!*name)
+		name = id;
+
+	ho->output = obs_output_create(id, name, settings);
+	if (!ho->output) {
+		blog(LOG_ERROR, "Failed to create output '%s' (%s)", name, id);
+		goto exit;
+	}
+
+	if (venc) {
+		obs_data_t *enc_settings = obs_data_get_obj(venc, "settings");
+		ho->video_encoder = obs_video_encoder_create(
+				obs_data_get_string(venc, "id"), name,
+				enc_settings);
+		obs_data_release(enc_settings);
+
+		if (!ho->video_encoder) {
+			blog(LOG_ERROR, "Failed to create video encoder for "
+			                "output '%s'", name);
+			goto exit;
+		}
+
+		obs_encoder_set_video(ho->video_encoder, obs_get_video());
+		obs_output_set_video_encoder(ho->output, ho->video_encoder);
+	}
+
+	if (aenc) {
+		obs_data_t *enc_settings = obs_data_get_obj(aenc, "settings");
+		ho->audio_encoder = obs_audio_encoder_create(
+				obs_data_get_string(aenc, "id"), name,
+				enc_settings, 0);
+		obs_data_release(enc_settings);
+
+		if (!ho->audio_encoder) {
+			blog(LOG_ERROR, "Failed to create audio encoder for "
+			                "output '%s'", name);
+			goto exit;
+		}
+
+		obs_encoder_set_audio(ho->audio_encoder, obs_get_audio());
+		obs_output_set_audio_encoder(ho->output, ho->audio_encoder, 0);
+	}
+
+	if (service) {
+		obs_data_t *svc_settings = obs_data_get_obj(service,
+				"settings");
+		ho->service = obs_service_create(
+				obs_data_get_string(service, "id"), name,
+				svc_settings);
+		obs_data_release(svc_settings);
+
+		if (!ho->service) {
+			blog(LOG_ERROR, "Failed to create service for "
+			                "output '%s'", name);
+			goto exit;
+		}
+
+		obs_output_set_service(ho->output, ho->service);
+	}
+
+	signal_handler_connect(obs_output_get_signal_handler(ho->output),
+			"stop", output_stopped, hl);
+	success = true;
+
+exit:
+	obs_data_release(settings);
+	obs_data_release(venc);
+	obs_data_release(aenc);
+	obs_data_release(service);
+	return success;
+}
+
+static bool start_outputs(struct headless *hl)
+{
+	obs_data_array_t *outputs;
+	size_t count;
+
+	outputs = obs_data_get_array(hl->outputs_config, "outputs");
+	count = obs_data_array_count(outputs);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *config = obs_data_array_item(outputs, i);
+		struct headless_output ho = {0};
+
+		if (create_output(hl, config, &ho))
+			da_push_back(hl->outputs, &ho);
+		else
+			free_output(&ho);
+
+		obs_data_release(config);
+	}
+
+	obs_data_array_release(outputs);
+
+	for (size_t i = 0; i < hl->outputs.num; i++) {
+		obs_output_t *output = hl->outputs.array[i].output;
+
+		os_atomic_inc_long(&hl->active_outputs);
+
+		if (!obs_output_start(output)) {
+			blog(LOG_ERROR, "Failed to start output '%s'",
+					obs_output_get_name(output));
+			os_atomic_dec_long(&hl->active_outputs);
+		}
+	}
+
+	if (!os_atomic_load_long(&hl->active_outputs)) {
+		blog(LOG_ERROR, "No outputs could be started");
+		return false;
+	}
+
+	return true;
+}
+
+/* offline, time is counted on the virtual video clock */
+static inline uint64_t get_time(struct headless *hl)
+{
+	return hl->offline ? video_output_get_time(obs_get_video()) :
+		os_gettime_ns();
+}
+
+/* returns once interrupted, out of time, or every output has stopped */
+static void wait_for_stop(struct headless *hl)
+{
+	uint64_t end_time = hl->duration_ns ?
+		get_time(hl) + hl->duration_ns : 0;
+
+	signal(SIGINT,  handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	while (!interrupted) {
+		if (os_event_timedwait(hl->stop_event, 100) == 0)
+			break;
+		if (end_time && get_time(hl) >= end_time)
+			break;
+	}
+
+	signal(SIGINT,  SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
+
+static void stop_outputs(struct headless *hl)
+{
+	for (size_t i = 0; i < hl->outputs.num; i++)
+		obs_output_stop(hl->outputs.array[i].output);
+	for (size_t i = 0; i < hl->outputs.num; i++)
+		free_output(&hl->outputs.array[i]);
+
+	da_free(hl->outputs);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"usage: %s [options] <scene collection> <outputs file>\n"
+		"\n"
+		"  --graphics <module>        graphics module (default %s)\n"
+		"  --duration <seconds>       stop after the given time\n"
+		"  --plugins <bin> <data>     also load plugins from the "
+		"given paths\n"
+		"  --locale <locale>          locale (default en-US)\n",
+		program, DEFAULT_GRAPHICS_MODULE);
+}
+
+static bool parse_args(struct headless *hl, int argc, char *argv[])
+{
+	int positional = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+
+		if (strcmp(arg, "--graphics") == 0 && i + 1 < argc) {
+			hl->graphics_module = argv[++i];
+
+		} else if (strcmp(arg, "--duration") == 0 && i + 1 < argc) {
+			hl->duration_ns = strtoull(argv[++i], NULL, 10) *
+				1000000000ULL;
+
+		} else if (strcmp(arg, "--plugins") == 0 && i + 2 < argc) {
+			hl->plugin_bin_path  = argv[++i];
+			hl->plugin_data_path = argv[++i];
+
+		} else if (strcmp(arg, "--locale") == 0 && i + 1 < argc) {
+			hl->locale = argv[++i];
+
+		} else if (strncmp(arg, "--", 2) == 0) {
+			return false;
+
+		} else if (positional == 0) {
+			hl->collection_path = arg;
+			positional++;
+
+		} else if (positional == 1) {
+			hl->outputs_path = arg;
+			positional++;
+
+		} else {
+			return false;
+		}
+	}
+
+	return positional == 2;
+}
+
+static bool init(struct headless *hl)
+{
+	hl->outputs_config = load_json_file(hl->outputs_path);
+	if (!hl->outputs_config)
+		return false;
+
+	if (!reset_audio(hl) || !reset_video(hl))
+		return false;
+
+	if (hl->plugin_bin_path)
+		obs_add_module_path(hl->plugin_bin_path,
+				hl->plugin_data_path);
+	obs_load_all_modules();
+
+	if (!load_collection(hl))
+		return false;
+
+	return start_outputs(hl);
+}
+
+int main(int argc, char *argv[])
+{
+	struct headless hl = {0};
+	int ret = 1;
+
+	hl.graphics_module = DEFAULT_GRAPHICS_MODULE;
+	hl.locale          = "en-US";
+
+	if (!parse_args(&hl, argc, argv)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (os_event_init(&hl.stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return 1;
+
+	if (!obs_startup(hl.locale)) {
+		fprintf(stderr, "Failed to initialize libobs\n");
+		goto exit;
+	}
+
+	if (!init(&hl))
+		goto exit;
+
+	blog(LOG_INFO, "Running headless, %ld output(s) active",
+			os_atomic_load_long(&hl.active_outputs));
+
+	wait_for_stop(&hl);
+
+	blog(LOG_INFO, "Stopping");
+	ret = 0;
+
+exit:
+	stop_outputs(&hl);
+	for (int i = 0; i < MAX_CHANNELS; i++)
+		obs_set_output_source(i, NULL);
+	obs_data_release(hl.outputs_config);
+	obs_shutdown();
+	os_event_destroy(hl.stop_event);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return ret;
+}
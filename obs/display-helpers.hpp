@@ -45,3 +45,21 @@ static inline QSize GetPixelSize(QWidget *widget)
 {
 	return widget->size() * widget->devicePixelRatio();
 }
+
+#define BACKGROUND_DISPLAY_INTERVAL 4
+
+/* displays don't need to keep up with the output while their window is in
+ * the background, and can stop entirely while it's minimized */
+static inline uint32_t GetDisplayInterval(QWidget *window)
+{
+	if (!window->isVisible() || window->isMinimized())
+		return 0;
+
+	return window->isActiveWindow() ? 1 : BACKGROUND_DISPLAY_INTERVAL;
+}
+
+static inline bool IsDisplayIntervalEvent(QEvent *event)
+{
+	return event->type() == QEvent::WindowStateChange ||
+	       event->type() == QEvent::ActivationChange;
+}
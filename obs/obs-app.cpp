@@ -21,6 +21,8 @@
 #include <util/bmem.h>
 #include <util/dstr.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <util/ring-queue.h>
 #include <obs-config.h>
 #include <obs.hpp>
 
@@ -33,6 +35,7 @@
 #include "platform.hpp"
 
 #include <fstream>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -68,32 +71,197 @@ string CurrentDateTimeString()
 	return buf;
 }
 
-static void do_log(int log_level, const char *msg, va_list args, void *param)
+/* ------------------------------------------------------------------------- */
+/* log writer
+ *
+ * Messages are formatted on the calling thread and handed to a writer thread
+ * through a lock-free queue, so the video, audio and encoder threads never
+ * wait on file I/O when they log.  If the queue is full the message is
+ * dropped and counted rather than blocking the caller.  Repeats of the last
+ * queued message are only counted, and written as a single line at most
+ * once a second. */
+
+#define LOG_QUEUE_SIZE     512
+#define LOG_MAX_LENGTH     4096
+#define LOG_REPEAT_TIME_NS 1000000000ULL
+
+struct LogRecord {
+	int    log_level;
+	time_t time;
+	char   str[LOG_MAX_LENGTH];
+};
+
+static fstream       *logWriterFile = nullptr;
+static mpmc_queue_t  *logQueue      = nullptr;
+static os_event_t    *logEvent      = nullptr;
+static thread        logThread;
+static volatile long logExiting     = 0;
+static volatile long logDropped     = 0;
+static volatile long logRepeats     = 0;
+static volatile long logLastHash    = 0;
+
+static string TimeString(time_t timestamp)
 {
-	fstream &logFile = *static_cast<fstream*>(param);
-	char str[4096];
+	struct tm  tstruct;
+	char       buf[80];
+	tstruct = *localtime(&timestamp);
+	strftime(buf, sizeof(buf), "%X", &tstruct);
+	return buf;
+}
 
 #ifndef _WIN32
-	va_list args2;
-	va_copy(args2, args);
+static void def_log(int log_level, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	def_log_handler(log_level, format, args, nullptr);
+	va_end(args);
+}
 #endif
 
-	vsnprintf(str, 4095, msg, args);
-
+static void write_log_line(int log_level, time_t timestamp,
+		const char *str)
+{
 #ifdef _WIN32
 	OutputDebugStringA(str);
 	OutputDebugStringA("\n");
 #else
-	def_log_handler(log_level, msg, args2, nullptr);
+	def_log(log_level, "%s", str);
 #endif
 
 	if (log_level <= LOG_INFO)
-		logFile << CurrentTimeString() << ": " << str << endl;
+		*logWriterFile << TimeString(timestamp) << ": " << str << "\n";
+}
+
+static void log_writer_thread()
+{
+	LogRecord *record   = new LogRecord;
+	int       lastLevel = LOG_INFO;
+	uint64_t  repeatTs  = os_gettime_ns();
+	bool      exiting   = false;
+	char      str[128];
+
+	auto writeRepeats = [&]() {
+		long repeats = os_atomic_exchange_long(&logRepeats, 0);
+		if (repeats) {
+			snprintf(str, sizeof(str),
+					"Last message repeated %ld times",
+					repeats);
+			write_log_line(lastLevel, time(0), str);
+		}
+		repeatTs = os_gettime_ns();
+	};
+
+	while (!exiting) {
+		os_event_timedwait(logEvent, 1000);
+		exiting = os_atomic_load_long(&logExiting) != 0;
+
+		while (mpmc_queue_pop(logQueue, record)) {
+			writeRepeats();
+			write_log_line(record->log_level, record->time,
+					record->str);
+			lastLevel = record->log_level;
+		}
+
+		/* keep reporting a message that keeps repeating, at most once
+		 * a second */
+		if (exiting || os_gettime_ns() - repeatTs >= LOG_REPEAT_TIME_NS)
+			writeRepeats();
+
+		long dropped = os_atomic_exchange_long(&logDropped, 0);
+		if (dropped) {
+			snprintf(str, sizeof(str), "%ld log messages were "
+					"dropped, the log queue was full",
+					dropped);
+			write_log_line(LOG_WARNING, time(0), str);
+		}
+
+		logWriterFile->flush();
+	}
+
+	delete record;
+}
+
+static bool start_log_writer(fstream &logFile)
+{
+	logQueue = mpmc_queue_create(sizeof(LogRecord), LOG_QUEUE_SIZE);
+	if (!logQueue)
+		return false;
+
+	if (os_event_init(&logEvent, OS_EVENT_TYPE_AUTO) != 0) {
+		mpmc_queue_destroy(logQueue);
+		logQueue = nullptr;
+		return false;
+	}
+
+	logWriterFile = &logFile;
+	logThread     = thread(log_writer_thread);
+	return true;
+}
+
+/* writes everything still queued, messages logged after this are written
+ * directly on the calling thread */
+static void stop_log_writer()
+{
+	mpmc_queue_t *queue = logQueue;
+	if (!queue)
+		return;
+
+	os_atomic_set_long(&logExiting, 1);
+	os_event_signal(logEvent);
+	logThread.join();
+
+	logQueue = nullptr;
+	mpmc_queue_destroy(queue);
+	os_event_destroy(logEvent);
+	logEvent = nullptr;
+}
+
+static long log_hash(int log_level, const char *str)
+{
+	uint32_t hash = 2166136261U ^ (uint32_t)log_level;
+
+	while (*str) {
+		hash ^= (uint8_t)*(str++);
+		hash *= 16777619U;
+	}
+
+	return (long)hash;
+}
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	LogRecord record;
+
+	record.log_level = log_level;
+	record.time      = time(0);
+	vsnprintf(record.str, LOG_MAX_LENGTH - 1, msg, args);
+	record.str[LOG_MAX_LENGTH - 1] = 0;
+
+	/* only count repeats of the last queued message so a burst of the
+	 * same warning doesn't fill the queue */
+	long hash = log_hash(log_level, record.str);
+
+	if (logQueue && os_atomic_exchange_long(&logLastHash, hash) == hash) {
+		os_atomic_inc_long(&logRepeats);
+
+	} else if (!logQueue) {
+		write_log_line(log_level, record.time, record.str);
+		logWriterFile->flush();
+
+	} else if (mpmc_queue_push(logQueue, &record)) {
+		os_event_signal(logEvent);
+
+	} else {
+		os_atomic_inc_long(&logDropped);
+	}
 
 #ifdef _WIN32
 	if (log_level <= LOG_ERROR && IsDebuggerPresent())
 		__debugbreak();
 #endif
+
+	UNUSED_PARAMETER(param);
 }
 
 #define DEFAULT_LANG "en-US"
@@ -103,6 +271,8 @@ bool OBSApp::InitGlobalConfigDefaults()
 	config_set_default_string(globalConfig, "General", "Language",
 			DEFAULT_LANG);
 	config_set_default_uint(globalConfig, "General", "MaxLogs", 10);
+	config_set_default_bool(globalConfig, "BasicWindow", "PreviewEnabled",
+			true);
 
 #if _WIN32
 	config_set_default_string(globalConfig, "Video", "Renderer",
@@ -140,6 +310,10 @@ static bool MakeUserDirs()
 	if (!do_mkdir(path))
 		return false;
 
+	path = os_get_config_path("obs-studio/traces");
+	if (!do_mkdir(path))
+		return false;
+
 	return true;
 }
 
@@ -527,7 +701,11 @@ static void create_log_file(fstream &logFile)
 
 	if (logFile.is_open()) {
 		delete_oldest_log();
-		base_set_log_handler(do_log, &logFile);
+
+		if (start_log_writer(logFile))
+			base_set_log_handler(do_log, nullptr);
+		else
+			blog(LOG_ERROR, "Failed to start log writer");
 	} else {
 		blog(LOG_ERROR, "Failed to open log file");
 	}
@@ -567,10 +745,19 @@ int main(int argc, char *argv[])
 
 	base_get_log_handler(&def_log_handler, nullptr);
 
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--track-memory") == 0)
+			bmem_enable_tracking(true);
+	}
+
+	bmem_set_thread_tag(BMEM_TAG_UI);
+
 	fstream logFile;
 
 	int ret = run_program(logFile, argc, argv);
 
+	stop_log_writer();
+
 	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
 	base_set_log_handler(nullptr, nullptr);
 	return ret;
@@ -0,0 +1,97 @@
+#include "perf-graph.hpp"
+#include <util/c99defs.h>
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+
+#define MAX_SAMPLES 60
+
+PerfGraph::PerfGraph(const QString &name_, const QString &unit_,
+		int precision_, QWidget *parent)
+	: QWidget   (parent),
+	  name      (name_),
+	  unit      (unit_),
+	  precision (precision_),
+	  samples   (MAX_SAMPLES, 0.0)
+{
+	setFixedSize(120, 22);
+
+	bkColor.setRgb(0x20, 0x20, 0x20);
+	lineColor.setRgb(0x3E, 0xF1, 0x2B);
+	textColor.setRgb(0xDD, 0xDD, 0xDD);
+}
+
+void PerfGraph::AddSample(double value)
+{
+	samples[next] = value;
+	next = (next + 1) % MAX_SAMPLES;
+	if (count < MAX_SAMPLES)
+		count++;
+
+	setToolTip(QString("%1: %2%3 (max %4%3)").arg(name,
+			QString::number(value, 'f', precision), unit,
+			QString::number(MaxSample(), 'f', precision)));
+	update();
+}
+
+double PerfGraph::MaxSample() const
+{
+	double maxVal = 0.0;
+	for (int i = 0; i < count; i++)
+		maxVal = std::max(maxVal, Sample(i));
+	return maxVal;
+}
+
+void PerfGraph::Clear()
+{
+	next  = 0;
+	count = 0;
+	update();
+}
+
+void PerfGraph::paintEvent(QPaintEvent *event)
+{
+	UNUSED_PARAMETER(event);
+
+	QPainter painter(this);
+	int width  = size().width();
+	int height = size().height();
+
+	painter.fillRect(0, 0, width, height, bkColor);
+
+	if (!count)
+		return;
+
+	/* scale to the largest recent value so small changes stay visible */
+	double maxVal = MaxSample();
+	if (maxVal <= 0.0)
+		maxVal = 1.0;
+
+	double step = double(width - 1) / double(MAX_SAMPLES - 1);
+	double x    = double(width - 1) - step * double(count - 1);
+
+	QPainterPath path;
+	for (int i = 0; i < count; i++, x += step) {
+		double y = double(height - 2) -
+			Sample(i) / maxVal * double(height - 4);
+
+		if (i == 0)
+			path.moveTo(x, y);
+		else
+			path.lineTo(x, y);
+	}
+
+	painter.setPen(lineColor);
+	painter.drawPath(path);
+
+	QString last = QString::number(Sample(count - 1), 'f', precision);
+	QFont font = painter.font();
+	font.setPixelSize(height / 2);
+
+	painter.setFont(font);
+	painter.setPen(textColor);
+	painter.drawText(rect().adjusted(3, 0, -3, 0),
+			Qt::AlignLeft | Qt::AlignTop, name);
+	painter.drawText(rect().adjusted(3, 0, -3, 0),
+			Qt::AlignRight | Qt::AlignTop, last + unit);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QWidget>
+#include <QVector>
+#include <QString>
+#include <QColor>
+
+/* small sparkline of the most recent samples of one performance counter,
+ * with the name and latest value drawn over it */
+class PerfGraph : public QWidget {
+	Q_OBJECT
+
+private:
+	QString         name;
+	QString         unit;
+	int             precision;
+	QColor          bkColor, lineColor, textColor;
+
+	QVector<double> samples;
+	int             next  = 0;
+	int             count = 0;
+
+	inline double Sample(int i) const
+	{
+		int size = samples.size();
+		return samples[(next - count + i + size) % size];
+	}
+
+	double MaxSample() const;
+
+protected:
+	void paintEvent(QPaintEvent *event) override;
+
+public:
+	PerfGraph(const QString &name, const QString &unit, int precision,
+			QWidget *parent = nullptr);
+
+	void AddSample(double value);
+	void Clear();
+};
@@ -12,6 +12,7 @@
 #include <QFileDialog>
 #include <QColorDialog>
 #include <QPlainTextEdit>
+#include <QTimer>
 #include "qt-wrappers.hpp"
 #include "properties-view.hpp"
 #include "obs-app.hpp"
@@ -19,6 +20,11 @@
 
 using namespace std;
 
+/* controls like sliders change on every step of a drag, and updating an
+ * object can be expensive (reopening a device, for example), so changes are
+ * passed on at most once per interval */
+#define UPDATE_INTERVAL_MS 100
+
 static inline QColor color_from_int(long long val)
 {
 	return QColor( val        & 0xff,
@@ -95,10 +101,37 @@ OBSPropertiesView::OBSPropertiesView(OBSData settings_, void *obj_,
 	  minSize        (minSize_),
 	  lastWidget     (nullptr)
 {
+	updateTimer = new QTimer(this);
+	updateTimer->setSingleShot(true);
+	connect(updateTimer, SIGNAL(timeout()), this, SLOT(UpdateSettings()));
+
 	setFrameShape(QFrame::NoFrame);
 	ReloadProperties();
 }
 
+OBSPropertiesView::~OBSPropertiesView()
+{
+	ApplyPendingUpdate();
+}
+
+void OBSPropertiesView::ApplyPendingUpdate()
+{
+	if (updateTimer->isActive())
+		UpdateSettings();
+}
+
+void OBSPropertiesView::ScheduleUpdate()
+{
+	if (!updateTimer->isActive())
+		updateTimer->start(UPDATE_INTERVAL_MS);
+}
+
+void OBSPropertiesView::UpdateSettings()
+{
+	updateTimer->stop();
+	callback(obj, settings);
+}
+
 void OBSPropertiesView::resizeEvent(QResizeEvent *event)
 {
 	emit PropertiesResized();
@@ -693,7 +726,7 @@ void WidgetInfo::ControlChanged()
 			return;
 	}
 
-	view->callback(view->obj, view->settings);
+	view->ScheduleUpdate();
 	if (obs_property_modified(property, view->settings)) {
 		view->lastFocused = setting;
 		QMetaObject::invokeMethod(view, "RefreshProperties",
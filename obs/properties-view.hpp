@@ -8,6 +8,7 @@
 class QFormLayout;
 class OBSPropertiesView;
 class QLabel;
+class QTimer;
 
 typedef obs_properties_t *(*PropertiesReloadCallback)(void *obj);
 typedef void              (*PropertiesUpdateCallback)(void *obj,
@@ -65,6 +66,7 @@ private:
 	std::vector<std::unique_ptr<WidgetInfo>> children;
 	std::string                              lastFocused;
 	QWidget                                  *lastWidget;
+	QTimer                                   *updateTimer;
 
 	QWidget *NewWidget(obs_property_t *prop, QWidget *widget,
 			const char *signal);
@@ -81,11 +83,14 @@ private:
 
 	void AddProperty(obs_property_t *property, QFormLayout *layout);
 
+	void ScheduleUpdate();
+
 	void resizeEvent(QResizeEvent *event) override;
 
 public slots:
 	void ReloadProperties();
 	void RefreshProperties();
+	void UpdateSettings();
 
 signals:
 	void PropertiesResized();
@@ -95,4 +100,8 @@ public:
 			PropertiesReloadCallback reloadCallback,
 			PropertiesUpdateCallback callback,
 			int minSize = 0);
+	~OBSPropertiesView();
+
+	/* passes on a change that is still waiting for the update interval */
+	void ApplyPendingUpdate();
 };
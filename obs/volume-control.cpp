@@ -12,7 +12,10 @@
 
 using namespace std;
 
-#define UPDATE_INTERVAL_MS 50
+#define UPDATE_INTERVAL_MS 16
+#define RESET_TIMEOUT_NS   1000000000ULL
+
+QPointer<VolumeMeterTimer> VolumeMeter::sharedTimer;
 
 void VolControl::OBSVolumeChanged(void *data, calldata_t *calldata)
 {
@@ -29,10 +32,7 @@ void VolControl::OBSVolumeLevel(void *data, calldata_t *calldata)
 	float mag       = calldata_float(calldata, "magnitude");
 	float peakHold  = calldata_float(calldata, "peak");
 
-	QMetaObject::invokeMethod(volControl, "VolumeLevel",
-		Q_ARG(float, mag),
-		Q_ARG(float, peak),
-		Q_ARG(float, peakHold));
+	volControl->volMeter->setLevels(mag, peak, peakHold);
 }
 
 void VolControl::VolumeChanged()
@@ -40,21 +40,6 @@ void VolControl::VolumeChanged()
 	slider->setValue((int) (obs_fader_get_deflection(obs_fader) * 100.0f));
 }
 
-void VolControl::VolumeLevel(float mag, float peak, float peakHold)
-{
-	uint64_t curMeterTime = os_gettime_ns() / 1000000;
-
-	/*
-	   Add again peak averaging?
-	*/
-
-	/* only update after a certain amount of time */
-	if ((curMeterTime - lastMeterTime) > UPDATE_INTERVAL_MS) {
-		lastMeterTime = curMeterTime;
-		volMeter->setLevels(mag, peak, peakHold);
-	}
-}
-
 void VolControl::SliderChanged(int vol)
 {
 	obs_fader_set_deflection(obs_fader, float(vol) * 0.01f);
@@ -74,7 +59,6 @@ void VolControl::SetName(const QString &newName)
 
 VolControl::VolControl(OBSSource source_)
 	: source        (source_),
-	  lastMeterTime (0),
 	  levelTotal    (0.0f),
 	  levelCount    (0.0f),
 	  obs_fader     (obs_fader_create(OBS_FADER_CUBIC)),
@@ -142,7 +126,14 @@ VolControl::~VolControl()
 }
 
 VolumeMeter::VolumeMeter(QWidget *parent)
-			: QWidget(parent)
+			: QWidget        (parent),
+			  mag            (0.0f),
+			  peak           (0.0f),
+			  peakHold       (0.0f),
+			  curMag         (0.0f),
+			  curPeak        (0.0f),
+			  curPeakHold    (0.0f),
+			  lastUpdateTime (0)
 {
 	setMinimumSize(1, 3);
 
@@ -150,31 +141,78 @@ VolumeMeter::VolumeMeter(QWidget *parent)
 	magColor.setRgb(0x20, 0x7D, 0x17);
 	peakColor.setRgb(0x3E, 0xF1, 0x2B);
 	peakHoldColor.setRgb(0x00, 0x00, 0x00);
-	
-	resetTimer = new QTimer(this);
-	connect(resetTimer, SIGNAL(timeout()), this, SLOT(resetState()));
 
-	resetState();
+	updateTimer = sharedTimer;
+	if (!updateTimer) {
+		updateTimer = new VolumeMeterTimer;
+		sharedTimer = updateTimer;
+		updateTimer->start(UPDATE_INTERVAL_MS);
+	}
+
+	updateTimer->AddVolumeMeter(this);
 }
 
-void VolumeMeter::resetState(void)
+VolumeMeter::~VolumeMeter()
 {
-	setLevels(0.0f, 0.0f, 0.0f);
-	if (resetTimer->isActive())
-		resetTimer->stop();
+	if (!updateTimer)
+		return;
+
+	updateTimer->RemoveVolumeMeter(this);
+	if (updateTimer->volumeMeters.isEmpty())
+		delete updateTimer;
 }
 
 void VolumeMeter::setLevels(float nmag, float npeak, float npeakHold)
 {
+	curMag         = nmag;
+	curPeak        = npeak;
+	curPeakHold    = npeakHold;
+	lastUpdateTime = os_gettime_ns();
+}
+
+void VolumeMeter::UpdateLevels(uint64_t ts)
+{
+	uint64_t lastTime = lastUpdateTime;
+	float    nmag, npeak, npeakHold;
+
+	/* drop to zero when the source stops sending levels */
+	if (ts > lastTime && ts - lastTime > RESET_TIMEOUT_NS) {
+		nmag      = 0.0f;
+		npeak     = 0.0f;
+		npeakHold = 0.0f;
+	} else {
+		nmag      = curMag;
+		npeak     = curPeak;
+		npeakHold = curPeakHold;
+	}
+
+	if (nmag == mag && npeak == peak && npeakHold == peakHold)
+		return;
+
 	mag      = nmag;
 	peak     = npeak;
 	peakHold = npeakHold;
-
 	update();
+}
+
+void VolumeMeterTimer::AddVolumeMeter(VolumeMeter *meter)
+{
+	volumeMeters.push_back(meter);
+}
 
-	if (resetTimer->isActive())
-		resetTimer->stop();
-	resetTimer->start(1000);
+void VolumeMeterTimer::RemoveVolumeMeter(VolumeMeter *meter)
+{
+	volumeMeters.removeOne(meter);
+}
+
+void VolumeMeterTimer::timerEvent(QTimerEvent *event)
+{
+	uint64_t ts = os_gettime_ns();
+
+	for (VolumeMeter *meter : volumeMeters)
+		meter->UpdateLevels(ts);
+
+	UNUSED_PARAMETER(event);
 }
 
 void VolumeMeter::paintEvent(QPaintEvent *event)
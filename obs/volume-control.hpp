@@ -2,22 +2,54 @@
 
 #include <obs.hpp>
 #include <QWidget>
+#include <QTimer>
+#include <QList>
+#include <QPointer>
+#include <atomic>
 
+class VolumeMeterTimer;
+
+/* levels are stored by the audio thread and picked up by a timer shared
+ * between all meters, so a meter repaints at most once per timer tick no
+ * matter how often the levels are updated */
 class VolumeMeter : public QWidget
 {
 	Q_OBJECT
 private:
 	float mag, peak, peakHold;
 	QColor bkColor, magColor, peakColor, peakHoldColor;
-	QTimer *resetTimer;
-	
+
+	std::atomic<float>    curMag, curPeak, curPeakHold;
+	std::atomic<uint64_t> lastUpdateTime;
+
+	QPointer<VolumeMeterTimer> updateTimer;
+	static QPointer<VolumeMeterTimer> sharedTimer;
+
 public:
 	explicit VolumeMeter(QWidget *parent = 0);
+	~VolumeMeter();
+
+	/* safe to call from any thread */
 	void setLevels(float nmag, float npeak, float npeakHold);
+
+	void UpdateLevels(uint64_t ts);
 protected:
 	void paintEvent(QPaintEvent *event);
-private slots:
-	void resetState();
+};
+
+class VolumeMeterTimer : public QTimer {
+	Q_OBJECT
+
+public:
+	QList<VolumeMeter*> volumeMeters;
+
+	inline VolumeMeterTimer() : QTimer() {}
+
+	void AddVolumeMeter(VolumeMeter *meter);
+	void RemoveVolumeMeter(VolumeMeter *meter);
+
+protected:
+	virtual void timerEvent(QTimerEvent *event) override;
 };
 
 class QLabel;
@@ -32,7 +64,6 @@ private:
 	QLabel          *volLabel;
 	VolumeMeter     *volMeter;
 	QSlider         *slider;
-	uint64_t        lastMeterTime;
 	float           levelTotal;
 	float           levelCount;
 	obs_fader_t     *obs_fader;
@@ -43,7 +74,6 @@ private:
 
 private slots:
 	void VolumeChanged();
-	void VolumeLevel(float mag, float peak, float peakHold);
 	void SliderChanged(int vol);
 
 public:
@@ -51,6 +51,8 @@ OBSBasicInteraction::OBSBasicInteraction(QWidget *parent, OBSSource source_)
 	if (cx > 400 && cy > 400)
 		resize(cx, cy);
 
+	obs_source_inc_showing(source);
+
 	OBSData settings = obs_source_get_settings(source);
 	obs_data_release(settings);
 
@@ -69,6 +71,8 @@ OBSBasicInteraction::~OBSBasicInteraction()
 	// since QT fakes a mouse movement while destructing a widget
 	// remove our event filter
 	ui->preview->removeEventFilter(eventFilter.get());
+
+	obs_source_dec_showing(source);
 }
 
 OBSEventFilter *OBSBasicInteraction::BuildEventFilter()
@@ -174,6 +178,14 @@ void OBSBasicInteraction::timerEvent(QTimerEvent *event)
 	}
 }
 
+void OBSBasicInteraction::changeEvent(QEvent *event)
+{
+	if (display && IsDisplayIntervalEvent(event))
+		obs_display_set_interval(display, GetDisplayInterval(this));
+
+	QDialog::changeEvent(event);
+}
+
 void OBSBasicInteraction::closeEvent(QCloseEvent *event)
 {
 	QDialog::closeEvent(event);
@@ -70,6 +70,7 @@ protected:
 	virtual void resizeEvent(QResizeEvent *event) override;
 	virtual void timerEvent(QTimerEvent *event) override;
 	virtual void closeEvent(QCloseEvent *event) override;
+	virtual void changeEvent(QEvent *event) override;
 };
 
 typedef std::function<bool(QObject *, QEvent *)> EventFilterFunc;
@@ -111,12 +111,24 @@ OBSBasic::OBSBasic(QWidget *parent)
 			SLOT(SceneItemNameEdited(QWidget*,
 					QAbstractItemDelegate::EndEditHint)));
 
+	/* with uniform sizes, long lists don't need to measure every item,
+	 * and batched layout lays them out a chunk at a time */
+	ui->scenes->setUniformItemSizes(true);
+	ui->scenes->setLayoutMode(QListView::Batched);
+	ui->sources->setUniformItemSizes(true);
+	ui->sources->setLayoutMode(QListView::Batched);
+
 	cpuUsageInfo = os_cpu_usage_info_start();
 	cpuUsageTimer = new QTimer(this);
 	connect(cpuUsageTimer, SIGNAL(timeout()),
 			ui->statusbar, SLOT(UpdateCPUUsage()));
 	cpuUsageTimer->start(3000);
 
+	renderStatsTimer = new QTimer(this);
+	connect(renderStatsTimer, SIGNAL(timeout()),
+			this, SLOT(UpdateSourceRenderStats()));
+	renderStatsTimer->start(1000);
+
 	DeleteKeys =
 #ifdef __APPLE__
 		QList<QKeySequence>{{Qt::Key_Backspace}} <<
@@ -179,18 +191,73 @@ void OBSBasic::ClearVolumeControls()
 	volumes.clear();
 }
 
+static bool WriteSaveData(const char *file, const char *jsonData)
+{
+	/* TODO maybe a message box here? */
+	if (!os_safe_write_utf8_file(file, jsonData, strlen(jsonData), false)) {
+		blog(LOG_ERROR, "Could not save scene data to %s", file);
+		return false;
+	}
+
+	return true;
+}
+
 void OBSBasic::Save(const char *file)
 {
+	/* an autosave still being written must not finish after this */
+	if (autoSaveResult.valid())
+		autoSaveResult.get();
+
 	obs_data_t *saveData  = GenerateSaveData();
 	const char *jsonData = obs_data_get_json(saveData);
 
-	/* TODO maybe a message box here? */
-	if (!os_quick_write_utf8_file(file, jsonData, strlen(jsonData), false))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	if (WriteSaveData(file, jsonData))
+		lastSaveData = jsonData;
 
 	obs_data_release(saveData);
 }
 
+#define AUTOSAVE_INTERVAL_MS 60000
+
+/* source settings can only be read safely on the UI thread, so only a
+ * snapshot of the save data is taken here.  the background thread serializes
+ * the snapshot, and writes it out if it changed since the last save */
+void OBSBasic::AutoSave()
+{
+	if (!loaded)
+		return;
+
+	if (autoSaveResult.valid()) {
+		if (autoSaveResult.wait_for(chrono::seconds(0)) !=
+				future_status::ready)
+			return;
+		lastSaveData = autoSaveResult.get();
+	}
+
+	obs_data_t          *saveData = GenerateSaveData();
+	obs_data_snapshot_t *snapshot = obs_data_snapshot_create(saveData);
+	obs_data_release(saveData);
+
+	BPtr<char> path(os_get_config_path("obs-studio/basic/scenes.json"));
+	string     file(path);
+	string     lastData(lastSaveData);
+
+	autoSaveResult = async(launch::async,
+			[file, lastData, snapshot] () -> string
+	{
+		obs_data_t *data     = obs_data_snapshot_get_data(snapshot);
+		string      jsonData = obs_data_get_json(data);
+		obs_data_release(data);
+		obs_data_snapshot_destroy(snapshot);
+
+		if (jsonData == lastData)
+			return lastData;
+
+		return WriteSaveData(file.c_str(), jsonData.c_str()) ?
+			jsonData : string();
+	});
+}
+
 static void LoadAudioDevice(const char *name, int channel, obs_data_t *parent)
 {
 	obs_data_t *data = obs_data_get_obj(parent, name);
@@ -247,6 +314,9 @@ void OBSBasic::Load(const char *file)
 			"current_scene");
 	obs_source_t     *curScene;
 
+	obs_set_deferred_source_creation(config_get_bool(basicConfig,
+			"General", "DeferSourceCreation"));
+
 	LoadAudioDevice(DESKTOP_AUDIO_1, 1, data);
 	LoadAudioDevice(DESKTOP_AUDIO_2, 2, data);
 	LoadAudioDevice(AUX_AUDIO_1,     3, data);
@@ -326,13 +396,32 @@ void OBSBasic::SaveService()
 	obs_data_t *data     = obs_data_create();
 	obs_data_t *settings = obs_service_get_settings(service);
 
+	obs_data_array_t *extra = obs_data_array_create();
+
 	obs_data_set_string(data, "type", obs_service_gettype(service));
 	obs_data_set_obj(data, "settings", settings);
 
+	for (obs_service_t *extraService : extraServices) {
+		obs_data_t *item          = obs_data_create();
+		obs_data_t *extraSettings = obs_service_get_settings(
+				extraService);
+
+		obs_data_set_string(item, "type",
+				obs_service_gettype(extraService));
+		obs_data_set_obj(item, "settings", extraSettings);
+		obs_data_array_push_back(extra, item);
+
+		obs_data_release(extraSettings);
+		obs_data_release(item);
+	}
+
+	obs_data_set_array(data, "extra", extra);
+
 	const char *json = obs_data_get_json(data);
 
 	os_quick_write_utf8_file(serviceJsonPath, json, strlen(json), false);
 
+	obs_data_array_release(extra);
 	obs_data_release(settings);
 	obs_data_release(data);
 }
@@ -358,6 +447,25 @@ bool OBSBasic::LoadService()
 
 	service = obs_service_create(type, "default_service", settings);
 
+	obs_data_array_t *extra = obs_data_get_array(data, "extra");
+	size_t count = obs_data_array_count(extra);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(extra, i);
+		obs_data_t *extraSettings = obs_data_get_obj(item, "settings");
+
+		obs_data_set_default_string(item, "type", "rtmp_common");
+		obs_service_t *extraService = obs_service_create(
+				obs_data_get_string(item, "type"), nullptr,
+				extraSettings);
+		if (extraService)
+			extraServices.push_back(extraService);
+
+		obs_data_release(extraSettings);
+		obs_data_release(item);
+	}
+
+	obs_data_array_release(extra);
 	obs_data_release(settings);
 	obs_data_release(data);
 
@@ -395,11 +503,12 @@ bool OBSBasic::InitEncoders()
 	if (!x264)
 		return false;
 
-	aac = obs_audio_encoder_create("libfdk_aac", "default_aac", nullptr);
+	aac = obs_audio_encoder_create("libfdk_aac", "default_aac", nullptr,
+			0);
 
 	if (!aac)
 		aac = obs_audio_encoder_create("ffmpeg_aac", "default_aac",
-				nullptr);
+				nullptr, 0);
 
 	if (!aac)
 		return false;
@@ -457,6 +566,11 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool  (basicConfig, "SimpleOutput", "UseCBR", true);
 	config_set_default_string(basicConfig, "SimpleOutput", "Preset",
 			"veryfast");
+	config_set_default_bool  (basicConfig, "SimpleOutput", "WarmStandby",
+			false);
+
+	config_set_default_bool  (basicConfig, "General",
+			"DeferSourceCreation", false);
 
 	config_set_default_uint  (basicConfig, "Video", "BaseCX",   cx);
 	config_set_default_uint  (basicConfig, "Video", "BaseCY",   cy);
@@ -472,11 +586,14 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_uint  (basicConfig, "Video", "FPSNum", 30);
 	config_set_default_uint  (basicConfig, "Video", "FPSDen", 1);
 	config_set_default_string(basicConfig, "Video", "ScaleType", "bicubic");
+	config_set_default_uint  (basicConfig, "Video", "RenderBuffers", 2);
 
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 			"Stereo");
 	config_set_default_uint  (basicConfig, "Audio", "BufferingTime", 1000);
+	config_set_default_bool  (basicConfig, "Audio", "AdaptiveBuffering",
+			false);
 
 	config_set_default_string(basicConfig, "Audio", "DesktopDevice1",
 			hasDesktopAudio ? "default" : "disabled");
@@ -543,6 +660,20 @@ void OBSBasic::InitPrimitives()
 	obs_leave_graphics();
 }
 
+/* optional masks of the logical CPUs the pipeline threads may run on, e.g. to
+ * keep the audio thread on an isolated core (no UI, set in global.ini) */
+static void LoadThreadAffinity()
+{
+	config_t *config = App()->GlobalConfig();
+
+	os_set_thread_role_affinity(OS_THREAD_ROLE_AUDIO,
+			config_get_uint(config, "Advanced", "AudioAffinity"));
+	os_set_thread_role_affinity(OS_THREAD_ROLE_VIDEO,
+			config_get_uint(config, "Advanced", "VideoAffinity"));
+	os_set_thread_role_affinity(OS_THREAD_ROLE_ENCODER,
+			config_get_uint(config, "Advanced", "EncoderAffinity"));
+}
+
 void OBSBasic::OBSInit()
 {
 	BPtr<char> savePath(os_get_config_path("obs-studio/basic/scenes.json"));
@@ -555,6 +686,9 @@ void OBSBasic::OBSInit()
 		throw "Failed to initialize libobs";
 	if (!InitBasicConfig())
 		throw "Failed to load basic.ini";
+
+	LoadThreadAffinity();
+
 	if (!ResetAudio())
 		throw "Failed to initialize audio";
 
@@ -574,6 +708,9 @@ void OBSBasic::OBSInit()
 			throw "Failed to initialize video:  Unspecified error";
 	}
 
+	obs_set_displays_enabled(config_get_bool(App()->GlobalConfig(),
+				"BasicWindow", "PreviewEnabled"));
+
 	InitOBSCallbacks();
 
 	AddExtraModulePaths();
@@ -590,9 +727,14 @@ void OBSBasic::OBSInit()
 
 	Load(savePath);
 	ResetAudioDevices();
+	ResetEncoderStandby();
 
 	TimedCheckForUpdates();
 	loaded = true;
+
+	autoSaveTimer = new QTimer(this);
+	connect(autoSaveTimer, SIGNAL(timeout()), this, SLOT(AutoSave()));
+	autoSaveTimer->start(AUTOSAVE_INTERVAL_MS);
 }
 
 OBSBasic::~OBSBasic()
@@ -608,8 +750,12 @@ OBSBasic::~OBSBasic()
 	 * the Qt UI stuff, so we have to manually clear any references to
 	 * libobs. */
 	delete cpuUsageTimer;
+	delete renderStatsTimer;
+	delete autoSaveTimer;
 	os_cpu_usage_info_destroy(cpuUsageInfo);
 
+	StopExtraOutputs();
+
 	if (interaction)
 		delete interaction;
 
@@ -651,31 +797,54 @@ OBSSceneItem OBSBasic::GetCurrentSceneItem()
 	return GetSceneItem(ui->sources->currentItem());
 }
 
+static QListWidgetItem *CreateSourceListItem(obs_sceneitem_t *item)
+{
+	obs_source_t *source = obs_sceneitem_get_source(item);
+	const char   *name  = obs_source_get_name(source);
+
+	QListWidgetItem *listItem = new QListWidgetItem(QT_UTF8(name));
+	listItem->setData(Qt::UserRole,
+			QVariant::fromValue(OBSSceneItem(item)));
+	return listItem;
+}
+
+/* the list is filled in one go and the top item is only made current once
+ * at the end: making each item current as it's added would select it in the
+ * scene, which deselects every other item and queues a selection update for
+ * each of them */
 void OBSBasic::UpdateSources(OBSScene scene)
 {
-	ui->sources->clear();
+	vector<OBSSceneItem> items;
 
 	obs_scene_enum_items(scene,
 			[] (obs_scene_t *scene, obs_sceneitem_t *item, void *p)
 			{
-				OBSBasic *window = static_cast<OBSBasic*>(p);
-				window->InsertSceneItem(item);
+				using ItemList = vector<OBSSceneItem>;
+				ItemList *items = static_cast<ItemList*>(p);
+				items->emplace_back(item);
 
 				UNUSED_PARAMETER(scene);
 				return true;
-			}, this);
+			}, &items);
+
+	ui->sources->setUpdatesEnabled(false);
+	ui->sources->clear();
+
+	/* top of the list is the top of the scene */
+	for (auto it = items.rbegin(); it != items.rend(); ++it)
+		ui->sources->addItem(CreateSourceListItem(*it));
+
+	if (ui->sources->count())
+		ui->sources->setCurrentRow(0);
+
+	ui->sources->setUpdatesEnabled(true);
 }
 
 void OBSBasic::InsertSceneItem(obs_sceneitem_t *item)
 {
 	obs_source_t *source = obs_sceneitem_get_source(item);
-	const char   *name  = obs_source_get_name(source);
-
-	QListWidgetItem *listItem = new QListWidgetItem(QT_UTF8(name));
-	listItem->setData(Qt::UserRole,
-			QVariant::fromValue(OBSSceneItem(item)));
 
-	ui->sources->insertItem(0, listItem);
+	ui->sources->insertItem(0, CreateSourceListItem(item));
 	ui->sources->setCurrentRow(0);
 
 	/* if the source was just created, open properties dialog */
@@ -683,6 +852,32 @@ void OBSBasic::InsertSceneItem(obs_sceneitem_t *item)
 		CreatePropertiesWindow(source);
 }
 
+static inline double NsToMs(uint64_t ns)
+{
+	return double(ns) / 1000000.0;
+}
+
+void OBSBasic::UpdateSourceRenderStats()
+{
+	for (int i = 0; i < ui->sources->count(); i++) {
+		QListWidgetItem *listItem = ui->sources->item(i);
+		OBSSceneItem item = GetSceneItem(listItem);
+		obs_source_t *source = obs_sceneitem_get_source(item);
+		struct obs_source_render_stats stats;
+
+		obs_source_get_render_stats(source, &stats);
+
+		QString text = QTStr("Basic.Main.SourceRenderStats")
+			.arg(NsToMs(stats.render_ns), 0, 'f', 2)
+			.arg(NsToMs(stats.tick_ns), 0, 'f', 2);
+		if (stats.gpu_ns)
+			text += "\n" + QTStr("Basic.Main.SourceGPUStats")
+				.arg(NsToMs(stats.gpu_ns), 0, 'f', 2);
+
+		listItem->setToolTip(text);
+	}
+}
+
 void OBSBasic::CreateInteractionWindow(obs_source_t *source)
 {
 	if (interaction)
@@ -1230,7 +1425,7 @@ void OBSBasic::RenderMain(void *data, uint32_t cx, uint32_t cy)
 
 	window->DrawBackdrop(float(ovi.base_width), float(ovi.base_height));
 
-	obs_render_main_view();
+	obs_render_main_texture();
 	gs_load_vertexbuffer(nullptr);
 
 	/* --------------------------------------- */
@@ -1293,27 +1488,55 @@ void OBSBasic::SceneItemMoveBottom(void *data, calldata_t *params)
 
 /* Main class functions */
 
-obs_service_t *OBSBasic::GetService()
+obs_service_t *OBSBasic::GetService(size_t idx)
 {
+	if (idx > 0)
+		return idx <= extraServices.size() ?
+			extraServices[idx - 1] : nullptr;
+
 	if (!service)
 		service = obs_service_create("rtmp_common", NULL, NULL);
 	return service;
 }
 
-void OBSBasic::SetService(obs_service_t *newService)
+void OBSBasic::SetService(obs_service_t *newService, size_t idx)
 {
-	if (newService) {
-		if (service)
-			obs_service_destroy(service);
-		service = newService;
+	if (!newService)
+		return;
+
+	if (idx > 0) {
+		if (idx > extraServices.size())
+			return;
+
+		obs_service_destroy(extraServices[idx - 1]);
+		extraServices[idx - 1] = newService;
+		return;
 	}
+
+	if (service)
+		obs_service_destroy(service);
+	service = newService;
 }
 
-#ifdef _WIN32
-#define IS_WIN32 1
-#else
-#define IS_WIN32 0
-#endif
+size_t OBSBasic::AddService()
+{
+	obs_service_t *newService = obs_service_create("rtmp_common", NULL,
+			NULL);
+	if (!newService)
+		return 0;
+
+	extraServices.push_back(newService);
+	return extraServices.size();
+}
+
+void OBSBasic::RemoveService(size_t idx)
+{
+	if (idx == 0 || idx > extraServices.size() || StreamingActive())
+		return;
+
+	obs_service_destroy(extraServices[idx - 1]);
+	extraServices.erase(extraServices.begin() + (idx - 1));
+}
 
 static inline int AttemptToResetVideo(struct obs_video_info *ovi)
 {
@@ -1345,6 +1568,8 @@ static inline enum obs_scale_type GetScaleType(ConfigFile &basicConfig)
 		return OBS_SCALE_BILINEAR;
 	else if (astrcmpi(scaleTypeStr, "lanczos") == 0)
 		return OBS_SCALE_LANCZOS;
+	else if (astrcmpi(scaleTypeStr, "area") == 0)
+		return OBS_SCALE_AREA;
 	else
 		return OBS_SCALE_BICUBIC;
 }
@@ -1354,6 +1579,13 @@ int OBSBasic::ResetVideo()
 	struct obs_video_info ovi;
 	int ret;
 
+	/* encoders in standby keep the video active, ResetEncoderStandby
+	 * starts them again with the new video */
+	if (activeRefs == 0) {
+		obs_encoder_set_standby(x264, false);
+		obs_encoder_set_standby(aac, false);
+	}
+
 	GetConfigFPS(ovi.fps_num, ovi.fps_den);
 
 	ovi.graphics_module = App()->GetRenderModule();
@@ -1371,6 +1603,8 @@ int OBSBasic::ResetVideo()
 	ovi.adapter        = 0;
 	ovi.gpu_conversion = true;
 	ovi.scale_type     = GetScaleType(basicConfig);
+	ovi.num_textures   = (uint32_t)config_get_uint(basicConfig,
+			"Video", "RenderBuffers");
 
 	QTToGSWindow(ui->preview->winId(), ovi.window);
 
@@ -1382,8 +1616,8 @@ int OBSBasic::ResetVideo()
 	ovi.window_height = size.height();
 
 	ret = AttemptToResetVideo(&ovi);
-	if (IS_WIN32 && ret != OBS_VIDEO_SUCCESS) {
-		/* Try OpenGL if DirectX fails on windows */
+	if (ret != OBS_VIDEO_SUCCESS) {
+		/* Try OpenGL if any other renderer fails to load */
 		if (astrcmpi(ovi.graphics_module, "libobs-opengl") != 0) {
 			blog(LOG_WARNING, "Failed to initialize obs video (%d) "
 					  "with graphics_module='%s', retrying "
@@ -1419,6 +1653,8 @@ bool OBSBasic::ResetAudio()
 		ai.speakers = SPEAKERS_STEREO;
 
 	ai.buffer_ms = config_get_uint(basicConfig, "Audio", "BufferingTime");
+	ai.adaptive_buffering = config_get_bool(basicConfig, "Audio",
+			"AdaptiveBuffering");
 
 	return obs_reset_audio(&ai);
 }
@@ -1506,8 +1742,10 @@ void OBSBasic::closeEvent(QCloseEvent *event)
 
 void OBSBasic::changeEvent(QEvent *event)
 {
-	/* TODO */
-	UNUSED_PARAMETER(event);
+	if (IsDisplayIntervalEvent(event))
+		obs_set_main_display_interval(GetDisplayInterval(this));
+
+	OBSMainWindow::changeEvent(event);
 }
 
 void OBSBasic::resizeEvent(QResizeEvent *event)
@@ -1989,6 +2227,11 @@ void OBSBasic::on_actionUploadLastLog_triggered()
 	UploadLog(App()->GetLastLog());
 }
 
+void OBSBasic::on_actionLogMemoryUsage_triggered()
+{
+	bmem_log_usage();
+}
+
 void OBSBasic::on_actionCheckForUpdates_triggered()
 {
 	CheckForUpdates();
@@ -2093,6 +2336,86 @@ void OBSBasic::StreamingStart()
 	ui->statusbar->StreamStarted(streamOutput);
 }
 
+static void OBSStopExtraStream(void *data, calldata_t *params)
+{
+	obs_output_t *output = (obs_output_t*)calldata_ptr(params, "output");
+	int code = (int)calldata_int(params, "code");
+
+	if (code != OBS_OUTPUT_SUCCESS)
+		blog(LOG_WARNING, "Extra stream '%s' stopped with error %d",
+				obs_output_get_name(output), code);
+
+	UNUSED_PARAMETER(data);
+}
+
+/* udp:// destinations are sent as MPEG-TS instead of RTMP */
+static const char *GetStreamOutputType(obs_service_t *service)
+{
+	const char *url = obs_service_get_url(service);
+	return (url && astrcmpi_n(url, "udp://", 6) == 0) ?
+		"udp_output" : "rtmp_output";
+}
+
+/* every extra destination gets its own output, with its own send thread,
+ * queue and frame dropping.  they share the encoders of the main stream, so
+ * each one only costs network I/O.  the encoder bitrate is only adjusted
+ * for the main stream, a slow extra destination drops frames instead of
+ * lowering the quality for everyone */
+void OBSBasic::StartExtraOutputs()
+{
+	StopExtraOutputs();
+
+	bool reconnect = config_get_bool(basicConfig, "SimpleOutput",
+			"Reconnect");
+	int retryDelay = config_get_uint(basicConfig, "SimpleOutput",
+			"RetryDelay");
+	int maxRetries = config_get_uint(basicConfig, "SimpleOutput",
+			"MaxRetries");
+	if (!reconnect)
+		maxRetries = 0;
+
+	for (size_t i = 0; i < extraServices.size(); i++) {
+		string name = "extra_stream_" + to_string(i + 1);
+
+		obs_data_t *settings = obs_data_create();
+		obs_data_set_bool(settings, "dynamic_bitrate", false);
+
+		obs_output_t *output = obs_output_create(
+				GetStreamOutputType(extraServices[i]),
+				name.c_str(), settings);
+		obs_data_release(settings);
+
+		if (!output)
+			continue;
+
+		signal_handler_connect(obs_output_get_signal_handler(output),
+				"stop", OBSStopExtraStream, this);
+
+		obs_output_set_video_encoder(output, x264);
+		obs_output_set_audio_encoder(output, aac, 0);
+		obs_output_set_service(output, extraServices[i]);
+		obs_output_set_reconnect_settings(output, maxRetries,
+				retryDelay);
+
+		if (!obs_output_start(output))
+			blog(LOG_WARNING, "Failed to start extra stream '%s'",
+					name.c_str());
+
+		extraOutputs.push_back(output);
+	}
+}
+
+void OBSBasic::StopExtraOutputs()
+{
+	for (obs_output_t *output : extraOutputs) {
+		if (obs_output_active(output))
+			obs_output_stop(output);
+		obs_output_destroy(output);
+	}
+
+	extraOutputs.clear();
+}
+
 void OBSBasic::StreamingStop(int code)
 {
 	const char *errorMessage;
@@ -2121,7 +2444,12 @@ void OBSBasic::StreamingStop(int code)
 		errorMessage = Str("Output.ConnectFail.Disconnected");
 	}
 
+	StopExtraOutputs();
+
 	activeRefs--;
+	if (activeRefs == 0 && standbyOutdated)
+		ResetEncoderStandby();
+
 	ui->statusbar->StreamStopped();
 
 	ui->streamButton->setText(QTStr("Basic.Main.StartStreaming"));
@@ -2142,12 +2470,47 @@ void OBSBasic::RecordingStop()
 {
 	ui->statusbar->RecordingStopped();
 	activeRefs--;
+	if (activeRefs == 0 && standbyOutdated)
+		ResetEncoderStandby();
+
 	ui->recordButton->setText(QTStr("Basic.Main.StartRecording"));
 }
 
+/* (re)starts the encoders in standby with the current settings, so that
+ * streaming/recording start without the encoders' startup delay */
+void OBSBasic::ResetEncoderStandby()
+{
+	bool standby = config_get_bool(basicConfig, "SimpleOutput",
+			"WarmStandby");
+
+	/* the encoders can't be reconfigured while outputs use them */
+	if (activeRefs > 0) {
+		standbyOutdated = true;
+		return;
+	}
+
+	standbyOutdated = false;
+
+	obs_encoder_set_standby(x264, false);
+	obs_encoder_set_standby(aac, false);
+
+	if (!standby)
+		return;
+
+	SetupEncoders();
+
+	if (!obs_encoder_set_standby(x264, true) ||
+	    !obs_encoder_set_standby(aac, true)) {
+		blog(LOG_WARNING, "Failed to start encoders in standby");
+		obs_encoder_set_standby(x264, false);
+		obs_encoder_set_standby(aac, false);
+	}
+}
+
 void OBSBasic::SetupEncoders()
 {
-	if (activeRefs == 0) {
+	/* encoders in standby are already set up with the current settings */
+	if (activeRefs == 0 && !obs_encoder_standby(x264)) {
 		obs_data_t *x264Settings = obs_data_create();
 		obs_data_t *aacSettings  = obs_data_create();
 
@@ -2198,7 +2561,7 @@ void OBSBasic::on_streamButton_clicked()
 		SetupEncoders();
 
 		obs_output_set_video_encoder(streamOutput, x264);
-		obs_output_set_audio_encoder(streamOutput, aac);
+		obs_output_set_audio_encoder(streamOutput, aac, 0);
 		obs_output_set_service(streamOutput, service);
 
 		bool reconnect = config_get_bool(basicConfig, "SimpleOutput",
@@ -2215,6 +2578,7 @@ void OBSBasic::on_streamButton_clicked()
 
 		if (obs_output_start(streamOutput)) {
 			activeRefs++;
+			StartExtraOutputs();
 
 			ui->streamButton->setEnabled(false);
 			ui->streamButton->setText(
@@ -2255,7 +2619,7 @@ void OBSBasic::on_recordButton_clicked()
 		SetupEncoders();
 
 		obs_output_set_video_encoder(fileOutput, x264);
-		obs_output_set_audio_encoder(fileOutput, aac);
+		obs_output_set_audio_encoder(fileOutput, aac, 0);
 
 		obs_data_t *settings = obs_data_create();
 		obs_data_set_string(settings, "path", strPath.c_str());
@@ -24,6 +24,8 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <future>
+#include <string>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -65,6 +67,11 @@ private:
 	QNetworkAccessManager networkManager;
 
 	QPointer<QTimer>    cpuUsageTimer;
+	QPointer<QTimer>    renderStatsTimer;
+	QPointer<QTimer>    autoSaveTimer;
+
+	std::future<std::string> autoSaveResult;
+	std::string         lastSaveData;
 	os_cpu_usage_info_t *cpuUsageInfo = nullptr;
 
 	QBuffer       logUploadPostData;
@@ -78,6 +85,11 @@ private:
 	obs_output_t  *fileOutput = nullptr;
 	obs_output_t  *streamOutput = nullptr;
 	obs_service_t *service = nullptr;
+
+	/* extra stream destinations, sent from the same encoders as the main
+	 * stream.  the outputs only exist while streaming */
+	std::vector<obs_service_t*> extraServices;
+	std::vector<obs_output_t*>  extraOutputs;
 	obs_encoder_t *aac = nullptr;
 	obs_encoder_t *x264 = nullptr;
 
@@ -94,6 +106,7 @@ private:
 	ConfigFile    basicConfig;
 
 	int           activeRefs = 0;
+	bool          standbyOutdated = false;
 
 	void          DrawBackdrop(float cx, float cy);
 
@@ -111,6 +124,9 @@ private:
 	void          SaveService();
 	bool          LoadService();
 
+	void          StartExtraOutputs();
+	void          StopExtraOutputs();
+
 	bool          InitOutputs();
 	bool          InitEncoders();
 	bool          InitService();
@@ -164,12 +180,16 @@ private slots:
 	void SelectSceneItem(OBSScene scene, OBSSceneItem item, bool select);
 	void MoveSceneItem(OBSSceneItem item, obs_order_movement movement);
 
+	void AutoSave();
+
 	void ActivateAudioSource(OBSSource source);
 	void DeactivateAudioSource(OBSSource source);
 
 	void RemoveSelectedScene();
 	void RemoveSelectedSceneItem();
 
+	void UpdateSourceRenderStats();
+
 private:
 	/* OBS Callbacks */
 	static void SceneItemAdded(void *data, calldata_t *params);
@@ -198,8 +218,20 @@ private:
 public:
 	OBSScene      GetCurrentScene();
 
-	obs_service_t *GetService();
-	void          SetService(obs_service_t *service);
+	obs_service_t *GetService(size_t idx = 0);
+	void          SetService(obs_service_t *service, size_t idx = 0);
+	size_t        AddService();
+	void          RemoveService(size_t idx);
+
+	inline size_t GetServiceCount() const
+	{
+		return 1 + extraServices.size();
+	}
+
+	inline bool StreamingActive() const
+	{
+		return obs_output_active(streamOutput);
+	}
 
 	int  ResetVideo();
 	bool ResetAudio();
@@ -207,6 +239,7 @@ public:
 	void ResetAudioDevice(const char *sourceId, const char *deviceName,
 			const char *deviceDesc, int channel);
 	void ResetAudioDevices();
+	void ResetEncoderStandby();
 
 	void NewProject();
 	void SaveProject();
@@ -241,6 +274,7 @@ private slots:
 	void on_actionShowLogs_triggered();
 	void on_actionUploadCurrentLog_triggered();
 	void on_actionUploadLastLog_triggered();
+	void on_actionLogMemoryUsage_triggered();
 	void on_actionCheckForUpdates_triggered();
 
 	void on_actionEditTransform_triggered();
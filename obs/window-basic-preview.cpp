@@ -1,5 +1,6 @@
 #include <QGuiApplication>
 #include <QMouseEvent>
+#include <QMenu>
 
 #include <algorithm>
 #include <cmath>
@@ -100,24 +101,6 @@ static bool FindItemAtPos(obs_scene_t *scene, obs_sceneitem_t *item,
 	return true;
 }
 
-static vec3 GetTransformedPos(float x, float y, const matrix4 &mat)
-{
-	vec3 result;
-	vec3_set(&result, x, y, 0.0f);
-	vec3_transform(&result, &result, &mat);
-	return result;
-}
-
-static vec3 GetTransformedPosScaled(float x, float y, const matrix4 &mat,
-		float scale)
-{
-	vec3 result;
-	vec3_set(&result, x, y, 0.0f);
-	vec3_transform(&result, &result, &mat);
-	vec3_mulf(&result, &result, scale);
-	return result;
-}
-
 static inline vec2 GetOBSScreenSize()
 {
 	obs_video_info ovi;
@@ -166,7 +149,7 @@ OBSSceneItem OBSBasicPreview::GetItemAtPos(const vec2 &pos, bool selectBelow)
 		return OBSSceneItem();
 
 	SceneFindData data(pos, selectBelow);
-	obs_scene_enum_items(scene, FindItemAtPos, &data);
+	obs_scene_enum_items_in_area(scene, &pos, &pos, FindItemAtPos, &data);
 	return data.item;
 }
 
@@ -209,7 +192,8 @@ bool OBSBasicPreview::SelectedAtPos(const vec2 &pos)
 		return false;
 
 	SceneFindData data(pos, false);
-	obs_scene_enum_items(scene, CheckItemSelected, &data);
+	obs_scene_enum_items_in_area(scene, &pos, &pos, CheckItemSelected,
+			&data);
 	return !!data.item;
 }
 
@@ -242,33 +226,35 @@ static bool FindHandleAtPos(obs_scene_t *scene, obs_sceneitem_t *item,
 	vec3           pos3;
 	float          closestHandle = HANDLE_SEL_RADIUS;
 
+	static const ItemHandle handles[] = {
+		ItemHandle::TopLeft,    ItemHandle::TopCenter,
+		ItemHandle::TopRight,   ItemHandle::CenterLeft,
+		ItemHandle::CenterRight, ItemHandle::BottomLeft,
+		ItemHandle::BottomCenter, ItemHandle::BottomRight
+	};
+
+	vec3 handlePos[] = {
+		{{{0.0f, 0.0f, 0.0f}}}, {{{0.5f, 0.0f, 0.0f}}},
+		{{{1.0f, 0.0f, 0.0f}}}, {{{0.0f, 0.5f, 0.0f}}},
+		{{{1.0f, 0.5f, 0.0f}}}, {{{0.0f, 1.0f, 0.0f}}},
+		{{{0.5f, 1.0f, 0.0f}}}, {{{1.0f, 1.0f, 0.0f}}}
+	};
+
 	vec3_set(&pos3, data->pos.x, data->pos.y, 0.0f);
 
 	obs_sceneitem_get_box_transform(item, &transform);
+	vec3_transform_array(handlePos, handlePos, 8, &transform);
 
-	auto TestHandle = [&] (float x, float y, ItemHandle handle)
-	{
-		vec3 handlePos = GetTransformedPosScaled(x, y, transform,
-				data->scale);
-
-		float dist = vec3_dist(&handlePos, &pos3);
-		if (dist < HANDLE_SEL_RADIUS) {
-			if (dist < closestHandle) {
-				closestHandle = dist;
-				data->handle  = handle;
-				data->item    = item;
-			}
-		}
-	};
+	for (size_t i = 0; i < 8; i++) {
+		vec3_mulf(&handlePos[i], &handlePos[i], data->scale);
 
-	TestHandle(0.0f, 0.0f, ItemHandle::TopLeft);
-	TestHandle(0.5f, 0.0f, ItemHandle::TopCenter);
-	TestHandle(1.0f, 0.0f, ItemHandle::TopRight);
-	TestHandle(0.0f, 0.5f, ItemHandle::CenterLeft);
-	TestHandle(1.0f, 0.5f, ItemHandle::CenterRight);
-	TestHandle(0.0f, 1.0f, ItemHandle::BottomLeft);
-	TestHandle(0.5f, 1.0f, ItemHandle::BottomCenter);
-	TestHandle(1.0f, 1.0f, ItemHandle::BottomRight);
+		float dist = vec3_dist(&handlePos[i], &pos3);
+		if (dist < closestHandle) {
+			closestHandle = dist;
+			data->handle  = handles[i];
+			data->item    = item;
+		}
+	}
 
 	UNUSED_PARAMETER(scene);
 	return true;
@@ -301,8 +287,16 @@ void OBSBasicPreview::GetStretchHandleData(const vec2 &pos)
 	if (!scene)
 		return;
 
-	HandleFindData data(pos, main->previewScale / main->devicePixelRatio());
-	obs_scene_enum_items(scene, FindHandleAtPos, &data);
+	float scale = main->previewScale / main->devicePixelRatio();
+	vec2 scenePos, min, max;
+
+	/* only items with a box near the position can have a handle there */
+	vec2_divf(&scenePos, &pos, scale);
+	vec2_subf(&min, &scenePos, HANDLE_SEL_RADIUS / scale);
+	vec2_addf(&max, &scenePos, HANDLE_SEL_RADIUS / scale);
+
+	HandleFindData data(pos, scale);
+	obs_scene_enum_items_in_area(scene, &min, &max, FindHandleAtPos, &data);
 
 	stretchItem     = std::move(data.item);
 	stretchHandle   = data.handle;
@@ -333,6 +327,26 @@ void OBSBasicPreview::GetStretchHandleData(const vec2 &pos)
 	}
 }
 
+/* turning the preview off stops drawing every display, so the video thread
+ * only renders the outputs */
+void OBSBasicPreview::contextMenuEvent(QContextMenuEvent *event)
+{
+	QMenu popup(this);
+	QAction *action = popup.addAction(QTStr("Basic.Main.PreviewEnabled"));
+
+	action->setCheckable(true);
+	action->setChecked(obs_displays_enabled());
+
+	connect(action, &QAction::toggled, [] (bool enabled)
+	{
+		obs_set_displays_enabled(enabled);
+		config_set_bool(App()->GlobalConfig(), "BasicWindow",
+				"PreviewEnabled", enabled);
+	});
+
+	popup.exec(event->globalPos());
+}
+
 void OBSBasicPreview::mousePressEvent(QMouseEvent *event)
 {
 	OBSBasic *main = reinterpret_cast<OBSBasic*>(App()->GetMainWindow());
@@ -354,6 +368,7 @@ void OBSBasicPreview::mousePressEvent(QMouseEvent *event)
 
 	mouseOverItems = SelectedAtPos(startPos);
 	vec2_zero(&lastMoveOffset);
+	selectionBoundsValid = false;
 }
 
 static bool select_one(obs_scene_t *scene, obs_sceneitem_t *item, void *param)
@@ -427,12 +442,14 @@ static bool AddItemBounds(obs_scene_t *scene, obs_sceneitem_t *item,
 	obs_sceneitem_get_box_transform(item, &boxTransform);
 
 	vec3 t[4] = {
-		GetTransformedPos(0.0f, 0.0f, boxTransform),
-		GetTransformedPos(1.0f, 0.0f, boxTransform),
-		GetTransformedPos(0.0f, 1.0f, boxTransform),
-		GetTransformedPos(1.0f, 1.0f, boxTransform)
+		{{{0.0f, 0.0f, 0.0f}}},
+		{{{1.0f, 0.0f, 0.0f}}},
+		{{{0.0f, 1.0f, 0.0f}}},
+		{{{1.0f, 1.0f, 0.0f}}}
 	};
 
+	vec3_transform_array(t, t, 4, &boxTransform);
+
 	for (const vec3 &v : t) {
 		if (data->first) {
 			vec3_copy(&data->tl, &v);
@@ -450,18 +467,30 @@ static bool AddItemBounds(obs_scene_t *scene, obs_sceneitem_t *item,
 
 void OBSBasicPreview::SnapItemMovement(vec2 &offset)
 {
-	OBSBasic *main = reinterpret_cast<OBSBasic*>(App()->GetMainWindow());
-	OBSScene scene = main->GetCurrentScene();
+	/* the selected items only move by the offsets applied since the drag
+	 * started, so their bounds are only gathered once per drag */
+	if (!selectionBoundsValid) {
+		OBSBasic *main = reinterpret_cast<OBSBasic*>(
+				App()->GetMainWindow());
+		OBSScene scene = main->GetCurrentScene();
+
+		SelectedItemBounds data;
+		obs_scene_enum_items(scene, AddItemBounds, &data);
 
-	SelectedItemBounds data;
-	obs_scene_enum_items(scene, AddItemBounds, &data);
+		vec3_copy(&selectionTL, &data.tl);
+		vec3_copy(&selectionBR, &data.br);
+		selectionBoundsValid = true;
+	}
+
+	vec3 tl = selectionTL;
+	vec3 br = selectionBR;
 
-	data.tl.x += offset.x;
-	data.tl.y += offset.y;
-	data.br.x += offset.x;
-	data.br.y += offset.y;
+	tl.x += lastMoveOffset.x + offset.x;
+	tl.y += lastMoveOffset.y + offset.y;
+	br.x += lastMoveOffset.x + offset.x;
+	br.y += lastMoveOffset.y + offset.y;
 
-	vec3 snapOffset = GetScreenSnapOffset(data.tl, data.br);
+	vec3 snapOffset = GetScreenSnapOffset(tl, br);
 	offset.x += snapOffset.x;
 	offset.y += snapOffset.y;
 }
@@ -565,13 +594,21 @@ void OBSBasicPreview::ClampAspect(vec3 &tl, vec3 &br, vec2 &size,
 void OBSBasicPreview::SnapStretchingToScreen(vec3 &tl, vec3 &br)
 {
 	uint32_t stretchFlags = (uint32_t)stretchHandle;
-	vec3     newTL        = GetTransformedPos(tl.x, tl.y, itemToScreen);
-	vec3     newTR        = GetTransformedPos(br.x, tl.y, itemToScreen);
-	vec3     newBL        = GetTransformedPos(tl.x, br.y, itemToScreen);
-	vec3     newBR        = GetTransformedPos(br.x, br.y, itemToScreen);
+	vec3     corners[4];
 	vec3     boundingTL;
 	vec3     boundingBR;
 
+	vec3_set(&corners[0], tl.x, tl.y, 0.0f);
+	vec3_set(&corners[1], br.x, tl.y, 0.0f);
+	vec3_set(&corners[2], tl.x, br.y, 0.0f);
+	vec3_set(&corners[3], br.x, br.y, 0.0f);
+	vec3_transform_array(corners, corners, 4, &itemToScreen);
+
+	vec3 &newTL = corners[0];
+	vec3 &newTR = corners[1];
+	vec3 &newBL = corners[2];
+	vec3 &newBR = corners[3];
+
 	vec3_copy(&boundingTL, &newTL);
 	vec3_min(&boundingTL, &boundingTL, &newTR);
 	vec3_min(&boundingTL, &boundingTL, &newBL);
@@ -42,6 +42,10 @@ private:
 	bool         mouseMoved     = false;
 	bool         mouseOverItems = false;
 
+	bool         selectionBoundsValid = false;
+	vec3         selectionTL;
+	vec3         selectionBR;
+
 	static vec2 GetMouseEventPos(QMouseEvent *event);
 	static bool DrawSelectedItem(obs_scene_t *scene, obs_sceneitem_t *item,
 		void *param);
@@ -61,7 +65,7 @@ private:
 	vec3 CalculateStretchPos(const vec3 &tl, const vec3 &br);
 	void StretchItem(const vec2 &pos);
 
-	static void SnapItemMovement(vec2 &offset);
+	void SnapItemMovement(vec2 &offset);
 	void MoveItems(const vec2 &pos);
 
 	void ProcessClick(const vec2 &pos);
@@ -69,6 +73,7 @@ private:
 public:
 	OBSBasicPreview(QWidget *parent, Qt::WindowFlags flags = 0);
 
+	virtual void contextMenuEvent(QContextMenuEvent *event) override;
 	virtual void mousePressEvent(QMouseEvent *event) override;
 	virtual void mouseReleaseEvent(QMouseEvent *event) override;
 	virtual void mouseMoveEvent(QMouseEvent *event) override;
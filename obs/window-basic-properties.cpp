@@ -27,6 +27,8 @@
 
 using namespace std;
 
+#define PROPERTIES_PREVIEW_FPS 30
+
 OBSBasicProperties::OBSBasicProperties(QWidget *parent, OBSSource source_)
 	: QDialog                (parent),
 	  main                   (qobject_cast<OBSBasic*>(parent)),
@@ -52,6 +54,12 @@ OBSBasicProperties::OBSBasicProperties(QWidget *parent, OBSSource source_)
 	if (cx > 400 && cy > 400)
 		resize(cx, cy);
 
+	obs_source_instantiate(source);
+
+	/* the preview draws the source outside of any scene, so mark it as
+	 * shown or sources that suspend while hidden would stay blank */
+	obs_source_inc_showing(source);
+
 	OBSData settings = obs_source_get_settings(source);
 	obs_data_release(settings);
 
@@ -77,6 +85,11 @@ OBSBasicProperties::OBSBasicProperties(QWidget *parent, OBSSource source_)
 	setWindowTitle(QTStr("Basic.PropertiesWindow").arg(QT_UTF8(name)));
 }
 
+OBSBasicProperties::~OBSBasicProperties()
+{
+	obs_source_dec_showing(source);
+}
+
 void OBSBasicProperties::SourceRemoved(void *data, calldata_t *params)
 {
 	QMetaObject::invokeMethod(static_cast<OBSBasicProperties*>(data),
@@ -151,12 +164,23 @@ void OBSBasicProperties::timerEvent(QTimerEvent *event)
 	}
 }
 
+void OBSBasicProperties::changeEvent(QEvent *event)
+{
+	if (display && IsDisplayIntervalEvent(event))
+		obs_display_set_interval(display, GetDisplayInterval(this));
+
+	QDialog::changeEvent(event);
+}
+
 void OBSBasicProperties::closeEvent(QCloseEvent *event)
 {
 	QDialog::closeEvent(event);
 	if (!event->isAccepted())
 		return;
 
+	// the view is only destroyed after the source has been released
+	view->ApplyPendingUpdate();
+
 	// remove draw callback and release display in case our drawable
 	// surfaces go away before the destructor gets called
 	obs_display_remove_draw_callback(display,
@@ -183,7 +207,10 @@ void OBSBasicProperties::Init()
 
 	display = obs_display_create(&init_data);
 
-	if (display)
+	if (display) {
+		/* a preview of the settings doesn't need the full frame rate */
+		obs_display_set_fps(display, PROPERTIES_PREVIEW_FPS);
 		obs_display_add_draw_callback(display,
 				OBSBasicProperties::DrawPreview, this);
+	}
 }
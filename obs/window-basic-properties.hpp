@@ -51,6 +51,7 @@ private slots:
 
 public:
 	OBSBasicProperties(QWidget *parent, OBSSource source_);
+	~OBSBasicProperties();
 
 	void Init();
 
@@ -58,4 +59,5 @@ protected:
 	virtual void resizeEvent(QResizeEvent *event) override;
 	virtual void timerEvent(QTimerEvent *event) override;
 	virtual void closeEvent(QCloseEvent *event) override;
+	virtual void changeEvent(QEvent *event) override;
 };
@@ -131,7 +131,8 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	  videoChanged     (false),
 	  pageIndex        (0),
 	  loading          (true),
-	  streamProperties (nullptr)
+	  streamProperties (nullptr),
+	  streamIdx        (0)
 {
 	string path;
 
@@ -149,6 +150,7 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	HookWidget(ui->simpleOutUseCBR,      CHECK_CHANGED,  OUTPUTS_CHANGED);
 	HookWidget(ui->simpleOutPreset,      COMBO_CHANGED,  OUTPUTS_CHANGED);
 	HookWidget(ui->simpleOutCustomX264,  EDIT_CHANGED,   OUTPUTS_CHANGED);
+	HookWidget(ui->simpleOutWarmStandby, CHECK_CHANGED,  OUTPUTS_CHANGED);
 	HookWidget(ui->channelSetup,         COMBO_CHANGED,  AUDIO_RESTART);
 	HookWidget(ui->sampleRate,           COMBO_CHANGED,  AUDIO_RESTART);
 	HookWidget(ui->desktopAudioDevice1,  COMBO_CHANGED,  AUDIO_CHANGED);
@@ -171,6 +173,7 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	//Apply button disabled until change.
 	EnableApplyButton(false);
 
+	LoadStreamDestinations();
 	LoadServiceTypes();
 	LoadServiceInfo();
 	LoadSettings(false);
@@ -217,6 +220,30 @@ void OBSBasicSettings::SaveSpinBox(QSpinBox *widget, const char *section,
 		config_set_int(main->Config(), section, value, widget->value());
 }
 
+void OBSBasicSettings::LoadStreamDestinations()
+{
+	bool streaming = main->StreamingActive();
+	size_t count   = main->GetServiceCount();
+
+	ui->streamDestination->blockSignals(true);
+	ui->streamDestination->clear();
+
+	ui->streamDestination->addItem(
+			QTStr("Basic.Settings.Stream.Destination.Main"));
+	for (size_t i = 1; i < count; i++)
+		ui->streamDestination->addItem(
+				QTStr("Basic.Settings.Stream.Destination.Extra")
+				.arg((int)i));
+
+	if (streamIdx >= count)
+		streamIdx = count - 1;
+	ui->streamDestination->setCurrentIndex((int)streamIdx);
+	ui->streamDestination->blockSignals(false);
+
+	ui->addStreamDestination->setEnabled(!streaming);
+	ui->removeStreamDestination->setEnabled(!streaming && streamIdx > 0);
+}
+
 void OBSBasicSettings::LoadServiceTypes()
 {
 	const char    *type;
@@ -230,14 +257,14 @@ void OBSBasicSettings::LoadServiceTypes()
 		ui->streamType->addItem(qName, qType);
 	}
 
-	type = obs_service_gettype(main->GetService());
+	type = obs_service_gettype(main->GetService(streamIdx));
 	SetComboByValue(ui->streamType, type);
 }
 
 void OBSBasicSettings::LoadServiceInfo()
 {
 	QLayout          *layout    = ui->streamContainer->layout();
-	obs_service_t    *service    = main->GetService();
+	obs_service_t    *service    = main->GetService(streamIdx);
 	obs_data_t       *settings   = obs_service_get_settings(service);
 
 	delete streamProperties;
@@ -349,6 +376,9 @@ void OBSBasicSettings::LoadDownscaleFilters()
 	ui->downscaleFilter->addItem(
 			QTStr("Basic.Settings.Video.DownscaleFilter.Lanczos"),
 			QT_UTF8("lanczos"));
+	ui->downscaleFilter->addItem(
+			QTStr("Basic.Settings.Video.DownscaleFilter.Area"),
+			QT_UTF8("area"));
 
 	const char *scaleType = config_get_string(main->Config(),
 			"Video", "ScaleType");
@@ -357,6 +387,8 @@ void OBSBasicSettings::LoadDownscaleFilters()
 		ui->downscaleFilter->setCurrentIndex(0);
 	else if (astrcmpi(scaleType, "lanczos") == 0)
 		ui->downscaleFilter->setCurrentIndex(2);
+	else if (astrcmpi(scaleType, "area") == 0)
+		ui->downscaleFilter->setCurrentIndex(3);
 	else
 		ui->downscaleFilter->setCurrentIndex(1);
 }
@@ -465,6 +497,8 @@ void OBSBasicSettings::LoadSimpleOutputSettings()
 			"Preset");
 	const char *custom = config_get_string(main->Config(), "SimpleOutput",
 			"x264Settings");
+	bool warmStandby = config_get_bool(main->Config(), "SimpleOutput",
+			"WarmStandby");
 
 	ui->simpleOutputPath->setText(path);
 	ui->simpleOutputVBitrate->setValue(videoBitrate);
@@ -479,6 +513,7 @@ void OBSBasicSettings::LoadSimpleOutputSettings()
 	ui->simpleOutUseCBR->setChecked(useCBR);
 	ui->simpleOutPreset->setCurrentText(preset);
 	ui->simpleOutCustomX264->setText(custom);
+	ui->simpleOutWarmStandby->setChecked(warmStandby);
 }
 
 void OBSBasicSettings::LoadOutputSettings()
@@ -656,6 +691,7 @@ void OBSBasicSettings::SaveOutputSettings()
 	SaveCheckBox(ui->simpleOutUseCBR, "SimpleOutput", "UseCBR");
 	SaveCombo(ui->simpleOutPreset, "SimpleOutput", "Preset");
 	SaveEdit(ui->simpleOutCustomX264, "SimpleOutput", "x264Settings");
+	SaveCheckBox(ui->simpleOutWarmStandby, "SimpleOutput", "WarmStandby");
 }
 
 void OBSBasicSettings::SaveAudioSettings()
@@ -698,6 +734,8 @@ void OBSBasicSettings::SaveSettings()
 		SaveAudioSettings();
 	if (videoChanged)
 		SaveVideoSettings();
+	if (outputsChanged || videoChanged)
+		main->ResetEncoderStandby();
 
 	config_save(main->Config());
 	config_save(GetGlobalConfig());
@@ -757,6 +795,50 @@ void OBSBasicSettings::on_buttonBox_clicked(QAbstractButton *button)
 	}
 }
 
+void OBSBasicSettings::on_streamDestination_currentIndexChanged(int idx)
+{
+	if (loading || idx < 0)
+		return;
+
+	streamIdx = (size_t)idx;
+	ui->removeStreamDestination->setEnabled(
+			!main->StreamingActive() && streamIdx > 0);
+
+	/* only show the settings of the newly selected service, don't
+	 * replace it with a new one of the selected type */
+	ui->streamType->blockSignals(true);
+	SetComboByValue(ui->streamType,
+			obs_service_gettype(main->GetService(streamIdx)));
+	ui->streamType->blockSignals(false);
+
+	delete streamProperties;
+	streamProperties = nullptr;
+	LoadServiceInfo();
+}
+
+void OBSBasicSettings::on_addStreamDestination_clicked()
+{
+	size_t idx = main->AddService();
+	if (!idx)
+		return;
+
+	streamIdx = idx;
+	LoadStreamDestinations();
+	on_streamDestination_currentIndexChanged((int)idx);
+}
+
+void OBSBasicSettings::on_removeStreamDestination_clicked()
+{
+	if (streamIdx == 0)
+		return;
+
+	main->RemoveService(streamIdx);
+
+	streamIdx--;
+	LoadStreamDestinations();
+	on_streamDestination_currentIndexChanged((int)streamIdx);
+}
+
 void OBSBasicSettings::on_streamType_currentIndexChanged(int idx)
 {
 	QString val = ui->streamType->itemData(idx).toString();
@@ -770,7 +852,7 @@ void OBSBasicSettings::on_streamType_currentIndexChanged(int idx)
 
 	newService = obs_service_create(QT_TO_UTF8(val), nullptr, nullptr);
 	if (newService)
-		main->SetService(newService);
+		main->SetService(newService, streamIdx);
 
 	LoadServiceInfo();
 }
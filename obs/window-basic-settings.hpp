@@ -45,6 +45,7 @@ private:
 	bool loading;
 
 	OBSPropertiesView *streamProperties;
+	size_t            streamIdx;
 
 	void SaveCombo(QComboBox *widget, const char *section,
 			const char *value);
@@ -81,6 +82,7 @@ private:
 
 	bool QueryChanges();
 
+	void LoadStreamDestinations();
 	void LoadServiceTypes();
 	void LoadServiceInfo();
 
@@ -118,6 +120,9 @@ private slots:
 	void on_listWidget_itemSelectionChanged();
 	void on_buttonBox_clicked(QAbstractButton *button);
 
+	void on_streamDestination_currentIndexChanged(int idx);
+	void on_addStreamDestination_clicked();
+	void on_removeStreamDestination_clicked();
 	void on_streamType_currentIndexChanged(int idx);
 	void on_simpleOutputBrowse_clicked();
 
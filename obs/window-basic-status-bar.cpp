@@ -1,14 +1,31 @@
 #include <QLabel>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <util/profiler.h>
 #include "obs-app.hpp"
+#include "qt-wrappers.hpp"
+#include "perf-graph.hpp"
 #include "window-basic-main.hpp"
 #include "window-basic-status-bar.hpp"
 
+#define PERF_UPDATE_INTERVAL_MS 500
+
+/* while the performance panel is shown, a trace of the last few seconds is
+ * saved automatically when this many frames are late in one update */
+#define TRACE_WINDOW_NS          10000000000ULL
+#define AUTO_TRACE_LATE_FRAMES   5
+#define AUTO_TRACE_INTERVAL_NS   60000000000ULL
+
 OBSBasicStatusBar::OBSBasicStatusBar(QWidget *parent)
 	: QStatusBar    (parent),
 	  droppedFrames (new QLabel),
 	  sessionTime   (new QLabel),
 	  cpuUsage      (new QLabel),
-	  kbps          (new QLabel)
+	  kbps          (new QLabel),
+	  perfToggle    (new QPushButton(QTStr("Basic.StatusBar.Perf"))),
+	  perfPanel     (new QWidget),
+	  perfLayout    (new QHBoxLayout),
+	  perfTimer     (new QTimer(this))
 {
 	sessionTime->setText(QString("00:00:00"));
 	cpuUsage->setText(QString("CPU: 0.0%"));
@@ -27,6 +44,48 @@ OBSBasicStatusBar::OBSBasicStatusBar(QWidget *parent)
 	addPermanentWidget(sessionTime);
 	addPermanentWidget(cpuUsage);
 	addPermanentWidget(kbps);
+
+	frameGraph      = new PerfGraph(QTStr("Basic.StatusBar.Perf.Frame"),
+			"ms", 1);
+	gpuGraph        = new PerfGraph(QTStr("Basic.StatusBar.Perf.GPU"),
+			"ms", 1);
+	encodeGraph     = new PerfGraph(QTStr("Basic.StatusBar.Perf.Encode"),
+			"ms", 1);
+	lateFramesGraph = new PerfGraph(
+			QTStr("Basic.StatusBar.Perf.LateFrames"), "", 0);
+	audioGraph      = new PerfGraph(QTStr("Basic.StatusBar.Perf.Audio"),
+			"ms", 0);
+
+	perfLayout->setContentsMargins(0, 0, 0, 0);
+	perfLayout->setSpacing(2);
+	perfLayout->addWidget(frameGraph);
+	perfLayout->addWidget(gpuGraph);
+	perfLayout->addWidget(encodeGraph);
+	perfLayout->addWidget(lateFramesGraph);
+	perfLayout->addWidget(audioGraph);
+
+	traceButton = new QPushButton(QTStr("Basic.StatusBar.Perf.SaveTrace"));
+	traceButton->setFlat(true);
+	traceButton->setToolTip(
+			QTStr("Basic.StatusBar.Perf.SaveTrace.Tooltip"));
+	perfLayout->addWidget(traceButton);
+
+	perfPanel->setLayout(perfLayout);
+	perfPanel->setVisible(false);
+
+	perfToggle->setCheckable(true);
+	perfToggle->setFlat(true);
+	perfToggle->setToolTip(QTStr("Basic.StatusBar.Perf.Tooltip"));
+
+	addPermanentWidget(perfPanel);
+	addPermanentWidget(perfToggle);
+
+	connect(perfToggle, SIGNAL(toggled(bool)),
+			this, SLOT(TogglePerfPanel(bool)));
+	connect(perfTimer, SIGNAL(timeout()),
+			this, SLOT(UpdatePerfStats()));
+	connect(traceButton, SIGNAL(clicked()),
+			this, SLOT(SaveTrace()));
 }
 
 void OBSBasicStatusBar::IncRef()
@@ -127,6 +186,113 @@ void OBSBasicStatusBar::UpdateDroppedFrames()
 	droppedFrames->setMinimumWidth(droppedFrames->width());
 }
 
+static inline uint32_t frames_since(uint32_t total, uint32_t last)
+{
+	/* the counters start over when video is reset */
+	return total >= last ? total - last : total;
+}
+
+void OBSBasicStatusBar::UpdateQueueGraphs(const struct obs_perf_stats &stats)
+{
+	std::map<std::string, PerfGraph*> graphs;
+
+	for (size_t i = 0; i < stats.num_outputs; i++) {
+		const struct obs_perf_output_stats &output = stats.outputs[i];
+		if (!output.active)
+			continue;
+
+		auto it = queueGraphs.find(output.name);
+		PerfGraph *graph;
+
+		if (it != queueGraphs.end()) {
+			graph = it->second;
+			queueGraphs.erase(it);
+		} else {
+			graph = new PerfGraph(
+					QTStr("Basic.StatusBar.Perf.Queue")
+					.arg(QT_UTF8(output.name)), "", 0);
+			perfLayout->addWidget(graph);
+		}
+
+		graph->AddSample(double(output.queued_packets));
+		graphs[output.name] = graph;
+	}
+
+	/* whatever is left belongs to outputs that stopped */
+	for (auto &it : queueGraphs)
+		delete it.second;
+
+	queueGraphs.swap(graphs);
+}
+
+void OBSBasicStatusBar::UpdatePerfStats()
+{
+	struct obs_perf_stats stats;
+	obs_get_perf_stats(&stats);
+
+	uint32_t lateFrames =
+		frames_since(stats.skipped_frames, lastSkippedFrames) +
+		frames_since(stats.lagged_frames, lastLaggedFrames);
+
+	frameGraph->AddSample(double(stats.frame_ns) / 1000000.0);
+	gpuGraph->AddSample(double(stats.gpu_render_ns) / 1000000.0);
+	encodeGraph->AddSample(double(stats.encode_ns) / 1000000.0);
+	lateFramesGraph->AddSample(double(lateFrames));
+	audioGraph->AddSample(double(stats.audio_buffer_ms));
+
+	UpdateQueueGraphs(stats);
+
+	lastSkippedFrames = stats.skipped_frames;
+	lastLaggedFrames  = stats.lagged_frames;
+
+	uint64_t now = os_gettime_ns();
+	if (lateFrames >= AUTO_TRACE_LATE_FRAMES &&
+	    (!lastAutoTraceTime ||
+	     now - lastAutoTraceTime >= AUTO_TRACE_INTERVAL_NS)) {
+		blog(LOG_WARNING, "%u frames were late, saving a trace",
+				lateFrames);
+		SaveTrace();
+		lastAutoTraceTime = now;
+	}
+}
+
+void OBSBasicStatusBar::SaveTrace()
+{
+	std::string name = "obs-studio/traces/" +
+		GenerateTimeDateFilename("json");
+	BPtr<char> path(os_get_config_path(name.c_str()));
+
+	profiler_save_trace(path, TRACE_WINDOW_NS);
+}
+
+void OBSBasicStatusBar::TogglePerfPanel(bool show)
+{
+	perfPanel->setVisible(show);
+	profiler_enable_trace(show);
+
+	if (show) {
+		struct obs_perf_stats stats;
+		obs_get_perf_stats(&stats);
+
+		lastSkippedFrames = stats.skipped_frames;
+		lastLaggedFrames  = stats.lagged_frames;
+
+		frameGraph->Clear();
+		gpuGraph->Clear();
+		encodeGraph->Clear();
+		lateFramesGraph->Clear();
+		audioGraph->Clear();
+
+		perfTimer->start(PERF_UPDATE_INTERVAL_MS);
+	} else {
+		perfTimer->stop();
+
+		for (auto &it : queueGraphs)
+			delete it.second;
+		queueGraphs.clear();
+	}
+}
+
 void OBSBasicStatusBar::OBSOutputReconnect(void *data, calldata_t *params)
 {
 	OBSBasicStatusBar *statusBar =
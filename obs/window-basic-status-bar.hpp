@@ -5,8 +5,13 @@
 #include <QTimer>
 #include <util/platform.h>
 #include <obs.h>
+#include <map>
+#include <string>
 
 class QLabel;
+class QPushButton;
+class QHBoxLayout;
+class PerfGraph;
 
 class OBSBasicStatusBar : public QStatusBar {
 	Q_OBJECT
@@ -30,6 +35,22 @@ private:
 
 	QPointer<QTimer> refreshTimer;
 
+	QPushButton *perfToggle;
+	QWidget     *perfPanel;
+	QHBoxLayout *perfLayout;
+	QTimer      *perfTimer;
+	PerfGraph   *frameGraph;
+	PerfGraph   *gpuGraph;
+	PerfGraph   *encodeGraph;
+	PerfGraph   *lateFramesGraph;
+	PerfGraph   *audioGraph;
+	QPushButton *traceButton;
+	std::map<std::string, PerfGraph*> queueGraphs;
+
+	uint32_t lastSkippedFrames = 0;
+	uint32_t lastLaggedFrames  = 0;
+	uint64_t lastAutoTraceTime = 0;
+
 	void DecRef();
 	void IncRef();
 
@@ -38,6 +59,7 @@ private:
 	void UpdateBandwidth();
 	void UpdateSessionTime();
 	void UpdateDroppedFrames();
+	void UpdateQueueGraphs(const struct obs_perf_stats &stats);
 
 	static void OBSOutputReconnect(void *data, calldata_t *params);
 	static void OBSOutputReconnectSuccess(void *data, calldata_t *params);
@@ -47,6 +69,9 @@ private slots:
 	void ReconnectSuccess();
 	void UpdateStatusBar();
 	void UpdateCPUUsage();
+	void UpdatePerfStats();
+	void TogglePerfPanel(bool show);
+	void SaveTrace();
 
 public:
 	OBSBasicStatusBar(QWidget *parent);
@@ -26,7 +26,10 @@
 
 #include "qt-wrappers.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <cmath>
 
 using namespace std;
@@ -72,7 +75,7 @@ OBSRemux::OBSRemux(const char *path, QWidget *parent)
 
 bool OBSRemux::Stop()
 {
-	if (!worker->job)
+	if (worker->jobs.empty())
 		return true;
 
 	if (QMessageBox::critical(nullptr,
@@ -95,22 +98,40 @@ OBSRemux::~OBSRemux()
 	remuxer.wait();
 }
 
+static inline QString TargetFile(const QString &path)
+{
+	QFileInfo fi(path);
+	return fi.path() + "/" + fi.baseName() + ".mp4";
+}
+
+/* several recordings can be selected at once, separated by ';' */
+QStringList OBSRemux::SourceFiles() const
+{
+	return ui->sourceFile->text().split(';', QString::SkipEmptyParts);
+}
+
 void OBSRemux::BrowseInput()
 {
-	QString path = ui->sourceFile->text();
-	if (path.isEmpty())
-		path = recPath;
+	QStringList files = SourceFiles();
+	QString path = files.isEmpty() ? recPath : files.first();
 
-	path = QFileDialog::getOpenFileName(this,
+	files = QFileDialog::getOpenFileNames(this,
 			QTStr("Remux.SelectRecording"), path,
 			QTStr("Remux.RecordingPattern"));
 
-	inputChanged(path);
+	if (!files.isEmpty())
+		inputChanged(files.join(';'));
 }
 
 void OBSRemux::inputChanged(const QString &path)
 {
-	if (!QFileInfo::exists(path)) {
+	QStringList files = path.split(';', QString::SkipEmptyParts);
+	bool exists = !files.isEmpty();
+
+	for (const QString &file : files)
+		exists = exists && QFileInfo::exists(file);
+
+	if (!exists) {
 		ui->remux->setEnabled(false);
 		return;
 	}
@@ -118,12 +139,12 @@ void OBSRemux::inputChanged(const QString &path)
 	ui->sourceFile->setText(path);
 	ui->remux->setEnabled(true);
 
-	QFileInfo fi(path);
-	QString mp4 = fi.path() + "/" + fi.baseName() + ".mp4";
-	ui->targetFile->setText(mp4);
+	/* with more than one recording, each is remuxed next to itself */
+	bool single = files.size() == 1;
+	ui->targetFile->setText(single ? TargetFile(files.first()) : "");
 
-	ui->targetFile->setEnabled(true);
-	ui->browseTarget->setEnabled(true);
+	ui->targetFile->setEnabled(single);
+	ui->browseTarget->setEnabled(single);
 }
 
 void OBSRemux::BrowseOutput()
@@ -140,19 +161,44 @@ void OBSRemux::BrowseOutput()
 
 void OBSRemux::Remux()
 {
-	if (QFileInfo::exists(ui->targetFile->text()))
+	QStringList sources = SourceFiles();
+	QStringList targets;
+	bool exists = false;
+
+	if (sources.size() == 1)
+		targets << ui->targetFile->text();
+	else
+		for (const QString &source : sources)
+			targets << TargetFile(source);
+
+	for (const QString &target : targets)
+		exists = exists || QFileInfo::exists(target);
+
+	if (exists)
 		if (QMessageBox::question(this, QTStr("Remux.FileExistsTitle"),
 					QTStr("Remux.FileExists"),
 					QMessageBox::Yes | QMessageBox::No) !=
 				QMessageBox::Yes)
 			return;
 
-	media_remux_job_t mr_job = nullptr;
-	if (!media_remux_job_create(&mr_job, QT_TO_UTF8(ui->sourceFile->text()),
-				QT_TO_UTF8(ui->targetFile->text())))
+	worker->jobs.clear();
+	worker->sizes.clear();
+
+	for (int i = 0; i < sources.size(); i++) {
+		media_remux_job_t mr_job = nullptr;
+		if (!media_remux_job_create(&mr_job,
+					QT_TO_UTF8(sources[i]),
+					QT_TO_UTF8(targets[i])))
+			continue;
+
+		worker->jobs.emplace_back(mr_job, media_remux_job_destroy);
+		worker->sizes.push_back(QFileInfo(sources[i]).size());
+	}
+
+	if (worker->jobs.empty())
 		return;
 
-	worker->job = job_t(mr_job, media_remux_job_destroy);
+	worker->progress.assign(worker->jobs.size(), 0.f);
 	worker->lastProgress = 0.f;
 
 	ui->progressBar->setVisible(true);
@@ -188,7 +234,7 @@ void OBSRemux::remuxFinished(bool success)
 			success ?
 			QTStr("Remux.Finished") : QTStr("Remux.FinishedError"));
 
-	worker->job.reset();
+	worker->jobs.clear();
 	ui->progressBar->setVisible(false);
 	ui->remux->setEnabled(true);
 }
@@ -203,8 +249,20 @@ RemuxWorker::~RemuxWorker()
 	os_event_destroy(stop);
 }
 
-void RemuxWorker::UpdateProgress(float percent)
+void RemuxWorker::UpdateProgress(size_t idx, float percent)
 {
+	lock_guard<mutex> lock(progressMutex);
+
+	double total = 0.0, done = 0.0;
+
+	progress[idx] = percent;
+	for (size_t i = 0; i < progress.size(); i++) {
+		total += (double)sizes[i];
+		done  += (double)sizes[i] * progress[i];
+	}
+
+	percent = total > 0.0 ? (float)(done / total) : percent;
+
 	if (abs(lastProgress - percent) < 0.1f)
 		return;
 
@@ -212,16 +270,46 @@ void RemuxWorker::UpdateProgress(float percent)
 	lastProgress = percent;
 }
 
+struct RemuxProgress {
+	RemuxWorker *worker;
+	size_t      idx;
+};
+
 void RemuxWorker::remux()
 {
 	auto callback = [](void *data, float percent)
 	{
-		auto rw = static_cast<RemuxWorker*>(data);
-		rw->UpdateProgress(percent);
-		return !!os_event_try(rw->stop);
+		auto rp = static_cast<RemuxProgress*>(data);
+		rp->worker->UpdateProgress(rp->idx, percent);
+		return !!os_event_try(rp->worker->stop);
+	};
+
+	/* each job already reads and writes on separate threads */
+	size_t numThreads = max(1, QThread::idealThreadCount() / 2);
+	numThreads = min(numThreads, jobs.size());
+
+	atomic<size_t> nextJob(0);
+	atomic<bool> success(true);
+
+	auto run = [&]()
+	{
+		size_t idx;
+		while ((idx = nextJob++) < jobs.size()) {
+			RemuxProgress rp = {this, idx};
+			if (!media_remux_job_process(jobs[idx].get(),
+						callback, &rp))
+				success = false;
+		}
 	};
 
-	bool success = media_remux_job_process(job.get(), callback, this);
+	vector<thread> threads;
+	for (size_t i = 1; i < numThreads; i++)
+		threads.emplace_back(run);
+
+	run();
+
+	for (thread &t : threads)
+		t.join();
 
 	emit remuxFinished(os_event_try(stop) && success);
 }
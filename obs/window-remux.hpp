@@ -20,6 +20,8 @@
 #include <QPointer>
 #include <QThread>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "ui_OBSRemux.h"
 
 #include <media-io/media-remux.h>
@@ -37,6 +39,8 @@ class OBSRemux : public QDialog {
 
 	const char *recPath;
 
+	QStringList SourceFiles() const;
+
 	void BrowseInput();
 	void BrowseOutput();
 	void Remux();
@@ -66,11 +70,15 @@ signals:
 class RemuxWorker : public QObject {
 	Q_OBJECT
 
-	OBSRemux::job_t job;
+	/* jobs are run concurrently, progress is weighted by input size */
+	std::vector<OBSRemux::job_t> jobs;
+	std::vector<int64_t> sizes;
+	std::vector<float> progress;
+	std::mutex progressMutex;
 	os_event_t *stop;
 
 	float lastProgress;
-	void UpdateProgress(float percent);
+	void UpdateProgress(size_t idx, float percent);
 
 	explicit RemuxWorker();
 	virtual ~RemuxWorker();
@@ -1,15 +1,181 @@
 #include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
 
 #define warn(format, ...) \
 	blog(LOG_WARNING, "[image_source: '%s'] " format, \
 			obs_source_get_name(context->source), ##__VA_ARGS__)
 
-struct image_source {
-	obs_source_t *source;
+/* frames without a usable delay are shown for 100ms, like browsers do */
+#define MIN_FRAME_DURATION_NS     20000000ULL
+#define DEFAULT_FRAME_DURATION_NS 100000000ULL
 
-	gs_texture_t *tex;
+/*
+ * Decoded images are shared by every image source that shows the same file,
+ * as long as the file hasn't been modified since.  Entries are reference
+ * counted and destroyed along with their textures when the last source stops
+ * using them, so the textures must be released in the graphics context.
+ *
+ * Every frame of an animated image is uploaded once, so playing it back is
+ * only a matter of picking the texture to draw.
+ */
+struct image_cache_entry {
+	char         *path;
+	int64_t      mod_time;
+	gs_texture_t **textures;
+	uint64_t     *durations_ns;
+	size_t       num_frames;
 	uint32_t     cx;
 	uint32_t     cy;
+	long         refs;
+};
+
+static void image_cache_entry_free(struct image_cache_entry *entry)
+{
+	for (size_t i = 0; i < entry->num_frames; i++)
+		gs_texture_destroy(entry->textures[i]);
+
+	bfree(entry->textures);
+	bfree(entry->durations_ns);
+	bfree(entry->path);
+	bfree(entry);
+}
+
+static struct image_cache_entry *image_cache_entry_create(const char *path,
+		int64_t mod_time, const struct gs_image_frames *frames)
+{
+	struct image_cache_entry *entry = bzalloc(sizeof(*entry));
+
+	entry->textures     = bzalloc(sizeof(gs_texture_t*) *
+			frames->num_frames);
+	entry->durations_ns = bzalloc(sizeof(uint64_t) * frames->num_frames);
+
+	for (size_t i = 0; i < frames->num_frames; i++) {
+		const uint8_t *pixels = frames->data[i];
+		uint64_t duration = frames->durations_ns[i];
+
+		entry->textures[i] = gs_texture_create(frames->cx, frames->cy,
+				frames->format, 1, &pixels, 0);
+		if (!entry->textures[i])
+			break;
+
+		if (duration < MIN_FRAME_DURATION_NS)
+			duration = DEFAULT_FRAME_DURATION_NS;
+
+		entry->durations_ns[i] = duration;
+		entry->num_frames++;
+	}
+
+	if (!entry->num_frames) {
+		image_cache_entry_free(entry);
+		return NULL;
+	}
+
+	entry->path     = bstrdup(path);
+	entry->mod_time = mod_time;
+	entry->cx       = frames->cx;
+	entry->cy       = frames->cy;
+	entry->refs     = 1;
+	return entry;
+}
+
+static pthread_mutex_t image_cache_mutex;
+static DARRAY(struct image_cache_entry*) image_cache;
+
+/* must be called with image_cache_mutex locked */
+static struct image_cache_entry *image_cache_find(const char *path,
+		int64_t mod_time)
+{
+	for (size_t i = 0; i < image_cache.num; i++) {
+		struct image_cache_entry *entry = image_cache.array[i];
+
+		if (entry->mod_time == mod_time &&
+		    strcmp(entry->path, path) == 0) {
+			entry->refs++;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static struct image_cache_entry *image_cache_acquire(const char *path,
+		int64_t mod_time)
+{
+	struct image_cache_entry *entry;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	entry = image_cache_find(path, mod_time);
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	return entry;
+}
+
+/* uploads the frames unless another source already did, needs graphics */
+static struct image_cache_entry *image_cache_add(const char *path,
+		int64_t mod_time, const struct gs_image_frames *frames)
+{
+	struct image_cache_entry *entry;
+
+	pthread_mutex_lock(&image_cache_mutex);
+
+	entry = image_cache_find(path, mod_time);
+	if (!entry) {
+		entry = image_cache_entry_create(path, mod_time, frames);
+		if (entry)
+			da_push_back(image_cache, &entry);
+	}
+
+	pthread_mutex_unlock(&image_cache_mutex);
+	return entry;
+}
+
+/* needs graphics */
+static void image_cache_release(struct image_cache_entry *entry)
+{
+	bool destroy;
+
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	destroy = --entry->refs == 0;
+	if (destroy)
+		da_erase_item(image_cache, &entry);
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	if (destroy)
+		image_cache_entry_free(entry);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Images are decoded on a loader thread so that large files don't hold the
+ * graphics context.  The result, either a cache entry or the decoded pixels,
+ * is handed over to the next tick, which swaps it in.
+ */
+struct image_source {
+	obs_source_t *source;
+
+	struct image_cache_entry *image;
+	size_t       cur_frame;
+	uint64_t     frame_time_ns;
+	bool         changed;
+
+	pthread_t    loader;
+	bool         loader_active;
+	struct dstr  file;
+
+	/* written by the loader thread, taken by the tick */
+	pthread_mutex_t          mutex;
+	volatile long            pending;
+	struct image_cache_entry *pending_image;
+	char                     *pending_file;
+	int64_t                  pending_mod_time;
+	struct gs_image_frames   pending_frames;
 };
 
 static const char *image_source_get_name(void)
@@ -17,39 +183,159 @@ static const char *image_source_get_name(void)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_update(void *data, obs_data_t *settings)
+static void *image_source_load_thread(void *data)
 {
 	struct image_source *context = data;
-	const char *file = obs_data_get_string(settings, "file");
+	struct image_cache_entry *image = NULL;
+	struct gs_image_frames frames = {0};
+	int64_t mod_time = -1;
 
-	obs_enter_graphics();
+	if (!dstr_is_empty(&context->file)) {
+		const char *file = context->file.array;
 
-	if (context->tex) {
-		gs_texture_destroy(context->tex);
-		context->tex = NULL;
-	}
+		mod_time = os_get_file_mod_time(file);
+		image = image_cache_acquire(file, mod_time);
 
-	if (file && *file) {
-		context->tex = gs_texture_create_from_file(file);
-		if (context->tex) {
-			context->cx = gs_texture_get_width(context->tex);
-			context->cy = gs_texture_get_height(context->tex);
-		} else {
+		if (!image && !gs_image_frames_init(&frames, file))
 			warn("failed to load texture '%s'", file);
-			context->cx = 0;
-			context->cy = 0;
-		}
 	}
 
+	pthread_mutex_lock(&context->mutex);
+	context->pending_image    = image;
+	context->pending_file     = frames.num_frames ?
+		bstrdup(context->file.array) : NULL;
+	context->pending_mod_time = mod_time;
+	context->pending_frames   = frames;
+	os_atomic_set_long(&context->pending, 1);
+	pthread_mutex_unlock(&context->mutex);
+
+	return NULL;
+}
+
+static void stop_loader(struct image_source *context)
+{
+	if (context->loader_active) {
+		pthread_join(context->loader, NULL);
+		context->loader_active = false;
+	}
+}
+
+/* drops a loaded image that the tick never got to, needs graphics if there
+ * is a pending cache entry */
+static void free_pending_image(struct image_source *context)
+{
+	image_cache_release(context->pending_image);
+	bfree(context->pending_file);
+	gs_image_frames_free(&context->pending_frames);
+
+	context->pending_image = NULL;
+	context->pending_file  = NULL;
+	os_atomic_set_long(&context->pending, 0);
+}
+
+static void image_source_update(void *data, obs_data_t *settings,
+		obs_data_t *changed)
+{
+	struct image_source *context = data;
+	const char *file = obs_data_get_string(settings, "file");
+
+	/* don't decode the same file again for unrelated setting changes */
+	if (changed && !obs_data_get_bool(changed, "file"))
+		return;
+
+	stop_loader(context);
+
+	if (context->pending_image) {
+		obs_enter_graphics();
+		free_pending_image(context);
+		obs_leave_graphics();
+	} else {
+		free_pending_image(context);
+	}
+
+	dstr_copy(&context->file, file);
+
+	if (pthread_create(&context->loader, NULL, image_source_load_thread,
+				context) == 0)
+		context->loader_active = true;
+	else
+		image_source_load_thread(context);
+}
+
+static void swap_in_pending_image(struct image_source *context)
+{
+	struct image_cache_entry *image;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&context->mutex);
+
+	image = context->pending_image;
+	if (!image && context->pending_frames.num_frames)
+		image = image_cache_add(context->pending_file,
+				context->pending_mod_time,
+				&context->pending_frames);
+
+	image_cache_release(context->image);
+	context->image         = image;
+	context->cur_frame     = 0;
+	context->frame_time_ns = 0;
+
+	bfree(context->pending_file);
+	gs_image_frames_free(&context->pending_frames);
+	context->pending_image = NULL;
+	context->pending_file  = NULL;
+	os_atomic_set_long(&context->pending, 0);
+
+	pthread_mutex_unlock(&context->mutex);
 	obs_leave_graphics();
 }
 
+static bool advance_frames(struct image_source *context, float seconds)
+{
+	struct image_cache_entry *image = context->image;
+	size_t start_frame = context->cur_frame;
+
+	if (!image || image->num_frames < 2)
+		return false;
+
+	context->frame_time_ns += (uint64_t)((double)seconds * 1000000000.0);
+
+	while (context->frame_time_ns >=
+			image->durations_ns[context->cur_frame]) {
+		context->frame_time_ns -=
+			image->durations_ns[context->cur_frame];
+		context->cur_frame = (context->cur_frame + 1) %
+			image->num_frames;
+	}
+
+	return context->cur_frame != start_frame;
+}
+
+static void image_source_tick(void *data, float seconds)
+{
+	struct image_source *context = data;
+
+	context->changed = false;
+
+	if (os_atomic_load_long(&context->pending)) {
+		swap_in_pending_image(context);
+		context->changed = true;
+	} else if (advance_frames(context, seconds)) {
+		context->changed = true;
+	}
+}
+
 static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct image_source *context = bzalloc(sizeof(struct image_source));
 	context->source = source;
 
-	image_source_update(context, settings);
+	if (pthread_mutex_init(&context->mutex, NULL) != 0) {
+		bfree(context);
+		return NULL;
+	}
+
+	image_source_update(context, settings, NULL);
 	return context;
 }
 
@@ -57,35 +343,52 @@ static void image_source_destroy(void *data)
 {
 	struct image_source *context = data;
 
+	stop_loader(context);
+
 	obs_enter_graphics();
-	gs_texture_destroy(context->tex);
+	free_pending_image(context);
+	image_cache_release(context->image);
 	obs_leave_graphics();
 
+	dstr_free(&context->file);
+	pthread_mutex_destroy(&context->mutex);
 	bfree(context);
 }
 
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->cx;
+	return context->image ? context->image->cx : 0;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->cy;
+	return context->image ? context->image->cy : 0;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
-	if (!context->tex)
+	struct image_cache_entry *image = context->image;
+	gs_texture_t *tex;
+	if (!image)
 		return;
 
+	tex = image->textures[context->cur_frame];
+
 	gs_reset_blend_state();
 	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			context->tex);
-	gs_draw_sprite(context->tex, 0, context->cx, context->cy);
+			tex);
+	gs_draw_sprite(tex, 0, image->cx, image->cy);
+}
+
+/* the image only changes when a newly loaded image was swapped in, or when
+ * an animation moved on to the next frame */
+static bool image_source_unchanged(void *data)
+{
+	struct image_source *context = data;
+	return !context->changed;
 }
 
 static const char *image_filter =
@@ -110,17 +413,19 @@ static obs_properties_t *image_source_properties(void *unused)
 }
 
 static struct obs_source_info image_source_info = {
-	.id             = "image_source",
-	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO,
-	.get_name       = image_source_get_name,
-	.create         = image_source_create,
-	.destroy        = image_source_destroy,
-	.update         = image_source_update,
-	.get_width      = image_source_getwidth,
-	.get_height     = image_source_getheight,
-	.video_render   = image_source_render,
-	.get_properties = image_source_properties
+	.id              = "image_source",
+	.type            = OBS_SOURCE_TYPE_INPUT,
+	.output_flags    = OBS_SOURCE_VIDEO,
+	.get_name        = image_source_get_name,
+	.create          = image_source_create,
+	.destroy         = image_source_destroy,
+	.update_diff     = image_source_update,
+	.get_width       = image_source_getwidth,
+	.get_height      = image_source_getheight,
+	.video_tick      = image_source_tick,
+	.video_render    = image_source_render,
+	.get_properties  = image_source_properties,
+	.video_unchanged = image_source_unchanged
 };
 
 OBS_DECLARE_MODULE()
@@ -128,6 +433,15 @@ OBS_MODULE_USE_DEFAULT_LOCALE("image-source", "en-US")
 
 bool obs_module_load(void)
 {
+	if (pthread_mutex_init(&image_cache_mutex, NULL) != 0)
+		return false;
+
 	obs_register_source(&image_source_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	da_free(image_cache);
+	pthread_mutex_destroy(&image_cache_mutex);
+}
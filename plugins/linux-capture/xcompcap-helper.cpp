@@ -168,6 +168,7 @@ namespace XCompcap
 	}
 
 	static std::unordered_set<Window> changedWindows;
+	static std::unordered_set<Window> remappedWindows;
 	static pthread_mutex_t changeLock = PTHREAD_MUTEX_INITIALIZER;
 	void processEvents()
 	{
@@ -183,8 +184,10 @@ namespace XCompcap
 			if (ev.type == ConfigureNotify)
 				changedWindows.insert(ev.xconfigure.event);
 
-			if (ev.type == MapNotify)
+			if (ev.type == MapNotify) {
 				changedWindows.insert(ev.xmap.event);
+				remappedWindows.insert(ev.xmap.event);
+			}
 
 			if (ev.type == DestroyNotify)
 				changedWindows.insert(ev.xdestroywindow.event);
@@ -207,6 +210,20 @@ namespace XCompcap
 		return false;
 	}
 
+	bool windowWasRemapped(Window win)
+	{
+		PLock lock(&changeLock);
+
+		auto it = remappedWindows.find(win);
+
+		if (it != remappedWindows.end()) {
+			remappedWindows.erase(it);
+			return true;
+		}
+
+		return false;
+	}
+
 }
 
 
@@ -72,4 +72,5 @@ namespace XCompcap
 
 	void processEvents();
 	bool windowWasReconfigured(Window win);
+	bool windowWasRemapped(Window win);
 }
@@ -17,6 +17,10 @@
 #define xdisp (XCompcap::disp())
 #define WIN_STRING_DIV "\r\n"
 
+/* the output texture is over-allocated to this granularity so that most
+ * window resizes can reuse it */
+#define TEX_ALIGN 256
+
 bool XCompcapMain::init()
 {
 	if (!xdisp) {
@@ -115,7 +119,9 @@ struct XCompcapMain_private
 		,width(0),height(0)
 		,pixmap(0)
 		,glxpixmap(0)
+		,fbconfig(0)
 		,tex(0)
+		,tex_width(0), tex_height(0)
 		,gltex(0)
 	{
 		pthread_mutexattr_init(&lockattr);
@@ -148,9 +154,13 @@ struct XCompcapMain_private
 
 	Pixmap pixmap;
 	GLXPixmap glxpixmap;
+	GLXFBConfig fbconfig;
 	gs_texture_t *tex;
+	uint32_t tex_width, tex_height;
 	gs_texture_t *gltex;
 
+	bool rebind = false;
+
 	pthread_mutex_t lock;
 	pthread_mutexattr_t lockattr;
 
@@ -231,7 +241,7 @@ static Window getWindowFromString(std::string wstr)
 	return matchedNameWin;
 }
 
-static void xcc_cleanup(XCompcapMain_private *p)
+static void xcc_release_pixmap(XCompcapMain_private *p)
 {
 	if (p->gltex) {
 		gs_texture_destroy(p->gltex);
@@ -247,6 +257,11 @@ static void xcc_cleanup(XCompcapMain_private *p)
 		XFreePixmap(xdisp, p->pixmap);
 		p->pixmap = 0;
 	}
+}
+
+static void xcc_cleanup(XCompcapMain_private *p)
+{
+	xcc_release_pixmap(p);
 
 	if (p->win) {
 		XCompositeUnredirectWindow(xdisp, p->win,
@@ -256,51 +271,117 @@ static void xcc_cleanup(XCompcapMain_private *p)
 	}
 }
 
-void XCompcapMain::updateSettings(obs_data_t *settings)
+static inline uint32_t xcc_align_size(uint32_t size)
 {
-	PLock lock(&p->lock);
-	XErrorLock xlock;
-	ObsGsContextHolder obsctx;
+	return (size + TEX_ALIGN - 1) & ~(uint32_t)(TEX_ALIGN - 1);
+}
 
-	blog(LOG_DEBUG, "Settings updating");
+/**
+ * Makes sure the output texture can hold the current size.  The texture is
+ * only recreated if it is too small or more than twice as large as needed.
+ */
+static void xcc_alloc_texture(XCompcapMain_private *p, uint32_t cx,
+		uint32_t cy)
+{
+	if (!cx) cx = 1;
+	if (!cy) cy = 1;
 
-	Window prevWin = p->win;
+	if (p->tex &&
+	    cx <= p->tex_width  && xcc_align_size(cx * 2) >= p->tex_width &&
+	    cy <= p->tex_height && xcc_align_size(cy * 2) >= p->tex_height)
+		return;
 
-	xcc_cleanup(p);
+	if (p->tex)
+		gs_texture_destroy(p->tex);
 
-	if (settings) {
-		const char *windowName = obs_data_get_string(settings,
-				"capture_window");
+	p->tex_width  = xcc_align_size(cx);
+	p->tex_height = xcc_align_size(cy);
 
-		p->win = getWindowFromString(windowName);
+	uint32_t size = p->tex_width * p->tex_height * 4;
+	uint8_t *texData = new uint8_t[size];
 
-		p->cut_top = obs_data_get_int(settings, "cut_top");
-		p->cut_left = obs_data_get_int(settings, "cut_left");
-		p->cut_right = obs_data_get_int(settings, "cut_right");
-		p->cut_bot = obs_data_get_int(settings, "cut_bot");
-		p->lockX = obs_data_get_bool(settings, "lock_x");
-		p->swapRedBlue = obs_data_get_bool(settings, "swap_redblue");
-		p->show_cursor = obs_data_get_bool(settings, "show_cursor");
-		p->include_border = obs_data_get_bool(settings, "include_border");
-	} else {
-		p->win = prevWin;
+	for (unsigned int i = 0; i < size; i += 4) {
+		texData[i + 0] = p->swapRedBlue ? 0 : 0xFF;
+		texData[i + 1] = 0;
+		texData[i + 2] = p->swapRedBlue ? 0xFF : 0;
+		texData[i + 3] = 0xFF;
+	}
+
+	const uint8_t* texDataArr[] = { texData, 0 };
+
+	p->tex = gs_texture_create(p->tex_width, p->tex_height, GS_RGBA, 1,
+			texDataArr, 0);
+
+	delete[] texData;
+
+	if (p->swapRedBlue) {
+		GLuint tex = *(GLuint*)gs_texture_get_obj(p->tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
+}
+
+/**
+ * Binds the current pixmap of the window to a new texture
+ */
+static bool xcc_bind_pixmap(XCompcapMain_private *p, XErrorLock &xlock)
+{
+	xcc_release_pixmap(p);
 
 	xlock.resetError();
 
-	XCompositeRedirectWindow(xdisp, p->win, CompositeRedirectAutomatic);
+	p->pixmap = XCompositeNameWindowPixmap(xdisp, p->win);
 
 	if (xlock.gotError()) {
-		blog(LOG_ERROR, "XCompositeRedirectWindow failed: %s",
+		blog(LOG_ERROR, "XCompositeNameWindowPixmap failed: %s",
 				xlock.getErrorText().c_str());
-		return;
+		p->pixmap = 0;
+		return false;
 	}
 
-	XSelectInput(xdisp, p->win, StructureNotifyMask);
-	XSync(xdisp, 0);
+	const int attribs[] =
+	{
+		GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+		GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGBA_EXT,
+		None
+	};
+
+	p->glxpixmap = glXCreatePixmap(xdisp, p->fbconfig, p->pixmap, attribs);
 
+	if (xlock.gotError()) {
+		blog(LOG_ERROR, "glXCreatePixmap failed: %s",
+				xlock.getErrorText().c_str());
+		XFreePixmap(xdisp, p->pixmap);
+		p->pixmap = 0;
+		p->glxpixmap = 0;
+		return false;
+	}
+
+	p->gltex = gs_texture_create(p->width, p->height, GS_RGBA, 1, 0,
+			GS_GL_DUMMYTEX);
+
+	GLuint gltex = *(GLuint*)gs_texture_get_obj(p->gltex);
+	glBindTexture(GL_TEXTURE_2D, gltex);
+	glXBindTexImageEXT(xdisp, p->glxpixmap, GLX_FRONT_LEFT_EXT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+/**
+ * Updates the capture after the window was configured.  Moving the window
+ * only updates the cursor offset, the pixmap is only rebound when the size of
+ * the window changed.
+ */
+static void xcc_update_geometry(XCompcapMain_private *p, XErrorLock &xlock,
+		bool force)
+{
 	XWindowAttributes attr;
 	if (!XGetWindowAttributes(xdisp, p->win, &attr)) {
+		xcc_release_pixmap(p);
 		p->win = 0;
 		p->width = 0;
 		p->height = 0;
@@ -316,18 +397,25 @@ void XCompcapMain::updateSettings(obs_data_t *settings)
 		xcursor_offset(p->cursor, x, y);
 	}
 
-	gs_color_format cf = GS_RGBA;
-
-	p->border = attr.border_width;
+	uint32_t border = attr.border_width;
+	uint32_t width, height;
 
 	if (p->include_border) {
-		p->width = attr.width + p->border * 2;
-		p->height = attr.height + p->border * 2;
+		width = attr.width + border * 2;
+		height = attr.height + border * 2;
 	} else {
-		p->width = attr.width;
-		p->height = attr.height;
+		width = attr.width;
+		height = attr.height;
 	}
 
+	if (!force && p->gltex && width == p->width && height == p->height &&
+	    border == p->border)
+		return;
+
+	p->border = border;
+	p->width = width;
+	p->height = height;
+
 	if (p->cut_top + p->cut_bot < (int)p->height) {
 		p->cur_cut_top = p->cut_top;
 		p->cur_cut_bot = p->cut_bot;
@@ -344,31 +432,68 @@ void XCompcapMain::updateSettings(obs_data_t *settings)
 		p->cur_cut_right = 0;
 	}
 
-	if (p->tex)
-		gs_texture_destroy(p->tex);
+	xcc_alloc_texture(p, p->width - p->cur_cut_left - p->cur_cut_right,
+			p->height - p->cur_cut_top - p->cur_cut_bot);
+	xcc_bind_pixmap(p, xlock);
+}
 
-	uint8_t *texData = new uint8_t[width() * height() * 4];
+void XCompcapMain::updateSettings(obs_data_t *settings)
+{
+	PLock lock(&p->lock);
+	XErrorLock xlock;
+	ObsGsContextHolder obsctx;
 
-	for (unsigned int i = 0; i < width() * height() * 4; i += 4) {
-		texData[i + 0] = p->swapRedBlue ? 0 : 0xFF;
-		texData[i + 1] = 0;
-		texData[i + 2] = p->swapRedBlue ? 0xFF : 0;
-		texData[i + 3] = 0xFF;
+	blog(LOG_DEBUG, "Settings updating");
+
+	Window prevWin = p->win;
+
+	xcc_cleanup(p);
+
+	if (settings) {
+		const char *windowName = obs_data_get_string(settings,
+				"capture_window");
+
+		p->win = getWindowFromString(windowName);
+
+		p->cut_top = obs_data_get_int(settings, "cut_top");
+		p->cut_left = obs_data_get_int(settings, "cut_left");
+		p->cut_right = obs_data_get_int(settings, "cut_right");
+		p->cut_bot = obs_data_get_int(settings, "cut_bot");
+		p->lockX = obs_data_get_bool(settings, "lock_x");
+		p->swapRedBlue = obs_data_get_bool(settings, "swap_redblue");
+		p->show_cursor = obs_data_get_bool(settings, "show_cursor");
+		p->include_border = obs_data_get_bool(settings, "include_border");
+	} else {
+		p->win = prevWin;
 	}
 
-	const uint8_t* texDataArr[] = { texData, 0 };
+	/* the swizzle of the output texture depends on the settings */
+	if (p->tex) {
+		gs_texture_destroy(p->tex);
+		p->tex = 0;
+	}
 
-	p->tex = gs_texture_create(width(), height(), cf, 1,
-			texDataArr, 0);
+	p->rebind = false;
 
-	delete[] texData;
+	xlock.resetError();
 
-	if (p->swapRedBlue) {
-		GLuint tex = *(GLuint*)gs_texture_get_obj(p->tex);
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	XCompositeRedirectWindow(xdisp, p->win, CompositeRedirectAutomatic);
+
+	if (xlock.gotError()) {
+		blog(LOG_ERROR, "XCompositeRedirectWindow failed: %s",
+				xlock.getErrorText().c_str());
+		return;
+	}
+
+	XSelectInput(xdisp, p->win, StructureNotifyMask);
+	XSync(xdisp, 0);
+
+	XWindowAttributes attr;
+	if (!XGetWindowAttributes(xdisp, p->win, &attr)) {
+		p->win = 0;
+		p->width = 0;
+		p->height = 0;
+		return;
 	}
 
 	const int attrs[] =
@@ -393,50 +518,13 @@ void XCompcapMain::updateSettings(obs_data_t *settings)
 		return;
 	}
 
-	glXGetFBConfigAttrib(xdisp, configs[0], GLX_Y_INVERTED_EXT, &nelem);
-	p->inverted = nelem != 0;
-
-	xlock.resetError();
-
-	p->pixmap = XCompositeNameWindowPixmap(xdisp, p->win);
-
-	if (xlock.gotError()) {
-		blog(LOG_ERROR, "XCompositeNameWindowPixmap failed: %s",
-				xlock.getErrorText().c_str());
-		p->pixmap = 0;
-		XFree(configs);
-		return;
-	}
-
-	const int attribs[] =
-	{
-		GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
-		GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGBA_EXT,
-		None
-	};
-
-	p->glxpixmap = glXCreatePixmap(xdisp, configs[0], p->pixmap, attribs);
-
-	if (xlock.gotError()) {
-		blog(LOG_ERROR, "glXCreatePixmap failed: %s",
-				xlock.getErrorText().c_str());
-		XFreePixmap(xdisp, p->pixmap);
-		XFree(configs);
-		p->pixmap = 0;
-		p->glxpixmap = 0;
-		return;
-	}
-
+	p->fbconfig = configs[0];
 	XFree(configs);
 
-	p->gltex = gs_texture_create(p->width, p->height, cf, 1, 0,
-			GS_GL_DUMMYTEX);
+	glXGetFBConfigAttrib(xdisp, p->fbconfig, GLX_Y_INVERTED_EXT, &nelem);
+	p->inverted = nelem != 0;
 
-	GLuint gltex = *(GLuint*)gs_texture_get_obj(p->gltex);
-	glBindTexture(GL_TEXTURE_2D, gltex);
-	glXBindTexImageEXT(xdisp, p->glxpixmap, GLX_FRONT_LEFT_EXT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	xcc_update_geometry(p, xlock, true);
 }
 
 void XCompcapMain::tick(float seconds)
@@ -450,14 +538,31 @@ void XCompcapMain::tick(float seconds)
 
 	XCompcap::processEvents();
 
+	/* configure events come in bursts while a window is being resized,
+	 * they are coalesced and handled once per tick */
 	if (XCompcap::windowWasReconfigured(p->win))
-		updateSettings(0);
+		p->rebind = true;
+
+	/* a mapped window gets a new pixmap even if its size is unchanged */
+	bool remapped = XCompcap::windowWasRemapped(p->win);
 
-	if (!p->tex || !p->gltex)
+	if (!p->win)
 		return;
 
 	obs_enter_graphics();
 
+	if (p->rebind || remapped) {
+		XErrorLock xlock;
+
+		p->rebind = false;
+		xcc_update_geometry(p, xlock, remapped);
+	}
+
+	if (!p->tex || !p->gltex) {
+		obs_leave_graphics();
+		return;
+	}
+
 	if (p->lockX) {
 		XLockDisplay(xdisp);
 		XSync(xdisp, 0);
@@ -506,7 +611,7 @@ void XCompcapMain::render(gs_effect_t *effect)
 	gs_effect_set_texture(image, p->tex);
 
 	gs_enable_blending(false);
-	gs_draw_sprite(p->tex, 0, 0, 0);
+	gs_draw_sprite_subregion(p->tex, 0, 0, 0, width(), height());
 
 	if (p->cursor && p->gltex && p->show_cursor && !p->cursor_outside)
 		xcursor_render(p->cursor);
@@ -39,62 +39,177 @@ static uint32_t *xcursor_pixels(XFixesCursorImage *xc) {
 }
 
 /*
- * Create the cursor texture, either by updating if the new cursor has the same
- * size or by creating a new texture if the size is different
+ * Find the cached texture of a cursor image
  */
-static void xcursor_create(xcursor_t *data, XFixesCursorImage *xc) {
-	uint32_t *pixels = xcursor_pixels(xc);
+static xcursor_cache_t *xcursor_find(xcursor_t *data, unsigned long serial) {
+	for (size_t i = 0; i < XCURSOR_CACHE_SIZE; ++i) {
+		xcursor_cache_t *entry = &data->cache[i];
+		if (entry->tex && entry->serial == serial)
+			return entry;
+	}
 
-	if (data->tex
-	&& data->last_height == xc->width
-	&& data->last_width == xc->height) {
-		gs_texture_set_image(data->tex, (const uint8_t *) pixels,
-			xc->width * sizeof(uint32_t), False);
-	} else {
-		if (data->tex)
-			gs_texture_destroy(data->tex);
+	return NULL;
+}
+
+/*
+ * Create the texture for a new cursor image, replacing the least recently
+ * used one in the cache
+ */
+static xcursor_cache_t *xcursor_create(xcursor_t *data,
+		XFixesCursorImage *xc) {
+	xcursor_cache_t *entry = &data->cache[0];
+	uint32_t *pixels = xcursor_pixels(xc);
 
-		data->tex = gs_texture_create(xc->width, xc->height,
-			GS_BGRA, 1, (const uint8_t **) &pixels, GS_DYNAMIC);
+	for (size_t i = 1; i < XCURSOR_CACHE_SIZE; ++i) {
+		if (data->cache[i].last_used < entry->last_used)
+			entry = &data->cache[i];
 	}
 
+	if (entry->tex)
+		gs_texture_destroy(entry->tex);
+
+	entry->tex = gs_texture_create(xc->width, xc->height,
+		GS_BGRA, 1, (const uint8_t **) &pixels, 0);
+	entry->serial = xc->cursor_serial;
+	entry->xhot = xc->xhot;
+	entry->yhot = xc->yhot;
+
 	bfree(pixels);
+	return entry;
+}
+
+/*
+ * Switch to the cursor image with the given serial, fetching the image only
+ * if it isn't cached
+ */
+static void xcursor_select(xcursor_t *data, XFixesCursorImage *xc,
+		unsigned long serial, bool have_serial) {
+	xcursor_cache_t *entry = NULL;
+	XFixesCursorImage *image;
+
+	if (have_serial)
+		entry = xcursor_find(data, serial);
 
-	data->last_serial = xc->cursor_serial;
-	data->last_width = xc->width;
-	data->last_height = xc->height;
+	if (!entry) {
+		image = xc ? xc : XFixesGetCursorImage(data->dpy);
+		if (!image)
+			return;
+
+		entry = xcursor_find(data, image->cursor_serial);
+		if (!entry)
+			entry = xcursor_create(data, image);
+
+		if (!xc)
+			XFree(image);
+	}
+
+	entry->last_used = ++data->use_counter;
+	data->current = entry;
+	data->tex = entry->tex;
+}
+
+/*
+ * Listen for cursor changes on a separate connection, so that the events
+ * aren't taken by (or left queued for) other users of the display
+ */
+static void xcursor_init_events(xcursor_t *data) {
+	int error_base;
+
+	data->event_dpy = XOpenDisplay(DisplayString(data->dpy));
+	if (!data->event_dpy)
+		return;
+
+	if (!XFixesQueryExtension(data->event_dpy, &data->event_base,
+			&error_base)) {
+		XCloseDisplay(data->event_dpy);
+		data->event_dpy = NULL;
+		return;
+	}
+
+	XFixesSelectCursorInput(data->event_dpy,
+		DefaultRootWindow(data->event_dpy),
+		XFixesDisplayCursorNotifyMask);
 }
 
 xcursor_t *xcursor_init(Display *dpy) {
 	xcursor_t *data = bzalloc(sizeof(xcursor_t));
 
 	data->dpy = dpy;
+	xcursor_init_events(data);
 	xcursor_tick(data);
 
 	return data;
 }
 
 void xcursor_destroy(xcursor_t *data) {
-	if (data->tex)
-		gs_texture_destroy(data->tex);
+	for (size_t i = 0; i < XCURSOR_CACHE_SIZE; ++i) {
+		if (data->cache[i].tex)
+			gs_texture_destroy(data->cache[i].tex);
+	}
+	if (data->event_dpy)
+		XCloseDisplay(data->event_dpy);
 	bfree(data);
 }
 
+/*
+ * With cursor events only the pointer position is queried on every tick,
+ * the cursor image is only fetched when it changed to one not cached.
+ */
+static void xcursor_tick_events(xcursor_t *data) {
+	bool changed = !data->current;
+	unsigned long serial = 0;
+	Window root, child;
+	int root_x, root_y, win_x, win_y;
+	unsigned int mask;
+	XEvent ev;
+
+	while (XCheckTypedEvent(data->event_dpy,
+			data->event_base + XFixesCursorNotify, &ev)) {
+		serial = ((XFixesCursorNotifyEvent *) &ev)->cursor_serial;
+		changed = true;
+	}
+
+	if (changed)
+		xcursor_select(data, NULL, serial, serial != 0);
+
+	if (!XQueryPointer(data->event_dpy, DefaultRootWindow(data->event_dpy),
+			&root, &child, &root_x, &root_y, &win_x, &win_y,
+			&mask))
+		return;
+
+	data->x = (int_fast32_t)root_x - (int_fast32_t)data->x_org;
+	data->y = (int_fast32_t)root_y - (int_fast32_t)data->y_org;
+}
+
 void xcursor_tick(xcursor_t *data) {
-	XFixesCursorImage *xc = XFixesGetCursorImage(data->dpy);
+	XFixesCursorImage *xc;
 
-	if (!data->tex || data->last_serial != xc->cursor_serial)
-		xcursor_create(data, xc);
+	if (data->event_dpy) {
+		xcursor_tick_events(data);
+	} else {
+		xc = XFixesGetCursorImage(data->dpy);
+		if (!xc)
+			return;
 
-	data->x = (int_fast32_t)xc->x - (int_fast32_t)data->x_org;
-	data->y = (int_fast32_t)xc->y - (int_fast32_t)data->y_org;
-	data->render_x = xc->x - xc->xhot - data->x_org;
-	data->render_y = xc->y - xc->yhot - data->y_org;
+		if (!data->current ||
+		    data->current->serial != xc->cursor_serial)
+			xcursor_select(data, xc, xc->cursor_serial, true);
 
-	XFree(xc);
+		data->x = (int_fast32_t)xc->x - (int_fast32_t)data->x_org;
+		data->y = (int_fast32_t)xc->y - (int_fast32_t)data->y_org;
+		XFree(xc);
+	}
+
+	if (data->current) {
+		data->render_x = data->x - data->current->xhot;
+		data->render_y = data->y - data->current->yhot;
+	}
 }
 
 void xcursor_render(xcursor_t *data) {
+	if (!data->tex)
+		return;
+
 	gs_effect_t *effect  = gs_get_effect();
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	gs_effect_set_texture(image, data->tex);
@@ -23,14 +23,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 extern "C" {
 #endif
 
+/* number of cursor images kept as textures */
+#define XCURSOR_CACHE_SIZE 8
+
+typedef struct {
+	unsigned long serial;
+	gs_texture_t *tex;
+	int_fast32_t xhot;
+	int_fast32_t yhot;
+	uint64_t last_used;
+} xcursor_cache_t;
+
 typedef struct {
 	Display *dpy;
+	/* own connection receiving cursor change events, NULL if the cursor
+	 * image has to be polled on every tick */
+	Display *event_dpy;
+	int event_base;
 	float render_x;
 	float render_y;
-	unsigned long last_serial;
-	uint_fast32_t last_width;
-	uint_fast32_t last_height;
 	gs_texture_t *tex;
+	xcursor_cache_t *current;
+	xcursor_cache_t cache[XCURSOR_CACHE_SIZE];
+	uint64_t use_counter;
 
 	int_fast32_t x, y;
 	int_fast32_t x_org;
@@ -20,6 +20,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <inttypes.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
 
 #include <obs-module.h>
 #include <util/dstr.h>
@@ -30,6 +32,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* with more damaged rectangles than this their bounding box is fetched */
+#define XSHM_MAX_DAMAGE_RECTS 16
+
 struct xshm_data {
 	/** The source object */
 	obs_source_t *source;
@@ -57,6 +62,17 @@ struct xshm_data {
 	bool use_xinerama;
 	/** user setting - if advanced settings should be displayed */
 	bool advanced;
+	/** xdamage object tracking changes of the root window, 0 if the
+	 *  extension is not available */
+	Damage damage;
+	/** first event number of the xdamage extension */
+	int damage_event_base;
+	/** region receiving the damaged area on every tick */
+	XserverRegion damage_region;
+	/** set once the texture holds a complete frame */
+	bool texture_valid;
+	/** set if the renderer supports partial texture uploads */
+	bool partial_upload;
 };
 
 /**
@@ -72,6 +88,180 @@ static inline void xshm_resize_texture(struct xshm_data *data)
 		gs_texture_destroy(data->texture);
 	data->texture = gs_texture_create(data->width, data->height,
 		GS_BGRA, 1, NULL, GS_DYNAMIC);
+	data->texture_valid = false;
+}
+
+/**
+ * Start tracking damage of the root window
+ *
+ * Without the xdamage extension the full screen is captured on every tick.
+ */
+static void xshm_damage_init(struct xshm_data *data)
+{
+	int event_base, error_base;
+
+	if (!XFixesQueryExtension(data->dpy, &event_base, &error_base) ||
+	    !XDamageQueryExtension(data->dpy, &data->damage_event_base,
+			&error_base)) {
+		blog(LOG_INFO, "XDamage extension not found, capturing full "
+				"frames");
+		return;
+	}
+
+	data->damage = XDamageCreate(data->dpy,
+			XRootWindowOfScreen(data->screen),
+			XDamageReportNonEmpty);
+	data->damage_region = XFixesCreateRegion(data->dpy, NULL, 0);
+	data->partial_upload = true;
+}
+
+static void xshm_damage_free(struct xshm_data *data)
+{
+	if (data->damage) {
+		XDamageDestroy(data->dpy, data->damage);
+		data->damage = 0;
+	}
+	if (data->damage_region) {
+		XFixesDestroyRegion(data->dpy, data->damage_region);
+		data->damage_region = 0;
+	}
+}
+
+/**
+ * Clip the damaged rectangles to the captured area
+ *
+ * @return the number of damaged pixels in the captured area
+ */
+static uint64_t xshm_clip_damage(struct xshm_data *data, XRectangle *rects,
+		int *count)
+{
+	uint64_t area = 0;
+	int num = 0;
+
+	for (int i = 0; i < *count; i++) {
+		int_fast32_t x1 = rects[i].x - data->x_org;
+		int_fast32_t y1 = rects[i].y - data->y_org;
+		int_fast32_t x2 = x1 + rects[i].width;
+		int_fast32_t y2 = y1 + rects[i].height;
+
+		if (x1 < 0) x1 = 0;
+		if (y1 < 0) y1 = 0;
+		if (x2 > data->width)  x2 = data->width;
+		if (y2 > data->height) y2 = data->height;
+		if (x1 >= x2 || y1 >= y2)
+			continue;
+
+		rects[num].x      = (short)x1;
+		rects[num].y      = (short)y1;
+		rects[num].width  = (unsigned short)(x2 - x1);
+		rects[num].height = (unsigned short)(y2 - y1);
+		area += (uint64_t)(x2 - x1) * (uint64_t)(y2 - y1);
+		num++;
+	}
+
+	*count = num;
+	return area;
+}
+
+/**
+ * Replace the rectangles with their bounding box
+ */
+static void xshm_merge_damage(XRectangle *rects, int *count)
+{
+	int x1 = rects[0].x, y1 = rects[0].y;
+	int x2 = x1 + rects[0].width, y2 = y1 + rects[0].height;
+
+	for (int i = 1; i < *count; i++) {
+		if (rects[i].x < x1) x1 = rects[i].x;
+		if (rects[i].y < y1) y1 = rects[i].y;
+		if (rects[i].x + rects[i].width  > x2)
+			x2 = rects[i].x + rects[i].width;
+		if (rects[i].y + rects[i].height > y2)
+			y2 = rects[i].y + rects[i].height;
+	}
+
+	rects[0].x      = (short)x1;
+	rects[0].y      = (short)y1;
+	rects[0].width  = (unsigned short)(x2 - x1);
+	rects[0].height = (unsigned short)(y2 - y1);
+	*count = 1;
+}
+
+/**
+ * Fetch and upload the damaged rectangles
+ *
+ * @return false if the full screen has to be captured instead
+ */
+static bool xshm_upload_damage(struct xshm_data *data, XRectangle *rects,
+		int count)
+{
+	XImage *image = data->xshm->image;
+	Window root = XRootWindowOfScreen(data->screen);
+	struct gs_rect regions[XSHM_MAX_DAMAGE_RECTS];
+	uint64_t area;
+
+	area = xshm_clip_damage(data, rects, &count);
+	if (!count)
+		return true;
+
+	/* past this point a single XShmGetImage is cheaper */
+	if (area * 2 > (uint64_t)data->width * (uint64_t)data->height)
+		return false;
+
+	if (count > XSHM_MAX_DAMAGE_RECTS)
+		xshm_merge_damage(rects, &count);
+
+	for (int i = 0; i < count; i++) {
+		const XRectangle *r = &rects[i];
+
+		XGetSubImage(data->dpy, root,
+				data->x_org + r->x, data->y_org + r->y,
+				r->width, r->height, AllPlanes, ZPixmap,
+				image, r->x, r->y);
+
+		regions[i].x  = r->x;
+		regions[i].y  = r->y;
+		regions[i].cx = r->width;
+		regions[i].cy = r->height;
+	}
+
+	if (!gs_texture_set_image_regions(data->texture,
+			(const uint8_t*)image->data, image->bytes_per_line,
+			regions, count)) {
+		blog(LOG_INFO, "Partial texture updates not supported, "
+				"capturing full frames");
+		data->partial_upload = false;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Update the texture with the area damaged since the last call
+ *
+ * @return false if the full screen has to be captured instead
+ */
+static bool xshm_update_damage(struct xshm_data *data)
+{
+	XRectangle *rects;
+	XEvent event;
+	int count = 0;
+	bool updated = false;
+
+	/* the damage state is polled, the events are only drained */
+	while (XCheckTypedEvent(data->dpy,
+			data->damage_event_base + XDamageNotify, &event));
+
+	XDamageSubtract(data->dpy, data->damage, None, data->damage_region);
+	rects = XFixesFetchRegion(data->dpy, data->damage_region, &count);
+
+	if (data->texture_valid && data->partial_upload)
+		updated = xshm_upload_damage(data, rects, rects ? count : 0);
+
+	if (rects)
+		XFree(rects);
+	return updated;
 }
 
 /**
@@ -143,6 +333,9 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	if (data->dpy)
+		xshm_damage_free(data);
+
 	if (data->xshm) {
 		xshm_detach(data->xshm);
 		data->xshm = NULL;
@@ -193,6 +386,8 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
+	xshm_damage_init(data);
+
 	obs_enter_graphics();
 
 	data->cursor = xcursor_init(data->dpy);
@@ -385,10 +580,15 @@ static void xshm_video_tick(void *vptr, float seconds)
 
 	obs_enter_graphics();
 
-	XShmGetImage(data->dpy, XRootWindowOfScreen(data->screen),
-		data->xshm->image, data->x_org, data->y_org, AllPlanes);
-	gs_texture_set_image(data->texture, (void *) data->xshm->image->data,
-		data->width * 4, false);
+	if (!data->damage || !xshm_update_damage(data)) {
+		XShmGetImage(data->dpy, XRootWindowOfScreen(data->screen),
+			data->xshm->image, data->x_org, data->y_org,
+			AllPlanes);
+		gs_texture_set_image(data->texture,
+			(void *) data->xshm->image->data,
+			data->width * 4, false);
+		data->texture_valid = true;
+	}
 
 	xcursor_tick(data->cursor);
 
@@ -438,7 +638,8 @@ static uint32_t xshm_getheight(void *vptr)
 struct obs_source_info xshm_input = {
 	.id             = "xshm_input",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_OPAQUE |
+	                  OBS_SOURCE_SUSPEND_WHEN_HIDDEN,
 	.get_name       = xshm_getname,
 	.create         = xshm_create,
 	.destroy        = xshm_destroy,
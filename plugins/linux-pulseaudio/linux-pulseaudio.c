@@ -21,10 +21,12 @@ OBS_MODULE_USE_DEFAULT_LOCALE("linux-pulseaudio", "en-US")
 
 extern struct obs_source_info pulse_input_capture;
 extern struct obs_source_info pulse_output_capture;
+extern struct obs_output_info pulse_monitor_output;
 
 bool obs_module_load(void)
 {
 	obs_register_source(&pulse_input_capture);
 	obs_register_source(&pulse_output_capture);
+	obs_register_output(&pulse_monitor_output);
 	return true;
 }
@@ -23,6 +23,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define NSEC_PER_SEC  1000000000LL
 #define NSEC_PER_MSEC 1000000L
+#define USEC_PER_MSEC 1000L
+
+#define DEFAULT_LATENCY_MS 25
+#define MIN_LATENCY_MS     1
+#define MAX_LATENCY_MS     500
+
+/* how much audio the server keeps for us, in multiples of the fragment
+ * size, before it starts dropping the oldest data */
+#define MAX_FRAGMENTS      4
 
 #define PULSE_DATA(voidptr) struct pulse_data *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-input: " msg, ##__VA_ARGS__)
@@ -30,9 +39,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 struct pulse_data {
 	obs_source_t *source;
 	pa_stream *stream;
+	struct pulse_loop *loop;
+	bool thread_role_set;
 
 	/* user settings */
 	char *device;
+	int latency_ms;
+	bool dedicated_loop;
 
 	/* server info */
 	enum speaker_layout speakers;
@@ -121,6 +134,11 @@ static void pulse_stream_read(pa_stream *p, size_t nbytes, void *userdata)
 	if (!data->stream)
 		goto exit;
 
+	if (!data->thread_role_set) {
+		os_set_thread_role(OS_THREAD_ROLE_AUDIO);
+		data->thread_role_set = true;
+	}
+
 	pa_stream_peek(data->stream, &frames, &bytes);
 
 	// check if we got data
@@ -154,7 +172,7 @@ static void pulse_stream_read(pa_stream *p, size_t nbytes, void *userdata)
 
 	pa_stream_drop(data->stream);
 exit:
-	pulse_signal(0);
+	pulse_loop_signal(data->loop, 0);
 }
 
 /**
@@ -226,9 +244,10 @@ skip:
  * We request the default format used by pulse here because the data will be
  * converted and possibly re-sampled by obs anyway.
  *
- * For now we request a buffer length of 25ms although pulse seems to ignore
- * this setting for monitor streams. For "real" input streams this should work
- * fine though.
+ * The fragment size is set from the configured latency, which pulse may
+ * ignore for monitor streams. For "real" input streams this should work
+ * fine though.  The stream can optionally get its own mainloop, so a slow
+ * device can't delay the other sources sharing the default one.
  */
 static int_fast32_t pulse_start_recording(struct pulse_data *data)
 {
@@ -256,38 +275,51 @@ static int_fast32_t pulse_start_recording(struct pulse_data *data)
 	data->speakers = pulse_channels_to_obs_speakers(spec.channels);
 	data->bytes_per_frame = pa_frame_size(&spec);
 
-	data->stream = pulse_stream_new(obs_source_get_name(data->source),
-		&spec, NULL);
+	if (data->dedicated_loop) {
+		data->loop = pulse_loop_create();
+		if (!data->loop)
+			blog(LOG_WARNING, "Unable to create a dedicated "
+				"mainloop, using the shared one");
+	}
+
+	data->stream = pulse_loop_stream_new(data->loop,
+		obs_source_get_name(data->source), &spec, NULL);
 	if (!data->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
+		pulse_loop_destroy(data->loop);
+		data->loop = NULL;
 		return -1;
 	}
 
-	pulse_lock();
+	pulse_loop_lock(data->loop);
 	pa_stream_set_read_callback(data->stream, pulse_stream_read,
 		(void *) data);
-	pulse_unlock();
+	pulse_loop_unlock(data->loop);
+
+	pa_usec_t latency = (pa_usec_t) data->latency_ms * USEC_PER_MSEC;
 
 	pa_buffer_attr attr;
-	attr.fragsize  = pa_usec_to_bytes(25000, &spec);
-	attr.maxlength = (uint32_t) -1;
+	attr.fragsize  = pa_usec_to_bytes(latency, &spec);
+	attr.maxlength = pa_usec_to_bytes(latency * MAX_FRAGMENTS, &spec);
 	attr.minreq    = (uint32_t) -1;
 	attr.prebuf    = (uint32_t) -1;
 	attr.tlength   = (uint32_t) -1;
 
 	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY;
 
-	pulse_lock();
+	pulse_loop_lock(data->loop);
 	int_fast32_t ret = pa_stream_connect_record(data->stream, data->device,
 		&attr, flags);
-	pulse_unlock();
+	pulse_loop_unlock(data->loop);
 	if (ret < 0) {
 		pulse_stop_recording(data);
 		blog(LOG_ERROR, "Unable to connect to stream");
 		return -1;
 	}
 
-	blog(LOG_INFO, "Started recording from '%s'", data->device);
+	blog(LOG_INFO, "Started recording from '%s' (latency %d ms%s)",
+		data->device, data->latency_ms,
+		data->loop ? ", dedicated mainloop" : "");
 	return 0;
 }
 
@@ -297,13 +329,17 @@ static int_fast32_t pulse_start_recording(struct pulse_data *data)
 static void pulse_stop_recording(struct pulse_data *data)
 {
 	if (data->stream) {
-		pulse_lock();
+		pulse_loop_lock(data->loop);
 		pa_stream_disconnect(data->stream);
 		pa_stream_unref(data->stream);
 		data->stream = NULL;
-		pulse_unlock();
+		pulse_loop_unlock(data->loop);
 	}
 
+	pulse_loop_destroy(data->loop);
+	data->loop = NULL;
+	data->thread_role_set = false;
+
 	blog(LOG_INFO, "Stopped recording from '%s'", data->device);
 	blog(LOG_INFO, "Got %"PRIuFAST32" packets with %"PRIuFAST64" frames",
 		data->packets, data->frames);
@@ -362,6 +398,11 @@ static obs_properties_t *pulse_properties(bool input)
 	pulse_get_source_info_list(cb, (void *) devices);
 	pulse_unref();
 
+	obs_properties_add_int(props, "latency", obs_module_text("Latency"),
+		MIN_LATENCY_MS, MAX_LATENCY_MS, 1);
+	obs_properties_add_bool(props, "dedicated_loop",
+		obs_module_text("DedicatedLoop"));
+
 	return props;
 }
 
@@ -424,6 +465,9 @@ static void pulse_defaults(obs_data_t *settings, bool input)
 	pulse_get_server_info(cb, (void *) settings);
 
 	pulse_unref();
+
+	obs_data_set_default_int(settings, "latency", DEFAULT_LATENCY_MS);
+	obs_data_set_default_bool(settings, "dedicated_loop", false);
 }
 
 static void pulse_input_defaults(obs_data_t *settings)
@@ -476,6 +520,8 @@ static void pulse_update(void *vptr, obs_data_t *settings)
 	PULSE_DATA(vptr);
 	bool restart = false;
 	const char *new_device;
+	int latency_ms;
+	bool dedicated_loop;
 
 	new_device = obs_data_get_string(settings, "device_id");
 	if (!data->device || strcmp(data->device, new_device) != 0) {
@@ -485,6 +531,23 @@ static void pulse_update(void *vptr, obs_data_t *settings)
 		restart = true;
 	}
 
+	latency_ms = (int) obs_data_get_int(settings, "latency");
+	if (latency_ms < MIN_LATENCY_MS)
+		latency_ms = MIN_LATENCY_MS;
+	else if (latency_ms > MAX_LATENCY_MS)
+		latency_ms = MAX_LATENCY_MS;
+
+	if (data->latency_ms != latency_ms) {
+		data->latency_ms = latency_ms;
+		restart = true;
+	}
+
+	dedicated_loop = obs_data_get_bool(settings, "dedicated_loop");
+	if (data->dedicated_loop != dedicated_loop) {
+		data->dedicated_loop = dedicated_loop;
+		restart = true;
+	}
+
 	if (!restart)
 		return;
 
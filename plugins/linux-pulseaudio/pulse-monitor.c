@@ -0,0 +1,375 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <util/circlebuf.h>
+#include <util/bmem.h>
+#include <obs-module.h>
+
+#include "pulse-wrapper.h"
+
+#define MONITOR_DATA(voidptr) struct pulse_monitor *data = voidptr;
+#define blog(level, msg, ...) blog(level, "pulse-monitor: " msg, ##__VA_ARGS__)
+
+#define DEFAULT_LATENCY_MS 10
+
+/*
+ * Plays a source's audio on the default sink as it's output by the source,
+ * without going through the buffered mix.  The audio is only kept in a small
+ * ring between the source's audio thread and the pulse mainloop, which is
+ * limited to twice the target latency by dropping the oldest data.
+ */
+struct pulse_monitor {
+	obs_output_t *output;
+	obs_source_t *source;
+	pa_stream *stream;
+
+	/* user settings */
+	char *source_name;
+	uint_fast32_t latency_ms;
+
+	/* audio ring, interleaved float */
+	pthread_mutex_t mutex;
+	struct circlebuf buffer;
+	size_t max_buffer_size;
+
+	bool planar;
+	uint_fast8_t channels;
+	size_t bytes_per_frame;
+
+	/* statistics */
+	uint_fast64_t underruns;
+	uint_fast64_t bytes_dropped;
+};
+
+/**
+ * Capture callback, called on the source's audio thread
+ */
+static void pulse_monitor_capture(void *param, obs_source_t *source,
+	const struct audio_data *audio)
+{
+	UNUSED_PARAMETER(source);
+	MONITOR_DATA(param);
+
+	size_t size = audio->frames * data->bytes_per_frame;
+
+	pthread_mutex_lock(&data->mutex);
+
+	struct circlebuf_span span;
+	circlebuf_push_back_span(&data->buffer, size, &span);
+
+	/* interleave and apply the volume straight in to the ring */
+	size_t pos = 0;
+	for (size_t part = 0; part < 2; part++) {
+		float *out = (float *) span.data[part];
+		size_t samples = span.size[part] / sizeof(float);
+
+		for (size_t i = 0; i < samples; i++, pos++) {
+			size_t frame = pos / data->channels;
+			size_t ch    = pos % data->channels;
+			const float *in = data->planar
+				? (const float *) audio->data[ch] + frame
+				: (const float *) audio->data[0] + pos;
+
+			out[i] = *in * audio->volume;
+		}
+	}
+
+	if (data->buffer.size > data->max_buffer_size) {
+		size_t excess = data->buffer.size - data->max_buffer_size;
+		excess -= excess % data->bytes_per_frame;
+
+		circlebuf_consume(&data->buffer, excess);
+		data->bytes_dropped += excess;
+	}
+
+	pthread_mutex_unlock(&data->mutex);
+}
+
+/**
+ * Callback for pulse which gets executed when the stream wants more data
+ */
+static void pulse_monitor_write(pa_stream *p, size_t nbytes, void *userdata)
+{
+	MONITOR_DATA(userdata);
+	void *buffer;
+
+	if (pa_stream_begin_write(p, &buffer, &nbytes) < 0 || !buffer)
+		goto exit;
+
+	pthread_mutex_lock(&data->mutex);
+
+	size_t size = (data->buffer.size < nbytes) ? data->buffer.size : nbytes;
+	circlebuf_pop_front(&data->buffer, buffer, size);
+
+	pthread_mutex_unlock(&data->mutex);
+
+	/* fill the rest with silence rather than letting the stream stall */
+	if (size < nbytes) {
+		memset((uint8_t *) buffer + size, 0, nbytes - size);
+		data->underruns++;
+	}
+
+	pa_stream_write(p, buffer, nbytes, NULL, 0, PA_SEEK_RELATIVE);
+exit:
+	pulse_signal(0);
+}
+
+/**
+ * Get the pulse sample spec matching the obs audio output
+ */
+static bool pulse_monitor_get_spec(struct pulse_monitor *data,
+	pa_sample_spec *spec)
+{
+	const struct audio_output_info *aoi =
+		audio_output_get_info(obs_get_audio());
+
+	if (!aoi)
+		return false;
+
+	if (aoi->format != AUDIO_FORMAT_FLOAT &&
+	    aoi->format != AUDIO_FORMAT_FLOAT_PLANAR) {
+		blog(LOG_ERROR, "Only float audio can be monitored");
+		return false;
+	}
+
+	data->planar   = aoi->format == AUDIO_FORMAT_FLOAT_PLANAR;
+	data->channels = get_audio_channels(aoi->speakers);
+
+	spec->format   = PA_SAMPLE_FLOAT32LE;
+	spec->rate     = aoi->samples_per_sec;
+	spec->channels = data->channels;
+
+	if (!pa_sample_spec_valid(spec)) {
+		blog(LOG_ERROR, "Sample spec is not valid");
+		return false;
+	}
+
+	data->bytes_per_frame = pa_frame_size(spec);
+	return true;
+}
+
+static void pulse_monitor_stop(void *vptr);
+
+/**
+ * Start playback of the source set in the settings
+ */
+static bool pulse_monitor_start(void *vptr)
+{
+	MONITOR_DATA(vptr);
+	pa_sample_spec spec;
+
+	if (data->source || !data->source_name || !*data->source_name)
+		return false;
+	if (!pulse_monitor_get_spec(data, &spec))
+		return false;
+
+	uint32_t target = pa_usec_to_bytes(data->latency_ms * 1000, &spec);
+	data->max_buffer_size = target * 2;
+
+	data->stream = pulse_stream_new(data->source_name, &spec, NULL);
+	if (!data->stream) {
+		blog(LOG_ERROR, "Unable to create stream");
+		return false;
+	}
+
+	pulse_lock();
+	pa_stream_set_write_callback(data->stream, pulse_monitor_write,
+		(void *) data);
+	pulse_unlock();
+
+	pa_buffer_attr attr;
+	attr.fragsize  = (uint32_t) -1;
+	attr.maxlength = (uint32_t) -1;
+	attr.minreq    = (uint32_t) -1;
+	attr.prebuf    = (uint32_t) -1;
+	attr.tlength   = target;
+
+	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY;
+
+	pulse_lock();
+	int_fast32_t ret = pa_stream_connect_playback(data->stream, NULL,
+		&attr, flags, NULL, NULL);
+	pulse_unlock();
+	if (ret < 0) {
+		pulse_monitor_stop(data);
+		blog(LOG_ERROR, "Unable to connect to stream");
+		return false;
+	}
+
+	data->source = obs_get_source_by_name(data->source_name);
+	if (!data->source) {
+		pulse_monitor_stop(data);
+		blog(LOG_ERROR, "Source '%s' not found", data->source_name);
+		return false;
+	}
+
+	obs_source_add_audio_capture_callback(data->source,
+		pulse_monitor_capture, data);
+
+	blog(LOG_INFO, "Started monitoring '%s' with %"PRIuFAST32" ms latency",
+		data->source_name, data->latency_ms);
+	return true;
+}
+
+/**
+ * Stop playback
+ */
+static void pulse_monitor_stop(void *vptr)
+{
+	MONITOR_DATA(vptr);
+
+	if (data->source) {
+		obs_source_remove_audio_capture_callback(data->source,
+			pulse_monitor_capture, data);
+		obs_source_release(data->source);
+		data->source = NULL;
+	}
+
+	if (data->stream) {
+		pulse_lock();
+		pa_stream_disconnect(data->stream);
+		pa_stream_unref(data->stream);
+		data->stream = NULL;
+		pulse_unlock();
+
+		blog(LOG_INFO, "Stopped monitoring '%s', %"PRIuFAST64
+			" underruns, %"PRIuFAST64" bytes dropped",
+			data->source_name, data->underruns,
+			data->bytes_dropped);
+	}
+
+	pthread_mutex_lock(&data->mutex);
+	circlebuf_free(&data->buffer);
+	pthread_mutex_unlock(&data->mutex);
+
+	data->underruns = 0;
+	data->bytes_dropped = 0;
+}
+
+/**
+ * Update the monitor settings, applied the next time it's started
+ */
+static void pulse_monitor_update(void *vptr, obs_data_t *settings)
+{
+	MONITOR_DATA(vptr);
+
+	if (data->source_name)
+		bfree(data->source_name);
+
+	data->source_name = bstrdup(obs_data_get_string(settings, "source"));
+	data->latency_ms  = (uint_fast32_t) obs_data_get_int(settings,
+		"latency_ms");
+	if (!data->latency_ms)
+		data->latency_ms = DEFAULT_LATENCY_MS;
+}
+
+static void pulse_monitor_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "latency_ms", DEFAULT_LATENCY_MS);
+}
+
+static bool pulse_monitor_add_source(void *param, obs_source_t *source)
+{
+	uint32_t flags = obs_source_get_output_flags(source);
+
+	if (flags & OBS_SOURCE_AUDIO) {
+		const char *name = obs_source_get_name(source);
+		obs_property_list_add_string((obs_property_t *) param,
+			name, name);
+	}
+
+	return true;
+}
+
+/**
+ * Get plugin properties
+ */
+static obs_properties_t *pulse_monitor_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *sources = obs_properties_add_list(props, "source",
+		obs_module_text("Source"), OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_STRING);
+	obs_properties_add_int(props, "latency_ms",
+		obs_module_text("Latency"), 1, 100, 1);
+
+	obs_enum_sources(pulse_monitor_add_source, sources);
+
+	return props;
+}
+
+/**
+ * Returns the name of the plugin
+ */
+static const char *pulse_monitor_getname(void)
+{
+	return obs_module_text("PulseMonitor");
+}
+
+/**
+ * Destroy the plugin object and free all memory
+ */
+static void pulse_monitor_destroy(void *vptr)
+{
+	MONITOR_DATA(vptr);
+
+	if (!data)
+		return;
+
+	pulse_monitor_stop(data);
+	pulse_unref();
+
+	pthread_mutex_destroy(&data->mutex);
+	if (data->source_name)
+		bfree(data->source_name);
+	bfree(data);
+}
+
+/**
+ * Create the plugin object
+ */
+static void *pulse_monitor_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct pulse_monitor *data = bzalloc(sizeof(struct pulse_monitor));
+
+	data->output = output;
+
+	if (pthread_mutex_init(&data->mutex, NULL) != 0) {
+		bfree(data);
+		return NULL;
+	}
+
+	pulse_init();
+	pulse_monitor_update(data, settings);
+
+	return data;
+}
+
+struct obs_output_info pulse_monitor_output = {
+	.id             = "pulse_monitor_output",
+	.get_name       = pulse_monitor_getname,
+	.create         = pulse_monitor_create,
+	.destroy        = pulse_monitor_destroy,
+	.start          = pulse_monitor_start,
+	.stop           = pulse_monitor_stop,
+	.update         = pulse_monitor_update,
+	.get_defaults   = pulse_monitor_defaults,
+	.get_properties = pulse_monitor_properties
+};
@@ -20,15 +20,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <pulse/thread-mainloop.h>
 
 #include <util/base.h>
+#include <util/bmem.h>
 #include <obs.h>
 
 #include "pulse-wrapper.h"
 
 /* global data */
+struct pulse_loop {
+	pa_threaded_mainloop *mainloop;
+	pa_context *context;
+};
+
 static uint_fast32_t pulse_refs = 0;
 static pthread_mutex_t pulse_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pa_threaded_mainloop *pulse_mainloop = NULL;
-static pa_context *pulse_context = NULL;
+static struct pulse_loop pulse_shared = {NULL, NULL};
+
+static inline struct pulse_loop *get_loop(struct pulse_loop *loop)
+{
+	return loop ? loop : &pulse_shared;
+}
 
 /**
  * context status change callback
@@ -38,10 +48,9 @@ static pa_context *pulse_context = NULL;
  */
 static void pulse_context_state_changed(pa_context *c, void *userdata)
 {
-	UNUSED_PARAMETER(userdata);
 	UNUSED_PARAMETER(c);
 
-	pulse_signal(0);
+	pulse_loop_signal(userdata, 0);
 }
 
 /**
@@ -59,41 +68,64 @@ static pa_proplist *pulse_properties()
 }
 
 /**
- * Initialize the pulse audio context with properties and callback
+ * Start the mainloop and connect its context with properties and callback
  */
-static void pulse_init_context()
+static void pulse_init_loop(struct pulse_loop *loop)
 {
-	pulse_lock();
+	loop->mainloop = pa_threaded_mainloop_new();
+	pa_threaded_mainloop_start(loop->mainloop);
+
+	pulse_loop_lock(loop);
 
 	pa_proplist *p = pulse_properties();
-	pulse_context = pa_context_new_with_proplist(
-		pa_threaded_mainloop_get_api(pulse_mainloop), "OBS", p);
+	loop->context = pa_context_new_with_proplist(
+		pa_threaded_mainloop_get_api(loop->mainloop), "OBS", p);
 
-	pa_context_set_state_callback(pulse_context,
-		pulse_context_state_changed, NULL);
+	pa_context_set_state_callback(loop->context,
+		pulse_context_state_changed, loop);
 
-	pa_context_connect(pulse_context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL);
+	pa_context_connect(loop->context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL);
 	pa_proplist_free(p);
 
-	pulse_unlock();
+	pulse_loop_unlock(loop);
+}
+
+/**
+ * Disconnect the context and stop the mainloop
+ */
+static void pulse_free_loop(struct pulse_loop *loop)
+{
+	pulse_loop_lock(loop);
+	if (loop->context != NULL) {
+		pa_context_disconnect(loop->context);
+		pa_context_unref(loop->context);
+		loop->context = NULL;
+	}
+	pulse_loop_unlock(loop);
+
+	if (loop->mainloop != NULL) {
+		pa_threaded_mainloop_stop(loop->mainloop);
+		pa_threaded_mainloop_free(loop->mainloop);
+		loop->mainloop = NULL;
+	}
 }
 
 /**
  * wait for context to be ready
  */
-static int_fast32_t pulse_context_ready()
+static int_fast32_t pulse_context_ready(struct pulse_loop *loop)
 {
-	pulse_lock();
+	pulse_loop_lock(loop);
 
-	if (!PA_CONTEXT_IS_GOOD(pa_context_get_state(pulse_context))) {
-		pulse_unlock();
+	if (!PA_CONTEXT_IS_GOOD(pa_context_get_state(loop->context))) {
+		pulse_loop_unlock(loop);
 		return -1;
 	}
 
-	while (pa_context_get_state(pulse_context) != PA_CONTEXT_READY)
-		pulse_wait();
+	while (pa_context_get_state(loop->context) != PA_CONTEXT_READY)
+		pa_threaded_mainloop_wait(loop->mainloop);
 
-	pulse_unlock();
+	pulse_loop_unlock(loop);
 	return 0;
 }
 
@@ -101,12 +133,8 @@ int_fast32_t pulse_init()
 {
 	pthread_mutex_lock(&pulse_mutex);
 
-	if (pulse_refs == 0) {
-		pulse_mainloop = pa_threaded_mainloop_new();
-		pa_threaded_mainloop_start(pulse_mainloop);
-
-		pulse_init_context();
-	}
+	if (pulse_refs == 0)
+		pulse_init_loop(&pulse_shared);
 
 	pulse_refs++;
 
@@ -119,59 +147,84 @@ void pulse_unref()
 {
 	pthread_mutex_lock(&pulse_mutex);
 
-	if (--pulse_refs == 0) {
-		pulse_lock();
-		if (pulse_context != NULL) {
-			pa_context_disconnect(pulse_context);
-			pa_context_unref(pulse_context);
-			pulse_context = NULL;
-		}
-		pulse_unlock();
-
-		if (pulse_mainloop != NULL) {
-			pa_threaded_mainloop_stop(pulse_mainloop);
-			pa_threaded_mainloop_free(pulse_mainloop);
-			pulse_mainloop = NULL;
-		}
-	}
+	if (--pulse_refs == 0)
+		pulse_free_loop(&pulse_shared);
 
 	pthread_mutex_unlock(&pulse_mutex);
 }
 
+struct pulse_loop *pulse_loop_create()
+{
+	struct pulse_loop *loop = bzalloc(sizeof(struct pulse_loop));
+
+	pulse_init_loop(loop);
+
+	if (pulse_context_ready(loop) < 0) {
+		pulse_loop_destroy(loop);
+		return NULL;
+	}
+
+	return loop;
+}
+
+void pulse_loop_destroy(struct pulse_loop *loop)
+{
+	if (!loop)
+		return;
+
+	pulse_free_loop(loop);
+	bfree(loop);
+}
+
+void pulse_loop_lock(struct pulse_loop *loop)
+{
+	pa_threaded_mainloop_lock(get_loop(loop)->mainloop);
+}
+
+void pulse_loop_unlock(struct pulse_loop *loop)
+{
+	pa_threaded_mainloop_unlock(get_loop(loop)->mainloop);
+}
+
+void pulse_loop_signal(struct pulse_loop *loop, int wait_for_accept)
+{
+	pa_threaded_mainloop_signal(get_loop(loop)->mainloop, wait_for_accept);
+}
+
 void pulse_lock()
 {
-	pa_threaded_mainloop_lock(pulse_mainloop);
+	pulse_loop_lock(NULL);
 }
 
 void pulse_unlock()
 {
-	pa_threaded_mainloop_unlock(pulse_mainloop);
+	pulse_loop_unlock(NULL);
 }
 
 void pulse_wait()
 {
-	pa_threaded_mainloop_wait(pulse_mainloop);
+	pa_threaded_mainloop_wait(pulse_shared.mainloop);
 }
 
 void pulse_signal(int wait_for_accept)
 {
-	pa_threaded_mainloop_signal(pulse_mainloop, wait_for_accept);
+	pulse_loop_signal(NULL, wait_for_accept);
 }
 
 void pulse_accept()
 {
-	pa_threaded_mainloop_accept(pulse_mainloop);
+	pa_threaded_mainloop_accept(pulse_shared.mainloop);
 }
 
 int_fast32_t pulse_get_source_info_list(pa_source_info_cb_t cb, void* userdata)
 {
-	if (pulse_context_ready() < 0)
+	if (pulse_context_ready(&pulse_shared) < 0)
 		return -1;
 
 	pulse_lock();
 
 	pa_operation *op = pa_context_get_source_info_list(
-		pulse_context, cb, userdata);
+		pulse_shared.context, cb, userdata);
 	while (pa_operation_get_state(op) == PA_OPERATION_RUNNING)
 		pulse_wait();
 	pa_operation_unref(op);
@@ -184,13 +237,13 @@ int_fast32_t pulse_get_source_info_list(pa_source_info_cb_t cb, void* userdata)
 int_fast32_t pulse_get_source_info(pa_source_info_cb_t cb, const char *name,
 	void *userdata)
 {
-	if (pulse_context_ready() < 0)
+	if (pulse_context_ready(&pulse_shared) < 0)
 		return -1;
 
 	pulse_lock();
 
 	pa_operation *op = pa_context_get_source_info_by_name(
-		pulse_context, name, cb, userdata);
+		pulse_shared.context, name, cb, userdata);
 	while (pa_operation_get_state(op) == PA_OPERATION_RUNNING)
 		pulse_wait();
 	pa_operation_unref(op);
@@ -202,13 +255,13 @@ int_fast32_t pulse_get_source_info(pa_source_info_cb_t cb, const char *name,
 
 int_fast32_t pulse_get_server_info(pa_server_info_cb_t cb, void* userdata)
 {
-	if (pulse_context_ready() < 0)
+	if (pulse_context_ready(&pulse_shared) < 0)
 		return -1;
 
 	pulse_lock();
 
 	pa_operation *op = pa_context_get_server_info(
-		pulse_context, cb, userdata);
+		pulse_shared.context, cb, userdata);
 	while (pa_operation_get_state(op) == PA_OPERATION_RUNNING)
 		pulse_wait();
 	pa_operation_unref(op);
@@ -217,20 +270,27 @@ int_fast32_t pulse_get_server_info(pa_server_info_cb_t cb, void* userdata)
 	return 0;
 }
 
-pa_stream* pulse_stream_new(const char* name, const pa_sample_spec* ss,
-	const pa_channel_map* map)
+pa_stream *pulse_loop_stream_new(struct pulse_loop *loop, const char *name,
+	const pa_sample_spec *ss, const pa_channel_map *map)
 {
-	if (pulse_context_ready() < 0)
+	loop = get_loop(loop);
+
+	if (pulse_context_ready(loop) < 0)
 		return NULL;
 
-	pulse_lock();
+	pulse_loop_lock(loop);
 
 	pa_proplist *p = pulse_properties();
 	pa_stream *s = pa_stream_new_with_proplist(
-		pulse_context, name, ss, map, p);
+		loop->context, name, ss, map, p);
 	pa_proplist_free(p);
 
-	pulse_unlock();
+	pulse_loop_unlock(loop);
 	return s;
 }
 
+pa_stream* pulse_stream_new(const char* name, const pa_sample_spec* ss,
+	const pa_channel_map* map)
+{
+	return pulse_loop_stream_new(NULL, name, ss, map);
+}
@@ -22,6 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+struct pulse_loop;
+
 /**
  * Initialize the pulseaudio mainloop and increase the reference count
  */
@@ -33,6 +35,47 @@ int_fast32_t pulse_init();
  */
 void pulse_unref();
 
+/**
+ * Create a private mainloop with its own context
+ *
+ * Streams created on a private mainloop are serviced by their own thread, so
+ * they are not delayed by other streams on the shared mainloop.  All
+ * pulse_loop_ functions treat a NULL loop as the shared mainloop.
+ *
+ * @note The function will block until the server context is ready.
+ *
+ * @return NULL on error
+ */
+struct pulse_loop *pulse_loop_create();
+
+/**
+ * Disconnect and destroy a private mainloop
+ *
+ * @warning call without active locks, after all of its streams were released
+ */
+void pulse_loop_destroy(struct pulse_loop *loop);
+
+/**
+ * Lock a mainloop
+ *
+ * @see pulse_lock()
+ */
+void pulse_loop_lock(struct pulse_loop *loop);
+
+/**
+ * Unlock a mainloop
+ *
+ * @see pulse_unlock()
+ */
+void pulse_loop_unlock(struct pulse_loop *loop);
+
+/**
+ * Signal threads waiting on a mainloop
+ *
+ * @see pulse_signal()
+ */
+void pulse_loop_signal(struct pulse_loop *loop, int wait_for_accept);
+
 /**
  * Lock the mainloop
  *
@@ -135,3 +178,13 @@ int_fast32_t pulse_get_server_info(pa_server_info_cb_t cb, void *userdata);
  */
 pa_stream *pulse_stream_new(const char *name, const pa_sample_spec *ss,
 	const pa_channel_map *map);
+
+/**
+ * Create a new stream with the default properties on a mainloop
+ *
+ * @note The function will block until the server context is ready.
+ *
+ * @warning call without active locks
+ */
+pa_stream *pulse_loop_stream_new(struct pulse_loop *loop, const char *name,
+	const pa_sample_spec *ss, const pa_channel_map *map);
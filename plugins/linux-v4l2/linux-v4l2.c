@@ -16,6 +16,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <obs-module.h>
 
+#include "v4l2-cache.h"
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("linux-v4l2", "en-US")
 
@@ -23,6 +25,12 @@ extern struct obs_source_info v4l2_input;
 
 bool obs_module_load(void)
 {
+	v4l2_cache_init();
 	obs_register_source(&v4l2_input);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	v4l2_cache_free();
+}
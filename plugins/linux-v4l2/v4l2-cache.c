@@ -0,0 +1,549 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <fcntl.h>
+#include <dirent.h>
+
+#include <util/threading.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+#include "v4l2-helpers.h"
+#include "v4l2-cache.h"
+
+#if HAVE_UDEV
+#include "v4l2-udev.h"
+#endif
+
+#define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
+
+/**
+ * Entry of a property list
+ */
+struct cache_item {
+	char *name;
+	int value;
+};
+
+/**
+ * Property list, for resolutions and framerates along with the format (and
+ * resolution) it was enumerated for
+ */
+struct cache_list {
+	uint32_t pixelformat;
+	int resolution;
+	DARRAY(struct cache_item) items;
+};
+
+/**
+ * Everything known about one device node
+ */
+struct cache_device {
+	char *node;
+	char *name;
+	/** set if the device could be opened and supports video capture */
+	bool available;
+	/** set if the device was found when listing all devices */
+	bool listed;
+
+	struct cache_list inputs;
+	struct cache_list formats;
+
+	/* enumerated on demand, when a format or resolution is selected */
+	DARRAY(struct cache_list) resolutions;
+	DARRAY(struct cache_list) framerates;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct cache_device*) cache_devices;
+/** set once all devices were listed */
+static bool cache_scanned;
+
+#if HAVE_UDEV
+static void *cache_udev;
+#endif
+
+static void list_add(struct cache_list *list, const char *name, int value)
+{
+	struct cache_item *item = da_push_back_new(list->items);
+	item->name  = bstrdup(name);
+	item->value = value;
+}
+
+static void list_free(struct cache_list *list)
+{
+	for (size_t i = 0; i < list->items.num; i++)
+		bfree(list->items.array[i].name);
+	da_free(list->items);
+}
+
+static struct cache_list *list_find(struct cache_list *lists, size_t num,
+		uint32_t pixelformat, int resolution)
+{
+	for (size_t i = 0; i < num; i++) {
+		if (lists[i].pixelformat == pixelformat &&
+		    lists[i].resolution  == resolution)
+			return &lists[i];
+	}
+
+	return NULL;
+}
+
+static void list_to_property(const struct cache_list *list,
+		obs_property_t *prop)
+{
+	obs_property_list_clear(prop);
+
+	obs_property_list_add_int(prop, obs_module_text("LeaveUnchanged"), -1);
+
+	for (size_t i = 0; i < list->items.num; i++)
+		obs_property_list_add_int(prop, list->items.array[i].name,
+				list->items.array[i].value);
+}
+
+/*
+ * Enumerate inputs of a device
+ */
+static void enum_inputs(int_fast32_t dev, struct cache_list *list)
+{
+	struct v4l2_input in;
+	memset(&in, 0, sizeof(in));
+
+	while (v4l2_ioctl(dev, VIDIOC_ENUMINPUT, &in) == 0) {
+		if (in.type & V4L2_INPUT_TYPE_CAMERA) {
+			list_add(list, (char *) in.name, in.index);
+			blog(LOG_INFO, "Found input '%s' (Index %d)", in.name,
+					in.index);
+		}
+		in.index++;
+	}
+}
+
+/*
+ * Enumerate formats of a device
+ */
+static void enum_formats(int_fast32_t dev, struct cache_list *list)
+{
+	struct v4l2_fmtdesc fmt;
+	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.index = 0;
+	struct dstr buffer;
+	dstr_init(&buffer);
+
+	while (v4l2_ioctl(dev, VIDIOC_ENUM_FMT, &fmt) == 0) {
+		dstr_copy(&buffer, (char *) fmt.description);
+		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
+			dstr_cat(&buffer, " (Emulated)");
+
+		if (v4l2_to_obs_video_format(fmt.pixelformat)
+				!= VIDEO_FORMAT_NONE) {
+			list_add(list, buffer.array, fmt.pixelformat);
+			blog(LOG_INFO, "Pixelformat: %s (available)",
+			     buffer.array);
+		} else {
+			blog(LOG_INFO, "Pixelformat: %s (unavailable)",
+			     buffer.array);
+		}
+		fmt.index++;
+	}
+
+	dstr_free(&buffer);
+}
+
+/*
+ * Enumerate resolutions of a device for a format
+ */
+static void enum_resolutions(int_fast32_t dev, uint32_t pixelformat,
+		struct cache_list *list)
+{
+	struct v4l2_frmsizeenum frmsize;
+	frmsize.pixel_format = pixelformat;
+	frmsize.index = 0;
+	struct dstr buffer;
+	dstr_init(&buffer);
+
+	v4l2_ioctl(dev, VIDIOC_ENUM_FRAMESIZES, &frmsize);
+
+	switch(frmsize.type) {
+	case V4L2_FRMSIZE_TYPE_DISCRETE:
+		while (v4l2_ioctl(dev, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0) {
+			dstr_printf(&buffer, "%dx%d", frmsize.discrete.width,
+					frmsize.discrete.height);
+			list_add(list, buffer.array,
+					v4l2_pack_tuple(frmsize.discrete.width,
+					frmsize.discrete.height));
+			frmsize.index++;
+		}
+		break;
+	default:
+		blog(LOG_INFO, "Stepwise and Continuous framesizes "
+			"are currently hardcoded");
+
+		for (const int *packed = v4l2_framesizes; *packed; ++packed) {
+			int width;
+			int height;
+			v4l2_unpack_tuple(&width, &height, *packed);
+			dstr_printf(&buffer, "%dx%d", width, height);
+			list_add(list, buffer.array, *packed);
+		}
+		break;
+	}
+
+	dstr_free(&buffer);
+}
+
+/*
+ * Enumerate framerates of a device for a format and resolution
+ */
+static void enum_framerates(int_fast32_t dev, uint32_t pixelformat,
+		int resolution, struct cache_list *list)
+{
+	struct v4l2_frmivalenum frmival;
+	int width, height;
+	v4l2_unpack_tuple(&width, &height, resolution);
+	frmival.pixel_format = pixelformat;
+	frmival.width = width;
+	frmival.height = height;
+	frmival.index = 0;
+	struct dstr buffer;
+	dstr_init(&buffer);
+
+	v4l2_ioctl(dev, VIDIOC_ENUM_FRAMEINTERVALS, &frmival);
+
+	switch(frmival.type) {
+	case V4L2_FRMIVAL_TYPE_DISCRETE:
+		while (v4l2_ioctl(dev, VIDIOC_ENUM_FRAMEINTERVALS,
+				&frmival) == 0) {
+			float fps = (float) frmival.discrete.denominator /
+				frmival.discrete.numerator;
+			int pack = v4l2_pack_tuple(frmival.discrete.numerator,
+					frmival.discrete.denominator);
+			dstr_printf(&buffer, "%.2f", fps);
+			list_add(list, buffer.array, pack);
+			frmival.index++;
+		}
+		break;
+	default:
+		blog(LOG_INFO, "Stepwise and Continuous framerates "
+			"are currently hardcoded");
+
+		for (const int *packed = v4l2_framerates; *packed; ++packed) {
+			int num;
+			int denom;
+			v4l2_unpack_tuple(&num, &denom, *packed);
+			float fps = (float) denom / num;
+			dstr_printf(&buffer, "%.2f", fps);
+			list_add(list, buffer.array, *packed);
+		}
+		break;
+	}
+
+	dstr_free(&buffer);
+}
+
+/*
+ * Open a device and query its name, inputs and formats
+ */
+static struct cache_device *scan_device(const char *node)
+{
+	struct cache_device *cd = bzalloc(sizeof(struct cache_device));
+	struct v4l2_capability video_cap;
+	uint32_t caps;
+	int fd;
+
+	cd->node = bstrdup(node);
+
+	if ((fd = v4l2_open(node, O_RDWR | O_NONBLOCK)) == -1) {
+		blog(LOG_INFO, "Unable to open %s", node);
+		return cd;
+	}
+
+	if (v4l2_ioctl(fd, VIDIOC_QUERYCAP, &video_cap) == -1) {
+		blog(LOG_INFO, "Failed to query capabilities for %s", node);
+		v4l2_close(fd);
+		return cd;
+	}
+
+	caps = (video_cap.capabilities & V4L2_CAP_DEVICE_CAPS)
+		? video_cap.device_caps
+		: video_cap.capabilities;
+
+	if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
+		blog(LOG_INFO, "%s seems to not support video capture", node);
+		v4l2_close(fd);
+		return cd;
+	}
+
+	blog(LOG_INFO, "Found device '%s' at %s", video_cap.card, node);
+
+	cd->name      = bstrdup((char *) video_cap.card);
+	cd->available = true;
+	enum_inputs(fd, &cd->inputs);
+	enum_formats(fd, &cd->formats);
+
+	v4l2_close(fd);
+	return cd;
+}
+
+static void free_device(struct cache_device *cd)
+{
+	for (size_t i = 0; i < cd->resolutions.num; i++)
+		list_free(&cd->resolutions.array[i]);
+	for (size_t i = 0; i < cd->framerates.num; i++)
+		list_free(&cd->framerates.array[i]);
+
+	list_free(&cd->inputs);
+	list_free(&cd->formats);
+	da_free(cd->resolutions);
+	da_free(cd->framerates);
+	bfree(cd->node);
+	bfree(cd->name);
+	bfree(cd);
+}
+
+/*
+ * Get the cached device, scanning it if needed, with cache_mutex locked
+ */
+static struct cache_device *get_device(const char *node)
+{
+	struct cache_device *cd;
+
+	for (size_t i = 0; i < cache_devices.num; i++) {
+		cd = cache_devices.array[i];
+		if (strcmp(cd->node, node) == 0)
+			return cd;
+	}
+
+	cd = scan_device(node);
+	da_push_back(cache_devices, &cd);
+	return cd;
+}
+
+/*
+ * List all device nodes, with cache_mutex locked
+ */
+static void scan_devices(void)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct dstr node;
+
+	dirp = opendir("/sys/class/video4linux");
+	if (!dirp)
+		return;
+
+	dstr_init_copy(&node, "/dev/");
+
+	while ((dp = readdir(dirp)) != NULL) {
+		if (dp->d_type == DT_DIR)
+			continue;
+
+		dstr_resize(&node, 5);
+		dstr_cat(&node, dp->d_name);
+
+		get_device(node.array)->listed = true;
+	}
+
+	closedir(dirp);
+	dstr_free(&node);
+
+	cache_scanned = true;
+}
+
+#if HAVE_UDEV
+/*
+ * Device added or removed callback
+ *
+ * Registered before the callbacks of any source, so the cache is already
+ * up to date when they update their properties.
+ */
+static void device_changed(const char *dev, void *param)
+{
+	UNUSED_PARAMETER(param);
+	v4l2_cache_invalidate(dev);
+}
+#endif
+
+void v4l2_cache_init(void)
+{
+#if HAVE_UDEV
+	cache_udev = v4l2_init_udev();
+	v4l2_set_device_added_callback(cache_udev, device_changed, NULL);
+	v4l2_set_device_removed_callback(cache_udev, device_changed, NULL);
+#endif
+}
+
+void v4l2_cache_free(void)
+{
+#if HAVE_UDEV
+	v4l2_unref_udev(cache_udev);
+	cache_udev = NULL;
+#endif
+
+	v4l2_cache_invalidate(NULL);
+	da_free(cache_devices);
+}
+
+void v4l2_cache_invalidate(const char *device)
+{
+	pthread_mutex_lock(&cache_mutex);
+
+	for (size_t i = cache_devices.num; i > 0; i--) {
+		struct cache_device *cd = cache_devices.array[i - 1];
+
+		if (!device || strcmp(cd->node, device) == 0) {
+			free_device(cd);
+			da_erase(cache_devices, i - 1);
+		}
+	}
+
+	/* a new device has to show up in the list as well */
+	cache_scanned = false;
+
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+void v4l2_cache_list_devices(obs_property_t *prop, const char *cur_device)
+{
+	bool cur_device_found = false;
+	size_t cur_device_index;
+
+	obs_property_list_clear(prop);
+
+	pthread_mutex_lock(&cache_mutex);
+
+	if (!cache_scanned)
+		scan_devices();
+
+	for (size_t i = 0; i < cache_devices.num; i++) {
+		struct cache_device *cd = cache_devices.array[i];
+
+		if (!cd->listed || !cd->available)
+			continue;
+
+		obs_property_list_add_string(prop, cd->name, cd->node);
+
+		/* check if this is the currently used device */
+		if (cur_device && !strcmp(cur_device, cd->node))
+			cur_device_found = true;
+	}
+
+	pthread_mutex_unlock(&cache_mutex);
+
+	/* add currently selected device if not present, but disable it ... */
+	if (!cur_device_found && cur_device && strlen(cur_device)) {
+		cur_device_index = obs_property_list_add_string(prop,
+				cur_device, cur_device);
+		obs_property_list_item_disable(prop, cur_device_index, true);
+	}
+}
+
+bool v4l2_cache_list_inputs(const char *device, obs_property_t *prop)
+{
+	struct cache_device *cd;
+	bool available;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	cd = get_device(device);
+	available = cd->available;
+	if (available)
+		list_to_property(&cd->inputs, prop);
+
+	pthread_mutex_unlock(&cache_mutex);
+	return available;
+}
+
+bool v4l2_cache_list_formats(const char *device, obs_property_t *prop)
+{
+	struct cache_device *cd;
+	bool available;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	cd = get_device(device);
+	available = cd->available;
+	if (available)
+		list_to_property(&cd->formats, prop);
+
+	pthread_mutex_unlock(&cache_mutex);
+	return available;
+}
+
+bool v4l2_cache_list_resolutions(const char *device, uint32_t pixelformat,
+		obs_property_t *prop)
+{
+	struct cache_device *cd;
+	struct cache_list *list = NULL;
+	int fd;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	cd = get_device(device);
+	if (!cd->available)
+		goto unlock;
+
+	list = list_find(cd->resolutions.array, cd->resolutions.num,
+			pixelformat, 0);
+	if (!list) {
+		if ((fd = v4l2_open(device, O_RDWR | O_NONBLOCK)) == -1)
+			goto unlock;
+
+		list = da_push_back_new(cd->resolutions);
+		list->pixelformat = pixelformat;
+		enum_resolutions(fd, pixelformat, list);
+		v4l2_close(fd);
+	}
+
+	list_to_property(list, prop);
+
+unlock:
+	pthread_mutex_unlock(&cache_mutex);
+	return list != NULL;
+}
+
+bool v4l2_cache_list_framerates(const char *device, uint32_t pixelformat,
+		int resolution, obs_property_t *prop)
+{
+	struct cache_device *cd;
+	struct cache_list *list = NULL;
+	int fd;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	cd = get_device(device);
+	if (!cd->available)
+		goto unlock;
+
+	list = list_find(cd->framerates.array, cd->framerates.num,
+			pixelformat, resolution);
+	if (!list) {
+		if ((fd = v4l2_open(device, O_RDWR | O_NONBLOCK)) == -1)
+			goto unlock;
+
+		list = da_push_back_new(cd->framerates);
+		list->pixelformat = pixelformat;
+		list->resolution  = resolution;
+		enum_framerates(fd, pixelformat, resolution, list);
+		v4l2_close(fd);
+	}
+
+	list_to_property(list, prop);
+
+unlock:
+	pthread_mutex_unlock(&cache_mutex);
+	return list != NULL;
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache of the devices and their capabilities shown in the properties
+ *
+ * Devices are only opened and queried the first time they are listed, after
+ * that the lists are filled from the cache. With udev the cache entry of a
+ * device is dropped when it is added or removed, without udev the whole cache
+ * is dropped whenever new properties are created.
+ */
+
+/**
+ * Set up the cache and start watching for device changes
+ */
+void v4l2_cache_init(void);
+
+/**
+ * Free the cache
+ */
+void v4l2_cache_free(void);
+
+/**
+ * Drop cached information
+ *
+ * @param device device node of the device that changed, or NULL to drop
+ *               everything
+ */
+void v4l2_cache_invalidate(const char *device);
+
+/**
+ * List available devices
+ *
+ * @param prop property list to fill with the device names and nodes
+ * @param cur_device currently selected device, added disabled if it is not
+ *                   available
+ */
+void v4l2_cache_list_devices(obs_property_t *prop, const char *cur_device);
+
+/**
+ * List inputs of a device
+ *
+ * @return false if the device could not be opened
+ */
+bool v4l2_cache_list_inputs(const char *device, obs_property_t *prop);
+
+/**
+ * List supported pixel formats of a device
+ *
+ * @return false if the device could not be opened
+ */
+bool v4l2_cache_list_formats(const char *device, obs_property_t *prop);
+
+/**
+ * List resolutions of a device for a pixel format
+ *
+ * @return false if the device could not be opened
+ */
+bool v4l2_cache_list_resolutions(const char *device, uint32_t pixelformat,
+		obs_property_t *prop);
+
+/**
+ * List framerates of a device for a pixel format and resolution
+ *
+ * @param resolution packed resolution tuple
+ *
+ * @return false if the device could not be opened
+ */
+bool v4l2_cache_list_framerates(const char *device, uint32_t pixelformat,
+		int resolution, obs_property_t *prop);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,7 +20,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <inttypes.h>
 #include <fcntl.h>
-#include <dirent.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
@@ -30,12 +29,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <libv4l2.h>
 
 #include <util/threading.h>
+#include <util/darray.h>
 #include <util/bmem.h>
 #include <util/dstr.h>
 #include <util/platform.h>
 #include <obs-module.h>
 
 #include "v4l2-helpers.h"
+#include "v4l2-cache.h"
 
 #if HAVE_UDEV
 #include "v4l2-udev.h"
@@ -49,10 +50,65 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
 /**
- * Data structure for the v4l2 source
+ * Minimum number of buffers that have to stay queued in the driver
+ *
+ * Buffers are handed to libobs without copying them, as long as this many
+ * buffers are left for the driver to capture into. Otherwise the frame is
+ * copied and the buffer is returned to the driver right away.
  */
-struct v4l2_data {
-	/* settings */
+#define V4L2_MIN_QUEUED_BUFFERS 2
+
+/**
+ * Frame referencing a mapped buffer that is owned by libobs
+ */
+struct v4l2_pool_frame {
+	/** the frame passed to libobs, must be the first member */
+	struct obs_source_frame frame;
+	/** index of the buffer the frame data points to */
+	uint32_t index;
+};
+
+/**
+ * A dequeued buffer, queued again once every frame output from it was
+ * released
+ */
+struct v4l2_pool_buffer {
+	struct v4l2_buffer buf;
+	volatile long refs;
+	/** one frame for each source the buffer was output to */
+	DARRAY(struct v4l2_pool_frame) frames;
+};
+
+/**
+ * Mapped buffers shared with the frames output to libobs
+ *
+ * Every frame held by libobs keeps a reference, so the mapped buffers and the
+ * device they belong to stay valid until the last frame was released, even if
+ * the capture was stopped or the source destroyed in the meantime.
+ */
+struct v4l2_buffer_pool {
+	volatile long refs;
+	pthread_mutex_t mutex;
+	/** device handle, closed with the pool */
+	int_fast32_t dev;
+	/** set while the stream is on and buffers can be queued */
+	bool streaming;
+	/** number of buffers currently queued in the driver */
+	uint_fast32_t queued;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_pool_buffer *dequeued;
+};
+
+/**
+ * Capture from one device, shared by all sources using the device
+ *
+ * The first source that starts capturing from a device opens it with its
+ * settings. Sources using the same device later on get the same frames
+ * instead of failing to open the device a second time, so the device is only
+ * captured from (and its frames only copied or mapped) once.
+ */
+struct v4l2_device {
+	/* settings the device was opened with */
 	char *device_id;
 	int input;
 	int pixfmt;
@@ -60,23 +116,59 @@ struct v4l2_data {
 	int framerate;
 	bool sys_timing;
 
-	/* internal data */
-	obs_source_t *source;
 	pthread_t thread;
 	os_event_t *event;
-	void *udev;
 
 	int_fast32_t dev;
 	int width;
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+	struct v4l2_buffer_pool *pool;
+
+	/** sources the frames are output to */
+	pthread_mutex_t sources_mutex;
+	DARRAY(obs_source_t*) sources;
 };
 
+/**
+ * Data structure for the v4l2 source
+ */
+struct v4l2_data {
+	/* settings */
+	char *device_id;
+	int input;
+	int pixfmt;
+	int resolution;
+	int framerate;
+	bool sys_timing;
+	bool deactivate_hidden;
+
+	/* internal data */
+	bool showing;
+	obs_source_t *source;
+	void *udev;
+
+	struct v4l2_device *device;
+};
+
+/** devices currently captured from, and the mutex for opening/closing them */
+static pthread_mutex_t devices_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct v4l2_device*) devices;
+
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 
+/**
+ * Check if the device should be open, which is always unless the source is
+ * set to be deactivated while it's not shown
+ */
+static inline bool v4l2_should_capture(struct v4l2_data *data)
+{
+	return !data->deactivate_hidden || data->showing;
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -88,51 +180,192 @@ static void v4l2_terminate(struct v4l2_data *data);
  * offsets to add to the start address in order to give obs the correct data
  * pointers for the individual planes.
  */
-static void v4l2_prep_obs_frame(struct v4l2_data *data,
+static void v4l2_prep_obs_frame(struct v4l2_device *device,
 	struct obs_source_frame *frame, size_t *plane_offsets)
 {
 	memset(frame, 0, sizeof(struct obs_source_frame));
 	memset(plane_offsets, 0, sizeof(size_t) * MAX_AV_PLANES);
 
-	frame->width = data->width;
-	frame->height = data->height;
-	frame->format = v4l2_to_obs_video_format(data->pixfmt);
+	frame->width = device->width;
+	frame->height = device->height;
+	frame->format = v4l2_to_obs_video_format(device->pixfmt);
 	video_format_get_parameters(VIDEO_CS_DEFAULT, VIDEO_RANGE_PARTIAL,
 		frame->color_matrix, frame->color_range_min,
 		frame->color_range_max);
 
-	switch(data->pixfmt) {
+	switch(device->pixfmt) {
 	case V4L2_PIX_FMT_NV12:
-		frame->linesize[0] = data->linesize;
-		frame->linesize[1] = data->linesize / 2;
-		plane_offsets[1] = data->linesize * data->height;
+		frame->linesize[0] = device->linesize;
+		frame->linesize[1] = device->linesize / 2;
+		plane_offsets[1] = device->linesize * device->height;
 		break;
 	case V4L2_PIX_FMT_YVU420:
-		frame->linesize[0] = data->linesize;
-		frame->linesize[1] = data->linesize / 2;
-		frame->linesize[2] = data->linesize / 2;
-		plane_offsets[1] = data->linesize * data->height * 5 / 4;
-		plane_offsets[2] = data->linesize * data->height;
+		frame->linesize[0] = device->linesize;
+		frame->linesize[1] = device->linesize / 2;
+		frame->linesize[2] = device->linesize / 2;
+		plane_offsets[1] = device->linesize * device->height * 5 / 4;
+		plane_offsets[2] = device->linesize * device->height;
 		break;
 	case V4L2_PIX_FMT_YUV420:
-		frame->linesize[0] = data->linesize;
-		frame->linesize[1] = data->linesize / 2;
-		frame->linesize[2] = data->linesize / 2;
-		plane_offsets[1] = data->linesize * data->height;
-		plane_offsets[2] = data->linesize * data->height * 5 / 4;
+		frame->linesize[0] = device->linesize;
+		frame->linesize[1] = device->linesize / 2;
+		frame->linesize[2] = device->linesize / 2;
+		plane_offsets[1] = device->linesize * device->height;
+		plane_offsets[2] = device->linesize * device->height * 5 / 4;
 		break;
 	default:
-		frame->linesize[0] = data->linesize;
+		frame->linesize[0] = device->linesize;
 		break;
 	}
 }
 
+/**
+ * Create the buffer pool, taking ownership of the device and mapped buffers
+ */
+static struct v4l2_buffer_pool *v4l2_pool_create(int_fast32_t dev,
+		struct v4l2_buffer_data *buffers)
+{
+	struct v4l2_buffer_pool *pool = bzalloc(sizeof(*pool));
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	pool->refs     = 1;
+	pool->dev      = dev;
+	pool->buffers  = *buffers;
+	pool->dequeued = bzalloc(buffers->count *
+			sizeof(struct v4l2_pool_buffer));
+	memset(buffers, 0, sizeof(*buffers));
+
+	return pool;
+}
+
+static void v4l2_pool_release(struct v4l2_buffer_pool *pool)
+{
+	if (os_atomic_dec_long(&pool->refs) != 0)
+		return;
+
+	for (uint_fast32_t i = 0; i < pool->buffers.count; ++i)
+		da_free(pool->dequeued[i].frames);
+
+	v4l2_destroy_mmap(&pool->buffers);
+	v4l2_close(pool->dev);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->dequeued);
+	bfree(pool);
+}
+
+/**
+ * Queue a buffer in the driver again
+ *
+ * @return negative if the buffer could not be queued
+ */
+static int_fast32_t v4l2_pool_requeue(struct v4l2_buffer_pool *pool,
+		struct v4l2_buffer *buf)
+{
+	int_fast32_t ret = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	/* buffers are not queued again after the stream is off */
+	if (pool->streaming) {
+		if (v4l2_ioctl(pool->dev, VIDIOC_QBUF, buf) < 0)
+			ret = -1;
+		else
+			pool->queued++;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+	return ret;
+}
+
+/**
+ * Called by libobs when a frame is no longer used
+ */
+static void v4l2_frame_release(void *param, struct obs_source_frame *frame)
+{
+	struct v4l2_buffer_pool *pool = param;
+	struct v4l2_pool_frame *pool_frame = (struct v4l2_pool_frame *) frame;
+	struct v4l2_pool_buffer *pool_buf = &pool->dequeued[pool_frame->index];
+
+	if (os_atomic_dec_long(&pool_buf->refs) == 0) {
+		if (v4l2_pool_requeue(pool, &pool_buf->buf) < 0)
+			blog(LOG_DEBUG, "failed to enqueue buffer");
+	}
+
+	v4l2_pool_release(pool);
+}
+
+/**
+ * Pass a dequeued buffer to all sources using the device
+ *
+ * @return negative if the buffer could not be queued again
+ */
+static int_fast32_t v4l2_output_buffer(struct v4l2_device *device,
+		struct v4l2_buffer *buf, struct obs_source_frame *out)
+{
+	struct v4l2_buffer_pool *pool = device->pool;
+	struct v4l2_pool_buffer *pool_buf = &pool->dequeued[buf->index];
+	bool zero_copy;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->queued--;
+	zero_copy = pool->queued >= V4L2_MIN_QUEUED_BUFFERS;
+	pthread_mutex_unlock(&pool->mutex);
+
+	pthread_mutex_lock(&device->sources_mutex);
+
+	if (zero_copy) {
+		/* no frame refers to the buffer while it's dequeued, so the
+		 * frames can be resized, the extra reference is held until
+		 * the buffer was output to every source */
+		da_resize(pool_buf->frames, device->sources.num);
+		pool_buf->buf  = *buf;
+		pool_buf->refs = 1;
+	}
+
+	for (size_t i = 0; i < device->sources.num; i++) {
+		obs_source_t *source = device->sources.array[i];
+		struct v4l2_pool_frame *pool_frame;
+
+		/* the frame would only replace an older one that was never
+		 * shown, so it isn't output to this source at all */
+		if (obs_source_async_queue_full(source))
+			continue;
+
+		if (!zero_copy) {
+			obs_source_output_video(source, out);
+			continue;
+		}
+
+		pool_frame = &pool_buf->frames.array[i];
+		pool_frame->frame               = *out;
+		pool_frame->frame.release       = v4l2_frame_release;
+		pool_frame->frame.release_param = pool;
+		pool_frame->index               = buf->index;
+
+		os_atomic_inc_long(&pool_buf->refs);
+		os_atomic_inc_long(&pool->refs);
+		obs_source_output_video_owned(source, &pool_frame->frame);
+	}
+
+	pthread_mutex_unlock(&device->sources_mutex);
+
+	/* a source still holds a frame, it queues the buffer on release */
+	if (zero_copy && os_atomic_dec_long(&pool_buf->refs) != 0)
+		return 0;
+
+	return v4l2_pool_requeue(pool, buf);
+}
+
 /*
  * Worker thread to get video data
  */
 static void *v4l2_thread(void *vptr)
 {
-	V4L2_DATA(vptr);
+	struct v4l2_device *device = vptr;
 	int r;
 	fd_set fds;
 	uint8_t *start;
@@ -143,20 +376,28 @@ static void *v4l2_thread(void *vptr)
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	pthread_mutex_lock(&device->pool->mutex);
+	r = v4l2_start_capture(device->dev, &device->pool->buffers);
+	if (r == 0) {
+		device->pool->streaming = true;
+		device->pool->queued    = device->pool->buffers.count;
+	}
+	pthread_mutex_unlock(&device->pool->mutex);
+
+	if (r < 0)
 		goto exit;
 
 	frames   = 0;
 	first_ts = 0;
-	v4l2_prep_obs_frame(data, &out, plane_offsets);
+	v4l2_prep_obs_frame(device, &out, plane_offsets);
 
-	while (os_event_try(data->event) == EAGAIN) {
+	while (os_event_try(device->event) == EAGAIN) {
 		FD_ZERO(&fds);
-		FD_SET(data->dev, &fds);
+		FD_SET(device->dev, &fds);
 		tv.tv_sec = 1;
 		tv.tv_usec = 0;
 
-		r = select(data->dev + 1, &fds, NULL, NULL, &tv);
+		r = select(device->dev + 1, &fds, NULL, NULL, &tv);
 		if (r < 0) {
 			if (errno == EINTR)
 				continue;
@@ -170,14 +411,14 @@ static void *v4l2_thread(void *vptr)
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.memory = V4L2_MEMORY_MMAP;
 
-		if (v4l2_ioctl(data->dev, VIDIOC_DQBUF, &buf) < 0) {
+		if (v4l2_ioctl(device->dev, VIDIOC_DQBUF, &buf) < 0) {
 			if (errno == EAGAIN)
 				continue;
 			blog(LOG_DEBUG, "failed to dequeue buffer");
 			break;
 		}
 
-		out.timestamp = data->sys_timing ?
+		out.timestamp = device->sys_timing ?
 			os_gettime_ns() : timeval2ns(buf.timestamp);
 
 		if (!frames)
@@ -185,12 +426,11 @@ static void *v4l2_thread(void *vptr)
 
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *) data->buffers.info[buf.index].start;
+		start = (uint8_t *) device->pool->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+		if (v4l2_output_buffer(device, &buf, &out) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
 			break;
 		}
@@ -201,7 +441,11 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
 
 exit:
-	v4l2_stop_capture(data->dev);
+	/* buffers held by obs are not queued again after the stream is off */
+	pthread_mutex_lock(&device->pool->mutex);
+	device->pool->streaming = false;
+	v4l2_stop_capture(device->dev);
+	pthread_mutex_unlock(&device->pool->mutex);
 	return NULL;
 }
 
@@ -217,6 +461,8 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "resolution", -1);
 	obs_data_set_default_int(settings, "framerate", -1);
 	obs_data_set_default_bool(settings, "system_timing", false);
+	obs_data_set_default_bool(settings, "deactivate_when_not_showing",
+			false);
 }
 
 /**
@@ -243,260 +489,21 @@ static void v4l2_props_set_enabled(obs_properties_t *props,
 	}
 }
 
-/*
- * List available devices
- */
-static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
-{
-	DIR *dirp;
-	struct dirent *dp;
-	struct dstr device;
-	bool cur_device_found;
-	size_t cur_device_index;
-	const char *cur_device_name;
-
-	dirp = opendir("/sys/class/video4linux");
-	if (!dirp)
-		return;
-
-	cur_device_found = false;
-	cur_device_name  = obs_data_get_string(settings, "device_id");
-
-	obs_property_list_clear(prop);
-
-	dstr_init_copy(&device, "/dev/");
-
-	while ((dp = readdir(dirp)) != NULL) {
-		int fd;
-		uint32_t caps;
-		struct v4l2_capability video_cap;
-
-		if (dp->d_type == DT_DIR)
-			continue;
-
-		dstr_resize(&device, 5);
-		dstr_cat(&device, dp->d_name);
-
-		if ((fd = v4l2_open(device.array, O_RDWR | O_NONBLOCK)) == -1) {
-			blog(LOG_INFO, "Unable to open %s", device.array);
-			continue;
-		}
-
-		if (v4l2_ioctl(fd, VIDIOC_QUERYCAP, &video_cap) == -1) {
-			blog(LOG_INFO, "Failed to query capabilities for %s",
-			     device.array);
-			v4l2_close(fd);
-			continue;
-		}
-
-		caps = (video_cap.capabilities & V4L2_CAP_DEVICE_CAPS)
-			? video_cap.device_caps
-			: video_cap.capabilities;
-
-		if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
-			blog(LOG_INFO, "%s seems to not support video capture",
-			     device.array);
-			v4l2_close(fd);
-			continue;
-		}
-
-		obs_property_list_add_string(prop, (char *) video_cap.card,
-				device.array);
-		blog(LOG_INFO, "Found device '%s' at %s", video_cap.card,
-				device.array);
-
-		/* check if this is the currently used device */
-		if (cur_device_name && !strcmp(cur_device_name, device.array))
-			cur_device_found = true;
-
-		v4l2_close(fd);
-	}
-
-	/* add currently selected device if not present, but disable it ... */
-	if (!cur_device_found && cur_device_name && strlen(cur_device_name)) {
-		cur_device_index = obs_property_list_add_string(prop,
-				cur_device_name, cur_device_name);
-		obs_property_list_item_disable(prop, cur_device_index, true);
-	}
-
-	closedir(dirp);
-	dstr_free(&device);
-}
-
-/*
- * List inputs for device
- */
-static void v4l2_input_list(int_fast32_t dev, obs_property_t *prop)
-{
-	struct v4l2_input in;
-	memset(&in, 0, sizeof(in));
-
-	obs_property_list_clear(prop);
-
-	obs_property_list_add_int(prop, obs_module_text("LeaveUnchanged"), -1);
-
-	while (v4l2_ioctl(dev, VIDIOC_ENUMINPUT, &in) == 0) {
-		if (in.type & V4L2_INPUT_TYPE_CAMERA) {
-			obs_property_list_add_int(prop, (char *) in.name,
-					in.index);
-			blog(LOG_INFO, "Found input '%s' (Index %d)", in.name,
-					in.index);
-		}
-		in.index++;
-	}
-}
-
-/*
- * List formats for device
- */
-static void v4l2_format_list(int dev, obs_property_t *prop)
-{
-	struct v4l2_fmtdesc fmt;
-	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	fmt.index = 0;
-	struct dstr buffer;
-	dstr_init(&buffer);
-
-	obs_property_list_clear(prop);
-
-	obs_property_list_add_int(prop, obs_module_text("LeaveUnchanged"), -1);
-
-	while (v4l2_ioctl(dev, VIDIOC_ENUM_FMT, &fmt) == 0) {
-		dstr_copy(&buffer, (char *) fmt.description);
-		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
-			dstr_cat(&buffer, " (Emulated)");
-
-		if (v4l2_to_obs_video_format(fmt.pixelformat)
-				!= VIDEO_FORMAT_NONE) {
-			obs_property_list_add_int(prop, buffer.array,
-					fmt.pixelformat);
-			blog(LOG_INFO, "Pixelformat: %s (available)",
-			     buffer.array);
-		} else {
-			blog(LOG_INFO, "Pixelformat: %s (unavailable)",
-			     buffer.array);
-		}
-		fmt.index++;
-	}
-
-	dstr_free(&buffer);
-}
-
-/*
- * List resolutions for device and format
- */
-static void v4l2_resolution_list(int dev, uint_fast32_t pixelformat,
-		obs_property_t *prop)
-{
-	struct v4l2_frmsizeenum frmsize;
-	frmsize.pixel_format = pixelformat;
-	frmsize.index = 0;
-	struct dstr buffer;
-	dstr_init(&buffer);
-
-	obs_property_list_clear(prop);
-
-	obs_property_list_add_int(prop, obs_module_text("LeaveUnchanged"), -1);
-
-	v4l2_ioctl(dev, VIDIOC_ENUM_FRAMESIZES, &frmsize);
-
-	switch(frmsize.type) {
-	case V4L2_FRMSIZE_TYPE_DISCRETE:
-		while (v4l2_ioctl(dev, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0) {
-			dstr_printf(&buffer, "%dx%d", frmsize.discrete.width,
-					frmsize.discrete.height);
-			obs_property_list_add_int(prop, buffer.array,
-					v4l2_pack_tuple(frmsize.discrete.width,
-					frmsize.discrete.height));
-			frmsize.index++;
-		}
-		break;
-	default:
-		blog(LOG_INFO, "Stepwise and Continuous framesizes "
-			"are currently hardcoded");
-
-		for (const int *packed = v4l2_framesizes; *packed; ++packed) {
-			int width;
-			int height;
-			v4l2_unpack_tuple(&width, &height, *packed);
-			dstr_printf(&buffer, "%dx%d", width, height);
-			obs_property_list_add_int(prop, buffer.array, *packed);
-		}
-		break;
-	}
-
-	dstr_free(&buffer);
-}
-
-/*
- * List framerates for device and resolution
- */
-static void v4l2_framerate_list(int dev, uint_fast32_t pixelformat,
-		uint_fast32_t width, uint_fast32_t height, obs_property_t *prop)
-{
-	struct v4l2_frmivalenum frmival;
-	frmival.pixel_format = pixelformat;
-	frmival.width = width;
-	frmival.height = height;
-	frmival.index = 0;
-	struct dstr buffer;
-	dstr_init(&buffer);
-
-	obs_property_list_clear(prop);
-
-	obs_property_list_add_int(prop, obs_module_text("LeaveUnchanged"), -1);
-
-	v4l2_ioctl(dev, VIDIOC_ENUM_FRAMEINTERVALS, &frmival);
-
-	switch(frmival.type) {
-	case V4L2_FRMIVAL_TYPE_DISCRETE:
-		while (v4l2_ioctl(dev, VIDIOC_ENUM_FRAMEINTERVALS,
-				&frmival) == 0) {
-			float fps = (float) frmival.discrete.denominator /
-				frmival.discrete.numerator;
-			int pack = v4l2_pack_tuple(frmival.discrete.numerator,
-					frmival.discrete.denominator);
-			dstr_printf(&buffer, "%.2f", fps);
-			obs_property_list_add_int(prop, buffer.array, pack);
-			frmival.index++;
-		}
-		break;
-	default:
-		blog(LOG_INFO, "Stepwise and Continuous framerates "
-			"are currently hardcoded");
-
-		for (const int *packed = v4l2_framerates; *packed; ++packed) {
-			int num;
-			int denom;
-			v4l2_unpack_tuple(&num, &denom, *packed);
-			float fps = (float) denom / num;
-			dstr_printf(&buffer, "%.2f", fps);
-			obs_property_list_add_int(prop, buffer.array, *packed);
-		}
-		break;
-	}
-
-	dstr_free(&buffer);
-}
-
 /*
  * Device selected callback
  */
 static bool device_selected(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
-	int dev = v4l2_open(obs_data_get_string(settings, "device_id"),
-			O_RDWR | O_NONBLOCK);
+	obs_property_t *prop = obs_properties_get(props, "input");
+	bool available = v4l2_cache_list_inputs(
+			obs_data_get_string(settings, "device_id"), prop);
 
-	v4l2_props_set_enabled(props, p, (dev == -1) ? false : true);
+	v4l2_props_set_enabled(props, p, available);
 
-	if (dev == -1)
+	if (!available)
 		return false;
 
-	obs_property_t *prop = obs_properties_get(props, "input");
-	v4l2_input_list(dev, prop);
-	v4l2_close(dev);
-
 	obs_property_modified(prop, settings);
 
 	return true;
@@ -509,14 +516,10 @@ static bool input_selected(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
 	UNUSED_PARAMETER(p);
-	int dev = v4l2_open(obs_data_get_string(settings, "device_id"),
-			O_RDWR | O_NONBLOCK);
-	if (dev == -1)
-		return false;
-
 	obs_property_t *prop = obs_properties_get(props, "pixelformat");
-	v4l2_format_list(dev, prop);
-	v4l2_close(dev);
+	if (!v4l2_cache_list_formats(obs_data_get_string(settings, "device_id"),
+			prop))
+		return false;
 
 	obs_property_modified(prop, settings);
 
@@ -530,15 +533,11 @@ static bool format_selected(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
 	UNUSED_PARAMETER(p);
-	int dev = v4l2_open(obs_data_get_string(settings, "device_id"),
-			O_RDWR | O_NONBLOCK);
-	if (dev == -1)
-		return false;
-
 	obs_property_t *prop = obs_properties_get(props, "resolution");
-	v4l2_resolution_list(dev, obs_data_get_int(settings, "pixelformat"),
-			prop);
-	v4l2_close(dev);
+	if (!v4l2_cache_list_resolutions(
+			obs_data_get_string(settings, "device_id"),
+			obs_data_get_int(settings, "pixelformat"), prop))
+		return false;
 
 	obs_property_modified(prop, settings);
 
@@ -552,18 +551,12 @@ static bool resolution_selected(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
 	UNUSED_PARAMETER(p);
-	int width, height;
-	int dev = v4l2_open(obs_data_get_string(settings, "device_id"),
-			O_RDWR | O_NONBLOCK);
-	if (dev == -1)
-		return false;
-
 	obs_property_t *prop = obs_properties_get(props, "framerate");
-	v4l2_unpack_tuple(&width, &height, obs_data_get_int(settings,
-				"resolution"));
-	v4l2_framerate_list(dev, obs_data_get_int(settings, "pixelformat"),
-			width, height, prop);
-	v4l2_close(dev);
+	if (!v4l2_cache_list_framerates(
+			obs_data_get_string(settings, "device_id"),
+			obs_data_get_int(settings, "pixelformat"),
+			obs_data_get_int(settings, "resolution"), prop))
+		return false;
 
 	obs_property_modified(prop, settings);
 
@@ -588,7 +581,8 @@ static void device_added(const char *dev, void *vptr)
 
 	blog(LOG_INFO, "Device %s reconnected", dev);
 
-	v4l2_init(data);
+	if (v4l2_should_capture(data))
+		v4l2_init(data);
 }
 /**
  * Device removed callback
@@ -640,8 +634,18 @@ static obs_properties_t *v4l2_properties(void *vptr)
 	obs_properties_add_bool(props,
 			"system_timing", obs_module_text("UseSystemTiming"));
 
+	obs_properties_add_bool(props, "deactivate_when_not_showing",
+			obs_module_text("DeactivateWhenNotShowing"));
+
+#if !HAVE_UDEV
+	/* without hotplug notifications, check for changes at least every
+	 * time the properties are shown */
+	v4l2_cache_invalidate(NULL);
+#endif
+
 	obs_data_t *settings = obs_source_get_settings(data->source);
-	v4l2_device_list(device_list, settings);
+	v4l2_cache_list_devices(device_list,
+			obs_data_get_string(settings, "device_id"));
 	obs_data_release(settings);
 
 	obs_property_set_modified_callback(device_list, device_selected);
@@ -653,44 +657,43 @@ static obs_properties_t *v4l2_properties(void *vptr)
 	return props;
 }
 
-static void v4l2_terminate(struct v4l2_data *data)
+/**
+ * Stop the capture and free the device
+ */
+static void v4l2_device_close(struct v4l2_device *device)
 {
-	if (data->thread) {
-		os_event_signal(data->event);
-		pthread_join(data->thread, NULL);
-		os_event_destroy(data->event);
-		data->thread = 0;
+	if (device->thread) {
+		os_event_signal(device->event);
+		pthread_join(device->thread, NULL);
+		os_event_destroy(device->event);
+		device->thread = 0;
 	}
 
-	v4l2_destroy_mmap(&data->buffers);
+	if (device->pool) {
+		/* the pool closes the device once obs released all frames,
+		 * wait a bit for the frame being rendered so that the device
+		 * can be opened again right away */
+		for (int i = 0; i < 100 && device->pool->refs > 1; i++)
+			os_sleep_ms(1);
 
-	if (data->dev != -1) {
-		v4l2_close(data->dev);
-		data->dev = -1;
+		v4l2_pool_release(device->pool);
+		device->pool = NULL;
+		device->dev = -1;
 	}
-}
 
-static void v4l2_destroy(void *vptr)
-{
-	V4L2_DATA(vptr);
+	v4l2_destroy_mmap(&device->buffers);
 
-	if (!data)
-		return;
-
-	v4l2_terminate(data);
-
-	if (data->device_id)
-		bfree(data->device_id);
-
-#if HAVE_UDEV
-	v4l2_unref_udev(data->udev);
-#endif
+	if (device->dev != -1)
+		v4l2_close(device->dev);
 
-	bfree(data);
+	pthread_mutex_destroy(&device->sources_mutex);
+	da_free(device->sources);
+	bfree(device->device_id);
+	bfree(device);
 }
 
 /**
- * Initialize the v4l2 device
+ * Open a device with the settings of the source
  *
  * This function:
  * - tries to open the device
@@ -699,77 +702,238 @@ static void v4l2_destroy(void *vptr)
  * - maps the buffers
  * - starts the capture thread
  */
-static void v4l2_init(struct v4l2_data *data)
+static struct v4l2_device *v4l2_device_open(struct v4l2_data *data)
 {
+	struct v4l2_device *device = bzalloc(sizeof(struct v4l2_device));
 	int fps_num, fps_denom;
 
-	blog(LOG_INFO, "Start capture from %s", data->device_id);
-	data->dev = v4l2_open(data->device_id, O_RDWR | O_NONBLOCK);
-	if (data->dev == -1) {
+	device->dev        = -1;
+	device->device_id  = bstrdup(data->device_id);
+	device->input      = data->input;
+	device->pixfmt     = data->pixfmt;
+	device->resolution = data->resolution;
+	device->framerate  = data->framerate;
+	device->sys_timing = data->sys_timing;
+
+	if (pthread_mutex_init(&device->sources_mutex, NULL) != 0) {
+		bfree(device->device_id);
+		bfree(device);
+		return NULL;
+	}
+
+	blog(LOG_INFO, "Start capture from %s", device->device_id);
+	device->dev = v4l2_open(device->device_id, O_RDWR | O_NONBLOCK);
+	if (device->dev == -1) {
 		blog(LOG_ERROR, "Unable to open device");
 		goto fail;
 	}
 
 	/* set input */
-	if (v4l2_set_input(data->dev, &data->input) < 0) {
-		blog(LOG_ERROR, "Unable to set input %d", data->input);
+	if (v4l2_set_input(device->dev, &device->input) < 0) {
+		blog(LOG_ERROR, "Unable to set input %d", device->input);
 		goto fail;
 	}
-	blog(LOG_INFO, "Input: %d", data->input);
+	blog(LOG_INFO, "Input: %d", device->input);
 
 	/* set pixel format and resolution */
-	if (v4l2_set_format(data->dev, &data->resolution, &data->pixfmt,
-			&data->linesize) < 0) {
+	if (v4l2_set_format(device->dev, &device->resolution,
+			&device->pixfmt, &device->linesize) < 0) {
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (v4l2_to_obs_video_format(device->pixfmt) == VIDEO_FORMAT_NONE) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
-	v4l2_unpack_tuple(&data->width, &data->height, data->resolution);
-	blog(LOG_INFO, "Resolution: %dx%d", data->width, data->height);
-	blog(LOG_INFO, "Pixelformat: %d", data->pixfmt);
-	blog(LOG_INFO, "Linesize: %d Bytes", data->linesize);
+	v4l2_unpack_tuple(&device->width, &device->height,
+			device->resolution);
+	blog(LOG_INFO, "Resolution: %dx%d", device->width, device->height);
+	blog(LOG_INFO, "Pixelformat: %d", device->pixfmt);
+	blog(LOG_INFO, "Linesize: %d Bytes", device->linesize);
 
 	/* set framerate */
-	if (v4l2_set_framerate(data->dev, &data->framerate) < 0) {
+	if (v4l2_set_framerate(device->dev, &device->framerate) < 0) {
 		blog(LOG_ERROR, "Unable to set framerate");
 		goto fail;
 	}
-	v4l2_unpack_tuple(&fps_num, &fps_denom, data->framerate);
+	v4l2_unpack_tuple(&fps_num, &fps_denom, device->framerate);
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	if (v4l2_create_mmap(device->dev, &device->buffers) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
 
+	device->pool = v4l2_pool_create(device->dev, &device->buffers);
+	if (!device->pool)
+		goto fail;
+
 	/* start the capture thread */
-	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
+	if (os_event_init(&device->event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
-	if (pthread_create(&data->thread, NULL, v4l2_thread, data) != 0)
+	if (pthread_create(&device->thread, NULL, v4l2_thread, device) != 0)
 		goto fail;
-	return;
+	return device;
 fail:
 	blog(LOG_ERROR, "Initialization failed");
+	v4l2_device_close(device);
+	return NULL;
+}
+
+/**
+ * Find a device that is already captured from, with devices_mutex locked
+ */
+static struct v4l2_device *v4l2_find_device(const char *device_id)
+{
+	for (size_t i = 0; i < devices.num; i++) {
+		if (strcmp(devices.array[i]->device_id, device_id) == 0)
+			return devices.array[i];
+	}
+
+	return NULL;
+}
+
+static inline bool v4l2_device_matches(struct v4l2_device *device,
+		struct v4l2_data *data)
+{
+	return device->input      == data->input      &&
+	       device->pixfmt     == data->pixfmt     &&
+	       device->resolution == data->resolution &&
+	       device->framerate  == data->framerate  &&
+	       device->sys_timing == data->sys_timing;
+}
+
+/**
+ * Stop capturing for the source
+ *
+ * The device itself is only closed once no other source uses it anymore.
+ */
+static void v4l2_terminate(struct v4l2_data *data)
+{
+	struct v4l2_device *device = data->device;
+	bool last;
+
+	if (!device)
+		return;
+
+	pthread_mutex_lock(&devices_mutex);
+
+	pthread_mutex_lock(&device->sources_mutex);
+	da_erase_item(device->sources, &data->source);
+	last = device->sources.num == 0;
+	pthread_mutex_unlock(&device->sources_mutex);
+
+	/* release the frames of the device this source still holds */
+	obs_source_flush_video(data->source);
+
+	if (last) {
+		da_erase_item(devices, &device);
+		v4l2_device_close(device);
+	}
+
+	pthread_mutex_unlock(&devices_mutex);
+
+	data->device = NULL;
+}
+
+static void v4l2_destroy(void *vptr)
+{
+	V4L2_DATA(vptr);
+
+	if (!data)
+		return;
+
 	v4l2_terminate(data);
+
+	if (data->device_id)
+		bfree(data->device_id);
+
+#if HAVE_UDEV
+	v4l2_unref_udev(data->udev);
+#endif
+
+	bfree(data);
+}
+
+/**
+ * Start capturing for the source
+ *
+ * If another source already captures from the same device, its frames are
+ * shared instead of opening the device again.
+ */
+static void v4l2_init(struct v4l2_data *data)
+{
+	struct v4l2_device *device;
+
+	if (data->device)
+		return;
+
+	pthread_mutex_lock(&devices_mutex);
+
+	device = v4l2_find_device(data->device_id);
+	if (device) {
+		blog(LOG_INFO, "Sharing capture from %s", device->device_id);
+
+		if (!v4l2_device_matches(device, data))
+			blog(LOG_WARNING, "Device %s is already used with "
+			                  "different settings, which are used "
+			                  "for this source as well",
+			                  device->device_id);
+	} else {
+		device = v4l2_device_open(data);
+		if (device)
+			da_push_back(devices, &device);
+	}
+
+	if (device) {
+		pthread_mutex_lock(&device->sources_mutex);
+		da_push_back(device->sources, &data->source);
+		pthread_mutex_unlock(&device->sources_mutex);
+	}
+
+	pthread_mutex_unlock(&devices_mutex);
+
+	data->device = device;
+}
+
+/** settings that the device has to be reopened for */
+static const char *v4l2_device_settings[] = {
+	"device_id",
+	"input",
+	"pixelformat",
+	"resolution",
+	"framerate",
+	"system_timing",
+	NULL
+};
+
+static bool v4l2_device_settings_changed(obs_data_t *changed)
+{
+	for (const char **name = v4l2_device_settings; *name; name++) {
+		if (obs_data_get_bool(changed, *name))
+			return true;
+	}
+
+	return false;
 }
 
 /**
  * Update the settings for the v4l2 source
  *
  * Since there are very few settings that can be changed without restarting the
- * stream we don't bother to even try. Whenever this is called the currently
- * active stream (if exists) is stopped, the settings are updated and finally
- * the new stream is started.
+ * stream we don't bother to even try. Whenever one of the device settings
+ * changed the currently active stream (if exists) is stopped, the settings are
+ * updated and finally the new stream is started.
+ *
+ * @param changed changed settings, or NULL if everything has to be applied
  */
-static void v4l2_update(void *vptr, obs_data_t *settings)
+static void v4l2_update(void *vptr, obs_data_t *settings, obs_data_t *changed)
 {
 	V4L2_DATA(vptr);
 
-	v4l2_terminate(data);
+	if (!changed || v4l2_device_settings_changed(changed))
+		v4l2_terminate(data);
 
 	if (data->device_id)
 		bfree(data->device_id);
@@ -780,17 +944,50 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->resolution = obs_data_get_int(settings, "resolution");
 	data->framerate  = obs_data_get_int(settings, "framerate");
 	data->sys_timing = obs_data_get_bool(settings, "system_timing");
+	data->deactivate_hidden = obs_data_get_bool(settings,
+			"deactivate_when_not_showing");
+
+	if (v4l2_should_capture(data))
+		v4l2_init(data);
+	else
+		v4l2_terminate(data);
+}
+
+/**
+ * Reopen the device when the source is shown again
+ */
+static void v4l2_show(void *vptr)
+{
+	V4L2_DATA(vptr);
+
+	data->showing = true;
+
+	if (data->deactivate_hidden)
+		v4l2_init(data);
+}
+
+/**
+ * Release the device while the source isn't shown anywhere
+ *
+ * Only done if the user asked for it, since reopening the device when the
+ * source is shown again takes a moment.
+ */
+static void v4l2_hide(void *vptr)
+{
+	V4L2_DATA(vptr);
+
+	data->showing = false;
 
-	v4l2_init(data);
+	if (data->deactivate_hidden)
+		v4l2_terminate(data);
 }
 
 static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct v4l2_data *data = bzalloc(sizeof(struct v4l2_data));
-	data->dev = -1;
 	data->source = source;
 
-	v4l2_update(data, settings);
+	v4l2_update(data, settings, NULL);
 
 #if HAVE_UDEV
 	data->udev = v4l2_init_udev();
@@ -804,11 +1001,13 @@ static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 struct obs_source_info v4l2_input = {
 	.id             = "v4l2_input",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_ASYNC_VIDEO,
+	.output_flags   = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_OPAQUE,
 	.get_name       = v4l2_getname,
 	.create         = v4l2_create,
 	.destroy        = v4l2_destroy,
-	.update         = v4l2_update,
+	.update_diff    = v4l2_update,
+	.show           = v4l2_show,
+	.hide           = v4l2_hide,
 	.get_defaults   = v4l2_defaults,
 	.get_properties = v4l2_properties
 };
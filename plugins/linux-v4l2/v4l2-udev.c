@@ -50,7 +50,7 @@ static pthread_mutex_t udev_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t udev_thread;
 static os_event_t *udev_event;
 
-static DARRAY(struct v4l2_udev_mon_t) udev_clients;
+static DARRAY(struct v4l2_udev_mon_t*) udev_clients;
 
 /**
  * udev gives us the device action as string, so we convert it here ...
@@ -87,7 +87,7 @@ static inline void udev_call_callbacks(struct udev_device *dev)
 	action = udev_action_to_enum(udev_device_get_action(dev));
 
 	for (size_t idx = 0; idx < udev_clients.num; idx++) {
-		struct v4l2_udev_mon_t *c = &udev_clients.array[idx];
+		struct v4l2_udev_mon_t *c = udev_clients.array[idx];
 
 		switch (action) {
 		case UDEV_ACTION_ADDED:
@@ -174,8 +174,10 @@ void *v4l2_init_udev(void)
 	}
 	udev_refs++;
 
-	/* create monitor object */
-	ret = da_push_back_new(udev_clients);
+	/* create monitor object, allocated separately since the pointer is
+	 * kept by the caller while the array grows */
+	ret = bzalloc(sizeof(struct v4l2_udev_mon_t));
+	da_push_back(udev_clients, &ret);
 fail:
 	pthread_mutex_unlock(&udev_mutex);
 	return ret;
@@ -187,7 +189,8 @@ void v4l2_unref_udev(void *monitor)
 	pthread_mutex_lock(&udev_mutex);
 
 	/* clean up monitor object */
-	da_erase_item(udev_clients, m);
+	da_erase_item(udev_clients, &m);
+	bfree(m);
 
 	/* unref udev monitor */
 	udev_refs--;
@@ -6,6 +6,8 @@
 
 #include <obs-module.h>
 #include <util/threading.h>
+#include <util/ring-queue.h>
+#include <util/platform.h>
 #include <util/c99defs.h>
 
 #include "mac-helpers.h"
@@ -23,6 +25,9 @@
 
 #define MAX_DEVICES 20
 
+/* number of preallocated packets between the IO proc and the packet thread */
+#define NUM_PACKETS 16
+
 #define set_property AudioUnitSetProperty
 #define get_property AudioUnitGetProperty
 
@@ -31,6 +36,17 @@
 #define TEXT_DEVICE         obs_module_text("CoreAudio.Device")
 #define TEXT_DEVICE_DEFAULT obs_module_text("CoreAudio.Device.Default")
 
+/*
+ * The IO proc runs on the CoreAudio real-time thread, so it only renders into
+ * a preallocated packet and queues its index.  Resampling and output to the
+ * audio line (which allocate and lock) happen on the packet thread.
+ */
+struct ca_packet {
+	uint8_t             *data[MAX_AV_PLANES];
+	uint32_t            frames;
+	uint64_t            timestamp;
+};
+
 struct coreaudio_data {
 	char               *device_name;
 	char               *device_uid;
@@ -52,6 +68,16 @@ struct coreaudio_data {
 	volatile bool       reconnecting;
 	unsigned long       retry_time;
 
+	struct ca_packet    packets[NUM_PACKETS];
+	UInt32              packet_sizes[MAX_AV_PLANES];
+	spsc_queue_t        *free_packets;
+	spsc_queue_t        *ready_packets;
+	os_sem_t            *packet_sem;
+	pthread_t           packet_thread;
+	bool                packet_thread_active;
+	volatile long       stop_packets;
+	volatile long       dropped_packets;
+
 	obs_source_t        *source;
 };
 
@@ -271,22 +297,126 @@ static bool coreaudio_init_buffer(struct coreaudio_data *ca)
 		return false;
 	}
 
-	for (UInt32 i = 0; i < ca->buf_list->mNumberBuffers; i++) {
-		size = ca->buf_list->mBuffers[i].mDataByteSize;
-		ca->buf_list->mBuffers[i].mData = bmalloc(size);
+	if (ca->buf_list->mNumberBuffers > MAX_AV_PLANES) {
+		ca_warn(ca, "coreaudio_init_buffer", "too many buffers: %u",
+				(unsigned int)ca->buf_list->mNumberBuffers);
+		bfree(ca->buf_list);
+		ca->buf_list = NULL;
+		return false;
 	}
-	
+
+	/* the buffers themselves belong to the packets, the IO proc points
+	 * the list at a free packet before each render */
+	for (UInt32 i = 0; i < ca->buf_list->mNumberBuffers; i++)
+		ca->buf_list->mBuffers[i].mData = NULL;
+
 	return true;
 }
 
-static void buf_list_free(AudioBufferList *buf_list)
+static void *packet_thread(void *data)
+{
+	struct coreaudio_data *ca = data;
+
+	os_set_thread_role(OS_THREAD_ROLE_AUDIO);
+
+	while (os_sem_wait(ca->packet_sem) == 0) {
+		struct obs_source_audio audio = {0};
+		struct ca_packet *packet;
+		size_t idx;
+
+		if (os_atomic_load_long(&ca->stop_packets))
+			break;
+		if (!spsc_queue_pop(ca->ready_packets, &idx))
+			continue;
+
+		packet = &ca->packets[idx];
+		if (!packet->frames) {
+			spsc_queue_push(ca->free_packets, &idx);
+			continue;
+		}
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			audio.data[i] = packet->data[i];
+
+		audio.frames          = packet->frames;
+		audio.speakers        = ca->speakers;
+		audio.format          = ca->format;
+		audio.samples_per_sec = ca->sample_rate;
+		audio.timestamp       = packet->timestamp;
+
+		obs_source_output_audio(ca->source, &audio);
+
+		spsc_queue_push(ca->free_packets, &idx);
+	}
+
+	return NULL;
+}
+
+static void coreaudio_free_packets(struct coreaudio_data *ca)
+{
+	long dropped;
+
+	if (ca->packet_thread_active) {
+		os_atomic_set_long(&ca->stop_packets, 1);
+		os_sem_post(ca->packet_sem);
+		pthread_join(ca->packet_thread, NULL);
+		ca->packet_thread_active = false;
+	}
+
+	dropped = os_atomic_exchange_long(&ca->dropped_packets, 0);
+	if (dropped)
+		blog(LOG_INFO, "coreaudio: device '%s' dropped %ld packets",
+				ca->device_name, dropped);
+
+	spsc_queue_destroy(ca->free_packets);
+	spsc_queue_destroy(ca->ready_packets);
+	os_sem_destroy(ca->packet_sem);
+	ca->free_packets  = NULL;
+	ca->ready_packets = NULL;
+	ca->packet_sem    = NULL;
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		for (size_t j = 0; j < MAX_AV_PLANES; j++) {
+			bfree(ca->packets[i].data[j]);
+			ca->packets[i].data[j] = NULL;
+		}
+	}
+}
+
+static bool coreaudio_init_packets(struct coreaudio_data *ca)
 {
-	if (buf_list) {
-		for (UInt32 i = 0; i < buf_list->mNumberBuffers; i++)
-			bfree(buf_list->mBuffers[i].mData);
+	ca->free_packets  = spsc_queue_create(sizeof(size_t), NUM_PACKETS);
+	ca->ready_packets = spsc_queue_create(sizeof(size_t), NUM_PACKETS);
+
+	if (!ca->free_packets || !ca->ready_packets ||
+	    os_sem_init(&ca->packet_sem, 0) != 0) {
+		ca_warn(ca, "coreaudio_init_packets", "failed to create queues");
+		goto fail;
+	}
 
-		bfree(buf_list);
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		for (UInt32 j = 0; j < ca->buf_list->mNumberBuffers; j++) {
+			UInt32 size = ca->buf_list->mBuffers[j].mDataByteSize;
+			ca->packets[i].data[j] = bmalloc(size);
+			ca->packet_sizes[j]    = size;
+		}
+
+		spsc_queue_push(ca->free_packets, &i);
+	}
+
+	os_atomic_set_long(&ca->stop_packets, 0);
+
+	if (pthread_create(&ca->packet_thread, NULL, packet_thread, ca) != 0) {
+		ca_warn(ca, "coreaudio_init_packets", "failed to create thread");
+		goto fail;
 	}
+
+	ca->packet_thread_active = true;
+	return true;
+
+fail:
+	coreaudio_free_packets(ca);
+	return false;
 }
 
 static OSStatus input_callback(
@@ -298,24 +428,36 @@ static OSStatus input_callback(
 		AudioBufferList *ignored_buffers)
 {
 	struct coreaudio_data *ca = data;
+	struct ca_packet *packet;
 	OSStatus stat;
-	struct obs_source_audio audio;
+	size_t idx;
+
+	/* no allocations or locks in here, this is the real-time thread */
+	if (!spsc_queue_pop(ca->free_packets, &idx)) {
+		os_atomic_inc_long(&ca->dropped_packets);
+		return noErr;
+	}
+
+	packet = &ca->packets[idx];
+
+	/* render resets the byte sizes to what was written, so restore them */
+	for (UInt32 i = 0; i < ca->buf_list->mNumberBuffers; i++) {
+		ca->buf_list->mBuffers[i].mData         = packet->data[i];
+		ca->buf_list->mBuffers[i].mDataByteSize = ca->packet_sizes[i];
+	}
 
 	stat = AudioUnitRender(ca->unit, action_flags, ts_data, bus_num, frames,
 			ca->buf_list);
+	/* failed packets still go through the ready queue (with no frames)
+	 * because only the packet thread may push to the free queue */
 	if (!ca_success(stat, ca, "input_callback", "audio retrieval"))
-		return noErr;
+		frames = 0;
 
-	for (UInt32 i = 0; i < ca->buf_list->mNumberBuffers; i++)
-		audio.data[i] = ca->buf_list->mBuffers[i].mData;
+	packet->frames    = frames;
+	packet->timestamp = ts_data->mHostTime;
 
-	audio.frames          = frames;
-	audio.speakers        = ca->speakers;
-	audio.format          = ca->format;
-	audio.samples_per_sec = ca->sample_rate;
-	audio.timestamp       = ts_data->mHostTime;
-
-	obs_source_output_audio(ca->source, &audio);
+	spsc_queue_push(ca->ready_packets, &idx);
+	os_sem_post(ca->packet_sem);
 
 	UNUSED_PARAMETER(ignored_buffers);
 	return noErr;
@@ -572,6 +714,8 @@ static bool coreaudio_init(struct coreaudio_data *ca)
 		goto fail;
 	if (!coreaudio_init_buffer(ca))
 		goto fail;
+	if (!coreaudio_init_packets(ca))
+		goto fail;
 	if (!coreaudio_init_hooks(ca))
 		goto fail;
 
@@ -627,7 +771,9 @@ static void coreaudio_uninit(struct coreaudio_data *ca)
 
 	ca->au_initialized = false;
 
-	buf_list_free(ca->buf_list);
+	coreaudio_free_packets(ca);
+
+	bfree(ca->buf_list);
 	ca->buf_list = NULL;
 }
 
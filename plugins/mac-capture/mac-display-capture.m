@@ -650,7 +650,8 @@ struct obs_source_info display_capture_info = {
 	.create         = display_capture_create,
 	.destroy        = display_capture_destroy,
 
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.video_tick     = display_capture_video_tick,
 	.video_render   = display_capture_video_render,
 
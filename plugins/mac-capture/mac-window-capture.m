@@ -1,13 +1,17 @@
 #include <obs-module.h>
-#include <util/darray.h>
 #include <util/threading.h>
 #include <util/platform.h>
 
 #import <CoreGraphics/CGWindow.h>
+#import <IOSurface/IOSurface.h>
 #import <Cocoa/Cocoa.h>
 
 #include "window-utils.h"
 
+/* surfaces the capture thread can draw into while others are still being
+ * displayed (current and prev are both held while in use) */
+#define NUM_SURFACES 3
+
 struct window_capture {
 	obs_source_t *source;
 
@@ -19,13 +23,33 @@ struct window_capture {
 
 	CGColorSpaceRef color_space;
 
-	DARRAY(uint8_t) buffer;
+	/* owned by the capture thread */
+	IOSurfaceRef surfaces[NUM_SURFACES];
+	size_t       next_surface;
+
+	gs_samplerstate_t *sampler;
+	gs_effect_t       *effect;
+	gs_texture_t      *tex;
+	gs_vertbuffer_t   *vertbuf;
+	uint32_t          width;
+	uint32_t          height;
+
+	pthread_mutex_t mutex;
+	IOSurfaceRef    current, prev;
 
 	pthread_t  capture_thread;
 	os_event_t *capture_event;
 	os_event_t *stop_event;
 };
 
+static inline void release_surface(IOSurfaceRef surface)
+{
+	if (surface) {
+		IOSurfaceDecrementUseCount(surface);
+		CFRelease(surface);
+	}
+}
+
 static CGImageRef get_image(struct window_capture *wc)
 {
 	NSArray *arr = (NSArray*)CGWindowListCreate(
@@ -46,9 +70,51 @@ static CGImageRef get_image(struct window_capture *wc)
 			wc->window.window_id, wc->image_option);
 }
 
+static IOSurfaceRef create_surface(size_t width, size_t height)
+{
+	NSDictionary *props = @{
+		(NSString*)kIOSurfaceWidth:           @(width),
+		(NSString*)kIOSurfaceHeight:          @(height),
+		(NSString*)kIOSurfaceBytesPerElement: @4,
+		(NSString*)kIOSurfacePixelFormat:     @((uint32_t)'BGRA'),
+	};
+
+	return IOSurfaceCreate((CFDictionaryRef)props);
+}
+
+/* finds a surface of the right size that nobody is displaying, recreating
+ * one if the window size changed */
+static IOSurfaceRef get_free_surface(struct window_capture *wc,
+		size_t width, size_t height)
+{
+	for (size_t i = 0; i < NUM_SURFACES; i++) {
+		size_t idx = (wc->next_surface + i) % NUM_SURFACES;
+		IOSurfaceRef surface = wc->surfaces[idx];
+
+		if (surface && IOSurfaceIsInUse(surface))
+			continue;
+
+		if (!surface ||
+		    IOSurfaceGetWidth(surface)  != width ||
+		    IOSurfaceGetHeight(surface) != height) {
+			if (surface)
+				CFRelease(surface);
+
+			surface = create_surface(width, height);
+			wc->surfaces[idx] = surface;
+		}
+
+		wc->next_surface = idx + 1;
+		return surface;
+	}
+
+	return NULL;
+}
+
+/* draws the window straight into an IOSurface, which the graphics thread
+ * then binds as a texture without any upload */
 static inline void capture_frame(struct window_capture *wc)
 {
-	uint64_t   ts  = os_gettime_ns();
 	CGImageRef img = get_image(wc);
 	if (!img)
 		return;
@@ -56,12 +122,19 @@ static inline void capture_frame(struct window_capture *wc)
 	size_t width  = CGImageGetWidth(img);
 	size_t height = CGImageGetHeight(img);
 
+	IOSurfaceRef surface = get_free_surface(wc, width, height);
+	if (!surface) {
+		CGImageRelease(img);
+		return;
+	}
+
 	CGRect rect = {{0, 0}, {width, height}};
-	da_reserve(wc->buffer, width * height * 4);
-	uint8_t *data = wc->buffer.array;
 
-	CGContextRef cg_context = CGBitmapContextCreate(data, width, height,
-			8, width * 4, wc->color_space,
+	IOSurfaceLock(surface, 0, NULL);
+
+	CGContextRef cg_context = CGBitmapContextCreate(
+			IOSurfaceGetBaseAddress(surface), width, height,
+			8, IOSurfaceGetBytesPerRow(surface), wc->color_space,
 			kCGBitmapByteOrder32Host |
 			kCGImageAlphaPremultipliedFirst);
 	CGContextSetBlendMode(cg_context, kCGBlendModeCopy);
@@ -69,16 +142,17 @@ static inline void capture_frame(struct window_capture *wc)
 	CGContextRelease(cg_context);
 	CGImageRelease(img);
 
-	struct obs_source_frame frame = {
-		.format      = VIDEO_FORMAT_BGRA,
-		.width       = width,
-		.height      = height,
-		.data[0]     = data,
-		.linesize[0] = width * 4,
-		.timestamp   = ts,
-	};
+	IOSurfaceUnlock(surface, 0, NULL);
+
+	CFRetain(surface);
+	IOSurfaceIncrementUseCount(surface);
+
+	pthread_mutex_lock(&wc->mutex);
+	IOSurfaceRef prev_current = wc->current;
+	wc->current = surface;
+	pthread_mutex_unlock(&wc->mutex);
 
-	obs_source_output_video(wc->source, &frame);
+	release_surface(prev_current);
 }
 
 static void *capture_thread(void *data)
@@ -98,6 +172,38 @@ static void *capture_thread(void *data)
 	return NULL;
 }
 
+static bool init_vertbuf(struct window_capture *wc)
+{
+	struct gs_vb_data *vb_data = gs_vbdata_create();
+	vb_data->num = 4;
+	vb_data->points = bzalloc(sizeof(struct vec3) * 4);
+	vb_data->num_tex = 1;
+	vb_data->tvarray = bzalloc(sizeof(struct gs_tvertarray));
+	vb_data->tvarray[0].width = 2;
+	vb_data->tvarray[0].array = bzalloc(sizeof(struct vec2) * 4);
+
+	wc->vertbuf = gs_vertexbuffer_create(vb_data, GS_DYNAMIC);
+	return wc->vertbuf != NULL;
+}
+
+/* IOSurface textures are rectangle textures, so the coordinates are in
+ * pixels rather than normalized */
+static void build_sprite(struct gs_vb_data *data, float cx, float cy)
+{
+	struct vec2 *tvarray = data->tvarray[0].array;
+
+	vec3_zero(data->points);
+	vec3_set(data->points+1,  cx, 0.0f, 0.0f);
+	vec3_set(data->points+2, 0.0f,  cy, 0.0f);
+	vec3_set(data->points+3,  cx,  cy, 0.0f);
+	vec2_set(tvarray,   0.0f, 0.0f);
+	vec2_set(tvarray+1, cx,   0.0f);
+	vec2_set(tvarray+2, 0.0f, cy);
+	vec2_set(tvarray+3, cx,   cy);
+}
+
+static void window_capture_destroy(void *data);
+
 static inline void *window_capture_create_internal(obs_data_t *settings,
 		obs_source_t *source)
 {
@@ -105,9 +211,30 @@ static inline void *window_capture_create_internal(obs_data_t *settings,
 
 	wc->source = source;
 
+	wc->effect = obs_get_default_rect_effect();
+	if (!wc->effect)
+		goto fail;
+
+	obs_enter_graphics();
+
+	struct gs_sampler_info info = {
+		.filter = GS_FILTER_LINEAR,
+		.address_u = GS_ADDRESS_CLAMP,
+		.address_v = GS_ADDRESS_CLAMP,
+		.address_w = GS_ADDRESS_CLAMP,
+		.max_anisotropy = 1,
+	};
+	wc->sampler = gs_samplerstate_create(&info);
+	bool success = wc->sampler && init_vertbuf(wc);
+
+	obs_leave_graphics();
+
+	if (!success)
+		goto fail;
+
 	wc->color_space = CGColorSpaceCreateDeviceRGB();
 
-	da_init(wc->buffer);
+	pthread_mutex_init(&wc->mutex, NULL);
 
 	init_window(&wc->window, settings);
 
@@ -120,6 +247,17 @@ static inline void *window_capture_create_internal(obs_data_t *settings,
 	pthread_create(&wc->capture_thread, NULL, capture_thread, wc);
 
 	return wc;
+
+fail:
+	obs_enter_graphics();
+	if (wc->sampler)
+		gs_samplerstate_destroy(wc->sampler);
+	if (wc->vertbuf)
+		gs_vertexbuffer_destroy(wc->vertbuf);
+	obs_leave_graphics();
+
+	bfree(wc);
+	return NULL;
 }
 
 static void *window_capture_create(obs_data_t *settings, obs_source_t *source)
@@ -138,9 +276,23 @@ static void window_capture_destroy(void *data)
 	
 	pthread_join(cap->capture_thread, NULL);
 
-	CGColorSpaceRelease(cap->color_space);
+	obs_enter_graphics();
+	if (cap->tex)
+		gs_texture_destroy(cap->tex);
+	gs_samplerstate_destroy(cap->sampler);
+	gs_vertexbuffer_destroy(cap->vertbuf);
+	obs_leave_graphics();
+
+	release_surface(cap->current);
+	release_surface(cap->prev);
+
+	for (size_t i = 0; i < NUM_SURFACES; i++) {
+		if (cap->surfaces[i])
+			CFRelease(cap->surfaces[i]);
+	}
 
-	da_free(cap->buffer);
+	CGColorSpaceRelease(cap->color_space);
+	pthread_mutex_destroy(&cap->mutex);
 
 	os_event_destroy(cap->capture_event);
 	os_event_destroy(cap->stop_event);
@@ -186,6 +338,43 @@ static void window_capture_update(void *data, obs_data_t *settings)
 	}
 }
 
+static void window_capture_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+
+	struct window_capture *wc = data;
+
+	if (!wc->tex)
+		return;
+
+	gs_vertexbuffer_flush(wc->vertbuf);
+	gs_load_vertexbuffer(wc->vertbuf);
+	gs_load_indexbuffer(NULL);
+	gs_load_samplerstate(wc->sampler, 0);
+	gs_technique_t *tech = gs_effect_get_technique(wc->effect, "Draw");
+	gs_effect_set_texture(gs_effect_get_param_by_name(wc->effect, "image"),
+			wc->tex);
+	gs_technique_begin(tech);
+	gs_technique_begin_pass(tech, 0);
+
+	gs_draw(GS_TRISTRIP, 0, 4);
+
+	gs_technique_end_pass(tech);
+	gs_technique_end(tech);
+}
+
+static uint32_t window_capture_getwidth(void *data)
+{
+	struct window_capture *wc = data;
+	return wc->width;
+}
+
+static uint32_t window_capture_getheight(void *data)
+{
+	struct window_capture *wc = data;
+	return wc->height;
+}
+
 static const char *window_capture_getname(void)
 {
 	return obs_module_text("WindowCapture");
@@ -195,6 +384,33 @@ static inline void window_capture_tick_internal(struct window_capture *wc,
 		float seconds)
 {
 	UNUSED_PARAMETER(seconds);
+
+	IOSurfaceRef prev_prev = wc->prev;
+
+	pthread_mutex_lock(&wc->mutex);
+	if (wc->current) {
+		wc->prev    = wc->current;
+		wc->current = NULL;
+	}
+	pthread_mutex_unlock(&wc->mutex);
+
+	if (prev_prev != wc->prev) {
+		wc->width  = (uint32_t)IOSurfaceGetWidth(wc->prev);
+		wc->height = (uint32_t)IOSurfaceGetHeight(wc->prev);
+
+		obs_enter_graphics();
+		build_sprite(gs_vertexbuffer_get_data(wc->vertbuf),
+				wc->width, wc->height);
+
+		if (wc->tex)
+			gs_texture_rebind_iosurface(wc->tex, wc->prev);
+		else
+			wc->tex = gs_texture_create_from_iosurface(wc->prev);
+		obs_leave_graphics();
+
+		release_surface(prev_prev);
+	}
+
 	os_event_signal(wc->capture_event);
 }
 
@@ -213,8 +429,11 @@ struct obs_source_info window_capture_info = {
 	.create         = window_capture_create,
 	.destroy        = window_capture_destroy,
 
-	.output_flags   = OBS_SOURCE_ASYNC_VIDEO,
+	.output_flags   = OBS_SOURCE_VIDEO,
 	.video_tick     = window_capture_tick,
+	.video_render   = window_capture_render,
+	.get_width      = window_capture_getwidth,
+	.get_height     = window_capture_getheight,
 
 	.get_defaults   = window_capture_defaults,
 	.get_properties = window_capture_properties,
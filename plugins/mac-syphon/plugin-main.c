@@ -4,9 +4,11 @@ OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("syphon", "en-US")
 
 extern struct obs_source_info syphon_info;
+extern struct obs_output_info syphon_output_info;
 
 bool obs_module_load(void)
 {
 	obs_register_source(&syphon_info);
+	obs_register_output(&syphon_output_info);
 	return true;
 }
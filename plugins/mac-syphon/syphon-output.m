@@ -0,0 +1,174 @@
+#import <Cocoa/Cocoa.h>
+#import <OpenGL/OpenGL.h>
+#import <OpenGL/gl.h>
+#import "syphon-framework/Syphon.h"
+#include <obs-module.h>
+
+#define LOG(level, message, ...) \
+	blog(level, "%s: " message, obs_output_get_name(so->output), \
+			##__VA_ARGS__)
+
+/*
+ * Publishes the main output texture as a Syphon server.  Syphon clients get
+ * the frames through the IOSurface the server renders the texture in to, so
+ * there is no readback or encode involved.
+ */
+struct syphon_output {
+	obs_output_t *output;
+	NSString     *name;
+
+	/* graphics thread only.  the output never begins data capture, it
+	 * takes the output texture instead of raw or encoded frames */
+	SYPHON_SERVER_UNIQUE_CLASS_NAME *server;
+
+	bool active;
+};
+
+static const char *syphon_output_getname(void)
+{
+	return obs_module_text("SyphonOutput");
+}
+
+/* called on the graphics thread each frame with the output texture */
+static void syphon_output_texture(void *param, gs_texture_t *texture,
+		uint64_t timestamp)
+{
+	struct syphon_output *so = param;
+	GLuint *tex_obj = gs_texture_get_obj(texture);
+	uint32_t cx = gs_texture_get_width(texture);
+	uint32_t cy = gs_texture_get_height(texture);
+
+	if (!tex_obj)
+		return;
+
+	@autoreleasepool {
+		/* the server needs the CGL context of the graphics thread,
+		 * so it is created here on the first frame */
+		if (!so->server) {
+			CGLContextObj ctx =
+				[[NSOpenGLContext currentContext] CGLContextObj];
+
+			so->server = [[SYPHON_SERVER_UNIQUE_CLASS_NAME alloc]
+				initWithName:so->name context:ctx options:nil];
+			if (!so->server)
+				return;
+
+			LOG(LOG_INFO, "publishing Syphon server '%s'",
+					so->name.UTF8String);
+		}
+
+		/* textures rendered by OBS are stored top row first */
+		[so->server publishFrameTexture:*tex_obj
+				  textureTarget:GL_TEXTURE_2D
+				    imageRegion:NSMakeRect(0, 0, cx, cy)
+			      textureDimensions:NSMakeSize(cx, cy)
+					flipped:YES];
+	}
+
+	UNUSED_PARAMETER(timestamp);
+}
+
+static void syphon_output_stop(void *data)
+{
+	struct syphon_output *so = data;
+
+	if (!so->active)
+		return;
+
+	obs_remove_video_texture_callback(obs_get_video(),
+			syphon_output_texture, so);
+
+	obs_enter_graphics();
+	@autoreleasepool {
+		[so->server stop];
+		[so->server release];
+		so->server = nil;
+	}
+	obs_leave_graphics();
+
+	so->active = false;
+	LOG(LOG_INFO, "stopped");
+}
+
+static bool syphon_output_start(void *data)
+{
+	struct syphon_output *so = data;
+
+	if (so->active)
+		return true;
+
+	obs_add_video_texture_callback(obs_get_video(),
+			syphon_output_texture, so);
+
+	so->active = true;
+	return true;
+}
+
+static void syphon_output_update(void *data, obs_data_t *settings)
+{
+	struct syphon_output *so = data;
+	NSString *name = @(obs_data_get_string(settings, "name"));
+	bool restart = so->active && ![name isEqualToString:so->name];
+
+	if (restart)
+		syphon_output_stop(so);
+
+	[so->name release];
+	so->name = [name retain];
+
+	if (restart)
+		syphon_output_start(so);
+}
+
+static void *syphon_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct syphon_output *so = bzalloc(sizeof(struct syphon_output));
+
+	so->output = output;
+
+	@autoreleasepool {
+		syphon_output_update(so, settings);
+	}
+
+	return so;
+}
+
+static void syphon_output_destroy(void *data)
+{
+	struct syphon_output *so = data;
+
+	syphon_output_stop(so);
+	[so->name release];
+	bfree(so);
+}
+
+static void syphon_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, "name", "OBS");
+}
+
+static obs_properties_t *syphon_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, "name",
+			obs_module_text("SyphonOutput.Name"),
+			OBS_TEXT_DEFAULT);
+
+	return props;
+}
+
+struct obs_output_info syphon_output_info = {
+	.id             = "syphon_output",
+	.flags          = OBS_OUTPUT_VIDEO,
+	.get_name       = syphon_output_getname,
+	.create         = syphon_output_create,
+	.destroy        = syphon_output_destroy,
+	.start          = syphon_output_start,
+	.stop           = syphon_output_stop,
+	.update         = syphon_output_update,
+	.get_defaults   = syphon_output_defaults,
+	.get_properties = syphon_output_properties
+};
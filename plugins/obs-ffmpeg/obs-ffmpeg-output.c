@@ -21,6 +21,7 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <inttypes.h>
 
 #include <libavutil/opt.h>
 #include <libavformat/avformat.h>
@@ -32,6 +33,21 @@
 //#define OBS_FFMPEG_VIDEO_FORMAT VIDEO_FORMAT_I420
 #define OBS_FFMPEG_VIDEO_FORMAT VIDEO_FORMAT_NV12
 
+/* number of raw frames that can be waiting for the encode thread before new
+ * frames are dropped */
+#define VIDEO_QUEUE_SIZE 8
+
+/* packets waiting for the write thread are limited to this many bytes, once
+ * the disk falls that far behind the output stops with an error rather than
+ * using up memory */
+#define MAX_QUEUED_BYTES (512 * 1024 * 1024)
+
+/* over every interval, the speed packets are written at is compared to the
+ * rate they're queued at, to warn about a disk that is barely keeping up
+ * before the queue starts to grow */
+#define MONITOR_INTERVAL_NS 10000000000ULL
+#define MIN_WRITE_HEADROOM  2
+
 /* NOTE: much of this stuff is test stuff that was more or less copied from
  * the muxing.c ffmpeg example */
 
@@ -49,6 +65,14 @@ struct ffmpeg_data {
 	int                frame_size;
 	int                total_frames;
 
+	/* raw frames copied out of the video callback, encoded in order by the
+	 * encode thread */
+	AVPicture          queued_pictures[VIDEO_QUEUE_SIZE];
+	int64_t            queued_pts[VIDEO_QUEUE_SIZE];
+	size_t             first_queued;
+	size_t             num_queued;
+	uint32_t           dropped_frames;
+
 	int                width;
 	int                height;
 
@@ -66,12 +90,22 @@ struct ffmpeg_data {
 
 	const char         *filename_test;
 
+	/* encoded mode: streams are fed by the output's encoders and only
+	 * muxed, no codecs are opened here.  each audio encoder gets its own
+	 * audio stream */
+	bool               encoded;
+	obs_encoder_t      *vencoder;
+	obs_encoder_t      *aencoders[MAX_AUDIO_MIXES];
+	AVStream           *audio_streams[MAX_AUDIO_MIXES];
+	size_t             num_audio_streams;
+
 	bool               initialized;
 };
 
 struct ffmpeg_output {
 	obs_output_t       *output;
 	volatile bool      active;
+	bool               encoded;
 	struct ffmpeg_data ff_data;
 
 	bool               connecting;
@@ -83,7 +117,21 @@ struct ffmpeg_output {
 	os_sem_t           *write_sem;
 	os_event_t         *stop_event;
 
+	bool               encode_thread_active;
+	pthread_mutex_t    encode_mutex;
+	pthread_t          encode_thread;
+	os_sem_t           *encode_sem;
+
 	DARRAY(AVPacket)   packets;
+	size_t             queued_bytes;
+	uint64_t           total_queued;
+	bool               queue_overflow;
+
+	uint64_t           monitor_start;
+	uint64_t           monitor_queued;
+	uint64_t           monitor_written;
+	uint64_t           write_time_ns;
+	bool               slow_warned;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -119,6 +167,10 @@ static bool open_video_codec(struct ffmpeg_data *data)
 		av_opt_set(context->priv_data, "x264-params", "nal-hrd=cbr", 0);
 	}
 
+	/* let the codec pick its own thread count */
+	context->thread_count = 0;
+	context->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
 	ret = avcodec_open2(context, data->vcodec, NULL);
 	if (ret < 0) {
 		blog(LOG_WARNING, "Failed to open video codec: %s",
@@ -144,6 +196,18 @@ static bool open_video_codec(struct ffmpeg_data *data)
 		return false;
 	}
 
+	for (size_t i = 0; i < VIDEO_QUEUE_SIZE; i++) {
+		ret = avpicture_alloc(&data->queued_pictures[i],
+				obs_to_ffmpeg_video_format(
+					OBS_FFMPEG_VIDEO_FORMAT),
+				context->width, context->height);
+		if (ret < 0) {
+			blog(LOG_WARNING, "Failed to allocate queued frame: "
+			                  "%s", av_err2str(ret));
+			return false;
+		}
+	}
+
 	*((AVPicture*)data->vframe) = data->dst_picture;
 	return true;
 }
@@ -273,10 +337,123 @@ static bool create_audio_stream(struct ffmpeg_data *data)
 	return open_audio_codec(data);
 }
 
+static enum AVCodecID get_codec_id(const char *codec)
+{
+	if (astrcmpi(codec, "h264") == 0)
+		return AV_CODEC_ID_H264;
+	else if (astrcmpi(codec, "AAC") == 0)
+		return AV_CODEC_ID_AAC;
+
+	return AV_CODEC_ID_NONE;
+}
+
+static bool new_encoded_stream(struct ffmpeg_data *data, AVStream **stream,
+		obs_encoder_t *encoder)
+{
+	const char *codec = obs_encoder_get_codec(encoder);
+	enum AVCodecID id = get_codec_id(codec);
+	AVCodecContext *context;
+	uint8_t *extra_data;
+	size_t size;
+
+	if (id == AV_CODEC_ID_NONE) {
+		blog(LOG_WARNING, "Codec '%s' cannot be muxed", codec);
+		return false;
+	}
+
+	*stream = avformat_new_stream(data->output, NULL);
+	if (!*stream) {
+		blog(LOG_WARNING, "Couldn't create stream for codec '%s'",
+				codec);
+		return false;
+	}
+
+	(*stream)->id    = data->output->nb_streams-1;
+	context          = (*stream)->codec;
+	context->codec_id = id;
+
+	if (obs_encoder_get_extra_data(encoder, &extra_data, &size) && size) {
+		context->extradata = av_mallocz(size +
+				FF_INPUT_BUFFER_PADDING_SIZE);
+		memcpy(context->extradata, extra_data, size);
+		context->extradata_size = (int)size;
+	}
+
+	if (data->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+	return true;
+}
+
+static bool create_encoded_video_stream(struct ffmpeg_data *data)
+{
+	const struct video_output_info *voi;
+	AVCodecContext *context;
+
+	if (!new_encoded_stream(data, &data->video, data->vencoder))
+		return false;
+
+	voi = video_output_get_info(obs_encoder_video(data->vencoder));
+
+	context                = data->video->codec;
+	context->codec_type    = AVMEDIA_TYPE_VIDEO;
+	context->width         = (int)obs_encoder_get_width(data->vencoder);
+	context->height        = (int)obs_encoder_get_height(data->vencoder);
+	context->time_base.num = (int)voi->fps_den;
+	context->time_base.den = (int)voi->fps_num;
+	context->pix_fmt       = obs_to_ffmpeg_video_format(
+			OBS_FFMPEG_VIDEO_FORMAT);
+
+	data->video->time_base = context->time_base;
+	return true;
+}
+
+static bool create_encoded_audio_stream(struct ffmpeg_data *data, size_t idx)
+{
+	obs_encoder_t *aencoder = data->aencoders[idx];
+	AVStream **stream = &data->audio_streams[idx];
+	audio_t *audio;
+	AVCodecContext *context;
+
+	if (!new_encoded_stream(data, stream, aencoder))
+		return false;
+
+	audio = obs_encoder_audio(aencoder);
+
+	context              = (*stream)->codec;
+	context->codec_type  = AVMEDIA_TYPE_AUDIO;
+	context->bit_rate    = data->audio_bitrate * 1000;
+	context->channels    = (int)audio_output_get_channels(audio);
+	context->sample_rate = (int)audio_output_get_sample_rate(audio);
+	context->sample_fmt  = AV_SAMPLE_FMT_FLTP;
+	context->frame_size  = 1024;
+
+	(*stream)->time_base = (AVRational){1, context->sample_rate};
+	return true;
+}
+
+static inline bool init_encoded_streams(struct ffmpeg_data *data)
+{
+	if (data->vencoder)
+		if (!create_encoded_video_stream(data))
+			return false;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES && data->aencoders[i]; i++) {
+		if (!create_encoded_audio_stream(data, i))
+			return false;
+		data->num_audio_streams++;
+	}
+
+	return true;
+}
+
 static inline bool init_streams(struct ffmpeg_data *data)
 {
 	AVOutputFormat *format = data->output->oformat;
 
+	if (data->encoded)
+		return init_encoded_streams(data);
+
 	if (format->video_codec != AV_CODEC_ID_NONE)
 		if (!create_video_stream(data))
 			return false;
@@ -317,6 +494,9 @@ static void close_video(struct ffmpeg_data *data)
 {
 	avcodec_close(data->video->codec);
 	avpicture_free(&data->dst_picture);
+
+	for (size_t i = 0; i < VIDEO_QUEUE_SIZE; i++)
+		avpicture_free(&data->queued_pictures[i]);
 	av_frame_free(&data->vframe);
 }
 
@@ -351,7 +531,8 @@ static void ffmpeg_data_free(struct ffmpeg_data *data)
 }
 
 static bool ffmpeg_data_init(struct ffmpeg_data *data, const char *filename,
-		int vbitrate, int abitrate, int width, int height)
+		int vbitrate, int abitrate, int width, int height,
+		obs_encoder_t *vencoder, obs_encoder_t **aencoders)
 {
 	bool is_rtmp = false;
 
@@ -361,6 +542,11 @@ static bool ffmpeg_data_init(struct ffmpeg_data *data, const char *filename,
 	data->audio_bitrate = abitrate;
 	data->width         = width;
 	data->height        = height;
+	data->vencoder      = vencoder;
+	data->encoded       = vencoder || (aencoders && aencoders[0]);
+
+	if (aencoders)
+		memcpy(data->aencoders, aencoders, sizeof(data->aencoders));
 
 	if (!filename || !*filename)
 		return false;
@@ -406,6 +592,11 @@ static const char *ffmpeg_output_getname(void)
 	return obs_module_text("FFmpegOutput");
 }
 
+static const char *ffmpeg_muxer_getname(void)
+{
+	return obs_module_text("FFmpegMuxer");
+}
+
 static void ffmpeg_log_callback(void *param, int level, const char *format,
 		va_list args)
 {
@@ -419,14 +610,19 @@ static void *ffmpeg_output_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct ffmpeg_output *data = bzalloc(sizeof(struct ffmpeg_output));
 	pthread_mutex_init_value(&data->write_mutex);
+	pthread_mutex_init_value(&data->encode_mutex);
 	data->output = output;
 
 	if (pthread_mutex_init(&data->write_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->encode_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_AUTO) != 0)
 		goto fail;
 	if (os_sem_init(&data->write_sem, 0) != 0)
 		goto fail;
+	if (os_sem_init(&data->encode_sem, 0) != 0)
+		goto fail;
 
 	av_log_set_callback(ffmpeg_log_callback);
 
@@ -435,11 +631,21 @@ static void *ffmpeg_output_create(obs_data_t *settings, obs_output_t *output)
 
 fail:
 	pthread_mutex_destroy(&data->write_mutex);
+	pthread_mutex_destroy(&data->encode_mutex);
+	os_sem_destroy(data->write_sem);
 	os_event_destroy(data->stop_event);
 	bfree(data);
 	return NULL;
 }
 
+static void *ffmpeg_muxer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct ffmpeg_output *data = ffmpeg_output_create(settings, output);
+	if (data)
+		data->encoded = true;
+	return data;
+}
+
 static void ffmpeg_output_stop(void *data);
 
 static void ffmpeg_output_destroy(void *data)
@@ -453,7 +659,9 @@ static void ffmpeg_output_destroy(void *data)
 		ffmpeg_output_stop(output);
 
 		pthread_mutex_destroy(&output->write_mutex);
+		pthread_mutex_destroy(&output->encode_mutex);
 		os_sem_destroy(output->write_sem);
+		os_sem_destroy(output->encode_sem);
 		os_event_destroy(output->stop_event);
 		bfree(data);
 	}
@@ -483,10 +691,34 @@ static inline void copy_data(AVPicture *pic, const struct video_data *frame,
 	}
 }
 
-static void receive_video(void *param, struct video_data *frame)
+static void queue_packet(struct ffmpeg_output *output, AVPacket *packet)
 {
-	struct ffmpeg_output *output = param;
-	struct ffmpeg_data   *data   = &output->ff_data;
+	size_t size = (size_t)packet->size;
+	bool overflow;
+
+	pthread_mutex_lock(&output->write_mutex);
+
+	overflow = output->queued_bytes + size > MAX_QUEUED_BYTES;
+	if (overflow) {
+		output->queue_overflow = true;
+	} else {
+		da_push_back(output->packets, packet);
+		output->queued_bytes += size;
+		output->total_queued += size;
+	}
+
+	pthread_mutex_unlock(&output->write_mutex);
+
+	if (overflow)
+		av_free_packet(packet);
+
+	os_sem_post(output->write_sem);
+}
+
+static void encode_video(struct ffmpeg_output *output, AVPicture *picture,
+		int64_t pts)
+{
+	struct ffmpeg_data *data = &output->ff_data;
 	AVCodecContext *context = data->video->codec;
 	AVPacket packet = {0};
 	int ret = 0, got_packet;
@@ -494,17 +726,19 @@ static void receive_video(void *param, struct video_data *frame)
 
 	av_init_packet(&packet);
 
-	if (!data->start_timestamp)
-		data->start_timestamp = frame->timestamp;
-
 	format = obs_to_ffmpeg_video_format(OBS_FFMPEG_VIDEO_FORMAT);
-	if (context->pix_fmt != format)
-		sws_scale(data->swscale, (const uint8_t *const *)frame->data,
-				(const int*)frame->linesize,
+	if (context->pix_fmt != format) {
+		sws_scale(data->swscale, (const uint8_t *const *)picture->data,
+				(const int*)picture->linesize,
 				0, context->height, data->dst_picture.data,
 				data->dst_picture.linesize);
-	else
-		copy_data(&data->dst_picture, frame, context->height);
+		picture = &data->dst_picture;
+
+	} else if (data->output->flags & AVFMT_RAWPICTURE) {
+		av_picture_copy(&data->dst_picture, picture, format,
+				context->width, context->height);
+		picture = &data->dst_picture;
+	}
 
 	if (data->output->flags & AVFMT_RAWPICTURE) {
 		packet.flags        |= AV_PKT_FLAG_KEY;
@@ -512,17 +746,15 @@ static void receive_video(void *param, struct video_data *frame)
 		packet.data          = data->dst_picture.data[0];
 		packet.size          = sizeof(AVPicture);
 
-		pthread_mutex_lock(&output->write_mutex);
-		da_push_back(output->packets, &packet);
-		pthread_mutex_unlock(&output->write_mutex);
-		os_sem_post(output->write_sem);
+		queue_packet(output, &packet);
 
 	} else {
-		data->vframe->pts = data->total_frames;
+		*((AVPicture*)data->vframe) = *picture;
+		data->vframe->pts = pts;
 		ret = avcodec_encode_video2(context, &packet, data->vframe,
 				&got_packet);
 		if (ret < 0) {
-			blog(LOG_WARNING, "receive_video: Error encoding "
+			blog(LOG_WARNING, "encode_video: Error encoding "
 			                  "video: %s", av_err2str(ret));
 			return;
 		}
@@ -536,21 +768,129 @@ static void receive_video(void *param, struct video_data *frame)
 					context->time_base,
 					data->video->time_base);
 
-			pthread_mutex_lock(&output->write_mutex);
-			da_push_back(output->packets, &packet);
-			pthread_mutex_unlock(&output->write_mutex);
-			os_sem_post(output->write_sem);
+			queue_packet(output, &packet);
 		} else {
 			ret = 0;
 		}
 	}
 
 	if (ret != 0) {
-		blog(LOG_WARNING, "receive_video: Error writing video: %s",
+		blog(LOG_WARNING, "encode_video: Error writing video: %s",
 				av_err2str(ret));
 	}
+}
+
+static void receive_video(void *param, struct video_data *frame)
+{
+	struct ffmpeg_output *output = param;
+	struct ffmpeg_data   *data   = &output->ff_data;
+	AVCodecContext *context = data->video->codec;
+	size_t idx;
+	bool full;
+
+	if (!data->start_timestamp)
+		data->start_timestamp = frame->timestamp;
+
+	pthread_mutex_lock(&output->encode_mutex);
+	full = data->num_queued == VIDEO_QUEUE_SIZE;
+	idx  = (data->first_queued + data->num_queued) % VIDEO_QUEUE_SIZE;
+	pthread_mutex_unlock(&output->encode_mutex);
+
+	/* the encode thread is falling behind; drop this frame rather than
+	 * holding up the other video outputs */
+	if (full) {
+		data->dropped_frames++;
+		data->total_frames++;
+		return;
+	}
+
+	/* the slot isn't visible to the encode thread until it's counted, so
+	 * it can be filled without holding the lock */
+	copy_data(&data->queued_pictures[idx], frame, context->height);
+	data->queued_pts[idx] = data->total_frames++;
+
+	pthread_mutex_lock(&output->encode_mutex);
+	data->num_queued++;
+	pthread_mutex_unlock(&output->encode_mutex);
+
+	os_sem_post(output->encode_sem);
+}
+
+static void *encode_thread(void *param)
+{
+	struct ffmpeg_output *output = param;
+	struct ffmpeg_data   *data   = &output->ff_data;
+
+	while (os_sem_wait(output->encode_sem) == 0) {
+		size_t idx;
+		bool   empty;
+
+		pthread_mutex_lock(&output->encode_mutex);
+		empty = data->num_queued == 0;
+		idx   = data->first_queued;
+		pthread_mutex_unlock(&output->encode_mutex);
+
+		/* every queued frame posts once, so waking up to an empty
+		 * queue means the output is stopping */
+		if (empty)
+			break;
+
+		encode_video(output, &data->queued_pictures[idx],
+				data->queued_pts[idx]);
+
+		pthread_mutex_lock(&output->encode_mutex);
+		data->first_queued = (data->first_queued + 1) %
+			VIDEO_QUEUE_SIZE;
+		data->num_queued--;
+		pthread_mutex_unlock(&output->encode_mutex);
+	}
+
+	return NULL;
+}
+
+static void receive_encoded(void *param, struct encoder_packet *encpacket)
+{
+	struct ffmpeg_output *output = param;
+	struct ffmpeg_data   *data   = &output->ff_data;
+	AVStream *stream = NULL;
+	AVRational time_base = {
+		encpacket->timebase_num,
+		encpacket->timebase_den
+	};
+	AVPacket packet = {0};
+	int ret;
+
+	if (encpacket->type == OBS_ENCODER_VIDEO)
+		stream = data->video;
+	else if (encpacket->track_idx < data->num_audio_streams)
+		stream = data->audio_streams[encpacket->track_idx];
+
+	if (!stream)
+		return;
+
+	av_init_packet(&packet);
+
+	/* encoder packet data is only valid for the duration of the
+	 * callback, so it has to be copied before queuing */
+	ret = av_new_packet(&packet, (int)encpacket->size);
+	if (ret < 0) {
+		blog(LOG_WARNING, "receive_encoded: Failed to allocate "
+		                  "packet: %s", av_err2str(ret));
+		return;
+	}
+
+	memcpy(packet.data, encpacket->data, encpacket->size);
 
-	data->total_frames++;
+	packet.pts = av_rescale_q(encpacket->pts, time_base,
+			stream->time_base);
+	packet.dts = av_rescale_q(encpacket->dts, time_base,
+			stream->time_base);
+	packet.stream_index = stream->index;
+
+	if (encpacket->keyframe)
+		packet.flags |= AV_PKT_FLAG_KEY;
+
+	queue_packet(output, &packet);
 }
 
 static void encode_audio(struct ffmpeg_output *output,
@@ -595,10 +935,7 @@ static void encode_audio(struct ffmpeg_output *output,
 			data->audio->time_base);
 	packet.stream_index = data->audio->index;
 
-	pthread_mutex_lock(&output->write_mutex);
-	da_push_back(output->packets, &packet);
-	pthread_mutex_unlock(&output->write_mutex);
-	os_sem_post(output->write_sem);
+	queue_packet(output, &packet);
 }
 
 static bool prepare_audio(struct ffmpeg_data *data,
@@ -656,16 +993,59 @@ static void receive_audio(void *param, struct audio_data *frame)
 	}
 }
 
+static inline uint64_t kb_per_sec(uint64_t bytes, uint64_t ns)
+{
+	return ns ? (bytes * 1000000000ULL / ns / 1024) : 0;
+}
+
+static void check_write_speed(struct ffmpeg_output *output,
+		uint64_t total_queued)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t elapsed = now - output->monitor_start;
+	uint64_t queued_rate, write_rate;
+
+	if (elapsed < MONITOR_INTERVAL_NS)
+		return;
+
+	queued_rate = kb_per_sec(total_queued - output->monitor_queued,
+			elapsed);
+	write_rate = kb_per_sec(output->monitor_written,
+			output->write_time_ns);
+
+	if (write_rate && write_rate < queued_rate * MIN_WRITE_HEADROOM) {
+		if (!output->slow_warned)
+			blog(LOG_WARNING, "ffmpeg_output: Writing at "
+			                  "%"PRIu64" KB/s while data arrives "
+			                  "at %"PRIu64" KB/s, the disk may not "
+			                  "be able to keep up",
+			                  write_rate, queued_rate);
+		output->slow_warned = true;
+	} else {
+		output->slow_warned = false;
+	}
+
+	output->monitor_start   = now;
+	output->monitor_queued  = total_queued;
+	output->monitor_written = 0;
+	output->write_time_ns   = 0;
+}
+
 static bool process_packet(struct ffmpeg_output *output)
 {
 	AVPacket packet;
 	bool new_packet = false;
+	uint64_t total_queued = 0;
+	uint64_t start;
+	size_t size;
 	int ret;
 
 	pthread_mutex_lock(&output->write_mutex);
 	if (output->packets.num) {
 		packet = output->packets.array[0];
 		da_erase(output->packets, 0);
+		output->queued_bytes -= (size_t)packet.size;
+		total_queued = output->total_queued;
 		new_packet = true;
 	}
 	pthread_mutex_unlock(&output->write_mutex);
@@ -678,6 +1058,9 @@ static bool process_packet(struct ffmpeg_output *output)
 			packet.size, packet.flags,
 			packet.stream_index, output->packets.num);*/
 
+	size  = (size_t)packet.size;
+	start = os_gettime_ns();
+
 	ret = av_interleaved_write_frame(output->ff_data.output, &packet);
 	if (ret < 0) {
 		av_free_packet(&packet);
@@ -686,6 +1069,10 @@ static bool process_packet(struct ffmpeg_output *output)
 		return false;
 	}
 
+	output->write_time_ns   += os_gettime_ns() - start;
+	output->monitor_written += size;
+
+	check_write_speed(output, total_queued);
 	return true;
 }
 
@@ -698,11 +1085,19 @@ static void *write_thread(void *data)
 		if (os_event_try(output->stop_event) == 0)
 			break;
 
-		if (!process_packet(output)) {
+		if (output->queue_overflow)
+			blog(LOG_WARNING, "ffmpeg_output: Write queue reached "
+			                  "%d MB, the output is too slow to "
+			                  "keep up, stopping",
+			                  MAX_QUEUED_BYTES / (1024 * 1024));
+
+		if (output->queue_overflow || !process_packet(output)) {
 			pthread_detach(output->write_thread);
 			output->write_thread_active = false;
 
 			ffmpeg_output_stop(output);
+			obs_output_signal_stop(output->output,
+					OBS_OUTPUT_ERROR);
 			break;
 		}
 	}
@@ -715,7 +1110,10 @@ static bool try_connect(struct ffmpeg_output *output)
 {
 	const char *filename_test;
 	obs_data_t *settings;
+	obs_encoder_t *vencoder = NULL;
+	obs_encoder_t *aencoders[MAX_AUDIO_MIXES] = {0};
 	int audio_bitrate, video_bitrate;
+	size_t audio_mixer;
 	int width, height;
 	int ret;
 
@@ -723,17 +1121,34 @@ static bool try_connect(struct ffmpeg_output *output)
 	filename_test = obs_data_get_string(settings, "filename");
 	video_bitrate = (int)obs_data_get_int(settings, "video_bitrate");
 	audio_bitrate = (int)obs_data_get_int(settings, "audio_bitrate");
+	audio_mixer   = (size_t)obs_data_get_int(settings, "audio_mixer");
 	obs_data_release(settings);
 
 	if (!filename_test || !*filename_test)
 		return false;
 
-	width  = (int)obs_output_get_width(output->output);
-	height = (int)obs_output_get_height(output->output);
+	/* encoders have to be initialized before their headers can be
+	 * used to set up the streams */
+	if (output->encoded) {
+		if (!obs_output_can_begin_data_capture(output->output, 0))
+			return false;
+		if (!obs_output_initialize_encoders(output->output, 0))
+			return false;
+
+		vencoder = obs_output_get_video_encoder(output->output);
+		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+			aencoders[i] = obs_output_get_audio_encoder(
+					output->output, i);
+		width    = (int)obs_encoder_get_width(vencoder);
+		height   = (int)obs_encoder_get_height(vencoder);
+	} else {
+		width    = (int)obs_output_get_width(output->output);
+		height   = (int)obs_output_get_height(output->output);
+	}
 
 	if (!ffmpeg_data_init(&output->ff_data, filename_test,
 				video_bitrate, audio_bitrate,
-				width, height))
+				width, height, vencoder, aencoders))
 		return false;
 
 	struct audio_convert_info aci = {
@@ -746,9 +1161,19 @@ static bool try_connect(struct ffmpeg_output *output)
 
 	output->active = true;
 
-	if (!obs_output_can_begin_data_capture(output->output, 0))
+	if (!output->encoded &&
+	    !obs_output_can_begin_data_capture(output->output, 0))
 		return false;
 
+	output->queued_bytes    = 0;
+	output->total_queued    = 0;
+	output->queue_overflow  = false;
+	output->monitor_start   = os_gettime_ns();
+	output->monitor_queued  = 0;
+	output->monitor_written = 0;
+	output->write_time_ns   = 0;
+	output->slow_warned     = false;
+
 	ret = pthread_create(&output->write_thread, NULL, write_thread, output);
 	if (ret != 0) {
 		blog(LOG_WARNING, "ffmpeg_output_start: failed to create write "
@@ -757,10 +1182,28 @@ static bool try_connect(struct ffmpeg_output *output)
 		return false;
 	}
 
-	obs_output_set_video_conversion(output->output, &vsi);
-	obs_output_set_audio_conversion(output->output, &aci);
-	obs_output_begin_data_capture(output->output, 0);
+	if (!output->encoded) {
+		obs_output_set_video_conversion(output->output, &vsi);
+		obs_output_set_audio_conversion(output->output, &aci);
+		obs_output_set_mixer(output->output, audio_mixer);
+	}
+
 	output->write_thread_active = true;
+
+	if (!output->encoded && output->ff_data.video) {
+		ret = pthread_create(&output->encode_thread, NULL,
+				encode_thread, output);
+		if (ret != 0) {
+			blog(LOG_WARNING, "ffmpeg_output_start: failed to "
+			                  "create encode thread.");
+			ffmpeg_output_stop(output);
+			return false;
+		}
+
+		output->encode_thread_active = true;
+	}
+
+	obs_output_begin_data_capture(output->output, 0);
 	return true;
 }
 
@@ -795,6 +1238,19 @@ static void ffmpeg_output_stop(void *data)
 	if (output->active) {
 		obs_output_end_data_capture(output->output);
 
+		/* frames still in the queue are encoded before the thread
+		 * sees the final post and exits */
+		if (output->encode_thread_active) {
+			os_sem_post(output->encode_sem);
+			pthread_join(output->encode_thread, NULL);
+			output->encode_thread_active = false;
+		}
+
+		if (output->ff_data.dropped_frames)
+			blog(LOG_INFO, "ffmpeg_output_stop: %u frames dropped "
+			               "by a busy encoder",
+			               output->ff_data.dropped_frames);
+
 		if (output->write_thread_active) {
 			os_event_signal(output->stop_event);
 			os_sem_post(output->write_sem);
@@ -807,6 +1263,7 @@ static void ffmpeg_output_stop(void *data)
 		for (size_t i = 0; i < output->packets.num; i++)
 			av_free_packet(output->packets.array+i);
 		da_free(output->packets);
+		output->queued_bytes = 0;
 
 		pthread_mutex_unlock(&output->write_mutex);
 
@@ -825,3 +1282,15 @@ struct obs_output_info ffmpeg_output = {
 	.raw_video = receive_video,
 	.raw_audio = receive_audio,
 };
+
+struct obs_output_info ffmpeg_muxer = {
+	.id             = "ffmpeg_muxer",
+	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+	                  OBS_OUTPUT_MULTI_TRACK,
+	.get_name       = ffmpeg_muxer_getname,
+	.create         = ffmpeg_muxer_create,
+	.destroy        = ffmpeg_output_destroy,
+	.start          = ffmpeg_output_start,
+	.stop           = ffmpeg_output_stop,
+	.encoded_packet = receive_encoded,
+};
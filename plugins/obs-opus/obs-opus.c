@@ -0,0 +1,265 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <opus/opus.h>
+
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-opus", "en-US")
+
+#define do_log(level, format, ...) \
+	blog(level, "[opus encoder: '%s'] " format, \
+			obs_encoder_get_name(enc->encoder), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* opus always runs at 48khz internally, libobs resamples to that.  more than
+ * two channels would need the multistream API, so anything else is mixed
+ * down to stereo */
+#define OPUS_SAMPLE_RATE  48000
+
+/* recommended maximum packet size from the libopus documentation */
+#define MAX_PACKET_SIZE   4000
+
+/* "OpusHead" identification header, as used by Ogg, Matroska and ffmpeg */
+#define OPUS_HEADER_SIZE  19
+
+struct opus_encoder {
+	obs_encoder_t    *encoder;
+	OpusEncoder      *opus;
+
+	int              channels;
+	int              frame_size;
+	int              lookahead;
+	int64_t          total_samples;
+
+	uint8_t          header[OPUS_HEADER_SIZE];
+	uint8_t          packet_buffer[MAX_PACKET_SIZE];
+};
+
+static const char *opus_getname(void)
+{
+	return obs_module_text("Opus");
+}
+
+static void opus_destroy(void *data)
+{
+	struct opus_encoder *enc = data;
+
+	if (enc->opus)
+		opus_encoder_destroy(enc->opus);
+	bfree(enc);
+}
+
+static inline void set_le16(uint8_t *data, uint16_t val)
+{
+	data[0] = (uint8_t)val;
+	data[1] = (uint8_t)(val >> 8);
+}
+
+static inline void set_le32(uint8_t *data, uint32_t val)
+{
+	set_le16(data, (uint16_t)val);
+	set_le16(data + 2, (uint16_t)(val >> 16));
+}
+
+static void init_header(struct opus_encoder *enc, uint32_t input_rate)
+{
+	uint8_t *header = enc->header;
+
+	memcpy(header, "OpusHead", 8);
+	header[8] = 1; /* version */
+	header[9] = (uint8_t)enc->channels;
+	set_le16(header + 10, (uint16_t)enc->lookahead); /* pre-skip */
+	set_le32(header + 12, input_rate);
+	set_le16(header + 16, 0); /* output gain */
+	header[18] = 0; /* channel mapping family: mono/stereo */
+}
+
+static bool opus_update(void *data, obs_data_t *settings)
+{
+	struct opus_encoder *enc = data;
+	int bitrate = (int)obs_data_get_int(settings, "bitrate") * 1000;
+	int ret;
+
+	ret = opus_encoder_ctl(enc->opus, OPUS_SET_BITRATE(bitrate));
+	if (ret != OPUS_OK) {
+		warn("Failed to set bitrate: %s", opus_strerror(ret));
+		return false;
+	}
+
+	return true;
+}
+
+static inline int get_channels(audio_t *audio)
+{
+	return audio_output_get_channels(audio) > 1 ? 2 : 1;
+}
+
+static void *opus_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	struct opus_encoder *enc;
+	audio_t *audio       = obs_encoder_audio(encoder);
+	int     bitrate      = (int)obs_data_get_int(settings, "bitrate");
+	int     frame_ms     = (int)obs_data_get_int(settings, "frame_ms");
+	bool    low_delay    = obs_data_get_bool(settings, "low_delay");
+	int     application  = low_delay ?
+		OPUS_APPLICATION_RESTRICTED_LOWDELAY :
+		OPUS_APPLICATION_AUDIO;
+	int     ret;
+
+	if (!bitrate) {
+		blog(LOG_WARNING, "[opus encoder]: Invalid bitrate specified");
+		return NULL;
+	}
+
+	if (frame_ms != 10 && frame_ms != 20)
+		frame_ms = 20;
+
+	enc             = bzalloc(sizeof(struct opus_encoder));
+	enc->encoder    = encoder;
+	enc->channels   = get_channels(audio);
+	enc->frame_size = OPUS_SAMPLE_RATE / 1000 * frame_ms;
+
+	enc->opus = opus_encoder_create(OPUS_SAMPLE_RATE, enc->channels,
+			application, &ret);
+	if (!enc->opus) {
+		warn("Failed to create encoder: %s", opus_strerror(ret));
+		goto fail;
+	}
+
+	if (!opus_update(enc, settings))
+		goto fail;
+
+	/* the delay of the encoder, packets are timestamped for the audio
+	 * they decode to and players skip this much at the start */
+	opus_encoder_ctl(enc->opus, OPUS_GET_LOOKAHEAD(&enc->lookahead));
+	init_header(enc, audio_output_get_sample_rate(audio));
+
+	info("bitrate: %d, channels: %d, frame: %d ms, low delay: %s, "
+	     "lookahead: %d samples", bitrate, enc->channels, frame_ms,
+	     low_delay ? "yes" : "no", enc->lookahead);
+	return enc;
+
+fail:
+	opus_destroy(enc);
+	return NULL;
+}
+
+static bool opus_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	struct opus_encoder *enc = data;
+	opus_int32 size;
+
+	size = opus_encode_float(enc->opus, (const float*)frame->data[0],
+			enc->frame_size, enc->packet_buffer, MAX_PACKET_SIZE);
+	if (size < 0) {
+		warn("Failed to encode frame: %s", opus_strerror(size));
+		return false;
+	}
+
+	packet->pts          = enc->total_samples - enc->lookahead;
+	packet->dts          = packet->pts;
+	packet->data         = enc->packet_buffer;
+	packet->size         = (size_t)size;
+	packet->type         = OBS_ENCODER_AUDIO;
+	packet->timebase_num = 1;
+	packet->timebase_den = OPUS_SAMPLE_RATE;
+	*received_packet     = true;
+
+	enc->total_samples += enc->frame_size;
+	return true;
+}
+
+static void opus_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "bitrate", 96);
+	obs_data_set_default_int(settings, "frame_ms", 20);
+	obs_data_set_default_bool(settings, "low_delay", false);
+}
+
+static obs_properties_t *opus_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t   *p;
+
+	obs_properties_add_int(props, "bitrate",
+			obs_module_text("Bitrate"), 16, 512, 16);
+
+	p = obs_properties_add_list(props, "frame_ms",
+			obs_module_text("FrameDuration"),
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, "10 ms", 10);
+	obs_property_list_add_int(p, "20 ms", 20);
+
+	obs_properties_add_bool(props, "low_delay",
+			obs_module_text("LowDelay"));
+	return props;
+}
+
+static bool opus_extra_data(void *data, uint8_t **extra_data, size_t *size)
+{
+	struct opus_encoder *enc = data;
+
+	*extra_data = enc->header;
+	*size       = OPUS_HEADER_SIZE;
+	return true;
+}
+
+static bool opus_audio_info(void *data, struct audio_convert_info *info)
+{
+	struct opus_encoder *enc = data;
+
+	memset(info, 0, sizeof(struct audio_convert_info));
+	info->format          = AUDIO_FORMAT_FLOAT;
+	info->samples_per_sec = OPUS_SAMPLE_RATE;
+	info->speakers        = enc->channels == 1 ?
+		SPEAKERS_MONO : SPEAKERS_STEREO;
+	return true;
+}
+
+static size_t opus_frame_size(void *data)
+{
+	struct opus_encoder *enc = data;
+	return (size_t)enc->frame_size;
+}
+
+struct obs_encoder_info opus_encoder_info = {
+	.id             = "opus",
+	.type           = OBS_ENCODER_AUDIO,
+	.codec          = "opus",
+	.get_name       = opus_getname,
+	.create         = opus_create,
+	.destroy        = opus_destroy,
+	.encode         = opus_encode,
+	.update         = opus_update,
+	.get_frame_size = opus_frame_size,
+	.get_defaults   = opus_defaults,
+	.get_properties = opus_properties,
+	.get_extra_data = opus_extra_data,
+	.get_audio_info = opus_audio_info
+};
+
+bool obs_module_load(void)
+{
+	obs_register_encoder(&opus_encoder_info);
+	return true;
+}
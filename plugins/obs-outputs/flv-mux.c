@@ -60,7 +60,7 @@ static void build_flv_meta_data(obs_output_t *context,
 		uint8_t **output, size_t *size)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
-	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context, 0);
 	video_t       *video    = obs_encoder_video(vencoder);
 	audio_t       *audio    = obs_encoder_audio(aencoder);
 	char buf[4096];
@@ -71,19 +71,23 @@ static void build_flv_meta_data(obs_output_t *context,
 	enc_str(&enc, end, "onMetaData");
 
 	*enc++ = AMF_ECMA_ARRAY;
-	enc    = AMF_EncodeInt32(enc, end, 14);
+	enc    = AMF_EncodeInt32(enc, end, vencoder ? 14 : 9);
 
 	enc_num_val(&enc, end, "duration", 0.0);
 	enc_num_val(&enc, end, "fileSize", 0.0);
 
-	enc_num_val(&enc, end, "width",
-			(double)obs_encoder_get_width(vencoder));
-	enc_num_val(&enc, end, "height",
-			(double)obs_encoder_get_height(vencoder));
-
-	enc_str_val(&enc, end, "videocodecid", "avc1");
-	enc_num_val(&enc, end, "videodatarate", encoder_bitrate(vencoder));
-	enc_num_val(&enc, end, "framerate", video_output_get_frame_rate(video));
+	if (vencoder) {
+		enc_num_val(&enc, end, "width",
+				(double)obs_encoder_get_width(vencoder));
+		enc_num_val(&enc, end, "height",
+				(double)obs_encoder_get_height(vencoder));
+
+		enc_str_val(&enc, end, "videocodecid", "avc1");
+		enc_num_val(&enc, end, "videodatarate",
+				encoder_bitrate(vencoder));
+		enc_num_val(&enc, end, "framerate",
+				video_output_get_frame_rate(video));
+	}
 
 	enc_str_val(&enc, end, "audiocodecid", "mp4a");
 	enc_num_val(&enc, end, "audiodatarate", encoder_bitrate(aencoder));
@@ -129,6 +133,7 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 	uint8_t *meta_data;
 	size_t  meta_data_size;
 	uint32_t start_pos;
+	bool    has_video = obs_output_get_video_encoder(context) != NULL;
 
 	array_output_serializer_init(&s, &data);
 
@@ -137,7 +142,7 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 	if (write_header) {
 		s_write(&s, "FLV", 3);
 		s_w8(&s, 1);
-		s_w8(&s, 5);
+		s_w8(&s, has_video ? 5 : 4); /* audio | video flags */
 		s_wb32(&s, 9);
 		s_wb32(&s, 0);
 	}
@@ -167,8 +172,9 @@ static int32_t last_time = 0;
 static void flv_video(struct serializer *s, struct encoder_packet *packet,
 		bool is_header)
 {
-	int64_t offset  = packet->pts - packet->dts;
-	int32_t time_ms = get_ms_time(packet, packet->dts);
+	int64_t  offset  = packet->pts - packet->dts;
+	int32_t  time_ms = get_ms_time(packet, packet->dts);
+	uint64_t start   = serializer_get_pos(s);
 
 	if (!packet->data || !packet->size)
 		return;
@@ -196,13 +202,14 @@ static void flv_video(struct serializer *s, struct encoder_packet *packet,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesnt count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) + 4 - 1);
+	s_wb32(s, (uint32_t)(serializer_get_pos(s) - start) + 4 - 1);
 }
 
 static void flv_audio(struct serializer *s, struct encoder_packet *packet,
 		bool is_header)
 {
-	int32_t time_ms = get_ms_time(packet, packet->dts);
+	int32_t  time_ms = get_ms_time(packet, packet->dts);
+	uint64_t start   = serializer_get_pos(s);
 
 	if (!packet->data || !packet->size)
 		return;
@@ -229,7 +236,7 @@ static void flv_audio(struct serializer *s, struct encoder_packet *packet,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesnt count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) + 4 - 1);
+	s_wb32(s, (uint32_t)(serializer_get_pos(s) - start) + 4 - 1);
 }
 
 void flv_packet_mux(struct encoder_packet *packet,
@@ -248,3 +255,19 @@ void flv_packet_mux(struct encoder_packet *packet,
 	*output = data.bytes.array;
 	*size   = data.bytes.num;
 }
+
+void flv_packet_mux_append(struct encoder_packet *packet,
+		struct array_output_data *output, bool is_header)
+{
+	struct array_output_data data = *output;
+	struct serializer s;
+
+	/* the serializer init clears the array, keep what is already in it */
+	array_output_serializer_init(&s, output);
+	*output = data;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		flv_video(&s, packet, is_header);
+	else
+		flv_audio(&s, packet, is_header);
+}
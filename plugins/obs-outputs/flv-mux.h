@@ -18,6 +18,7 @@
 #pragma once
 
 #include <obs.h>
+#include <util/array-serializer.h>
 
 #define MILLISECOND_DEN   1000
 
@@ -32,3 +33,8 @@ extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 		bool write_header);
 extern void flv_packet_mux(struct encoder_packet *packet,
 		uint8_t **output, size_t *size, bool is_header);
+
+/* appends the tag to the array instead of allocating a new one, so the same
+ * buffer can be reused for every packet */
+extern void flv_packet_mux_append(struct encoder_packet *packet,
+		struct array_output_data *output, bool is_header);
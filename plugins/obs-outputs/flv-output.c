@@ -21,6 +21,8 @@
 #include <util/platform.h>
 #include <util/dstr.h>
 #include <util/threading.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
 #include <inttypes.h>
 #include "flv-mux.h"
 
@@ -31,12 +33,61 @@
 #define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
+/* muxed data is queued in memory and written to disk by a separate thread in
+ * large blocks, so a slow disk never blocks the encoder threads.  data is
+ * written once a block has accumulated, or after WRITE_INTERVAL_NS so that
+ * low bitrate recordings still reach the disk regularly. */
+#define WRITE_BLOCK_SIZE    (1024 * 1024)
+#define WRITE_INTERVAL_NS   1000000000ULL
+#define QUEUE_RESERVE_SIZE  (8 * 1024 * 1024)
+#define QUEUE_WARN_SIZE     (64 * 1024 * 1024)
+
+/* if the disk can't keep up at all the queue would grow until memory runs
+ * out, so the output stops with an error once it reaches this size */
+#define QUEUE_MAX_SIZE      (512 * 1024 * 1024)
+
+/* disk space for the file is reserved this far ahead of the data written, so
+ * the file isn't fragmented as it grows */
+#define PREALLOC_SIZE       (64 * 1024 * 1024)
+
+/* over every interval, the speed the disk writes at is compared to the rate
+ * data is queued at, to warn about a disk that is barely keeping up before
+ * the queue starts to grow */
+#define MONITOR_INTERVAL_NS 10000000000ULL
+#define MIN_WRITE_HEADROOM  2
+
 struct flv_output {
-	obs_output_t *output;
-	struct dstr  path;
-	FILE         *file;
-	bool         active;
-	int64_t      last_packet_ts;
+	obs_output_t     *output;
+	struct dstr      path;
+	FILE             *file;
+	bool             active;
+	int64_t          last_packet_ts;
+
+	pthread_t        write_thread;
+	os_sem_t         *write_sem;
+	os_event_t       *stop_event;
+
+	pthread_mutex_t  queue_mutex;
+	struct circlebuf queue;
+	size_t           max_queue_size;
+	uint64_t         total_queued;
+	bool             queue_warned;
+	bool             queue_overflow;
+
+	DARRAY(uint8_t)  write_data;
+	uint64_t         last_write_time;
+	uint64_t         total_bytes;
+	bool             write_failed;
+	bool             stop_signaled;
+
+	int64_t          reserved_size;
+	bool             prealloc_failed;
+
+	uint64_t         monitor_start;
+	uint64_t         monitor_queued;
+	uint64_t         monitor_written;
+	uint64_t         write_time_ns;
+	bool             slow_warned;
 };
 
 static const char *flv_output_getname(void)
@@ -53,36 +104,247 @@ static void flv_output_destroy(void *data)
 	if (stream->active)
 		flv_output_stop(data);
 
-	dstr_free(&stream->path);
-	bfree(stream);
+	if (stream) {
+		dstr_free(&stream->path);
+		os_event_destroy(stream->stop_event);
+		os_sem_destroy(stream->write_sem);
+		pthread_mutex_destroy(&stream->queue_mutex);
+		circlebuf_free(&stream->queue);
+		da_free(stream->write_data);
+		bfree(stream);
+	}
 }
 
 static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct flv_output *stream = bzalloc(sizeof(struct flv_output));
 	stream->output = output;
+	pthread_mutex_init_value(&stream->queue_mutex);
+
+	if (pthread_mutex_init(&stream->queue_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
 
 	UNUSED_PARAMETER(settings);
 	return stream;
+
+fail:
+	flv_output_destroy(stream);
+	return NULL;
+}
+
+/* takes everything queued so far if a full block is available, if the write
+ * interval passed, or if the output is stopping */
+static bool take_queued_data(struct flv_output *stream, bool force,
+		uint64_t *total_queued)
+{
+	uint64_t now = os_gettime_ns();
+	bool take;
+
+	pthread_mutex_lock(&stream->queue_mutex);
+
+	*total_queued = stream->total_queued;
+
+	take = stream->queue.size && (force ||
+			stream->queue.size >= WRITE_BLOCK_SIZE ||
+			now - stream->last_write_time >= WRITE_INTERVAL_NS);
+
+	if (take) {
+		da_resize(stream->write_data, stream->queue.size);
+		circlebuf_pop_front(&stream->queue, stream->write_data.array,
+				stream->queue.size);
+	}
+
+	pthread_mutex_unlock(&stream->queue_mutex);
+
+	if (take)
+		stream->last_write_time = now;
+	return take;
+}
+
+static void reserve_file_space(struct flv_output *stream, size_t size)
+{
+	int64_t end = (int64_t)(stream->total_bytes + size);
+
+	if (stream->prealloc_failed || end <= stream->reserved_size)
+		return;
+
+	while (stream->reserved_size < end)
+		stream->reserved_size += PREALLOC_SIZE;
+
+	if (!os_fpreallocate(stream->file, stream->reserved_size)) {
+		info("Unable to reserve disk space for the file, writing "
+		     "without preallocation");
+		stream->prealloc_failed = true;
+	}
+}
+
+static inline uint64_t kb_per_sec(uint64_t bytes, uint64_t ns)
+{
+	return ns ? (bytes * 1000000000ULL / ns / 1024) : 0;
+}
+
+static void check_write_speed(struct flv_output *stream,
+		uint64_t total_queued)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t elapsed = now - stream->monitor_start;
+	uint64_t queued_rate, write_rate;
+
+	if (elapsed < MONITOR_INTERVAL_NS)
+		return;
+
+	queued_rate = kb_per_sec(total_queued - stream->monitor_queued,
+			elapsed);
+	write_rate = kb_per_sec(stream->monitor_written,
+			stream->write_time_ns);
+
+	if (write_rate && write_rate < queued_rate * MIN_WRITE_HEADROOM) {
+		if (!stream->slow_warned)
+			warn("The disk is writing at %"PRIu64" KB/s while "
+			     "recording at %"PRIu64" KB/s, it may not be able "
+			     "to keep up", write_rate, queued_rate);
+		stream->slow_warned = true;
+	} else {
+		stream->slow_warned = false;
+	}
+
+	stream->monitor_start   = now;
+	stream->monitor_queued  = total_queued;
+	stream->monitor_written = 0;
+	stream->write_time_ns   = 0;
+}
+
+/* stopping from the write thread only ends data capture, the thread itself
+ * keeps running until the output is stopped */
+static void signal_error(struct flv_output *stream)
+{
+	if (!stream->stop_signaled) {
+		stream->stop_signaled = true;
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_ERROR);
+	}
+}
+
+static void write_queued_data(struct flv_output *stream, bool force)
+{
+	uint64_t total_queued;
+	uint64_t start;
+	size_t size;
+
+	if (!take_queued_data(stream, force, &total_queued))
+		return;
+	if (stream->write_failed)
+		return;
+
+	size = stream->write_data.num;
+	reserve_file_space(stream, size);
+
+	start = os_gettime_ns();
+	if (fwrite(stream->write_data.array, 1, size, stream->file) != size) {
+		warn("Failed to write to FLV file '%s'", stream->path.array);
+		stream->write_failed = true;
+		if (!force)
+			signal_error(stream);
+		return;
+	}
+
+	stream->write_time_ns   += os_gettime_ns() - start;
+	stream->monitor_written += size;
+	stream->total_bytes     += size;
+
+	check_write_speed(stream, total_queued);
+}
+
+static void *write_thread(void *data)
+{
+	struct flv_output *stream = data;
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		if (os_event_try(stream->stop_event) != EAGAIN)
+			break;
+
+		if (stream->queue_overflow && !stream->stop_signaled) {
+			warn("Write queue reached %d MB, the disk is too slow "
+			     "to record to, stopping",
+			     QUEUE_MAX_SIZE / (1024 * 1024));
+			signal_error(stream);
+		}
+
+		write_queued_data(stream, false);
+	}
+
+	write_queued_data(stream, true);
+	return NULL;
 }
 
 static void flv_output_stop(void *data)
 {
 	struct flv_output *stream = data;
+	void *ret;
 
 	if (stream->active) {
-		if (stream->file)
-			write_file_info(stream->file, stream->last_packet_ts,
-					os_ftelli64(stream->file));
+		obs_output_end_data_capture(stream->output);
+
+		os_event_signal(stream->stop_event);
+		os_sem_post(stream->write_sem);
+		pthread_join(stream->write_thread, &ret);
+		os_event_reset(stream->stop_event);
+
+		write_file_info(stream->file, stream->last_packet_ts,
+				os_ftelli64(stream->file));
+
+		if (stream->reserved_size)
+			os_fpreallocate(stream->file, 0);
 
 		fclose(stream->file);
-		obs_output_end_data_capture(stream->output);
+		stream->file   = NULL;
 		stream->active = false;
 
-		info("FLV file output complete");
+		info("FLV file output complete, %"PRIu64" bytes written, "
+		     "peak write queue %"PRIu64" KB", stream->total_bytes,
+		     (uint64_t)stream->max_queue_size / 1024);
 	}
 }
 
+/* called from the encoder threads, only copies the data to the queue */
+static void queue_data(struct flv_output *stream, const uint8_t *data,
+		size_t size)
+{
+	bool warn_size = false;
+	size_t queued;
+
+	pthread_mutex_lock(&stream->queue_mutex);
+
+	if (stream->queue.size + size > QUEUE_MAX_SIZE) {
+		stream->queue_overflow = true;
+		pthread_mutex_unlock(&stream->queue_mutex);
+		os_sem_post(stream->write_sem);
+		return;
+	}
+
+	circlebuf_push_back(&stream->queue, data, size);
+	stream->total_queued += size;
+
+	queued = stream->queue.size;
+	if (queued > stream->max_queue_size)
+		stream->max_queue_size = queued;
+	if (queued > QUEUE_WARN_SIZE && !stream->queue_warned) {
+		stream->queue_warned = true;
+		warn_size = true;
+	}
+
+	pthread_mutex_unlock(&stream->queue_mutex);
+
+	if (warn_size)
+		warn("Write queue has grown to %"PRIu64" KB, the disk may be "
+		     "too slow", (uint64_t)queued / 1024);
+
+	os_sem_post(stream->write_sem);
+}
+
 static int write_packet(struct flv_output *stream,
 		struct encoder_packet *packet, bool is_header)
 {
@@ -93,9 +355,8 @@ static int write_packet(struct flv_output *stream,
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
 	flv_packet_mux(packet, &data, &size, is_header);
-	fwrite(data, 1, size, stream->file);
+	queue_data(stream, data, size);
 	bfree(data);
-	obs_free_encoder_packet(packet);
 
 	return ret;
 }
@@ -106,14 +367,14 @@ static void write_meta_data(struct flv_output *stream)
 	size_t  meta_data_size;
 
 	flv_meta_data(stream->output, &meta_data, &meta_data_size, true);
-	fwrite(meta_data, 1, meta_data_size, stream->file);
+	queue_data(stream, meta_data, meta_data_size);
 	bfree(meta_data);
 }
 
 static void write_audio_header(struct flv_output *stream)
 {
 	obs_output_t  *context  = stream->output;
-	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context, 0);
 	uint8_t       *header;
 
 	struct encoder_packet packet   = {
@@ -122,7 +383,7 @@ static void write_audio_header(struct flv_output *stream)
 	};
 
 	obs_encoder_get_extra_data(aencoder, &header, &packet.size);
-	packet.data = bmemdup(header, packet.size);
+	packet.data = header;
 	write_packet(stream, &packet, true);
 }
 
@@ -139,9 +400,13 @@ static void write_video_header(struct flv_output *stream)
 		.keyframe     = true
 	};
 
+	if (!vencoder)
+		return;
+
 	obs_encoder_get_extra_data(vencoder, &header, &size);
 	packet.size = obs_parse_avc_header(&packet.data, header, size);
 	write_packet(stream, &packet, true);
+	bfree(packet.data);
 }
 
 static void write_headers(struct flv_output *stream)
@@ -174,6 +439,32 @@ static bool flv_output_start(void *data)
 		return false;
 	}
 
+	stream->total_bytes     = 0;
+	stream->max_queue_size  = 0;
+	stream->total_queued    = 0;
+	stream->queue_warned    = false;
+	stream->queue_overflow  = false;
+	stream->write_failed    = false;
+	stream->stop_signaled   = false;
+	stream->reserved_size   = 0;
+	stream->prealloc_failed = false;
+	stream->last_write_time = os_gettime_ns();
+	stream->monitor_start   = stream->last_write_time;
+	stream->monitor_queued  = 0;
+	stream->monitor_written = 0;
+	stream->write_time_ns   = 0;
+	stream->slow_warned     = false;
+	circlebuf_free(&stream->queue);
+	circlebuf_reserve(&stream->queue, QUEUE_RESERVE_SIZE);
+
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+				stream) != 0) {
+		warn("Failed to create write thread");
+		fclose(stream->file);
+		stream->file = NULL;
+		return false;
+	}
+
 	/* write headers and start capture */
 	stream->active = true;
 	write_headers(stream);
@@ -191,12 +482,18 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 	if (packet->type == OBS_ENCODER_VIDEO) {
 		obs_parse_avc_packet(&parsed_packet, packet);
 		write_packet(stream, &parsed_packet, false);
-		obs_free_encoder_packet(&parsed_packet);
+		obs_encoder_packet_release(&parsed_packet);
 	} else {
 		write_packet(stream, packet, false);
 	}
 }
 
+static uint64_t flv_output_total_bytes(void *data)
+{
+	struct flv_output *stream = data;
+	return stream->total_bytes;
+}
+
 static obs_properties_t *flv_output_properties(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -210,13 +507,14 @@ static obs_properties_t *flv_output_properties(void *unused)
 }
 
 struct obs_output_info flv_output_info = {
-	.id             = "flv_output",
-	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
-	.get_name       = flv_output_getname,
-	.create         = flv_output_create,
-	.destroy        = flv_output_destroy,
-	.start          = flv_output_start,
-	.stop           = flv_output_stop,
-	.encoded_packet = flv_output_data,
-	.get_properties = flv_output_properties
+	.id              = "flv_output",
+	.flags           = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name        = flv_output_getname,
+	.create          = flv_output_create,
+	.destroy         = flv_output_destroy,
+	.start           = flv_output_start,
+	.stop            = flv_output_stop,
+	.encoded_packet  = flv_output_data,
+	.get_total_bytes = flv_output_total_bytes,
+	.get_properties  = flv_output_properties
 };
@@ -0,0 +1,571 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include <inttypes.h>
+#include "ts-mux.h"
+#include "mp4-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[hls output: '%s'] " format, \
+			obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/*
+ * Writes HLS segments and a live playlist to a directory, for a local web
+ * server to serve as-is.  Segments are cut at the first video keyframe after
+ * the target duration, which by default is the keyframe interval of the
+ * video encoder, so every segment is a whole number of GOPs.
+ *
+ * The encoder thread only muxes in to memory.  Finished segments are queued
+ * and written to disk, along with the updated playlist, by a separate
+ * thread.  A segment is only added to the playlist once it is completely
+ * written.
+ */
+#define DEFAULT_SEGMENT_SEC   4
+#define DEFAULT_PLAYLIST_SIZE 6
+
+struct hls_segment {
+	uint32_t                 index;
+	double                   duration;
+	struct array_output_data data;
+};
+
+struct hls_entry {
+	uint32_t                 index;
+	double                   duration;
+};
+
+struct hls_output {
+	obs_output_t     *output;
+	bool             active;
+
+	struct dstr      path;
+	struct dstr      name;
+	bool             fmp4;
+	int64_t          segment_usec;
+	size_t           playlist_size;
+	bool             delete_segments;
+
+	/* encoder thread state */
+	struct ts_mux    ts;
+	struct mp4_mux   mp4;
+	struct array_output_data segment;
+	uint32_t         segment_index;
+	int64_t          segment_start_usec;
+	int64_t          last_dts_usec;
+	bool             started;
+
+	pthread_t        write_thread;
+	os_sem_t         *write_sem;
+	os_event_t       *stop_event;
+
+	pthread_mutex_t  queue_mutex;
+	DARRAY(struct hls_segment) queue;
+
+	/* write thread state */
+	DARRAY(struct hls_segment) write_segments;
+	DARRAY(struct hls_entry) entries;
+	int              target_duration;
+	uint64_t         total_bytes;
+	struct dstr      file_path;
+	struct dstr      playlist;
+};
+
+static const char *hls_output_getname(void)
+{
+	return obs_module_text("HLSOutput");
+}
+
+static void free_segments(struct hls_segment *segments, size_t num)
+{
+	for (size_t i = 0; i < num; i++)
+		array_output_serializer_free(&segments[i].data);
+}
+
+static void hls_output_stop(void *data);
+
+static void hls_output_destroy(void *data)
+{
+	struct hls_output *stream = data;
+
+	if (stream->active)
+		hls_output_stop(data);
+
+	if (stream) {
+		dstr_free(&stream->path);
+		dstr_free(&stream->name);
+		dstr_free(&stream->file_path);
+		dstr_free(&stream->playlist);
+		os_event_destroy(stream->stop_event);
+		os_sem_destroy(stream->write_sem);
+		pthread_mutex_destroy(&stream->queue_mutex);
+		free_segments(stream->queue.array, stream->queue.num);
+		da_free(stream->queue);
+		da_free(stream->write_segments);
+		da_free(stream->entries);
+		array_output_serializer_free(&stream->segment);
+		bfree(stream);
+	}
+}
+
+static void *hls_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct hls_output *stream = bzalloc(sizeof(struct hls_output));
+	stream->output = output;
+	pthread_mutex_init_value(&stream->queue_mutex);
+
+	if (pthread_mutex_init(&stream->queue_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	hls_output_destroy(stream);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* write thread */
+
+static inline const char *segment_ext(struct hls_output *stream)
+{
+	return stream->fmp4 ? "m4s" : "ts";
+}
+
+static void segment_path(struct hls_output *stream, uint32_t index)
+{
+	dstr_printf(&stream->file_path, "%s/%s%"PRIu32".%s",
+			stream->path.array, stream->name.array, index,
+			segment_ext(stream));
+}
+
+static bool write_file(struct hls_output *stream, const uint8_t *data,
+		size_t size)
+{
+	FILE *file = os_fopen(stream->file_path.array, "wb");
+	bool success;
+
+	if (!file) {
+		warn("Unable to open '%s'", stream->file_path.array);
+		return false;
+	}
+
+	success = fwrite(data, 1, size, file) == size;
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success)
+		warn("Failed to write '%s'", stream->file_path.array);
+	return success;
+}
+
+/* EXTINF durations rounded to the nearest integer must not exceed the target
+ * duration, and the target duration must not change during the stream */
+static void write_playlist(struct hls_output *stream, bool ended)
+{
+	struct dstr *playlist = &stream->playlist;
+	uint32_t    first = stream->entries.num ?
+		stream->entries.array[0].index : 0;
+
+	for (size_t i = 0; i < stream->entries.num; i++) {
+		int duration = (int)(stream->entries.array[i].duration + 0.5);
+		if (stream->target_duration < duration)
+			stream->target_duration = duration;
+	}
+
+	dstr_printf(playlist, "#EXTM3U\n"
+			"#EXT-X-VERSION:%d\n"
+			"#EXT-X-TARGETDURATION:%d\n"
+			"#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+			stream->fmp4 ? 7 : 3, stream->target_duration, first);
+
+	if (stream->fmp4)
+		dstr_catf(playlist, "#EXT-X-MAP:URI=\"%s_init.mp4\"\n",
+				stream->name.array);
+
+	for (size_t i = 0; i < stream->entries.num; i++) {
+		struct hls_entry *entry = stream->entries.array + i;
+
+		dstr_catf(playlist, "#EXTINF:%.3f,\n%s%"PRIu32".%s\n",
+				entry->duration, stream->name.array,
+				entry->index, segment_ext(stream));
+	}
+
+	if (ended)
+		dstr_cat(playlist, "#EXT-X-ENDLIST\n");
+
+	dstr_printf(&stream->file_path, "%s/%s.m3u8", stream->path.array,
+			stream->name.array);
+
+	/* replaced atomically, servers never see a partial playlist */
+	if (!os_safe_write_utf8_file(stream->file_path.array, playlist->array,
+				playlist->len, false))
+		warn("Failed to write playlist '%s'",
+				stream->file_path.array);
+}
+
+static void remove_old_entries(struct hls_output *stream)
+{
+	while (stream->entries.num > stream->playlist_size) {
+		if (stream->delete_segments) {
+			segment_path(stream, stream->entries.array[0].index);
+			os_unlink(stream->file_path.array);
+		}
+
+		da_erase(stream->entries, 0);
+	}
+}
+
+static void write_segment(struct hls_output *stream,
+		struct hls_segment *segment)
+{
+	struct hls_entry entry = {segment->index, segment->duration};
+	uint8_t          *bytes = segment->data.bytes.array;
+	size_t           size   = segment->data.bytes.num;
+
+	segment_path(stream, segment->index);
+	if (!write_file(stream, bytes, size))
+		return;
+
+	stream->total_bytes += size;
+
+	da_push_back(stream->entries, &entry);
+	remove_old_entries(stream);
+	write_playlist(stream, false);
+}
+
+static void write_queued_segments(struct hls_output *stream)
+{
+	pthread_mutex_lock(&stream->queue_mutex);
+	da_move(stream->write_segments, stream->queue);
+	pthread_mutex_unlock(&stream->queue_mutex);
+
+	for (size_t i = 0; i < stream->write_segments.num; i++)
+		write_segment(stream, stream->write_segments.array + i);
+
+	free_segments(stream->write_segments.array,
+			stream->write_segments.num);
+	da_resize(stream->write_segments, 0);
+}
+
+static void *write_thread(void *data)
+{
+	struct hls_output *stream = data;
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		if (os_event_try(stream->stop_event) != EAGAIN)
+			break;
+		write_queued_segments(stream);
+	}
+
+	write_queued_segments(stream);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* encoder thread */
+
+static void finish_segment(struct hls_output *stream, int64_t end_usec)
+{
+	struct hls_segment segment;
+
+	if (!stream->segment.bytes.num)
+		return;
+
+	segment.index    = stream->segment_index++;
+	segment.duration = (double)(end_usec - stream->segment_start_usec) /
+		1000000.0;
+	segment.data     = stream->segment;
+	memset(&stream->segment, 0, sizeof(stream->segment));
+
+	pthread_mutex_lock(&stream->queue_mutex);
+	da_push_back(stream->queue, &segment);
+	pthread_mutex_unlock(&stream->queue_mutex);
+
+	os_sem_post(stream->write_sem);
+
+	stream->segment_start_usec = end_usec;
+}
+
+static void mux_packet(struct hls_output *stream,
+		struct encoder_packet *packet)
+{
+	bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+	bool cut = keyframe && packet->dts_usec - stream->segment_start_usec >=
+		stream->segment_usec;
+	uint8_t *fragment;
+	size_t  size;
+
+	/* mp4 fragments start at keyframes and are returned once the next
+	 * keyframe arrives, so the fragment returned here belongs to the
+	 * segment being finished */
+	if (stream->fmp4) {
+		if (mp4_mux_packet(&stream->mp4, packet, &fragment, &size)) {
+			da_push_back_array(stream->segment.bytes, fragment,
+					size);
+			bfree(fragment);
+		}
+		if (cut)
+			finish_segment(stream, packet->dts_usec);
+	} else {
+		if (cut)
+			finish_segment(stream, packet->dts_usec);
+		ts_mux_packet(&stream->ts, packet, &stream->segment);
+	}
+}
+
+static void hls_output_data(void *data, struct encoder_packet *packet)
+{
+	struct hls_output     *stream = data;
+	struct encoder_packet parsed_packet;
+
+	/* segments have to start with a keyframe */
+	if (!stream->started) {
+		if (packet->type != OBS_ENCODER_VIDEO || !packet->keyframe)
+			return;
+
+		stream->started            = true;
+		stream->segment_start_usec = packet->dts_usec;
+	}
+
+	stream->last_dts_usec = packet->dts_usec;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		obs_parse_avc_packet(&parsed_packet, packet);
+		mux_packet(stream, &parsed_packet);
+		obs_encoder_packet_release(&parsed_packet);
+	} else {
+		mux_packet(stream, packet);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void hls_output_stop(void *data)
+{
+	struct hls_output *stream = data;
+	uint8_t *fragment;
+	size_t  size;
+	void    *ret;
+
+	if (!stream->active)
+		return;
+
+	obs_output_end_data_capture(stream->output);
+
+	if (stream->fmp4 && mp4_mux_flush(&stream->mp4, &fragment, &size)) {
+		da_push_back_array(stream->segment.bytes, fragment, size);
+		bfree(fragment);
+	}
+	finish_segment(stream, stream->last_dts_usec);
+
+	os_event_signal(stream->stop_event);
+	os_sem_post(stream->write_sem);
+	pthread_join(stream->write_thread, &ret);
+	os_event_reset(stream->stop_event);
+
+	write_playlist(stream, true);
+
+	if (stream->fmp4)
+		mp4_mux_free(&stream->mp4);
+	else
+		ts_mux_free(&stream->ts);
+
+	stream->active = false;
+
+	info("HLS output stopped, %"PRIu32" segments written (%"PRIu64
+	     " bytes)", stream->segment_index, stream->total_bytes);
+}
+
+/* segments follow the keyframe interval of the encoder unless a duration is
+ * set explicitly */
+static int64_t get_segment_usec(struct hls_output *stream,
+		obs_data_t *settings)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	int64_t       sec = obs_data_get_int(settings, "segment_duration");
+
+	if (!sec && vencoder) {
+		obs_data_t *vsettings = obs_encoder_get_settings(vencoder);
+		sec = obs_data_get_int(vsettings, "keyint_sec");
+		obs_data_release(vsettings);
+	}
+
+	return (sec > 0 ? sec : DEFAULT_SEGMENT_SEC) * 1000000;
+}
+
+static bool write_init_segment(struct hls_output *stream)
+{
+	uint8_t *header;
+	size_t  size;
+	bool    success;
+
+	mp4_init_segment(&stream->mp4, stream->output, &header, &size);
+
+	dstr_printf(&stream->file_path, "%s/%s_init.mp4", stream->path.array,
+			stream->name.array);
+	success = write_file(stream, header, size);
+
+	bfree(header);
+	return success;
+}
+
+static bool hls_output_start(void *data)
+{
+	struct hls_output *stream = data;
+	obs_data_t *settings;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	settings = obs_output_get_settings(stream->output);
+	dstr_copy(&stream->path, obs_data_get_string(settings, "path"));
+	dstr_copy(&stream->name, obs_data_get_string(settings, "name"));
+	stream->fmp4 = strcmp(obs_data_get_string(settings, "format"),
+			"fmp4") == 0;
+	stream->segment_usec = get_segment_usec(stream, settings);
+	stream->playlist_size =
+		(size_t)obs_data_get_int(settings, "playlist_size");
+	stream->delete_segments =
+		obs_data_get_bool(settings, "delete_segments");
+	obs_data_release(settings);
+
+	if (dstr_is_empty(&stream->path) || dstr_is_empty(&stream->name)) {
+		warn("No directory or playlist name set");
+		return false;
+	}
+
+	if (os_mkdir(stream->path.array) == MKDIR_ERROR) {
+		warn("Unable to create directory '%s'", stream->path.array);
+		return false;
+	}
+
+	stream->started         = false;
+	stream->segment_index   = 0;
+	stream->total_bytes     = 0;
+	stream->target_duration =
+		(int)((stream->segment_usec + 500000) / 1000000);
+	da_resize(stream->entries, 0);
+	da_resize(stream->segment.bytes, 0);
+
+	if (stream->fmp4) {
+		mp4_mux_init(&stream->mp4, stream->output);
+
+		if (!write_init_segment(stream)) {
+			mp4_mux_free(&stream->mp4);
+			return false;
+		}
+	} else {
+		ts_mux_init(&stream->ts, stream->output);
+	}
+
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+				stream) != 0) {
+		warn("Failed to create write thread");
+		if (stream->fmp4)
+			mp4_mux_free(&stream->mp4);
+		else
+			ts_mux_free(&stream->ts);
+		return false;
+	}
+
+	stream->active = true;
+	obs_output_begin_data_capture(stream->output, 0);
+
+	info("Writing HLS playlist '%s/%s.m3u8' with %s segments of %"PRId64
+	     " seconds...", stream->path.array, stream->name.array,
+	     segment_ext(stream), stream->segment_usec / 1000000);
+	return true;
+}
+
+static uint64_t hls_output_total_bytes(void *data)
+{
+	struct hls_output *stream = data;
+	return stream->total_bytes;
+}
+
+static void hls_output_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_string(defaults, "name", "stream");
+	obs_data_set_default_string(defaults, "format", "ts");
+	obs_data_set_default_int(defaults, "segment_duration", 0);
+	obs_data_set_default_int(defaults, "playlist_size",
+			DEFAULT_PLAYLIST_SIZE);
+	obs_data_set_default_bool(defaults, "delete_segments", true);
+}
+
+static obs_properties_t *hls_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t   *p;
+
+	obs_properties_add_path(props, "path",
+			obs_module_text("HLSOutput.Directory"),
+			OBS_PATH_DIRECTORY, NULL, NULL);
+	obs_properties_add_text(props, "name",
+			obs_module_text("HLSOutput.Name"),
+			OBS_TEXT_DEFAULT);
+
+	p = obs_properties_add_list(props, "format",
+			obs_module_text("HLSOutput.Format"),
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, "MPEG-TS", "ts");
+	obs_property_list_add_string(p, "Fragmented MP4", "fmp4");
+
+	obs_properties_add_int(props, "segment_duration",
+			obs_module_text("HLSOutput.SegmentDuration"),
+			0, 60, 1);
+	obs_properties_add_int(props, "playlist_size",
+			obs_module_text("HLSOutput.PlaylistSize"),
+			1, 100, 1);
+	obs_properties_add_bool(props, "delete_segments",
+			obs_module_text("HLSOutput.DeleteSegments"));
+	return props;
+}
+
+struct obs_output_info hls_output_info = {
+	.id              = "hls_output",
+	.flags           = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+	                   OBS_OUTPUT_MULTI_TRACK,
+	.get_name        = hls_output_getname,
+	.create          = hls_output_create,
+	.destroy         = hls_output_destroy,
+	.start           = hls_output_start,
+	.stop            = hls_output_stop,
+	.encoded_packet  = hls_output_data,
+	.get_defaults    = hls_output_defaults,
+	.get_properties  = hls_output_properties,
+	.get_total_bytes = hls_output_total_bytes
+};
@@ -26,6 +26,22 @@
 #include "rtmp_sys.h"
 #include "log.h"
 
+#ifdef _WIN32
+typedef WSABUF RTMPIOVec;
+#define IOV_SET(v, p, l)	((v).buf = (char *)(p), (v).len = (ULONG)(l))
+#define IOV_BASE(v)	((char *)(v).buf)
+#define IOV_LEN(v)	((int)(v).len)
+#else
+#include <sys/uio.h>
+typedef struct iovec RTMPIOVec;
+#define IOV_SET(v, p, l)	((v).iov_base = (void *)(p), (v).iov_len = (size_t)(l))
+#define IOV_BASE(v)	((char *)(v).iov_base)
+#define IOV_LEN(v)	((int)(v).iov_len)
+#endif
+
+/* max buffers handed to a single writev/WSASend call */
+#define RTMP_MAX_IOV	64
+
 #ifdef CRYPTO
 #ifdef USE_POLARSSL
 #include <polarssl/havege.h>
@@ -1835,6 +1851,63 @@ WriteN(RTMP *r, const char *buffer, int n)
     return n == 0;
 }
 
+static int RTMPSockBuf_SendV(RTMPSockBuf *sb, RTMPIOVec *iov, int cnt);
+
+/* sends a list of buffers with as few syscalls as possible.  falls back to
+ * WriteN for each buffer when the data has to go through HTTP, TLS, RC4 or a
+ * custom send function */
+static int
+WriteV(RTMP *r, RTMPIOVec *iov, int cnt)
+{
+    int i;
+
+    if ((r->Link.protocol & RTMP_FEATURE_HTTP)
+            || (r->m_bCustomSend && r->m_customSendFunc)
+#ifdef CRYPTO
+            || r->Link.rc4keyOut || r->m_sb.sb_ssl
+#endif
+       )
+    {
+        for (i = 0; i < cnt; i++)
+            if (!WriteN(r, IOV_BASE(iov[i]), IOV_LEN(iov[i])))
+                return FALSE;
+        return TRUE;
+    }
+
+    while (cnt > 0)
+    {
+        int nBytes = RTMPSockBuf_SendV(&r->m_sb, iov, cnt);
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d buffers)", __FUNCTION__,
+                     sockerr, cnt);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        /* skip what was sent, a partial send can end mid-buffer */
+        while (cnt > 0 && nBytes >= IOV_LEN(*iov))
+        {
+            nBytes -= IOV_LEN(*iov);
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0 && nBytes)
+            IOV_SET(*iov, IOV_BASE(*iov) + nBytes, IOV_LEN(*iov) - nBytes);
+    }
+
+    return TRUE;
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -4403,46 +4476,88 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
             toff = tbuf;
         }
     }
-    while (nSize + hSize)
+    if (!tbuf)
     {
-        int wrote;
+        /* the chunks go out in a single gathered write.  the first chunk
+         * header is already in front of the body, the continuation headers
+         * are all identical and share one small buffer */
+        RTMPIOVec iov[RTMP_MAX_IOV];
+        char cbuf[3];
+        int cbufSize = 1 + cSize;
+        int niov = 0;
 
-        if (nSize < nChunkSize)
-            nChunkSize = nSize;
-
-        RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)header, hSize);
-        RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)buffer, nChunkSize);
-        if (tbuf)
+        cbuf[0] = (0xc0 | c);
+        if (cSize)
         {
-            memcpy(toff, header, nChunkSize + hSize);
-            toff += nChunkSize + hSize;
+            int tmp = packet->m_nChannel - 64;
+            cbuf[1] = tmp & 0xff;
+            if (cSize == 2)
+                cbuf[2] = tmp >> 8;
         }
-        else
-        {
-            wrote = WriteN(r, header, nChunkSize + hSize);
-            if (!wrote)
-                return FALSE;
-        }
-        nSize -= nChunkSize;
-        buffer += nChunkSize;
-        hSize = 0;
 
-        if (nSize > 0)
+        while (nSize + hSize)
         {
-            header = buffer - 1;
-            hSize = 1;
-            if (cSize)
+            if (nSize < nChunkSize)
+                nChunkSize = nSize;
+
+            if (hSize)
             {
-                header -= cSize;
-                hSize += cSize;
+                RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)header, hSize);
+                IOV_SET(iov[niov], header, hSize + nChunkSize);
+                niov++;
             }
-            *header = (0xc0 | c);
-            if (cSize)
+            else
             {
-                int tmp = packet->m_nChannel - 64;
-                header[1] = tmp & 0xff;
-                if (cSize == 2)
-                    header[2] = tmp >> 8;
+                IOV_SET(iov[niov], cbuf, cbufSize);
+                IOV_SET(iov[niov + 1], buffer, nChunkSize);
+                niov += 2;
+            }
+            RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)buffer, nChunkSize);
+
+            nSize -= nChunkSize;
+            buffer += nChunkSize;
+            hSize = 0;
+
+            if (!nSize || niov > RTMP_MAX_IOV - 2)
+            {
+                if (!WriteV(r, iov, niov))
+                    return FALSE;
+                niov = 0;
+            }
+        }
+    }
+    else
+    {
+        while (nSize + hSize)
+        {
+            if (nSize < nChunkSize)
+                nChunkSize = nSize;
+
+            RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)header, hSize);
+            RTMP_LogHexString(RTMP_LOGDEBUG2, (uint8_t *)buffer, nChunkSize);
+            memcpy(toff, header, nChunkSize + hSize);
+            toff += nChunkSize + hSize;
+            nSize -= nChunkSize;
+            buffer += nChunkSize;
+            hSize = 0;
+
+            if (nSize > 0)
+            {
+                header = buffer - 1;
+                hSize = 1;
+                if (cSize)
+                {
+                    header -= cSize;
+                    hSize += cSize;
+                }
+                *header = (0xc0 | c);
+                if (cSize)
+                {
+                    int tmp = packet->m_nChannel - 64;
+                    header[1] = tmp & 0xff;
+                    if (cSize == 2)
+                        header[2] = tmp >> 8;
+                }
             }
         }
     }
@@ -4530,6 +4645,7 @@ RTMP_Close(RTMP *r)
 
     r->m_write.m_nBytesRead = 0;
     RTMPPacket_Free(&r->m_write);
+    r->m_nWriteAlloc = 0;
 
     for (i = 0; i < r->m_channelsAllocatedIn; i++)
     {
@@ -4689,6 +4805,29 @@ RTMPSockBuf_Send(RTMPSockBuf *sb, const char *buf, int len)
     return rc;
 }
 
+static int
+RTMPSockBuf_SendV(RTMPSockBuf *sb, RTMPIOVec *iov, int cnt)
+{
+    int rc;
+
+#if defined(RTMP_NETSTACK_DUMP)
+    for (rc = 0; rc < cnt; rc++)
+        fwrite(IOV_BASE(iov[rc]), 1, IOV_LEN(iov[rc]), netstackdump);
+#endif
+
+#ifdef _WIN32
+    {
+        DWORD sent = 0;
+        rc = WSASend(sb->sb_socket, iov, (DWORD)cnt, &sent, 0, NULL, NULL);
+        if (rc == 0)
+            rc = (int)sent;
+    }
+#else
+    rc = (int)writev(sb->sb_socket, iov, cnt);
+#endif
+    return rc;
+}
+
 int
 RTMPSockBuf_Close(RTMPSockBuf *sb)
 {
@@ -5518,10 +5657,17 @@ RTMP_Write(RTMP *r, const char *buf, int size)
                 pkt->m_headerType = RTMP_PACKET_SIZE_MEDIUM;
             }
 
-            if (!RTMPPacket_Alloc(pkt, pkt->m_nBodySize))
+            /* the body buffer is kept between packets and only grows */
+            if (!pkt->m_body || r->m_nWriteAlloc < (int)pkt->m_nBodySize)
             {
-                RTMP_Log(RTMP_LOGDEBUG, "%s, failed to allocate packet", __FUNCTION__);
-                return FALSE;
+                RTMPPacket_Free(pkt);
+                if (!RTMPPacket_Alloc(pkt, pkt->m_nBodySize))
+                {
+                    RTMP_Log(RTMP_LOGDEBUG, "%s, failed to allocate packet", __FUNCTION__);
+                    r->m_nWriteAlloc = 0;
+                    return FALSE;
+                }
+                r->m_nWriteAlloc = pkt->m_nBodySize;
             }
             enc = pkt->m_body;
             pend = enc + pkt->m_nBodySize;
@@ -5545,7 +5691,6 @@ RTMP_Write(RTMP *r, const char *buf, int size)
         if (pkt->m_nBytesRead == pkt->m_nBodySize)
         {
             ret = RTMP_SendPacket(r, pkt, FALSE);
-            RTMPPacket_Free(pkt);
             pkt->m_nBytesRead = 0;
             if (!ret)
                 return -1;
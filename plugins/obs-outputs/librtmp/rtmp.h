@@ -312,6 +312,7 @@ extern "C"
 
         RTMP_READ m_read;
         RTMPPacket m_write;
+        int m_nWriteAlloc;		/* allocated body size of m_write */
         RTMPSockBuf m_sb;
         RTMP_LNK Link;
     } RTMP;
@@ -0,0 +1,696 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/array-serializer.h>
+#include "mp4-mux.h"
+
+/* TODO: like the FLV muxer, video is hard-coded to h264 */
+
+/* a keyframe only starts a new fragment once the current one is at least
+ * this long, so short keyframe intervals don't produce tiny fragments */
+#define MIN_FRAGMENT_DURATION_MS 1000
+
+#define AAC_FRAME_SIZE 1024
+
+/* opus is always timestamped at 48khz, whatever the input rate was */
+#define OPUS_SAMPLE_RATE 48000
+
+#define SAMPLE_FLAGS_SYNC     0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+#define TFHD_DEFAULT_BASE_IS_MOOF 0x020000
+
+#define TRUN_DATA_OFFSET          0x000001
+#define TRUN_SAMPLE_DURATION      0x000100
+#define TRUN_SAMPLE_SIZE          0x000200
+#define TRUN_SAMPLE_FLAGS         0x000400
+#define TRUN_SAMPLE_CTS_OFFSET    0x000800
+
+/* ------------------------------------------------------------------------- */
+
+static inline void patch_wb32(struct array_output_data *data, size_t pos,
+		uint32_t val)
+{
+	uint8_t *p = data->bytes.array + pos;
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+static inline size_t start_box(struct serializer *s, const char *type)
+{
+	size_t pos = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+	s_write(s, type, 4);
+	return pos;
+}
+
+static inline size_t start_full_box(struct serializer *s, const char *type,
+		uint8_t version, uint32_t flags)
+{
+	size_t pos = start_box(s, type);
+	s_w8(s, version);
+	s_wb24(s, flags);
+	return pos;
+}
+
+static inline void end_box(struct serializer *s,
+		struct array_output_data *data, size_t pos)
+{
+	patch_wb32(data, pos, (uint32_t)(serializer_get_pos(s) - pos));
+}
+
+static inline void write_zeros(struct serializer *s, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		s_w8(s, 0);
+}
+
+static inline void write_matrix(struct serializer *s)
+{
+	s_wb32(s, 0x00010000); s_wb32(s, 0); s_wb32(s, 0);
+	s_wb32(s, 0); s_wb32(s, 0x00010000); s_wb32(s, 0);
+	s_wb32(s, 0); s_wb32(s, 0); s_wb32(s, 0x40000000);
+}
+
+/* converts a packet timestamp to the track's timescale */
+static inline int64_t track_time(const struct mp4_track *track,
+		const struct encoder_packet *packet, int64_t val)
+{
+	return val * (int64_t)track->timescale * packet->timebase_num /
+		packet->timebase_den;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline obs_encoder_t *get_track_encoder(obs_output_t *context,
+		size_t idx)
+{
+	return idx == 0 ?
+		obs_output_get_video_encoder(context) :
+		obs_output_get_audio_encoder(context, idx - 1);
+}
+
+static inline bool is_opus(const obs_encoder_t *aencoder)
+{
+	return strcmp(obs_encoder_get_codec(aencoder), "opus") == 0;
+}
+
+void mp4_mux_init(struct mp4_mux *mux, obs_output_t *context)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
+	const struct video_output_info *voi;
+	struct mp4_track *video = &mux->tracks[0];
+
+	memset(mux, 0, sizeof(struct mp4_mux));
+
+	voi = video_output_get_info(obs_encoder_video(vencoder));
+
+	video->id        = 1;
+	video->type      = OBS_ENCODER_VIDEO;
+	video->timescale = voi ? voi->fps_num : 1000;
+	mux->num_tracks  = 1;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		obs_encoder_t *aencoder = get_track_encoder(context, i + 1);
+		struct mp4_track *audio = &mux->tracks[mux->num_tracks];
+
+		if (!aencoder)
+			break;
+
+		audio->id        = (uint32_t)mux->num_tracks + 1;
+		audio->type      = OBS_ENCODER_AUDIO;
+		audio->timescale = is_opus(aencoder) ? OPUS_SAMPLE_RATE :
+			audio_output_get_sample_rate(
+					obs_encoder_audio(aencoder));
+		mux->num_tracks++;
+	}
+
+	mux->sequence = 1;
+}
+
+static inline void track_free(struct mp4_track *track)
+{
+	da_free(track->samples);
+	da_free(track->data);
+}
+
+void mp4_mux_free(struct mp4_mux *mux)
+{
+	for (size_t i = 0; i < mux->num_tracks; i++)
+		track_free(&mux->tracks[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* init segment                                                              */
+
+static void write_ftyp(struct serializer *s, struct array_output_data *data)
+{
+	size_t box = start_box(s, "ftyp");
+	s_write(s, "isom", 4);
+	s_wb32(s, 0x200);
+	s_write(s, "isom", 4);
+	s_write(s, "iso5", 4);
+	s_write(s, "avc1", 4);
+	s_write(s, "mp41", 4);
+	end_box(s, data, box);
+}
+
+static void write_mvhd(struct serializer *s, struct array_output_data *data,
+		uint32_t next_track_id)
+{
+	size_t box = start_full_box(s, "mvhd", 0, 0);
+	s_wb32(s, 0);          /* creation time */
+	s_wb32(s, 0);          /* modification time */
+	s_wb32(s, 1000);       /* timescale */
+	s_wb32(s, 0);          /* duration, unknown when fragmented */
+	s_wb32(s, 0x00010000); /* rate */
+	s_wb16(s, 0x0100);     /* volume */
+	write_zeros(s, 10);
+	write_matrix(s);
+	write_zeros(s, 24);
+	s_wb32(s, next_track_id);
+	end_box(s, data, box);
+}
+
+static void write_tkhd(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track, uint32_t width, uint32_t height)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+
+	size_t box = start_full_box(s, "tkhd", 0, 0x3);
+	s_wb32(s, 0);          /* creation time */
+	s_wb32(s, 0);          /* modification time */
+	s_wb32(s, track->id);
+	s_wb32(s, 0);
+	s_wb32(s, 0);          /* duration */
+	write_zeros(s, 8);
+	s_wb16(s, 0);          /* layer */
+	s_wb16(s, 0);          /* alternate group */
+	s_wb16(s, audio ? 0x0100 : 0);
+	s_wb16(s, 0);
+	write_matrix(s);
+	s_wb32(s, width << 16);
+	s_wb32(s, height << 16);
+	end_box(s, data, box);
+}
+
+static void write_mdhd(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track)
+{
+	size_t box = start_full_box(s, "mdhd", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, track->timescale);
+	s_wb32(s, 0);
+	s_wb16(s, 0x55c4);     /* 'und' */
+	s_wb16(s, 0);
+	end_box(s, data, box);
+}
+
+static void write_hdlr(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+	const char *name = audio ? "SoundHandler" : "VideoHandler";
+
+	size_t box = start_full_box(s, "hdlr", 0, 0);
+	s_wb32(s, 0);
+	s_write(s, audio ? "soun" : "vide", 4);
+	write_zeros(s, 12);
+	s_write(s, name, strlen(name) + 1);
+	end_box(s, data, box);
+}
+
+static void write_dinf(struct serializer *s, struct array_output_data *data)
+{
+	size_t dinf = start_box(s, "dinf");
+	size_t dref = start_full_box(s, "dref", 0, 0);
+	s_wb32(s, 1);
+	end_box(s, data, start_full_box(s, "url ", 0, 1));
+	end_box(s, data, dref);
+	end_box(s, data, dinf);
+}
+
+static void write_avc1(struct serializer *s, struct array_output_data *data,
+		obs_encoder_t *vencoder)
+{
+	uint8_t *extra_data = NULL;
+	uint8_t *header     = NULL;
+	size_t  extra_size  = 0;
+	size_t  header_size = 0;
+	size_t  box, avcc;
+
+	obs_encoder_get_extra_data(vencoder, &extra_data, &extra_size);
+	if (extra_data && extra_size)
+		header_size = obs_parse_avc_header(&header, extra_data,
+				extra_size);
+
+	box = start_box(s, "avc1");
+	write_zeros(s, 6);
+	s_wb16(s, 1);          /* data reference index */
+	write_zeros(s, 16);
+	s_wb16(s, (uint16_t)obs_encoder_get_width(vencoder));
+	s_wb16(s, (uint16_t)obs_encoder_get_height(vencoder));
+	s_wb32(s, 0x00480000); /* 72 dpi */
+	s_wb32(s, 0x00480000);
+	s_wb32(s, 0);
+	s_wb16(s, 1);          /* frame count */
+	write_zeros(s, 32);    /* compressor name */
+	s_wb16(s, 0x0018);     /* depth */
+	s_wb16(s, 0xFFFF);
+
+	avcc = start_box(s, "avcC");
+	s_write(s, header, header_size);
+	end_box(s, data, avcc);
+
+	end_box(s, data, box);
+	bfree(header);
+}
+
+static inline void write_descriptor(struct serializer *s, uint8_t tag,
+		uint32_t size)
+{
+	s_w8(s, tag);
+	s_w8(s, 0x80 | ((size >> 21) & 0x7F));
+	s_w8(s, 0x80 | ((size >> 14) & 0x7F));
+	s_w8(s, 0x80 | ((size >> 7)  & 0x7F));
+	s_w8(s, size & 0x7F);
+}
+
+static void write_audio_sample_entry(struct serializer *s, size_t channels,
+		uint32_t sample_rate)
+{
+	write_zeros(s, 6);
+	s_wb16(s, 1);          /* data reference index */
+	write_zeros(s, 8);
+	s_wb16(s, (uint16_t)channels);
+	s_wb16(s, 16);         /* sample size */
+	s_wb16(s, 0);
+	s_wb16(s, 0);
+	s_wb32(s, sample_rate << 16);
+}
+
+static inline uint16_t get_le16(const uint8_t *data)
+{
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *data)
+{
+	return get_le16(data) | ((uint32_t)get_le16(data + 2) << 16);
+}
+
+/* the dOps box holds the fields of the OpusHead header the encoder gives as
+ * extra data, but big endian */
+static void write_opus(struct serializer *s, struct array_output_data *data,
+		obs_encoder_t *aencoder)
+{
+	audio_t  *audio      = obs_encoder_audio(aencoder);
+	uint8_t  *extra_data = NULL;
+	size_t   extra_size  = 0;
+	size_t   channels    = audio_output_get_channels(audio);
+	uint16_t pre_skip    = 0;
+	uint32_t input_rate  = audio_output_get_sample_rate(audio);
+	size_t   box, dops;
+
+	if (obs_encoder_get_extra_data(aencoder, &extra_data, &extra_size) &&
+	    extra_size >= 19) {
+		channels   = extra_data[9];
+		pre_skip   = get_le16(extra_data + 10);
+		input_rate = get_le32(extra_data + 12);
+	}
+
+	box = start_box(s, "Opus");
+	write_audio_sample_entry(s, channels, OPUS_SAMPLE_RATE);
+
+	dops = start_box(s, "dOps");
+	s_w8(s, 0);            /* version */
+	s_w8(s, (uint8_t)channels);
+	s_wb16(s, pre_skip);
+	s_wb32(s, input_rate);
+	s_wb16(s, 0);          /* output gain */
+	s_w8(s, 0);            /* channel mapping family */
+	end_box(s, data, dops);
+
+	end_box(s, data, box);
+}
+
+static void write_mp4a(struct serializer *s, struct array_output_data *data,
+		obs_encoder_t *aencoder)
+{
+	audio_t  *audio       = obs_encoder_audio(aencoder);
+	uint8_t  *extra_data  = NULL;
+	size_t   extra_size   = 0;
+	uint32_t sample_rate  = audio_output_get_sample_rate(audio);
+	uint32_t bitrate;
+	uint32_t dec_config_size;
+	size_t   box, esds;
+
+	obs_data_t *settings = obs_encoder_get_settings(aencoder);
+	bitrate = (uint32_t)obs_data_get_int(settings, "bitrate") * 1000;
+	obs_data_release(settings);
+
+	obs_encoder_get_extra_data(aencoder, &extra_data, &extra_size);
+
+	box = start_box(s, "mp4a");
+	write_audio_sample_entry(s, audio_output_get_channels(audio),
+			sample_rate);
+
+	dec_config_size = 13 + 5 + (uint32_t)extra_size;
+
+	esds = start_full_box(s, "esds", 0, 0);
+	write_descriptor(s, 0x03, 3 + 5 + dec_config_size + 5 + 1);
+	s_wb16(s, 0);          /* ES ID */
+	s_w8(s, 0);
+	write_descriptor(s, 0x04, dec_config_size);
+	s_w8(s, 0x40);         /* MPEG-4 audio */
+	s_w8(s, 0x15);         /* audio stream */
+	s_wb24(s, 0);
+	s_wb32(s, bitrate);
+	s_wb32(s, bitrate);
+	write_descriptor(s, 0x05, (uint32_t)extra_size);
+	s_write(s, extra_data, extra_size);
+	write_descriptor(s, 0x06, 1);
+	s_w8(s, 0x02);
+	end_box(s, data, esds);
+
+	end_box(s, data, box);
+}
+
+/* sample tables are empty, all samples are in the fragments */
+static void write_stbl(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track, obs_encoder_t *encoder)
+{
+	size_t stbl = start_box(s, "stbl");
+
+	size_t stsd = start_full_box(s, "stsd", 0, 0);
+	s_wb32(s, 1);
+	if (track->type == OBS_ENCODER_VIDEO)
+		write_avc1(s, data, encoder);
+	else if (is_opus(encoder))
+		write_opus(s, data, encoder);
+	else
+		write_mp4a(s, data, encoder);
+	end_box(s, data, stsd);
+
+	size_t box = start_full_box(s, "stts", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, data, box);
+
+	box = start_full_box(s, "stsc", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, data, box);
+
+	box = start_full_box(s, "stsz", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	end_box(s, data, box);
+
+	box = start_full_box(s, "stco", 0, 0);
+	s_wb32(s, 0);
+	end_box(s, data, box);
+
+	end_box(s, data, stbl);
+}
+
+static void write_trak(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track, obs_encoder_t *encoder)
+{
+	bool     video  = track->type == OBS_ENCODER_VIDEO;
+	uint32_t width  = video ? obs_encoder_get_width(encoder)  : 0;
+	uint32_t height = video ? obs_encoder_get_height(encoder) : 0;
+	size_t   trak, mdia, minf, box;
+
+	trak = start_box(s, "trak");
+	write_tkhd(s, data, track, width, height);
+
+	mdia = start_box(s, "mdia");
+	write_mdhd(s, data, track);
+	write_hdlr(s, data, track);
+
+	minf = start_box(s, "minf");
+	if (video) {
+		box = start_full_box(s, "vmhd", 0, 1);
+		write_zeros(s, 8);
+	} else {
+		box = start_full_box(s, "smhd", 0, 0);
+		write_zeros(s, 4);
+	}
+	end_box(s, data, box);
+
+	write_dinf(s, data);
+	write_stbl(s, data, track, encoder);
+	end_box(s, data, minf);
+
+	end_box(s, data, mdia);
+	end_box(s, data, trak);
+}
+
+static void write_trex(struct serializer *s, struct array_output_data *data,
+		const struct mp4_track *track)
+{
+	size_t box = start_full_box(s, "trex", 0, 0);
+	s_wb32(s, track->id);
+	s_wb32(s, 1);          /* sample description index */
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	end_box(s, data, box);
+}
+
+void mp4_init_segment(struct mp4_mux *mux, obs_output_t *context,
+		uint8_t **output, size_t *size)
+{
+	struct array_output_data data;
+	struct serializer s;
+	size_t moov, mvex;
+
+	array_output_serializer_init(&s, &data);
+
+	write_ftyp(&s, &data);
+
+	moov = start_box(&s, "moov");
+	write_mvhd(&s, &data, (uint32_t)mux->num_tracks + 1);
+	for (size_t i = 0; i < mux->num_tracks; i++)
+		write_trak(&s, &data, &mux->tracks[i],
+				get_track_encoder(context, i));
+
+	mvex = start_box(&s, "mvex");
+	for (size_t i = 0; i < mux->num_tracks; i++)
+		write_trex(&s, &data, &mux->tracks[i]);
+	end_box(&s, &data, mvex);
+
+	end_box(&s, &data, moov);
+
+	*output = data.bytes.array;
+	*size   = data.bytes.num;
+}
+
+/* ------------------------------------------------------------------------- */
+/* fragments                                                                 */
+
+/* the last sample's duration isn't known until the next packet, the previous
+ * duration is used for it */
+static inline int64_t sample_duration(struct mp4_track *track, size_t idx,
+		int64_t next_dts)
+{
+	int64_t duration;
+
+	if (idx + 1 < track->samples.num)
+		duration = track->samples.array[idx + 1].dts -
+			track->samples.array[idx].dts;
+	else if (next_dts >= 0)
+		duration = next_dts - track->samples.array[idx].dts;
+	else
+		duration = track->last_duration;
+
+	if (duration <= 0)
+		duration = track->last_duration;
+	else
+		track->last_duration = duration;
+
+	return duration;
+}
+
+/* returns the position of the trun data offset, to be patched once the size
+ * of the moof is known */
+static size_t write_traf(struct serializer *s, struct array_output_data *data,
+		struct mp4_track *track, int64_t next_dts)
+{
+	bool     video = track->type == OBS_ENCODER_VIDEO;
+	uint32_t flags = TRUN_DATA_OFFSET | TRUN_SAMPLE_DURATION |
+		TRUN_SAMPLE_SIZE;
+	size_t   traf, box, offset_pos;
+	int64_t  base_time = track->samples.array[0].dts;
+
+	if (video)
+		flags |= TRUN_SAMPLE_FLAGS | TRUN_SAMPLE_CTS_OFFSET;
+
+	traf = start_box(s, "traf");
+
+	box = start_full_box(s, "tfhd", 0, TFHD_DEFAULT_BASE_IS_MOOF);
+	s_wb32(s, track->id);
+	end_box(s, data, box);
+
+	box = start_full_box(s, "tfdt", 1, 0);
+	s_wb64(s, (uint64_t)(base_time > 0 ? base_time : 0));
+	end_box(s, data, box);
+
+	box = start_full_box(s, "trun", 1, flags);
+	s_wb32(s, (uint32_t)track->samples.num);
+	offset_pos = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+
+	for (size_t i = 0; i < track->samples.num; i++) {
+		struct mp4_sample *sample = track->samples.array + i;
+
+		s_wb32(s, (uint32_t)sample_duration(track, i, next_dts));
+		s_wb32(s, sample->size);
+
+		if (video) {
+			s_wb32(s, sample->keyframe ?
+					SAMPLE_FLAGS_SYNC :
+					SAMPLE_FLAGS_NON_SYNC);
+			s_wb32(s, (uint32_t)sample->cts_offset);
+		}
+	}
+
+	end_box(s, data, box);
+	end_box(s, data, traf);
+	return offset_pos;
+}
+
+static void write_fragment(struct mp4_mux *mux, int64_t next_video_dts,
+		uint8_t **output, size_t *size)
+{
+	struct mp4_track *tracks = mux->tracks;
+	size_t offset_pos[MP4_MAX_TRACKS] = {0};
+	struct array_output_data data;
+	struct serializer s;
+	size_t moof, box, mdat_size = 8;
+
+	array_output_serializer_init(&s, &data);
+
+	moof = start_box(&s, "moof");
+
+	box = start_full_box(&s, "mfhd", 0, 0);
+	s_wb32(&s, mux->sequence++);
+	end_box(&s, &data, box);
+
+	for (size_t i = 0; i < mux->num_tracks; i++) {
+		if (tracks[i].samples.num)
+			offset_pos[i] = write_traf(&s, &data, &tracks[i],
+					i == 0 ? next_video_dts : -1);
+	}
+
+	end_box(&s, &data, moof);
+
+	/* data offsets are relative to the start of the moof */
+	for (size_t i = 0; i < mux->num_tracks; i++) {
+		if (!tracks[i].samples.num)
+			continue;
+
+		patch_wb32(&data, offset_pos[i],
+				(uint32_t)(serializer_get_pos(&s) - moof +
+					mdat_size));
+		mdat_size += tracks[i].data.num;
+	}
+
+	s_wb32(&s, (uint32_t)mdat_size);
+	s_write(&s, "mdat", 4);
+
+	for (size_t i = 0; i < mux->num_tracks; i++) {
+		s_write(&s, tracks[i].data.array, tracks[i].data.num);
+		da_resize(tracks[i].samples, 0);
+		da_resize(tracks[i].data, 0);
+	}
+
+	*output = data.bytes.array;
+	*size   = data.bytes.num;
+}
+
+static inline bool fragment_ready(struct mp4_mux *mux, int64_t dts)
+{
+	struct mp4_track *video = &mux->tracks[0];
+	int64_t duration;
+
+	if (!video->samples.num)
+		return false;
+
+	duration = dts - video->samples.array[0].dts;
+	return duration * 1000 >= (int64_t)video->timescale *
+		MIN_FRAGMENT_DURATION_MS;
+}
+
+bool mp4_mux_packet(struct mp4_mux *mux, struct encoder_packet *packet,
+		uint8_t **output, size_t *size)
+{
+	bool video = packet->type == OBS_ENCODER_VIDEO;
+	size_t idx = video ? 0 : 1 + packet->track_idx;
+	struct mp4_track *track = &mux->tracks[idx];
+	struct mp4_sample sample;
+	bool fragment = false;
+
+	if (!packet->data || !packet->size || idx >= mux->num_tracks)
+		return false;
+
+	sample.dts        = track_time(track, packet, packet->dts);
+	sample.cts_offset = (int32_t)track_time(track, packet,
+			packet->pts - packet->dts);
+	sample.size       = (uint32_t)packet->size;
+	sample.keyframe   = packet->keyframe;
+
+	if (!track->last_duration)
+		track->last_duration = video ?
+			track_time(track, packet, 1) : AAC_FRAME_SIZE;
+
+	if (video && packet->keyframe && fragment_ready(mux, sample.dts)) {
+		write_fragment(mux, sample.dts, output, size);
+		fragment = true;
+	}
+
+	da_push_back(track->samples, &sample);
+	da_push_back_array(track->data, packet->data, packet->size);
+
+	if (video) {
+		int64_t end_ms = sample.dts * 1000 / track->timescale;
+		if (end_ms > mux->duration)
+			mux->duration = end_ms;
+	}
+
+	return fragment;
+}
+
+bool mp4_mux_flush(struct mp4_mux *mux, uint8_t **output, size_t *size)
+{
+	bool pending = false;
+
+	for (size_t i = 0; i < mux->num_tracks; i++) {
+		if (mux->tracks[i].samples.num)
+			pending = true;
+	}
+
+	if (!pending)
+		return false;
+
+	write_fragment(mux, -1, output, size);
+	return true;
+}
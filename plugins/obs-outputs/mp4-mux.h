@@ -0,0 +1,70 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+
+/*
+ * Fragmented MP4 muxing.  The init segment (ftyp + moov) describes the tracks
+ * but contains no samples, every fragment after it (moof + mdat) is complete
+ * on its own, so a file cut off at any point is playable up to the last
+ * fragment written.  Fragments start at video keyframes.
+ */
+
+struct mp4_sample {
+	int64_t  dts;
+	int32_t  cts_offset;
+	uint32_t size;
+	bool     keyframe;
+};
+
+struct mp4_track {
+	uint32_t                  id;
+	enum obs_encoder_type     type;
+	uint32_t                  timescale;
+
+	DARRAY(struct mp4_sample) samples;
+	DARRAY(uint8_t)           data;
+	int64_t                   last_duration;
+};
+
+/* track 0 is video, followed by one track per audio encoder */
+#define MP4_MAX_TRACKS (1 + MAX_AUDIO_MIXES)
+
+struct mp4_mux {
+	struct mp4_track          tracks[MP4_MAX_TRACKS];
+	size_t                    num_tracks;
+	uint32_t                  sequence;
+	int64_t                   duration;
+};
+
+extern void mp4_mux_init(struct mp4_mux *mux, obs_output_t *context);
+extern void mp4_mux_free(struct mp4_mux *mux);
+
+extern void mp4_init_segment(struct mp4_mux *mux, obs_output_t *context,
+		uint8_t **output, size_t *size);
+
+/* adds an encoded packet (AVCC for video), returns true and the finished
+ * fragment if the packet started a new one */
+extern bool mp4_mux_packet(struct mp4_mux *mux,
+		struct encoder_packet *packet, uint8_t **output, size_t *size);
+
+/* returns the last pending fragment, if any */
+extern bool mp4_mux_flush(struct mp4_mux *mux, uint8_t **output,
+		size_t *size);
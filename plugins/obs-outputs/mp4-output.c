@@ -0,0 +1,334 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <inttypes.h>
+#include "mp4-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[mp4 output: '%s'] " format, \
+			obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* each fragment is queued as a whole and written to disk by a separate
+ * thread.  the file is only ever appended to, nothing is rewritten at the
+ * end, so an interrupted recording is still playable and no remux is
+ * needed afterwards. */
+#define QUEUE_RESERVE_SIZE  (8 * 1024 * 1024)
+#define QUEUE_WARN_SIZE     (64 * 1024 * 1024)
+
+struct mp4_output {
+	obs_output_t     *output;
+	struct dstr      path;
+	FILE             *file;
+	bool             active;
+
+	struct mp4_mux   mux;
+
+	pthread_t        write_thread;
+	os_sem_t         *write_sem;
+	os_event_t       *stop_event;
+
+	pthread_mutex_t  queue_mutex;
+	struct circlebuf queue;
+	size_t           max_queue_size;
+	bool             queue_warned;
+
+	DARRAY(uint8_t)  write_data;
+	uint64_t         total_bytes;
+	uint32_t         fragments;
+	bool             write_failed;
+};
+
+static const char *mp4_output_getname(void)
+{
+	return obs_module_text("MP4Output");
+}
+
+static void mp4_output_stop(void *data);
+
+static void mp4_output_destroy(void *data)
+{
+	struct mp4_output *stream = data;
+
+	if (stream->active)
+		mp4_output_stop(data);
+
+	if (stream) {
+		dstr_free(&stream->path);
+		os_event_destroy(stream->stop_event);
+		os_sem_destroy(stream->write_sem);
+		pthread_mutex_destroy(&stream->queue_mutex);
+		circlebuf_free(&stream->queue);
+		da_free(stream->write_data);
+		mp4_mux_free(&stream->mux);
+		bfree(stream);
+	}
+}
+
+static void *mp4_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct mp4_output *stream = bzalloc(sizeof(struct mp4_output));
+	stream->output = output;
+	pthread_mutex_init_value(&stream->queue_mutex);
+
+	if (pthread_mutex_init(&stream->queue_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	mp4_output_destroy(stream);
+	return NULL;
+}
+
+static bool take_queued_data(struct mp4_output *stream)
+{
+	bool take;
+
+	pthread_mutex_lock(&stream->queue_mutex);
+
+	take = stream->queue.size != 0;
+	if (take) {
+		da_resize(stream->write_data, stream->queue.size);
+		circlebuf_pop_front(&stream->queue, stream->write_data.array,
+				stream->queue.size);
+	}
+
+	pthread_mutex_unlock(&stream->queue_mutex);
+	return take;
+}
+
+static void write_queued_data(struct mp4_output *stream)
+{
+	size_t size;
+
+	if (!take_queued_data(stream))
+		return;
+	if (stream->write_failed)
+		return;
+
+	size = stream->write_data.num;
+	if (fwrite(stream->write_data.array, 1, size, stream->file) != size) {
+		warn("Failed to write to MP4 file '%s'", stream->path.array);
+		stream->write_failed = true;
+		return;
+	}
+
+	/* fragments are complete, flush them so they survive a crash */
+	fflush(stream->file);
+	stream->total_bytes += size;
+}
+
+static void *write_thread(void *data)
+{
+	struct mp4_output *stream = data;
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		if (os_event_try(stream->stop_event) != EAGAIN)
+			break;
+		write_queued_data(stream);
+	}
+
+	write_queued_data(stream);
+	return NULL;
+}
+
+/* called from the encoder threads, only copies the data to the queue */
+static void queue_data(struct mp4_output *stream, uint8_t *data, size_t size)
+{
+	bool warn_size = false;
+	size_t queued;
+
+	pthread_mutex_lock(&stream->queue_mutex);
+
+	circlebuf_push_back(&stream->queue, data, size);
+
+	queued = stream->queue.size;
+	if (queued > stream->max_queue_size)
+		stream->max_queue_size = queued;
+	if (queued > QUEUE_WARN_SIZE && !stream->queue_warned) {
+		stream->queue_warned = true;
+		warn_size = true;
+	}
+
+	pthread_mutex_unlock(&stream->queue_mutex);
+
+	bfree(data);
+
+	if (warn_size)
+		warn("Write queue has grown to %"PRIu64" KB, the disk may be "
+		     "too slow", (uint64_t)queued / 1024);
+
+	os_sem_post(stream->write_sem);
+}
+
+static void mp4_output_stop(void *data)
+{
+	struct mp4_output *stream = data;
+	uint8_t *fragment;
+	size_t  size;
+	void    *ret;
+
+	if (stream->active) {
+		obs_output_end_data_capture(stream->output);
+
+		if (mp4_mux_flush(&stream->mux, &fragment, &size)) {
+			queue_data(stream, fragment, size);
+			stream->fragments++;
+		}
+
+		os_event_signal(stream->stop_event);
+		os_sem_post(stream->write_sem);
+		pthread_join(stream->write_thread, &ret);
+		os_event_reset(stream->stop_event);
+
+		fclose(stream->file);
+		stream->file   = NULL;
+		stream->active = false;
+
+		info("MP4 file output complete, %"PRIu64" bytes written in "
+		     "%"PRIu32" fragments (%"PRId64" ms), peak write queue "
+		     "%"PRIu64" KB", stream->total_bytes, stream->fragments,
+		     stream->mux.duration,
+		     (uint64_t)stream->max_queue_size / 1024);
+
+		mp4_mux_free(&stream->mux);
+	}
+}
+
+static bool mp4_output_start(void *data)
+{
+	struct mp4_output *stream = data;
+	obs_data_t *settings;
+	const char *path;
+	uint8_t    *header;
+	size_t     size;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	/* get path */
+	settings = obs_output_get_settings(stream->output);
+	path = obs_data_get_string(settings, "path");
+	dstr_copy(&stream->path, path);
+	obs_data_release(settings);
+
+	stream->file = os_fopen(stream->path.array, "wb");
+	if (!stream->file) {
+		warn("Unable to open MP4 file '%s'", stream->path.array);
+		return false;
+	}
+
+	stream->total_bytes    = 0;
+	stream->fragments      = 0;
+	stream->max_queue_size = 0;
+	stream->queue_warned   = false;
+	stream->write_failed   = false;
+	circlebuf_free(&stream->queue);
+	circlebuf_reserve(&stream->queue, QUEUE_RESERVE_SIZE);
+
+	if (pthread_create(&stream->write_thread, NULL, write_thread,
+				stream) != 0) {
+		warn("Failed to create write thread");
+		fclose(stream->file);
+		stream->file = NULL;
+		return false;
+	}
+
+	/* write init segment and start capture */
+	mp4_mux_init(&stream->mux, stream->output);
+	mp4_init_segment(&stream->mux, stream->output, &header, &size);
+	queue_data(stream, header, size);
+
+	stream->active = true;
+	obs_output_begin_data_capture(stream->output, 0);
+
+	info("Writing MP4 file '%s'...", stream->path.array);
+	return true;
+}
+
+static void mp4_output_data(void *data, struct encoder_packet *packet)
+{
+	struct mp4_output     *stream = data;
+	struct encoder_packet parsed_packet;
+	uint8_t               *fragment;
+	size_t                size;
+	bool                  ready;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		obs_parse_avc_packet(&parsed_packet, packet);
+		ready = mp4_mux_packet(&stream->mux, &parsed_packet,
+				&fragment, &size);
+		obs_encoder_packet_release(&parsed_packet);
+	} else {
+		ready = mp4_mux_packet(&stream->mux, packet, &fragment, &size);
+	}
+
+	if (ready) {
+		queue_data(stream, fragment, size);
+		stream->fragments++;
+	}
+}
+
+static uint64_t mp4_output_total_bytes(void *data)
+{
+	struct mp4_output *stream = data;
+	return stream->total_bytes;
+}
+
+static obs_properties_t *mp4_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, "path",
+			obs_module_text("MP4Output.FilePath"),
+			OBS_TEXT_DEFAULT);
+	return props;
+}
+
+struct obs_output_info mp4_output_info = {
+	.id              = "mp4_output",
+	.flags           = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+	                   OBS_OUTPUT_MULTI_TRACK,
+	.get_name        = mp4_output_getname,
+	.create          = mp4_output_create,
+	.destroy         = mp4_output_destroy,
+	.start           = mp4_output_start,
+	.stop            = mp4_output_stop,
+	.encoded_packet  = mp4_output_data,
+	.get_total_bytes = mp4_output_total_bytes,
+	.get_properties  = mp4_output_properties
+};
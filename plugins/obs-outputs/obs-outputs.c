@@ -1,4 +1,5 @@
 #include <obs-module.h>
+#include "rtmp-connect.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -9,7 +10,12 @@ OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-outputs", "en-US")
 
 extern struct obs_output_info rtmp_output_info;
+extern struct obs_output_info udp_output_info;
 extern struct obs_output_info flv_output_info;
+extern struct obs_output_info mp4_output_info;
+extern struct obs_output_info hls_output_info;
+extern struct obs_output_info replay_buffer_info;
+extern struct obs_output_info shm_output_info;
 
 bool obs_module_load(void)
 {
@@ -18,13 +24,22 @@ bool obs_module_load(void)
 	WSAStartup(MAKEWORD(2, 2), &wsad);
 #endif
 
+	rtmp_connect_init();
+
 	obs_register_output(&rtmp_output_info);
+	obs_register_output(&udp_output_info);
 	obs_register_output(&flv_output_info);
+	obs_register_output(&mp4_output_info);
+	obs_register_output(&hls_output_info);
+	obs_register_output(&replay_buffer_info);
+	obs_register_output(&shm_output_info);
 	return true;
 }
 
 void obs_module_unload(void)
 {
+	rtmp_connect_free();
+
 #ifdef _WIN32
 	WSACleanup();
 #endif
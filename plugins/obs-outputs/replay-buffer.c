@@ -0,0 +1,411 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include <inttypes.h>
+#include "mp4-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[replay buffer: '%s'] " format, \
+			obs_output_get_name(rb->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* the buffer holds references to the packets the encoders produced, nothing
+ * is copied.  when it grows past either limit, whole groups of pictures are
+ * dropped from the front so the buffer always starts at a keyframe. */
+#define DEFAULT_MAX_TIME_SEC  20
+#define DEFAULT_MAX_SIZE_MB   512
+
+struct replay_buffer {
+	obs_output_t     *output;
+	bool             active;
+
+	pthread_mutex_t  mutex;
+	DARRAY(struct encoder_packet) packets;
+	size_t           total_size;
+	int64_t          max_time_usec;
+	size_t           max_size;
+
+	pthread_t        save_thread;
+	bool             save_thread_active;
+	DARRAY(struct encoder_packet) save_packets;
+	struct dstr      save_path;
+	struct dstr      path;
+};
+
+static const char *replay_buffer_getname(void)
+{
+	return obs_module_text("ReplayBuffer");
+}
+
+static inline bool is_keyframe(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+}
+
+static void free_packets(struct replay_buffer *rb)
+{
+	for (size_t i = 0; i < rb->packets.num; i++)
+		obs_encoder_packet_release(rb->packets.array + i);
+	da_resize(rb->packets, 0);
+
+	rb->total_size = 0;
+}
+
+static void free_save_packets(struct replay_buffer *rb)
+{
+	for (size_t i = 0; i < rb->save_packets.num; i++)
+		obs_encoder_packet_release(rb->save_packets.array + i);
+	da_resize(rb->save_packets, 0);
+}
+
+static void join_save_thread(struct replay_buffer *rb)
+{
+	if (rb->save_thread_active) {
+		pthread_join(rb->save_thread, NULL);
+		rb->save_thread_active = false;
+		free_save_packets(rb);
+	}
+}
+
+static void replay_buffer_stop(void *data);
+
+static void replay_buffer_destroy(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active)
+		replay_buffer_stop(data);
+
+	join_save_thread(rb);
+	free_packets(rb);
+
+	pthread_mutex_destroy(&rb->mutex);
+	da_free(rb->packets);
+	da_free(rb->save_packets);
+	dstr_free(&rb->save_path);
+	dstr_free(&rb->path);
+	bfree(rb);
+}
+
+static void replay_buffer_update(void *data, obs_data_t *settings)
+{
+	struct replay_buffer *rb = data;
+	int64_t max_time = obs_data_get_int(settings, "max_time_sec");
+	int64_t max_size = obs_data_get_int(settings, "max_size_mb");
+
+	pthread_mutex_lock(&rb->mutex);
+	rb->max_time_usec = max_time * 1000000;
+	rb->max_size      = (size_t)max_size * 1024 * 1024;
+	dstr_copy(&rb->path, obs_data_get_string(settings, "path"));
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool over_limit(struct replay_buffer *rb, int64_t newest_usec)
+{
+	int64_t duration = newest_usec - rb->packets.array[0].dts_usec;
+	return duration > rb->max_time_usec || rb->total_size > rb->max_size;
+}
+
+/* drops everything up to the next keyframe.  the newest group of pictures is
+ * always kept, even if it alone is over a limit. */
+static bool drop_front_gop(struct replay_buffer *rb)
+{
+	size_t count = 1;
+
+	while (count < rb->packets.num &&
+	       !is_keyframe(rb->packets.array + count))
+		count++;
+
+	if (count == rb->packets.num && is_keyframe(rb->packets.array))
+		return false;
+
+	for (size_t i = 0; i < count; i++) {
+		rb->total_size -= rb->packets.array[i].size;
+		obs_encoder_packet_release(rb->packets.array + i);
+	}
+
+	da_erase_range(rb->packets, 0, count);
+	return true;
+}
+
+static void replay_buffer_data(void *data, struct encoder_packet *packet)
+{
+	struct replay_buffer  *rb = data;
+	struct encoder_packet ref;
+
+	obs_encoder_packet_ref(&ref, packet);
+
+	pthread_mutex_lock(&rb->mutex);
+
+	da_push_back(rb->packets, &ref);
+	rb->total_size += ref.size;
+
+	while (rb->packets.num && over_limit(rb, ref.dts_usec)) {
+		if (!drop_front_gop(rb))
+			break;
+	}
+
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void offset_packet(struct encoder_packet *packet,
+		int64_t offset_usec)
+{
+	int64_t offset = offset_usec * packet->timebase_den /
+		((int64_t)packet->timebase_num * 1000000);
+
+	packet->pts -= offset;
+	packet->dts -= offset;
+}
+
+static bool write_fragment(struct replay_buffer *rb, FILE *file,
+		uint8_t *data, size_t size)
+{
+	bool success = fwrite(data, 1, size, file) == size;
+	if (!success)
+		warn("Failed to write to replay file '%s'",
+				rb->save_path.array);
+
+	bfree(data);
+	return success;
+}
+
+static void *save_thread(void *data)
+{
+	struct replay_buffer *rb = data;
+	struct mp4_mux       mux;
+	int64_t              start_usec;
+	uint8_t              *fragment;
+	size_t               size;
+	bool                 success;
+	FILE                 *file;
+
+	file = os_fopen(rb->save_path.array, "wb");
+	if (!file) {
+		warn("Unable to open replay file '%s'", rb->save_path.array);
+		return NULL;
+	}
+
+	start_usec = rb->save_packets.array[0].dts_usec;
+
+	mp4_mux_init(&mux, rb->output);
+	mp4_init_segment(&mux, rb->output, &fragment, &size);
+	success = write_fragment(rb, file, fragment, size);
+
+	for (size_t i = 0; success && i < rb->save_packets.num; i++) {
+		struct encoder_packet packet = rb->save_packets.array[i];
+		struct encoder_packet parsed_packet;
+		bool ready;
+
+		/* audio from before the first keyframe has nothing to play
+		 * against */
+		if (packet.dts_usec < start_usec)
+			continue;
+
+		offset_packet(&packet, start_usec);
+
+		if (packet.type == OBS_ENCODER_VIDEO) {
+			obs_parse_avc_packet(&parsed_packet, &packet);
+			ready = mp4_mux_packet(&mux, &parsed_packet,
+					&fragment, &size);
+			obs_encoder_packet_release(&parsed_packet);
+		} else {
+			ready = mp4_mux_packet(&mux, &packet, &fragment, &size);
+		}
+
+		if (ready)
+			success = write_fragment(rb, file, fragment, size);
+	}
+
+	if (success && mp4_mux_flush(&mux, &fragment, &size))
+		success = write_fragment(rb, file, fragment, size);
+
+	fclose(file);
+
+	if (success)
+		info("Saved %"PRId64" ms replay to '%s'", mux.duration,
+				rb->save_path.array);
+
+	mp4_mux_free(&mux);
+	return NULL;
+}
+
+/* takes references to everything from the first keyframe on, so the save
+ * thread works on its own snapshot while the buffer keeps filling */
+static bool take_snapshot(struct replay_buffer *rb)
+{
+	size_t first = 0;
+
+	while (first < rb->packets.num &&
+	       !is_keyframe(rb->packets.array + first))
+		first++;
+
+	for (size_t i = first; i < rb->packets.num; i++) {
+		struct encoder_packet *ref = da_push_back_new(rb->save_packets);
+		obs_encoder_packet_ref(ref, rb->packets.array + i);
+	}
+
+	return rb->save_packets.num != 0;
+}
+
+static void replay_buffer_save(void *data, calldata_t *cd)
+{
+	struct replay_buffer *rb = data;
+	const char *path = calldata_string(cd, "path");
+	bool success = false;
+
+	if (!rb->active)
+		goto finish;
+
+	join_save_thread(rb);
+
+	pthread_mutex_lock(&rb->mutex);
+	dstr_copy(&rb->save_path, (path && *path) ? path : rb->path.array);
+	success = take_snapshot(rb);
+	pthread_mutex_unlock(&rb->mutex);
+
+	if (!success) {
+		warn("Nothing to save yet");
+		goto finish;
+	}
+	if (dstr_is_empty(&rb->save_path)) {
+		warn("No path to save the replay to");
+		free_save_packets(rb);
+		success = false;
+		goto finish;
+	}
+
+	success = pthread_create(&rb->save_thread, NULL, save_thread,
+			rb) == 0;
+	if (success)
+		rb->save_thread_active = true;
+	else
+		free_save_packets(rb);
+
+finish:
+	calldata_set_bool(cd, "success", success);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct replay_buffer *rb = bzalloc(sizeof(struct replay_buffer));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	rb->output = output;
+	pthread_mutex_init_value(&rb->mutex);
+
+	if (pthread_mutex_init(&rb->mutex, NULL) != 0) {
+		bfree(rb);
+		return NULL;
+	}
+
+	replay_buffer_update(rb, settings);
+
+	proc_handler_add(ph, "void save(string path, out bool success)",
+			replay_buffer_save, rb);
+	return rb;
+}
+
+static bool replay_buffer_start(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (!obs_output_can_begin_data_capture(rb->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(rb->output, 0))
+		return false;
+
+	rb->active = true;
+	obs_output_begin_data_capture(rb->output, 0);
+
+	info("Replay buffer started, keeping up to %"PRId64" seconds or "
+	     "%"PRIu64" MB", rb->max_time_usec / 1000000,
+	     (uint64_t)rb->max_size / (1024 * 1024));
+	return true;
+}
+
+static void replay_buffer_stop(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active) {
+		obs_output_end_data_capture(rb->output);
+		rb->active = false;
+
+		join_save_thread(rb);
+
+		pthread_mutex_lock(&rb->mutex);
+		free_packets(rb);
+		pthread_mutex_unlock(&rb->mutex);
+	}
+}
+
+static void replay_buffer_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "max_time_sec",
+			DEFAULT_MAX_TIME_SEC);
+	obs_data_set_default_int(settings, "max_size_mb",
+			DEFAULT_MAX_SIZE_MB);
+}
+
+static obs_properties_t *replay_buffer_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_int(props, "max_time_sec",
+			obs_module_text("ReplayBuffer.MaxTime"),
+			1, 3600, 1);
+	obs_properties_add_int(props, "max_size_mb",
+			obs_module_text("ReplayBuffer.MaxSize"),
+			1, 16384, 1);
+	obs_properties_add_text(props, "path",
+			obs_module_text("ReplayBuffer.FilePath"),
+			OBS_TEXT_DEFAULT);
+	return props;
+}
+
+struct obs_output_info replay_buffer_info = {
+	.id              = "replay_buffer",
+	.flags           = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+	                   OBS_OUTPUT_MULTI_TRACK,
+	.get_name        = replay_buffer_getname,
+	.create          = replay_buffer_create,
+	.destroy         = replay_buffer_destroy,
+	.start           = replay_buffer_start,
+	.stop            = replay_buffer_stop,
+	.update          = replay_buffer_update,
+	.encoded_packet  = replay_buffer_data,
+	.get_defaults    = replay_buffer_defaults,
+	.get_properties  = replay_buffer_properties
+};
@@ -0,0 +1,431 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include "librtmp/rtmp_sys.h"
+#include "rtmp-connect.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/select.h>
+#define INVALID_SOCKET -1
+#endif
+
+/* resolved addresses are kept for this long */
+#define DNS_CACHE_TTL_NS          (5ULL * 60ULL * 1000000000ULL)
+
+/* a new connection attempt is started this often while the previous ones
+ * are still pending */
+#define CONNECT_ATTEMPT_DELAY_MS  250
+#define CONNECT_TIMEOUT_MS        10000
+#define MAX_CONNECT_ATTEMPTS      8
+
+struct net_addr {
+	struct sockaddr_storage addr;
+	socklen_t               len;
+};
+
+struct dns_entry {
+	char                    *host;
+	int                     port;
+	uint64_t                resolved_ns;
+	DARRAY(struct net_addr) addrs;
+};
+
+static pthread_mutex_t          dns_mutex;
+static DARRAY(struct dns_entry) dns_cache;
+
+void rtmp_connect_init(void)
+{
+	pthread_mutex_init(&dns_mutex, NULL);
+}
+
+static inline void dns_entry_free(struct dns_entry *entry)
+{
+	bfree(entry->host);
+	da_free(entry->addrs);
+}
+
+void rtmp_connect_free(void)
+{
+	for (size_t i = 0; i < dns_cache.num; i++)
+		dns_entry_free(dns_cache.array + i);
+	da_free(dns_cache);
+
+	pthread_mutex_destroy(&dns_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* DNS                                                                       */
+
+static size_t find_dns_entry(const char *host, int port)
+{
+	for (size_t i = 0; i < dns_cache.num; i++) {
+		struct dns_entry *entry = dns_cache.array + i;
+		if (entry->port == port && strcmp(entry->host, host) == 0)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static void forget_host(const char *host, int port)
+{
+	size_t idx;
+
+	pthread_mutex_lock(&dns_mutex);
+
+	idx = find_dns_entry(host, port);
+	if (idx != DARRAY_INVALID) {
+		dns_entry_free(dns_cache.array + idx);
+		da_erase(dns_cache, idx);
+	}
+
+	pthread_mutex_unlock(&dns_mutex);
+}
+
+static inline void push_addr(struct dns_entry *entry, struct addrinfo *ai)
+{
+	struct net_addr *addr = da_push_back_new(entry->addrs);
+	memcpy(&addr->addr, ai->ai_addr, ai->ai_addrlen);
+	addr->len = (socklen_t)ai->ai_addrlen;
+}
+
+/* alternates between address families, so a broken IPv6 route can't hold up
+ * every IPv4 attempt behind it */
+static void add_addrs(struct dns_entry *entry, struct addrinfo *list)
+{
+	struct addrinfo *v6 = NULL, *v4 = NULL, *ai;
+
+	for (ai = list; ai; ai = ai->ai_next) {
+		if (ai->ai_family == AF_INET6 && !v6)
+			v6 = ai;
+		else if (ai->ai_family == AF_INET && !v4)
+			v4 = ai;
+	}
+
+	while (v6 || v4) {
+		if (v6) {
+			push_addr(entry, v6);
+			do {
+				v6 = v6->ai_next;
+			} while (v6 && v6->ai_family != AF_INET6);
+		}
+		if (v4) {
+			push_addr(entry, v4);
+			do {
+				v4 = v4->ai_next;
+			} while (v4 && v4->ai_family != AF_INET);
+		}
+	}
+}
+
+static bool resolve(const char *host, int port, struct dns_entry *out,
+		bool *cached)
+{
+	struct addrinfo hints = {0};
+	struct addrinfo *list = NULL;
+	uint64_t now = os_gettime_ns();
+	char port_str[16];
+	size_t idx;
+	int ret;
+
+	memset(out, 0, sizeof(*out));
+
+	pthread_mutex_lock(&dns_mutex);
+
+	idx = find_dns_entry(host, port);
+	if (idx != DARRAY_INVALID) {
+		struct dns_entry *entry = dns_cache.array + idx;
+
+		if (now - entry->resolved_ns < DNS_CACHE_TTL_NS) {
+			da_copy(out->addrs, entry->addrs);
+			pthread_mutex_unlock(&dns_mutex);
+			*cached = true;
+			return true;
+		}
+
+		dns_entry_free(entry);
+		da_erase(dns_cache, idx);
+	}
+
+	pthread_mutex_unlock(&dns_mutex);
+
+	*cached = false;
+
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	snprintf(port_str, sizeof(port_str), "%d", port);
+
+	ret = getaddrinfo(host, port_str, &hints, &list);
+	if (ret != 0 || !list) {
+		blog(LOG_WARNING, "rtmp_connect: Could not resolve '%s': %d",
+				host, ret);
+		return false;
+	}
+
+	add_addrs(out, list);
+	freeaddrinfo(list);
+
+	if (!out->addrs.num)
+		return false;
+
+	out->host        = bstrdup(host);
+	out->port        = port;
+	out->resolved_ns = now;
+
+	pthread_mutex_lock(&dns_mutex);
+	idx = find_dns_entry(host, port);
+	if (idx == DARRAY_INVALID) {
+		struct dns_entry *entry = da_push_back_new(dns_cache);
+		entry->host        = bstrdup(host);
+		entry->port        = port;
+		entry->resolved_ns = now;
+		da_copy(entry->addrs, out->addrs);
+	}
+	pthread_mutex_unlock(&dns_mutex);
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* connecting                                                                */
+
+static inline bool set_blocking(SOCKET sock, bool blocking)
+{
+#ifdef _WIN32
+	u_long nonblocking = blocking ? 0 : 1;
+	return ioctlsocket(sock, FIONBIO, &nonblocking) == 0;
+#else
+	int flags = fcntl(sock, F_GETFL, 0);
+	if (flags < 0)
+		return false;
+
+	flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+	return fcntl(sock, F_SETFL, flags) == 0;
+#endif
+}
+
+static inline bool connect_pending(void)
+{
+	int err = GetSockError();
+#ifdef _WIN32
+	return err == WSAEWOULDBLOCK;
+#else
+	return err == EINPROGRESS;
+#endif
+}
+
+static SOCKET start_attempt(RTMP *r, const struct net_addr *addr)
+{
+	SOCKET sock = socket(addr->addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	if (r->m_bindIP.addrLen &&
+	    r->m_bindIP.addr.sin_family == addr->addr.ss_family &&
+	    bind(sock, (const struct sockaddr*)&r->m_bindIP.addr,
+		    r->m_bindIP.addrLen) < 0)
+		goto fail;
+
+	if (!set_blocking(sock, false))
+		goto fail;
+
+	if (connect(sock, (const struct sockaddr*)&addr->addr, addr->len) < 0 &&
+	    !connect_pending())
+		goto fail;
+
+	return sock;
+
+fail:
+	closesocket(sock);
+	return INVALID_SOCKET;
+}
+
+static inline bool socket_connected(SOCKET sock)
+{
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0)
+		return false;
+	return err == 0;
+}
+
+/* starts connecting to the first address, then to the next one every
+ * CONNECT_ATTEMPT_DELAY_MS (or right away when all pending attempts have
+ * failed), and keeps the first socket that connects */
+static SOCKET connect_fastest(RTMP *r, const struct net_addr *addrs,
+		size_t count)
+{
+	SOCKET   pending[MAX_CONNECT_ATTEMPTS];
+	size_t   num_pending = 0;
+	size_t   next        = 0;
+	SOCKET   winner      = INVALID_SOCKET;
+	uint64_t start       = os_gettime_ns();
+	uint64_t next_ns     = start;
+	uint64_t deadline    = start + CONNECT_TIMEOUT_MS * 1000000ULL;
+
+	if (count > MAX_CONNECT_ATTEMPTS)
+		count = MAX_CONNECT_ATTEMPTS;
+
+	while (winner == INVALID_SOCKET) {
+		uint64_t now = os_gettime_ns();
+		uint64_t wait_ns;
+		struct timeval tv;
+		fd_set write_set, except_set;
+		SOCKET max_sock = 0;
+		int ret;
+
+		if (next < count && (now >= next_ns || !num_pending)) {
+			SOCKET sock = start_attempt(r, addrs + next++);
+			if (sock != INVALID_SOCKET)
+				pending[num_pending++] = sock;
+
+			next_ns = now + CONNECT_ATTEMPT_DELAY_MS * 1000000ULL;
+			continue;
+		}
+
+		if (!num_pending || now >= deadline)
+			break;
+
+		wait_ns = deadline - now;
+		if (next < count && next_ns - now < wait_ns)
+			wait_ns = next_ns - now;
+
+		FD_ZERO(&write_set);
+		FD_ZERO(&except_set);
+		for (size_t i = 0; i < num_pending; i++) {
+			FD_SET(pending[i], &write_set);
+			FD_SET(pending[i], &except_set);
+			if (pending[i] > max_sock)
+				max_sock = pending[i];
+		}
+
+		tv.tv_sec  = (long)(wait_ns / 1000000000ULL);
+		tv.tv_usec = (long)(wait_ns % 1000000000ULL / 1000);
+
+		ret = select((int)max_sock + 1, NULL, &write_set, &except_set,
+				&tv);
+		if (ret < 0)
+			break;
+
+		for (size_t i = 0; i < num_pending; i++) {
+			SOCKET sock = pending[i];
+			bool   done = FD_ISSET(sock, &write_set) ||
+			              FD_ISSET(sock, &except_set);
+
+			if (!done)
+				continue;
+
+			if (winner == INVALID_SOCKET && socket_connected(sock)) {
+				winner = sock;
+			} else {
+				closesocket(sock);
+			}
+
+			pending[i--] = pending[--num_pending];
+		}
+	}
+
+	for (size_t i = 0; i < num_pending; i++)
+		closesocket(pending[i]);
+
+	if (winner != INVALID_SOCKET && !set_blocking(winner, true)) {
+		closesocket(winner);
+		winner = INVALID_SOCKET;
+	}
+
+	return winner;
+}
+
+static bool connect_socket(RTMP *r, const char *host, int port)
+{
+	struct dns_entry entry;
+	SOCKET sock;
+	bool cached;
+
+	if (!resolve(host, port, &entry, &cached))
+		return false;
+
+	sock = connect_fastest(r, entry.addrs.array, entry.addrs.num);
+	dns_entry_free(&entry);
+
+	/* the server may have moved, try again with fresh addresses */
+	if (sock == INVALID_SOCKET && cached) {
+		forget_host(host, port);
+
+		if (!resolve(host, port, &entry, &cached))
+			return false;
+
+		sock = connect_fastest(r, entry.addrs.array, entry.addrs.num);
+		dns_entry_free(&entry);
+	}
+
+	if (sock == INVALID_SOCKET) {
+		forget_host(host, port);
+		blog(LOG_WARNING, "rtmp_connect: Could not connect to '%s'",
+				host);
+		return false;
+	}
+
+	r->m_sb.sb_socket = sock;
+	return true;
+}
+
+bool rtmp_connect(RTMP *r)
+{
+	struct dstr host = {0};
+	int on = 1;
+	bool success;
+
+	if (!r->Link.hostname.av_len)
+		return false;
+
+	/* proxied connections go through librtmp's own code */
+	if (r->Link.socksport)
+		return RTMP_Connect(r, NULL) != 0;
+
+	dstr_ncopy(&host, r->Link.hostname.av_val, r->Link.hostname.av_len);
+	success = connect_socket(r, host.array, r->Link.port);
+	dstr_free(&host);
+
+	if (!success)
+		return false;
+
+	r->m_sb.sb_timedout = false;
+	r->m_pausing        = 0;
+	r->m_fDuration      = 0.0;
+
+	{
+		SET_RCVTIMEO(tv, r->Link.timeout);
+		setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_RCVTIMEO,
+				(char*)&tv, sizeof(tv));
+	}
+
+	if (!r->m_bUseNagle)
+		setsockopt(r->m_sb.sb_socket, IPPROTO_TCP, TCP_NODELAY,
+				(char*)&on, sizeof(on));
+
+	r->m_bSendCounter = true;
+	return RTMP_Connect1(r, NULL) != 0;
+}
@@ -0,0 +1,35 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include "librtmp/rtmp.h"
+
+/*
+ * Connects the socket of an RTMP object that has been set up with
+ * RTMP_SetupURL, and performs the RTMP handshake (replaces RTMP_Connect).
+ *
+ * Resolved ingest addresses are cached for a few minutes, so reconnecting to
+ * the same server skips DNS.  When a host has several addresses, connection
+ * attempts are started a short time apart without waiting for the previous
+ * ones to fail, and the first one to succeed is used.
+ */
+extern bool rtmp_connect(RTMP *r);
+
+extern void rtmp_connect_init(void);
+extern void rtmp_connect_free(void);
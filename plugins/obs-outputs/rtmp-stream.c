@@ -19,12 +19,19 @@
 #include <obs-avc.h>
 #include <util/platform.h>
 #include <util/circlebuf.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/threading.h>
+#include <util/profiler.h>
 #include <inttypes.h>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
 #include "librtmp/rtmp.h"
 #include "librtmp/log.h"
 #include "flv-mux.h"
+#include "rtmp-connect.h"
 
 #define do_log(level, format, ...) \
 	blog(level, "[rtmp stream: '%s'] " format, \
@@ -34,7 +41,21 @@
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 #define debug(format, ...) do_log(LOG_DEBUG,   format, ##__VA_ARGS__)
 
-#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+#define OPT_DROP_THRESHOLD  "drop_threshold_ms"
+#define OPT_DYNAMIC_BITRATE "dynamic_bitrate"
+#define OPT_PACING          "socket_pacing"
+
+/* when the connection drops, the send thread first tries to reconnect right
+ * away while packets keep queuing, before the output is stopped and restarted
+ * by the regular (much slower) reconnect */
+#define WARM_RECONNECT_ATTEMPTS 3
+#define WARM_RECONNECT_DELAY_MS 250
+
+/* chunk size announced to the server.  chunks of one message are sent with a
+ * single gathered write, a large size mostly saves header bytes and keeps
+ * the number of buffers per write low.  64 KB is the largest size that
+ * common ingest servers accept */
+#define RTMP_OUT_CHUNK_SIZE (64 * 1024)
 
 //#define TEST_FRAMEDROPS
 
@@ -44,6 +65,12 @@ struct rtmp_stream {
 	pthread_mutex_t  packets_mutex;
 	struct circlebuf packets;
 
+	/* packets are taken from the queue in batches and muxed into a single
+	 * buffer so they can be written with one RTMP_Write call.  the buffer
+	 * is reused, so muxing does not allocate once it has grown */
+	DARRAY(struct encoder_packet) send_packets;
+	struct array_output_data send_data;
+
 	bool             connecting;
 	pthread_t        connect_thread;
 
@@ -62,6 +89,29 @@ struct rtmp_stream {
 	int              min_priority;
 
 	int64_t          last_dts_usec;
+	size_t           buffered_bytes;
+
+	/* after a warm reconnect, packets are dropped until the next video
+	 * keyframe so the new connection starts with a decodable frame */
+	bool             wait_for_keyframe;
+	int              warm_reconnects;
+
+	/* buffered duration relative to the drop threshold, reported to
+	 * libobs to lower the encoder bitrate before frames need dropping */
+	bool             dynamic_bitrate;
+	float            congestion;
+
+	/* send rate estimation */
+	uint64_t         rate_window_start;
+	uint64_t         rate_window_busy_ns;
+	uint64_t         rate_window_bytes;
+	uint32_t         send_rate_kbps;
+
+	/* the socket send buffer follows bitrate and round trip time, and is
+	 * optionally paced */
+	bool             pacing;
+	uint64_t         last_tune_ns;
+	uint32_t         pacing_rate;
 
 	uint64_t         total_bytes_sent;
 	int              dropped_frames;
@@ -87,8 +137,10 @@ static inline void free_packets(struct rtmp_stream *stream)
 	while (stream->packets.size) {
 		struct encoder_packet packet;
 		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
-		obs_free_encoder_packet(&packet);
+		obs_encoder_packet_release(&packet);
 	}
+
+	stream->buffered_bytes = 0;
 }
 
 static void rtmp_stream_stop(void *data);
@@ -110,6 +162,8 @@ static void rtmp_stream_destroy(void *data)
 		os_sem_destroy(stream->send_sem);
 		pthread_mutex_destroy(&stream->packets_mutex);
 		circlebuf_free(&stream->packets);
+		da_free(stream->send_packets);
+		array_output_serializer_free(&stream->send_data);
 		bfree(stream);
 	}
 }
@@ -171,51 +225,355 @@ static inline void set_rtmp_dstr(AVal *val, struct dstr *str)
 	val->av_len = valid ? (int)str->len : 0;
 }
 
-static inline bool get_next_packet(struct rtmp_stream *stream,
-		struct encoder_packet *packet)
+static inline bool get_packet_batch(struct rtmp_stream *stream)
 {
-	bool new_packet = false;
+	size_t count;
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
 
-	pthread_mutex_lock(&stream->packets_mutex);
-	if (stream->packets.size) {
-		circlebuf_pop_front(&stream->packets, packet,
-				sizeof(struct encoder_packet));
-		new_packet = true;
+	count = stream->packets.size / sizeof(struct encoder_packet);
+	if (count) {
+		da_resize(stream->send_packets, count);
+		circlebuf_pop_front(&stream->packets,
+				stream->send_packets.array,
+				count * sizeof(struct encoder_packet));
+		stream->buffered_bytes = 0;
 	}
-	pthread_mutex_unlock(&stream->packets_mutex);
 
-	return new_packet;
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	return count != 0;
 }
 
 static int send_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t  size;
-	int     ret = 0;
+	struct array_output_data *data = &stream->send_data;
+	int ret = 0;
 
-	flv_packet_mux(packet, &data, &size, is_header);
+	da_resize(data->bytes, 0);
+	flv_packet_mux_append(packet, data, is_header);
 #ifdef TEST_FRAMEDROPS
 	os_sleep_ms(rand() % 40);
 #endif
-	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size);
-	bfree(data);
+	ret = RTMP_Write(&stream->rtmp, (char*)data->bytes.array,
+			(int)data->bytes.num);
+
+	stream->total_bytes_sent += data->bytes.num;
+	return ret;
+}
+
+#define RATE_WINDOW_NS 1000000000ULL
+
+/*
+ * Estimates the rate the connection can sustain from how long RTMP_Write
+ * blocks.  If the send thread was blocked on the socket for most of the
+ * window, the wall-clock rate is what the connection is able to sustain;
+ * otherwise the rate while busy is used, which is an upper bound.
+ */
+static void update_send_rate(struct rtmp_stream *stream, uint64_t start_ns,
+		uint64_t end_ns, size_t bytes)
+{
+	uint64_t elapsed;
+	uint64_t time_ns;
+	uint64_t rate;
+
+	if (!stream->rate_window_start)
+		stream->rate_window_start = start_ns;
+
+	stream->rate_window_busy_ns += end_ns - start_ns;
+	stream->rate_window_bytes   += bytes;
+
+	elapsed = end_ns - stream->rate_window_start;
+	if (elapsed < RATE_WINDOW_NS)
+		return;
+
+	time_ns = (stream->rate_window_busy_ns * 10 >= elapsed * 9) ?
+		elapsed : stream->rate_window_busy_ns;
+
+	if (time_ns) {
+		rate = stream->rate_window_bytes * 8 * 1000000ULL / time_ns;
 
-	obs_free_encoder_packet(packet);
+		if (rate > UINT32_MAX)
+			rate = UINT32_MAX;
 
-	stream->total_bytes_sent += size;
+		stream->send_rate_kbps = stream->send_rate_kbps ?
+			(uint32_t)((stream->send_rate_kbps * 3ULL + rate) / 4) :
+			(uint32_t)rate;
+	}
+
+	stream->rate_window_start   = end_ns;
+	stream->rate_window_busy_ns = 0;
+	stream->rate_window_bytes   = 0;
+}
+
+#ifdef _WIN32
+#define socklen_t int
+#endif
+
+#define SOCKET_TUNE_INTERVAL_NS 1000000000ULL
+#define MIN_SENDBUF_SIZE        65535
+#define MAX_SENDBUF_SIZE        (8 * 1024 * 1024)
+#define DEFAULT_RTT_USEC        100000
+#define SENDBUF_RTT_FACTOR      2
+#define PACING_RATE_FACTOR      2
+
+static inline int encoder_bitrate_kbps(obs_encoder_t *encoder)
+{
+	obs_data_t *settings;
+	int        bitrate;
+
+	if (!encoder)
+		return 0;
+
+	settings = obs_encoder_get_settings(encoder);
+	bitrate = (int)obs_data_get_int(settings, "bitrate");
+	obs_data_release(settings);
+	return bitrate;
+}
+
+/* read every time, the video bitrate can change while streaming */
+static uint64_t get_stream_bytes_per_sec(struct rtmp_stream *stream)
+{
+	obs_output_t *context = stream->output;
+	int kbps = encoder_bitrate_kbps(obs_output_get_video_encoder(context)) +
+		encoder_bitrate_kbps(obs_output_get_audio_encoder(context, 0));
+
+	return kbps > 0 ? (uint64_t)kbps * 1000 / 8 : 0;
+}
+
+/* smoothed round trip time of the connection, 0 if unknown */
+static uint32_t get_rtt_usec(struct rtmp_stream *stream)
+{
+#if defined(TCP_INFO)
+	struct tcp_info tcp_info;
+	socklen_t size = sizeof(tcp_info);
+
+	if (getsockopt(stream->rtmp.m_sb.sb_socket, IPPROTO_TCP, TCP_INFO,
+				&tcp_info, &size) == 0)
+		return tcp_info.tcpi_rtt;
+#elif defined(TCP_CONNECTION_INFO)
+	struct tcp_connection_info tcp_info;
+	socklen_t size = sizeof(tcp_info);
+
+	if (getsockopt(stream->rtmp.m_sb.sb_socket, IPPROTO_TCP,
+				TCP_CONNECTION_INFO, &tcp_info, &size) == 0)
+		return tcp_info.tcpi_srtt * 1000;
+#else
+	UNUSED_PARAMETER(stream);
+#endif
+	return 0;
+}
+
+/*
+ * The send buffer only needs to hold what is in flight, about bitrate times
+ * round trip time.  A larger buffer hides congestion from the frame dropping
+ * logic, because data sitting in the socket no longer counts as buffered,
+ * while a smaller one limits throughput on high latency connections.
+ * Windows computes this value itself (ideal send backlog).
+ */
+static int get_target_sndbuf_size(struct rtmp_stream *stream,
+		uint64_t bytes_per_sec)
+{
+	uint64_t size = 0;
+
+#if defined(_WIN32) && defined(SIO_IDEAL_SEND_BACKLOG_QUERY)
+	ULONG backlog = 0;
+	DWORD bytes   = 0;
+
+	if (WSAIoctl(stream->rtmp.m_sb.sb_socket, SIO_IDEAL_SEND_BACKLOG_QUERY,
+				NULL, 0, &backlog, sizeof(backlog), &bytes,
+				NULL, NULL) == 0)
+		size = backlog;
+#endif
+
+	if (!size) {
+		uint32_t rtt_usec = get_rtt_usec(stream);
+		if (!rtt_usec)
+			rtt_usec = DEFAULT_RTT_USEC;
+
+		size = bytes_per_sec * rtt_usec / 1000000 * SENDBUF_RTT_FACTOR;
+	}
+
+	if (size < MIN_SENDBUF_SIZE)
+		size = MIN_SENDBUF_SIZE;
+	else if (size > MAX_SENDBUF_SIZE)
+		size = MAX_SENDBUF_SIZE;
+
+	return (int)size;
+}
+
+static void set_sndbuf_size(struct rtmp_stream *stream, int new_size)
+{
+	int cur_size = 0;
+	socklen_t int_size = sizeof(int);
+
+	getsockopt(stream->rtmp.m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF,
+			(char*)&cur_size, &int_size);
+
+	/* ignore small changes, linux also reports twice the set size */
+	if (cur_size >= new_size && cur_size <= new_size * 5 / 2)
+		return;
+
+	setsockopt(stream->rtmp.m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF,
+			(const char*)&new_size, int_size);
+	debug("Send buffer size changed from %d to %d", cur_size, new_size);
+}
+
+/* pacing spreads out the large bursts caused by keyframes, so they don't fill
+ * up the queues on the way to the server */
+static void set_pacing_rate(struct rtmp_stream *stream, uint64_t bytes_per_sec)
+{
+#ifdef SO_MAX_PACING_RATE
+	uint64_t rate = bytes_per_sec * PACING_RATE_FACTOR;
+	uint32_t rate32 = rate > UINT32_MAX ? UINT32_MAX : (uint32_t)rate;
+
+	if (!bytes_per_sec || rate32 == stream->pacing_rate)
+		return;
+
+	if (setsockopt(stream->rtmp.m_sb.sb_socket, SOL_SOCKET,
+				SO_MAX_PACING_RATE, &rate32,
+				sizeof(rate32)) == 0)
+		stream->pacing_rate = rate32;
+#else
+	UNUSED_PARAMETER(stream);
+	UNUSED_PARAMETER(bytes_per_sec);
+#endif
+}
+
+static void tune_socket(struct rtmp_stream *stream, uint64_t now_ns)
+{
+	uint64_t bytes_per_sec;
+
+	if (stream->last_tune_ns &&
+	    now_ns - stream->last_tune_ns < SOCKET_TUNE_INTERVAL_NS)
+		return;
+
+	if (!stream->last_tune_ns)
+		stream->pacing_rate = 0;
+	stream->last_tune_ns = now_ns;
+
+	bytes_per_sec = get_stream_bytes_per_sec(stream);
+
+	set_sndbuf_size(stream, get_target_sndbuf_size(stream,
+				bytes_per_sec));
+	if (stream->pacing)
+		set_pacing_rate(stream, bytes_per_sec);
+}
+
+static int send_batch(struct rtmp_stream *stream)
+{
+	struct array_output_data *data = &stream->send_data;
+	uint64_t start_ns, end_ns;
+	int      ret;
+
+	da_resize(data->bytes, 0);
+
+	for (size_t i = 0; i < stream->send_packets.num; i++) {
+		struct encoder_packet *packet = stream->send_packets.array+i;
+
+		flv_packet_mux_append(packet, data, false);
+		obs_encoder_packet_release(packet);
+	}
+
+	da_resize(stream->send_packets, 0);
+
+#ifdef TEST_FRAMEDROPS
+	os_sleep_ms(rand() % 40);
+#endif
+	start_ns = os_gettime_ns();
+	ret = RTMP_Write(&stream->rtmp, (char*)data->bytes.array,
+			(int)data->bytes.num);
+	end_ns = os_gettime_ns();
+	update_send_rate(stream, start_ns, end_ns, data->bytes.num);
+	tune_socket(stream, end_ns);
+
+	stream->total_bytes_sent += data->bytes.num;
 	return ret;
 }
 
-static bool send_remaining_packets(struct rtmp_stream *stream)
+/* sends packets until the queue is empty.  the encoder thread only posts the
+ * semaphore when it adds a packet to an empty queue, so the queue must always
+ * be fully drained before waiting again */
+static bool send_queued_packets(struct rtmp_stream *stream)
+{
+	while (get_packet_batch(stream))
+		if (send_batch(stream) < 0)
+			return false;
+
+	return true;
+}
+
+static int connect_rtmp(struct rtmp_stream *stream);
+static void send_headers(struct rtmp_stream *stream);
+
+/* drops everything queued before the first video keyframe, or everything if
+ * there isn't one yet, in which case incoming packets are dropped until the
+ * next keyframe arrives */
+static void drop_until_keyframe(struct rtmp_stream *stream)
 {
 	struct encoder_packet packet;
 
-	while (get_next_packet(stream, &packet))
-		if (send_packet(stream, &packet, false) < 0)
+	/* audio-only streams can resume from any packet */
+	if (!obs_output_get_video_encoder(stream->output))
+		return;
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
+
+	while (stream->packets.size) {
+		circlebuf_peek_front(&stream->packets, &packet, sizeof(packet));
+		if (packet.type == OBS_ENCODER_VIDEO && packet.keyframe)
+			break;
+
+		circlebuf_pop_front(&stream->packets, NULL, sizeof(packet));
+		stream->buffered_bytes -= packet.size;
+		if (packet.type == OBS_ENCODER_VIDEO)
+			stream->dropped_frames++;
+		obs_encoder_packet_release(&packet);
+	}
+
+	stream->wait_for_keyframe = stream->packets.size == 0;
+
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+}
+
+static bool warm_reconnect(struct rtmp_stream *stream)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+
+	for (int i = 0; i < WARM_RECONNECT_ATTEMPTS; i++) {
+		uint64_t start = os_gettime_ns();
+
+		if (i > 0 && os_event_timedwait(stream->stop_event,
+					WARM_RECONNECT_DELAY_MS * i) != ETIMEDOUT)
 			return false;
 
-	return true;
+		RTMP_Close(&stream->rtmp);
+
+		info("Connection lost, reconnecting to %s...",
+				stream->path.array);
+
+		if (connect_rtmp(stream) == OBS_OUTPUT_SUCCESS) {
+			stream->last_tune_ns = 0;
+			send_headers(stream);
+			drop_until_keyframe(stream);
+			stream->warm_reconnects++;
+
+			/* don't wait for the encoder's next keyframe */
+			if (stream->wait_for_keyframe)
+				obs_encoder_request_keyframe(vencoder);
+
+			info("Reconnected in %"PRIu64" ms",
+					(os_gettime_ns() - start) / 1000000);
+
+			/* packets queued while reconnecting didn't wake up
+			 * the send thread */
+			os_sem_post(stream->send_sem);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 static void *send_thread(void *data)
@@ -223,25 +581,34 @@ static void *send_thread(void *data)
 	struct rtmp_stream *stream = data;
 	bool disconnected = false;
 
+	bmem_set_thread_tag(BMEM_TAG_OUTPUT);
+	os_set_thread_role(OS_THREAD_ROLE_NETWORK);
+
 	while (os_sem_wait(stream->send_sem) == 0) {
-		struct encoder_packet packet;
+		bool sent;
 
 		if (os_event_try(stream->stop_event) != EAGAIN)
 			break;
-		if (!get_next_packet(stream, &packet))
-			continue;
-		if (send_packet(stream, &packet, false) < 0) {
+
+		profile_start("send_thread");
+		sent = send_queued_packets(stream);
+		profile_end("send_thread");
+
+		if (!sent && !warm_reconnect(stream)) {
 			disconnected = true;
 			break;
 		}
 	}
 
-	if (!disconnected && !send_remaining_packets(stream))
+	if (!disconnected && !send_queued_packets(stream))
 		disconnected = true;
 
 	if (disconnected) {
 		info("Disconnected from %s", stream->path.array);
 		free_packets(stream);
+		for (size_t i = 0; i < stream->send_packets.num; i++)
+			obs_encoder_packet_release(stream->send_packets.array+i);
+		da_resize(stream->send_packets, 0);
 	} else {
 		info("User stopped the stream");
 	}
@@ -268,7 +635,7 @@ static void send_meta_data(struct rtmp_stream *stream)
 static void send_audio_header(struct rtmp_stream *stream)
 {
 	obs_output_t  *context  = stream->output;
-	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context, 0);
 	uint8_t       *header;
 
 	struct encoder_packet packet   = {
@@ -277,7 +644,7 @@ static void send_audio_header(struct rtmp_stream *stream)
 	};
 
 	obs_encoder_get_extra_data(aencoder, &header, &packet.size);
-	packet.data = bmemdup(header, packet.size);
+	packet.data = header;
 	send_packet(stream, &packet, true);
 }
 
@@ -294,9 +661,13 @@ static void send_video_header(struct rtmp_stream *stream)
 		.keyframe     = true
 	};
 
+	if (!vencoder)
+		return;
+
 	obs_encoder_get_extra_data(vencoder, &header, &size);
 	packet.size = obs_parse_avc_header(&packet.data, header, size);
 	send_packet(stream, &packet, true);
+	bfree(packet.data);
 }
 
 static void send_headers(struct rtmp_stream *stream)
@@ -312,34 +683,12 @@ static inline bool reset_semaphore(struct rtmp_stream *stream)
 	return os_sem_init(&stream->send_sem, 0) == 0;
 }
 
-#ifdef _WIN32
-#define socklen_t int
-#endif
-
-#define MIN_SENDBUF_SIZE 65535
-
-static void adjust_sndbuf_size(struct rtmp_stream *stream, int new_size)
-{
-	int cur_sendbuf_size = new_size;
-	socklen_t int_size = sizeof(int);
-
-	getsockopt(stream->rtmp.m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF,
-			(char*)&cur_sendbuf_size, &int_size);
-
-	if (cur_sendbuf_size < new_size) {
-		cur_sendbuf_size = new_size;
-		setsockopt(stream->rtmp.m_sb.sb_socket, SOL_SOCKET, SO_SNDBUF,
-				(const char*)&cur_sendbuf_size, int_size);
-	}
-}
-
 static int init_send(struct rtmp_stream *stream)
 {
 	int ret;
 
-#if defined(_WIN32)
-	adjust_sndbuf_size(stream, MIN_SENDBUF_SIZE);
-#endif
+	stream->last_tune_ns = 0;
+	tune_socket(stream, os_gettime_ns());
 
 	reset_semaphore(stream);
 
@@ -357,15 +706,8 @@ static int init_send(struct rtmp_stream *stream)
 	return OBS_OUTPUT_SUCCESS;
 }
 
-static int try_connect(struct rtmp_stream *stream)
+static int connect_rtmp(struct rtmp_stream *stream)
 {
-	if (dstr_is_empty(&stream->path)) {
-		warn("URL is empty");
-		return OBS_OUTPUT_BAD_PATH;
-	}
-
-	info("Connecting to RTMP URL %s...", stream->path.array);
-
 	if (!RTMP_SetupURL2(&stream->rtmp, stream->path.array,
 				stream->key.array))
 		return OBS_OUTPUT_BAD_PATH;
@@ -378,15 +720,33 @@ static int try_connect(struct rtmp_stream *stream)
 	set_rtmp_str(&stream->rtmp.Link.flashVer,
 			"FMLE/3.0 (compatible; FMSc/1.0)");
 
-	stream->rtmp.m_outChunkSize       = 4096;
+	stream->rtmp.m_outChunkSize       = RTMP_OUT_CHUNK_SIZE;
 	stream->rtmp.m_bSendChunkSizeInfo = true;
 	stream->rtmp.m_bUseNagle          = true;
 
-	if (!RTMP_Connect(&stream->rtmp, NULL))
+	if (!rtmp_connect(&stream->rtmp))
 		return OBS_OUTPUT_CONNECT_FAILED;
 	if (!RTMP_ConnectStream(&stream->rtmp, 0))
 		return OBS_OUTPUT_INVALID_STREAM;
 
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static int try_connect(struct rtmp_stream *stream)
+{
+	int ret;
+
+	if (dstr_is_empty(&stream->path)) {
+		warn("URL is empty");
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	info("Connecting to RTMP URL %s...", stream->path.array);
+
+	ret = connect_rtmp(stream);
+	if (ret != OBS_OUTPUT_SUCCESS)
+		return ret;
+
 	info("Connection to %s successful", stream->path.array);
 
 	return init_send(stream);
@@ -395,7 +755,10 @@ static int try_connect(struct rtmp_stream *stream)
 static void *connect_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
-	int ret = try_connect(stream);
+	int ret;
+
+	bmem_set_thread_tag(BMEM_TAG_OUTPUT);
+	ret = try_connect(stream);
 
 	if (ret != OBS_OUTPUT_SUCCESS) {
 		obs_output_signal_stop(stream->output, ret);
@@ -420,8 +783,16 @@ static bool rtmp_stream_start(void *data)
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
 
-	stream->total_bytes_sent = 0;
-	stream->dropped_frames   = 0;
+	stream->total_bytes_sent    = 0;
+	stream->dropped_frames      = 0;
+	stream->buffered_bytes      = 0;
+	stream->rate_window_start   = 0;
+	stream->rate_window_busy_ns = 0;
+	stream->rate_window_bytes   = 0;
+	stream->send_rate_kbps      = 0;
+	stream->congestion          = 0.0f;
+	stream->wait_for_keyframe   = false;
+	stream->warm_reconnects     = 0;
 
 	settings = obs_output_get_settings(stream->output);
 	dstr_copy(&stream->path,     obs_service_get_url(service));
@@ -430,6 +801,9 @@ static bool rtmp_stream_start(void *data)
 	dstr_copy(&stream->password, obs_service_get_password(service));
 	stream->drop_threshold_usec =
 		(int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD) * 1000;
+	stream->dynamic_bitrate =
+		obs_data_get_bool(settings, OPT_DYNAMIC_BITRATE);
+	stream->pacing = obs_data_get_bool(settings, OPT_PACING);
 	obs_data_release(settings);
 
 	return pthread_create(&stream->connect_thread, NULL, connect_thread,
@@ -441,7 +815,8 @@ static inline bool add_packet(struct rtmp_stream *stream,
 {
 	circlebuf_push_back(&stream->packets, packet,
 			sizeof(struct encoder_packet));
-	stream->last_dts_usec = packet->dts_usec;
+	stream->last_dts_usec   = packet->dts_usec;
+	stream->buffered_bytes += packet->size;
 	return true;
 }
 
@@ -450,7 +825,8 @@ static inline size_t num_buffered_packets(struct rtmp_stream *stream)
 	return stream->packets.size / sizeof(struct encoder_packet);
 }
 
-static void drop_frames(struct rtmp_stream *stream)
+/* drops buffered video packets with a priority of max_priority or lower */
+static void drop_frames(struct rtmp_stream *stream, int max_priority)
 {
 	struct circlebuf new_buf            = {0};
 	int              drop_priority      = 0;
@@ -467,15 +843,17 @@ static void drop_frames(struct rtmp_stream *stream)
 
 		last_drop_dts_usec = packet.dts_usec;
 
-		if (packet.type == OBS_ENCODER_AUDIO) {
+		if (packet.type == OBS_ENCODER_AUDIO ||
+		    packet.priority > max_priority) {
 			circlebuf_push_back(&new_buf, &packet, sizeof(packet));
 
 		} else {
 			if (drop_priority < packet.drop_priority)
 				drop_priority = packet.drop_priority;
 
+			stream->buffered_bytes -= packet.size;
 			num_frames_dropped++;
-			obs_free_encoder_packet(&packet);
+			obs_encoder_packet_release(&packet);
 		}
 	}
 
@@ -488,28 +866,74 @@ static void drop_frames(struct rtmp_stream *stream)
 	debug("New packet count: %d", (int)num_buffered_packets(stream));
 }
 
+/* estimated time to send everything currently buffered, or 0 if the send rate
+ * isn't known yet */
+static inline int64_t buffered_send_time_usec(struct rtmp_stream *stream)
+{
+	if (!stream->send_rate_kbps)
+		return 0;
+
+	return (int64_t)((uint64_t)stream->buffered_bytes * 8000ULL /
+			stream->send_rate_kbps);
+}
+
 static void check_to_drop_frames(struct rtmp_stream *stream)
 {
 	struct encoder_packet first;
 	int64_t buffer_duration_usec;
+	int64_t send_time_usec;
 
-	if (num_buffered_packets(stream) < 5)
+	if (num_buffered_packets(stream) < 5) {
+		stream->congestion = 0.0f;
 		return;
+	}
 
 	circlebuf_peek_front(&stream->packets, &first, sizeof(first));
 
+	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	stream->congestion = stream->drop_threshold_usec ?
+		(float)buffer_duration_usec /
+		(float)stream->drop_threshold_usec : 0.0f;
+
 	/* do not drop frames if frames were just dropped within this time */
 	if (first.dts_usec < stream->min_drop_dts_usec)
 		return;
 
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
 
-	if (buffer_duration_usec > stream->drop_threshold_usec) {
-		drop_frames(stream);
-		debug("dropping %" PRId64 " worth of frames",
-				buffer_duration_usec);
+	if (buffer_duration_usec <= stream->drop_threshold_usec)
+		return;
+
+	debug("buffered %" PRId64 " worth of frames", buffer_duration_usec);
+
+	/* without a send rate estimate, there is no way of telling how much
+	 * needs to be dropped, so drop all buffered video.  this is also done
+	 * if the buffer keeps growing in spite of the estimate */
+	if (!stream->send_rate_kbps ||
+	    buffer_duration_usec > stream->drop_threshold_usec * 2) {
+		drop_frames(stream, OBS_NAL_PRIORITY_HIGHEST);
+		return;
+	}
+
+	/* drop the least important frames first (non-reference frames, then
+	 * low priority reference frames) and only drop everything if the
+	 * buffered data still can't be sent within the threshold */
+	for (int priority = OBS_NAL_PRIORITY_DISPOSABLE;
+	     priority <= OBS_NAL_PRIORITY_HIGHEST;
+	     priority++) {
+		if (priority == OBS_NAL_PRIORITY_HIGH)
+			continue;
+
+		send_time_usec = buffered_send_time_usec(stream);
+		if (send_time_usec <= stream->drop_threshold_usec)
+			break;
+
+		debug("estimated send time %" PRId64 " at %u kbps, dropping "
+				"frames of priority %d or lower",
+				send_time_usec, stream->send_rate_kbps,
+				priority);
+		drop_frames(stream, priority);
 	}
 }
 
@@ -535,29 +959,53 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 	struct rtmp_stream    *stream = data;
 	struct encoder_packet new_packet;
 	bool                  added_packet;
+	bool                  was_empty;
+	float                 congestion;
 
 	if (packet->type == OBS_ENCODER_VIDEO)
 		obs_parse_avc_packet(&new_packet, packet);
 	else
-		obs_duplicate_encoder_packet(&new_packet, packet);
+		obs_encoder_packet_ref(&new_packet, packet);
 
-	pthread_mutex_lock(&stream->packets_mutex);
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
 
-	added_packet = (packet->type == OBS_ENCODER_VIDEO) ?
-		add_video_packet(stream, &new_packet) :
-		add_packet(stream, &new_packet);
+	if (stream->wait_for_keyframe && packet->type == OBS_ENCODER_VIDEO &&
+	    packet->keyframe)
+		stream->wait_for_keyframe = false;
 
-	pthread_mutex_unlock(&stream->packets_mutex);
+	was_empty = stream->packets.size == 0;
 
-	if (added_packet)
+	if (stream->wait_for_keyframe) {
+		if (packet->type == OBS_ENCODER_VIDEO)
+			stream->dropped_frames++;
+		added_packet = false;
+	} else {
+		added_packet = (packet->type == OBS_ENCODER_VIDEO) ?
+			add_video_packet(stream, &new_packet) :
+			add_packet(stream, &new_packet);
+	}
+
+	/* the send thread drains the whole queue each time it wakes up, so it
+	 * only needs to be woken when the queue goes from empty to non-empty */
+	if (added_packet && was_empty)
 		os_sem_post(stream->send_sem);
-	else
-		obs_free_encoder_packet(&new_packet);
+
+	congestion = stream->congestion;
+
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	if (!added_packet)
+		obs_encoder_packet_release(&new_packet);
+
+	if (stream->dynamic_bitrate && packet->type == OBS_ENCODER_VIDEO)
+		obs_output_report_congestion(stream->output, congestion);
 }
 
 static void rtmp_stream_defaults(obs_data_t *defaults)
 {
 	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 600);
+	obs_data_set_default_bool(defaults, OPT_DYNAMIC_BITRATE, false);
+	obs_data_set_default_bool(defaults, OPT_PACING, false);
 }
 
 static obs_properties_t *rtmp_stream_properties(void *unused)
@@ -569,6 +1017,10 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 	obs_properties_add_int(props, OPT_DROP_THRESHOLD,
 			obs_module_text("RTMPStream.DropThreshold"),
 			200, 10000, 100);
+	obs_properties_add_bool(props, OPT_DYNAMIC_BITRATE,
+			obs_module_text("RTMPStream.DynamicBitrate"));
+	obs_properties_add_bool(props, OPT_PACING,
+			obs_module_text("RTMPStream.Pacing"));
 	return props;
 }
 
@@ -584,6 +1036,24 @@ static int rtmp_stream_dropped_frames(void *data)
 	return stream->dropped_frames;
 }
 
+static uint32_t rtmp_stream_send_rate(void *data)
+{
+	struct rtmp_stream *stream = data;
+	return stream->send_rate_kbps;
+}
+
+static size_t rtmp_stream_queued_packets(void *data)
+{
+	struct rtmp_stream *stream = data;
+	size_t num;
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
+	num = num_buffered_packets(stream);
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	return num;
+}
+
 struct obs_output_info rtmp_output_info = {
 	.id                 = "rtmp_output",
 	.flags              = OBS_OUTPUT_AV |
@@ -598,5 +1068,7 @@ struct obs_output_info rtmp_output_info = {
 	.get_defaults       = rtmp_stream_defaults,
 	.get_properties     = rtmp_stream_properties,
 	.get_total_bytes    = rtmp_stream_total_bytes_sent,
-	.get_dropped_frames = rtmp_stream_dropped_frames
+	.get_dropped_frames = rtmp_stream_dropped_frames,
+	.get_send_rate      = rtmp_stream_send_rate,
+	.get_queued_packets = rtmp_stream_queued_packets
 };         
@@ -0,0 +1,445 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/pipe.h>
+#include <util/dstr.h>
+#include <media-io/video-frame.h>
+#include <inttypes.h>
+#include "shm-output.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[shm output: '%s'] " format, \
+			obs_output_get_name(so->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+#define SETTING_NAME        "name"
+#define SETTING_VIDEO_SLOTS "video_slots"
+#define SETTING_AUDIO_SLOTS "audio_slots"
+#define SETTING_CONSUMER    "consumer"
+
+#define TEXT_SHM_OUTPUT     obs_module_text("ShmOutput")
+#define TEXT_NAME           obs_module_text("ShmOutput.Name")
+#define TEXT_VIDEO_SLOTS    obs_module_text("ShmOutput.VideoSlots")
+#define TEXT_AUDIO_SLOTS    obs_module_text("ShmOutput.AudioSlots")
+#define TEXT_CONSUMER       obs_module_text("ShmOutput.Consumer")
+
+#define SLOT_ALIGNMENT      64
+#define AUDIO_SLOT_FRAMES   1024
+
+#define ALIGN_SIZE(size) \
+	(((size) + (SLOT_ALIGNMENT - 1)) & ~(uint64_t)(SLOT_ALIGNMENT - 1))
+
+/*
+ * Writes the raw frames the output receives in to a named block of shared
+ * memory, so that local processes can read them without encoding (see
+ * shm-output.h for the layout).
+ *
+ * Optionally a consumer process is launched when the output starts.  It gets
+ * "start <name> <size>\n" on its standard input once the block is ready, and
+ * "stop\n" when the output stops, after which its standard input is closed
+ * and the output waits for it to exit.
+ */
+struct shm_output {
+	obs_output_t             *output;
+
+	char                     *name;
+	char                     *consumer_cmd;
+	uint32_t                 video_slots;
+	uint32_t                 audio_slots;
+
+	os_shmem_t               *shmem;
+	struct shm_output_header *header;
+	uint8_t                  *video;
+	uint8_t                  *audio;
+	os_process_pipe_t        *consumer;
+
+	/* video thread only */
+	uint64_t                 video_frames;
+	enum video_format        video_format;
+	uint32_t                 video_height;
+
+	/* audio thread only */
+	uint64_t                 audio_frames;
+	uint64_t                 audio_index;
+	uint32_t                 audio_rate;
+
+	bool                     active;
+};
+
+static const char *shm_output_getname(void)
+{
+	return TEXT_SHM_OUTPUT;
+}
+
+static inline uint32_t plane_height(enum video_format format, size_t plane,
+		uint32_t height)
+{
+	if (plane > 0 && (format == VIDEO_FORMAT_I420 ||
+	                  format == VIDEO_FORMAT_NV12))
+		return height / 2;
+	return height;
+}
+
+/* uses the same plane layout as video_frame_init, relative to the slot */
+static uint64_t init_video_layout(struct shm_output_header *header,
+		const struct video_output_info *voi)
+{
+	struct video_frame frame;
+	uint64_t size = 0;
+
+	video_frame_init(&frame, voi->format, voi->width, voi->height);
+
+	for (size_t i = 0; i < MAX_AV_PLANES && frame.data[i]; i++) {
+		uint64_t offset = (uint64_t)(frame.data[i] - frame.data[0]);
+		uint64_t end = offset + (uint64_t)frame.linesize[i] *
+			plane_height(voi->format, i, voi->height);
+
+		header->plane_offset[i] = (uint32_t)offset;
+		header->linesize[i]     = frame.linesize[i];
+		if (end > size)
+			size = end;
+	}
+
+	video_frame_free(&frame);
+	return size;
+}
+
+static bool init_header(struct shm_output *so,
+		struct shm_output_header *header)
+{
+	const struct video_output_info *voi;
+	const struct audio_output_info *aoi;
+	uint64_t video_size;
+
+	voi = video_output_get_info(obs_output_video(so->output));
+	aoi = audio_output_get_info(obs_output_audio(so->output));
+
+	memset(header, 0, sizeof(*header));
+	header->version     = SHM_OUTPUT_VERSION;
+	header->header_size = sizeof(struct shm_output_header);
+
+	video_size = init_video_layout(header, voi);
+	if (!video_size) {
+		warn("unsupported video format %d", (int)voi->format);
+		return false;
+	}
+
+	header->video_format    = (uint32_t)voi->format;
+	header->colorspace      = (uint32_t)voi->colorspace;
+	header->range           = (uint32_t)voi->range;
+	header->width           = voi->width;
+	header->height          = voi->height;
+	header->fps_num         = voi->fps_num;
+	header->fps_den         = voi->fps_den;
+	header->video_slots     = so->video_slots;
+	header->video_slot_size = ALIGN_SIZE(sizeof(struct shm_output_slot) +
+			video_size);
+
+	header->audio_format      = (uint32_t)aoi->format;
+	header->speakers          = (uint32_t)aoi->speakers;
+	header->samples_per_sec   = aoi->samples_per_sec;
+	header->audio_planes      = (uint32_t)get_audio_planes(aoi->format,
+			aoi->speakers);
+	header->audio_block_size  = (uint32_t)get_audio_size(aoi->format,
+			aoi->speakers, 1);
+	header->audio_slot_frames = AUDIO_SLOT_FRAMES;
+	header->audio_plane_size  = (uint32_t)ALIGN_SIZE(
+			header->audio_block_size * AUDIO_SLOT_FRAMES);
+	header->audio_slots       = so->audio_slots;
+	header->audio_slot_size   = ALIGN_SIZE(sizeof(struct shm_output_slot) +
+			(uint64_t)header->audio_plane_size *
+			header->audio_planes);
+
+	header->video_offset = ALIGN_SIZE(sizeof(struct shm_output_header));
+	header->audio_offset = header->video_offset +
+		header->video_slot_size * header->video_slots;
+	header->total_size   = header->audio_offset +
+		header->audio_slot_size * header->audio_slots;
+
+	so->video_format = voi->format;
+	so->video_height = voi->height;
+	so->audio_rate   = aoi->samples_per_sec;
+	return true;
+}
+
+static inline struct shm_output_slot *get_slot(uint8_t *base,
+		uint64_t slot_size, uint32_t slots, uint64_t idx)
+{
+	return (struct shm_output_slot*)(base + slot_size * (idx % slots));
+}
+
+static inline void begin_slot_write(struct shm_output_slot *slot)
+{
+	/* odd: readers discard whatever they copy from here on */
+	os_atomic_add_64(&slot->seq, 1);
+}
+
+static inline void end_slot_write(struct shm_output_slot *slot,
+		volatile int64_t *written, uint64_t total)
+{
+	os_atomic_add_64(&slot->seq, 1);
+	os_atomic_set_64(written, (int64_t)total);
+}
+
+static void shm_output_raw_video(void *data, struct video_data *frame)
+{
+	struct shm_output *so = data;
+	struct shm_output_header *header = so->header;
+	struct shm_output_slot *slot;
+	struct video_frame dst = {0};
+	struct video_frame src;
+	uint8_t *slot_data;
+
+	slot = get_slot(so->video, header->video_slot_size,
+			header->video_slots, so->video_frames);
+	slot_data = (uint8_t*)(slot + 1);
+
+	for (size_t i = 0; i < MAX_AV_PLANES && frame->data[i]; i++) {
+		dst.data[i]     = slot_data + header->plane_offset[i];
+		dst.linesize[i] = header->linesize[i];
+	}
+
+	memcpy(src.data, frame->data, sizeof(src.data));
+	memcpy(src.linesize, frame->linesize, sizeof(src.linesize));
+
+	begin_slot_write(slot);
+	slot->index     = so->video_frames;
+	slot->timestamp = frame->timestamp;
+	slot->frames    = 0;
+	video_frame_copy(&dst, &src, so->video_format, so->video_height);
+	end_slot_write(slot, &header->video_written, ++so->video_frames);
+}
+
+static void shm_output_raw_audio(void *data, struct audio_data *frames)
+{
+	struct shm_output *so = data;
+	struct shm_output_header *header = so->header;
+	uint32_t block_size = header->audio_block_size;
+	uint32_t offset = 0;
+
+	/* packets bigger than a slot are split over several slots */
+	while (offset < frames->frames) {
+		struct shm_output_slot *slot;
+		uint8_t *slot_data;
+		uint32_t count = frames->frames - offset;
+
+		if (count > header->audio_slot_frames)
+			count = header->audio_slot_frames;
+
+		slot = get_slot(so->audio, header->audio_slot_size,
+				header->audio_slots, so->audio_index);
+		slot_data = (uint8_t*)(slot + 1);
+
+		begin_slot_write(slot);
+		slot->index     = so->audio_frames;
+		slot->timestamp = frames->timestamp +
+			(uint64_t)offset * 1000000000ULL / so->audio_rate;
+		slot->frames    = count;
+
+		for (uint32_t i = 0; i < header->audio_planes; i++)
+			memcpy(slot_data + (size_t)header->audio_plane_size * i,
+					frames->data[i] + (size_t)offset *
+					block_size,
+					(size_t)count * block_size);
+
+		end_slot_write(slot, &header->audio_written,
+				++so->audio_index);
+
+		so->audio_frames += count;
+		offset           += count;
+	}
+}
+
+static void send_consumer(struct shm_output *so, const char *msg)
+{
+	size_t len = strlen(msg);
+
+	if (os_process_pipe_write(so->consumer, (const uint8_t*)msg, len) !=
+			len)
+		warn("failed to write to consumer process");
+}
+
+static void start_consumer(struct shm_output *so)
+{
+	struct dstr msg = {0};
+
+	if (!so->consumer_cmd || !*so->consumer_cmd)
+		return;
+
+	so->consumer = os_process_pipe_create(so->consumer_cmd, "w");
+	if (!so->consumer) {
+		warn("failed to launch consumer '%s'", so->consumer_cmd);
+		return;
+	}
+
+	dstr_printf(&msg, "start %s %"PRIu64"\n", so->name,
+			(uint64_t)os_shmem_get_size(so->shmem));
+	send_consumer(so, msg.array);
+	dstr_free(&msg);
+
+	info("launched consumer '%s'", so->consumer_cmd);
+}
+
+static void stop_consumer(struct shm_output *so)
+{
+	if (!so->consumer)
+		return;
+
+	send_consumer(so, "stop\n");
+	os_process_pipe_destroy(so->consumer);
+	so->consumer = NULL;
+}
+
+static void free_shmem(struct shm_output *so)
+{
+	os_shmem_destroy(so->shmem);
+	so->shmem  = NULL;
+	so->header = NULL;
+	so->video  = NULL;
+	so->audio  = NULL;
+}
+
+static void shm_output_stop(void *data)
+{
+	struct shm_output *so = data;
+
+	if (!so->active)
+		return;
+
+	obs_output_end_data_capture(so->output);
+	os_atomic_set_64(&so->header->active, 0);
+
+	stop_consumer(so);
+
+	info("stopped, %"PRIu64" video frames and %"PRIu64" audio frames "
+	     "written", so->video_frames, so->audio_frames);
+
+	free_shmem(so);
+	so->active = false;
+}
+
+static bool shm_output_start(void *data)
+{
+	struct shm_output *so = data;
+	struct shm_output_header header;
+
+	if (so->active)
+		return true;
+	if (!obs_output_can_begin_data_capture(so->output, 0))
+		return false;
+	if (!init_header(so, &header))
+		return false;
+
+	so->shmem = os_shmem_create(so->name, (size_t)header.total_size);
+	if (!so->shmem) {
+		warn("failed to create shared memory '%s'", so->name);
+		return false;
+	}
+
+	so->header = os_shmem_get_data(so->shmem);
+	so->video  = (uint8_t*)so->header + header.video_offset;
+	so->audio  = (uint8_t*)so->header + header.audio_offset;
+
+	memset(so->header, 0, (size_t)header.total_size);
+	memcpy(so->header, &header, sizeof(header));
+	os_atomic_set_64(&so->header->active, 1);
+
+	so->video_frames = 0;
+	so->audio_frames = 0;
+	so->audio_index  = 0;
+
+	start_consumer(so);
+
+	if (!obs_output_begin_data_capture(so->output, 0)) {
+		stop_consumer(so);
+		free_shmem(so);
+		return false;
+	}
+
+	so->active = true;
+	info("started, %ux%u, %"PRIu64" bytes of shared memory",
+			header.width, header.height, header.total_size);
+	return true;
+}
+
+static void shm_output_update(void *data, obs_data_t *settings)
+{
+	struct shm_output *so = data;
+
+	bfree(so->name);
+	bfree(so->consumer_cmd);
+
+	so->name         = bstrdup(obs_data_get_string(settings, SETTING_NAME));
+	so->consumer_cmd = bstrdup(obs_data_get_string(settings,
+				SETTING_CONSUMER));
+	so->video_slots  = (uint32_t)obs_data_get_int(settings,
+			SETTING_VIDEO_SLOTS);
+	so->audio_slots  = (uint32_t)obs_data_get_int(settings,
+			SETTING_AUDIO_SLOTS);
+
+	if (!so->video_slots)
+		so->video_slots = 1;
+	if (!so->audio_slots)
+		so->audio_slots = 1;
+}
+
+static void *shm_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct shm_output *so = bzalloc(sizeof(struct shm_output));
+
+	so->output = output;
+	shm_output_update(so, settings);
+	return so;
+}
+
+static void shm_output_destroy(void *data)
+{
+	struct shm_output *so = data;
+
+	shm_output_stop(so);
+	bfree(so->name);
+	bfree(so->consumer_cmd);
+	bfree(so);
+}
+
+static void shm_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, SETTING_NAME, "obs_raw_output");
+	obs_data_set_default_int(settings, SETTING_VIDEO_SLOTS, 4);
+	obs_data_set_default_int(settings, SETTING_AUDIO_SLOTS, 32);
+}
+
+static obs_properties_t *shm_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, SETTING_NAME, TEXT_NAME,
+			OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, SETTING_VIDEO_SLOTS, TEXT_VIDEO_SLOTS,
+			1, 64, 1);
+	obs_properties_add_int(props, SETTING_AUDIO_SLOTS, TEXT_AUDIO_SLOTS,
+			1, 256, 1);
+	obs_properties_add_text(props, SETTING_CONSUMER, TEXT_CONSUMER,
+			OBS_TEXT_DEFAULT);
+
+	return props;
+}
+
+struct obs_output_info shm_output_info = {
+	.id             = "shm_output",
+	.flags          = OBS_OUTPUT_AV,
+	.get_name       = shm_output_getname,
+	.create         = shm_output_create,
+	.destroy        = shm_output_destroy,
+	.start          = shm_output_start,
+	.stop           = shm_output_stop,
+	.update         = shm_output_update,
+	.raw_video      = shm_output_raw_video,
+	.raw_audio      = shm_output_raw_audio,
+	.get_defaults   = shm_output_defaults,
+	.get_properties = shm_output_properties
+};
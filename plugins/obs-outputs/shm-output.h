@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Layout of the shared memory written by the shared memory output, for
+ * processes reading raw frames from it.
+ *
+ * The block starts with a struct shm_output_header, followed by video_slots
+ * video slots at video_offset and audio_slots audio slots at audio_offset.
+ * Each slot starts with a struct shm_output_slot, followed by the frame data
+ * (at slot + sizeof(struct shm_output_slot)):
+ *
+ *   - video: planes at plane_offset[i] with linesize[i], in video_format
+ *   - audio: audio_planes planes of audio_plane_size bytes each, the first
+ *     frames * audio_block_size bytes of every plane are valid
+ *
+ * Slots are written round robin.  The writer makes seq odd, writes the slot,
+ * makes seq even again, and then stores the number of slots written so far
+ * in video_written/audio_written, so the newest slot is at index
+ * (written - 1) % slots.  A reader copies a slot out and then checks that
+ * seq was even and unchanged across the copy; otherwise the slot was being
+ * overwritten and the copy has to be discarded.  Slot data can also be read
+ * in place as long as seq is checked afterwards.
+ *
+ * active is cleared when the output stops, after which the block is removed.
+ * Readers that still have it mapped keep their mapping until they unmap it.
+ */
+
+#define SHM_OUTPUT_VERSION    1
+#define SHM_OUTPUT_MAX_PLANES 8
+
+#pragma pack(push, 8)
+
+struct shm_output_slot {
+	volatile int64_t               seq;
+	uint64_t                       index;     /* number of the frame */
+	uint64_t                       timestamp; /* ns, OBS clock */
+	uint32_t                       frames;    /* audio frames, 0 for video */
+	uint32_t                       reserved;
+};
+
+struct shm_output_header {
+	uint32_t                       version;
+	uint32_t                       header_size;
+	uint64_t                       total_size;
+
+	/* video, video_slots is 0 if the output has no video */
+	uint32_t                       video_format;  /* enum video_format */
+	uint32_t                       colorspace;    /* enum video_colorspace */
+	uint32_t                       range;         /* enum video_range_type */
+	uint32_t                       width;
+	uint32_t                       height;
+	uint32_t                       fps_num;
+	uint32_t                       fps_den;
+	uint32_t                       video_slots;
+	uint64_t                       video_slot_size;
+	uint64_t                       video_offset;
+	uint32_t                       plane_offset[SHM_OUTPUT_MAX_PLANES];
+	uint32_t                       linesize[SHM_OUTPUT_MAX_PLANES];
+
+	/* audio, audio_slots is 0 if the output has no audio */
+	uint32_t                       audio_format;  /* enum audio_format */
+	uint32_t                       speakers;      /* enum speaker_layout */
+	uint32_t                       samples_per_sec;
+	uint32_t                       audio_planes;
+	uint32_t                       audio_block_size;
+	uint32_t                       audio_slot_frames;
+	uint32_t                       audio_plane_size;
+	uint32_t                       audio_slots;
+	uint64_t                       audio_slot_size;
+	uint64_t                       audio_offset;
+
+	volatile int64_t               video_written;
+	volatile int64_t               audio_written;
+	volatile int64_t               active;
+};
+
+#pragma pack(pop)
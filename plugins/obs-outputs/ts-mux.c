@@ -0,0 +1,494 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs.h>
+#include <util/serializer.h>
+#include "ts-mux.h"
+
+/* TODO: like the FLV muxer, video is hard-coded to h264 */
+
+#define PID_PAT          0x0000
+#define PID_PMT          0x1000
+#define PID_VIDEO        0x0100
+#define PID_AUDIO        0x0101
+
+#define STREAM_TYPE_H264 0x1B
+#define STREAM_TYPE_AAC  0x0F
+#define STREAM_TYPE_PES  0x06
+
+#define STREAM_ID_VIDEO  0xE0
+#define STREAM_ID_AUDIO  0xC0
+#define STREAM_ID_PES    0xBD
+
+#define TS_CLOCK         90000
+
+/* timestamps are offset so audio starting slightly before the first video
+ * frame doesn't go negative, and the clock reference runs ahead of the
+ * decode timestamps by the time receivers get to buffer frames */
+#define TS_TIME_OFFSET   (TS_CLOCK / 2)
+#define PCR_DELAY        (TS_CLOCK / 10)
+
+#define TS_TIME_MASK     0x1FFFFFFFFLL
+
+#define ADTS_HEADER_SIZE 7
+
+static const uint8_t start_code[] = {0, 0, 0, 1};
+static const uint8_t access_unit_delimiter[] = {0, 0, 0, 1, 0x09, 0xF0};
+
+static const uint32_t aac_sample_rates[] = {
+	96000, 88200, 64000, 48000, 44100, 32000,
+	24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+/* ------------------------------------------------------------------------- */
+
+static uint32_t crc32_mpeg(const uint8_t *data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < size; i++) {
+		crc ^= (uint32_t)data[i] << 24;
+
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80000000) ?
+				(crc << 1) ^ 0x04C11DB7 : crc << 1;
+	}
+
+	return crc;
+}
+
+static inline int64_t ts_time(const struct encoder_packet *packet,
+		int64_t val)
+{
+	int64_t time = val * TS_CLOCK * packet->timebase_num /
+		packet->timebase_den;
+	return (time + TS_TIME_OFFSET) & TS_TIME_MASK;
+}
+
+static inline void write_ts_header(struct serializer *s, uint16_t pid,
+		bool unit_start, bool adaptation_field, uint8_t *continuity)
+{
+	s_w8(s, 0x47);
+	s_w8(s, (unit_start ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+	s_w8(s, (uint8_t)pid);
+	s_w8(s, (adaptation_field ? 0x30 : 0x10) | *continuity);
+
+	*continuity = (*continuity + 1) & 0xF;
+}
+
+/* ------------------------------------------------------------------------- */
+/* program tables */
+
+static void write_section(struct serializer *s, uint16_t pid,
+		uint8_t *continuity, uint8_t *section, size_t size)
+{
+	uint32_t crc = crc32_mpeg(section, size);
+
+	write_ts_header(s, pid, true, false, continuity);
+	s_w8(s, 0); /* pointer field */
+	s_write(s, section, size);
+	s_wb32(s, crc);
+
+	for (size_t i = 4 + 1 + size + 4; i < TS_PACKET_SIZE; i++)
+		s_w8(s, 0xFF);
+}
+
+static void write_pat(struct ts_mux *mux, struct serializer *s)
+{
+	uint8_t section[] = {
+		0x00,                  /* table id */
+		0xB0, 13,              /* section length */
+		0x00, 0x01,            /* transport stream id */
+		0xC1, 0x00, 0x00,      /* version, section numbers */
+		0x00, 0x01,            /* program number */
+		0xE0 | (PID_PMT >> 8), PID_PMT & 0xFF
+	};
+
+	write_section(s, PID_PAT, &mux->pat_continuity, section,
+			sizeof(section));
+}
+
+/* opus is carried as private data, identified by a registration descriptor
+ * and a DVB extension descriptor with the channel configuration */
+static size_t write_opus_descriptors(uint8_t *data, struct ts_stream *stream)
+{
+	static const uint8_t registration[] = {0x05, 4, 'O', 'p', 'u', 's'};
+
+	memcpy(data, registration, sizeof(registration));
+	data[6] = 0x7F; /* extension descriptor */
+	data[7] = 2;
+	data[8] = 0x80; /* opus */
+	data[9] = stream->channels;
+	return 10;
+}
+
+static void write_pmt(struct ts_mux *mux, struct serializer *s)
+{
+	uint8_t section[TS_PACKET_SIZE];
+	size_t  size = 0;
+
+	section[size++] = 0x02;
+	section[size++] = 0;  /* section length, set below */
+	section[size++] = 0;
+	section[size++] = 0x00;
+	section[size++] = 0x01;
+	section[size++] = 0xC1;
+	section[size++] = 0x00;
+	section[size++] = 0x00;
+	section[size++] = 0xE0 | (PID_VIDEO >> 8);
+	section[size++] = PID_VIDEO & 0xFF;
+	section[size++] = 0xF0;
+	section[size++] = 0x00;
+
+	for (size_t i = 0; i < mux->num_streams; i++) {
+		struct ts_stream *stream = &mux->streams[i];
+		size_t info_size = 0;
+		uint8_t type;
+
+		if (i == 0)
+			type = STREAM_TYPE_H264;
+		else
+			type = stream->opus ? STREAM_TYPE_PES : STREAM_TYPE_AAC;
+
+		section[size++] = type;
+		section[size++] = 0xE0 | (uint8_t)(stream->pid >> 8);
+		section[size++] = (uint8_t)stream->pid;
+
+		if (stream->opus)
+			info_size = write_opus_descriptors(section + size + 2,
+					stream);
+
+		section[size++] = 0xF0 | (uint8_t)(info_size >> 8);
+		section[size++] = (uint8_t)info_size;
+		size += info_size;
+	}
+
+	/* everything after the length field, including the CRC */
+	section[1] = 0xB0 | (uint8_t)((size + 1) >> 8);
+	section[2] = (uint8_t)(size + 1);
+
+	write_section(s, PID_PMT, &mux->pmt_continuity, section, size);
+}
+
+/* ------------------------------------------------------------------------- */
+/* elementary streams */
+
+static inline bool has_start_code(const uint8_t *data, size_t size)
+{
+	return size >= 4 && data[0] == 0 && data[1] == 0 &&
+		(data[2] == 1 || (data[2] == 0 && data[3] == 1));
+}
+
+/* the packets are AVCC, and every 4 byte length just becomes a start code */
+static void append_annexb(struct ts_mux *mux, const uint8_t *data,
+		size_t size)
+{
+	const uint8_t *end = data + size;
+
+	while (end - data > 4) {
+		size_t nal_size = ((size_t)data[0] << 24) |
+			((size_t)data[1] << 16) | ((size_t)data[2] << 8) |
+			(size_t)data[3];
+
+		data += 4;
+		if (nal_size > (size_t)(end - data))
+			break;
+
+		da_push_back_array(mux->pes, start_code, sizeof(start_code));
+		da_push_back_array(mux->pes, data, nal_size);
+		data += nal_size;
+	}
+}
+
+/* every opus packet is preceded by a control header with its size */
+static void append_opus_header(struct ts_mux *mux, size_t size)
+{
+	uint8_t header[] = {0x7F, 0xE0};
+
+	da_push_back_array(mux->pes, header, sizeof(header));
+
+	for (; size >= 255; size -= 255) {
+		uint8_t val = 255;
+		da_push_back(mux->pes, &val);
+	}
+
+	header[0] = (uint8_t)size;
+	da_push_back(mux->pes, header);
+}
+
+static void append_adts_header(struct ts_mux *mux, struct ts_stream *stream,
+		size_t size)
+{
+	size_t  frame_size = size + ADTS_HEADER_SIZE;
+	uint8_t header[ADTS_HEADER_SIZE];
+
+	header[0] = 0xFF;
+	header[1] = 0xF1; /* MPEG-4, no CRC */
+	header[2] = (uint8_t)((stream->aac_profile << 6) |
+			(stream->aac_freq_idx << 2) |
+			(stream->channels >> 2));
+	header[3] = (uint8_t)(((stream->channels & 3) << 6) |
+			(frame_size >> 11));
+	header[4] = (uint8_t)(frame_size >> 3);
+	header[5] = (uint8_t)(((frame_size & 7) << 5) | 0x1F);
+	header[6] = 0xFC;
+
+	da_push_back_array(mux->pes, header, ADTS_HEADER_SIZE);
+}
+
+static inline void write_timestamp(struct serializer *s, uint8_t prefix,
+		int64_t ts)
+{
+	s_w8(s, (uint8_t)((prefix << 4) | ((ts >> 29) & 0x0E) | 1));
+	s_wb16(s, (uint16_t)(((ts >> 14) & 0xFFFE) | 1));
+	s_wb16(s, (uint16_t)(((ts << 1) & 0xFFFE) | 1));
+}
+
+static void write_pes_header(struct serializer *s, uint8_t stream_id,
+		int64_t pts, int64_t dts, size_t size)
+{
+	bool   write_dts   = pts != dts;
+	size_t header_size = write_dts ? 10 : 5;
+	size_t length      = 3 + header_size + size;
+	bool   video       = stream_id == STREAM_ID_VIDEO;
+
+	s_wb24(s, 0x000001);
+	s_w8(s, stream_id);
+
+	/* video packets may be too large for the length field, 0 means that
+	 * the packet continues up to the next one */
+	s_wb16(s, (video || length > 0xFFFF) ? 0 : (uint16_t)length);
+
+	s_w8(s, video ? 0x84 : 0x80); /* data alignment for video */
+	s_w8(s, write_dts ? 0xC0 : 0x80);
+	s_w8(s, (uint8_t)header_size);
+
+	write_timestamp(s, write_dts ? 0x3 : 0x2, pts);
+	if (write_dts)
+		write_timestamp(s, 0x1, dts);
+}
+
+static void write_adaptation_field(struct serializer *s, size_t size,
+		bool random_access, bool write_pcr, int64_t pcr)
+{
+	size_t written = 1;
+
+	s_w8(s, (uint8_t)(size - 1));
+
+	if (size > 1) {
+		s_w8(s, (random_access ? 0x40 : 0) | (write_pcr ? 0x10 : 0));
+		written++;
+	}
+
+	if (write_pcr) {
+		s_wb32(s, (uint32_t)(pcr >> 1));
+		s_w8(s, (uint8_t)(((pcr & 1) << 7) | 0x7E));
+		s_w8(s, 0);
+		written += 6;
+	}
+
+	for (; written < size; written++)
+		s_w8(s, 0xFF);
+}
+
+/* splits the PES header and payload in to TS packets.  the first one carries
+ * the random access flag and clock reference, and the last one is padded
+ * with adaptation field stuffing */
+static void write_ts_packets(struct serializer *s, struct ts_stream *stream,
+		const uint8_t *header, size_t header_size,
+		const uint8_t *data, size_t size,
+		bool random_access, bool write_pcr, int64_t pcr)
+{
+	bool first = true;
+
+	while (header_size || size) {
+		bool   flags = first && (random_access || write_pcr);
+		size_t af_size = flags ? (write_pcr && first ? 8 : 2) : 0;
+		size_t payload = TS_PACKET_SIZE - 4 - af_size;
+		size_t left    = header_size + size;
+		size_t count;
+
+		if (left < payload) {
+			af_size += payload - left;
+			payload  = left;
+		}
+
+		write_ts_header(s, stream->pid, first, af_size != 0,
+				&stream->continuity);
+		if (af_size)
+			write_adaptation_field(s, af_size,
+					flags && random_access,
+					flags && write_pcr, pcr);
+
+		count = header_size < payload ? header_size : payload;
+		s_write(s, header, count);
+		header      += count;
+		header_size -= count;
+		payload     -= count;
+
+		s_write(s, data, payload);
+		data += payload;
+		size -= payload;
+
+		first = false;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint8_t get_freq_idx(uint32_t sample_rate)
+{
+	size_t count = sizeof(aac_sample_rates) / sizeof(aac_sample_rates[0]);
+
+	for (size_t i = 0; i < count; i++) {
+		if (aac_sample_rates[i] == sample_rate)
+			return (uint8_t)i;
+	}
+
+	return 4; /* 44.1khz */
+}
+
+static void init_audio_stream(struct ts_stream *stream,
+		obs_encoder_t *aencoder)
+{
+	audio_t *audio = obs_encoder_audio(aencoder);
+	uint8_t *config;
+	size_t  size;
+	bool    has_config;
+
+	has_config = obs_encoder_get_extra_data(aencoder, &config, &size);
+	stream->opus = strcmp(obs_encoder_get_codec(aencoder), "opus") == 0;
+
+	/* OpusHead: channel count at offset 9 */
+	if (stream->opus) {
+		stream->channels = (has_config && size > 9) ? config[9] :
+			(uint8_t)audio_output_get_channels(audio);
+
+	/* AudioSpecificConfig: object type, sample rate index, channels */
+	} else if (has_config && size >= 2) {
+		stream->aac_profile  = (uint8_t)((config[0] >> 3) - 1);
+		stream->aac_freq_idx = (uint8_t)(((config[0] & 7) << 1) |
+				(config[1] >> 7));
+		stream->channels     = (config[1] >> 3) & 0xF;
+	} else {
+		stream->aac_profile  = 1; /* LC */
+		stream->aac_freq_idx = get_freq_idx(
+				audio_output_get_sample_rate(audio));
+		stream->channels     = (uint8_t)audio_output_get_channels(
+				audio);
+	}
+}
+
+void ts_mux_init(struct ts_mux *mux, obs_output_t *context)
+{
+	obs_encoder_t    *vencoder = obs_output_get_video_encoder(context);
+	struct ts_stream *video    = &mux->streams[0];
+	uint8_t          *header;
+	size_t           size;
+
+	memset(mux, 0, sizeof(struct ts_mux));
+
+	video->pid = PID_VIDEO;
+	if (obs_encoder_get_extra_data(vencoder, &header, &size) &&
+	    has_start_code(header, size))
+		da_push_back_array(video->config, header, size);
+
+	mux->num_streams = 1;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		obs_encoder_t *aencoder = obs_output_get_audio_encoder(context,
+				i);
+		struct ts_stream *audio = &mux->streams[mux->num_streams];
+
+		if (!aencoder)
+			break;
+
+		audio->pid = (uint16_t)(PID_AUDIO + i);
+		init_audio_stream(audio, aencoder);
+		mux->num_streams++;
+	}
+}
+
+void ts_mux_free(struct ts_mux *mux)
+{
+	for (size_t i = 0; i < TS_MAX_STREAMS; i++)
+		da_free(mux->streams[i].config);
+	da_free(mux->pes);
+}
+
+void ts_mux_packet(struct ts_mux *mux, struct encoder_packet *packet,
+		struct array_output_data *output)
+{
+	struct array_output_data data = *output;
+	struct array_output_data header;
+	struct serializer        header_s;
+	struct serializer        s;
+	struct ts_stream         *stream;
+	bool                     video = packet->type == OBS_ENCODER_VIDEO;
+	size_t                   idx   = video ? 0 : 1 + packet->track_idx;
+	uint8_t                  stream_id;
+	int64_t                  pts, dts;
+
+	if (idx >= mux->num_streams)
+		return;
+
+	stream = &mux->streams[idx];
+	pts    = ts_time(packet, packet->pts);
+	dts    = ts_time(packet, packet->dts);
+
+	/* the serializer init clears the array, keep what is already in it */
+	array_output_serializer_init(&s, output);
+	*output = data;
+
+	if (!mux->tables_written || (video && packet->keyframe)) {
+		write_pat(mux, &s);
+		write_pmt(mux, &s);
+		mux->tables_written = true;
+	}
+
+	da_resize(mux->pes, 0);
+
+	if (video) {
+		da_push_back_array(mux->pes, access_unit_delimiter,
+				sizeof(access_unit_delimiter));
+		if (packet->keyframe)
+			da_push_back_array(mux->pes, stream->config.array,
+					stream->config.num);
+		append_annexb(mux, packet->data, packet->size);
+	} else {
+		if (stream->opus)
+			append_opus_header(mux, packet->size);
+		else
+			append_adts_header(mux, stream, packet->size);
+		da_push_back_array(mux->pes, packet->data, packet->size);
+	}
+
+	if (video)
+		stream_id = STREAM_ID_VIDEO;
+	else
+		stream_id = stream->opus ? STREAM_ID_PES : STREAM_ID_AUDIO;
+
+	array_output_serializer_init(&header_s, &header);
+	write_pes_header(&header_s, stream_id, pts, dts, mux->pes.num);
+
+	write_ts_packets(&s, stream, header.bytes.array, header.bytes.num,
+			mux->pes.array, mux->pes.num,
+			video && packet->keyframe, video,
+			(dts - PCR_DELAY) & TS_TIME_MASK);
+
+	array_output_serializer_free(&header);
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+#include <util/array-serializer.h>
+
+/*
+ * MPEG-TS muxing, for streaming over datagram protocols.  Every encoded
+ * packet becomes one PES packet split in to 188 byte TS packets, so the
+ * output can be cut at any TS packet boundary.  The program tables and the
+ * decoder configuration (SPS/PPS) are repeated before every video keyframe,
+ * so receivers can join at any keyframe.
+ */
+
+#define TS_PACKET_SIZE 188
+
+/* video is stream 0, followed by one stream per audio encoder */
+#define TS_MAX_STREAMS (1 + MAX_AUDIO_MIXES)
+
+struct ts_stream {
+	uint16_t                  pid;
+	uint8_t                   continuity;
+
+	/* annex-b SPS/PPS for video, ADTS header fields for AAC audio */
+	DARRAY(uint8_t)           config;
+	uint8_t                   aac_profile;
+	uint8_t                   aac_freq_idx;
+	uint8_t                   channels;
+
+	/* audio is AAC (as ADTS) unless the encoder is opus */
+	bool                      opus;
+};
+
+struct ts_mux {
+	struct ts_stream          streams[TS_MAX_STREAMS];
+	size_t                    num_streams;
+	uint8_t                   pat_continuity;
+	uint8_t                   pmt_continuity;
+	bool                      tables_written;
+
+	/* elementary stream data of the current packet, reused */
+	DARRAY(uint8_t)           pes;
+};
+
+extern void ts_mux_init(struct ts_mux *mux, obs_output_t *context);
+extern void ts_mux_free(struct ts_mux *mux);
+
+/* appends the TS packets of an encoded packet (AVCC for video) to the output,
+ * preceded by the program tables if needed */
+extern void ts_mux_packet(struct ts_mux *mux, struct encoder_packet *packet,
+		struct array_output_data *output);
@@ -0,0 +1,736 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/profiler.h>
+#include <inttypes.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#define SOCKET         int
+#define INVALID_SOCKET -1
+#define closesocket    close
+#endif
+#include "ts-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[udp stream: '%s'] " format, \
+			obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+#define debug(format, ...) do_log(LOG_DEBUG,   format, ##__VA_ARGS__)
+
+#define OPT_LATENCY         "latency_ms"
+#define OPT_DYNAMIC_BITRATE "dynamic_bitrate"
+
+/* 7 TS packets per datagram is the usual size, it fits in an ethernet MTU
+ * with room for IP and UDP (or RTP) headers */
+#define TS_PACKETS_PER_DATAGRAM 7
+#define DATAGRAM_SIZE           (TS_PACKETS_PER_DATAGRAM * TS_PACKET_SIZE)
+
+#define SENDBUF_SIZE            (1024 * 1024)
+
+/* datagrams are paced at a multiple of the stream bitrate, so keyframes go
+ * out slightly spread instead of as one burst that overflows the queues of
+ * routers (and receivers) on the way.  there is no retransmission, so every
+ * datagram lost that way is visible */
+#define PACING_RATE_FACTOR      2
+#define MAX_PACING_LAG_NS       50000000ULL
+
+struct udp_stream {
+	obs_output_t     *output;
+
+	pthread_mutex_t  packets_mutex;
+	struct circlebuf packets;
+
+	DARRAY(struct encoder_packet) send_packets;
+	struct array_output_data send_data;
+	struct ts_mux    mux;
+
+	bool             connecting;
+	pthread_t        connect_thread;
+
+	bool             active;
+	pthread_t        send_thread;
+
+	os_sem_t         *send_sem;
+	os_event_t       *stop_event;
+
+	struct dstr      path;
+	SOCKET           sock;
+
+	/* anything buffered for longer than the latency window is dropped,
+	 * there's no point in sending what the receiver will be too late to
+	 * play.  the same window is the reference for congestion */
+	int64_t          latency_usec;
+	int64_t          min_drop_dts_usec;
+	int              min_priority;
+
+	int64_t          last_dts_usec;
+	size_t           buffered_bytes;
+
+	bool             dynamic_bitrate;
+	float            congestion;
+
+	uint64_t         next_send_ns;
+	uint64_t         rate_window_start;
+	uint64_t         rate_window_bytes;
+	uint32_t         send_rate_kbps;
+
+	uint64_t         total_bytes_sent;
+	int              dropped_frames;
+};
+
+static const char *udp_stream_getname(void)
+{
+	return obs_module_text("UDPStream");
+}
+
+static inline void free_packets(struct udp_stream *stream)
+{
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+
+	stream->buffered_bytes = 0;
+}
+
+static inline void close_socket(struct udp_stream *stream)
+{
+	if (stream->sock != INVALID_SOCKET) {
+		closesocket(stream->sock);
+		stream->sock = INVALID_SOCKET;
+	}
+}
+
+static void udp_stream_stop(void *data);
+
+static void udp_stream_destroy(void *data)
+{
+	struct udp_stream *stream = data;
+
+	if (stream->active)
+		udp_stream_stop(data);
+
+	if (stream) {
+		free_packets(stream);
+		close_socket(stream);
+		dstr_free(&stream->path);
+		os_event_destroy(stream->stop_event);
+		os_sem_destroy(stream->send_sem);
+		pthread_mutex_destroy(&stream->packets_mutex);
+		circlebuf_free(&stream->packets);
+		da_free(stream->send_packets);
+		array_output_serializer_free(&stream->send_data);
+		bfree(stream);
+	}
+}
+
+static void *udp_stream_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct udp_stream *stream = bzalloc(sizeof(struct udp_stream));
+	stream->output = output;
+	stream->sock   = INVALID_SOCKET;
+	pthread_mutex_init_value(&stream->packets_mutex);
+
+	if (pthread_mutex_init(&stream->packets_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	udp_stream_destroy(stream);
+	return NULL;
+}
+
+static void udp_stream_stop(void *data)
+{
+	struct udp_stream *stream = data;
+	void *ret;
+
+	os_event_signal(stream->stop_event);
+
+	if (stream->connecting)
+		pthread_join(stream->connect_thread, &ret);
+
+	if (stream->active) {
+		obs_output_end_data_capture(stream->output);
+		os_sem_post(stream->send_sem);
+		pthread_join(stream->send_thread, &ret);
+		ts_mux_free(&stream->mux);
+		close_socket(stream);
+	}
+
+	os_event_reset(stream->stop_event);
+}
+
+static inline bool get_packet_batch(struct udp_stream *stream)
+{
+	size_t count;
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
+
+	count = stream->packets.size / sizeof(struct encoder_packet);
+	if (count) {
+		da_resize(stream->send_packets, count);
+		circlebuf_pop_front(&stream->packets,
+				stream->send_packets.array,
+				count * sizeof(struct encoder_packet));
+		stream->buffered_bytes = 0;
+	}
+
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	return count != 0;
+}
+
+static inline int encoder_bitrate_kbps(obs_encoder_t *encoder)
+{
+	obs_data_t *settings;
+	int        bitrate;
+
+	if (!encoder)
+		return 0;
+
+	settings = obs_encoder_get_settings(encoder);
+	bitrate = (int)obs_data_get_int(settings, "bitrate");
+	obs_data_release(settings);
+	return bitrate;
+}
+
+/* read every time, the video bitrate can change while streaming */
+static uint64_t get_stream_bytes_per_sec(struct udp_stream *stream)
+{
+	obs_output_t *context = stream->output;
+	int kbps = encoder_bitrate_kbps(obs_output_get_video_encoder(context)) +
+		encoder_bitrate_kbps(obs_output_get_audio_encoder(context, 0));
+
+	return kbps > 0 ? (uint64_t)kbps * 1000 / 8 : 0;
+}
+
+#define RATE_WINDOW_NS 1000000000ULL
+
+static void update_send_rate(struct udp_stream *stream, uint64_t now_ns,
+		size_t bytes)
+{
+	uint64_t elapsed;
+	uint64_t rate;
+
+	if (!stream->rate_window_start)
+		stream->rate_window_start = now_ns;
+
+	stream->rate_window_bytes += bytes;
+
+	elapsed = now_ns - stream->rate_window_start;
+	if (elapsed < RATE_WINDOW_NS)
+		return;
+
+	rate = stream->rate_window_bytes * 8 * 1000000ULL / elapsed;
+	stream->send_rate_kbps = rate > UINT32_MAX ?
+		UINT32_MAX : (uint32_t)rate;
+
+	stream->rate_window_start = now_ns;
+	stream->rate_window_bytes = 0;
+}
+
+/* datagrams can be lost without the sender ever knowing, so a failed send
+ * (no buffer space, or an ICMP error from a receiver that isn't listening
+ * yet) is not treated as a disconnect */
+static void send_datagram(struct udp_stream *stream, const uint8_t *data,
+		size_t size)
+{
+	if (send(stream->sock, (const char*)data, (int)size, 0) < 0)
+		return;
+
+	stream->total_bytes_sent += size;
+}
+
+static void send_batch(struct udp_stream *stream)
+{
+	struct array_output_data *data = &stream->send_data;
+	uint64_t bytes_per_sec = get_stream_bytes_per_sec(stream);
+	uint64_t datagram_ns   = bytes_per_sec ?
+		DATAGRAM_SIZE * 1000000000ULL /
+		(bytes_per_sec * PACING_RATE_FACTOR) : 0;
+	uint64_t now_ns;
+
+	da_resize(data->bytes, 0);
+
+	for (size_t i = 0; i < stream->send_packets.num; i++) {
+		struct encoder_packet *packet = stream->send_packets.array+i;
+
+		ts_mux_packet(&stream->mux, packet, data);
+		obs_encoder_packet_release(packet);
+	}
+
+	da_resize(stream->send_packets, 0);
+
+	/* don't try to catch up after falling far behind */
+	now_ns = os_gettime_ns();
+	if (stream->next_send_ns + MAX_PACING_LAG_NS < now_ns)
+		stream->next_send_ns = now_ns;
+
+	for (size_t pos = 0; pos < data->bytes.num; pos += DATAGRAM_SIZE) {
+		size_t size = data->bytes.num - pos;
+		if (size > DATAGRAM_SIZE)
+			size = DATAGRAM_SIZE;
+
+		if (stream->next_send_ns > now_ns)
+			os_sleepto_ns(stream->next_send_ns);
+
+		send_datagram(stream, data->bytes.array + pos, size);
+		stream->next_send_ns += datagram_ns;
+		now_ns = os_gettime_ns();
+	}
+
+	update_send_rate(stream, now_ns, data->bytes.num);
+}
+
+static void *send_thread(void *data)
+{
+	struct udp_stream *stream = data;
+
+	bmem_set_thread_tag(BMEM_TAG_OUTPUT);
+	os_set_thread_role(OS_THREAD_ROLE_NETWORK);
+
+	while (os_sem_wait(stream->send_sem) == 0) {
+		if (os_event_try(stream->stop_event) != EAGAIN)
+			break;
+
+		profile_start("udp_send_thread");
+		while (get_packet_batch(stream))
+			send_batch(stream);
+		profile_end("udp_send_thread");
+	}
+
+	while (get_packet_batch(stream))
+		send_batch(stream);
+
+	info("User stopped the stream");
+
+	stream->active = false;
+	return NULL;
+}
+
+static inline bool reset_semaphore(struct udp_stream *stream)
+{
+	os_sem_destroy(stream->send_sem);
+	return os_sem_init(&stream->send_sem, 0) == 0;
+}
+
+static int init_send(struct udp_stream *stream)
+{
+	int ret;
+
+	reset_semaphore(stream);
+	ts_mux_init(&stream->mux, stream->output);
+	stream->next_send_ns = 0;
+
+	ret = pthread_create(&stream->send_thread, NULL, send_thread, stream);
+	if (ret != 0) {
+		ts_mux_free(&stream->mux);
+		close_socket(stream);
+		warn("Failed to create send thread");
+		return OBS_OUTPUT_ERROR;
+	}
+
+	stream->active = true;
+	obs_output_begin_data_capture(stream->output, 0);
+
+	return OBS_OUTPUT_SUCCESS;
+}
+
+/* udp://host:port, the host can be an [ipv6] address */
+static bool parse_url(const char *url, struct dstr *host, struct dstr *port)
+{
+	const char *start;
+	const char *end;
+
+	if (astrcmpi_n(url, "udp://", 6) != 0)
+		return false;
+
+	start = url + 6;
+
+	if (*start == '[') {
+		end = strchr(++start, ']');
+		if (!end || end[1] != ':')
+			return false;
+
+		dstr_ncopy(host, start, end - start);
+		end++;
+	} else {
+		end = strrchr(start, ':');
+		if (!end)
+			return false;
+
+		dstr_ncopy(host, start, end - start);
+	}
+
+	dstr_copy(port, end + 1);
+	return !dstr_is_empty(host) && !dstr_is_empty(port);
+}
+
+static int connect_udp(struct udp_stream *stream)
+{
+	struct addrinfo hints = {0};
+	struct addrinfo *result;
+	struct addrinfo *ai;
+	struct dstr     host = {0};
+	struct dstr     port = {0};
+	int             sndbuf = SENDBUF_SIZE;
+	int             ret;
+
+	if (!parse_url(stream->path.array, &host, &port)) {
+		dstr_free(&host);
+		dstr_free(&port);
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+
+	ret = getaddrinfo(host.array, port.array, &hints, &result);
+	dstr_free(&host);
+	dstr_free(&port);
+
+	if (ret != 0)
+		return OBS_OUTPUT_BAD_PATH;
+
+	/* connecting a datagram socket only sets the default destination */
+	for (ai = result; ai; ai = ai->ai_next) {
+		stream->sock = socket(ai->ai_family, ai->ai_socktype,
+				ai->ai_protocol);
+		if (stream->sock == INVALID_SOCKET)
+			continue;
+
+		if (connect(stream->sock, ai->ai_addr,
+					(int)ai->ai_addrlen) == 0)
+			break;
+
+		close_socket(stream);
+	}
+
+	freeaddrinfo(result);
+
+	if (stream->sock == INVALID_SOCKET)
+		return OBS_OUTPUT_CONNECT_FAILED;
+
+	setsockopt(stream->sock, SOL_SOCKET, SO_SNDBUF, (const char*)&sndbuf,
+			sizeof(sndbuf));
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static int try_connect(struct udp_stream *stream)
+{
+	int ret;
+
+	if (dstr_is_empty(&stream->path)) {
+		warn("URL is empty");
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	info("Sending to %s...", stream->path.array);
+
+	ret = connect_udp(stream);
+	if (ret != OBS_OUTPUT_SUCCESS)
+		return ret;
+
+	return init_send(stream);
+}
+
+static void *connect_thread(void *data)
+{
+	struct udp_stream *stream = data;
+	int ret;
+
+	bmem_set_thread_tag(BMEM_TAG_OUTPUT);
+	ret = try_connect(stream);
+
+	if (ret != OBS_OUTPUT_SUCCESS) {
+		obs_output_signal_stop(stream->output, ret);
+		info("Connection to %s failed: %d", stream->path.array, ret);
+	}
+
+	if (os_event_try(stream->stop_event) == EAGAIN)
+		pthread_detach(stream->connect_thread);
+
+	stream->connecting = false;
+	return NULL;
+}
+
+static bool udp_stream_start(void *data)
+{
+	struct udp_stream *stream = data;
+	obs_service_t *service = obs_output_get_service(stream->output);
+	obs_data_t *settings;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	stream->total_bytes_sent  = 0;
+	stream->dropped_frames    = 0;
+	stream->buffered_bytes    = 0;
+	stream->min_priority      = 0;
+	stream->min_drop_dts_usec = 0;
+	stream->rate_window_start = 0;
+	stream->rate_window_bytes = 0;
+	stream->send_rate_kbps    = 0;
+	stream->congestion        = 0.0f;
+
+	settings = obs_output_get_settings(stream->output);
+	dstr_copy(&stream->path, obs_service_get_url(service));
+	stream->latency_usec =
+		(int64_t)obs_data_get_int(settings, OPT_LATENCY) * 1000;
+	stream->dynamic_bitrate =
+		obs_data_get_bool(settings, OPT_DYNAMIC_BITRATE);
+	obs_data_release(settings);
+
+	stream->connecting = true;
+	return pthread_create(&stream->connect_thread, NULL, connect_thread,
+			stream) == 0;
+}
+
+static inline bool add_packet(struct udp_stream *stream,
+		struct encoder_packet *packet)
+{
+	circlebuf_push_back(&stream->packets, packet,
+			sizeof(struct encoder_packet));
+	stream->last_dts_usec   = packet->dts_usec;
+	stream->buffered_bytes += packet->size;
+	return true;
+}
+
+static inline size_t num_buffered_packets(struct udp_stream *stream)
+{
+	return stream->packets.size / sizeof(struct encoder_packet);
+}
+
+/* drops buffered video packets with a priority of max_priority or lower */
+static void drop_frames(struct udp_stream *stream, int max_priority)
+{
+	struct circlebuf new_buf            = {0};
+	int              drop_priority      = 0;
+	uint64_t         last_drop_dts_usec = 0;
+	int              num_frames_dropped = 0;
+
+	circlebuf_reserve(&new_buf, sizeof(struct encoder_packet) * 8);
+
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+
+		last_drop_dts_usec = packet.dts_usec;
+
+		if (packet.type == OBS_ENCODER_AUDIO ||
+		    packet.priority > max_priority) {
+			circlebuf_push_back(&new_buf, &packet, sizeof(packet));
+
+		} else {
+			if (drop_priority < packet.drop_priority)
+				drop_priority = packet.drop_priority;
+
+			stream->buffered_bytes -= packet.size;
+			num_frames_dropped++;
+			obs_encoder_packet_release(&packet);
+		}
+	}
+
+	circlebuf_free(&stream->packets);
+	stream->packets           = new_buf;
+	stream->min_priority      = drop_priority;
+	stream->min_drop_dts_usec = last_drop_dts_usec;
+
+	stream->dropped_frames += num_frames_dropped;
+	debug("Dropped %d frames", num_frames_dropped);
+}
+
+/* packets are only buffered while the send thread is pacing (or the socket
+ * buffer is full), so unlike with RTMP this is the local backlog rather than
+ * the state of the network.  it still rises as soon as the stream bitrate
+ * exceeds what the pacer lets out */
+static void check_to_drop_frames(struct udp_stream *stream)
+{
+	struct encoder_packet first;
+	int64_t buffer_duration_usec;
+
+	if (num_buffered_packets(stream) < 5) {
+		stream->congestion = 0.0f;
+		return;
+	}
+
+	circlebuf_peek_front(&stream->packets, &first, sizeof(first));
+
+	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	stream->congestion = stream->latency_usec ?
+		(float)buffer_duration_usec /
+		(float)stream->latency_usec : 0.0f;
+
+	if (first.dts_usec < stream->min_drop_dts_usec)
+		return;
+	if (buffer_duration_usec <= stream->latency_usec)
+		return;
+
+	debug("buffered %" PRId64 " worth of frames", buffer_duration_usec);
+
+	/* drop non-reference frames first, everything if the backlog keeps
+	 * growing regardless */
+	drop_frames(stream, buffer_duration_usec > stream->latency_usec * 2 ?
+			OBS_NAL_PRIORITY_HIGHEST :
+			OBS_NAL_PRIORITY_DISPOSABLE);
+}
+
+static bool add_video_packet(struct udp_stream *stream,
+		struct encoder_packet *packet)
+{
+	check_to_drop_frames(stream);
+
+	/* if currently dropping frames, drop packets until it reaches the
+	 * desired priority */
+	if (packet->priority < stream->min_priority) {
+		stream->dropped_frames++;
+		return false;
+	} else {
+		stream->min_priority = 0;
+	}
+
+	return add_packet(stream, packet);
+}
+
+static void udp_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct udp_stream     *stream = data;
+	struct encoder_packet new_packet;
+	bool                  added_packet;
+	bool                  was_empty;
+	float                 congestion;
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		obs_parse_avc_packet(&new_packet, packet);
+	else
+		obs_encoder_packet_ref(&new_packet, packet);
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
+
+	was_empty = stream->packets.size == 0;
+	added_packet = (packet->type == OBS_ENCODER_VIDEO) ?
+		add_video_packet(stream, &new_packet) :
+		add_packet(stream, &new_packet);
+
+	/* the send thread drains the whole queue each time it wakes up */
+	if (added_packet && was_empty)
+		os_sem_post(stream->send_sem);
+
+	congestion = stream->congestion;
+
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	if (!added_packet)
+		obs_encoder_packet_release(&new_packet);
+
+	if (stream->dynamic_bitrate && packet->type == OBS_ENCODER_VIDEO)
+		obs_output_report_congestion(stream->output, congestion);
+}
+
+static void udp_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_LATENCY, 400);
+	obs_data_set_default_bool(defaults, OPT_DYNAMIC_BITRATE, false);
+}
+
+static obs_properties_t *udp_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_int(props, OPT_LATENCY,
+			obs_module_text("UDPStream.Latency"),
+			20, 5000, 10);
+	obs_properties_add_bool(props, OPT_DYNAMIC_BITRATE,
+			obs_module_text("UDPStream.DynamicBitrate"));
+	return props;
+}
+
+static uint64_t udp_stream_total_bytes_sent(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->total_bytes_sent;
+}
+
+static int udp_stream_dropped_frames(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->dropped_frames;
+}
+
+static uint32_t udp_stream_send_rate(void *data)
+{
+	struct udp_stream *stream = data;
+	return stream->send_rate_kbps;
+}
+
+static size_t udp_stream_queued_packets(void *data)
+{
+	struct udp_stream *stream = data;
+	size_t num;
+
+	os_mutex_lock(&stream->packets_mutex, "packets_mutex");
+	num = num_buffered_packets(stream);
+	os_mutex_unlock(&stream->packets_mutex, "packets_mutex");
+
+	return num;
+}
+
+struct obs_output_info udp_output_info = {
+	.id                 = "udp_output",
+	.flags              = OBS_OUTPUT_AV |
+	                      OBS_OUTPUT_ENCODED |
+	                      OBS_OUTPUT_SERVICE,
+	.get_name           = udp_stream_getname,
+	.create             = udp_stream_create,
+	.destroy            = udp_stream_destroy,
+	.start              = udp_stream_start,
+	.stop               = udp_stream_stop,
+	.encoded_packet     = udp_stream_data,
+	.get_defaults       = udp_stream_defaults,
+	.get_properties     = udp_stream_properties,
+	.get_total_bytes    = udp_stream_total_bytes_sent,
+	.get_dropped_frames = udp_stream_dropped_frames,
+	.get_send_rate      = udp_stream_send_rate,
+	.get_queued_packets = udp_stream_queued_packets
+};
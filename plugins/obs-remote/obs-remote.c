@@ -0,0 +1,438 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <stdlib.h>
+#include "remote-server.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+OBS_DECLARE_MODULE()
+
+/*
+ * Remote control and statistics over a local socket.
+ *
+ * Clients send one JSON request per line and get one JSON response per line.
+ * Requests have a "request" name and an optional "id" that is copied in to
+ * the response:
+ *
+ *   {"request": "get_scenes"}
+ *   {"request": "set_scene", "name": "Scene 2"}
+ *   {"request": "get_stats"}
+ *   {"request": "call", "proc": "name", "params": {...}}
+ *
+ * "call" calls a procedure of the core procedure handler, with the given
+ * string/number/bool parameters.
+ *
+ * Events are pushed to every client as they happen, with an "event" name
+ * (scene_changed, source_renamed, source_added, source_removed).  The
+ * statistics are checked once a second and pushed as a "stats" event only
+ * when they change, so monitoring doesn't require polling.
+ *
+ * The server listens on 127.0.0.1 port OBS_REMOTE_PORT (default 4444), or on
+ * the unix socket at OBS_REMOTE_SOCKET when set.  Setting OBS_REMOTE_PORT to
+ * 0 disables it.
+ */
+
+#define DEFAULT_PORT        4444
+#define STATS_INTERVAL_NS   1000000000ULL
+
+struct obs_remote {
+	struct remote_server *server;
+	os_cpu_usage_info_t  *cpu_info;
+
+	/* server thread only */
+	uint64_t             last_stats_time;
+	char                 *last_stats;
+};
+
+static struct obs_remote remote = {0};
+
+static void send_data(struct remote_client *client, obs_data_t *data)
+{
+	struct dstr line = {0};
+
+	/* one message per line */
+	dstr_copy(&line, obs_data_get_json(data));
+	dstr_replace(&line, "\n", "");
+
+	if (client)
+		remote_server_send(client, line.array);
+	else
+		remote_server_broadcast(remote.server, line.array);
+
+	dstr_free(&line);
+}
+
+static void send_event(obs_data_t *event, const char *name)
+{
+	obs_data_set_string(event, "event", name);
+	send_data(NULL, event);
+}
+
+/* ------------------------------------------------------------------------- */
+/* statistics */
+
+struct stats_info {
+	obs_data_array_t *outputs;
+	bool             full;
+};
+
+static bool add_output_stats(void *param, obs_output_t *output)
+{
+	struct stats_info *info = param;
+	obs_data_t *data = obs_data_create();
+
+	obs_data_set_string(data, "name", obs_output_get_name(output));
+	obs_data_set_bool(data, "active", obs_output_active(output));
+	obs_data_set_int(data, "frames_dropped",
+			obs_output_get_frames_dropped(output));
+
+	/* totals change constantly, so they're only sent on request */
+	if (info->full) {
+		obs_data_set_int(data, "total_frames",
+				obs_output_get_total_frames(output));
+		obs_data_set_int(data, "total_bytes",
+				(long long)obs_output_get_total_bytes(output));
+	}
+
+	obs_data_array_push_back(info->outputs, data);
+	obs_data_release(data);
+	return true;
+}
+
+static obs_data_t *get_stats(bool full)
+{
+	struct stats_info info = {obs_data_array_create(), full};
+	obs_data_t *stats = obs_data_create();
+	video_t *video = obs_get_video();
+	double cpu_usage = os_cpu_usage_info_query(remote.cpu_info);
+
+	/* whole percents, or every push would be a change */
+	obs_data_set_int(stats, "cpu_usage", (long long)(cpu_usage + 0.5));
+
+	if (video) {
+		obs_data_set_int(stats, "skipped_frames",
+				video_output_get_skipped_frames(video));
+		if (full)
+			obs_data_set_int(stats, "total_frames",
+					video_output_get_total_frames(video));
+	}
+
+	obs_enum_outputs(add_output_stats, &info);
+	obs_data_set_array(stats, "outputs", info.outputs);
+	obs_data_array_release(info.outputs);
+
+	return stats;
+}
+
+static void remote_tick(void *param)
+{
+	uint64_t now = os_gettime_ns();
+	obs_data_t *stats;
+	const char *json;
+
+	if (now - remote.last_stats_time < STATS_INTERVAL_NS)
+		return;
+
+	remote.last_stats_time = now;
+
+	stats = get_stats(false);
+	json = obs_data_get_json(stats);
+
+	if (!remote.last_stats || strcmp(json, remote.last_stats) != 0) {
+		bfree(remote.last_stats);
+		remote.last_stats = bstrdup(json);
+		send_event(stats, "stats");
+	}
+
+	obs_data_release(stats);
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* requests */
+
+static inline bool is_scene(obs_source_t *source)
+{
+	return obs_scene_from_source(source) != NULL;
+}
+
+static bool add_scene(void *param, obs_source_t *source)
+{
+	obs_data_array_t *scenes = param;
+
+	if (is_scene(source)) {
+		obs_data_t *scene = obs_data_create();
+		obs_data_set_string(scene, "name", obs_source_get_name(source));
+		obs_data_array_push_back(scenes, scene);
+		obs_data_release(scene);
+	}
+
+	return true;
+}
+
+static const char *get_scenes(obs_data_t *request, obs_data_t *response)
+{
+	obs_data_array_t *scenes = obs_data_array_create();
+	obs_source_t *current = obs_get_output_source(0);
+
+	obs_enum_sources(add_scene, scenes);
+	obs_data_set_array(response, "scenes", scenes);
+	obs_data_set_string(response, "current_scene",
+			current ? obs_source_get_name(current) : "");
+
+	obs_source_release(current);
+	obs_data_array_release(scenes);
+
+	UNUSED_PARAMETER(request);
+	return NULL;
+}
+
+static const char *set_scene(obs_data_t *request, obs_data_t *response)
+{
+	const char *name = obs_data_get_string(request, "name");
+	obs_source_t *source = obs_get_source_by_name(name);
+	const char *error = NULL;
+
+	if (!source)
+		error = "scene not found";
+	else if (!is_scene(source))
+		error = "source is not a scene";
+	else
+		obs_set_output_source(0, source);
+
+	obs_source_release(source);
+
+	UNUSED_PARAMETER(response);
+	return error;
+}
+
+static const char *get_stats_request(obs_data_t *request,
+		obs_data_t *response)
+{
+	obs_data_t *stats = get_stats(true);
+
+	obs_data_set_obj(response, "stats", stats);
+	obs_data_release(stats);
+
+	UNUSED_PARAMETER(request);
+	return NULL;
+}
+
+static void set_call_params(calldata_t *cd, obs_data_t *params)
+{
+	obs_data_item_t *item = obs_data_first(params);
+
+	for (; item; obs_data_item_next(&item)) {
+		const char *name = obs_data_item_get_name(item);
+
+		switch (obs_data_item_gettype(item)) {
+		case OBS_DATA_STRING:
+			calldata_set_string(cd, name,
+					obs_data_item_get_string(item));
+			break;
+		case OBS_DATA_NUMBER:
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_DOUBLE)
+				calldata_set_float(cd, name, (double)
+						obs_data_item_get_double(item));
+			else
+				calldata_set_int(cd, name,
+						obs_data_item_get_int(item));
+			break;
+		case OBS_DATA_BOOLEAN:
+			calldata_set_bool(cd, name,
+					obs_data_item_get_bool(item));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static const char *call_proc(obs_data_t *request, obs_data_t *response)
+{
+	obs_data_t *params = obs_data_get_obj(request, "params");
+	calldata_t cd = {0};
+	bool found;
+
+	set_call_params(&cd, params);
+	found = proc_handler_call(obs_get_proc_handler(),
+			obs_data_get_string(request, "proc"), &cd);
+
+	calldata_free(&cd);
+	obs_data_release(params);
+
+	UNUSED_PARAMETER(response);
+	return found ? NULL : "procedure not found";
+}
+
+struct request_handler {
+	const char *name;
+	const char *(*handle)(obs_data_t *request, obs_data_t *response);
+};
+
+static const struct request_handler request_handlers[] = {
+	{"get_scenes", get_scenes},
+	{"set_scene",  set_scene},
+	{"get_stats",  get_stats_request},
+	{"call",       call_proc},
+	{NULL,         NULL}
+};
+
+static void copy_id(obs_data_t *request, obs_data_t *response)
+{
+	obs_data_item_t *id = obs_data_item_byname(request, "id");
+
+	if (!id)
+		return;
+
+	if (obs_data_item_gettype(id) == OBS_DATA_STRING)
+		obs_data_set_string(response, "id",
+				obs_data_item_get_string(id));
+	else if (obs_data_item_gettype(id) == OBS_DATA_NUMBER)
+		obs_data_set_int(response, "id", obs_data_item_get_int(id));
+
+	obs_data_item_release(&id);
+}
+
+static void remote_request(void *param, struct remote_client *client,
+		const char *line)
+{
+	obs_data_t *request = obs_data_create_from_json(line);
+	obs_data_t *response = obs_data_create();
+	const char *error = "unknown request";
+	const char *name;
+
+	if (!request) {
+		error = "invalid JSON";
+		goto send;
+	}
+
+	copy_id(request, response);
+	name = obs_data_get_string(request, "request");
+
+	for (const struct request_handler *h = request_handlers; h->name; h++) {
+		if (strcmp(h->name, name) == 0) {
+			error = h->handle(request, response);
+			break;
+		}
+	}
+
+send:
+	obs_data_set_string(response, "status", error ? "error" : "ok");
+	if (error)
+		obs_data_set_string(response, "error", error);
+
+	send_data(client, response);
+
+	obs_data_release(response);
+	obs_data_release(request);
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* events, called from whichever thread emits the signal */
+
+static void channel_changed(void *param, calldata_t *cd)
+{
+	obs_source_t *source = calldata_ptr(cd, "source");
+	obs_data_t *event;
+
+	if (calldata_int(cd, "channel") != 0)
+		return;
+
+	event = obs_data_create();
+	obs_data_set_string(event, "name",
+			source ? obs_source_get_name(source) : "");
+	send_event(event, "scene_changed");
+	obs_data_release(event);
+
+	UNUSED_PARAMETER(param);
+}
+
+static void source_renamed(void *param, calldata_t *cd)
+{
+	obs_data_t *event = obs_data_create();
+
+	obs_data_set_string(event, "name", calldata_string(cd, "new_name"));
+	obs_data_set_string(event, "prev_name",
+			calldata_string(cd, "prev_name"));
+	send_event(event, "source_renamed");
+	obs_data_release(event);
+
+	UNUSED_PARAMETER(param);
+}
+
+static void source_added_removed(void *param, calldata_t *cd)
+{
+	obs_source_t *source = calldata_ptr(cd, "source");
+	obs_data_t *event = obs_data_create();
+
+	obs_data_set_string(event, "name", obs_source_get_name(source));
+	obs_data_set_bool(event, "scene", is_scene(source));
+	send_event(event, param ? "source_added" : "source_removed");
+	obs_data_release(event);
+}
+
+static void connect_signals(bool connect)
+{
+	signal_handler_t *handler = obs_get_signal_handler();
+	void (*func)(signal_handler_t*, const char*, signal_callback_t, void*);
+
+	func = connect ? signal_handler_connect : signal_handler_disconnect;
+
+	func(handler, "channel_change", channel_changed, NULL);
+	func(handler, "source_rename", source_renamed, NULL);
+	func(handler, "source_add", source_added_removed, (void*)1);
+	func(handler, "source_remove", source_added_removed, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_module_load(void)
+{
+	const char *port_str = getenv("OBS_REMOTE_PORT");
+	const char *path = getenv("OBS_REMOTE_SOCKET");
+	int port = port_str ? atoi(port_str) : DEFAULT_PORT;
+
+	if (port <= 0 && !(path && *path)) {
+		blog(LOG_INFO, "[obs-remote] disabled");
+		return true;
+	}
+
+#ifdef _WIN32
+	WSADATA wsad;
+	WSAStartup(MAKEWORD(2, 2), &wsad);
+#endif
+
+	remote.cpu_info = os_cpu_usage_info_start();
+	remote.server = remote_server_create(port, path, remote_request,
+			remote_tick, NULL);
+
+	if (remote.server)
+		connect_signals(true);
+	return true;
+}
+
+void obs_module_unload(void)
+{
+	if (remote.server) {
+		connect_signals(false);
+		remote_server_destroy(remote.server);
+		remote.server = NULL;
+	}
+
+	if (remote.cpu_info) {
+		os_cpu_usage_info_destroy(remote.cpu_info);
+		remote.cpu_info = NULL;
+
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	bfree(remote.last_stats);
+	remote.last_stats = NULL;
+}
@@ -0,0 +1,428 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include "remote-server.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int SOCKET;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+/* don't get killed by SIGPIPE when a client goes away */
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define do_log(level, format, ...) \
+	blog(level, "[obs-remote] " format, ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+#define MAX_CLIENTS       16
+#define MAX_LINE_SIZE     (64 * 1024)
+#define MAX_PENDING_SIZE  (1024 * 1024)
+
+struct remote_client {
+	SOCKET           sock;
+	struct dstr      line;
+	struct circlebuf pending;
+	bool             closed;
+};
+
+struct remote_server {
+	SOCKET                        listen_sock;
+	struct dstr                   path;
+
+	remote_request_cb             request;
+	remote_tick_cb                tick;
+	void                          *param;
+
+	/* server thread only */
+	DARRAY(struct remote_client*) clients;
+
+	/* messages broadcast from other threads, sent on the server thread */
+	pthread_mutex_t               broadcast_mutex;
+	struct dstr                   broadcast;
+
+	pthread_t                     thread;
+	bool                          thread_created;
+	volatile bool                 stop;
+};
+
+static inline void set_nonblocking(SOCKET sock)
+{
+#ifdef _WIN32
+	u_long nonblocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static inline bool would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void client_destroy(struct remote_client *client)
+{
+	closesocket(client->sock);
+	dstr_free(&client->line);
+	circlebuf_free(&client->pending);
+	bfree(client);
+}
+
+static void client_flush(struct remote_client *client)
+{
+	uint8_t buf[4096];
+
+	while (client->pending.size && !client->closed) {
+		size_t size = client->pending.size < sizeof(buf) ?
+			client->pending.size : sizeof(buf);
+		int ret;
+
+		circlebuf_peek_front(&client->pending, buf, size);
+
+		ret = send(client->sock, (const char*)buf, (int)size,
+				SEND_FLAGS);
+		if (ret < 0) {
+			if (!would_block())
+				client->closed = true;
+			break;
+		}
+
+		circlebuf_pop_front(&client->pending, NULL, (size_t)ret);
+	}
+}
+
+void remote_server_send(struct remote_client *client, const char *msg)
+{
+	size_t len = strlen(msg);
+
+	if (client->closed)
+		return;
+
+	/* a client that doesn't read what it's sent is dropped instead of
+	 * buffering without limit */
+	if (client->pending.size + len + 1 > MAX_PENDING_SIZE) {
+		warn("client is not reading, disconnecting it");
+		client->closed = true;
+		return;
+	}
+
+	circlebuf_push_back(&client->pending, msg, len);
+	circlebuf_push_back(&client->pending, "\n", 1);
+	client_flush(client);
+}
+
+static void client_receive(struct remote_server *server,
+		struct remote_client *client)
+{
+	char buf[4096];
+	int  ret;
+
+	ret = recv(client->sock, buf, sizeof(buf), 0);
+	if (ret == 0 || (ret < 0 && !would_block())) {
+		client->closed = true;
+		return;
+	}
+	if (ret < 0)
+		return;
+
+	for (int i = 0; i < ret && !client->closed; i++) {
+		if (buf[i] == '\n') {
+			if (client->line.len)
+				server->request(server->param, client,
+						client->line.array);
+			dstr_resize(&client->line, 0);
+
+		} else if (buf[i] != '\r') {
+			if (client->line.len >= MAX_LINE_SIZE) {
+				warn("request too long, disconnecting "
+				     "client");
+				client->closed = true;
+				break;
+			}
+
+			dstr_ncat(&client->line, buf + i, 1);
+		}
+	}
+}
+
+static void accept_client(struct remote_server *server)
+{
+	struct remote_client *client;
+	SOCKET sock = accept(server->listen_sock, NULL, NULL);
+
+	if (sock == INVALID_SOCKET)
+		return;
+
+	if (server->clients.num >= MAX_CLIENTS) {
+		warn("too many clients, refusing connection");
+		closesocket(sock);
+		return;
+	}
+
+	set_nonblocking(sock);
+
+	client = bzalloc(sizeof(struct remote_client));
+	client->sock = sock;
+	da_push_back(server->clients, &client);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void remote_server_broadcast(struct remote_server *server, const char *msg)
+{
+	pthread_mutex_lock(&server->broadcast_mutex);
+	dstr_cat(&server->broadcast, msg);
+	dstr_cat(&server->broadcast, "\n");
+	pthread_mutex_unlock(&server->broadcast_mutex);
+}
+
+static void send_broadcasts(struct remote_server *server)
+{
+	struct dstr msgs;
+	char *line;
+
+	pthread_mutex_lock(&server->broadcast_mutex);
+	msgs = server->broadcast;
+	dstr_init(&server->broadcast);
+	pthread_mutex_unlock(&server->broadcast_mutex);
+
+	line = msgs.array;
+	while (line && *line) {
+		char *end = strchr(line, '\n');
+		*end = 0;
+
+		for (size_t i = 0; i < server->clients.num; i++)
+			remote_server_send(server->clients.array[i], line);
+
+		line = end + 1;
+	}
+
+	dstr_free(&msgs);
+}
+
+static void remove_closed_clients(struct remote_server *server)
+{
+	for (size_t i = server->clients.num; i > 0; i--) {
+		struct remote_client *client = server->clients.array[i - 1];
+
+		if (client->closed) {
+			client_destroy(client);
+			da_erase(server->clients, i - 1);
+		}
+	}
+}
+
+static void *server_thread(void *data)
+{
+	struct remote_server *server = data;
+	uint64_t next_tick = os_gettime_ns();
+
+	while (!server->stop) {
+		struct timeval tv = {0, REMOTE_TICK_INTERVAL_MS * 1000};
+		fd_set read_fds, write_fds;
+		SOCKET max_sock = server->listen_sock;
+		uint64_t now;
+
+		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
+		FD_SET(server->listen_sock, &read_fds);
+
+		for (size_t i = 0; i < server->clients.num; i++) {
+			struct remote_client *client =
+				server->clients.array[i];
+
+			FD_SET(client->sock, &read_fds);
+			if (client->pending.size)
+				FD_SET(client->sock, &write_fds);
+			if (client->sock > max_sock)
+				max_sock = client->sock;
+		}
+
+		if (select((int)max_sock + 1, &read_fds, &write_fds, NULL,
+					&tv) > 0) {
+			if (FD_ISSET(server->listen_sock, &read_fds))
+				accept_client(server);
+
+			for (size_t i = 0; i < server->clients.num; i++) {
+				struct remote_client *client =
+					server->clients.array[i];
+
+				if (FD_ISSET(client->sock, &write_fds))
+					client_flush(client);
+				if (FD_ISSET(client->sock, &read_fds))
+					client_receive(server, client);
+			}
+		}
+
+		now = os_gettime_ns();
+		if (now >= next_tick) {
+			server->tick(server->param);
+			next_tick = now +
+				REMOTE_TICK_INTERVAL_MS * 1000000ULL;
+		}
+
+		send_broadcasts(server);
+		remove_closed_clients(server);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static SOCKET listen_tcp(int port)
+{
+	struct sockaddr_in addr = {0};
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int reuse = 1;
+
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse,
+			sizeof(reuse));
+
+	/* local connections only */
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		warn("failed to bind to port %d", port);
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	info("listening on 127.0.0.1:%d", port);
+	return sock;
+}
+
+#ifndef _WIN32
+static SOCKET listen_unix(const char *path)
+{
+	struct sockaddr_un addr = {0};
+	SOCKET sock;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		warn("socket path '%s' is too long", path);
+		return INVALID_SOCKET;
+	}
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		warn("failed to bind to '%s': %d", path, errno);
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	info("listening on '%s'", path);
+	return sock;
+}
+#endif
+
+struct remote_server *remote_server_create(int port, const char *path,
+		remote_request_cb request, remote_tick_cb tick, void *param)
+{
+	struct remote_server *server = bzalloc(sizeof(struct remote_server));
+
+	server->listen_sock = INVALID_SOCKET;
+	server->request     = request;
+	server->tick        = tick;
+	server->param       = param;
+	pthread_mutex_init_value(&server->broadcast_mutex);
+
+	if (pthread_mutex_init(&server->broadcast_mutex, NULL) != 0)
+		goto fail;
+
+#ifndef _WIN32
+	if (path && *path) {
+		server->listen_sock = listen_unix(path);
+		dstr_copy(&server->path, path);
+	} else
+#endif
+	{
+		server->listen_sock = listen_tcp(port);
+	}
+
+	UNUSED_PARAMETER(path);
+
+	if (server->listen_sock == INVALID_SOCKET)
+		goto fail;
+	if (listen(server->listen_sock, MAX_CLIENTS) != 0)
+		goto fail;
+
+	set_nonblocking(server->listen_sock);
+
+	if (pthread_create(&server->thread, NULL, server_thread, server) != 0)
+		goto fail;
+
+	server->thread_created = true;
+	return server;
+
+fail:
+	remote_server_destroy(server);
+	return NULL;
+}
+
+void remote_server_destroy(struct remote_server *server)
+{
+	if (!server)
+		return;
+
+	if (server->thread_created) {
+		server->stop = true;
+		pthread_join(server->thread, NULL);
+	}
+
+	for (size_t i = 0; i < server->clients.num; i++)
+		client_destroy(server->clients.array[i]);
+	da_free(server->clients);
+
+	if (server->listen_sock != INVALID_SOCKET)
+		closesocket(server->listen_sock);
+#ifndef _WIN32
+	if (server->path.len)
+		unlink(server->path.array);
+#endif
+
+	pthread_mutex_destroy(&server->broadcast_mutex);
+	dstr_free(&server->broadcast);
+	dstr_free(&server->path);
+	bfree(server);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Line based local socket server.  Each line a client sends is handed to the
+ * request callback; messages are sent back one per line.  Everything except
+ * remote_server_broadcast happens on the server thread.
+ */
+
+struct remote_server;
+struct remote_client;
+
+typedef void (*remote_request_cb)(void *param, struct remote_client *client,
+		const char *line);
+typedef void (*remote_tick_cb)(void *param);
+
+/**
+ * Listens on 127.0.0.1 at port, or on the unix socket at path if path is
+ * set (not supported on Windows).  tick is called on the server thread
+ * about every TICK_INTERVAL_MS.
+ */
+extern struct remote_server *remote_server_create(int port, const char *path,
+		remote_request_cb request, remote_tick_cb tick, void *param);
+extern void remote_server_destroy(struct remote_server *server);
+
+/** Sends a message to one client, server thread only */
+extern void remote_server_send(struct remote_client *client, const char *msg);
+
+/** Sends a message to every client, from any thread */
+extern void remote_server_broadcast(struct remote_server *server,
+		const char *msg);
+
+#define REMOTE_TICK_INTERVAL_MS 250
@@ -19,6 +19,8 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <util/circlebuf.h>
 #include <obs-module.h>
 
 #ifndef _STDINT_H_INCLUDED
@@ -37,14 +39,35 @@
 
 /* ------------------------------------------------------------------------- */
 
+/* number of frames that can be queued for the submission thread before
+ * obs_x264_encode has to wait for x264 to catch up */
+#define SUBMIT_QUEUE_SIZE 3
+
+/* with automatic preset adjustment, the preset is lowered when the average
+ * encode time goes above LOAD_HIGH percent of the frame time, and raised
+ * again when it drops below LOAD_LOW percent */
+#define LOAD_HIGH         90
+#define LOAD_LOW          50
+
+/* number of load checks to skip after changing the preset so that the new
+ * preset is measured on its own */
+#define LOAD_COOLDOWN     2
+
+struct submit_frame {
+	uint8_t                *data;
+	size_t                 size;
+	uint8_t                *planes[MAX_AV_PLANES];
+	uint32_t               linesize[MAX_AV_PLANES];
+	int64_t                pts;
+	bool                   keyframe;
+};
+
 struct obs_x264 {
 	obs_encoder_t          *encoder;
 
 	x264_param_t           params;
 	x264_t                 *context;
 
-	DARRAY(uint8_t)        packet_data;
-
 	uint8_t                *extra_data;
 	uint8_t                *sei;
 
@@ -55,6 +78,42 @@ struct obs_x264 {
 
 	enum video_colorspace  colorspace;
 	enum video_range_type  range;
+
+	/* makes the next submitted frame an IDR frame */
+	bool                   force_keyframe;
+
+	/* with threaded submission, frames are copied in to a bounded queue
+	 * and encoded on a separate thread so that x264 doesn't hold up the
+	 * video output thread, and finished packets are handed back on the
+	 * next call to obs_x264_encode */
+	bool                   threaded;
+	bool                   thread_active;
+	pthread_t              submit_thread;
+	pthread_mutex_t        encode_mutex;
+	pthread_mutex_t        output_mutex;
+	os_sem_t               *input_sem;
+	os_sem_t               *space_sem;
+	volatile bool          stop;
+	volatile bool          encode_failed;
+
+	struct submit_frame    frames[SUBMIT_QUEUE_SIZE];
+	size_t                 write_idx;
+	size_t                 read_idx;
+
+	struct circlebuf       output_packets;
+
+	/* automatic preset adjustment, updated from whichever thread calls
+	 * x264_encoder_encode.  the load is checked about once a second */
+	bool                   auto_preset;
+	char                   *tune;
+	int                    base_preset;
+	int                    cur_preset;
+	int                    base_refs;
+	uint64_t               frame_ns;
+	uint64_t               encode_ns;
+	uint32_t               load_frames;
+	uint32_t               load_interval;
+	uint32_t               cooldown;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -66,6 +125,36 @@ static const char *obs_x264_getname(void)
 
 static void obs_x264_stop(void *data);
 
+static void stop_submit_thread(struct obs_x264 *obsx264)
+{
+	if (!obsx264->threaded)
+		return;
+
+	if (obsx264->thread_active) {
+		obsx264->stop = true;
+		os_sem_post(obsx264->input_sem);
+		pthread_join(obsx264->submit_thread, NULL);
+		obsx264->thread_active = false;
+	}
+
+	while (obsx264->output_packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&obsx264->output_packets, &packet,
+				sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+
+	for (size_t i = 0; i < SUBMIT_QUEUE_SIZE; i++)
+		bfree(obsx264->frames[i].data);
+
+	circlebuf_free(&obsx264->output_packets);
+	os_sem_destroy(obsx264->input_sem);
+	os_sem_destroy(obsx264->space_sem);
+	pthread_mutex_destroy(&obsx264->encode_mutex);
+	pthread_mutex_destroy(&obsx264->output_mutex);
+	obsx264->threaded = false;
+}
+
 static void clear_data(struct obs_x264 *obsx264)
 {
 	if (obsx264->context) {
@@ -85,8 +174,9 @@ static void obs_x264_destroy(void *data)
 
 	if (obsx264) {
 		os_end_high_performance(obsx264->performance_token);
+		stop_submit_thread(obsx264);
 		clear_data(obsx264);
-		da_free(obsx264->packet_data);
+		bfree(obsx264->tune);
 		bfree(obsx264);
 	}
 }
@@ -98,6 +188,8 @@ static void obs_x264_defaults(obs_data_t *settings)
 	obs_data_set_default_int   (settings, "keyint_sec",  0);
 	obs_data_set_default_int   (settings, "crf",         23);
 	obs_data_set_default_bool  (settings, "cbr",         false);
+	obs_data_set_default_bool  (settings, "threaded",    false);
+	obs_data_set_default_bool  (settings, "auto_preset", false);
 
 	obs_data_set_default_string(settings, "preset",      "veryfast");
 	obs_data_set_default_string(settings, "profile",     "");
@@ -120,6 +212,8 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_PROFILE    obs_module_text("Profile")
 #define TEXT_TUNE       obs_module_text("Tune")
 #define TEXT_X264_OPTS  obs_module_text("EncoderOptions")
+#define TEXT_THREADED   obs_module_text("ThreadedSubmission")
+#define TEXT_AUTO_PRESET obs_module_text("AutoPreset")
 
 static obs_properties_t *obs_x264_props(void *unused)
 {
@@ -150,6 +244,9 @@ static obs_properties_t *obs_x264_props(void *unused)
 	obs_properties_add_text(props, "x264opts", TEXT_X264_OPTS,
 			OBS_TEXT_DEFAULT);
 
+	obs_properties_add_bool(props, "threaded", TEXT_THREADED);
+	obs_properties_add_bool(props, "auto_preset", TEXT_AUTO_PRESET);
+
 	return props;
 }
 
@@ -270,12 +367,34 @@ static inline const char *validate_preset(struct obs_x264 *obsx264,
 	return new_preset ? new_preset : "veryfast";
 }
 
+static int get_preset_idx(const char *preset)
+{
+	for (int i = 0; x264_preset_names[i]; i++) {
+		if (strcmp(x264_preset_names[i], preset) == 0)
+			return i;
+	}
+
+	return 0;
+}
+
 static bool reset_x264_params(struct obs_x264 *obsx264,
 		const char *preset, const char *tune)
 {
-	int ret = x264_param_default_preset(&obsx264->params,
-			validate_preset(obsx264, preset),
-			validate(obsx264, tune, "tune", x264_tune_names));
+	const char *valid_preset = validate_preset(obsx264, preset);
+	const char *valid_tune = validate(obsx264, tune, "tune",
+			x264_tune_names);
+	int ret;
+
+	ret = x264_param_default_preset(&obsx264->params, valid_preset,
+			valid_tune);
+
+	/* kept for automatic preset adjustment */
+	bfree(obsx264->tune);
+	obsx264->tune        = valid_tune && *valid_tune ?
+		bstrdup(valid_tune) : NULL;
+	obsx264->base_preset = get_preset_idx(valid_preset);
+	obsx264->cur_preset  = obsx264->base_preset;
+
 	return ret == 0;
 }
 
@@ -329,6 +448,12 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	int height       = (int)obs_encoder_get_height(obsx264->encoder);
 	bool cbr         = obs_data_get_bool(settings, "cbr");
 
+	obsx264->auto_preset   = obs_data_get_bool(settings, "auto_preset");
+	obsx264->frame_ns      = 1000000000ULL * voi->fps_den / voi->fps_num;
+	obsx264->load_interval = voi->fps_num / voi->fps_den;
+	if (!obsx264->load_interval)
+		obsx264->load_interval = 1;
+
 	if (keyint_sec)
 		obsx264->params.i_keyint_max =
 			keyint_sec * voi->fps_num / voi->fps_den;
@@ -425,8 +550,10 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings)
 		if (opts && *opts)
 			info("custom settings: %s", opts);
 
-		if (!obsx264->context)
+		if (!obsx264->context) {
 			apply_x264_profile(obsx264, profile);
+			obsx264->base_refs = obsx264->params.i_frame_reference;
+		}
 	}
 
 	obsx264->params.b_repeat_headers = false;
@@ -439,20 +566,121 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings)
 	return success;
 }
 
+/* changes the analysis settings that x264_encoder_reconfig can change to
+ * those of another preset.  the number of reference frames can't go above
+ * what the encoder was opened with */
+static bool set_preset_params(struct obs_x264 *obsx264, int idx)
+{
+	x264_param_t preset;
+
+	if (x264_param_default_preset(&preset, x264_preset_names[idx],
+				obsx264->tune) != 0)
+		return false;
+
+	obsx264->params.analyse.inter            = preset.analyse.inter;
+	obsx264->params.analyse.i_me_method      = preset.analyse.i_me_method;
+	obsx264->params.analyse.i_me_range       = preset.analyse.i_me_range;
+	obsx264->params.analyse.i_subpel_refine  =
+		preset.analyse.i_subpel_refine;
+	obsx264->params.analyse.i_trellis        = preset.analyse.i_trellis;
+	obsx264->params.analyse.b_mixed_references =
+		preset.analyse.b_mixed_references;
+	obsx264->params.analyse.i_direct_mv_pred =
+		preset.analyse.i_direct_mv_pred;
+	obsx264->params.i_frame_reference        =
+		preset.i_frame_reference < obsx264->base_refs ?
+		preset.i_frame_reference : obsx264->base_refs;
+
+	obsx264->cur_preset = idx;
+	return true;
+}
+
+/* must be called with the encode mutex held when threaded */
+static void change_preset(struct obs_x264 *obsx264, int idx)
+{
+	const char *prev = x264_preset_names[obsx264->cur_preset];
+	int ret;
+
+	if (!set_preset_params(obsx264, idx))
+		return;
+
+	ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
+	if (ret != 0) {
+		warn("Failed to change preset to %s: %d",
+				x264_preset_names[idx], ret);
+		return;
+	}
+
+	info("encode time %.1f ms of %.1f ms per frame, preset changed "
+	     "from %s to %s",
+	     (double)obsx264->encode_ns / 1000000.0,
+	     (double)obsx264->frame_ns / 1000000.0,
+	     prev, x264_preset_names[idx]);
+}
+
+/* lowers the preset before x264 falls so far behind that frames get skipped,
+ * and goes back towards the chosen preset once there's headroom again */
+static void update_encoder_load(struct obs_x264 *obsx264, uint64_t encode_ns)
+{
+	uint64_t high, low;
+
+	if (!obsx264->auto_preset)
+		return;
+
+	obsx264->encode_ns = obsx264->load_frames ?
+		(obsx264->encode_ns * 7 + encode_ns) / 8 : encode_ns;
+
+	if (++obsx264->load_frames < obsx264->load_interval)
+		return;
+
+	obsx264->load_frames = 0;
+
+	if (obsx264->cooldown) {
+		obsx264->cooldown--;
+		return;
+	}
+
+	high = obsx264->frame_ns * LOAD_HIGH / 100;
+	low  = obsx264->frame_ns * LOAD_LOW  / 100;
+
+	if (obsx264->encode_ns > high && obsx264->cur_preset > 0) {
+		change_preset(obsx264, obsx264->cur_preset - 1);
+		obsx264->cooldown = LOAD_COOLDOWN;
+
+	} else if (obsx264->encode_ns < low &&
+	           obsx264->cur_preset < obsx264->base_preset) {
+		change_preset(obsx264, obsx264->cur_preset + 1);
+		obsx264->cooldown = LOAD_COOLDOWN;
+	}
+}
+
 static bool obs_x264_update(void *data, obs_data_t *settings)
 {
 	struct obs_x264 *obsx264 = data;
-	bool success = update_settings(obsx264, settings);
-	int ret;
+	bool success;
+	int ret = 0;
 
-	if (success) {
+	/* the submission thread may be in the middle of encoding a frame */
+	if (obsx264->thread_active)
+		pthread_mutex_lock(&obsx264->encode_mutex);
+
+	success = update_settings(obsx264, settings);
+
+	/* go back to the chosen preset if adjustment was turned off */
+	if (success && !obsx264->auto_preset &&
+	    obsx264->cur_preset != obsx264->base_preset)
+		set_preset_params(obsx264, obsx264->base_preset);
+
+	if (success)
 		ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
-		if (ret != 0)
-			warn("Failed to reconfigure: %d", ret);
-		return ret == 0;
-	}
 
-	return false;
+	if (obsx264->thread_active)
+		pthread_mutex_unlock(&obsx264->encode_mutex);
+
+	if (success && ret != 0)
+		warn("Failed to reconfigure: %d", ret);
+
+	return success && ret == 0;
 }
 
 static void load_headers(struct obs_x264 *obsx264)
@@ -483,6 +711,32 @@ static void load_headers(struct obs_x264 *obsx264)
 	obsx264->sei_size        = sei.num;
 }
 
+static void *submit_thread(void *data);
+
+static bool start_submit_thread(struct obs_x264 *obsx264)
+{
+	obsx264->threaded = true;
+
+	pthread_mutex_init_value(&obsx264->encode_mutex);
+	pthread_mutex_init_value(&obsx264->output_mutex);
+
+	if (pthread_mutex_init(&obsx264->encode_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&obsx264->output_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&obsx264->input_sem, 0) != 0)
+		return false;
+	if (os_sem_init(&obsx264->space_sem, SUBMIT_QUEUE_SIZE) != 0)
+		return false;
+	if (pthread_create(&obsx264->submit_thread, NULL, submit_thread,
+				obsx264) != 0)
+		return false;
+
+	obsx264->thread_active = true;
+	info("using threaded frame submission");
+	return true;
+}
+
 static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 {
 	struct obs_x264 *obsx264 = bzalloc(sizeof(struct obs_x264));
@@ -504,6 +758,13 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 		return NULL;
 	}
 
+	if (obs_data_get_bool(settings, "threaded") &&
+	    !start_submit_thread(obsx264)) {
+		warn("Failed to start submission thread, encoding on the "
+		     "video thread instead");
+		stop_submit_thread(obsx264);
+	}
+
 	obsx264->performance_token =
 		os_request_high_performance("x264 encoding");
 
@@ -514,30 +775,34 @@ static void parse_packet(struct obs_x264 *obsx264,
 		struct encoder_packet *packet, x264_nal_t *nals,
 		int nal_count, x264_picture_t *pic_out)
 {
-	if (!nal_count) return;
+	x264_nal_t *last;
 
-	da_resize(obsx264->packet_data, 0);
+	if (!nal_count) return;
 
-	for (int i = 0; i < nal_count; i++) {
-		x264_nal_t *nal = nals+i;
-		da_push_back_array(obsx264->packet_data, nal->p_payload,
-				nal->i_payload);
-	}
+	last = nals + nal_count - 1;
 
-	packet->data          = obsx264->packet_data.array;
-	packet->size          = obsx264->packet_data.num;
+	/* x264 writes the NALs of a frame one after the other in its own
+	 * buffer, which stays valid until the next x264_encoder_encode call,
+	 * so the packet can just point at it */
+	packet->data          = nals[0].p_payload;
+	packet->size          = last->p_payload + last->i_payload -
+		nals[0].p_payload;
 	packet->type          = OBS_ENCODER_VIDEO;
 	packet->pts           = pic_out->i_pts;
 	packet->dts           = pic_out->i_dts;
 	packet->keyframe      = pic_out->b_keyframe != 0;
+
+	UNUSED_PARAMETER(obsx264);
 }
 
 static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
-		struct encoder_frame *frame)
+		struct encoder_frame *frame, bool keyframe)
 {
 	x264_picture_init(pic);
 
 	pic->i_pts = frame->pts;
+	if (keyframe)
+		pic->i_type = X264_TYPE_IDR;
 	pic->img.i_csp = obsx264->params.i_csp;
 
 	if (obsx264->params.i_csp == X264_CSP_NV12)
@@ -551,6 +816,155 @@ static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 	}
 }
 
+static void encode_submitted_frame(struct obs_x264 *obsx264,
+		struct submit_frame *sf)
+{
+	struct encoder_frame  frame = {0};
+	struct encoder_packet packet = {0};
+	struct encoder_packet out;
+	x264_nal_t            *nals;
+	int                   nal_count;
+	int                   ret;
+	x264_picture_t        pic, pic_out;
+	uint64_t              start;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame.data[i]     = sf->planes[i];
+		frame.linesize[i] = sf->linesize[i];
+	}
+	frame.pts = sf->pts;
+
+	init_pic_data(obsx264, &pic, &frame, sf->keyframe);
+
+	pthread_mutex_lock(&obsx264->encode_mutex);
+
+	start = os_gettime_ns();
+	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
+			&pic, &pic_out);
+	/* x264's buffer gets reused by the next encode call, so the packet is
+	 * copied straight in to reference counted data, which is then handed
+	 * over to libobs as is */
+	if (ret >= 0 && nal_count) {
+		parse_packet(obsx264, &packet, nals, nal_count, &pic_out);
+		obs_encoder_packet_create_instance(&out, &packet);
+		out.refcounted = true;
+	}
+
+	if (ret >= 0)
+		update_encoder_load(obsx264, os_gettime_ns() - start);
+
+	pthread_mutex_unlock(&obsx264->encode_mutex);
+
+	if (ret < 0) {
+		warn("encode failed");
+		obsx264->encode_failed = true;
+		return;
+	}
+
+	if (!nal_count)
+		return;
+
+	pthread_mutex_lock(&obsx264->output_mutex);
+	circlebuf_push_back(&obsx264->output_packets, &out, sizeof(out));
+	pthread_mutex_unlock(&obsx264->output_mutex);
+}
+
+static void *submit_thread(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+
+	while (os_sem_wait(obsx264->input_sem) == 0) {
+		if (obsx264->stop)
+			break;
+
+		encode_submitted_frame(obsx264,
+				&obsx264->frames[obsx264->read_idx]);
+
+		obsx264->read_idx = (obsx264->read_idx + 1) % SUBMIT_QUEUE_SIZE;
+		os_sem_post(obsx264->space_sem);
+	}
+
+	return NULL;
+}
+
+static inline uint32_t get_plane_height(struct obs_x264 *obsx264, int plane)
+{
+	/* both NV12 and I420 have half height chroma planes */
+	return plane == 0 ?
+		(uint32_t)obsx264->params.i_height :
+		(uint32_t)obsx264->params.i_height / 2;
+}
+
+static void copy_submit_frame(struct obs_x264 *obsx264,
+		struct submit_frame *sf, struct encoder_frame *frame)
+{
+	int    planes = obsx264->params.i_csp == X264_CSP_I420 ? 3 : 2;
+	size_t size   = 0;
+	size_t offset = 0;
+
+	for (int i = 0; i < planes; i++)
+		size += frame->linesize[i] * get_plane_height(obsx264, i);
+
+	if (sf->size != size) {
+		bfree(sf->data);
+		sf->data = bmalloc(size);
+		sf->size = size;
+	}
+
+	for (int i = 0; i < planes; i++) {
+		size_t plane_size = frame->linesize[i] *
+			get_plane_height(obsx264, i);
+
+		sf->planes[i]   = sf->data + offset;
+		sf->linesize[i] = frame->linesize[i];
+		memcpy(sf->planes[i], frame->data[i], plane_size);
+		offset += plane_size;
+	}
+
+	sf->pts      = frame->pts;
+	sf->keyframe = obsx264->force_keyframe;
+	obsx264->force_keyframe = false;
+}
+
+static bool obs_x264_encode_threaded(struct obs_x264 *obsx264,
+		struct encoder_frame *frame, struct encoder_packet *packet,
+		bool *received_packet)
+{
+	struct encoder_packet out;
+
+	if (obsx264->encode_failed)
+		return false;
+
+	/* blocks if x264 is more than SUBMIT_QUEUE_SIZE frames behind */
+	os_sem_wait(obsx264->space_sem);
+	copy_submit_frame(obsx264, &obsx264->frames[obsx264->write_idx], frame);
+	obsx264->write_idx = (obsx264->write_idx + 1) % SUBMIT_QUEUE_SIZE;
+	os_sem_post(obsx264->input_sem);
+
+	*received_packet = false;
+
+	pthread_mutex_lock(&obsx264->output_mutex);
+	if (obsx264->output_packets.size) {
+		circlebuf_pop_front(&obsx264->output_packets, &out,
+				sizeof(out));
+		*received_packet = true;
+	}
+	pthread_mutex_unlock(&obsx264->output_mutex);
+
+	/* the reference goes to libobs along with the packet */
+	if (*received_packet) {
+		packet->data       = out.data;
+		packet->size       = out.size;
+		packet->type       = out.type;
+		packet->pts        = out.pts;
+		packet->dts        = out.dts;
+		packet->keyframe   = out.keyframe;
+		packet->refcounted = true;
+	}
+
+	return true;
+}
+
 static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 		struct encoder_packet *packet, bool *received_packet)
 {
@@ -559,13 +973,20 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	int             nal_count;
 	int             ret;
 	x264_picture_t  pic, pic_out;
+	uint64_t        start;
 
 	if (!frame || !packet || !received_packet)
 		return false;
 
+	if (obsx264->thread_active)
+		return obs_x264_encode_threaded(obsx264, frame, packet,
+				received_packet);
+
 	if (frame)
-		init_pic_data(obsx264, &pic, frame);
+		init_pic_data(obsx264, &pic, frame, obsx264->force_keyframe);
+	obsx264->force_keyframe = false;
 
+	start = os_gettime_ns();
 	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
 			(frame ? &pic : NULL), &pic_out);
 	if (ret < 0) {
@@ -576,9 +997,16 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	*received_packet = (nal_count != 0);
 	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
 
+	update_encoder_load(obsx264, os_gettime_ns() - start);
 	return true;
 }
 
+static void obs_x264_request_keyframe(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+	obsx264->force_keyframe = true;
+}
+
 static bool obs_x264_extra_data(void *data, uint8_t **extra_data, size_t *size)
 {
 	struct obs_x264 *obsx264 = data;
@@ -603,6 +1031,19 @@ static bool obs_x264_sei(void *data, uint8_t **sei, size_t *size)
 	return true;
 }
 
+static uint32_t obs_x264_frame_delay(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+	int delay = x264_encoder_maximum_delayed_frames(obsx264->context);
+
+	if (delay < 0)
+		delay = 0;
+
+	/* with threaded submission, a packet is handed back on the next call
+	 * to encode at the earliest */
+	return (uint32_t)delay + (obsx264->thread_active ? 1 : 0);
+}
+
 static bool obs_x264_video_info(void *data, struct video_scale_info *info)
 {
 	struct obs_x264 *obsx264 = data;
@@ -628,17 +1069,19 @@ static bool obs_x264_video_info(void *data, struct video_scale_info *info)
 }
 
 struct obs_encoder_info obs_x264_encoder = {
-	.id             = "obs_x264",
-	.type           = OBS_ENCODER_VIDEO,
-	.codec          = "h264",
-	.get_name       = obs_x264_getname,
-	.create         = obs_x264_create,
-	.destroy        = obs_x264_destroy,
-	.encode         = obs_x264_encode,
-	.update         = obs_x264_update,
-	.get_properties = obs_x264_props,
-	.get_defaults   = obs_x264_defaults,
-	.get_extra_data = obs_x264_extra_data,
-	.get_sei_data   = obs_x264_sei,
-	.get_video_info = obs_x264_video_info
+	.id               = "obs_x264",
+	.type             = OBS_ENCODER_VIDEO,
+	.codec            = "h264",
+	.get_name         = obs_x264_getname,
+	.create           = obs_x264_create,
+	.destroy          = obs_x264_destroy,
+	.encode           = obs_x264_encode,
+	.update           = obs_x264_update,
+	.get_properties   = obs_x264_props,
+	.get_defaults     = obs_x264_defaults,
+	.get_extra_data   = obs_x264_extra_data,
+	.get_sei_data     = obs_x264_sei,
+	.get_video_info   = obs_x264_video_info,
+	.get_frame_delay  = obs_x264_frame_delay,
+	.request_keyframe = obs_x264_request_keyframe
 };
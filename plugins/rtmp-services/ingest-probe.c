@@ -0,0 +1,339 @@
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+#include <obs-module.h>
+#include <stdlib.h>
+#include "ingest-probe.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int SOCKET;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#define DEFAULT_RTMP_PORT 1935
+#define RTT_SAMPLES       3
+#define HANDSHAKE_SIZE    1536
+
+struct probe {
+	struct ingest_result *result;
+	uint64_t             deadline;
+	pthread_t            thread;
+	bool                 started;
+};
+
+static bool parse_url(const char *url, struct dstr *host, int *port)
+{
+	const char *start = strstr(url, "://");
+	const char *end;
+
+	start = start ? start + 3 : url;
+	*port = DEFAULT_RTMP_PORT;
+
+	if (*start == '[') {
+		end = strchr(++start, ']');
+		if (!end)
+			return false;
+
+		dstr_ncopy(host, start, end - start);
+		end++;
+	} else {
+		end = start + strcspn(start, ":/");
+		dstr_ncopy(host, start, end - start);
+	}
+
+	if (*end == ':')
+		*port = atoi(end + 1);
+
+	return !dstr_is_empty(host) && *port > 0 && *port < 65536;
+}
+
+static inline void set_nonblocking(SOCKET sock)
+{
+#ifdef _WIN32
+	u_long nonblocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static inline bool would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EINPROGRESS || errno == EAGAIN ||
+		errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* waits until the socket is ready, or the deadline has passed */
+static bool wait_socket(SOCKET sock, bool write, uint64_t deadline)
+{
+	uint64_t       now = os_gettime_ns();
+	uint64_t       remaining;
+	struct timeval tv;
+	fd_set         fds;
+
+	if (now >= deadline)
+		return false;
+
+	remaining  = (deadline - now) / 1000;
+	tv.tv_sec  = (long)(remaining / 1000000);
+	tv.tv_usec = (long)(remaining % 1000000);
+
+	FD_ZERO(&fds);
+	FD_SET(sock, &fds);
+
+	return select((int)sock + 1, write ? NULL : &fds, write ? &fds : NULL,
+			NULL, &tv) > 0;
+}
+
+static SOCKET connect_socket(const struct addrinfo *ai, uint64_t deadline)
+{
+	SOCKET    sock = socket(ai->ai_family, SOCK_STREAM, IPPROTO_TCP);
+	int       err  = 0;
+	socklen_t size = sizeof(err);
+
+	if (sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	set_nonblocking(sock);
+
+	if (connect(sock, ai->ai_addr, (int)ai->ai_addrlen) != 0 &&
+	    !would_block())
+		goto fail;
+	if (!wait_socket(sock, true, deadline))
+		goto fail;
+	if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&err, &size) != 0 ||
+	    err != 0)
+		goto fail;
+
+	return sock;
+
+fail:
+	closesocket(sock);
+	return INVALID_SOCKET;
+}
+
+static bool send_all(SOCKET sock, const uint8_t *data, size_t size,
+		uint64_t deadline)
+{
+	while (size) {
+		int ret;
+
+		if (!wait_socket(sock, true, deadline))
+			return false;
+
+		ret = send(sock, (const char*)data, (int)size, 0);
+		if (ret < 0) {
+			if (would_block())
+				continue;
+			return false;
+		}
+
+		data += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+static bool recv_all(SOCKET sock, uint8_t *data, size_t size,
+		uint64_t deadline)
+{
+	while (size) {
+		int ret;
+
+		if (!wait_socket(sock, false, deadline))
+			return false;
+
+		ret = recv(sock, (char*)data, (int)size, 0);
+		if (ret == 0)
+			return false;
+		if (ret < 0) {
+			if (would_block())
+				continue;
+			return false;
+		}
+
+		data += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/* C0+C1, then S0+S1+S2 from the server, then C2.  the connection is closed
+ * right after, before anything is published */
+static bool rtmp_handshake(SOCKET sock, uint64_t deadline)
+{
+	uint8_t c0c1[1 + HANDSHAKE_SIZE];
+	uint8_t s0s1s2[1 + HANDSHAKE_SIZE * 2];
+
+	c0c1[0] = 3;
+	memset(c0c1 + 1, 0, 8);
+	for (size_t i = 9; i < sizeof(c0c1); i++)
+		c0c1[i] = (uint8_t)rand();
+
+	if (!send_all(sock, c0c1, sizeof(c0c1), deadline))
+		return false;
+	if (!recv_all(sock, s0s1s2, sizeof(s0s1s2), deadline))
+		return false;
+	if (s0s1s2[0] != 3)
+		return false;
+
+	return send_all(sock, s0s1s2 + 1, HANDSHAKE_SIZE, deadline);
+}
+
+static inline int elapsed_ms(uint64_t start)
+{
+	return (int)((os_gettime_ns() - start) / 1000000);
+}
+
+static void probe_server(struct probe *probe, const struct addrinfo *ai)
+{
+	struct ingest_result *result = probe->result;
+	SOCKET               sock    = INVALID_SOCKET;
+	uint64_t             start;
+
+	for (int i = 0; i < RTT_SAMPLES; i++) {
+		int rtt;
+
+		if (sock != INVALID_SOCKET)
+			closesocket(sock);
+
+		start = os_gettime_ns();
+		sock  = connect_socket(ai, probe->deadline);
+		if (sock == INVALID_SOCKET)
+			break;
+
+		rtt = elapsed_ms(start);
+		if (!result->reachable || rtt < result->rtt_ms)
+			result->rtt_ms = rtt;
+		result->reachable = true;
+	}
+
+	if (sock == INVALID_SOCKET)
+		return;
+
+	start = os_gettime_ns();
+	result->handshake_ok = rtmp_handshake(sock, probe->deadline);
+	result->handshake_ms = elapsed_ms(start);
+
+	closesocket(sock);
+}
+
+static void *probe_thread(void *data)
+{
+	struct probe    *probe = data;
+	struct addrinfo hints  = {0};
+	struct addrinfo *ai    = NULL;
+	struct dstr     host   = {0};
+	char            port_str[16];
+	int             port;
+
+	if (!parse_url(probe->result->url, &host, &port))
+		goto exit;
+
+	snprintf(port_str, sizeof(port_str), "%d", port);
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host.array, port_str, &hints, &ai) != 0 || !ai)
+		goto exit;
+
+	probe_server(probe, ai);
+	freeaddrinfo(ai);
+
+exit:
+	dstr_free(&host);
+	return NULL;
+}
+
+static int compare_results(const void *val1, const void *val2)
+{
+	const struct ingest_result *r1 = val1;
+	const struct ingest_result *r2 = val2;
+
+	if (r1->handshake_ok != r2->handshake_ok)
+		return r1->handshake_ok ? -1 : 1;
+	if (r1->reachable != r2->reachable)
+		return r1->reachable ? -1 : 1;
+
+	return r1->handshake_ok ?
+		r1->handshake_ms - r2->handshake_ms :
+		r1->rtt_ms - r2->rtt_ms;
+}
+
+void ingest_probe(struct ingest_result *results, size_t count,
+		int timeout_ms)
+{
+	struct probe *probes;
+	uint64_t     deadline;
+
+	if (!count)
+		return;
+
+#ifdef _WIN32
+	WSADATA wsad;
+	bool    wsa_init = WSAStartup(MAKEWORD(2, 2), &wsad) == 0;
+#endif
+
+	probes   = bzalloc(sizeof(struct probe) * count);
+	deadline = os_gettime_ns() + (uint64_t)timeout_ms * 1000000ULL;
+
+	for (size_t i = 0; i < count; i++) {
+		results[i].reachable    = false;
+		results[i].handshake_ok = false;
+		results[i].rtt_ms       = 0;
+		results[i].handshake_ms = 0;
+
+		probes[i].result   = results + i;
+		probes[i].deadline = deadline;
+		probes[i].started  = pthread_create(&probes[i].thread, NULL,
+				probe_thread, probes + i) == 0;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (probes[i].started)
+			pthread_join(probes[i].thread, NULL);
+	}
+
+	qsort(results, count, sizeof(struct ingest_result), compare_results);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct ingest_result *result = results + i;
+
+		if (result->handshake_ok)
+			blog(LOG_INFO, "ingest-probe: %s: rtt %d ms, "
+			               "handshake %d ms", result->url,
+			               result->rtt_ms, result->handshake_ms);
+		else if (result->reachable)
+			blog(LOG_INFO, "ingest-probe: %s: rtt %d ms, "
+			               "handshake failed", result->url,
+			               result->rtt_ms);
+		else
+			blog(LOG_INFO, "ingest-probe: %s: unreachable",
+			               result->url);
+	}
+
+	bfree(probes);
+
+#ifdef _WIN32
+	if (wsa_init)
+		WSACleanup();
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+
+struct ingest_result {
+	const char *url;
+
+	bool       reachable;
+	bool       handshake_ok;
+	int        rtt_ms;
+	int        handshake_ms;
+};
+
+/*
+ * Measures all ingest servers in parallel, waiting at most timeout_ms.
+ *
+ * The round trip time is the fastest of a few TCP connects to the server.
+ * The handshake time is how long the RTMP handshake takes, which also
+ * transfers a few kilobytes each way and shows whether the server is
+ * actually accepting streams.  Results are sorted best first.
+ */
+extern void ingest_probe(struct ingest_result *results, size_t count,
+		int timeout_ms);
@@ -1,8 +1,15 @@
 #include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
 #include <obs-module.h>
 #include <jansson.h>
+#include "ingest-probe.h"
+
+#define PROBE_TIMEOUT_MS 3000
 
 struct rtmp_common {
+	obs_service_t *context;
+
 	char *service;
 	char *server;
 	char *key;
@@ -39,9 +46,9 @@ static void rtmp_common_destroy(void *data)
 static void *rtmp_common_create(obs_data_t *settings, obs_service_t *service)
 {
 	struct rtmp_common *data = bzalloc(sizeof(struct rtmp_common));
+	data->context = service;
 	rtmp_common_update(data, settings);
 
-	UNUSED_PARAMETER(service);
 	return data;
 }
 
@@ -134,10 +141,54 @@ static void properties_data_destroy(void *data)
 		json_decref(root);
 }
 
+/* probe results are cached in the settings as an array of objects with the
+ * server url and its timings, for the service named in "probe_service" */
+static obs_data_t *find_probe_result(obs_data_t *settings, const char *name,
+		const char *url)
+{
+	obs_data_array_t *results;
+	obs_data_t       *found = NULL;
+	size_t           count;
+
+	if (strcmp(obs_data_get_string(settings, "probe_service"), name) != 0)
+		return NULL;
+
+	results = obs_data_get_array(settings, "probe_results");
+	count   = obs_data_array_count(results);
+
+	for (size_t i = 0; i < count && !found; i++) {
+		obs_data_t *result = obs_data_array_item(results, i);
+
+		if (strcmp(obs_data_get_string(result, "url"), url) == 0)
+			found = result;
+		else
+			obs_data_release(result);
+	}
+
+	obs_data_array_release(results);
+	return found;
+}
+
+static void get_server_label(struct dstr *label, const char *server_name,
+		obs_data_t *result)
+{
+	dstr_copy(label, server_name);
+
+	if (!result)
+		return;
+
+	if (obs_data_get_bool(result, "handshake_ok"))
+		dstr_catf(label, " (%d ms)",
+				(int)obs_data_get_int(result, "handshake_ms"));
+	else
+		dstr_catf(label, " (%s)", obs_module_text("ServerUnreachable"));
+}
+
 static void fill_servers(obs_property_t *servers_prop, json_t *service,
-		const char *name)
+		const char *name, obs_data_t *settings)
 {
 	json_t *servers, *server;
+	struct dstr label = {0};
 	size_t index;
 
 	obs_property_list_clear(servers_prop);
@@ -158,8 +209,14 @@ static void fill_servers(obs_property_t *servers_prop, json_t *service,
 		if (!server_name || !url)
 			continue;
 
-		obs_property_list_add_string(servers_prop, server_name, url);
+		obs_data_t *result = find_probe_result(settings, name, url);
+		get_server_label(&label, server_name, result);
+		obs_data_release(result);
+
+		obs_property_list_add_string(servers_prop, label.array, url);
 	}
+
+	dstr_free(&label);
 }
 
 static inline json_t *find_service(json_t *root, const char *name)
@@ -191,7 +248,85 @@ static bool service_selected(obs_properties_t *props, obs_property_t *p,
 	if (!service)
 		return false;
 
-	fill_servers(obs_properties_get(props, "server"), service, name);
+	fill_servers(obs_properties_get(props, "server"), service, name,
+			settings);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+static void save_probe_results(obs_data_t *settings, const char *name,
+		struct ingest_result *results, size_t count)
+{
+	obs_data_array_t *array = obs_data_array_create();
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_create();
+
+		obs_data_set_string(item, "url", results[i].url);
+		obs_data_set_bool(item, "handshake_ok", results[i].handshake_ok);
+		obs_data_set_int(item, "rtt_ms", results[i].rtt_ms);
+		obs_data_set_int(item, "handshake_ms", results[i].handshake_ms);
+		obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+
+	obs_data_set_string(settings, "probe_service", name);
+	obs_data_set_array(settings, "probe_results", array);
+	obs_data_array_release(array);
+}
+
+/* connects to every server of the selected service at the same time and
+ * selects the one that completes the RTMP handshake the fastest */
+static bool probe_servers_clicked(obs_properties_t *props, obs_property_t *p,
+		void *data)
+{
+	struct rtmp_common *service = data;
+	json_t             *root    = obs_properties_get_param(props);
+	json_t             *json_service, *servers, *server;
+	obs_data_t         *settings;
+	const char         *name;
+	size_t             index;
+
+	DARRAY(struct ingest_result) results = {0};
+
+	if (!service || !root)
+		return false;
+
+	settings = obs_service_get_settings(service->context);
+	name     = obs_data_get_string(settings, "service");
+
+	json_service = find_service(root, name);
+	servers = json_service ? json_object_get(json_service, "servers") : NULL;
+
+	json_array_foreach (servers, index, server) {
+		struct ingest_result *result;
+		const char *url = get_string_val(server, "url");
+
+		if (!url)
+			continue;
+
+		result = da_push_back_new(results);
+		result->url = url;
+	}
+
+	if (!results.num) {
+		obs_data_release(settings);
+		return false;
+	}
+
+	ingest_probe(results.array, results.num, PROBE_TIMEOUT_MS);
+	save_probe_results(settings, name, results.array, results.num);
+
+	if (results.array[0].handshake_ok)
+		obs_data_set_string(settings, "server", results.array[0].url);
+
+	rtmp_common_update(service, settings);
+	fill_servers(obs_properties_get(props, "server"), json_service, name,
+			settings);
+
+	da_free(results);
+	obs_data_release(settings);
 
 	UNUSED_PARAMETER(p);
 	return true;
@@ -220,6 +355,9 @@ static obs_properties_t *rtmp_common_properties(void *unused)
 	obs_properties_add_list(ppts, "server", obs_module_text("Server"),
 			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 
+	obs_properties_add_button(ppts, "probe_servers",
+			obs_module_text("ProbeServers"), probe_servers_clicked);
+
 	obs_properties_add_text(ppts, "key", obs_module_text("StreamKey"),
 			OBS_TEXT_PASSWORD);
 	return ppts;
@@ -281,7 +419,7 @@ static void initialize_output(struct rtmp_common *service, obs_output_t *output,
 		json_t *root)
 {
 	obs_encoder_t *video_encoder = obs_output_get_video_encoder(output);
-	obs_encoder_t *audio_encoder = obs_output_get_audio_encoder(output);
+	obs_encoder_t *audio_encoder = obs_output_get_audio_encoder(output, 0);
 	json_t        *json_service = find_service(root, service->service);
 	json_t        *recommended;
 
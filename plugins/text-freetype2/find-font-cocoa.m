@@ -4,14 +4,14 @@
 
 #import <Foundation/Foundation.h>
 
-static inline void add_path_font(const char *path)
+static inline void add_path_font(FT_Library lib, const char *path)
 {
 	FT_Face face;
 	FT_Long idx = 0;
 	FT_Long max_faces = 1;
 
 	while (idx < max_faces) {
-		if (FT_New_Face(ft2_lib, path, idx, &face) != 0)
+		if (FT_New_Face(lib, path, idx, &face) != 0)
 			break;
 
 		build_font_path_info(face, idx++, path);
@@ -20,7 +20,8 @@ static inline void add_path_font(const char *path)
 	}
 }
 
-static void add_path_fonts(NSFileManager *file_manager, NSString *path)
+static void add_path_fonts(FT_Library lib, NSFileManager *file_manager,
+		NSString *path)
 {
 	NSArray *files = NULL;
 
@@ -29,29 +30,52 @@ static void add_path_fonts(NSFileManager *file_manager, NSString *path)
 	for (NSString *file in files) {
 		NSString *full_path = [path stringByAppendingPathComponent:file];
 
-		add_path_font(full_path.fileSystemRepresentation);
+		if (os_font_scan_canceled())
+			break;
+
+		add_path_font(lib, full_path.fileSystemRepresentation);
 	}
 }
 
-void load_os_font_list(void)
+static NSArray *get_font_dirs(NSFileManager *file_manager)
+{
+	NSMutableArray *font_dirs = [NSMutableArray array];
+	BOOL is_dir;
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(
+			NSLibraryDirectory, NSAllDomainsMask, true);
+
+	for (NSString *path in paths) {
+		NSString *font_path =
+			[path stringByAppendingPathComponent:@"Fonts"];
+
+		bool folder_exists = [file_manager
+				fileExistsAtPath:font_path
+				isDirectory:&is_dir];
+
+		if (folder_exists && is_dir)
+			[font_dirs addObject:font_path];
+	}
+
+	return font_dirs;
+}
+
+void get_os_font_list_key(struct dstr *key)
+{
+	@autoreleasepool {
+		NSFileManager *file_manager = [NSFileManager defaultManager];
+
+		for (NSString *font_path in get_font_dirs(file_manager))
+			add_font_dir_key(key,
+					font_path.fileSystemRepresentation);
+	}
+}
+
+void scan_os_font_list(FT_Library lib)
 {
 	@autoreleasepool {
-		BOOL is_dir;
-		NSArray *paths = NSSearchPathForDirectoriesInDomains(
-				NSLibraryDirectory, NSAllDomainsMask, true);
-
-		for (NSString *path in paths) {
-			NSFileManager *file_manager =
-				[NSFileManager defaultManager];
-			NSString *font_path =
-				[path stringByAppendingPathComponent:@"Fonts"];
-
-			bool folder_exists = [file_manager
-					fileExistsAtPath:font_path
-					isDirectory:&is_dir];
-
-			if (folder_exists && is_dir)
-				add_path_fonts(file_manager, font_path);
-		}
+		NSFileManager *file_manager = [NSFileManager defaultManager];
+
+		for (NSString *font_path in get_font_dirs(file_manager))
+			add_path_fonts(lib, file_manager, font_path);
 	}
 }
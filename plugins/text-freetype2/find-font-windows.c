@@ -8,8 +8,6 @@
 #include <shellapi.h>
 #include <shlobj.h>
 
-extern DARRAY(struct font_path_info) font_list;
-
 struct mac_font_mapping {
 	unsigned short encoding_id;
 	unsigned short language_id;
@@ -190,22 +188,40 @@ char *sfnt_name_to_utf8(FT_SfntName *sfnt_name)
 	return utf8_str;
 }
 
-void load_os_font_list(void)
+static bool get_font_dir(struct dstr *path)
 {
-	struct dstr      path = {0};
-	HANDLE           handle;
-	WIN32_FIND_DATAA wfd;
-
-	dstr_reserve(&path, MAX_PATH);
+	dstr_reserve(path, MAX_PATH);
 
 	HRESULT res = SHGetFolderPathA(NULL, CSIDL_FONTS, NULL,
-			SHGFP_TYPE_CURRENT, path.array);
+			SHGFP_TYPE_CURRENT, path->array);
 	if (res != S_OK) {
 		blog(LOG_WARNING, "Error finding windows font folder");
-		return;
+		return false;
 	}
 
-	path.len = strlen(path.array);
+	path->len = strlen(path->array);
+	return true;
+}
+
+void get_os_font_list_key(struct dstr *key)
+{
+	struct dstr path = {0};
+
+	if (get_font_dir(&path))
+		add_font_dir_key(key, path.array);
+
+	dstr_free(&path);
+}
+
+void scan_os_font_list(FT_Library lib)
+{
+	struct dstr      path = {0};
+	HANDLE           handle;
+	WIN32_FIND_DATAA wfd;
+
+	if (!get_font_dir(&path))
+		goto free_string;
+
 	dstr_cat(&path, "\\*.*");
 
 	handle = FindFirstFileA(path.array, &wfd);
@@ -228,7 +244,7 @@ void load_os_font_list(void)
 		dstr_cat(&full_path, wfd.cFileName);
 
 		while (idx < max_faces) {
-			FT_Error ret = FT_New_Face(ft2_lib, full_path.array,
+			FT_Error ret = FT_New_Face(lib, full_path.array,
 					idx, &face);
 			if (ret != 0)
 				break;
@@ -239,7 +255,7 @@ void load_os_font_list(void)
 		}
 
 		dstr_free(&full_path);
-	} while (FindNextFileA(handle, &wfd));
+	} while (!os_font_scan_canceled() && FindNextFileA(handle, &wfd));
 
 	FindClose(handle);
 
@@ -1,8 +1,25 @@
 #include <ctype.h>
+#include <stdlib.h>
 #include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "find-font.h"
+#include "text-freetype2.h"
 
-DARRAY(struct font_path_info) font_list;
+static DARRAY(struct font_path_info) font_list;
+
+/* filled by build_font_path_info while the OS fonts are being scanned */
+static DARRAY(struct font_path_info) scan_list;
+
+/* list replaced by a background rescan.  get_font_path returns paths that
+ * point in to the list, so it's only freed on unload */
+static DARRAY(struct font_path_info) stale_list;
+
+static pthread_mutex_t font_list_mutex;
+static pthread_t       rescan_thread;
+static bool            rescan_thread_active = false;
+static volatile bool   rescan_canceled      = false;
+static char            *cache_key           = NULL;
 
 static void create_bitmap_sizes(struct font_path_info *info, FT_Face face)
 {
@@ -68,7 +85,7 @@ static void add_font_path(FT_Face face,
 	info.path           = bstrdup(path);
 
 	create_bitmap_sizes(&info, face);
-	da_push_back(font_list, &info);
+	da_push_back(scan_list, &info);
 
 	/*blog(LOG_DEBUG, "name: %s\n\tstyle: %s\n\tpath: %s\n",
 			family_in,
@@ -120,11 +137,254 @@ void build_font_path_info(FT_Face face, FT_Long idx, const char *path)
 	da_free(family_names);
 }
 
+/* ------------------------------------------------------------------------- */
+/* font list cache
+ *
+ * Opening every installed font takes seconds on systems with thousands of
+ * fonts, so the list is saved to a text file with one font per line:
+ *
+ *   path <tab> index <tab> bitmap|bold|italic <tab> face_len <tab> sizes
+ *   <tab> face_and_style
+ *
+ * The first line holds a key built from the modification times of the font
+ * folders.  If it doesn't match on startup, the cached list is used while the
+ * fonts are scanned again in the background. */
+
+static char *get_cache_path(void)
+{
+	char *path;
+
+	path = os_get_config_path("obs-studio/plugin_config");
+	os_mkdir(path);
+	bfree(path);
+
+	path = os_get_config_path("obs-studio/plugin_config/text-freetype2");
+	os_mkdir(path);
+	bfree(path);
+
+	return os_get_config_path(
+			"obs-studio/plugin_config/text-freetype2/fonts.txt");
+}
+
+void add_font_dir_key(struct dstr *key, const char *dir)
+{
+	dstr_catf(key, "%lld;", (long long)os_get_file_mod_time(dir));
+}
+
+static void save_font_cache(const struct font_path_info *list, size_t num,
+		const char *key)
+{
+	struct dstr text = {0};
+	char *path;
+
+	dstr_printf(&text, "%s\n", key);
+
+	for (size_t i = 0; i < num; i++) {
+		const struct font_path_info *info = list + i;
+
+		dstr_catf(&text, "%s\t%ld\t%d%d%d\t%u\t", info->path,
+				(long)info->index, info->is_bitmap,
+				info->bold, info->italic,
+				(unsigned int)info->face_len);
+
+		for (size_t j = 0; j < info->num_sizes; j++)
+			dstr_catf(&text, j ? ",%d" : "%d", info->sizes[j]);
+
+		dstr_catf(&text, "\t%s\n", info->face_and_style);
+	}
+
+	path = get_cache_path();
+	if (!os_safe_write_utf8_file(path, text.array, text.len, false))
+		blog(LOG_WARNING, "Failed to save font cache to '%s'", path);
+	bfree(path);
+
+	dstr_free(&text);
+}
+
+/* splits off the text up to the next delimiter, or returns NULL if the
+ * line ends first */
+static char *next_field(char **pos, char delim)
+{
+	char *start = *pos;
+	char *end   = start;
+
+	while (*end && *end != delim && *end != '\n')
+		end++;
+	if (*end != delim)
+		return NULL;
+
+	*end = 0;
+	*pos = end + 1;
+	return start;
+}
+
+static bool parse_cached_font(char **pos, struct font_path_info *info)
+{
+	char *path, *index, *flags, *face_len, *sizes, *name;
+	DARRAY(int) size_list;
+
+	path     = next_field(pos, '\t');
+	index    = path     ? next_field(pos, '\t') : NULL;
+	flags    = index    ? next_field(pos, '\t') : NULL;
+	face_len = flags    ? next_field(pos, '\t') : NULL;
+	sizes    = face_len ? next_field(pos, '\t') : NULL;
+	name     = sizes    ? next_field(pos, '\n') : NULL;
+
+	if (!name || strlen(flags) != 3)
+		return false;
+
+	info->index     = (FT_Long)strtol(index, NULL, 10);
+	info->is_bitmap = flags[0] == '1';
+	info->bold      = flags[1] == '1';
+	info->italic    = flags[2] == '1';
+	info->face_len  = (size_t)strtoul(face_len, NULL, 10);
+	info->full_len  = strlen(name);
+
+	if (info->face_len > info->full_len)
+		return false;
+
+	da_init(size_list);
+	while (*sizes) {
+		int val = (int)strtol(sizes, &sizes, 10);
+		da_push_back(size_list, &val);
+
+		if (*sizes != ',')
+			break;
+		sizes++;
+	}
+
+	info->sizes          = size_list.array;
+	info->num_sizes      = size_list.num;
+	info->path           = bstrdup(path);
+	info->face_and_style = bstrdup(name);
+	return true;
+}
+
+/* returns false if there is no usable cache, up_to_date is set if the cache
+ * was built from the fonts that are currently installed */
+static bool load_font_cache(const char *key, bool *up_to_date)
+{
+	char *path = get_cache_path();
+	char *text = os_quick_read_utf8_file(path);
+	char *pos  = text;
+	char *cached_key;
+
+	bfree(path);
+
+	if (!text)
+		return false;
+
+	cached_key = next_field(&pos, '\n');
+	if (!cached_key) {
+		bfree(text);
+		return false;
+	}
+
+	*up_to_date = strcmp(cached_key, key) == 0;
+
+	while (*pos) {
+		struct font_path_info info;
+
+		if (!parse_cached_font(&pos, &info)) {
+			blog(LOG_WARNING, "Font cache is corrupt, rescanning");
+			for (size_t i = 0; i < font_list.num; i++)
+				font_path_info_free(font_list.array + i);
+			da_free(font_list);
+			bfree(text);
+			return false;
+		}
+
+		da_push_back(font_list, &info);
+	}
+
+	bfree(text);
+	return font_list.num > 0;
+}
+
+bool os_font_scan_canceled(void)
+{
+	return rescan_canceled;
+}
+
+static bool scan_fonts(FT_Library lib)
+{
+	scan_os_font_list(lib);
+
+	if (rescan_canceled) {
+		for (size_t i = 0; i < scan_list.num; i++)
+			font_path_info_free(scan_list.array + i);
+		da_free(scan_list);
+		return false;
+	}
+
+	save_font_cache(scan_list.array, scan_list.num, cache_key);
+	return true;
+}
+
+static void *rescan_fonts_thread(void *unused)
+{
+	FT_Library lib;
+
+	/* FT_New_Face isn't thread safe, so ft2_lib can't be used here */
+	if (FT_Init_FreeType(&lib) != 0)
+		return NULL;
+
+	if (scan_fonts(lib)) {
+		pthread_mutex_lock(&font_list_mutex);
+		da_move(stale_list, font_list);
+		da_move(font_list, scan_list);
+		pthread_mutex_unlock(&font_list_mutex);
+
+		blog(LOG_INFO, "Installed fonts changed, font list updated");
+	}
+
+	FT_Done_FreeType(lib);
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+void load_os_font_list(void)
+{
+	struct dstr key = {0};
+	bool up_to_date = false;
+
+	pthread_mutex_init(&font_list_mutex, NULL);
+
+	get_os_font_list_key(&key);
+	cache_key = key.array;
+
+	if (!load_font_cache(cache_key, &up_to_date)) {
+		/* nothing to fall back on, so the fonts have to be scanned
+		 * before any text can be drawn */
+		if (scan_fonts(ft2_lib))
+			da_move(font_list, scan_list);
+
+	} else if (!up_to_date) {
+		rescan_thread_active = pthread_create(&rescan_thread, NULL,
+				rescan_fonts_thread, NULL) == 0;
+	}
+}
+
 void free_os_font_list(void)
 {
+	if (rescan_thread_active) {
+		rescan_canceled = true;
+		pthread_join(rescan_thread, NULL);
+		rescan_thread_active = false;
+	}
+
+	pthread_mutex_destroy(&font_list_mutex);
+
 	for (size_t i = 0; i < font_list.num; i++)
 		font_path_info_free(font_list.array + i);
+	for (size_t i = 0; i < stale_list.num; i++)
+		font_path_info_free(stale_list.array + i);
 	da_free(font_list);
+	da_free(stale_list);
+
+	bfree(cache_key);
+	cache_key = NULL;
 }
 
 static inline size_t get_rating(struct font_path_info *info, struct dstr *cmp)
@@ -171,6 +431,8 @@ const char *get_font_path(const char *family, uint16_t size, const char *style,
 		dstr_cat_dstr(&face_and_style, &style_str);
 	}
 
+	pthread_mutex_lock(&font_list_mutex);
+
 	for (size_t i = 0; i < font_list.num; i++) {
 		struct font_path_info *info = font_list.array + i;
 
@@ -199,6 +461,8 @@ const char *get_font_path(const char *family, uint16_t size, const char *style,
 		}
 	}
 
+	pthread_mutex_unlock(&font_list_mutex);
+
 	dstr_free(&style_str);
 	dstr_free(&face_and_style);
 	return best_path;
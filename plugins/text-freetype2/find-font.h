@@ -34,6 +34,15 @@ static inline void font_path_info_free(struct font_path_info *info)
 extern void build_font_path_info(FT_Face face, FT_Long idx, const char *path);
 extern char *sfnt_name_to_utf8(FT_SfntName *sfnt_name);
 
+/* implemented per platform, scan_os_font_list calls build_font_path_info for
+ * every installed font and should stop early if os_font_scan_canceled
+ * returns true */
+extern void scan_os_font_list(FT_Library lib);
+extern void get_os_font_list_key(struct dstr *key);
+
+extern void add_font_dir_key(struct dstr *key, const char *dir);
+extern bool os_font_scan_canceled(void);
+
 extern void load_os_font_list(void);
 extern void free_os_font_list(void);
 extern const char *get_font_path(const char *family, uint16_t size,
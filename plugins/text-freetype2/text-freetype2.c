@@ -31,6 +31,9 @@ OBS_MODULE_USE_DEFAULT_LOCALE("text-freetype2", "en-US")
 
 uint32_t texbuf_w = 2048, texbuf_h = 2048;
 
+/* appends are read incrementally, so the file can be checked often */
+#define FILE_CHECK_INTERVAL 250000000ULL
+
 static struct obs_source_info freetype2_source_info = {
 	.id = "text_ft2_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
@@ -56,6 +59,7 @@ bool obs_module_load()
 	}
 
 	load_os_font_list();
+	init_atlas_cache();
 
 	obs_register_source(&freetype2_source_info);
 
@@ -64,6 +68,7 @@ bool obs_module_load()
 
 void obs_module_unload(void)
 {
+	free_atlas_cache();
 	free_os_font_list();
 	FT_Done_FreeType(ft2_lib);
 }
@@ -141,17 +146,8 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-	
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	ft2_atlas_release(srcdata->atlas);
+	srcdata->atlas = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -159,19 +155,15 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->colorbuf != NULL)
 		bfree(srcdata->colorbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
+	bfree(srcdata->layout_text);
+	da_free(srcdata->pens);
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -191,14 +183,15 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL) return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL) return;
+	if (srcdata->atlas == NULL || srcdata->atlas->tex == NULL ||
+	    srcdata->vbuf == NULL) return;
 
 	gs_reset_blend_state();
 	if (srcdata->outline_text) draw_outlines(srcdata);
 	if (srcdata->drop_shadow) draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-		srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+		srcdata->draw_effect, srcdata->num_glyphs * 6);
 
 	UNUSED_PARAMETER(effect);
 }
@@ -209,16 +202,19 @@ static void ft2_video_tick(void *data, float seconds)
 	if (srcdata == NULL) return;
 	if (!srcdata->from_file || !srcdata->text_file) return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
+	if (os_gettime_ns() - srcdata->last_checked >= FILE_CHECK_INTERVAL) {
 		srcdata->last_checked = os_gettime_ns();
 
-		if (srcdata->m_timestamp != t) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata,
-					srcdata->text_file);
+		if (text_file_changed(srcdata)) {
+			const char *file = srcdata->text_file;
+
+			if (!append_text_from_file(srcdata, file)) {
+				if (srcdata->log_mode)
+					read_from_end(srcdata, file);
+				else
+					load_text_from_file(srcdata, file);
+			}
+			cache_glyphs(srcdata->atlas, srcdata->text);
 			set_up_vertex_buffer(srcdata);
 		}
 	}
@@ -226,22 +222,6 @@ static void ft2_video_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
-static bool init_font(struct ft2_source *srcdata)
-{
-	FT_Long index;
-	const char *path = get_font_path(srcdata->font_name, srcdata->font_size,
-			srcdata->font_style, srcdata->font_flags, &index);
-	if (!path)
-		return false;
-
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
-}
-
 static void ft2_source_update(void *data, obs_data_t *settings)
 {
 	struct ft2_source *srcdata = data;
@@ -334,7 +314,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		bfree(srcdata->font_style);
 		srcdata->font_name = NULL;
 		srcdata->font_style = NULL;
-		srcdata->max_h = 0;
 	}
 
 	srcdata->font_name  = bstrdup(font_name);
@@ -342,24 +321,19 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->font_size  = font_size;
 	srcdata->font_flags = font_flags;
 
-	if (!init_font(srcdata) || srcdata->font_face == NULL) {
+	ft2_atlas_release(srcdata->atlas);
+	srcdata->atlas = ft2_atlas_acquire(font_name, font_style, font_flags,
+			font_size);
+
+	/* the glyphs of the previous layout came from the old atlas */
+	bfree(srcdata->layout_text);
+	srcdata->layout_text = NULL;
+	if (!srcdata->atlas) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s",
 			srcdata->font_name);
 		goto error;
 	}
-	else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size); 
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
-	}
-
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_w * texbuf_h * 4);
 
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
 skip_font_load:;
 	if (from_file) {
 		const char *tmp = obs_data_get_string(settings, "text_file");
@@ -395,8 +369,8 @@ skip_font_load:;
 		os_utf8_to_wcs_ptr(tmp, strlen(tmp), &srcdata->text);
 	}
 
-	if (srcdata->font_face) {
-		cache_glyphs(srcdata, srcdata->text);
+	if (srcdata->atlas) {
+		cache_glyphs(srcdata->atlas, srcdata->text);
 		set_up_vertex_buffer(srcdata);
 	}
 
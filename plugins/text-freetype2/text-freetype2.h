@@ -16,10 +16,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
 #include <obs-module.h>
+#include <util/threading.h>
+#include <util/darray.h>
 #include <ft2build.h>
+#include FT_FREETYPE_H
 
 #define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
+#define src_glyph srcdata->atlas->cacheglyphs[glyph_index]
 
 struct glyph_info {
 	float u, v, u2, v2;
@@ -27,6 +30,43 @@ struct glyph_info {
 	int32_t xadv;
 };
 
+/*
+ * Glyphs of one font face, size and style, shared by every source that uses
+ * that font.  Glyphs are only ever added, so a glyph keeps its place in the
+ * texture for as long as the atlas exists.  The mutex protects the face and
+ * the glyphs.  When the graphics context is needed as well, it must be
+ * entered before locking the atlas.
+ */
+struct ft2_atlas {
+	char *key;
+	long refs;
+
+	pthread_mutex_t mutex;
+	FT_Face font_face;
+	uint32_t max_h;
+
+	uint32_t *texbuf;
+	uint32_t texbuf_x, texbuf_y;
+	bool full;
+	DARRAY(struct gs_rect) dirty_rects;
+	gs_texture_t *tex;
+
+	struct glyph_info *cacheglyphs[num_cache_slots];
+};
+
+/* everything that affects the glyph positions besides the text */
+struct ft2_layout_params {
+	uint32_t line_h;
+	uint32_t custom_width;
+	uint32_t color[2];
+};
+
+/* layout state before a character */
+struct ft2_pen {
+	uint32_t dx, dy, max_y;
+	uint32_t glyph;
+};
+
 struct ft2_source {
 	char     *font_name;
 	char     *font_style;
@@ -39,22 +79,26 @@ struct ft2_source {
 	wchar_t *text;
 	time_t m_timestamp;
 	uint64_t last_checked;
+	int64_t file_size;
 
-	uint32_t cx, cy, max_h, custom_width;
-	uint32_t texbuf_x, texbuf_y;
+	/* how much of the file is in text, 0 if it has to be read again */
+	int64_t file_offset;
+
+	uint32_t cx, cy, custom_width;
 	uint32_t color[2];
 	uint32_t *colorbuf;
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
+	struct ft2_atlas *atlas;
 
-	struct glyph_info *cacheglyphs[num_cache_slots];
-
-	FT_Face	font_face;
-
-	uint32_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t num_glyphs, max_glyphs;
+
+	/* the previous layout, reused up to the first changed character */
+	wchar_t *layout_text;
+	struct ft2_layout_params layout_params;
+	DARRAY(struct ft2_pen) pens;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -84,11 +128,20 @@ static const char *ft2_source_get_name(void);
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
 time_t get_modified_timestamp(char *filename);
+bool text_file_changed(struct ft2_source *srcdata);
 void load_text_from_file(struct ft2_source *srcdata, const char *filename);
 void read_from_end(struct ft2_source *srcdata, const char *filename);
+bool append_text_from_file(struct ft2_source *srcdata, const char *filename);
+
+void init_atlas_cache(void);
+void free_atlas_cache(void);
+struct ft2_atlas *ft2_atlas_acquire(const char *font_name,
+		const char *font_style, uint32_t font_flags,
+		uint16_t font_size);
+void ft2_atlas_release(struct ft2_atlas *atlas);
+void ft2_atlas_upload(struct ft2_atlas *atlas);
 
-void cache_standard_glyphs(struct ft2_source *srcdata);
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
+void cache_glyphs(struct ft2_atlas *atlas, const wchar_t *cache_glyphs);
 
 void set_up_vertex_buffer(struct ft2_source *srcdata);
 void fill_vertex_buffer(struct ft2_source *srcdata);
@@ -17,11 +17,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
+#include "find-font.h"
 
 float offsets[16] = { -2.0f, 0.0f, 0.0f, -2.0f, 2.0f, 0.0f, 2.0f, 0.0f,
 	0.0f, 2.0f, 0.0f, 2.0f, -2.0f, 0.0f, -2.0f, 0.0f };
@@ -45,9 +48,8 @@ void draw_outlines(struct ft2_source *srcdata)
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
 			0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-			srcdata->draw_effect,
-			(uint32_t)wcslen(srcdata->text) * 6);
+		draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+			srcdata->draw_effect, srcdata->num_glyphs * 6);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -70,45 +72,23 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-		srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex,
+		srcdata->draw_effect, srcdata->num_glyphs * 6);
 	gs_matrix_identity();
 	gs_matrix_pop();
 
 	vdata->colors = tmp;
 }
 
-void set_up_vertex_buffer(struct ft2_source *srcdata)
+/* must be called with the atlas locked */
+static void wrap_text(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
-	size_t len;
-
-	if (!srcdata->text)
-		return;
-
-	if (srcdata->custom_width >= 100)
-		srcdata->cx = srcdata->custom_width;
-	else
-		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
-	srcdata->cy = srcdata->max_h;
-
-	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
-	srcdata->vbuf = create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6,
-			true);
-
-	if (srcdata->custom_width <= 100) goto skip_word_wrap;
-	if (!srcdata->word_wrap) goto skip_word_wrap;
-
-	len = wcslen(srcdata->text);
+	size_t len = wcslen(srcdata->text);
 
 	for (uint32_t i = 0; i <= len; i++) {
-		if (i == wcslen(srcdata->text)) goto eos_check;
+		if (i == len) goto eos_check;
 
 		if (srcdata->text[i] != L' ' && srcdata->text[i] != L'\n')
 			goto next_char;
@@ -119,7 +99,7 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 				srcdata->text[space_pos] = L'\n';
 			x = 0;
 		}
-		if (i == wcslen(srcdata->text)) goto eos_skip;
+		if (i == len) goto eos_skip;
 
 		x += word_width;
 		word_width = 0;
@@ -128,192 +108,405 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 		if (srcdata->text[i] == L' ')
 			space_pos = i;
 	next_char:;
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
+		glyph_index = FT_Get_Char_Index(srcdata->atlas->font_face,
 			srcdata->text[i]);
-		word_width += src_glyph->xadv;
+		if (src_glyph != NULL)
+			word_width += src_glyph->xadv;
 	eos_skip:;
 	}
+}
+
+/* vertex buffers grow in steps so that a ticker or clock that changes length
+ * by a few characters doesn't recreate its buffer every time */
+#define GLYPH_ALLOC_STEP 64
+
+static bool reserve_glyphs(struct ft2_source *srcdata, size_t len)
+{
+	uint32_t max_glyphs;
+
+	if (srcdata->vbuf && len <= srcdata->max_glyphs)
+		return true;
+
+	max_glyphs = (uint32_t)((len + GLYPH_ALLOC_STEP) &
+			~(size_t)(GLYPH_ALLOC_STEP - 1));
+
+	gs_vertexbuffer_destroy(srcdata->vbuf);
+	srcdata->vbuf = create_uv_vbuffer(max_glyphs * 6, true);
+	srcdata->max_glyphs = srcdata->vbuf ? max_glyphs : 0;
+	srcdata->num_glyphs = 0;
+
+	/* the new buffer is empty, so nothing of the old layout is left */
+	bfree(srcdata->layout_text);
+	srcdata->layout_text = NULL;
+
+	bfree(srcdata->colorbuf);
+	srcdata->colorbuf = NULL;
+
+	if (!srcdata->vbuf)
+		return false;
+
+	srcdata->colorbuf = bmalloc(sizeof(uint32_t) * max_glyphs * 6);
+	for (size_t i = 0; i < (size_t)max_glyphs * 6; i++)
+		srcdata->colorbuf[i] = 0xFF000000;
+
+	return true;
+}
+
+void set_up_vertex_buffer(struct ft2_source *srcdata)
+{
+	struct ft2_atlas *atlas = srcdata->atlas;
+
+	if (!srcdata->text || !atlas)
+		return;
+
+	obs_enter_graphics();
+
+	ft2_atlas_upload(atlas);
+
+	if (reserve_glyphs(srcdata, wcslen(srcdata->text))) {
+		pthread_mutex_lock(&atlas->mutex);
+
+		if (srcdata->custom_width >= 100)
+			srcdata->cx = srcdata->custom_width;
+		else
+			srcdata->cx = get_ft2_text_width(srcdata->text,
+					srcdata);
+
+		if (srcdata->custom_width > 100 && srcdata->word_wrap)
+			wrap_text(srcdata);
+
+		fill_vertex_buffer(srcdata);
+		pthread_mutex_unlock(&atlas->mutex);
+	}
 
-skip_word_wrap:;
-	fill_vertex_buffer(srcdata);
 	obs_leave_graphics();
 }
 
+/* must be called with the atlas locked */
 void fill_vertex_buffer(struct ft2_source *srcdata)
 {
+	struct ft2_atlas *atlas = srcdata->atlas;
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
 	if (vdata == NULL || !srcdata->text) return;
 
 	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
 	uint32_t *col = (uint32_t *)vdata->colors;
+	const wchar_t *text = srcdata->text;
 
 	FT_UInt glyph_index = 0;
 
-	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
-	uint32_t cur_glyph = 0;
-	size_t len = wcslen(srcdata->text);
-
-	if (srcdata->colorbuf != NULL) {
-		bfree(srcdata->colorbuf);
-		srcdata->colorbuf = NULL;
-	}
-	srcdata->colorbuf = bzalloc(sizeof(uint32_t)*wcslen(srcdata->text) * 6);
-	for (size_t i = 0; i < len * 6; i++) {
-		srcdata->colorbuf[i] = 0xFF000000;
+	struct ft2_layout_params params = {
+		atlas->max_h,
+		srcdata->custom_width,
+		{srcdata->color[0], srcdata->color[1]}
+	};
+	struct ft2_pen pen = {0, atlas->max_h, atlas->max_h, 0};
+	size_t len = wcslen(text);
+	size_t i = 0;
+
+	/* glyphs before the first changed character keep their positions, so
+	 * layout continues from the pen position saved there */
+	if (srcdata->layout_text &&
+	    memcmp(&params, &srcdata->layout_params, sizeof(params)) == 0) {
+		const wchar_t *prev = srcdata->layout_text;
+
+		while (i < len && prev[i] == text[i])
+			i++;
+		pen = srcdata->pens.array[i];
 	}
 
-	for (size_t i = 0; i < len; i++) {
-	add_linebreak:;
-		if (srcdata->text[i] != L'\n') goto draw_glyph;
-		dx = 0; i++;
-		dy += srcdata->max_h + 4;
-		if (i == wcslen(srcdata->text)) goto skip_glyph;
-		if (srcdata->text[i] == L'\n') goto add_linebreak;
-	draw_glyph:;
+	da_resize(srcdata->pens, len + 1);
+
+	for (; i < len; i++) {
+		srcdata->pens.array[i] = pen;
+
+		if (text[i] == L'\n') {
+			pen.dx = 0;
+			pen.dy += atlas->max_h + 4;
+			continue;
+		}
+
 		// Skip filthy dual byte Windows line breaks
-		if (srcdata->text[i] == L'\r') goto skip_glyph;
+		if (text[i] == L'\r')
+			continue;
 
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
-			srcdata->text[i]);
+		glyph_index = FT_Get_Char_Index(atlas->font_face, text[i]);
 		if (src_glyph == NULL)
-			goto skip_glyph;
-
-		if (srcdata->custom_width < 100) goto skip_custom_width;
+			continue;
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
-			dx = 0;
-			dy += srcdata->max_h + 4;
+		if (srcdata->custom_width >= 100 &&
+		    pen.dx + src_glyph->xadv > srcdata->custom_width) {
+			pen.dx = 0;
+			pen.dy += atlas->max_h + 4;
 		}
 
-	skip_custom_width:;
-
-		set_v3_rect(vdata->points + (cur_glyph * 6),
-			(float)dx + (float)src_glyph->xoff,
-			(float)dy - (float)src_glyph->yoff,
+		set_v3_rect(vdata->points + (pen.glyph * 6),
+			(float)pen.dx + (float)src_glyph->xoff,
+			(float)pen.dy - (float)src_glyph->yoff,
 			(float)src_glyph->w,
 			(float)src_glyph->h);
-		set_v2_uv(tvarray + (cur_glyph * 6),
+		set_v2_uv(tvarray + (pen.glyph * 6),
 			src_glyph->u,
 			src_glyph->v,
 			src_glyph->u2,
 			src_glyph->v2);
-		set_rect_colors2(col + (cur_glyph * 6),
+		set_rect_colors2(col + (pen.glyph * 6),
 			srcdata->color[0],
 			srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
-		cur_glyph++;
-	skip_glyph:;
+		pen.dx += src_glyph->xadv;
+		if ((float)pen.dy - (float)src_glyph->yoff + src_glyph->h >
+				pen.max_y)
+			pen.max_y = pen.dy - src_glyph->yoff + src_glyph->h;
+		pen.glyph++;
 	}
 
-	srcdata->cy = max_y;
+	srcdata->pens.array[len] = pen;
+	srcdata->num_glyphs      = pen.glyph;
+	srcdata->cy              = pen.max_y;
+	srcdata->layout_params   = params;
+
+	bfree(srcdata->layout_text);
+	srcdata->layout_text = bwstrdup(text);
 }
 
-void cache_standard_glyphs(struct ft2_source *srcdata)
+/* ------------------------------------------------------------------------- */
+
+static pthread_mutex_t atlas_cache_mutex;
+static DARRAY(struct ft2_atlas*) atlas_cache;
+
+void init_atlas_cache(void)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
+	pthread_mutex_init(&atlas_cache_mutex, NULL);
+}
+
+void free_atlas_cache(void)
+{
+	da_free(atlas_cache);
+	pthread_mutex_destroy(&atlas_cache_mutex);
+}
+
+static const wchar_t *standard_glyphs = L"abcdefghijklmnopqrstuvwxyz" \
+	L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890" \
+	L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0";
+
+/* must be called with the atlas cache locked, FT_New_Face and FT_Done_Face
+ * aren't thread safe */
+static struct ft2_atlas *create_atlas(const char *key, const char *font_name,
+		const char *font_style, uint32_t font_flags,
+		uint16_t font_size)
+{
+	struct ft2_atlas *atlas;
+	FT_Long index;
+	const char *path = get_font_path(font_name, font_size, font_style,
+			font_flags, &index);
+	if (!path)
+		return NULL;
+
+	atlas = bzalloc(sizeof(struct ft2_atlas));
+
+	if (FT_New_Face(ft2_lib, path, index, &atlas->font_face) != 0) {
+		bfree(atlas);
+		return NULL;
+	}
+	if (pthread_mutex_init(&atlas->mutex, NULL) != 0) {
+		FT_Done_Face(atlas->font_face);
+		bfree(atlas);
+		return NULL;
+	}
+
+	FT_Set_Pixel_Sizes(atlas->font_face, 0, font_size);
+	FT_Select_Charmap(atlas->font_face, FT_ENCODING_UNICODE);
+
+	atlas->key    = bstrdup(key);
+	atlas->refs   = 1;
+	atlas->texbuf = bzalloc(texbuf_w * texbuf_h * 4);
+
+	cache_glyphs(atlas, standard_glyphs);
+	return atlas;
+}
+
+struct ft2_atlas *ft2_atlas_acquire(const char *font_name,
+		const char *font_style, uint32_t font_flags,
+		uint16_t font_size)
+{
+	struct ft2_atlas *atlas = NULL;
+	struct dstr key = {0};
+
+	dstr_printf(&key, "%s\n%s\n%u\n%u", font_name, font_style,
+			font_flags, (unsigned int)font_size);
+
+	pthread_mutex_lock(&atlas_cache_mutex);
+
+	for (size_t i = 0; i < atlas_cache.num; i++) {
+		if (strcmp(atlas_cache.array[i]->key, key.array) == 0) {
+			atlas = atlas_cache.array[i];
+			atlas->refs++;
+			break;
 		}
 	}
 
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
+	if (!atlas) {
+		atlas = create_atlas(key.array, font_name, font_style,
+				font_flags, font_size);
+		if (atlas)
+			da_push_back(atlas_cache, &atlas);
+	}
 
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz" \
-		L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890" \
-		L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
+	pthread_mutex_unlock(&atlas_cache_mutex);
+
+	dstr_free(&key);
+	return atlas;
+}
+
+void ft2_atlas_release(struct ft2_atlas *atlas)
+{
+	bool destroy;
+
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&atlas_cache_mutex);
+	destroy = --atlas->refs == 0;
+	if (destroy) {
+		da_erase_item(atlas_cache, &atlas);
+		FT_Done_Face(atlas->font_face);
+	}
+	pthread_mutex_unlock(&atlas_cache_mutex);
+
+	if (!destroy)
+		return;
+
+	obs_enter_graphics();
+	gs_texture_destroy(atlas->tex);
+	obs_leave_graphics();
+
+	for (uint32_t i = 0; i < num_cache_slots; i++)
+		bfree(atlas->cacheglyphs[i]);
+
+	da_free(atlas->dirty_rects);
+	pthread_mutex_destroy(&atlas->mutex);
+	bfree(atlas->texbuf);
+	bfree(atlas->key);
+	bfree(atlas);
+}
+
+/* uploads the glyphs added since the last upload, needs graphics */
+void ft2_atlas_upload(struct ft2_atlas *atlas)
+{
+	pthread_mutex_lock(&atlas->mutex);
+
+	if (!atlas->dirty_rects.num && atlas->tex)
+		goto exit;
+
+	/* only upload the newly cached glyphs if possible */
+	if (atlas->tex != NULL &&
+	    gs_texture_set_image_regions(atlas->tex,
+			(const uint8_t *)atlas->texbuf, texbuf_w * 4,
+			atlas->dirty_rects.array, atlas->dirty_rects.num))
+		goto clear;
+
+	gs_texture_destroy(atlas->tex);
+	atlas->tex = gs_texture_create(texbuf_w, texbuf_h, GS_RGBA, 1,
+			(const uint8_t **)&atlas->texbuf, 0);
+
+clear:
+	da_resize(atlas->dirty_rects, 0);
+exit:
+	pthread_mutex_unlock(&atlas->mutex);
 }
 
 #define glyph_pos x + (y*slot->bitmap.pitch)
 #define buf_pos (dx + x) + ((dy + y) * texbuf_w)
 
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+/* rasterizes the glyphs that aren't in the atlas yet, they're uploaded with
+ * the next ft2_atlas_upload */
+void cache_glyphs(struct ft2_atlas *atlas, const wchar_t *cache_glyphs)
 {
 	FT_GlyphSlot slot;
 	FT_UInt glyph_index = 0;
 
-	if (!srcdata->font_face || !cache_glyphs)
+	if (!atlas || !cache_glyphs)
 		return;
 
-	slot = srcdata->font_face->glyph;
+	pthread_mutex_lock(&atlas->mutex);
+
+	slot = atlas->font_face->glyph;
 
-	uint32_t dx = srcdata->texbuf_x, dy = srcdata->texbuf_y;
+	uint32_t dx = atlas->texbuf_x, dy = atlas->texbuf_y;
 	uint8_t alpha;
 
-	int32_t cached_glyphs = 0;
 	size_t len = wcslen(cache_glyphs);
 
-	for (size_t i = 0; i < len; i++) {
-		glyph_index = FT_Get_Char_Index(srcdata->font_face,
+	for (size_t i = 0; i < len && !atlas->full; i++) {
+		struct glyph_info *glyph;
+
+		glyph_index = FT_Get_Char_Index(atlas->font_face,
 			cache_glyphs[i]);
 
-		if (src_glyph != NULL)
-			goto skip_glyph;
+		if (atlas->cacheglyphs[glyph_index] != NULL)
+			continue;
 
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
+		FT_Load_Glyph(atlas->font_face, glyph_index, FT_LOAD_DEFAULT);
 		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
 
 		uint32_t g_w = slot->bitmap.width;
 		uint32_t g_h = slot->bitmap.rows;
 
-		if (srcdata->max_h < g_h) srcdata->max_h = g_h;
+		if (atlas->max_h < g_h) atlas->max_h = g_h;
 
 		if (dx + g_w >= texbuf_w) {
 			dx = 0;
-			dy += srcdata->max_h + 1;
+			dy += atlas->max_h + 1;
+		}
+
+		if (dy + g_h >= texbuf_h) {
+			blog(LOG_WARNING, "FT2-text: Glyph atlas is full, "
+			                  "some characters will be missing");
+			atlas->full = true;
+			break;
 		}
 
-		src_glyph = bzalloc(sizeof(struct glyph_info));
-		src_glyph->u = (float)dx / (float)texbuf_w;
-		src_glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-		src_glyph->v = (float)dy / (float)texbuf_h;
-		src_glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-		src_glyph->w = g_w;
-		src_glyph->h = g_h;
-		src_glyph->yoff = slot->bitmap_top;
-		src_glyph->xoff = slot->bitmap_left;
-		src_glyph->xadv = slot->advance.x >> 6;
+		glyph = bzalloc(sizeof(struct glyph_info));
+		glyph->u = (float)dx / (float)texbuf_w;
+		glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
+		glyph->v = (float)dy / (float)texbuf_h;
+		glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
+		glyph->w = g_w;
+		glyph->h = g_h;
+		glyph->yoff = slot->bitmap_top;
+		glyph->xoff = slot->bitmap_left;
+		glyph->xadv = slot->advance.x >> 6;
 
 		for (uint32_t y = 0; y < g_h; y++) {
 			for (uint32_t x = 0; x < g_w; x++) {
 				alpha = slot->bitmap.buffer[glyph_pos];
-				srcdata->texbuf[buf_pos] =
+				atlas->texbuf[buf_pos] =
 					0x00FFFFFF ^ (alpha << 24);
 			}
 		}
 
+		if (g_w && g_h) {
+			struct gs_rect *rect =
+				da_push_back_new(atlas->dirty_rects);
+			rect->x  = (int)dx;
+			rect->y  = (int)dy;
+			rect->cx = (int)g_w;
+			rect->cy = (int)g_h;
+		}
+
+		atlas->cacheglyphs[glyph_index] = glyph;
+
 		dx += (g_w + 1);
 		if (dx >= texbuf_w) {
 			dx = 0;
-			dy += srcdata->max_h;
+			dy += atlas->max_h;
 		}
-
-		cached_glyphs++;
-	skip_glyph:;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
+	atlas->texbuf_x = dx;
+	atlas->texbuf_y = dy;
 
-	if (cached_glyphs > 0) {
-
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = NULL;
-			tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h,
-			GS_RGBA, 1, (const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
+	pthread_mutex_unlock(&atlas->mutex);
 }
 
 time_t get_modified_timestamp(char *filename)
@@ -327,6 +520,23 @@ time_t get_modified_timestamp(char *filename)
 	return stats.st_mtime;
 }
 
+/* checks the size as well, since the time stamp only has a resolution of a
+ * second and files can be appended to more often than that */
+bool text_file_changed(struct ft2_source *srcdata)
+{
+	struct stat stats;
+
+	if (stat(srcdata->text_file, &stats) != 0)
+		return false;
+
+	if (stats.st_mtime == srcdata->m_timestamp &&
+	    (int64_t)stats.st_size == srcdata->file_size)
+		return false;
+
+	srcdata->file_size = (int64_t)stats.st_size;
+	return true;
+}
+
 static void remove_cr(wchar_t* source)
 {
 	int j = 0;
@@ -370,6 +580,7 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 
 		srcdata->m_timestamp =
 			get_modified_timestamp(srcdata->text_file);
+		srcdata->file_offset = 0;
 		bfree(tmp_read);
 		fclose(tmp_file);
 
@@ -378,6 +589,7 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 
 	fseek(tmp_file, 0, SEEK_SET);
 	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
+	srcdata->file_offset = filesize;
 
 	tmp_read = bzalloc(filesize + 1);
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
@@ -457,6 +669,7 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 		remove_cr(srcdata->text);
 		srcdata->m_timestamp =
 			get_modified_timestamp(srcdata->text_file);
+		srcdata->file_offset = 0;
 		bfree(tmp_read);
 		fclose(tmp_file);
 
@@ -477,12 +690,122 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 	remove_cr(srcdata->text);
 	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
+	srcdata->file_offset = filesize;
 	bfree(tmp_read);
 }
 
+/* a multi-byte character may only be partially written yet, so it's left
+ * for the next read */
+static size_t complete_utf8_size(const char *str, size_t size)
+{
+	size_t start = size;
+	size_t expected;
+	unsigned char lead;
+
+	while (start > 0 && size - start < 4 &&
+	       ((unsigned char)str[start - 1] & 0xC0) == 0x80)
+		start--;
+
+	if (start == 0)
+		return size;
+
+	lead = (unsigned char)str[start - 1];
+	if      ((lead & 0x80) == 0x00) expected = 1;
+	else if ((lead & 0xE0) == 0xC0) expected = 2;
+	else if ((lead & 0xF0) == 0xE0) expected = 3;
+	else if ((lead & 0xF8) == 0xF0) expected = 4;
+	else                            return size;
+
+	return (size - (start - 1) < expected) ? start - 1 : size;
+}
+
+/* keeps what follows the given number of line breaks from the end, which is
+ * what read_from_end reads */
+static void keep_last_lines(wchar_t *text, size_t line_breaks)
+{
+	size_t len = wcslen(text);
+	size_t pos = len;
+
+	while (pos > 0) {
+		if (text[pos - 1] == L'\n' && line_breaks-- == 0)
+			break;
+		pos--;
+	}
+
+	if (pos > 0)
+		memmove(text, text + pos, (len - pos + 1) * sizeof(wchar_t));
+}
+
+/*
+ * Reads only what was appended to the file since it was last read, so that
+ * the layout of the existing text can be kept.  Returns false if the whole
+ * file has to be read again, like when it was truncated or isn't UTF-8.
+ */
+bool append_text_from_file(struct ft2_source *srcdata, const char *filename)
+{
+	FILE *file;
+	int64_t size;
+	size_t read_size, used;
+	char *buf;
+	wchar_t *appended = NULL;
+	wchar_t *text;
+	size_t old_len, new_len;
+
+	if (!srcdata->text || srcdata->file_offset <= 0)
+		return false;
+
+	file = os_fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	os_fseeki64(file, 0, SEEK_END);
+	size = os_ftelli64(file);
+
+	if (size < srcdata->file_offset) {
+		fclose(file);
+		return false;
+	}
+
+	read_size = (size_t)(size - srcdata->file_offset);
+	buf = bmalloc(read_size + 1);
+
+	os_fseeki64(file, srcdata->file_offset, SEEK_SET);
+	read_size = fread(buf, 1, read_size, file);
+	fclose(file);
+
+	used = complete_utf8_size(buf, read_size);
+	buf[used] = 0;
+
+	srcdata->file_offset += (int64_t)used;
+	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
+
+	if (used)
+		os_utf8_to_wcs_ptr(buf, used, &appended);
+	bfree(buf);
+
+	if (!appended)
+		return true;
+
+	remove_cr(appended);
+
+	old_len = wcslen(srcdata->text);
+	new_len = wcslen(appended);
+	text = bmalloc((old_len + new_len + 1) * sizeof(wchar_t));
+	memcpy(text, srcdata->text, old_len * sizeof(wchar_t));
+	memcpy(text + old_len, appended, (new_len + 1) * sizeof(wchar_t));
+
+	bfree(appended);
+	bfree(srcdata->text);
+	srcdata->text = text;
+
+	if (srcdata->log_mode)
+		keep_last_lines(srcdata->text, 6);
+	return true;
+}
+
+/* uses the cached advances, must be called with the atlas locked */
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 {
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
 	FT_UInt glyph_index = 0;
 	uint32_t w = 0, max_w = 0;
 	size_t len;
@@ -492,14 +815,18 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 
 	len = wcslen(text);
 	for (size_t i = 0; i < len; i++) {
-		glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
-
-		if (text[i] == L'\n') w = 0;
-		else {
-			w += slot->advance.x >> 6;
-			if (w > max_w) max_w = w;
+		if (text[i] == L'\n') {
+			w = 0;
+			continue;
 		}
+
+		glyph_index = FT_Get_Char_Index(srcdata->atlas->font_face,
+				text[i]);
+		if (src_glyph == NULL)
+			continue;
+
+		w += src_glyph->xadv;
+		if (w > max_w) max_w = w;
 	}
 
 	return max_w;
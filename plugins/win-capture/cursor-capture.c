@@ -131,40 +131,64 @@ static inline uint8_t *cursor_capture_icon_bitmap(ICONINFO *ii,
 	return output;
 }
 
-static inline bool cursor_capture_icon(struct cursor_data *data, HICON icon)
+static inline void cursor_capture_icon(struct cached_cursor *cc, HICON icon)
 {
-	bool success = false;
 	uint8_t *bitmap;
 	uint32_t height;
 	uint32_t width;
 	ICONINFO ii;
 
-	gs_texture_destroy(data->texture);
-	data->texture = NULL;
-
-	if (!icon) {
-		return false;
-	}
 	if (!GetIconInfo(icon, &ii)) {
-		return false;
+		return;
 	}
 
 	bitmap = cursor_capture_icon_bitmap(&ii, &width, &height);
 	if (bitmap) {
-		data->texture = gs_texture_create(width, height, GS_BGRA,
+		cc->texture = gs_texture_create(width, height, GS_BGRA,
 				1, &bitmap, 0);
 		bfree(bitmap);
 	}
 
+	cc->x_hotspot = ii.xHotspot;
+	cc->y_hotspot = ii.yHotspot;
+
 	DeleteObject(ii.hbmColor);
 	DeleteObject(ii.hbmMask);
-	return !!data->texture;
+}
+
+/* cursors are shared system wide and switched between constantly (arrow,
+ * I-beam, resize arrows), so their bitmaps are only read back once and kept
+ * until pushed out of the cache by other cursors */
+static struct cached_cursor *get_cached_cursor(struct cursor_data *data,
+		HCURSOR cursor)
+{
+	struct cached_cursor *cc = &data->cache[0];
+	HICON icon;
+
+	for (size_t i = 0; i < CURSOR_CACHE_SIZE; i++) {
+		if (data->cache[i].cursor == cursor)
+			return &data->cache[i];
+		if (data->cache[i].last_used < cc->last_used)
+			cc = &data->cache[i];
+	}
+
+	gs_texture_destroy(cc->texture);
+	memset(cc, 0, sizeof(*cc));
+	cc->cursor = cursor;
+
+	icon = CopyIcon(cursor);
+	if (icon) {
+		cursor_capture_icon(cc, icon);
+		DestroyIcon(icon);
+	}
+
+	return cc;
 }
 
 void cursor_capture(struct cursor_data *data)
 {
+	struct cached_cursor *cc;
 	CURSORINFO ci = {0};
-	HICON icon;
 
 	ci.cbSize = sizeof(ci);
 
@@ -175,16 +199,21 @@ void cursor_capture(struct cursor_data *data)
 
 	memcpy(&data->cursor_pos, &ci.ptScreenPos, sizeof(data->cursor_pos));
 
-	if (data->current_cursor == ci.hCursor) {
-		return;
+	if (data->current_cursor != ci.hCursor) {
+		data->current_cursor = ci.hCursor;
+		data->texture = NULL;
+
+		if (ci.hCursor) {
+			cc = get_cached_cursor(data, ci.hCursor);
+			cc->last_used = ++data->use_counter;
+
+			data->texture   = cc->texture;
+			data->x_hotspot = cc->x_hotspot;
+			data->y_hotspot = cc->y_hotspot;
+		}
 	}
 
-	icon = CopyIcon(ci.hCursor);
-	data->visible = cursor_capture_icon(data, icon);
-	data->current_cursor = ci.hCursor;
-	if ((ci.flags & CURSOR_SHOWING) == 0)
-		data->visible = false;
-	DestroyIcon(icon);
+	data->visible = data->texture && (ci.flags & CURSOR_SHOWING) != 0;
 }
 
 void cursor_draw(struct cursor_data *data, long x_offset, long y_offset,
@@ -203,6 +232,7 @@ void cursor_draw(struct cursor_data *data, long x_offset, long y_offset,
 
 void cursor_data_free(struct cursor_data *data)
 {
-	gs_texture_destroy(data->texture);
+	for (size_t i = 0; i < CURSOR_CACHE_SIZE; i++)
+		gs_texture_destroy(data->cache[i].texture);
 	memset(data, 0, sizeof(*data));
 }
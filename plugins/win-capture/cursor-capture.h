@@ -2,13 +2,27 @@
 
 #include <stdint.h>
 
-struct cursor_data {
+/* number of cursor images kept as textures */
+#define CURSOR_CACHE_SIZE 8
+
+struct cached_cursor {
+	HCURSOR                        cursor;
 	gs_texture_t                   *texture;
+	long                           x_hotspot;
+	long                           y_hotspot;
+	uint64_t                       last_used;
+};
+
+struct cursor_data {
+	gs_texture_t                   *texture; /* owned by the cache */
 	HCURSOR                        current_cursor;
 	POINT                          cursor_pos;
 	long                           x_hotspot;
 	long                           y_hotspot;
 	bool                           visible;
+
+	struct cached_cursor           cache[CURSOR_CACHE_SIZE];
+	uint64_t                       use_counter;
 };
 
 extern void cursor_capture(struct cursor_data *data);
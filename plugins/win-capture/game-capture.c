@@ -73,6 +73,7 @@ struct game_capture {
 	DWORD                         thread_id;
 	HWND                          next_window;
 	HWND                          window;
+	long                          window_generation;
 	float                         check_interval;
 	float                         fps_reset_interval;
 	bool                          active : 1;
@@ -81,6 +82,7 @@ struct game_capture {
 	bool                          error_aqcuiring : 1;
 	bool                          dwm_capture : 1;
 	bool                          initial_config : 1;
+	bool                          showing : 1;
 
 	struct game_capture_config    config;
 
@@ -97,6 +99,20 @@ struct game_capture {
 	HANDLE                        target_process;
 	HANDLE                        texture_mutexes[2];
 
+	/* shared memory frames are copied in to a pair of dynamic textures
+	 * by the copy thread.  the graphics thread only maps the texture
+	 * that's not being drawn, and swaps them once the copy is done */
+	gs_texture_t                  *shmem_textures[2];
+	int                           shmem_write_idx;
+	HANDLE                        copy_thread;
+	HANDLE                        copy_start;
+	HANDLE                        copy_done;
+	volatile bool                 copy_stop;
+	bool                          copy_pending;
+	bool                          copy_success;
+	uint8_t                       *copy_data;
+	uint32_t                      copy_pitch;
+
 	union {
 		struct {
 			struct shmem_data *shmem_data;
@@ -157,8 +173,31 @@ static inline HANDLE open_process(DWORD desired_access, bool inherit_handle,
 	return open_process_proc(desired_access, inherit_handle, process_id);
 }
 
+static void stop_shmem_copy(struct game_capture *gc)
+{
+	if (gc->copy_thread) {
+		gc->copy_stop = true;
+		SetEvent(gc->copy_start);
+		WaitForSingleObject(gc->copy_thread, INFINITE);
+		close_handle(&gc->copy_thread);
+	}
+
+	close_handle(&gc->copy_start);
+	close_handle(&gc->copy_done);
+
+	if (gc->copy_pending) {
+		obs_enter_graphics();
+		gs_texture_unmap(gc->shmem_textures[gc->shmem_write_idx]);
+		obs_leave_graphics();
+		gc->copy_pending = false;
+	}
+}
+
 static void stop_capture(struct game_capture *gc)
 {
+	/* the copy thread uses the texture mutexes and the mapped data */
+	stop_shmem_copy(gc);
+
 	ipc_pipe_server_free(&gc->pipe);
 
 	if (gc->hook_stop) {
@@ -184,13 +223,20 @@ static void stop_capture(struct game_capture *gc)
 	close_handle(&gc->texture_mutexes[0]);
 	close_handle(&gc->texture_mutexes[1]);
 
-	if (gc->texture) {
-		obs_enter_graphics();
-		gs_texture_destroy(gc->texture);
-		obs_leave_graphics();
-		gc->texture = NULL;
+	obs_enter_graphics();
+
+	for (size_t i = 0; i < 2; i++) {
+		if (gc->texture == gc->shmem_textures[i])
+			gc->texture = NULL;
+		gs_texture_destroy(gc->shmem_textures[i]);
+		gc->shmem_textures[i] = NULL;
 	}
 
+	gs_texture_destroy(gc->texture);
+	gc->texture = NULL;
+
+	obs_leave_graphics();
+
 	gc->copy_texture = NULL;
 	gc->active = false;
 }
@@ -318,6 +364,7 @@ static void game_capture_update(void *data, obs_data_t *settings)
 	free_config(&gc->config);
 	gc->config = cfg;
 	gc->activate_hook = obs_data_get_bool(settings, "activate_hook");
+	gc->window_generation = 0;
 
 	if (!gc->initial_config) {
 		if (reset_capture) {
@@ -476,12 +523,47 @@ static inline bool attempt_existing_hook(struct game_capture *gc)
 static inline void reset_frame_interval(struct game_capture *gc)
 {
 	struct obs_video_info ovi;
+	uint64_t obs_interval = 0;
 	uint64_t interval = 0;
 
-	if (gc->config.limit_framerate && obs_get_video_info(&ovi))
-		interval = ovi.fps_den * 1000000000ULL / ovi.fps_num;
+	if (obs_get_video_info(&ovi))
+		obs_interval = ovi.fps_den * 1000000000ULL / ovi.fps_num;
+	if (gc->config.limit_framerate)
+		interval = obs_interval;
 
-	gc->global_hook_info->frame_interval = interval;
+	gc->global_hook_info->frame_interval     = interval;
+	gc->global_hook_info->obs_frame_interval = obs_interval;
+}
+
+/* LUID of the adapter OBS renders with, 0 if it can't be determined */
+static uint64_t get_obs_adapter_luid(void)
+{
+	struct obs_video_info ovi;
+	IDXGIFactory1 *factory;
+	IDXGIAdapter1 *adapter;
+	DXGI_ADAPTER_DESC desc;
+	uint64_t luid = 0;
+	HRESULT hr;
+
+	if (!obs_get_video_info(&ovi))
+		return 0;
+
+	hr = CreateDXGIFactory1(&IID_IDXGIFactory1, (void**)&factory);
+	if (FAILED(hr))
+		return 0;
+
+	hr = factory->lpVtbl->EnumAdapters1(factory, ovi.adapter, &adapter);
+	if (SUCCEEDED(hr)) {
+		hr = adapter->lpVtbl->GetDesc(adapter, &desc);
+		if (SUCCEEDED(hr))
+			luid = ((uint64_t)(uint32_t)desc.AdapterLuid.HighPart
+					<< 32) | desc.AdapterLuid.LowPart;
+
+		adapter->lpVtbl->Release(adapter);
+	}
+
+	factory->lpVtbl->Release(factory);
+	return luid;
 }
 
 static inline bool init_hook_info(struct game_capture *gc)
@@ -509,6 +591,8 @@ static inline bool init_hook_info(struct game_capture *gc)
 	gc->global_hook_info->use_scale = gc->config.force_scaling;
 	gc->global_hook_info->cx = gc->config.scale_cx;
 	gc->global_hook_info->cy = gc->config.scale_cy;
+	gc->global_hook_info->capture_paused = !gc->showing;
+	gc->global_hook_info->obs_adapter_luid = get_obs_adapter_luid();
 	reset_frame_interval(gc);
 
 	obs_enter_graphics();
@@ -690,6 +774,12 @@ static void get_fullscreen_window(struct game_capture *gc)
 
 static void get_selected_window(struct game_capture *gc)
 {
+	/* the last search found nothing and no windows have changed since */
+	if (!windows_changed(&gc->window_generation)) {
+		gc->next_window = NULL;
+		return;
+	}
+
 	if (strcmpi(gc->config.class, "dwm") == 0) {
 		wchar_t class_w[512];
 		os_utf8_to_wcs(gc->config.class, 0, class_w, 512);
@@ -701,6 +791,10 @@ static void get_selected_window(struct game_capture *gc)
 				gc->config.title,
 				gc->config.executable);
 	}
+
+	/* search again next time in case the window doesn't get hooked */
+	if (gc->next_window)
+		gc->window_generation = 0;
 }
 
 static void try_hook(struct game_capture *gc)
@@ -793,16 +887,17 @@ static inline bool init_capture_data(struct game_capture *gc)
 	return true;
 }
 
-static void copy_shmem_tex(struct game_capture *gc)
+/* runs on the copy thread, the texture mutexes are owned by the thread that
+ * acquires them */
+static bool copy_shmem_frame(struct game_capture *gc, uint8_t *data,
+		uint32_t pitch)
 {
 	int cur_texture = gc->shmem_data->last_tex;
 	HANDLE mutex = NULL;
-	uint32_t pitch;
 	int next_texture;
-	uint8_t *data;
 
 	if (cur_texture < 0 || cur_texture > 1)
-		return;
+		return false;
 
 	next_texture = cur_texture == 1 ? 0 : 1;
 
@@ -814,49 +909,107 @@ static void copy_shmem_tex(struct game_capture *gc)
 		cur_texture = next_texture;
 
 	} else {
-		return;
+		return false;
 	}
 
-	if (gs_texture_map(gc->texture, &data, &pitch)) {
-		if (pitch == gc->pitch) {
-			memcpy(data, gc->texture_buffers[cur_texture],
-					pitch * gc->cy);
-		} else {
-			uint8_t *input = gc->texture_buffers[cur_texture];
-			uint32_t best_pitch =
-				pitch < gc->pitch ? pitch : gc->pitch;
+	if (pitch == gc->pitch) {
+		memcpy(data, gc->texture_buffers[cur_texture], pitch * gc->cy);
+	} else {
+		uint8_t *input = gc->texture_buffers[cur_texture];
+		uint32_t best_pitch = pitch < gc->pitch ? pitch : gc->pitch;
 
-			for (uint32_t y = 0; y < gc->cy; y++) {
-				uint8_t *line_in = input + gc->pitch * y;
-				uint8_t *line_out = data + pitch * y;
-				memcpy(line_out, line_in, best_pitch);
-			}
+		for (uint32_t y = 0; y < gc->cy; y++) {
+			uint8_t *line_in = input + gc->pitch * y;
+			uint8_t *line_out = data + pitch * y;
+			memcpy(line_out, line_in, best_pitch);
 		}
-
-		gs_texture_unmap(gc->texture);
 	}
 
 	ReleaseMutex(mutex);
+	return true;
+}
+
+static DWORD WINAPI shmem_copy_thread(void *param)
+{
+	struct game_capture *gc = param;
+
+	for (;;) {
+		WaitForSingleObject(gc->copy_start, INFINITE);
+		if (gc->copy_stop)
+			break;
+
+		gc->copy_success = copy_shmem_frame(gc, gc->copy_data,
+				gc->copy_pitch);
+		SetEvent(gc->copy_done);
+	}
+
+	return 0;
+}
+
+/* never waits on the copy thread, a frame that's still being copied is
+ * simply picked up on a later tick */
+static void copy_shmem_tex(struct game_capture *gc)
+{
+	gs_texture_t *target = gc->shmem_textures[gc->shmem_write_idx];
+
+	if (gc->copy_pending) {
+		if (!object_signalled(gc->copy_done))
+			return;
+
+		gs_texture_unmap(target);
+		gc->copy_pending = false;
+
+		if (gc->copy_success) {
+			gc->texture = target;
+			gc->shmem_write_idx = gc->shmem_write_idx == 1 ? 0 : 1;
+			target = gc->shmem_textures[gc->shmem_write_idx];
+		}
+	}
+
+	if (gs_texture_map(target, &gc->copy_data, &gc->copy_pitch)) {
+		gc->copy_pending = true;
+		SetEvent(gc->copy_start);
+	}
 }
 
 static inline bool init_shmem_capture(struct game_capture *gc)
 {
+	enum gs_color_format format =
+		convert_format(gc->global_hook_info->format);
+
 	gc->texture_buffers[0] =
 		(uint8_t*)gc->data + gc->shmem_data->tex1_offset;
 	gc->texture_buffers[1] =
 		(uint8_t*)gc->data + gc->shmem_data->tex2_offset;
 
 	obs_enter_graphics();
-	gc->texture = gs_texture_create(gc->cx, gc->cy,
-			convert_format(gc->global_hook_info->format),
-			1, NULL, GS_DYNAMIC);
+	for (size_t i = 0; i < 2; i++)
+		gc->shmem_textures[i] = gs_texture_create(gc->cx, gc->cy,
+				format, 1, NULL, GS_DYNAMIC);
 	obs_leave_graphics();
 
-	if (!gc->texture) {
+	if (!gc->shmem_textures[0] || !gc->shmem_textures[1]) {
 		warn("init_shmem_capture: failed to create texture");
 		return false;
 	}
 
+	gc->shmem_write_idx = 0;
+	gc->copy_stop       = false;
+	gc->copy_start      = CreateEvent(NULL, false, false, NULL);
+	gc->copy_done       = CreateEvent(NULL, false, false, NULL);
+	if (!gc->copy_start || !gc->copy_done) {
+		warn("init_shmem_capture: failed to create copy events");
+		return false;
+	}
+
+	gc->copy_thread = CreateThread(NULL, 0, shmem_copy_thread, gc,
+			0, NULL);
+	if (!gc->copy_thread) {
+		warn("init_shmem_capture: failed to create copy thread: %lu",
+				GetLastError());
+		return false;
+	}
+
 	gc->copy_texture = copy_shmem_tex;
 	return true;
 }
@@ -944,7 +1097,7 @@ static void game_capture_tick(void *data, float seconds)
 			info("capture window no longer exists, "
 			     "terminating capture");
 			stop_capture(gc);
-		} else {
+		} else if (gc->showing) {
 			if (gc->copy_texture) {
 				obs_enter_graphics();
 				gc->copy_texture(gc);
@@ -966,6 +1119,23 @@ static void game_capture_tick(void *data, float seconds)
 	}
 }
 
+static void set_capture_paused(struct game_capture *gc, bool paused)
+{
+	gc->showing = !paused;
+	if (gc->global_hook_info)
+		gc->global_hook_info->capture_paused = paused;
+}
+
+static void game_capture_show(void *data)
+{
+	set_capture_paused(data, false);
+}
+
+static void game_capture_hide(void *data)
+{
+	set_capture_paused(data, true);
+}
+
 static inline void game_capture_render_cursor(struct game_capture *gc)
 {
 	POINT p = {0};
@@ -1251,6 +1421,8 @@ struct obs_source_info game_capture_info = {
 	.get_defaults = game_capture_defaults,
 	.get_properties = game_capture_properties,
 	.update = game_capture_update,
+	.show = game_capture_show,
+	.hide = game_capture_hide,
 	.video_tick = game_capture_tick,
 	.video_render = game_capture_render
 };
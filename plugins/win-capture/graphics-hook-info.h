@@ -92,10 +92,18 @@ struct hook_info {
 
 	/* additional options */
 	uint64_t                       frame_interval;
+	uint64_t                       obs_frame_interval;
 	bool                           use_scale;
 	bool                           force_shmem;
 	bool                           capture_overlay;
 
+	/* LUID of the adapter OBS renders with, 0 if unknown */
+	uint64_t                       obs_adapter_luid;
+
+	/* set while the source isn't shown, the hook stays attached but skips
+	 * copying frames so that showing the source again is instant */
+	bool                           capture_paused;
+
 	/* hook addresses */
 	struct graphics_offsets        offsets;
 };
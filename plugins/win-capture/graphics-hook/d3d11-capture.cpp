@@ -551,7 +551,17 @@ static void d3d11_init(IDXGISwapChain *swap)
 		success = false;
 	}
 	if (success) {
-		if (global_hook_info->force_shmem) {
+		bool shmem = global_hook_info->force_shmem;
+
+		if (!shmem && !device_on_adapter(data.device,
+					global_hook_info->obs_adapter_luid)) {
+			hlog("d3d11_init: game is rendering on a different "
+			     "adapter than OBS, using shared memory "
+			     "capture");
+			shmem = true;
+		}
+
+		if (shmem) {
 			success = d3d11_shmem_init(window);
 		} else {
 			success = d3d11_shtex_init(window);
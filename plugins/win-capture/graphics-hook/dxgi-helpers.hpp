@@ -12,3 +12,38 @@ static inline DXGI_FORMAT fix_dxgi_format(DXGI_FORMAT format)
 	return format;
 }
 
+static inline uint64_t luid_to_uint64(const LUID &luid)
+{
+	return ((uint64_t)(uint32_t)luid.HighPart << 32) | luid.LowPart;
+}
+
+/* shared textures can only be opened on the adapter they were created on,
+ * which on hybrid GPU laptops is often not the one OBS renders with */
+static inline bool device_on_adapter(IUnknown *device, uint64_t luid)
+{
+	IDXGIDevice *dxgi_device;
+	IDXGIAdapter *adapter;
+	DXGI_ADAPTER_DESC desc;
+	HRESULT hr;
+
+	if (!luid)
+		return true;
+
+	hr = device->QueryInterface(__uuidof(IDXGIDevice),
+			(void**)&dxgi_device);
+	if (FAILED(hr))
+		return true;
+
+	hr = dxgi_device->GetAdapter(&adapter);
+	dxgi_device->Release();
+	if (FAILED(hr))
+		return true;
+
+	hr = adapter->GetDesc(&desc);
+	adapter->Release();
+	if (FAILED(hr))
+		return true;
+
+	return luid_to_uint64(desc.AdapterLuid) == luid;
+}
+
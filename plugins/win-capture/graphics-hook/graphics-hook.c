@@ -549,10 +549,24 @@ static inline bool frame_ready(uint64_t interval)
 	return true;
 }
 
+/* shared memory captures are read back to the CPU, which is far too costly
+ * to do for frames that OBS will never use, so they're always limited to the
+ * OBS frame rate.  shared texture captures only limit when asked to */
+static inline uint64_t capture_interval(void)
+{
+	uint64_t interval = global_hook_info->frame_interval;
+
+	if (global_hook_info->type == CAPTURE_TYPE_MEMORY &&
+	    global_hook_info->obs_frame_interval > interval)
+		interval = global_hook_info->obs_frame_interval;
+
+	return interval;
+}
+
 inline bool capture_ready(void)
 {
-	return capture_active() &&
-		frame_ready(global_hook_info->frame_interval);
+	return capture_active() && !global_hook_info->capture_paused &&
+		frame_ready(capture_interval());
 }
 
 static inline bool init_shared_info(size_t size)
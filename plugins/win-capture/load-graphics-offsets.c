@@ -11,15 +11,9 @@
 extern struct graphics_offsets offsets32;
 extern struct graphics_offsets offsets64;
 
-static inline bool load_offsets_from_string(struct graphics_offsets *offsets,
-		const char *str)
+static void load_offsets_from_config(struct graphics_offsets *offsets,
+		config_t *config)
 {
-	config_t *config;
-
-	if (config_open_string(&config, str) != CONFIG_SUCCESS) {
-		return false;
-	}
-
 	offsets->d3d9.present =
 		(uint32_t)config_get_uint(config, "d3d9", "present");
 	offsets->d3d9.present_ex =
@@ -35,15 +29,135 @@ static inline bool load_offsets_from_string(struct graphics_offsets *offsets,
 		(uint32_t)config_get_uint(config, "dxgi", "present");
 	offsets->dxgi.resize =
 		(uint32_t)config_get_uint(config, "dxgi", "resize");
+}
 
+static inline bool load_offsets_from_string(struct graphics_offsets *offsets,
+		const char *str)
+{
+	config_t *config;
+
+	if (config_open_string(&config, str) != CONFIG_SUCCESS) {
+		return false;
+	}
+
+	load_offsets_from_config(offsets, config);
 	config_close(config);
 	return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/* offsets cache                                                             */
+
+/* the offsets only change when the system graphics DLLs (or the helper that
+ * finds them) change, so they are cached along with the write times and
+ * sizes of those files rather than running the helper on every load */
+static const wchar_t *cache_dlls[] = {
+	L"d3d8.dll",
+	L"d3d9.dll",
+	L"dxgi.dll",
+	L"d3d11.dll",
+	NULL
+};
+
+static void cat_file_key(struct dstr *key, const wchar_t *path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+
+	if (GetFileAttributesExW(path, GetFileExInfoStandard, &attr))
+		dstr_catf(key, "%08lX%08lX-%08lX%08lX;",
+				attr.ftLastWriteTime.dwHighDateTime,
+				attr.ftLastWriteTime.dwLowDateTime,
+				attr.nFileSizeHigh, attr.nFileSizeLow);
+	else
+		dstr_cat(key, "none;");
+}
+
+static void get_cache_key(struct dstr *key, const char *exe_path,
+		bool is32bit)
+{
+	wchar_t dir[MAX_PATH];
+	wchar_t path[MAX_PATH];
+	wchar_t *exe_path_w = NULL;
+	UINT len = 0;
+
+	/* 32bit DLLs live in SysWOW64 on 64bit windows */
+	if (is32bit)
+		len = GetSystemWow64DirectoryW(dir, MAX_PATH);
+	if (!len)
+		len = GetSystemDirectoryW(dir, MAX_PATH);
+	if (!len || len >= MAX_PATH)
+		dir[0] = 0;
+
+	for (const wchar_t **dll = cache_dlls; *dll; dll++) {
+		_snwprintf(path, MAX_PATH, L"%s\\%s", dir, *dll);
+		path[MAX_PATH - 1] = 0;
+		cat_file_key(key, path);
+	}
+
+	if (os_utf8_to_wcs_ptr(exe_path, 0, &exe_path_w))
+		cat_file_key(key, exe_path_w);
+	bfree(exe_path_w);
+}
+
+static char *get_cache_path(bool is32bit)
+{
+	char *path;
+
+	path = os_get_config_path("obs-studio/plugin_config");
+	os_mkdir(path);
+	bfree(path);
+
+	path = os_get_config_path("obs-studio/plugin_config/win-capture");
+	os_mkdir(path);
+	bfree(path);
+
+	return os_get_config_path(is32bit ?
+			"obs-studio/plugin_config/win-capture/offsets32.ini" :
+			"obs-studio/plugin_config/win-capture/offsets64.ini");
+}
+
+static bool load_cached_offsets(struct graphics_offsets *offsets,
+		const char *cache_path, const char *key)
+{
+	const char *cached_key;
+	config_t *config;
+	bool success;
+
+	if (config_open(&config, cache_path, CONFIG_OPEN_EXISTING) !=
+			CONFIG_SUCCESS)
+		return false;
+
+	cached_key = config_get_string(config, "cache", "key");
+	success = cached_key && strcmp(cached_key, key) == 0;
+	if (success)
+		load_offsets_from_config(offsets, config);
+
+	config_close(config);
+	return success;
+}
+
+static void save_cached_offsets(const char *cache_path, const char *key,
+		const char *str)
+{
+	struct dstr text = {0};
+
+	dstr_printf(&text, "[cache]\nkey=%s\n\n%s", key, str);
+	if (!os_quick_write_utf8_file(cache_path, text.array, text.len, false))
+		blog(LOG_WARNING, "load_graphics_offsets: Failed to save "
+		                  "offsets to '%s'", cache_path);
+
+	dstr_free(&text);
+}
+
+/* ------------------------------------------------------------------------- */
+
 bool load_graphics_offsets(bool is32bit)
 {
+	struct graphics_offsets *offsets = is32bit ? &offsets32 : &offsets64;
 	char *offset_exe_path = NULL;
+	char *cache_path = NULL;
 	struct dstr offset_exe = {0};
+	struct dstr key = {0};
 	struct dstr str = {0};
 	os_process_pipe_t *pp;
 	bool success = false;
@@ -53,11 +167,20 @@ bool load_graphics_offsets(bool is32bit)
 	dstr_cat(&offset_exe, is32bit ? "32.exe" : "64.exe");
 	offset_exe_path = obs_module_file(offset_exe.array);
 
+	get_cache_key(&key, offset_exe_path, is32bit);
+	cache_path = get_cache_path(is32bit);
+
+	if (cache_path && load_cached_offsets(offsets, cache_path,
+				key.array)) {
+		success = true;
+		goto done;
+	}
+
 	pp = os_process_pipe_create(offset_exe_path, "r");
 	if (!pp) {
 		blog(LOG_INFO, "load_graphics_offsets: Failed to start '%s'",
 				offset_exe.array);
-		goto error;
+		goto done;
 	}
 
 	for (;;) {
@@ -68,17 +191,20 @@ bool load_graphics_offsets(bool is32bit)
 		dstr_ncat(&str, data, len);
 	}
 
-	success = load_offsets_from_string(is32bit ? &offsets32 : &offsets64,
-			str.array);
+	success = load_offsets_from_string(offsets, str.array);
 	if (!success) {
 		blog(LOG_INFO, "load_graphics_offsets: Failed to load string");
+	} else if (cache_path) {
+		save_cached_offsets(cache_path, key.array, str.array);
 	}
 
 	os_process_pipe_destroy(pp);
 
-error:
+done:
 	bfree(offset_exe_path);
+	bfree(cache_path);
 	dstr_free(&offset_exe);
+	dstr_free(&key);
 	dstr_free(&str);
 	return success;
 }
@@ -4,10 +4,14 @@ OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("win-capture", "en-US")
 
 extern struct obs_source_info monitor_capture_info;
+extern struct obs_source_info duplicator_capture_info;
 extern struct obs_source_info window_capture_info;
 extern struct obs_source_info game_capture_info;
+extern struct obs_output_info shared_texture_output_info;
 
 extern bool load_graphics_offsets(bool is32bit);
+extern void init_window_tracking(void);
+extern void free_window_tracking(void);
 
 /* temporary, will eventually be erased once we figure out how to create both
  * 32bit and 64bit versions of the helpers/hook */
@@ -20,7 +24,11 @@ extern bool load_graphics_offsets(bool is32bit);
 bool obs_module_load(void)
 {
 	obs_register_source(&monitor_capture_info);
+	obs_register_source(&duplicator_capture_info);
 	obs_register_source(&window_capture_info);
+	obs_register_output(&shared_texture_output_info);
+
+	init_window_tracking();
 
 	if (load_graphics_offsets(IS32BIT)) {
 		load_graphics_offsets(!IS32BIT);
@@ -29,3 +37,8 @@ bool obs_module_load(void)
 
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	free_window_tracking();
+}
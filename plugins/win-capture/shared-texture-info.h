@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * The shared texture output publishes the handle of a D3D11 texture with
+ * D3D11_RESOURCE_MISC_SHARED in a named file mapping, so other applications
+ * can open it with ID3D11Device::OpenSharedResource.
+ *
+ * The mapping is named SHARED_TEXTURE_MAP_NAME followed by the output's
+ * name.  frame is incremented after each copy in to the texture; when
+ * tex_handle, cx or cy change the texture was recreated and must be opened
+ * again.  tex_handle is 0 while the output is stopped.
+ */
+
+#define SHARED_TEXTURE_MAP_NAME L"OBSSharedTexture_"
+#define SHARED_TEXTURE_VERSION  1
+
+#pragma pack(push, 8)
+
+struct shared_texture_info {
+	uint32_t                       version;
+	uint32_t                       tex_handle;
+	uint32_t                       format; /* DXGI_FORMAT */
+	uint32_t                       cx;
+	uint32_t                       cy;
+	volatile uint32_t              frame;
+	uint64_t                       timestamp;
+};
+
+#pragma pack(pop)
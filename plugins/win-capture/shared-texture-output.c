@@ -0,0 +1,257 @@
+#include <windows.h>
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include "shared-texture-info.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[shared texture output: '%s'] " format, \
+			obs_output_get_name(sto->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+#define SETTING_NAME        "name"
+
+#define TEXT_SHARED_TEXTURE obs_module_text("SharedTextureOutput")
+#define TEXT_NAME           obs_module_text("SharedTextureOutput.Name")
+
+/* DXGI_FORMAT_R8G8B8A8_UNORM, the format of the output textures */
+#define SHARED_TEXTURE_DXGI_FORMAT 28
+
+struct shared_texture_output {
+	obs_output_t               *output;
+	char                       *name;
+
+	HANDLE                     map;
+	struct shared_texture_info *info;
+
+	/* graphics thread only.  the output never begins data capture, it
+	 * takes the output texture instead of raw or encoded frames */
+	gs_texture_t               *texture;
+	bool                       failed;
+
+	bool                       active;
+};
+
+static const char *shared_texture_output_getname(void)
+{
+	return TEXT_SHARED_TEXTURE;
+}
+
+static void free_texture(struct shared_texture_output *sto)
+{
+	obs_enter_graphics();
+	gs_texture_destroy(sto->texture);
+	sto->texture = NULL;
+	sto->failed  = false;
+	obs_leave_graphics();
+}
+
+static bool init_texture(struct shared_texture_output *sto,
+		uint32_t cx, uint32_t cy)
+{
+	gs_texture_destroy(sto->texture);
+
+	sto->texture = gs_texture_create(cx, cy, GS_RGBA, 1, NULL,
+			GS_SHARED_TEX);
+	if (!sto->texture) {
+		warn("failed to create %ux%u shared texture", cx, cy);
+		return false;
+	}
+
+	sto->info->cx         = cx;
+	sto->info->cy         = cy;
+	sto->info->format     = SHARED_TEXTURE_DXGI_FORMAT;
+	sto->info->tex_handle = gs_texture_get_shared_handle(sto->texture);
+
+	info("sharing %ux%u texture, handle %lX", cx, cy,
+			(unsigned long)sto->info->tex_handle);
+	return true;
+}
+
+/* called on the graphics thread each frame with the output texture */
+static void shared_texture_callback(void *param, gs_texture_t *texture,
+		uint64_t timestamp)
+{
+	struct shared_texture_output *sto = param;
+	uint32_t cx = gs_texture_get_width(texture);
+	uint32_t cy = gs_texture_get_height(texture);
+
+	if (sto->failed)
+		return;
+
+	if (!sto->texture || cx != sto->info->cx || cy != sto->info->cy) {
+		if (!init_texture(sto, cx, cy)) {
+			sto->failed = true;
+			return;
+		}
+	}
+
+	gs_copy_texture(sto->texture, texture);
+
+	sto->info->timestamp = timestamp;
+	InterlockedIncrement((volatile LONG*)&sto->info->frame);
+}
+
+static void free_map(struct shared_texture_output *sto)
+{
+	if (sto->info) {
+		UnmapViewOfFile(sto->info);
+		sto->info = NULL;
+	}
+	if (sto->map) {
+		CloseHandle(sto->map);
+		sto->map = NULL;
+	}
+}
+
+static bool init_map(struct shared_texture_output *sto)
+{
+	wchar_t *wname = NULL;
+
+	os_utf8_to_wcs_ptr(sto->name, 0, &wname);
+
+	size_t prefix_len = wcslen(SHARED_TEXTURE_MAP_NAME);
+	size_t name_len   = wname ? wcslen(wname) : 0;
+	wchar_t *map_name = bzalloc((prefix_len + name_len + 1) *
+			sizeof(wchar_t));
+
+	wcscpy(map_name, SHARED_TEXTURE_MAP_NAME);
+	if (wname)
+		wcscat(map_name, wname);
+	bfree(wname);
+
+	sto->map = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL,
+			PAGE_READWRITE, 0, sizeof(struct shared_texture_info),
+			map_name);
+	bfree(map_name);
+
+	if (!sto->map) {
+		warn("failed to create file mapping: %lu", GetLastError());
+		return false;
+	}
+
+	sto->info = MapViewOfFile(sto->map, FILE_MAP_ALL_ACCESS, 0, 0,
+			sizeof(struct shared_texture_info));
+	if (!sto->info) {
+		warn("failed to map file mapping: %lu", GetLastError());
+		free_map(sto);
+		return false;
+	}
+
+	memset(sto->info, 0, sizeof(*sto->info));
+	sto->info->version = SHARED_TEXTURE_VERSION;
+	return true;
+}
+
+static void shared_texture_output_stop(void *data)
+{
+	struct shared_texture_output *sto = data;
+
+	if (!sto->active)
+		return;
+
+	obs_remove_video_texture_callback(obs_get_video(),
+			shared_texture_callback, sto);
+
+	sto->info->tex_handle = 0;
+	free_texture(sto);
+	free_map(sto);
+
+	sto->active = false;
+	info("stopped");
+}
+
+static bool shared_texture_output_start(void *data)
+{
+	struct shared_texture_output *sto = data;
+
+	if (sto->active)
+		return true;
+
+	obs_enter_graphics();
+	bool available = gs_shared_texture_available();
+	obs_leave_graphics();
+
+	if (!available) {
+		warn("shared textures are not available with this renderer");
+		return false;
+	}
+
+	if (!init_map(sto))
+		return false;
+
+	obs_add_video_texture_callback(obs_get_video(),
+			shared_texture_callback, sto);
+
+	sto->active = true;
+	info("started");
+	return true;
+}
+
+static void shared_texture_output_update(void *data, obs_data_t *settings)
+{
+	struct shared_texture_output *sto = data;
+	const char *name = obs_data_get_string(settings, SETTING_NAME);
+	bool restart = sto->active && strcmp(name, sto->name) != 0;
+
+	if (restart)
+		shared_texture_output_stop(sto);
+
+	bfree(sto->name);
+	sto->name = bstrdup(name);
+
+	if (restart)
+		shared_texture_output_start(sto);
+}
+
+static void *shared_texture_output_create(obs_data_t *settings,
+		obs_output_t *output)
+{
+	struct shared_texture_output *sto =
+		bzalloc(sizeof(struct shared_texture_output));
+
+	sto->output = output;
+	shared_texture_output_update(sto, settings);
+	return sto;
+}
+
+static void shared_texture_output_destroy(void *data)
+{
+	struct shared_texture_output *sto = data;
+
+	shared_texture_output_stop(sto);
+	bfree(sto->name);
+	bfree(sto);
+}
+
+static void shared_texture_output_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, SETTING_NAME, "OBS");
+}
+
+static obs_properties_t *shared_texture_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, SETTING_NAME, TEXT_NAME,
+			OBS_TEXT_DEFAULT);
+
+	return props;
+}
+
+struct obs_output_info shared_texture_output_info = {
+	.id             = "shared_texture_output",
+	.flags          = OBS_OUTPUT_VIDEO,
+	.get_name       = shared_texture_output_getname,
+	.create         = shared_texture_output_create,
+	.destroy        = shared_texture_output_destroy,
+	.start          = shared_texture_output_start,
+	.stop           = shared_texture_output_stop,
+	.update         = shared_texture_output_update,
+	.get_defaults   = shared_texture_output_defaults,
+	.get_properties = shared_texture_output_properties
+};
@@ -30,6 +30,7 @@ struct window_capture {
 	gs_effect_t          *opaque_effect;
 
 	HWND                 window;
+	long                 window_generation;
 	RECT                 last_rect;
 };
 
@@ -97,6 +98,7 @@ static void wc_update(void *data, obs_data_t *settings)
 
 	/* forces a reset */
 	wc->window = NULL;
+	wc->window_generation = 0;
 }
 
 static uint32_t wc_width(void *data)
@@ -152,12 +154,18 @@ static void wc_tick(void *data, float seconds)
 	if (!wc->window || !IsWindow(wc->window)) {
 		if (!wc->title && !wc->class)
 			return;
+		if (!windows_changed(&wc->window_generation))
+			return;
 
 		wc->window = find_window(EXCLUDE_MINIMIZED, wc->priority,
 				wc->class, wc->title, wc->executable);
 		if (!wc->window)
 			return;
 
+		/* if this window goes away, search again straight away in
+		 * case another one matches */
+		wc->window_generation = 0;
+
 		reset_capture = true;
 
 	} else if (IsIconic(wc->window)) {
@@ -203,7 +211,8 @@ static void wc_render(void *data, gs_effect_t *effect)
 struct obs_source_info window_capture_info = {
 	.id             = "window_capture",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_SUSPEND_WHEN_HIDDEN,
 	.get_name       = wc_getname,
 	.create         = wc_create,
 	.destroy        = wc_destroy,
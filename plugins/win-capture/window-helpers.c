@@ -1,5 +1,6 @@
 #include <obs.h>
 #include <util/dstr.h>
+#include <util/threading.h>
 
 #include <windows.h>
 #include <psapi.h>
@@ -107,6 +108,7 @@ fail:
 
 static void get_window_title(struct dstr *name, HWND hwnd)
 {
+	wchar_t buf[256];
 	wchar_t *temp;
 	int len;
 
@@ -114,10 +116,12 @@ static void get_window_title(struct dstr *name, HWND hwnd)
 	if (!len)
 		return;
 
-	temp = malloc(sizeof(wchar_t) * (len+1));
+	/* most titles are short, only allocate for long ones */
+	temp = (len < 256) ? buf : malloc(sizeof(wchar_t) * (len+1));
 	GetWindowTextW(hwnd, temp, len+1);
 	dstr_from_wcs(name, temp);
-	free(temp);
+	if (temp != buf)
+		free(temp);
 }
 
 static void get_window_class(struct dstr *class, HWND hwnd)
@@ -125,7 +129,7 @@ static void get_window_class(struct dstr *class, HWND hwnd)
 	wchar_t temp[256];
 
 	temp[0] = 0;
-	GetClassNameW(hwnd, temp, sizeof(temp));
+	GetClassNameW(hwnd, temp, sizeof(temp) / sizeof(wchar_t));
 	dstr_from_wcs(class, temp);
 }
 
@@ -277,3 +281,105 @@ HWND find_window(enum window_search_mode mode,
 
 	return best_window;
 }
+
+/* ------------------------------------------------------------------------- */
+/* window change tracking                                                    */
+
+/* incremented whenever a top level window is created, destroyed, shown,
+ * hidden, renamed, minimized/restored or brought to the foreground, so that
+ * sources only search the window list again when it may have changed */
+static volatile long window_generation = 1;
+static HANDLE        tracker_thread    = NULL;
+static DWORD         tracker_thread_id = 0;
+
+static void CALLBACK window_event(HWINEVENTHOOK hook, DWORD event,
+		HWND window, LONG id_object, LONG id_child, DWORD thread_id,
+		DWORD time)
+{
+	if (id_object == OBJID_WINDOW && id_child == CHILDID_SELF &&
+	    window && GetAncestor(window, GA_ROOT) == window)
+		os_atomic_inc_long(&window_generation);
+
+	UNUSED_PARAMETER(hook);
+	UNUSED_PARAMETER(event);
+	UNUSED_PARAMETER(thread_id);
+	UNUSED_PARAMETER(time);
+}
+
+static const DWORD tracked_events[][2] = {
+	{EVENT_SYSTEM_FOREGROUND,     EVENT_SYSTEM_FOREGROUND},
+	{EVENT_SYSTEM_MINIMIZESTART,  EVENT_SYSTEM_MINIMIZEEND},
+	{EVENT_OBJECT_CREATE,         EVENT_OBJECT_HIDE},
+	{EVENT_OBJECT_NAMECHANGE,     EVENT_OBJECT_NAMECHANGE},
+};
+
+#define NUM_TRACKED_EVENTS \
+	(sizeof(tracked_events) / sizeof(tracked_events[0]))
+
+/* out of context event hooks are called through this thread's message
+ * loop */
+static DWORD WINAPI tracker_thread_proc(LPVOID param)
+{
+	HWINEVENTHOOK hooks[NUM_TRACKED_EVENTS];
+	MSG msg;
+
+	for (size_t i = 0; i < NUM_TRACKED_EVENTS; i++)
+		hooks[i] = SetWinEventHook(tracked_events[i][0],
+				tracked_events[i][1], NULL, window_event,
+				0, 0, WINEVENT_OUTOFCONTEXT);
+
+	while (GetMessage(&msg, NULL, 0, 0) > 0) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	for (size_t i = 0; i < NUM_TRACKED_EVENTS; i++) {
+		if (hooks[i])
+			UnhookWinEvent(hooks[i]);
+	}
+
+	UNUSED_PARAMETER(param);
+	return 0;
+}
+
+void init_window_tracking(void)
+{
+	tracker_thread = CreateThread(NULL, 0, tracker_thread_proc, NULL, 0,
+			&tracker_thread_id);
+	if (!tracker_thread)
+		blog(LOG_WARNING, "init_window_tracking: Failed to create "
+		                  "thread, windows will be searched for on "
+		                  "every check");
+}
+
+void free_window_tracking(void)
+{
+	if (!tracker_thread)
+		return;
+
+	/* the thread's message queue may not exist yet right after it has
+	 * been created, in which case posting fails */
+	while (!PostThreadMessage(tracker_thread_id, WM_QUIT, 0, 0)) {
+		if (WaitForSingleObject(tracker_thread, 1) != WAIT_TIMEOUT)
+			break;
+	}
+
+	WaitForSingleObject(tracker_thread, INFINITE);
+	CloseHandle(tracker_thread);
+	tracker_thread = NULL;
+}
+
+bool windows_changed(long *generation)
+{
+	long cur;
+
+	if (!tracker_thread)
+		return true;
+
+	cur = os_atomic_load_long(&window_generation);
+	if (cur == *generation)
+		return false;
+
+	*generation = cur;
+	return true;
+}
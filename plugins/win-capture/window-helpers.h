@@ -22,6 +22,18 @@ extern void build_window_strings(const char *str,
 		char **title,
 		char **exe);
 
+/* tracks changes to the top level windows from a background thread */
+extern void init_window_tracking(void);
+extern void free_window_tracking(void);
+
+/**
+ * Returns true if top level windows may have been created, destroyed,
+ * shown, hidden, renamed or minimized since the last call with the same
+ * generation, which starts at 0.  Searches that found nothing can be skipped
+ * until this returns true.
+ */
+extern bool windows_changed(long *generation);
+
 extern HWND find_window(enum window_search_mode mode,
 		enum window_priority priority,
 		const char *class,
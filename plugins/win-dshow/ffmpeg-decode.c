@@ -17,6 +17,19 @@
 
 #include "ffmpeg-decode.h"
 #include <obs-avc.h>
+#include <util/platform.h>
+
+/* frame threads add a frame of latency each, so don't use too many */
+#define MAX_DECODE_THREADS 4
+
+static inline int get_thread_count(void)
+{
+	int cores = os_get_logical_cores();
+
+	if (cores <= 1)
+		return 1;
+	return cores < MAX_DECODE_THREADS ? cores : MAX_DECODE_THREADS;
+}
 
 int ffmpeg_decode_init(struct ffmpeg_decode *decode, enum AVCodecID id)
 {
@@ -30,6 +43,8 @@ int ffmpeg_decode_init(struct ffmpeg_decode *decode, enum AVCodecID id)
 		return -1;
 
 	decode->decoder = avcodec_alloc_context3(decode->codec);
+	decode->decoder->thread_count = get_thread_count();
+	decode->decoder->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
 	ret = avcodec_open2(decode->decoder, decode->codec, NULL);
 	if (ret < 0) {
@@ -62,14 +77,15 @@ void ffmpeg_decode_free(struct ffmpeg_decode *decode)
 static inline enum video_format convert_pixel_format(int f)
 {
 	switch (f) {
-	case AV_PIX_FMT_NONE:    return VIDEO_FORMAT_NONE;
-	case AV_PIX_FMT_YUV420P: return VIDEO_FORMAT_I420;
-	case AV_PIX_FMT_NV12:    return VIDEO_FORMAT_NV12;
-	case AV_PIX_FMT_YUYV422: return VIDEO_FORMAT_YUY2;
-	case AV_PIX_FMT_UYVY422: return VIDEO_FORMAT_UYVY;
-	case AV_PIX_FMT_RGBA:    return VIDEO_FORMAT_RGBA;
-	case AV_PIX_FMT_BGRA:    return VIDEO_FORMAT_BGRA;
-	case AV_PIX_FMT_BGR0:    return VIDEO_FORMAT_BGRX;
+	case AV_PIX_FMT_NONE:     return VIDEO_FORMAT_NONE;
+	case AV_PIX_FMT_YUV420P:  return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUVJ420P: return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_NV12:     return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:  return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_UYVY422:  return VIDEO_FORMAT_UYVY;
+	case AV_PIX_FMT_RGBA:     return VIDEO_FORMAT_RGBA;
+	case AV_PIX_FMT_BGRA:     return VIDEO_FORMAT_BGRA;
+	case AV_PIX_FMT_BGR0:     return VIDEO_FORMAT_BGRX;
 	default:;
 	}
 
@@ -157,12 +173,16 @@ int ffmpeg_decode_audio(struct ffmpeg_decode *decode,
 #define NAL_SLICE     1
 #define NAL_SLICE_IDR 5
 
-static bool avc_keyframe(const uint8_t *data, size_t size)
+bool ffmpeg_decode_keyframe(enum AVCodecID id, const uint8_t *data,
+		size_t size)
 {
 	const uint8_t *nal_start, *nal_end;
 	const uint8_t *end = data + size;
 	int type;
 
+	if (id != AV_CODEC_ID_H264)
+		return true;
+
 	nal_start = obs_avc_find_startcode(data, end);
 	while (true) {
 		while (nal_start < end && !*(nal_start++));
@@ -201,7 +221,8 @@ int ffmpeg_decode_video(struct ffmpeg_decode *decode,
 	packet.size     = (int)size;
 	packet.pts      = *ts;
 
-	if (decode->codec->id == AV_CODEC_ID_H264 && avc_keyframe(data, size))
+	if (decode->codec->id == AV_CODEC_ID_H264 &&
+	    ffmpeg_decode_keyframe(decode->codec->id, data, size))
 		packet.flags |= AV_PKT_FLAG_KEY;
 
 	if (!decode->frame) {
@@ -228,7 +249,8 @@ int ffmpeg_decode_video(struct ffmpeg_decode *decode,
 
 		frame->format = new_format;
 		frame->full_range =
-			decode->frame->color_range == AVCOL_RANGE_JPEG;
+			decode->frame->color_range == AVCOL_RANGE_JPEG ||
+			decode->frame->format == AV_PIX_FMT_YUVJ420P;
 
 		range = frame->full_range ?
 			VIDEO_RANGE_FULL : VIDEO_RANGE_PARTIAL;
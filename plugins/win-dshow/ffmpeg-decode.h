@@ -59,6 +59,10 @@ extern int ffmpeg_decode_video(struct ffmpeg_decode *decode,
 		struct obs_source_frame *frame,
 		bool *got_output);
 
+/** Returns whether a packet can be decoded without previous packets */
+extern bool ffmpeg_decode_keyframe(enum AVCodecID id, const uint8_t *data,
+		size_t size);
+
 static inline bool ffmpeg_decode_valid(struct ffmpeg_decode *decode)
 {
 	return decode->decoder != NULL;
@@ -10,6 +10,7 @@
 #include "ffmpeg-decode.h"
 
 #include <algorithm>
+#include <deque>
 #include <limits>
 #include <set>
 #include <string>
@@ -126,7 +127,16 @@ enum class Action {
 	ConfigCrossbar2,
 };
 
+/* encoded packets waiting to be decoded before the queue is dropped */
+#define MAX_DECODE_QUEUE 4
+
+struct EncodedPacket {
+	vector<unsigned char> data;
+	long long             ts;
+};
+
 static DWORD CALLBACK DShowThread(LPVOID ptr);
+static DWORD CALLBACK DecodeThread(LPVOID ptr);
 
 struct DShowInput {
 	obs_source_t *source;
@@ -140,6 +150,7 @@ struct DShowInput {
 	AudioConfig  audioConfig;
 
 	obs_source_frame frame;
+	obs_source_frame decodedFrame;
 	obs_source_audio audio;
 
 	WinHandle semaphore;
@@ -147,6 +158,17 @@ struct DShowInput {
 	CriticalSection mutex;
 	vector<Action> actions;
 
+	/* encoded video is decoded in its own thread so the device callback
+	 * never waits on the decoder */
+	WinHandle decodeSemaphore;
+	WinHandle decodeThread;
+	CriticalSection decodeMutex;
+	deque<EncodedPacket> decodeQueue;
+	vector<EncodedPacket> freePackets;
+	enum AVCodecID decodeCodec = AV_CODEC_ID_NONE;
+	bool waitForKeyframe = false;
+	bool stopDecoding = false;
+
 	inline void QueueAction(Action action)
 	{
 		CriticalScope scope(mutex);
@@ -160,6 +182,7 @@ struct DShowInput {
 	{
 		memset(&audio, 0, sizeof(audio));
 		memset(&frame, 0, sizeof(frame));
+		memset(&decodedFrame, 0, sizeof(decodedFrame));
 
 		av_log_set_level(AV_LOG_WARNING);
 		av_log_set_callback(ffmpeg_log);
@@ -168,6 +191,16 @@ struct DShowInput {
 		if (!semaphore)
 			throw "Failed to create semaphore";
 
+		decodeSemaphore = CreateSemaphore(nullptr, 0, 0x7FFFFFFF,
+				nullptr);
+		if (!decodeSemaphore)
+			throw "Failed to create decode semaphore";
+
+		decodeThread = CreateThread(nullptr, 0, DecodeThread, this, 0,
+				nullptr);
+		if (!decodeThread)
+			throw "Failed to create decode thread";
+
 		thread = CreateThread(nullptr, 0, DShowThread, this, 0,
 				nullptr);
 		if (!thread)
@@ -187,8 +220,19 @@ struct DShowInput {
 		ReleaseSemaphore(semaphore, 1, nullptr);
 
 		WaitForSingleObject(thread, INFINITE);
+
+		{
+			CriticalScope scope(decodeMutex);
+			stopDecoding = true;
+		}
+
+		ReleaseSemaphore(decodeSemaphore, 1, nullptr);
+
+		WaitForSingleObject(decodeThread, INFINITE);
 	}
 
+	void QueueEncodedVideoData(enum AVCodecID id,
+			unsigned char *data, size_t size, long long ts);
 	void OnEncodedVideoData(enum AVCodecID id,
 			unsigned char *data, size_t size, long long ts);
 	void OnEncodedAudioData(enum AVCodecID id,
@@ -206,6 +250,7 @@ struct DShowInput {
 	void Update(obs_data_t *settings);
 
 	void DShowLoop();
+	void DecodeLoop();
 };
 
 static DWORD CALLBACK DShowThread(LPVOID ptr)
@@ -218,6 +263,14 @@ static DWORD CALLBACK DShowThread(LPVOID ptr)
 	return 0;
 }
 
+static DWORD CALLBACK DecodeThread(LPVOID ptr)
+{
+	DShowInput *dshowInput = (DShowInput*)ptr;
+
+	dshowInput->DecodeLoop();
+	return 0;
+}
+
 static inline void ProcessMessages()
 {
 	MSG msg;
@@ -284,6 +337,35 @@ void DShowInput::DShowLoop()
 	}
 }
 
+void DShowInput::DecodeLoop()
+{
+	while (WaitForSingleObject(decodeSemaphore, INFINITE) ==
+			WAIT_OBJECT_0) {
+		EncodedPacket packet;
+		enum AVCodecID id;
+
+		{
+			CriticalScope scope(decodeMutex);
+			if (stopDecoding)
+				break;
+
+			/* the queue may have been dropped in the meantime */
+			if (decodeQueue.empty())
+				continue;
+
+			packet = move(decodeQueue.front());
+			decodeQueue.pop_front();
+			id = decodeCodec;
+		}
+
+		OnEncodedVideoData(id, packet.data.data(), packet.data.size(),
+				packet.ts);
+
+		CriticalScope scope(decodeMutex);
+		freePackets.push_back(move(packet));
+	}
+}
+
 #define FPS_HIGHEST   0LL
 #define FPS_MATCHING -1LL
 
@@ -357,6 +439,55 @@ static inline audio_format ConvertAudioFormat(AudioFormat format)
 //#define LOG_ENCODED_VIDEO_TS 1
 //#define LOG_ENCODED_AUDIO_TS 1
 
+void DShowInput::QueueEncodedVideoData(enum AVCodecID id,
+		unsigned char *data, size_t size, long long ts)
+{
+	bool keyframe = ffmpeg_decode_keyframe(id, data, size);
+
+	CriticalScope scope(decodeMutex);
+
+	/* if the decoder can't keep up, drop everything queued and continue
+	 * with the next packet that doesn't depend on the dropped ones */
+	if (decodeQueue.size() >= MAX_DECODE_QUEUE) {
+		blog(LOG_DEBUG, "Video decoder is falling behind, dropping "
+		                "%u packets", (unsigned)decodeQueue.size());
+
+		for (EncodedPacket &packet : decodeQueue)
+			freePackets.push_back(move(packet));
+		decodeQueue.clear();
+		waitForKeyframe = true;
+	}
+
+	/* likewise if the decoded frames aren't being consumed, there's no
+	 * point in decoding more of them until there's room again */
+	if (obs_source_async_queue_full(source)) {
+		for (EncodedPacket &packet : decodeQueue)
+			freePackets.push_back(move(packet));
+		decodeQueue.clear();
+		waitForKeyframe = true;
+		return;
+	}
+
+	if (waitForKeyframe && !keyframe)
+		return;
+
+	waitForKeyframe = false;
+
+	if (freePackets.size()) {
+		decodeQueue.push_back(move(freePackets.back()));
+		freePackets.pop_back();
+	} else {
+		decodeQueue.emplace_back();
+	}
+
+	EncodedPacket &packet = decodeQueue.back();
+	packet.data.assign(data, data + size);
+	packet.ts = ts;
+	decodeCodec = id;
+
+	ReleaseSemaphore(decodeSemaphore, 1, nullptr);
+}
+
 void DShowInput::OnEncodedVideoData(enum AVCodecID id,
 		unsigned char *data, size_t size, long long ts)
 {
@@ -369,18 +500,18 @@ void DShowInput::OnEncodedVideoData(enum AVCodecID id,
 
 	bool got_output;
 	int len = ffmpeg_decode_video(video_decoder, data, size, &ts,
-			&frame, &got_output);
+			&decodedFrame, &got_output);
 	if (len < 0) {
 		blog(LOG_WARNING, "Error decoding video");
 		return;
 	}
 
 	if (got_output) {
-		frame.timestamp = (uint64_t)ts * 100;
+		decodedFrame.timestamp = (uint64_t)ts * 100;
 #if LOG_ENCODED_VIDEO_TS
-		blog(LOG_DEBUG, "video ts: %llu", frame.timestamp);
+		blog(LOG_DEBUG, "video ts: %llu", decodedFrame.timestamp);
 #endif
-		obs_source_output_video(source, &frame);
+		obs_source_output_video(source, &decodedFrame);
 	}
 }
 
@@ -389,7 +520,8 @@ void DShowInput::OnVideoData(const VideoConfig &config,
 		long long startTime, long long endTime)
 {
 	if (videoConfig.format == VideoFormat::H264) {
-		OnEncodedVideoData(AV_CODEC_ID_H264, data, size, startTime);
+		QueueEncodedVideoData(AV_CODEC_ID_H264, data, size,
+				startTime);
 		return;
 	}
 
@@ -429,7 +561,8 @@ void DShowInput::OnVideoData(const VideoConfig &config,
 		return;
 	}
 
-	obs_source_output_video(source, &frame);
+	if (!obs_source_async_queue_full(source))
+		obs_source_output_video(source, &frame);
 
 	UNUSED_PARAMETER(endTime); /* it's the enndd tiimmes! */
 	UNUSED_PARAMETER(size);
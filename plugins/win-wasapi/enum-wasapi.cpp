@@ -5,6 +5,9 @@
 #include <util/windows/HRError.hpp>
 #include <util/windows/ComPtr.hpp>
 #include <util/windows/CoTaskMemPtr.hpp>
+#include <util/threading.h>
+
+#include <mutex>
 
 using namespace std;
 
@@ -82,15 +85,164 @@ void GetWASAPIAudioDevices_(vector<AudioDeviceInfo> &devices, bool input)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* Device list cache, dropped whenever an endpoint is added, removed, renamed
+ * or changes its state                                                      */
+
+static void InvalidateDeviceCache();
+
+class DeviceNotifier : public IMMNotificationClient {
+	volatile long refs = 1;
+
+public:
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return (ULONG)os_atomic_inc_long(&refs);
+	}
+
+	STDMETHODIMP_(ULONG) Release()
+	{
+		long val = os_atomic_dec_long(&refs);
+		if (val == 0)
+			delete this;
+		return (ULONG)val;
+	}
+
+	STDMETHODIMP QueryInterface(REFIID riid, void **ptr)
+	{
+		if (riid == __uuidof(IUnknown) ||
+		    riid == __uuidof(IMMNotificationClient)) {
+			*ptr = this;
+			AddRef();
+			return S_OK;
+		}
+
+		*ptr = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	STDMETHODIMP OnDeviceStateChanged(LPCWSTR, DWORD)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDeviceAdded(LPCWSTR)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDeviceRemoved(LPCWSTR)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDefaultDeviceChanged(EDataFlow, ERole, LPCWSTR)
+	{
+		return S_OK;
+	}
+
+	STDMETHODIMP OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY key)
+	{
+		if (key == PKEY_Device_FriendlyName)
+			InvalidateDeviceCache();
+		return S_OK;
+	}
+};
+
+static mutex                       cacheMutex;
+static vector<AudioDeviceInfo>     cachedDevices[2];
+static bool                        cacheValid[2] = {};
+static uint64_t                    cacheGeneration = 0;
+static ComPtr<IMMDeviceEnumerator> notifyEnumerator;
+static DeviceNotifier              *notifier = nullptr;
+
+static void InvalidateDeviceCache()
+{
+	lock_guard<mutex> lock(cacheMutex);
+	cacheValid[0] = false;
+	cacheValid[1] = false;
+	cacheGeneration++;
+}
+
+/* without notifications the cache can't be trusted, so it's only used once
+ * they're registered */
+static bool StartDeviceNotifications()
+{
+	HRESULT res;
+
+	if (notifier)
+		return true;
+
+	res = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL,
+			__uuidof(IMMDeviceEnumerator),
+			(void**)notifyEnumerator.Assign());
+	if (FAILED(res))
+		return false;
+
+	notifier = new DeviceNotifier;
+	res = notifyEnumerator->RegisterEndpointNotificationCallback(notifier);
+	if (FAILED(res)) {
+		blog(LOG_WARNING, "[GetWASAPIAudioDevices] Failed to register "
+		                  "for device notifications: %lX", res);
+		notifier->Release();
+		notifier = nullptr;
+		notifyEnumerator.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+void FreeWASAPIDeviceCache()
+{
+	if (notifier) {
+		notifyEnumerator->UnregisterEndpointNotificationCallback(
+				notifier);
+		notifier->Release();
+		notifier = nullptr;
+		notifyEnumerator.Clear();
+	}
+
+	lock_guard<mutex> lock(cacheMutex);
+	for (size_t i = 0; i < 2; i++) {
+		cachedDevices[i].clear();
+		cacheValid[i] = false;
+	}
+}
+
 void GetWASAPIAudioDevices(vector<AudioDeviceInfo> &devices, bool input)
 {
+	bool cache = StartDeviceNotifications();
+	size_t idx = input ? 1 : 0;
+	uint64_t generation;
+
 	devices.clear();
 
+	unique_lock<mutex> lock(cacheMutex);
+	if (cache && cacheValid[idx]) {
+		devices = cachedDevices[idx];
+		return;
+	}
+	generation = cacheGeneration;
+	lock.unlock();
+
 	try {
 		GetWASAPIAudioDevices_(devices, input);
 
 	} catch (HRError error) {
 		blog(LOG_WARNING, "[GetWASAPIAudioDevices] %s: %lX",
 				error.str, error.hr);
+		return;
+	}
+
+	/* if devices changed during the enumeration, the result may already
+	 * be outdated, so it's only cached by the next call */
+	lock.lock();
+	if (cache && generation == cacheGeneration) {
+		cachedDevices[idx] = devices;
+		cacheValid[idx] = true;
 	}
 }
@@ -17,3 +17,4 @@ struct AudioDeviceInfo {
 
 std::string GetDeviceName(IMMDevice *device);
 void GetWASAPIAudioDevices(std::vector<AudioDeviceInfo> &devices, bool input);
+void FreeWASAPIDeviceCache();
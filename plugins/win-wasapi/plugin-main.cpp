@@ -5,6 +5,7 @@ OBS_MODULE_USE_DEFAULT_LOCALE("win-wasapi", "en-US")
 
 void RegisterWASAPIInput();
 void RegisterWASAPIOutput();
+void FreeWASAPIDeviceCache();
 
 bool obs_module_load(void)
 {
@@ -12,3 +13,8 @@ bool obs_module_load(void)
 	RegisterWASAPIOutput();
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	FreeWASAPIDeviceCache();
+}
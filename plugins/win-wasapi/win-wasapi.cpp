@@ -11,6 +11,11 @@ using namespace std;
 
 #define OPT_DEVICE_ID         "device_id"
 #define OPT_USE_DEVICE_TIMING "use_device_timing"
+#define OPT_BUFFER_MS         "buffer_ms"
+
+#define DEFAULT_BUFFER_MS     10
+#define MIN_BUFFER_MS         3
+#define MAX_BUFFER_MS         500
 
 static void GetWASAPIDefaults(obs_data_t *settings);
 
@@ -28,6 +33,7 @@ class WASAPISource {
 	bool                        isInputDevice;
 	bool                        useDeviceTiming;
 	bool                        isDefaultDevice;
+	int                         bufferMs;
 
 	bool                        reconnecting;
 	WinHandle                   reconnectThread;
@@ -127,12 +133,20 @@ void WASAPISource::UpdateSettings(obs_data_t *settings)
 	device_id       = obs_data_get_string(settings, OPT_DEVICE_ID);
 	useDeviceTiming = obs_data_get_bool(settings, OPT_USE_DEVICE_TIMING);
 	isDefaultDevice = _strcmpi(device_id.c_str(), "default") == 0;
+	bufferMs        = (int)obs_data_get_int(settings, OPT_BUFFER_MS);
+
+	if (bufferMs < MIN_BUFFER_MS)
+		bufferMs = MIN_BUFFER_MS;
+	else if (bufferMs > MAX_BUFFER_MS)
+		bufferMs = MAX_BUFFER_MS;
 }
 
 void WASAPISource::Update(obs_data_t *settings)
 {
 	string newDevice = obs_data_get_string(settings, OPT_DEVICE_ID);
-	bool restart = newDevice.compare(device_id) != 0;
+	int newBufferMs = (int)obs_data_get_int(settings, OPT_BUFFER_MS);
+	bool restart = newDevice.compare(device_id) != 0 ||
+		newBufferMs != bufferMs;
 
 	if (restart)
 		Stop();
@@ -164,13 +178,12 @@ bool WASAPISource::InitDevice(IMMDeviceEnumerator *enumerator)
 	return SUCCEEDED(res);
 }
 
-#define BUFFER_TIME_100NS (5*10000000)
-
 void WASAPISource::InitClient()
 {
 	CoTaskMemPtr<WAVEFORMATEX> wfex;
 	HRESULT                    res;
 	DWORD                      flags = AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
+	REFERENCE_TIME             bufferTime = (REFERENCE_TIME)bufferMs * 10000;
 
 	res = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL,
 			nullptr, (void**)client.Assign());
@@ -188,9 +201,12 @@ void WASAPISource::InitClient()
 
 	res = client->Initialize(
 			AUDCLNT_SHAREMODE_SHARED, flags,
-			BUFFER_TIME_100NS, 0, wfex, nullptr);
+			bufferTime, 0, wfex, nullptr);
 	if (FAILED(res))
 		throw HRError("Failed to get initialize audio client", res);
+
+	blog(LOG_INFO, "WASAPI: Device '%s' buffer duration: %d ms",
+			device_name.c_str(), bufferMs);
 }
 
 static speaker_layout ConvertSpeakerLayout(DWORD layout, WORD channels)
@@ -388,14 +404,18 @@ DWORD WINAPI WASAPISource::CaptureThread(LPVOID param)
 	WASAPISource *source   = (WASAPISource*)param;
 	bool         reconnect = false;
 
-	/* Output devices don't signal, so just make it check every 10 ms */
-	DWORD        dur       = source->isInputDevice ? INFINITE : 10;
+	/* Output devices don't signal, so poll them at half the buffer
+	 * duration so the buffer never fills up between checks */
+	DWORD        dur       = source->isInputDevice ? INFINITE :
+		(DWORD)(source->bufferMs / 2);
 
 	HANDLE sigs[2] = {
 		source->receiveSignal,
 		source->stopSignal
 	};
 
+	os_set_thread_role(OS_THREAD_ROLE_AUDIO);
+
 	while (WaitForCaptureSignal(2, sigs, dur)) {
 		if (!source->ProcessCaptureData()) {
 			reconnect = true;
@@ -433,6 +453,7 @@ static void GetWASAPIDefaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, OPT_DEVICE_ID, "default");
 	obs_data_set_default_bool(settings, OPT_USE_DEVICE_TIMING, true);
+	obs_data_set_default_int(settings, OPT_BUFFER_MS, DEFAULT_BUFFER_MS);
 }
 
 static void *CreateWASAPISource(obs_data_t *settings, obs_source_t *source,
@@ -493,6 +514,10 @@ static obs_properties_t *GetWASAPIProperties(bool input)
 	prop = obs_properties_add_bool(props, OPT_USE_DEVICE_TIMING,
 			obs_module_text("UseDeviceTiming"));
 
+	obs_properties_add_int(props, OPT_BUFFER_MS,
+			obs_module_text("BufferMs"), MIN_BUFFER_MS, MAX_BUFFER_MS,
+			1);
+
 	return props;
 }
 
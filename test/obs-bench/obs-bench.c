@@ -0,0 +1,498 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * Pipeline benchmark: runs libobs without a window on a synthetic scene made
+ * of the test-input sources (random textures with test filters, sine waves,
+ * and optionally text), for a fixed duration, and prints frame time
+ * percentiles, skipped/lagged frames, encode times and memory use.
+ *
+ * The first second is not measured, so source creation and shader compiles
+ * don't skew the results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <obs.h>
+#include <graphics/vec2.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+
+#ifdef _WIN32
+#define DEFAULT_GRAPHICS_MODULE "libobs-d3d11"
+#define NULL_DEVICE             "NUL"
+#else
+#define DEFAULT_GRAPHICS_MODULE "libobs-opengl"
+#define NULL_DEVICE             "/dev/null"
+#endif
+
+#define WARMUP_NS 1000000000ULL
+
+struct bench {
+	const char     *graphics_module;
+	uint32_t       base_width;
+	uint32_t       base_height;
+	uint32_t       output_width;
+	uint32_t       output_height;
+	uint32_t       fps_num;
+	uint32_t       fps_den;
+	uint64_t       duration_ns;
+
+	int            num_sources;
+	int            num_filters;
+	int            num_sinewaves;
+	int            num_texts;
+	const char     *encoder_id;
+
+	obs_scene_t    *scene;
+	obs_output_t   *output;
+	obs_encoder_t  *video_encoder;
+	obs_encoder_t  *audio_encoder;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static bool reset_video(struct bench *b)
+{
+	struct obs_video_info ovi = {0};
+	int ret;
+
+	ovi.graphics_module = b->graphics_module;
+	ovi.base_width      = b->base_width;
+	ovi.base_height     = b->base_height;
+	ovi.output_width    = b->output_width  ? b->output_width  :
+		b->base_width;
+	ovi.output_height   = b->output_height ? b->output_height :
+		b->base_height;
+	ovi.fps_num         = b->fps_num;
+	ovi.fps_den         = b->fps_den;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.gpu_conversion  = true;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	ret = obs_reset_video(&ovi);
+	if (ret != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Failed to initialize video with '%s': %d\n",
+				b->graphics_module, ret);
+		return false;
+	}
+
+	return true;
+}
+
+static bool reset_audio(void)
+{
+	struct audio_output_info ai = {0};
+
+	ai.name            = "Benchmark Audio";
+	ai.format          = AUDIO_FORMAT_FLOAT;
+	ai.samples_per_sec = 48000;
+	ai.speakers        = SPEAKERS_STEREO;
+	ai.buffer_ms       = 1000;
+
+	if (!obs_reset_audio(&ai)) {
+		fprintf(stderr, "Failed to initialize audio\n");
+		return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_source_t *create_text_source(const char *name)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *source;
+
+	obs_data_set_string(settings, "text", "The quick brown fox jumps "
+			"over the lazy dog 0123456789");
+
+	source = obs_source_create(OBS_SOURCE_TYPE_INPUT, "text_ft2_source",
+			name, settings);
+	if (!source)
+		source = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+				"text_gdiplus", name, settings);
+
+	obs_data_release(settings);
+	return source;
+}
+
+static void add_filters(struct bench *b, obs_source_t *source, int idx)
+{
+	struct dstr name = {0};
+
+	for (int i = 0; i < b->num_filters; i++) {
+		obs_source_t *filter;
+
+		dstr_printf(&name, "filter %d.%d", idx, i);
+		filter = obs_source_create(OBS_SOURCE_TYPE_FILTER,
+				"test_filter", name.array, NULL);
+		if (!filter)
+			break;
+
+		obs_source_filter_add(source, filter);
+		obs_source_release(filter);
+	}
+
+	dstr_free(&name);
+}
+
+/* lays the visible sources out in a grid covering the whole canvas, so every
+ * pixel is rendered by some source.  bounds are used because async sources
+ * have no size until their first frame arrives */
+static void place_item(struct bench *b, obs_sceneitem_t *item, int idx,
+		int count)
+{
+	int columns = 1;
+	struct vec2 pos, bounds;
+
+	while (columns * columns < count)
+		columns++;
+
+	vec2_set(&bounds, (float)b->base_width  / (float)columns,
+			(float)b->base_height / (float)columns);
+	vec2_set(&pos, bounds.x * (float)(idx % columns),
+			bounds.y * (float)(idx / columns));
+
+	obs_sceneitem_set_pos(item, &pos);
+	obs_sceneitem_set_bounds_type(item, OBS_BOUNDS_STRETCH);
+	obs_sceneitem_set_bounds(item, &bounds);
+}
+
+static bool build_scene(struct bench *b)
+{
+	int visible = b->num_sources + b->num_texts;
+	struct dstr name = {0};
+
+	b->scene = obs_scene_create("benchmark scene");
+
+	for (int i = 0; i < b->num_sources; i++) {
+		obs_source_t *source;
+
+		dstr_printf(&name, "random %d", i);
+		source = obs_source_create(OBS_SOURCE_TYPE_INPUT, "random",
+				name.array, NULL);
+		if (!source) {
+			fprintf(stderr, "Could not create the test sources, "
+			                "is the test-input module installed?\n");
+			dstr_free(&name);
+			return false;
+		}
+
+		add_filters(b, source, i);
+		place_item(b, obs_scene_add(b->scene, source), i, visible);
+		obs_source_release(source);
+	}
+
+	for (int i = 0; i < b->num_texts; i++) {
+		obs_source_t *source;
+
+		dstr_printf(&name, "text %d", i);
+		source = create_text_source(name.array);
+		if (!source) {
+			fprintf(stderr, "No text source available, skipping "
+			                "text\n");
+			break;
+		}
+
+		place_item(b, obs_scene_add(b->scene, source),
+				b->num_sources + i, visible);
+		obs_source_release(source);
+	}
+
+	for (int i = 0; i < b->num_sinewaves; i++) {
+		obs_source_t *source;
+
+		dstr_printf(&name, "sinewave %d", i);
+		source = obs_source_create(OBS_SOURCE_TYPE_INPUT,
+				"test_sinewave", name.array, NULL);
+		if (!source)
+			break;
+
+		obs_scene_add(b->scene, source);
+		obs_source_release(source);
+	}
+
+	obs_set_output_source(0, obs_scene_get_source(b->scene));
+	dstr_free(&name);
+	return true;
+}
+
+/* encodes to a file output that writes to the null device, so only the
+ * encoders add to the cost of the pipeline */
+static bool start_encoding(struct bench *b)
+{
+	obs_data_t *settings;
+	bool success;
+
+	b->video_encoder = obs_video_encoder_create(b->encoder_id,
+			"benchmark video", NULL);
+	b->audio_encoder = obs_audio_encoder_create("ffmpeg_aac",
+			"benchmark audio", NULL, 0);
+	if (!b->video_encoder || !b->audio_encoder) {
+		fprintf(stderr, "Failed to create the encoders\n");
+		return false;
+	}
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "path", NULL_DEVICE);
+	b->output = obs_output_create("flv_output", "benchmark output",
+			settings);
+	obs_data_release(settings);
+
+	if (!b->output) {
+		fprintf(stderr, "Failed to create the output\n");
+		return false;
+	}
+
+	obs_encoder_set_video(b->video_encoder, obs_get_video());
+	obs_encoder_set_audio(b->audio_encoder, obs_get_audio());
+	obs_output_set_video_encoder(b->output, b->video_encoder);
+	obs_output_set_audio_encoder(b->output, b->audio_encoder, 0);
+
+	success = obs_output_start(b->output);
+	if (!success)
+		fprintf(stderr, "Failed to start the output\n");
+	return success;
+}
+
+static void free_bench(struct bench *b)
+{
+	if (b->output) {
+		obs_output_stop(b->output);
+		obs_output_destroy(b->output);
+	}
+
+	obs_encoder_destroy(b->video_encoder);
+	obs_encoder_destroy(b->audio_encoder);
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(b->scene);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_section(const char *label, const char *name)
+{
+	struct profiler_section_stats stats;
+
+	if (!profiler_get_section_stats(name, &stats)) {
+		printf("%-16s (no samples)\n", label);
+		return;
+	}
+
+	printf("%-16s min %.3f, avg %.3f, median %.3f, 90th %.3f, "
+	       "99th %.3f, max %.3f ms (%llu calls)\n", label,
+	       (double)stats.min_ns    / 1000000.0,
+	       (double)stats.avg_ns    / 1000000.0,
+	       (double)stats.median_ns / 1000000.0,
+	       (double)stats.p90_ns    / 1000000.0,
+	       (double)stats.p99_ns    / 1000000.0,
+	       (double)stats.max_ns    / 1000000.0,
+	       (unsigned long long)stats.calls);
+}
+
+static void print_results(struct bench *b, const struct obs_perf_stats *start,
+		const struct obs_perf_stats *end)
+{
+	printf("\n== obs-bench: %ux%u -> %ux%u at %u/%u fps, %s ==\n",
+			b->base_width, b->base_height,
+			b->output_width  ? b->output_width  : b->base_width,
+			b->output_height ? b->output_height : b->base_height,
+			b->fps_num, b->fps_den, b->graphics_module);
+	printf("%d sources with %d filters each, %d text, %d sine waves\n\n",
+			b->num_sources, b->num_filters, b->num_texts,
+			b->num_sinewaves);
+
+	print_section("frame",         "obs_video_thread");
+	print_section("tick",          "tick_sources");
+	print_section("output frame",  "output_frame");
+	print_section("encode",        "encode");
+	print_section("encode texture", "encode_texture");
+
+	printf("\nframes:          %u\n",
+			end->total_frames - start->total_frames);
+	printf("skipped frames:  %u\n",
+			end->skipped_frames - start->skipped_frames);
+	printf("lagged frames:   %u\n",
+			end->lagged_frames - start->lagged_frames);
+
+	printf("\nmemory (peak / current):\n");
+	for (int i = 0; i < BMEM_TAG_COUNT; i++) {
+		struct bmem_tag_stats stats;
+		bmem_get_tag_stats((enum bmem_tag)i, &stats);
+
+		printf("  %-12s %8.2f MB / %8.2f MB\n",
+				bmem_tag_name((enum bmem_tag)i),
+				(double)stats.peak_bytes / (1024.0 * 1024.0),
+				(double)stats.bytes / (1024.0 * 1024.0));
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"\n"
+		"  --graphics <module>        graphics module (default %s)\n"
+		"  --resolution <w>x<h>       base resolution (default "
+		"1920x1080)\n"
+		"  --output <w>x<h>           output resolution (default "
+		"base)\n"
+		"  --fps <num>[/<den>]        frame rate (default 60)\n"
+		"  --duration <seconds>       measured time (default 10)\n"
+		"  --sources <n>              random sources (default 16)\n"
+		"  --filters <n>              filters per source (default 1)\n"
+		"  --text <n>                 text sources (default 0)\n"
+		"  --sinewaves <n>            sine wave sources (default 2)\n"
+		"  --encoder <id>             also encode with the given "
+		"video encoder\n",
+		program, DEFAULT_GRAPHICS_MODULE);
+}
+
+static bool parse_size(const char *str, uint32_t *width, uint32_t *height)
+{
+	unsigned int w, h;
+
+	if (sscanf(str, "%ux%u", &w, &h) != 2 || !w || !h)
+		return false;
+
+	*width  = w;
+	*height = h;
+	return true;
+}
+
+static bool parse_fps(const char *str, uint32_t *num, uint32_t *den)
+{
+	unsigned int n, d = 1;
+
+	if (sscanf(str, "%u/%u", &n, &d) < 1 || !n || !d)
+		return false;
+
+	*num = n;
+	*den = d;
+	return true;
+}
+
+static bool parse_args(struct bench *b, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (!val)
+			return false;
+
+		if (strcmp(arg, "--graphics") == 0) {
+			b->graphics_module = val;
+		} else if (strcmp(arg, "--resolution") == 0) {
+			if (!parse_size(val, &b->base_width, &b->base_height))
+				return false;
+		} else if (strcmp(arg, "--output") == 0) {
+			if (!parse_size(val, &b->output_width,
+						&b->output_height))
+				return false;
+		} else if (strcmp(arg, "--fps") == 0) {
+			if (!parse_fps(val, &b->fps_num, &b->fps_den))
+				return false;
+		} else if (strcmp(arg, "--duration") == 0) {
+			b->duration_ns = strtoull(val, NULL, 10) *
+				1000000000ULL;
+		} else if (strcmp(arg, "--sources") == 0) {
+			b->num_sources = atoi(val);
+		} else if (strcmp(arg, "--filters") == 0) {
+			b->num_filters = atoi(val);
+		} else if (strcmp(arg, "--text") == 0) {
+			b->num_texts = atoi(val);
+		} else if (strcmp(arg, "--sinewaves") == 0) {
+			b->num_sinewaves = atoi(val);
+		} else if (strcmp(arg, "--encoder") == 0) {
+			b->encoder_id = val;
+		} else {
+			return false;
+		}
+
+		i++;
+	}
+
+	return b->duration_ns != 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b = {0};
+	struct obs_perf_stats start, end;
+	int ret = 1;
+
+	b.graphics_module = DEFAULT_GRAPHICS_MODULE;
+	b.base_width      = 1920;
+	b.base_height     = 1080;
+	b.fps_num         = 60;
+	b.fps_den         = 1;
+	b.duration_ns     = 10000000000ULL;
+	b.num_sources     = 16;
+	b.num_filters     = 1;
+	b.num_sinewaves   = 2;
+
+	if (!parse_args(&b, argc, argv)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	/* must be enabled before anything is allocated to be accurate */
+	bmem_enable_tracking(true);
+
+	if (!obs_startup("en-US")) {
+		fprintf(stderr, "Failed to initialize libobs\n");
+		return 1;
+	}
+
+	if (!reset_audio() || !reset_video(&b))
+		goto exit;
+
+	obs_load_all_modules();
+
+	if (!build_scene(&b))
+		goto exit;
+	if (b.encoder_id && !start_encoding(&b))
+		goto exit;
+
+	os_sleep_ms((uint32_t)(WARMUP_NS / 1000000));
+
+	obs_get_perf_stats(&start);
+	profiler_start();
+
+	os_sleepto_ns(os_gettime_ns() + b.duration_ns);
+
+	profiler_stop();
+	obs_get_perf_stats(&end);
+
+	print_results(&b, &start, &end);
+	ret = 0;
+
+exit:
+	free_bench(&b);
+	obs_shutdown();
+	profiler_free();
+	return ret;
+}
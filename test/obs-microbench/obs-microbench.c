@@ -0,0 +1,483 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * Micro-benchmarks of the media-io kernels and util containers, each run in
+ * isolation over a range of sizes.  Every result is printed as one JSON
+ * object per line:
+ *
+ *   {"name": "compress_uyvx_to_nv12", "variant": "avx2",
+ *    "size": "1920x1080", "iterations": 1234, "ns_per_op": 812345.0,
+ *    "bytes_per_op": 8294400, "mb_per_sec": 9737.4}
+ *
+ * "variant" is the instruction set used: the format conversions are run
+ * with every version the CPU supports, the audio mix reports the one it was
+ * compiled with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/bmem.h>
+#include <media-io/format-conversion.h>
+#include <media-io/audio-mix.h>
+#include <media-io/audio-resampler.h>
+#include <media-io/video-scaler.h>
+#include <media-io/video-frame.h>
+#include <obs-data.h>
+
+#if defined(SIMD_SSE2)
+#define MIX_VARIANT "sse2"
+#elif defined(SIMD_NEON)
+#define MIX_VARIANT "neon"
+#else
+#define MIX_VARIANT "c"
+#endif
+
+typedef void (*bench_func_t)(void *param);
+
+static uint64_t    min_time_ns = 250000000ULL;
+static const char  *name_filter = NULL;
+
+/* keeps results alive so the compiler can't drop the benchmarked work */
+static volatile uint64_t sink;
+
+/* runs func in growing batches until the minimum time is reached */
+static void run(const char *name, const char *variant, const char *size,
+		uint64_t bytes_per_op, bench_func_t func, void *param)
+{
+	uint64_t iterations = 0;
+	uint64_t batch = 1;
+	uint64_t start, elapsed;
+	double ns_per_op;
+
+	if (name_filter && !strstr(name, name_filter))
+		return;
+
+	func(param);
+
+	start = os_gettime_ns();
+	do {
+		for (uint64_t i = 0; i < batch; i++)
+			func(param);
+
+		iterations += batch;
+		batch *= 2;
+		elapsed = os_gettime_ns() - start;
+	} while (elapsed < min_time_ns);
+
+	ns_per_op = (double)elapsed / (double)iterations;
+
+	printf("{\"name\": \"%s\", \"variant\": \"%s\", \"size\": \"%s\", "
+	       "\"iterations\": %llu, \"ns_per_op\": %.1f, "
+	       "\"bytes_per_op\": %llu, \"mb_per_sec\": %.1f}\n",
+	       name, variant, size, (unsigned long long)iterations,
+	       ns_per_op, (unsigned long long)bytes_per_op,
+	       (double)bytes_per_op * 1000000000.0 / ns_per_op /
+	       (1024.0 * 1024.0));
+	fflush(stdout);
+}
+
+/* ------------------------------------------------------------------------- */
+/* format conversion */
+
+static const uint32_t frame_sizes[][2] = {
+	{640,  360},
+	{1280, 720},
+	{1920, 1080},
+	{3840, 2160}
+};
+
+#define NUM_FRAME_SIZES (sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+
+struct compress_bench {
+	uint8_t            *input;
+	uint32_t           width;
+	uint32_t           height;
+	struct video_frame output;
+};
+
+static void bench_compress_i420(void *param)
+{
+	struct compress_bench *b = param;
+	compress_uyvx_to_i420(b->input, b->width * 4, 0, b->height,
+			b->output.data, b->output.linesize);
+}
+
+static void bench_compress_nv12(void *param)
+{
+	struct compress_bench *b = param;
+	compress_uyvx_to_nv12(b->input, b->width * 4, 0, b->height,
+			b->output.data, b->output.linesize);
+}
+
+static void run_compress(const char *variant)
+{
+	for (size_t i = 0; i < NUM_FRAME_SIZES; i++) {
+		struct compress_bench b;
+		size_t bytes;
+		char size[32];
+
+		b.width  = frame_sizes[i][0];
+		b.height = frame_sizes[i][1];
+		bytes    = (size_t)b.width * b.height * 4;
+		b.input  = bmalloc(bytes);
+		memset(b.input, 0x80, bytes);
+		snprintf(size, sizeof(size), "%ux%u", b.width, b.height);
+
+		video_frame_init(&b.output, VIDEO_FORMAT_I420,
+				b.width, b.height);
+		run("compress_uyvx_to_i420", variant, size, bytes,
+				bench_compress_i420, &b);
+		video_frame_free(&b.output);
+
+		video_frame_init(&b.output, VIDEO_FORMAT_NV12,
+				b.width, b.height);
+		run("compress_uyvx_to_nv12", variant, size, bytes,
+				bench_compress_nv12, &b);
+		video_frame_free(&b.output);
+
+		bfree(b.input);
+	}
+}
+
+static void bench_format_conversion(void)
+{
+	format_conversion_use_avx2(false);
+	run_compress("sse2");
+
+	if (format_conversion_use_avx2(true))
+		run_compress("avx2");
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio */
+
+struct mix_bench {
+	float  *mix;
+	float  *vals;
+	size_t count;
+};
+
+static void bench_mix(void *param)
+{
+	struct mix_bench *b = param;
+	mix_float_span(b->mix, b->vals, b->count);
+}
+
+static void bench_audio_mix(void)
+{
+	static const size_t counts[] = {1024, 8192, 65536};
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		struct mix_bench b;
+		char size[32];
+
+		b.count = counts[i];
+		b.mix   = bzalloc(b.count * sizeof(float));
+		b.vals  = bmalloc(b.count * sizeof(float));
+		for (size_t j = 0; j < b.count; j++)
+			b.vals[j] = (float)(j % 100) / 1000.0f - 0.05f;
+
+		snprintf(size, sizeof(size), "%u", (unsigned)b.count);
+		run("mix_float", MIX_VARIANT, size, b.count * sizeof(float),
+				bench_mix, &b);
+
+		bfree(b.mix);
+		bfree(b.vals);
+	}
+}
+
+struct resample_bench {
+	audio_resampler_t *resampler;
+	uint8_t           *input[MAX_AV_PLANES];
+	uint32_t          frames;
+};
+
+static void bench_resample(void *param)
+{
+	struct resample_bench *b = param;
+	uint8_t *output[MAX_AV_PLANES];
+	uint32_t out_frames;
+	uint64_t ts_offset;
+
+	audio_resampler_resample(b->resampler, output, &out_frames,
+			&ts_offset, (const uint8_t *const *)b->input,
+			b->frames);
+	sink += out_frames;
+}
+
+static void run_resample(const char *name, const struct resample_info *dst,
+		const struct resample_info *src)
+{
+	static const uint32_t frame_counts[] = {480, 1024, 4096};
+	size_t channels = get_audio_channels(src->speakers);
+
+	for (size_t i = 0; i < sizeof(frame_counts) / sizeof(uint32_t); i++) {
+		struct resample_bench b = {0};
+		char size[32];
+
+		b.resampler = audio_resampler_create(dst, src);
+		if (!b.resampler) {
+			fprintf(stderr, "failed to create resampler for %s\n",
+					name);
+			return;
+		}
+
+		b.frames = frame_counts[i];
+		for (size_t c = 0; c < channels; c++)
+			b.input[c] = bzalloc(b.frames * sizeof(float));
+
+		snprintf(size, sizeof(size), "%u", b.frames);
+		run(name, "ffmpeg", size,
+				b.frames * channels * sizeof(float),
+				bench_resample, &b);
+
+		for (size_t c = 0; c < channels; c++)
+			bfree(b.input[c]);
+		audio_resampler_destroy(b.resampler);
+	}
+}
+
+static void bench_audio_resampler(void)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_FLOAT_PLANAR,
+		SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+		SPEAKERS_STEREO};
+
+	run_resample("audio_resampler_resample 44100->48000", &dst, &src);
+
+	src.samples_per_sec = 48000;
+	src.speakers        = SPEAKERS_MONO;
+	run_resample("audio_resampler_resample mono->stereo", &dst, &src);
+}
+
+/* ------------------------------------------------------------------------- */
+/* video scaler */
+
+struct scale_bench {
+	video_scaler_t     *scaler;
+	struct video_frame input;
+	struct video_frame output;
+};
+
+static void bench_scale(void *param)
+{
+	struct scale_bench *b = param;
+	video_scaler_scale(b->scaler, b->output.data, b->output.linesize,
+			(const uint8_t *const *)b->input.data,
+			b->input.linesize);
+}
+
+static void run_scale(const char *name, enum video_format src_format,
+		enum video_format dst_format, uint32_t src_cx, uint32_t src_cy,
+		uint32_t dst_cx, uint32_t dst_cy)
+{
+	struct video_scale_info src = {src_format, src_cx, src_cy,
+		VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	struct video_scale_info dst = {dst_format, dst_cx, dst_cy,
+		VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	struct scale_bench b = {0};
+	char size[64];
+
+	if (video_scaler_create(&b.scaler, &dst, &src,
+				VIDEO_SCALE_BILINEAR) != VIDEO_SCALER_SUCCESS) {
+		fprintf(stderr, "failed to create scaler for %s\n", name);
+		return;
+	}
+
+	video_frame_init(&b.input, src_format, src_cx, src_cy);
+	video_frame_init(&b.output, dst_format, dst_cx, dst_cy);
+
+	snprintf(size, sizeof(size), "%ux%u->%ux%u", src_cx, src_cy,
+			dst_cx, dst_cy);
+	run(name, "ffmpeg", size, (uint64_t)src_cx * src_cy, bench_scale, &b);
+
+	video_frame_free(&b.input);
+	video_frame_free(&b.output);
+	video_scaler_destroy(b.scaler);
+}
+
+static void bench_video_scaler(void)
+{
+	run_scale("video_scaler_scale nv12", VIDEO_FORMAT_NV12,
+			VIDEO_FORMAT_NV12, 1920, 1080, 1280, 720);
+	run_scale("video_scaler_scale nv12", VIDEO_FORMAT_NV12,
+			VIDEO_FORMAT_NV12, 3840, 2160, 1920, 1080);
+	run_scale("video_scaler_scale i420->nv12", VIDEO_FORMAT_I420,
+			VIDEO_FORMAT_NV12, 1920, 1080, 1920, 1080);
+	run_scale("video_scaler_scale bgra->i420", VIDEO_FORMAT_BGRA,
+			VIDEO_FORMAT_I420, 1920, 1080, 1280, 720);
+}
+
+/* ------------------------------------------------------------------------- */
+/* containers */
+
+struct circlebuf_bench {
+	struct circlebuf buf;
+	uint8_t          *data;
+	size_t           chunk;
+};
+
+/* keeps a few chunks queued, like the audio and packet queues do */
+static void bench_circlebuf_push_pop(void *param)
+{
+	struct circlebuf_bench *b = param;
+
+	circlebuf_push_back(&b->buf, b->data, b->chunk);
+	if (b->buf.size > b->chunk * 4)
+		circlebuf_pop_front(&b->buf, b->data, b->chunk);
+}
+
+static void bench_circlebuf(void)
+{
+	static const size_t chunks[] = {16, 1024, 65536};
+
+	for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		struct circlebuf_bench b = {0};
+		char size[32];
+
+		b.chunk = chunks[i];
+		b.data  = bzalloc(b.chunk);
+
+		snprintf(size, sizeof(size), "%u", (unsigned)b.chunk);
+		run("circlebuf push/pop", "c", size, b.chunk,
+				bench_circlebuf_push_pop, &b);
+
+		circlebuf_free(&b.buf);
+		bfree(b.data);
+	}
+}
+
+struct darray_bench {
+	size_t count;
+};
+
+/* grows from empty every time, so reallocation is part of the cost */
+static void bench_darray_push(void *param)
+{
+	struct darray_bench *b = param;
+	DARRAY(uint32_t) array;
+
+	da_init(array);
+	for (uint32_t i = 0; i < (uint32_t)b->count; i++)
+		da_push_back(array, &i);
+
+	sink += array.num;
+	da_free(array);
+}
+
+static void bench_darray(void)
+{
+	static const size_t counts[] = {16, 1024, 100000};
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		struct darray_bench b = {counts[i]};
+		char size[32];
+
+		snprintf(size, sizeof(size), "%u", (unsigned)b.count);
+		run("darray push_back", "c", size,
+				b.count * sizeof(uint32_t),
+				bench_darray_push, &b);
+	}
+}
+
+struct obs_data_bench {
+	obs_data_t *data;
+	char       **names;
+	size_t     count;
+};
+
+static void bench_obs_data_set_get(void *param)
+{
+	struct obs_data_bench *b = param;
+
+	for (size_t i = 0; i < b->count; i++)
+		obs_data_set_int(b->data, b->names[i], (long long)i);
+	for (size_t i = 0; i < b->count; i++)
+		sink += (uint64_t)obs_data_get_int(b->data, b->names[i]);
+}
+
+static void bench_obs_data(void)
+{
+	static const size_t counts[] = {16, 256};
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		struct obs_data_bench b;
+		char size[32];
+
+		b.count = counts[i];
+		b.data  = obs_data_create();
+		b.names = bzalloc(b.count * sizeof(char*));
+		for (size_t j = 0; j < b.count; j++) {
+			char name[32];
+			snprintf(name, sizeof(name), "setting_%u",
+					(unsigned)j);
+			b.names[j] = bstrdup(name);
+		}
+
+		snprintf(size, sizeof(size), "%u", (unsigned)b.count);
+		run("obs_data set/get int", "c", size, 0,
+				bench_obs_data_set_get, &b);
+
+		for (size_t j = 0; j < b.count; j++)
+			bfree(b.names[j]);
+		bfree(b.names);
+		obs_data_release(b.data);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"\n"
+		"  --filter <text>     only run benchmarks whose name contains "
+		"the text\n"
+		"  --time <ms>         minimum time per benchmark (default "
+		"250)\n",
+		program);
+}
+
+int main(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			name_filter = argv[++i];
+		} else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+			min_time_ns = strtoull(argv[++i], NULL, 10) *
+				1000000ULL;
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	bench_format_conversion();
+	bench_audio_mix();
+	bench_audio_resampler();
+	bench_video_scaler();
+	bench_circlebuf();
+	bench_darray();
+	bench_obs_data();
+
+	return 0;
+}